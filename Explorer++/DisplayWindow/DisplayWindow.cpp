@@ -78,7 +78,9 @@ CDisplayWindow::CDisplayWindow(HWND hDisplayWindow,DWInitialSettings_t *pInitial
 	m_CentreColor(pInitialSettings->CentreColor),
 	m_SurroundColor(pInitialSettings->SurroundColor),
 	m_hMainIcon(pInitialSettings->hIcon),
-	m_hDisplayFont(pInitialSettings->hFont)
+	m_hDisplayFont(pInitialSettings->hFont),
+	m_thumbnailExtractionId(0),
+	m_thumbnailCache(MAX_CACHED_THUMBNAILS)
 {
 	g_ObjectCount++;
 
@@ -86,18 +88,24 @@ CDisplayWindow::CDisplayWindow(HWND hDisplayWindow,DWInitialSettings_t *pInitial
 	m_LeftIndent	= 80;
 
 	m_bSizing = FALSE;
-	m_hbmThumbnail = NULL;
 	m_bShowThumbnail = FALSE;
 	m_bThumbnailExtracted = FALSE;
 	m_bThumbnailExtractionFailed = FALSE;
 	m_hBitmapBackground = NULL;
 
-	InitializeCriticalSection(&m_csDWThumbnails);
+	if(pInitialSettings->taskScheduler != NULL)
+	{
+		m_thumbnailQueue = pInitialSettings->taskScheduler->CreateQueue();
+		m_thumbnailQueue->SetActive(true);
+	}
 }
 
 CDisplayWindow::~CDisplayWindow()
 {
-	DeleteCriticalSection(&m_csDWThumbnails);
+	/* Waits for any extraction that's in progress. The
+	result will be discarded, since the window no longer
+	exists to receive it. */
+	m_thumbnailQueue.reset();
 
 	DeleteDC(m_hdcBackground);
 	DeleteObject(m_hBitmapBackground);
@@ -241,6 +249,10 @@ WPARAM wParam,LPARAM lParam)
 			RedrawWindow(DisplayWindow,NULL,NULL,RDW_INVALIDATE);
 			break;
 
+		case DWM_THUMBNAILEXTRACTED:
+			OnThumbnailExtracted(wParam,lParam);
+			break;
+
 		case DWM_GETCENTRECOLOR:
 			return m_CentreColor.ToCOLORREF();
 			break;
@@ -4,6 +4,12 @@
 
 #pragma once
 
+#include "../Helper/LRUCache.h"
+#include "../Helper/TaskScheduler.h"
+#include <wil/resource.h>
+#include <memory>
+#include <string>
+
 #pragma warning(push)
 #pragma warning(disable:4458)
 #include <gdiplus.h>
@@ -30,6 +36,9 @@
 #define DWM_CLEARTEXTBUFFER		(DWM_BASE + 16)
 #define DWM_SETLINE				(DWM_BASE + 17)
 
+/* Sent (internally) once a thumbnail has been extracted. */
+#define DWM_THUMBNAILEXTRACTED	(DWM_BASE + 18)
+
 #define DisplayWindow_SetThumbnailFile(hDisplay,FileName,bShowImage) \
 SendMessage(hDisplay,DWM_SETTHUMBNAILFILE,(WPARAM)FileName,(LPARAM)bShowImage)
 
@@ -72,6 +81,10 @@ typedef struct
 	COLORREF	TextColor;
 	HFONT		hFont;
 	HICON		hIcon;
+
+	/* Thumbnails are extracted on this scheduler. If
+	this is NULL, no thumbnails will be shown. */
+	TaskScheduler	*taskScheduler;
 } DWInitialSettings_t;
 
 typedef struct
@@ -79,12 +92,6 @@ typedef struct
 	TCHAR szText[512];
 } LineData_t;
 
-typedef struct
-{
-	void *pdw;
-	BOOL bCancelled;
-} ThumbnailEntry_t;
-
 static int g_ObjectCount = 0;
 
 class CDisplayWindow
@@ -96,12 +103,41 @@ public:
 	CDisplayWindow(HWND hDisplayWindow,DWInitialSettings_t *pInitialSettings);
 	~CDisplayWindow();
 
-	void	ExtractThumbnailImageInternal(ThumbnailEntry_t *pte);
-
 private:
 
 	#define BORDER_COLOUR		Gdiplus::Color(128,128,128)
 
+	/* The number of recently shown thumbnails that are
+	kept, so that moving back and forth through a set of
+	files doesn't require each thumbnail to be extracted
+	again. */
+	static const int MAX_CACHED_THUMBNAILS = 20;
+
+	struct Thumbnail
+	{
+		wil::unique_hbitmap	bitmap;
+		int					width;
+		int					height;
+	};
+
+	/* A cached thumbnail is only used if the file hasn't
+	changed and the thumbnail was extracted at the current
+	height. An empty thumbnail indicates that no thumbnail
+	could be extracted for the file. */
+	struct CachedThumbnail
+	{
+		ULONGLONG	lastWriteTime;
+		ULONGLONG	fileSize;
+		int			thumbnailHeight;
+		std::shared_ptr<const Thumbnail>	thumbnail;
+	};
+
+	struct ThumbnailResult
+	{
+		std::wstring	path;
+		CachedThumbnail	cachedThumbnail;
+	};
+
 	LRESULT CALLBACK DisplayWindowProc(HWND,UINT,WPARAM,LPARAM);
 
 	LONG	OnMouseMove(LPARAM lParam);
@@ -120,7 +156,10 @@ private:
 	void	OnSize(int width, int height);
 
 	void	ExtractThumbnailImage(void);
-	void	CancelThumbnailExtraction(void);
+	void	OnThumbnailExtracted(WPARAM wParam,LPARAM lParam);
+	void	SetThumbnail(std::shared_ptr<const Thumbnail> thumbnail);
+
+	static std::shared_ptr<const Thumbnail>	ExtractThumbnail(const std::wstring &path,int thumbnailHeight);
 
 
 	HWND			m_hDisplayWindow;
@@ -140,9 +179,15 @@ private:
 	int				m_iImageWidth;
 	int				m_iImageHeight;
 
-	/* Thumbnails. */
-	CRITICAL_SECTION	m_csDWThumbnails;
-	HBITMAP			m_hbmThumbnail;
+	/* Thumbnails. Only the thumbnail for the current file
+	is ever needed, so the queue only runs one extraction at
+	a time and is cancelled whenever the file changes. Each
+	extraction is tagged with an id, so that a result that
+	arrives after the file has changed can be ignored. */
+	std::unique_ptr<TaskScheduler::Queue>	m_thumbnailQueue;
+	int				m_thumbnailExtractionId;
+	LRUCache<std::wstring,CachedThumbnail>	m_thumbnailCache;
+	std::shared_ptr<const Thumbnail>	m_thumbnail;
 	BOOL			m_bShowThumbnail;
 	BOOL			m_bThumbnailExtracted;
 	BOOL			m_bThumbnailExtractionFailed;
@@ -35,8 +35,6 @@ can float. */
 at the top and bottom of the thumbnail. */
 #define THUMB_HEIGHT_DELTA		20
 
-std::list<ThumbnailEntry_t>	g_ThumbnailEntries;
-
 void CDisplayWindow::DrawGradientFill(HDC hdc,RECT *rc)
 {
 	if(m_hBitmapBackground)
@@ -100,168 +98,225 @@ void CDisplayWindow::PatchBackground(HDC hdc,RECT *rc,RECT *UpdateRect)
 
 void CDisplayWindow::DrawThumbnail(HDC hdcMem)
 {
+	/* If the thumbnail is cached, it will be available
+	straight away. */
 	if(!m_bThumbnailExtracted)
 	{
 		ExtractThumbnailImage();
 	}
-	else
+
+	if(!m_bThumbnailExtractionFailed && m_thumbnail)
 	{
-		if(!m_bThumbnailExtractionFailed)
-		{
-			RECT rc;
-			GetClientRect(m_hDisplayWindow,&rc);
+		RECT rc;
+		GetClientRect(m_hDisplayWindow,&rc);
 
-			HDC hdcSrc = CreateCompatibleDC(hdcMem);
-			HBITMAP hBitmapOld = (HBITMAP)SelectObject(hdcSrc,m_hbmThumbnail);
+		HDC hdcSrc = CreateCompatibleDC(hdcMem);
+		HBITMAP hBitmapOld = (HBITMAP)SelectObject(hdcSrc,m_thumbnail->bitmap.get());
 
-			BitBlt(hdcMem,m_xColumnFinal,THUMB_IMAGE_TOP,
-				GetRectWidth(&rc) - m_xColumnFinal,GetRectHeight(&rc) - THUMB_HEIGHT_DELTA,
-				hdcSrc,0,0,SRCCOPY);
+		BitBlt(hdcMem,m_xColumnFinal,THUMB_IMAGE_TOP,
+			GetRectWidth(&rc) - m_xColumnFinal,GetRectHeight(&rc) - THUMB_HEIGHT_DELTA,
+			hdcSrc,0,0,SRCCOPY);
 
-			SelectObject(hdcSrc,hBitmapOld);
-			DeleteDC(hdcSrc);
-		}
+		SelectObject(hdcSrc,hBitmapOld);
+		DeleteDC(hdcSrc);
 	}
 }
 
-DWORD WINAPI Thread_ExtractThumbnailImage(LPVOID lpParameter)
+void CDisplayWindow::ExtractThumbnailImage(void)
 {
-	CDisplayWindow *pdw = NULL;
+	/* Nothing will be drawn until a thumbnail is
+	available. */
+	m_bThumbnailExtracted = TRUE;
+	m_bThumbnailExtractionFailed = TRUE;
 
-	pdw = (CDisplayWindow *)((ThumbnailEntry_t *)lpParameter)->pdw;
+	if(!m_thumbnailQueue)
+	{
+		return;
+	}
 
-	CoInitializeEx(0,COINIT_APARTMENTTHREADED);
+	RECT rc;
+	GetClientRect(m_hDisplayWindow,&rc);
+	int thumbnailHeight = GetRectHeight(&rc) - THUMB_HEIGHT_DELTA;
+
+	if(thumbnailHeight <= 0)
+	{
+		return;
+	}
+
+	WIN32_FILE_ATTRIBUTE_DATA fileAttributes;
+	BOOL res = GetFileAttributesEx(m_ImageFile,GetFileExInfoStandard,&fileAttributes);
 
-	SetThreadPriority(GetCurrentThread(),THREAD_PRIORITY_BELOW_NORMAL);
+	if(!res)
+	{
+		return;
+	}
 
-	pdw->ExtractThumbnailImageInternal((ThumbnailEntry_t *)lpParameter);
+	ULARGE_INTEGER lastWriteTime = {fileAttributes.ftLastWriteTime.dwLowDateTime,fileAttributes.ftLastWriteTime.dwHighDateTime};
+	ULARGE_INTEGER fileSize = {fileAttributes.nFileSizeLow,fileAttributes.nFileSizeHigh};
 
-	/* TODO: Erase the item. */
-	//g_ThumbnailEntries.erase();
+	auto cachedThumbnail = m_thumbnailCache.Get(m_ImageFile);
 
-	CoUninitialize();
+	if(cachedThumbnail && cachedThumbnail->lastWriteTime == lastWriteTime.QuadPart
+		&& cachedThumbnail->fileSize == fileSize.QuadPart
+		&& cachedThumbnail->thumbnailHeight == thumbnailHeight)
+	{
+		SetThumbnail(cachedThumbnail->thumbnail);
+		return;
+	}
 
-	return 0;
+	CachedThumbnail pendingThumbnail;
+	pendingThumbnail.lastWriteTime = lastWriteTime.QuadPart;
+	pendingThumbnail.fileSize = fileSize.QuadPart;
+	pendingThumbnail.thumbnailHeight = thumbnailHeight;
+
+	/* The thumbnail is extracted in the background and
+	then sent back to this window. */
+	m_thumbnailQueue->Push(TaskScheduler::TaskPriority::Visible,
+		[hDisplayWindow = m_hDisplayWindow, extractionId = m_thumbnailExtractionId,
+		path = std::wstring(m_ImageFile), pendingThumbnail] {
+		auto result = std::make_unique<ThumbnailResult>();
+		result->path = path;
+		result->cachedThumbnail = pendingThumbnail;
+		result->cachedThumbnail.thumbnail = ExtractThumbnail(path,pendingThumbnail.thumbnailHeight);
+
+		BOOL posted = PostMessage(hDisplayWindow,DWM_THUMBNAILEXTRACTED,
+			static_cast<WPARAM>(extractionId),reinterpret_cast<LPARAM>(result.get()));
+
+		/* The message won't be delivered if the window has
+		already been destroyed. */
+		if(posted)
+		{
+			result.release();
+		}
+	});
 }
 
-void CDisplayWindow::ExtractThumbnailImage(void)
+void CDisplayWindow::OnThumbnailExtracted(WPARAM wParam,LPARAM lParam)
 {
-	ThumbnailEntry_t te;
+	std::unique_ptr<ThumbnailResult> result(reinterpret_cast<ThumbnailResult *>(lParam));
+
+	/* The result is cached even if the file is no
+	longer selected, since it may well be selected
+	again. */
+	m_thumbnailCache.Set(result->path,result->cachedThumbnail);
 
-	te.pdw			= (void *)this;
-	te.bCancelled	= FALSE;
-	g_ThumbnailEntries.push_back(te);
+	if(static_cast<int>(wParam) != m_thumbnailExtractionId)
+	{
+		return;
+	}
 
-	HANDLE hThread = CreateThread(NULL,0,Thread_ExtractThumbnailImage,
-		(LPVOID)&g_ThumbnailEntries.back(),0,NULL);
-	CloseHandle(hThread);
+	SetThumbnail(result->cachedThumbnail.thumbnail);
+	InvalidateRect(m_hDisplayWindow,NULL,FALSE);
 }
 
-void CDisplayWindow::ExtractThumbnailImageInternal(ThumbnailEntry_t *pte)
+void CDisplayWindow::SetThumbnail(std::shared_ptr<const Thumbnail> thumbnail)
 {
-	IExtractImage *pExtractImage = NULL;
-	IShellFolder *pShellFolder = NULL;
-	LPITEMIDLIST pidlParent = NULL;
-	LPITEMIDLIST pidlFull = NULL;
-	LPITEMIDLIST pridl = NULL;
-	HBITMAP hBitmap;
-	BITMAP bm;
-	RECT rc;
-	SIZE size;
+	m_thumbnail = thumbnail;
+
+	if(m_thumbnail)
+	{
+		m_iImageWidth = m_thumbnail->width;
+		m_iImageHeight = m_thumbnail->height;
+		m_bThumbnailExtractionFailed = FALSE;
+	}
+	else
+	{
+		m_iImageWidth = 0;
+		m_iImageHeight = 0;
+		m_bThumbnailExtractionFailed = TRUE;
+	}
+}
+
+/* Runs on one of the scheduler's threads. As such,
+this shouldn't access any of the window's state. */
+std::shared_ptr<const CDisplayWindow::Thumbnail> CDisplayWindow::ExtractThumbnail(const std::wstring &path,
+	int thumbnailHeight)
+{
+	unique_pidl_absolute pidlFull;
+	HRESULT hr = SHParseDisplayName(path.c_str(), nullptr, wil::out_param(pidlFull), 0, nullptr);
+
+	if(FAILED(hr))
+	{
+		return nullptr;
+	}
+
+	unique_pidl_absolute pidlParent(ILCloneFull(pidlFull.get()));
+	ILRemoveLastID(pidlParent.get());
+
+	PCUITEMID_CHILD pidlChild = ILFindLastID(pidlFull.get());
+
+	wil::com_ptr<IShellFolder> pShellFolder;
+	hr = BindToIdl(pidlParent.get(), IID_PPV_ARGS(&pShellFolder));
+
+	if(FAILED(hr))
+	{
+		return nullptr;
+	}
+
+	wil::com_ptr<IExtractImage> pExtractImage;
+	hr = GetUIObjectOf(pShellFolder.get(), NULL, 1, &pidlChild, IID_PPV_ARGS(&pExtractImage));
+
+	if(FAILED(hr))
+	{
+		return nullptr;
+	}
+
 	TCHAR szImage[MAX_PATH];
 	DWORD dwPriority;
-	DWORD dwFlags;
-	HRESULT hr;
 
-	m_bThumbnailExtracted = TRUE;
-	m_bThumbnailExtractionFailed = TRUE;
+	/* First, query the thumbnail so that its actual aspect
+	ratio can be calculated. */
+	DWORD dwFlags = IEIFLAG_OFFLINE|IEIFLAG_QUALITY|IEIFLAG_ORIGSIZE;
+	SIZE size;
+	size.cx = thumbnailHeight;
+	size.cy = thumbnailHeight;
 
-	hr = SHParseDisplayName(m_ImageFile, nullptr, &pidlFull, 0, nullptr);
+	hr = pExtractImage->GetLocation(szImage,SIZEOF_ARRAY(szImage),
+		&dwPriority,&size,32,&dwFlags);
 
-	if(SUCCEEDED(hr))
+	if(FAILED(hr))
 	{
-		pidlParent = ILClone(pidlFull);
-		ILRemoveLastID(pidlParent);
+		return nullptr;
+	}
 
-		pridl = ILClone(ILFindLastID(pidlFull));
+	wil::unique_hbitmap hBitmap;
+	hr = pExtractImage->Extract(&hBitmap);
 
-		hr = BindToIdl(pidlParent, IID_PPV_ARGS(&pShellFolder));
+	if(FAILED(hr))
+	{
+		return nullptr;
+	}
 
-		if(SUCCEEDED(hr))
-		{
-			hr = GetUIObjectOf(pShellFolder, NULL, 1, (LPCITEMIDLIST *) &pridl,
-				IID_PPV_ARGS(&pExtractImage));
-
-			if(SUCCEEDED(hr))
-			{
-				GetClientRect(m_hDisplayWindow,&rc);
-
-				/* First, query the thumbnail so that its actual aspect
-				ratio can be calculated. */
-				dwFlags = IEIFLAG_OFFLINE|IEIFLAG_QUALITY|IEIFLAG_ORIGSIZE;
-				size.cx = GetRectHeight(&rc) - THUMB_HEIGHT_DELTA;
-				size.cy = GetRectHeight(&rc) - THUMB_HEIGHT_DELTA;
-
-				hr = pExtractImage->GetLocation(szImage,SIZEOF_ARRAY(szImage),
-					&dwPriority,&size,32,&dwFlags);
-
-				if(SUCCEEDED(hr))
-				{
-					hr = pExtractImage->Extract(&hBitmap);
-
-					if(SUCCEEDED(hr))
-					{
-						/* Get bitmap information (including height and width). */
-						GetObject(hBitmap,sizeof(BITMAP),&bm);
-
-						/* Delete the original bitmap. */
-						DeleteObject(hBitmap);
-
-						/* ...now query the thumbnail again, this time adjusting
-						the width of the suggested area based on the actual aspect
-						ratio. */
-						dwFlags = IEIFLAG_OFFLINE|IEIFLAG_QUALITY|IEIFLAG_ASPECT|IEIFLAG_ORIGSIZE;
-						size.cy = GetRectHeight(&rc) - THUMB_HEIGHT_DELTA;
-						size.cx = (LONG)((double)size.cy * ((double)bm.bmWidth / (double)bm.bmHeight));
-						m_iImageWidth = size.cx;
-						m_iImageHeight = size.cy;
-						pExtractImage->GetLocation(szImage,SIZEOF_ARRAY(szImage),
-							&dwPriority,&size,32,&dwFlags);
-						hr = pExtractImage->Extract(&m_hbmThumbnail);
-
-						if(SUCCEEDED(hr))
-						{
-							/* Check first if we've been cancelled. This might happen,
-							for example, if another file is selected while the current
-							thumbnail is been found. */
-							EnterCriticalSection(&m_csDWThumbnails);
-
-							if(!pte->bCancelled)
-							{
-								m_bThumbnailExtractionFailed = FALSE;
-								InvalidateRect(m_hDisplayWindow,NULL,FALSE);
-							}
-
-							LeaveCriticalSection(&m_csDWThumbnails);
-						}
-						else
-						{
-							m_bThumbnailExtractionFailed = TRUE;
-							m_hbmThumbnail = NULL;
-						}
-					}
-				}
-
-				pExtractImage->Release();
-			}
-
-			pShellFolder->Release();
-		}
+	BITMAP bm;
+
+	if(GetObject(hBitmap.get(),sizeof(BITMAP),&bm) == 0 || bm.bmHeight == 0)
+	{
+		return nullptr;
+	}
+
+	hBitmap.reset();
 
-		CoTaskMemFree(pidlFull);
-		CoTaskMemFree(pidlParent);
-		CoTaskMemFree(pridl);
+	/* ...now query the thumbnail again, this time adjusting
+	the width of the suggested area based on the actual aspect
+	ratio. */
+	dwFlags = IEIFLAG_OFFLINE|IEIFLAG_QUALITY|IEIFLAG_ASPECT|IEIFLAG_ORIGSIZE;
+	size.cy = thumbnailHeight;
+	size.cx = (LONG)((double)size.cy * ((double)bm.bmWidth / (double)abs(bm.bmHeight)));
+	pExtractImage->GetLocation(szImage,SIZEOF_ARRAY(szImage),
+		&dwPriority,&size,32,&dwFlags);
+
+	auto thumbnail = std::make_shared<Thumbnail>();
+	hr = pExtractImage->Extract(&thumbnail->bitmap);
+
+	if(FAILED(hr))
+	{
+		return nullptr;
 	}
+
+	thumbnail->width = size.cx;
+	thumbnail->height = size.cy;
+
+	return thumbnail;
 }
 
 void CDisplayWindow::PaintText(HDC hdc,unsigned int x)
@@ -440,35 +495,25 @@ void CDisplayWindow::OnRButtonUp(WPARAM wParam,LPARAM lParam)
 	}
 }
 
-void CDisplayWindow::CancelThumbnailExtraction(void)
+void CDisplayWindow::OnSetThumbnailFile(WPARAM wParam,LPARAM lParam)
 {
-	std::list<ThumbnailEntry_t>::iterator itr;
+	m_bShowThumbnail = (BOOL)lParam;
 
-	EnterCriticalSection(&m_csDWThumbnails);
+	/* Any extraction that's still queued or running is
+	for a file that's no longer shown. */
+	m_thumbnailExtractionId++;
 
-	for(itr = g_ThumbnailEntries.begin();itr != g_ThumbnailEntries.end();itr++)
+	if(m_thumbnailQueue)
 	{
-		itr->bCancelled = TRUE;
+		m_thumbnailQueue->Cancel();
 	}
 
-	LeaveCriticalSection(&m_csDWThumbnails);
-}
-
-void CDisplayWindow::OnSetThumbnailFile(WPARAM wParam,LPARAM lParam)
-{
-	m_bShowThumbnail = (BOOL)lParam;
+	SetThumbnail(nullptr);
+	m_bThumbnailExtracted = FALSE;
+	m_bThumbnailExtractionFailed = FALSE;
 
 	if(m_bShowThumbnail)
 	{
-		CancelThumbnailExtraction();
-
-		if(m_hbmThumbnail)
-			DeleteObject(m_hbmThumbnail);
-
-		m_iImageWidth	= 0;
-		m_iImageHeight	= 0;
-		m_bThumbnailExtracted = FALSE;
-		m_bThumbnailExtractionFailed = FALSE;
 		StringCchCopy(m_ImageFile,SIZEOF_ARRAY(m_ImageFile),
 		(TCHAR *)wParam);
 	}
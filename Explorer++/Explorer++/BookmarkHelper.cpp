@@ -20,25 +20,10 @@ int CALLBACK SortByLastModified(const VariantBookmark &BookmarkItem1,const Varia
 VariantBookmark &NBookmarkHelper::GetBookmarkItem(CBookmarkFolder &ParentBookmarkFolder,
 	const GUID &guid)
 {
-	auto itr = std::find_if(ParentBookmarkFolder.begin(),ParentBookmarkFolder.end(),
-		[guid](VariantBookmark &variantBookmark) -> BOOL
-		{
-			if(variantBookmark.type() == typeid(CBookmarkFolder))
-			{
-				CBookmarkFolder BookmarkFolder = boost::get<CBookmarkFolder>(variantBookmark);
-				return IsEqualGUID(BookmarkFolder.GetGUID(),guid);
-			}
-			else
-			{
-				CBookmark Bookmark = boost::get<CBookmark>(variantBookmark);
-				return IsEqualGUID(Bookmark.GetGUID(),guid);
-			}
-		}
-	);
-
-	assert(itr != ParentBookmarkFolder.end());
+	VariantBookmark *variantBookmark = ParentBookmarkFolder.GetChild(guid);
+	assert(variantBookmark != nullptr);
 
-	return *itr;
+	return *variantBookmark;
 }
 
 int CALLBACK NBookmarkHelper::Sort(SortMode_t SortMode,const VariantBookmark &BookmarkItem1,
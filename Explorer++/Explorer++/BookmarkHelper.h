@@ -9,21 +9,8 @@
 
 namespace NBookmarkHelper
 {
-	struct GuidEq
-	{
-		bool operator () (const GUID &guid1,const GUID &guid2) const
-		{
-			return (IsEqualGUID(guid1,guid2) == TRUE);
-		}
-	};
-
-	struct GuidHash
-	{
-		size_t operator () (const GUID &guid) const
-		{
-			return guid.Data1;
-		}
-	};
+	typedef NBookmark::GuidEq GuidEq;
+	typedef NBookmark::GuidHash GuidHash;
 
 	typedef std::unordered_set<GUID,GuidHash,GuidEq> setExpansion_t;
 
@@ -45,5 +32,7 @@ namespace NBookmarkHelper
 
 	int CALLBACK		Sort(SortMode_t SortMode, const VariantBookmark &BookmarkItem1, const VariantBookmark &BookmarkItem2);
 
+	/* The item must be a direct child of the specified
+	folder. */
 	VariantBookmark		&GetBookmarkItem(CBookmarkFolder &ParentBookmarkFolder, const GUID &guid);
 }
\ No newline at end of file
@@ -6,7 +6,6 @@
 #include "BookmarkTreeView.h"
 #include "MainResource.h"
 #include "../Helper/Macros.h"
-#include <stack>
 
 CBookmarkTreeView::CBookmarkTreeView(HWND hTreeView, HINSTANCE hInstance,
 	IExplorerplusplus *expp, CBookmarkFolder *pAllBookmarks, const GUID &guidSelected,
@@ -435,7 +434,7 @@ void CBookmarkTreeView::CreateNewFolder()
 	assert(hSelectedItem != NULL);
 
 	CBookmarkFolder &ParentBookmarkFolder = GetBookmarkFolderFromTreeView(hSelectedItem);
-	ParentBookmarkFolder.InsertBookmarkFolder(NewBookmarkFolder);
+	ParentBookmarkFolder.InsertBookmarkFolder(std::move(NewBookmarkFolder));
 }
 
 void CBookmarkTreeView::SelectFolder(const GUID &guid)
@@ -449,38 +448,24 @@ void CBookmarkTreeView::SelectFolder(const GUID &guid)
 
 CBookmarkFolder &CBookmarkTreeView::GetBookmarkFolderFromTreeView(HTREEITEM hItem)
 {
+	/* The root item represents the top-level folder. */
+	if (TreeView_GetParent(m_hTreeView, hItem) == NULL)
+	{
+		return *m_pAllBookmarks;
+	}
+
 	TVITEM tvi;
 	tvi.mask = TVIF_HANDLE | TVIF_PARAM;
 	tvi.hItem = hItem;
 	TreeView_GetItem(m_hTreeView, &tvi);
 
-	std::stack<UINT> stackIDs;
-	HTREEITEM hParent;
-	HTREEITEM hCurrentItem = hItem;
+	auto itr = m_mapID.find(static_cast<UINT>(tvi.lParam));
+	assert(itr != m_mapID.end());
 
-	while ((hParent = TreeView_GetParent(m_hTreeView, hCurrentItem)) != NULL)
-	{
-		tvi.mask = TVIF_HANDLE | TVIF_PARAM;
-		tvi.hItem = hCurrentItem;
-		TreeView_GetItem(m_hTreeView, &tvi);
-
-		stackIDs.push(static_cast<UINT>(tvi.lParam));
-
-		hCurrentItem = hParent;
-	}
-
-	CBookmarkFolder *pBookmarkFolder = m_pAllBookmarks;
-
-	while (!stackIDs.empty())
-	{
-		UINT uID = stackIDs.top();
-		auto itr = m_mapID.find(uID);
-
-		VariantBookmark &variantBookmark = NBookmarkHelper::GetBookmarkItem(*pBookmarkFolder, itr->second);
-		pBookmarkFolder = boost::get<CBookmarkFolder>(&variantBookmark);
-
-		stackIDs.pop();
-	}
+	/* Folders can be looked up directly, without having
+	to walk down from the root. */
+	VariantBookmark *variantBookmark = m_pAllBookmarks->FindItem(itr->second);
+	assert(variantBookmark != nullptr);
 
-	return *pBookmarkFolder;
+	return boost::get<CBookmarkFolder>(*variantBookmark);
 }
\ No newline at end of file
@@ -122,7 +122,7 @@ void CBookmarksToolbar::OpenBookmarkItemInNewTab(const VariantBookmark &variantB
 	{
 		const CBookmarkFolder &bookmarkFolder = boost::get<CBookmarkFolder>(variantBookmarkItem);
 
-		for (auto variantBookmarkChild : bookmarkFolder)
+		for (const auto &variantBookmarkChild : bookmarkFolder)
 		{
 			if (variantBookmarkChild.type() == typeid(CBookmark))
 			{
@@ -423,7 +423,7 @@ void CBookmarksToolbar::InsertBookmarkItems()
 {
 	/* The bookmarks toolbar folder should always be a direct child
 	of the root. */
-	auto variantBookmarksToolbar = NBookmarkHelper::GetBookmarkItem(m_AllBookmarks,m_guidBookmarksToolbar);
+	const auto &variantBookmarksToolbar = NBookmarkHelper::GetBookmarkItem(m_AllBookmarks,m_guidBookmarksToolbar);
 	assert(variantBookmarksToolbar.type() == typeid(CBookmarkFolder));
 	const CBookmarkFolder &BookmarksToolbarFolder = boost::get<CBookmarkFolder>(variantBookmarksToolbar);
 
@@ -536,14 +536,22 @@ void CBookmarksToolbar::OnBookmarkFolderRemoved(const GUID &guid)
 
 void CBookmarksToolbar::ModifyBookmarkItem(const GUID &guid,bool bFolder)
 {
+	/* Only items directly within the bookmarks toolbar folder
+	are shown, so there's no need to search the toolbar for
+	any other item. */
+	CBookmarkFolder *pParentBookmarkFolder = m_AllBookmarks.FindParent(guid);
+
+	if(pParentBookmarkFolder == NULL ||
+		!IsEqualGUID(pParentBookmarkFolder->GetGUID(),m_guidBookmarksToolbar))
+	{
+		return;
+	}
+
 	int iIndex = GetBookmarkItemIndex(guid);
 
 	if(iIndex != -1)
 	{
-		auto variantBookmarksToolbar = NBookmarkHelper::GetBookmarkItem(m_AllBookmarks,m_guidBookmarksToolbar);
-		CBookmarkFolder &BookmarksToolbarFolder = boost::get<CBookmarkFolder>(variantBookmarksToolbar);
-
-		auto variantBookmarkItem = NBookmarkHelper::GetBookmarkItem(BookmarksToolbarFolder,guid);
+		auto &variantBookmarkItem = NBookmarkHelper::GetBookmarkItem(*pParentBookmarkFolder,guid);
 
 		TCHAR szText[128];
 
@@ -882,7 +890,7 @@ HRESULT __stdcall CBookmarksToolbarDropHandler::Drop(IDataObject *pDataObject,
 
 					CBookmark Bookmark = CBookmark::Create(szDisplayName, szFullFileName, EMPTY_STRING);
 
-					auto variantBookmarksToolbar = NBookmarkHelper::GetBookmarkItem(m_AllBookmarks,m_guidBookmarksToolbar);
+					auto &variantBookmarksToolbar = NBookmarkHelper::GetBookmarkItem(m_AllBookmarks,m_guidBookmarksToolbar);
 					assert(variantBookmarksToolbar.type() == typeid(CBookmarkFolder));
 					CBookmarkFolder &BookmarksToolbarFolder = boost::get<CBookmarkFolder>(variantBookmarksToolbar);
 
@@ -67,6 +67,9 @@ struct Config
 		synchronizeTreeview = TRUE;
 		displayWindowHeight = DEFAULT_DISPLAYWINDOW_HEIGHT;
 		treeViewWidth = DEFAULT_TREEVIEW_WIDTH;
+		columnCacheSize = DEFAULT_COLUMN_CACHE_SIZE;
+		thumbnailCacheSize = DEFAULT_THUMBNAIL_CACHE_SIZE;
+		saveThumbnailCache = FALSE;
 
 		replaceExplorerMode = NDefaultFileManager::REPLACEEXPLORER_NONE;
 
@@ -122,6 +125,15 @@ struct Config
 	static const UINT DEFAULT_DISPLAYWINDOW_HEIGHT = 90;
 	static const UINT DEFAULT_TREEVIEW_WIDTH = 208;
 
+	/* The maximum size (in bytes) of the cache used to
+	store the values of expensive columns. */
+	static const DWORD DEFAULT_COLUMN_CACHE_SIZE = 16 * 1024 * 1024;
+
+	/* The maximum size (in bytes) of the cache used to
+	store extracted thumbnails. Each thumbnail takes up
+	roughly 56KB. */
+	static const DWORD DEFAULT_THUMBNAIL_CACHE_SIZE = 64 * 1024 * 1024;
+
 	DWORD language;
 	IconTheme iconTheme;
 	StartupMode_t startupMode;
@@ -157,6 +169,9 @@ struct Config
 	BOOL synchronizeTreeview;
 	LONG displayWindowHeight;
 	unsigned int treeViewWidth;
+	DWORD columnCacheSize;
+	DWORD thumbnailCacheSize;
+	BOOL saveThumbnailCache;
 
 	NDefaultFileManager::ReplaceExplorerModes_t replaceExplorerMode;
 
@@ -20,10 +20,15 @@ enum MousewheelSource_t
 };
 
 class CachedIcons;
+class ColorRuleMatcher;
+class ColumnCache;
 struct Config;
 class CShellBrowser;
+class FolderSizeCalculator;
 __interface IDirectoryMonitor;
 class TabContainer;
+class TaskScheduler;
+class ThumbnailCache;
 
 /* Basic interface between Explorerplusplus
 and some of the other components (such as the
@@ -43,6 +48,11 @@ __interface IExplorerplusplus
 
 	IconResourceLoader	*GetIconResourceLoader() const;
 	CachedIcons		*GetCachedIcons();
+	ColumnCache		*GetColumnCache();
+	ThumbnailCache	*GetThumbnailCache();
+	FolderSizeCalculator	*GetFolderSizeCalculator();
+	TaskScheduler	*GetTaskScheduler();
+	const ColorRuleMatcher	*GetColorRuleMatcher() const;
 
 	HWND			GetTreeView() const;
 
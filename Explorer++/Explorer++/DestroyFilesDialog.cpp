@@ -11,6 +11,15 @@
 #include "../Helper/RegistrySettings.h"
 #include "../Helper/StringHelper.h"
 #include "../Helper/XMLSettings.h"
+#include <thread>
+
+namespace NDestroyFilesDialog
+{
+	const int WM_APP_SETPROGRESS		= WM_APP + 1;
+	const int WM_APP_DESTROYFINISHED	= WM_APP + 2;
+
+	const int PROGRESS_RANGE			= 100;
+}
 
 const TCHAR CDestroyFilesDialogPersistentSettings::SETTINGS_KEY[] = _T("DestroyFiles");
 
@@ -19,7 +28,8 @@ const TCHAR CDestroyFilesDialogPersistentSettings::SETTING_OVERWRITE_METHOD[] =
 CDestroyFilesDialog::CDestroyFilesDialog(HINSTANCE hInstance,
 	int iResource,HWND hParent,std::list<std::wstring> FullFilenameList,
 	BOOL bShowFriendlyDates) :
-CBaseDialog(hInstance,iResource,hParent,true)
+CBaseDialog(hInstance,iResource,hParent,true),
+m_bDestroyingFiles(false)
 {
 	m_FullFilenameList = FullFilenameList;
 	m_bShowFriendlyDates = bShowFriendlyDates;
@@ -27,6 +37,14 @@ CBaseDialog(hInstance,iResource,hParent,true)
 	m_pdfdps = &CDestroyFilesDialogPersistentSettings::GetInstance();
 }
 
+CDestroyFilesDialog::~CDestroyFilesDialog()
+{
+	if(m_fileShredder)
+	{
+		m_fileShredder->Stop();
+	}
+}
+
 INT_PTR CDestroyFilesDialog::OnInitDialog()
 {
 	m_icon.reset(LoadIcon(GetModuleHandle(0),MAKEINTRESOURCE(IDI_MAIN)));
@@ -222,7 +240,24 @@ INT_PTR CDestroyFilesDialog::OnCommand(WPARAM wParam,LPARAM lParam)
 
 INT_PTR CDestroyFilesDialog::OnClose()
 {
-	EndDialog(m_hDlg,0);
+	OnCancel();
+	return 0;
+}
+
+INT_PTR CDestroyFilesDialog::OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
+{
+	switch(uMsg)
+	{
+	case NDestroyFilesDialog::WM_APP_SETPROGRESS:
+		OnProgress(static_cast<int>(wParam),static_cast<ULONGLONG>(lParam) * 1024);
+		break;
+
+	case NDestroyFilesDialog::WM_APP_DESTROYFINISHED:
+		m_bDestroyingFiles = false;
+		EndDialog(m_hDlg,1);
+		break;
+	}
+
 	return 0;
 }
 
@@ -244,6 +279,11 @@ void CDestroyFilesDialog::SaveState()
 
 void CDestroyFilesDialog::OnOk()
 {
+	if(m_bDestroyingFiles)
+	{
+		return;
+	}
+
 	TCHAR szConfirmation[128];
 	LoadString(GetInstance(),IDS_DESTROY_FILES_CONFIRMATION,
 		szConfirmation,SIZEOF_ARRAY(szConfirmation));
@@ -267,6 +307,16 @@ void CDestroyFilesDialog::OnOk()
 
 void CDestroyFilesDialog::OnCancel()
 {
+	/* Files that have already been destroyed can't be restored, so
+	the dialog will only be closed once the operation has
+	stopped. */
+	if(m_bDestroyingFiles)
+	{
+		m_fileShredder->Stop();
+		EnableWindow(GetDlgItem(m_hDlg,IDCANCEL),FALSE);
+		return;
+	}
+
 	EndDialog(m_hDlg,0);
 }
 
@@ -283,13 +333,65 @@ void CDestroyFilesDialog::OnConfirmDestroy()
 		OverwriteMethod = NFileOperations::OVERWRITE_THREEPASS;
 	}
 
-	/* TODO: Perform in background thread. */
+	/* Folders are skipped. */
+	std::vector<std::wstring> files;
+
 	for(const auto &strFullFilename : m_FullFilenameList)
 	{
-		DeleteFileSecurely(strFullFilename,OverwriteMethod);
+		DWORD dwAttributes = GetFileAttributes(strFullFilename.c_str());
+
+		if(dwAttributes != INVALID_FILE_ATTRIBUTES
+			&& (dwAttributes & FILE_ATTRIBUTE_DIRECTORY) != FILE_ATTRIBUTE_DIRECTORY)
+		{
+			files.push_back(strFullFilename);
+		}
 	}
 
-	EndDialog(m_hDlg,1);
+	m_fileShredder = std::make_shared<FileShredder>(NFileOperations::GetOverwritePasses(OverwriteMethod),
+		FileShredder::GetDefaultNumThreads());
+	m_bDestroyingFiles = true;
+
+	TCHAR szTitle[128];
+	GetWindowText(m_hDlg,szTitle,SIZEOF_ARRAY(szTitle));
+	m_strTitle = szTitle;
+
+	EnableWindow(GetDlgItem(m_hDlg,IDOK),FALSE);
+	EnableWindow(GetDlgItem(m_hDlg,IDC_DESTROYFILES_RADIO_ONEPASS),FALSE);
+	EnableWindow(GetDlgItem(m_hDlg,IDC_DESTROYFILES_RADIO_THREEPASS),FALSE);
+
+	HWND hDlg = m_hDlg;
+	std::shared_ptr<FileShredder> fileShredder = m_fileShredder;
+
+	std::thread([hDlg, fileShredder, files] {
+		fileShredder->Shred(files, [hDlg] (const FileShredder::Progress &progress) {
+			int iProgress = NDestroyFilesDialog::PROGRESS_RANGE;
+
+			if(progress.totalBytes != 0)
+			{
+				iProgress = static_cast<int>((progress.bytesWritten * NDestroyFilesDialog::PROGRESS_RANGE) / progress.totalBytes);
+			}
+
+			PostMessage(hDlg,NDestroyFilesDialog::WM_APP_SETPROGRESS,iProgress,
+				static_cast<LPARAM>(progress.bytesPerSecond / 1024));
+		});
+
+		PostMessage(hDlg,NDestroyFilesDialog::WM_APP_DESTROYFINISHED,0,0);
+	}).detach();
+}
+
+void CDestroyFilesDialog::OnProgress(int iProgress,ULONGLONG ullBytesPerSecond)
+{
+	/* The dialog has no progress control, so the progress and
+	current speed are shown in the title bar instead. */
+	TCHAR szSpeed[32];
+	ULARGE_INTEGER lSpeed = {};
+	lSpeed.QuadPart = ullBytesPerSecond;
+	FormatSizeString(lSpeed,szSpeed,SIZEOF_ARRAY(szSpeed));
+
+	TCHAR szTitle[256];
+	StringCchPrintf(szTitle,SIZEOF_ARRAY(szTitle),_T("%s - %d%% (%s/s)"),
+		m_strTitle.c_str(),iProgress,szSpeed);
+	SetWindowText(m_hDlg,szTitle);
 }
 
 CDestroyFilesDialogPersistentSettings::CDestroyFilesDialogPersistentSettings() :
@@ -8,7 +8,9 @@
 #include "../Helper/ResizableDialog.h"
 #include "../Helper/DialogSettings.h"
 #include "../Helper/FileOperations.h"
+#include "../Helper/FileShredder.h"
 #include <wil/resource.h>
+#include <memory>
 
 class CDestroyFilesDialog;
 
@@ -45,6 +47,7 @@ class CDestroyFilesDialog : public CBaseDialog
 public:
 
 	CDestroyFilesDialog(HINSTANCE hInstance,int iResource,HWND hParent,std::list<std::wstring> FullFilenameList,BOOL bShowFriendlyDates);
+	~CDestroyFilesDialog();
 
 protected:
 
@@ -52,6 +55,7 @@ protected:
 	INT_PTR	OnCtlColorStatic(HWND hwnd,HDC hdc);
 	INT_PTR	OnCommand(WPARAM wParam,LPARAM lParam);
 	INT_PTR	OnClose();
+	INT_PTR	OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lParam);
 
 private:
 
@@ -61,6 +65,7 @@ private:
 	void	OnOk();
 	void	OnCancel();
 	void	OnConfirmDestroy();
+	void	OnProgress(int iProgress,ULONGLONG ullBytesPerSecond);
 
 	std::list<std::wstring>	m_FullFilenameList;
 
@@ -69,4 +74,10 @@ private:
 	CDestroyFilesDialogPersistentSettings	*m_pdfdps;
 
 	BOOL	m_bShowFriendlyDates;
+
+	/* Shared with the thread that performs the operation, so that
+	it remains valid even if this dialog is destroyed first. */
+	std::shared_ptr<FileShredder>	m_fileShredder;
+	bool	m_bDestroyingFiles;
+	std::wstring	m_strTitle;
 };
\ No newline at end of file
@@ -121,6 +121,9 @@ void CDisplayColoursDialog::InitializePreviewWindow()
 	InitialSettings.hFont			= m_hDisplayFont;
 	InitialSettings.hIcon			= m_hDisplayWindowIcon;
 
+	/* The preview never shows a thumbnail. */
+	InitialSettings.taskScheduler	= NULL;
+
 	HWND hStatic = GetDlgItem(m_hDlg,IDC_STATIC_PREVIEWDISPLAY);
 	m_hPreviewDisplayWindow = CreateDisplayWindow(hStatic,&InitialSettings);
 
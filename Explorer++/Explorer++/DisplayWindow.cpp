@@ -8,10 +8,89 @@
 #include "MainResource.h"
 #include "../DisplayWindow/DisplayWindow.h"
 #include "../Helper/FolderSize.h"
+#include "../Helper/ImageHeader.h"
 #include "../Helper/ShellHelper.h"
 
+namespace
+{
+	UINT GetPixelFormatBitDepth(Gdiplus::PixelFormat format)
+	{
+		switch (format)
+		{
+		case PixelFormat1bppIndexed:
+			return 1;
+
+		case PixelFormat4bppIndexed:
+			return 4;
+
+		case PixelFormat8bppIndexed:
+			return 8;
+
+		case PixelFormat16bppARGB1555:
+		case PixelFormat16bppGrayScale:
+		case PixelFormat16bppRGB555:
+		case PixelFormat16bppRGB565:
+			return 16;
+
+		case PixelFormat24bppRGB:
+			return 24;
+
+		case PixelFormat32bppARGB:
+		case PixelFormat32bppPARGB:
+		case PixelFormat32bppRGB:
+			return 32;
+
+		case PixelFormat48bppRGB:
+			return 48;
+
+		case PixelFormat64bppARGB:
+		case PixelFormat64bppPARGB:
+			return 64;
+
+		default:
+			return 0;
+		}
+	}
+
+	// Runs on a background thread. Where possible, the properties are
+	// read directly from the image header. Other formats have to be
+	// loaded through GDI+.
+	boost::optional<ImageHeaderInfo> ReadImageInfo(const std::wstring &path)
+	{
+		ImageHeaderInfo info;
+
+		if (ReadImageHeader(path, info))
+		{
+			return info;
+		}
+
+		Gdiplus::Image image(path.c_str(), FALSE);
+
+		if (image.GetLastStatus() != Gdiplus::Ok)
+		{
+			return boost::none;
+		}
+
+		info.width = image.GetWidth();
+		info.height = image.GetHeight();
+		info.bitDepth = GetPixelFormatBitDepth(image.GetPixelFormat());
+		info.horizontalResolution = image.GetHorizontalResolution();
+		info.verticalResolution = image.GetVerticalResolution();
+
+		return info;
+	}
+}
+
 void Explorerplusplus::UpdateDisplayWindow(const Tab &tab)
 {
+	/* This update supersedes any that's pending. */
+	KillTimer(m_hContainer, DISPLAY_WINDOW_UPDATE_TIMER_ID);
+
+	/* Any image properties that are still being read
+	are for the previous selection. */
+	m_displayWindowUpdateId++;
+	m_displayWindowQueue->Cancel();
+
 	DisplayWindow_ClearTextBuffer(m_hDisplayWindow);
 
 	int nSelected = tab.GetShellBrowser()->GetNumSelected();
@@ -30,6 +109,15 @@ void Explorerplusplus::UpdateDisplayWindow(const Tab &tab)
 	}
 }
 
+/* Selection changes can arrive in quick succession (e.g. while
+the arrow keys are held down). Rather than the display window
+being updated for each change, it's only updated once the
+selection has settled. */
+void Explorerplusplus::ScheduleDisplayWindowUpdate()
+{
+	SetTimer(m_hContainer, DISPLAY_WINDOW_UPDATE_TIMER_ID, DISPLAY_WINDOW_UPDATE_DELAY, nullptr);
+}
+
 void Explorerplusplus::UpdateDisplayWindowForZeroFiles(const Tab &tab)
 {
 	/* Clear out any previous data shown in the display window. */
@@ -117,59 +205,43 @@ void Explorerplusplus::UpdateDisplayWindowForOneFile(const Tab &tab)
 
 			wfd = tab.GetShellBrowser()->GetItemFileFindData(iSelected);
 
-			dwAttributes = GetFileAttributes(szFullItemName);
+			dwAttributes = wfd.dwFileAttributes;
 
 			if (((dwAttributes & FILE_ATTRIBUTE_DIRECTORY) ==
 				FILE_ATTRIBUTE_DIRECTORY) && m_config->globalFolderSettings.showFolderSizes)
 			{
-				FolderSize_t	*pfs = NULL;
-				FolderSizeExtraInfo_t	*pfsei = NULL;
 				DWFolderSize_t	DWFolderSize;
 				TCHAR			szDisplayText[256];
 				TCHAR			szTotalSize[64];
 				TCHAR			szCalculating[64];
-				DWORD			ThreadId;
-
-				pfs = (FolderSize_t *)malloc(sizeof(FolderSize_t));
 
-				if (pfs != NULL)
-				{
-					pfsei = (FolderSizeExtraInfo_t *)malloc(sizeof(FolderSizeExtraInfo_t));
-
-					if (pfsei != NULL)
-					{
-						pfsei->pContainer = (void *)this;
-						pfsei->uId = m_iDWFolderSizeUniqueId;
-						pfs->pData = (LPVOID)pfsei;
-
-						pfs->pfnCallback = FolderSizeCallbackStub;
-
-						StringCchCopy(pfs->szPath, SIZEOF_ARRAY(pfs->szPath), szFullItemName);
-
-						LoadString(m_hLanguageModule, IDS_GENERAL_TOTALSIZE,
-							szTotalSize, SIZEOF_ARRAY(szTotalSize));
-						LoadString(m_hLanguageModule, IDS_GENERAL_CALCULATING,
-							szCalculating, SIZEOF_ARRAY(szCalculating));
-						StringCchPrintf(szDisplayText, SIZEOF_ARRAY(szDisplayText),
-							_T("%s: %s"), szTotalSize, szCalculating);
-						DisplayWindow_BufferText(m_hDisplayWindow, szDisplayText);
-
-						/* Maintain a global list of folder size operations. */
-						DWFolderSize.uId = m_iDWFolderSizeUniqueId;
-						DWFolderSize.iTabId = m_tabContainer->GetSelectedTab().GetId();
-						DWFolderSize.bValid = TRUE;
-						m_DWFolderSizes.push_back(DWFolderSize);
-
-						HANDLE hThread = CreateThread(NULL, 0, Thread_CalculateFolderSize, (LPVOID)pfs, 0, &ThreadId);
-						CloseHandle(hThread);
-
-						m_iDWFolderSizeUniqueId++;
-					}
-					else
-					{
-						free(pfs);
-					}
-				}
+				LoadString(m_hLanguageModule, IDS_GENERAL_TOTALSIZE,
+					szTotalSize, SIZEOF_ARRAY(szTotalSize));
+				LoadString(m_hLanguageModule, IDS_GENERAL_CALCULATING,
+					szCalculating, SIZEOF_ARRAY(szCalculating));
+				StringCchPrintf(szDisplayText, SIZEOF_ARRAY(szDisplayText),
+					_T("%s: %s"), szTotalSize, szCalculating);
+				DisplayWindow_BufferText(m_hDisplayWindow, szDisplayText);
+
+				int uId = m_iDWFolderSizeUniqueId++;
+
+				/* Partial totals are shown while the calculation
+				is in progress, so that the size of a large folder
+				can be seen to be increasing. */
+				int calculationId = m_folderSizeCalculator.StartCalculation(szFullItemName,
+					[this, uId] (const FolderSizeCalculator::Totals &partialTotals) {
+					PostFolderSizeResult(uId, partialTotals, FALSE, FALSE);
+				},
+					[this, uId] (const FolderSizeCalculator::Totals &totals, bool cancelled) {
+					PostFolderSizeResult(uId, totals, TRUE, cancelled);
+				});
+
+				/* Maintain a global list of folder size operations. */
+				DWFolderSize.uId = uId;
+				DWFolderSize.iTabId = m_tabContainer->GetSelectedTab().GetId();
+				DWFolderSize.bValid = TRUE;
+				DWFolderSize.calculationId = calculationId;
+				m_DWFolderSizes.push_back(DWFolderSize);
 			}
 			else
 			{
@@ -195,103 +267,23 @@ void Explorerplusplus::UpdateDisplayWindowForOneFile(const Tab &tab)
 
 			if (IsImage(szFullItemName))
 			{
-				TCHAR szOutput[256];
-				TCHAR szTemp[64];
-				UINT uWidth;
-				UINT uHeight;
-				Gdiplus::Image *pimg = NULL;
+				ULARGE_INTEGER lastWriteTime = { wfd.ftLastWriteTime.dwLowDateTime, wfd.ftLastWriteTime.dwHighDateTime };
+				ULARGE_INTEGER fileSize = { wfd.nFileSizeLow, wfd.nFileSizeHigh };
 
-				pimg = new Gdiplus::Image(szFullItemName, FALSE);
+				auto cachedImageInfo = m_imageInfoCache.Get(szFullItemName);
 
-				if (pimg->GetLastStatus() == Gdiplus::Ok)
+				if (cachedImageInfo && cachedImageInfo->lastWriteTime == lastWriteTime.QuadPart
+					&& cachedImageInfo->fileSize == fileSize.QuadPart)
 				{
-					uWidth = pimg->GetWidth();
-					LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_IMAGEWIDTH, szTemp, SIZEOF_ARRAY(szTemp));
-					StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, uWidth);
-					DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
-
-					uHeight = pimg->GetHeight();
-					LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_IMAGEHEIGHT, szTemp, SIZEOF_ARRAY(szTemp));
-					StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, uHeight);
-					DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
-
-					Gdiplus::PixelFormat format;
-					UINT uBitDepth;
-
-					format = pimg->GetPixelFormat();
-
-					switch (format)
-					{
-					case PixelFormat1bppIndexed:
-						uBitDepth = 1;
-						break;
-
-					case PixelFormat4bppIndexed:
-						uBitDepth = 4;
-						break;
-
-					case PixelFormat8bppIndexed:
-						uBitDepth = 8;
-						break;
-
-					case PixelFormat16bppARGB1555:
-					case PixelFormat16bppGrayScale:
-					case PixelFormat16bppRGB555:
-					case PixelFormat16bppRGB565:
-						uBitDepth = 16;
-						break;
-
-					case PixelFormat24bppRGB:
-						uBitDepth = 24;
-						break;
-
-					case PixelFormat32bppARGB:
-					case PixelFormat32bppPARGB:
-					case PixelFormat32bppRGB:
-						uBitDepth = 32;
-						break;
-
-					case PixelFormat48bppRGB:
-						uBitDepth = 48;
-						break;
-
-					case PixelFormat64bppARGB:
-					case PixelFormat64bppPARGB:
-						uBitDepth = 64;
-						break;
-
-					default:
-						uBitDepth = 0;
-						break;
-					}
-
-					if (uBitDepth == 0)
-					{
-						LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_BITDEPTHUNKNOWN, szTemp, SIZEOF_ARRAY(szTemp));
-						StringCchCopy(szOutput, SIZEOF_ARRAY(szOutput), szTemp);
-					}
-					else
+					if (cachedImageInfo->info)
 					{
-						LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_BITDEPTH, szTemp, SIZEOF_ARRAY(szTemp));
-						StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, uBitDepth);
+						ShowImageInfo(*cachedImageInfo->info);
 					}
-
-					DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
-
-					Gdiplus::REAL res;
-
-					res = pimg->GetHorizontalResolution();
-					LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_HORIZONTALRESOLUTION, szTemp, SIZEOF_ARRAY(szTemp));
-					StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, res);
-					DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
-
-					res = pimg->GetVerticalResolution();
-					LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_VERTICALRESOLUTION, szTemp, SIZEOF_ARRAY(szTemp));
-					StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, res);
-					DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
 				}
-
-				delete pimg;
+				else
+				{
+					QueueImageInfoRetrieval(szFullItemName, lastWriteTime.QuadPart, fileSize.QuadPart);
+				}
 			}
 
 			/* Only attempt to show file previews for files (not folders). Also, only
@@ -347,6 +339,91 @@ void Explorerplusplus::UpdateDisplayWindowForOneFile(const Tab &tab)
 	}
 }
 
+void Explorerplusplus::ShowImageInfo(const ImageHeaderInfo &info)
+{
+	TCHAR szOutput[256];
+	TCHAR szTemp[64];
+
+	LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_IMAGEWIDTH, szTemp, SIZEOF_ARRAY(szTemp));
+	StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, info.width);
+	DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
+
+	LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_IMAGEHEIGHT, szTemp, SIZEOF_ARRAY(szTemp));
+	StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, info.height);
+	DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
+
+	if (info.bitDepth == 0)
+	{
+		LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_BITDEPTHUNKNOWN, szTemp, SIZEOF_ARRAY(szTemp));
+		StringCchCopy(szOutput, SIZEOF_ARRAY(szOutput), szTemp);
+	}
+	else
+	{
+		LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_BITDEPTH, szTemp, SIZEOF_ARRAY(szTemp));
+		StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, info.bitDepth);
+	}
+
+	DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
+
+	/* Not every image specifies a resolution. */
+	if (info.horizontalResolution && info.verticalResolution)
+	{
+		LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_HORIZONTALRESOLUTION, szTemp, SIZEOF_ARRAY(szTemp));
+		StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, *info.horizontalResolution);
+		DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
+
+		LoadString(m_hLanguageModule, IDS_GENERAL_DISPLAYWINDOW_VERTICALRESOLUTION, szTemp, SIZEOF_ARRAY(szTemp));
+		StringCchPrintf(szOutput, SIZEOF_ARRAY(szOutput), szTemp, *info.verticalResolution);
+		DisplayWindow_BufferText(m_hDisplayWindow, szOutput);
+	}
+}
+
+void Explorerplusplus::QueueImageInfoRetrieval(const std::wstring &path, ULONGLONG lastWriteTime,
+	ULONGLONG fileSize)
+{
+	m_displayWindowQueue->Push(TaskScheduler::TaskPriority::Visible,
+		[hwnd = m_hContainer, updateId = m_displayWindowUpdateId, path, lastWriteTime, fileSize] {
+		auto result = std::make_unique<ImageInfoResult>();
+		result->path = path;
+		result->cachedImageInfo.lastWriteTime = lastWriteTime;
+		result->cachedImageInfo.fileSize = fileSize;
+		result->cachedImageInfo.info = ReadImageInfo(path);
+
+		BOOL res = PostMessage(hwnd, WM_APP_IMAGEINFORETRIEVED, static_cast<WPARAM>(updateId),
+			reinterpret_cast<LPARAM>(result.get()));
+
+		/* The message won't be delivered if the main window has
+		already been destroyed. */
+		if (res)
+		{
+			result.release();
+		}
+	});
+}
+
+void Explorerplusplus::OnImageInfoRetrieved(int updateId, ImageInfoResult *result)
+{
+	std::unique_ptr<ImageInfoResult> ownedResult(result);
+
+	/* The properties are cached even if the selection has
+	changed, since the file is likely to be selected again
+	(e.g. when moving back and forth through a set of
+	images). */
+	m_imageInfoCache.Set(ownedResult->path, ownedResult->cachedImageInfo);
+
+	if (updateId != m_displayWindowUpdateId)
+	{
+		return;
+	}
+
+	/* The image properties are the last lines shown for a
+	file, so they can simply be appended. */
+	if (ownedResult->cachedImageInfo.info)
+	{
+		ShowImageInfo(*ownedResult->cachedImageInfo.info);
+	}
+}
+
 void Explorerplusplus::UpdateDisplayWindowForMultipleFiles(const Tab &tab)
 {
 	TCHAR			szNumSelected[64] = EMPTY_STRING;
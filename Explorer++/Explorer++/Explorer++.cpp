@@ -34,10 +34,15 @@ const std::vector<std::wstring> Explorerplusplus::BLACKLISTED_BACKGROUND_MENU_CL
 
 Explorerplusplus::Explorerplusplus(HWND hwnd) :
 	m_hContainer(hwnd),
+	m_taskScheduler(TaskScheduler::GetDefaultNumThreads()),
 	m_cachedIcons(MAX_CACHED_ICONS),
+	m_folderSizeCalculator(FolderSizeCalculator::GetDefaultNumThreads()),
 	m_pluginMenuManager(hwnd, MENU_PLUGIN_STARTID, MENU_PLUGIN_ENDID),
 	m_acceleratorUpdater(&g_hAccl),
-	m_pluginCommandManager(&g_hAccl, ACCELERATOR_PLUGIN_STARTID, ACCELERATOR_PLUGIN_ENDID)
+	m_pluginCommandManager(&g_hAccl, ACCELERATOR_PLUGIN_STARTID, ACCELERATOR_PLUGIN_ENDID),
+	m_displayWindowQueue(m_taskScheduler.CreateQueue()),
+	m_displayWindowUpdateId(0),
+	m_imageInfoCache(MAX_CACHED_IMAGE_INFO)
 {
 	m_hLanguageModule				= nullptr;
 
@@ -80,6 +85,7 @@ Explorerplusplus::Explorerplusplus(HWND hwnd) :
 	m_ColorRules = NColorRuleHelper::GetDefaultColorRules();
 
 	m_iDWFolderSizeUniqueId = 0;
+	m_displayWindowQueue->SetActive(true);
 
 	m_pClipboardDataObject	= NULL;
 	m_iCutTabInternal		= 0;
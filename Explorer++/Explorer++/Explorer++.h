@@ -9,6 +9,8 @@
 #include "PluginCommandManager.h"
 #include "PluginInterface.h"
 #include "PluginMenuManager.h"
+#include "ShellBrowser/ColumnCache.h"
+#include "ShellBrowser/ThumbnailCache.h"
 #include "ShellBrowser/ShellBrowser.h"
 #include "ShellBrowser/SortModes.h"
 #include "ShellBrowser/ViewModes.h"
@@ -19,9 +21,14 @@
 #include "UiTheming.h"
 #include "ValueWrapper.h"
 #include "../Helper/CachedIcons.h"
+#include "../Helper/ColorRuleMatcher.h"
 #include "../Helper/DpiCompatibility.h"
 #include "../Helper/FileActionHandler.h"
 #include "../Helper/FileContextMenuManager.h"
+#include "../Helper/FolderSize.h"
+#include "../Helper/ImageHeader.h"
+#include "../Helper/LRUCache.h"
+#include "../Helper/TaskScheduler.h"
 #include <boost/optional.hpp>
 #include <boost/signals2.hpp>
 #include <wil/resource.h>
@@ -30,6 +37,10 @@
 /* Sent when a folder size calculation has finished. */
 #define WM_APP_FOLDERSIZECOMPLETED	WM_APP + 3
 
+/* Sent when the properties of an image shown in the
+display window have been read. */
+#define WM_APP_IMAGEINFORETRIEVED	WM_APP + 4
+
 /* Private definitions. */
 #define FROM_LISTVIEW				0
 #define FROM_TREEVIEW				1
@@ -113,6 +124,15 @@ private:
 	static const UINT_PTR AUTOSAVE_TIMER_ID = 100000;
 	static const UINT AUTOSAVE_TIMEOUT = 30000;
 
+	/* The display window is only updated once the selection
+	has stopped changing for this long. */
+	static const UINT_PTR DISPLAY_WINDOW_UPDATE_TIMER_ID = 100001;
+	static const UINT DISPLAY_WINDOW_UPDATE_DELAY = 100;
+
+	// The number of files whose image properties are kept for the
+	// display window.
+	static const int MAX_CACHED_IMAGE_INFO = 100;
+
 	// Represents the maximum number of icons that can be cached. This cache is
 	// shared between various components in the application.
 	static const int MAX_CACHED_ICONS = 1000;
@@ -139,7 +159,11 @@ private:
 	{
 		ULARGE_INTEGER	liFolderSize;
 		int				uId;
-		int				iTabId;
+
+		/* Set once the calculation has finished. Otherwise,
+		the size is a partial total. */
+		BOOL			bFinal;
+		BOOL			bCancelled;
 	};
 
 	struct DWFolderSize_t
@@ -147,12 +171,24 @@ private:
 		int	uId;
 		int	iTabId;
 		BOOL bValid;
+		int	calculationId;
+	};
+
+	/* The properties of an image, as shown in the display
+	window. These are only used while the file's size and
+	last write time remain the same. info is empty if the
+	file couldn't be read as an image. */
+	struct CachedImageInfo
+	{
+		ULONGLONG	lastWriteTime;
+		ULONGLONG	fileSize;
+		boost::optional<ImageHeaderInfo>	info;
 	};
 
-	struct FolderSizeExtraInfo_t
+	struct ImageInfoResult
 	{
-		void	*pContainer;
-		int		uId;
+		std::wstring	path;
+		CachedImageInfo	cachedImageInfo;
 	};
 
 	LRESULT CALLBACK		WindowProcedure(HWND hwnd,UINT Msg,WPARAM wParam,LPARAM lParam);
@@ -189,6 +225,7 @@ private:
 	void					OnNdwRClick(POINT *pt);
 	void					OnNdwIconRClick(POINT *pt);
 	LRESULT					OnCustomDraw(LPARAM lParam);
+	void					UpdateColorRuleMatcher();
 	void					OnSelectTabByIndex(int iTab);
 
 	/* Main menu handlers. */
@@ -346,6 +383,12 @@ private:
 	void					ApplyToolbarSettings(void);
 	void					TestConfigFile(void);
 	void					InitializeBookmarks(void);
+	void					LoadColumnCache();
+	void					SaveColumnCache() const;
+	static std::wstring		GetColumnCacheFilePath();
+	void					LoadThumbnailCache();
+	void					SaveThumbnailCache() const;
+	static std::wstring		GetThumbnailCacheFilePath();
 
 	/* Registry settings. */
 	LONG					LoadGenericSettingsFromRegistry();
@@ -452,6 +495,10 @@ private:
 	void					UpdateDisplayWindowForZeroFiles(const Tab &tab);
 	void					UpdateDisplayWindowForOneFile(const Tab &tab);
 	void					UpdateDisplayWindowForMultipleFiles(const Tab &tab);
+	void					ScheduleDisplayWindowUpdate();
+	void					ShowImageInfo(const ImageHeaderInfo &info);
+	void					QueueImageInfoRetrieval(const std::wstring &path, ULONGLONG lastWriteTime, ULONGLONG fileSize);
+	void					OnImageInfoRetrieved(int updateId, ImageInfoResult *result);
 
 	/* Columns. */
 	void					CopyColumnInfoToClipboard(void);
@@ -474,6 +521,11 @@ private:
 	IDirectoryMonitor		*GetDirectoryMonitor() const;
 	IconResourceLoader		*GetIconResourceLoader() const;
 	CachedIcons				*GetCachedIcons();
+	ColumnCache				*GetColumnCache();
+	ThumbnailCache			*GetThumbnailCache();
+	FolderSizeCalculator	*GetFolderSizeCalculator();
+	TaskScheduler			*GetTaskScheduler();
+	const ColorRuleMatcher	*GetColorRuleMatcher() const;
 	BOOL					GetSavePreferencesToXmlFile() const;
 	void					SetSavePreferencesToXmlFile(BOOL savePreferencesToXmlFile);
 
@@ -497,8 +549,7 @@ private:
 	void					HandleDirectoryMonitoring(int iTabId);
 	int						DetermineListViewObjectIndex(HWND hListView);
 
-	static void				FolderSizeCallbackStub(int nFolders, int nFiles, PULARGE_INTEGER lTotalFolderSize, LPVOID pData);
-	void					FolderSizeCallback(FolderSizeExtraInfo_t *pfsei,int nFolders,int nFiles,PULARGE_INTEGER lTotalFolderSize);
+	void					PostFolderSizeResult(int uId, const FolderSizeCalculator::Totals &totals, BOOL bFinal, BOOL bCancelled);
 
 	HWND					m_hContainer;
 	HWND					m_hStatusBar;
@@ -543,7 +594,14 @@ private:
 	std::unique_ptr<IconResourceLoader>	m_iconResourceLoader;
 	DpiCompatibility		m_dpiCompat;
 
+	/* Must be declared before any of the objects that queue
+	tasks on it, so that it's destroyed after them. */
+	TaskScheduler			m_taskScheduler;
+
 	CachedIcons				m_cachedIcons;
+	std::unique_ptr<ColumnCache>	m_columnCache;
+	std::unique_ptr<ThumbnailCache>	m_thumbnailCache;
+	FolderSizeCalculator	m_folderSizeCalculator;
 
 	MainMenuPreShowSignal	m_mainMenuPreShowSignal;
 
@@ -584,6 +642,10 @@ private:
 	/* Customize colors. */
 	std::vector<NColorRuleHelper::ColorRule_t>	m_ColorRules;
 
+	/* Built from m_ColorRules. Must be rebuilt (by calling
+	UpdateColorRuleMatcher()) whenever the rules change. */
+	ColorRuleMatcher		m_colorRuleMatcher;
+
 	/* Undo support. */
 	CFileActionHandler		m_FileActionHandler;
 
@@ -597,6 +659,14 @@ private:
 	std::list<DWFolderSize_t>	m_DWFolderSizes;
 	int						m_iDWFolderSizeUniqueId;
 
+	/* Display window image properties. Each update of the
+	display window has its own id. Image properties are read
+	in the background and only shown if no further update
+	has occurred in the meantime. */
+	std::unique_ptr<TaskScheduler::Queue>	m_displayWindowQueue;
+	int						m_displayWindowUpdateId;
+	LRUCache<std::wstring, CachedImageInfo>	m_imageInfoCache;
+
 	/* ListView selection. */
 	BOOL					m_bCountingUp;
 	BOOL					m_bCountingDown;
@@ -23,6 +23,15 @@ namespace NExplorerplusplus
 
 	const TCHAR LOG_FILENAME[]		= _T("Explorer++.log");
 
+	/* The file the column cache is saved to. Stored in
+	the same directory as the executable. */
+	const TCHAR COLUMN_CACHE_FILENAME[]	= _T("columncache.dat");
+
+	/* The file the thumbnail cache is saved to (if
+	enabled). Also stored in the same directory as the
+	executable. */
+	const TCHAR THUMBNAIL_CACHE_FILENAME[]	= _T("thumbnailcache.dat");
+
 	/* Command line arguments supplied to the program
 	for each jump list task. */
 	const TCHAR JUMPLIST_TASK_NEWTAB_ARGUMENT[]	= _T("--open-new-tab");
@@ -40,6 +40,12 @@ void Explorerplusplus::OnCreate()
 	LoadAllSettings(&pLoadSave);
 	ApplyToolbarSettings();
 
+	LoadColumnCache();
+	LoadThumbnailCache();
+
+	/* Needs to be done before any tabs are created. */
+	UpdateColorRuleMatcher();
+
 	m_iconResourceLoader = std::make_unique<IconResourceLoader>(m_config->iconTheme);
 
 	SetLanguageModule();
@@ -121,15 +127,15 @@ void Explorerplusplus::InitializeBookmarks(void)
 	
 	std::wstring strKey = L"Software\\Explorer++\\Bookmarks\\BookmarkFolder_0";
     	CBookmarkFolder bfBookmarksToolbar = CBookmarkFolder::UnserializeFromRegistry(strKey);
-	m_bfAllBookmarks->InsertBookmarkFolder(bfBookmarksToolbar);
     	m_guidBookmarksToolbar = bfBookmarksToolbar.GetGUID();
+	m_bfAllBookmarks->InsertBookmarkFolder(std::move(bfBookmarksToolbar));
 
 	GUID MenuGuid;
 	UuidFromString(reinterpret_cast<RPC_WSTR>(NBookmarkHelper::MENU_GUID),&MenuGuid);
 	LoadString(m_hLanguageModule,IDS_BOOKMARKS_BOOKMARKSMENU,szTemp,SIZEOF_ARRAY(szTemp));
 	CBookmarkFolder bfBookmarksMenu = CBookmarkFolder::Create(szTemp,MenuGuid);
-	m_bfAllBookmarks->InsertBookmarkFolder(bfBookmarksMenu);
 	m_guidBookmarksMenu = bfBookmarksMenu.GetGUID();
+	m_bfAllBookmarks->InsertBookmarkFolder(std::move(bfBookmarksMenu));
 }
 
 void Explorerplusplus::InitializeDisplayWindow()
@@ -142,6 +148,7 @@ void Explorerplusplus::InitializeDisplayWindow()
 	InitialSettings.hIcon			= (HICON)LoadImage(GetModuleHandle(0),
 		MAKEINTRESOURCE(IDI_DISPLAYWINDOW),IMAGE_ICON,
 		0,0,LR_CREATEDIBSECTION);
+	InitialSettings.taskScheduler	= &m_taskScheduler;
 
 	m_hDisplayWindow = CreateDisplayWindow(m_hContainer,&InitialSettings);
 }
@@ -6,6 +6,7 @@
 #include "Explorer++.h"
 #include "Config.h"
 #include "Explorer++_internal.h"
+#include "FileProgressSink.h"
 #include "IDropFilesCallback.h"
 #include "iServiceProvider.h"
 #include "ListViewEdit.h"
@@ -501,14 +502,16 @@ void Explorerplusplus::OnListViewItemChanged(LPARAM lParam)
 	/* The selection for this tab has changed, so invalidate any
 	folder size calculations that are occurring for this tab
 	(applies only to folder sizes that will be shown in the display
-	window). */
+	window). The calculations themselves are cancelled, since their
+	results are no longer needed. */
 	std::list<DWFolderSize_t>::iterator itr;
 
 	for(itr = m_DWFolderSizes.begin();itr != m_DWFolderSizes.end();itr++)
 	{
-		if(itr->iTabId == iObjectIndex)
+		if(itr->iTabId == iObjectIndex && itr->bValid)
 		{
 			itr->bValid = FALSE;
+			m_folderSizeCalculator.CancelCalculation(itr->calculationId);
 		}
 	}
 
@@ -542,7 +545,7 @@ void Explorerplusplus::OnListViewItemChanged(LPARAM lParam)
 	if(m_bCountingUp || m_bCountingDown || m_bInverted)
 		return;
 
-	UpdateDisplayWindow(tab);
+	ScheduleDisplayWindowUpdate();
 	UpdateStatusBarText(tab);
 	m_mainToolbar->UpdateToolbarButtonStates();
 }
@@ -1436,11 +1439,15 @@ void Explorerplusplus::OnListViewPaste(void)
 		/* Also, the string must be double NULL terminated. */
 		szDestination[lstrlen(szDestination) + 1] = '\0';
 
+		FileProgressSink *progressSink = FileProgressSink::CreateNew();
+
 		CDropHandler *pDropHandler = CDropHandler::CreateNew();
+		pDropHandler->SetProgressSink(progressSink);
 		CDropFilesCallback *DropFilesCallback = new CDropFilesCallback(this);
 		pDropHandler->CopyClipboardData(pClipboardObject,m_hContainer,szDestination,
 			DropFilesCallback,!m_config->overwriteExistingFilesConfirmation);
 		pDropHandler->Release();
+		progressSink->Release();
 
 		pClipboardObject->Release();
 	}
@@ -25,6 +25,7 @@
 #include "../Helper/ListViewHelper.h"
 #include "../Helper/ProcessHelper.h"
 #include "../Helper/ShellHelper.h"
+#include <boost/range/adaptor/map.hpp>
 #include <boost/scope_exit.hpp>
 #include <wil/com.h>
 
@@ -122,9 +123,14 @@ void Explorerplusplus::OnCustomizeColors()
 	CCustomizeColorsDialog CustomizeColorsDialog(m_hLanguageModule, IDD_CUSTOMIZECOLORS, m_hContainer, this, &m_ColorRules);
 	CustomizeColorsDialog.ShowModalDialog();
 
-	/* Causes the active listview to redraw (therefore
-	applying any updated color schemes). */
-	InvalidateRect(m_hActiveListView, NULL, FALSE);
+	/* The rules are edited in place, so the color of each
+	item is simply recalculated once the dialog has closed. */
+	UpdateColorRuleMatcher();
+
+	for (auto &tab : m_tabContainer->GetAllTabs() | boost::adaptors::map_values)
+	{
+		tab->GetShellBrowser()->UpdateItemColors();
+	}
 }
 
 void Explorerplusplus::OnRunScript()
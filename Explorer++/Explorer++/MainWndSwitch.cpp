@@ -107,6 +107,10 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 		{
 			SaveAllSettings();
 		}
+		else if (wParam == DISPLAY_WINDOW_UPDATE_TIMER_ID)
+		{
+			UpdateDisplayWindow(m_tabContainer->GetSelectedTab());
+		}
 		break;
 
 	case WM_USER_UPDATEWINDOWS:
@@ -161,8 +165,9 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 		{
 			DWFolderSizeCompletion_t *pDWFolderSizeCompletion = NULL;
 			TCHAR szFolderSize[32];
-			TCHAR szSizeString[64];
+			TCHAR szSizeString[128];
 			TCHAR szTotalSize[64];
+			TCHAR szCalculating[64];
 			BOOL bValid = FALSE;
 
 			pDWFolderSizeCompletion = (DWFolderSizeCompletion_t *)wParam;
@@ -182,13 +187,19 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 						bValid = itr->bValid;
 					}
 
-					m_DWFolderSizes.erase(itr);
+					/* Partial results are followed by further
+					updates, so the entry is only removed once the
+					calculation has finished. */
+					if(pDWFolderSizeCompletion->bFinal)
+					{
+						m_DWFolderSizes.erase(itr);
+					}
 
 					break;
 				}
 			}
 
-			if(bValid)
+			if(bValid && !pDWFolderSizeCompletion->bCancelled)
 			{
 				FormatSizeString(pDWFolderSizeCompletion->liFolderSize,szFolderSize,
 					SIZEOF_ARRAY(szFolderSize),m_config->globalFolderSettings.forceSize,
@@ -197,8 +208,19 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 				LoadString(m_hLanguageModule,IDS_GENERAL_TOTALSIZE,
 					szTotalSize,SIZEOF_ARRAY(szTotalSize));
 
-				StringCchPrintf(szSizeString,SIZEOF_ARRAY(szSizeString),
-					_T("%s: %s"),szTotalSize,szFolderSize);
+				if(pDWFolderSizeCompletion->bFinal)
+				{
+					StringCchPrintf(szSizeString,SIZEOF_ARRAY(szSizeString),
+						_T("%s: %s"),szTotalSize,szFolderSize);
+				}
+				else
+				{
+					LoadString(m_hLanguageModule,IDS_GENERAL_CALCULATING,
+						szCalculating,SIZEOF_ARRAY(szCalculating));
+
+					StringCchPrintf(szSizeString,SIZEOF_ARRAY(szSizeString),
+						_T("%s: %s (%s)"),szTotalSize,szFolderSize,szCalculating);
+				}
 
 				/* TODO: The line index should be stored in some other (variable) way. */
 				DisplayWindow_SetLine(m_hDisplayWindow,FOLDER_SIZE_LINE_INDEX,szSizeString);
@@ -208,6 +230,10 @@ LRESULT CALLBACK Explorerplusplus::WindowProcedure(HWND hwnd,UINT Msg,WPARAM wPa
 		}
 		break;
 
+	case WM_APP_IMAGEINFORETRIEVED:
+		OnImageInfoRetrieved(static_cast<int>(wParam), reinterpret_cast<ImageInfoResult *>(lParam));
+		break;
+
 	case WM_COPYDATA:
 		{
 			COPYDATASTRUCT *pcds = reinterpret_cast<COPYDATASTRUCT *>(lParam);
@@ -403,7 +403,7 @@ void CManageBookmarksDialog::OnNewFolder()
 
 	CBookmarkFolder &ParentBookmarkFolder = m_pBookmarkTreeView->GetBookmarkFolderFromTreeView(
 		hSelectedItem);
-	ParentBookmarkFolder.InsertBookmarkFolder(NewBookmarkFolder);
+	ParentBookmarkFolder.InsertBookmarkFolder(std::move(NewBookmarkFolder));
 }
 
 void CManageBookmarksDialog::OnDeleteBookmark(const GUID &guid)
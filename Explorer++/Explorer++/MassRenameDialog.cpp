@@ -4,13 +4,12 @@
 
 /*
  * Provides support for the mass renaming of files.
- * The following special characters are supported:
- * /N	- Counter
- * /F	- Filename
- * /B	- Basename (filename without extension)
- * /E	- Extension
- * /L	- Lowercase filename
- * /U	- Uppercase filename
+ * See MassRenameTemplate.h for the special characters
+ * that are supported.
+ *
+ * The preview is generated in the background, so that
+ * typing into the pattern box stays responsive even
+ * when a large number of files have been selected.
  */
 
 #include "stdafx.h"
@@ -21,11 +20,21 @@
 #include "ResourceHelper.h"
 #include "../Helper/Macros.h"
 #include "../Helper/RegistrySettings.h"
+#include "../Helper/WindowHelper.h"
 #include "../Helper/XMLSettings.h"
-#include <boost/algorithm/string.hpp>
-#include <iomanip>
+#include <algorithm>
 #include <list>
-#include <regex>
+
+namespace NMassRenameDialog
+{
+	const int WM_APP_PREVIEW_READY = WM_APP + 1;
+
+	const COLORREF COLLISION_TEXT_COLOR = RGB(255, 0, 0);
+
+	// The number of names generated between each check to see whether
+	// the preview has been cancelled.
+	const std::size_t CANCELLATION_CHECK_INTERVAL = 256;
+}
 
 const TCHAR CMassRenameDialogPersistentSettings::SETTINGS_KEY[] = _T("MassRename");
 
@@ -37,10 +46,35 @@ CMassRenameDialog::CMassRenameDialog(HINSTANCE hInstance, int iResource, HWND hP
 	CFileActionHandler *pFileActionHandler) :
 	CBaseDialog(hInstance, iResource, hParent, true),
 	m_expp(expp),
-	m_FullFilenameList(FullFilenameList),
-	m_pFileActionHandler(pFileActionHandler)
+	m_pFileActionHandler(pFileActionHandler),
+	m_fullFilenames(FullFilenameList.begin(), FullFilenameList.end()),
+	m_previewGeneration(0)
 {
 	m_pmrdps = &CMassRenameDialogPersistentSettings::GetInstance();
+
+	m_directories.reserve(m_fullFilenames.size());
+	m_filenames.reserve(m_fullFilenames.size());
+
+	for(const auto &strFullFilename : m_fullFilenames)
+	{
+		TCHAR szDirectory[MAX_PATH];
+		StringCchCopy(szDirectory,SIZEOF_ARRAY(szDirectory),
+			strFullFilename.c_str());
+		PathRemoveFileSpec(szDirectory);
+		m_directories.push_back(szDirectory);
+
+		m_filenames.push_back(PathFindFileName(strFullFilename.c_str()));
+	}
+
+	/* Icons are only retrieved once an item is shown. */
+	m_iconIndexes.resize(m_fullFilenames.size(),-1);
+
+	m_previewNames = m_filenames;
+	m_collisions.resize(m_fullFilenames.size(),false);
+
+	TaskScheduler *taskScheduler = m_expp->GetTaskScheduler();
+	m_previewQueue = taskScheduler->CreateQueue(taskScheduler->GetNumThreads());
+	m_previewQueue->SetActive(true);
 }
 
 INT_PTR CMassRenameDialog::OnInitDialog()
@@ -50,7 +84,7 @@ INT_PTR CMassRenameDialog::OnInitDialog()
 	SendDlgItemMessage(m_hDlg,IDC_MASSRENAME_MORE,BM_SETIMAGE,IMAGE_ICON,
 		reinterpret_cast<LPARAM>(m_moreIcon.get()));
 
-	HWND hListView = GetDlgItem(m_hDlg,IDC_MASSRENAME_FILELISTVIEW);
+	HWND hListView = EnsureVirtualListView(GetDlgItem(m_hDlg,IDC_MASSRENAME_FILELISTVIEW));
 
 	SetWindowTheme(hListView,L"Explorer",NULL);
 	ListView_SetExtendedListViewStyleEx(hListView,
@@ -76,36 +110,10 @@ INT_PTR CMassRenameDialog::OnInitDialog()
 	SendMessage(hListView,LVM_SETCOLUMNWIDTH,0,m_pmrdps->m_iColumnWidth1);
 	SendMessage(hListView,LVM_SETCOLUMNWIDTH,1,m_pmrdps->m_iColumnWidth2);
 
-	LVITEM lvItem;
-	SHFILEINFO shfi;
-	TCHAR szFilename[MAX_PATH];
-	int iItem = 0;
-
-	/* Add each file to the listview, along with its icon. */
-	for(const auto &strFilename : m_FullFilenameList)
-	{
-		SHGetFileInfo(strFilename.c_str(),0,&shfi,
-			sizeof(SHFILEINFO),SHGFI_SYSICONINDEX);
-
-		StringCchCopy(szFilename,SIZEOF_ARRAY(szFilename),
-			strFilename.c_str());
-		PathStripPath(szFilename);
-
-		lvItem.mask		= LVIF_TEXT|LVIF_IMAGE;
-		lvItem.iItem	= iItem;
-		lvItem.iSubItem	= 0;
-		lvItem.iImage	= shfi.iIcon;
-		lvItem.pszText	= szFilename;
-		ListView_InsertItem(hListView,&lvItem);
-
-		lvItem.mask		= LVIF_TEXT;
-		lvItem.iItem	= iItem;
-		lvItem.iSubItem	= 1;
-		lvItem.pszText	= szFilename;
-		ListView_SetItem(hListView,&lvItem);
-
-		iItem++;
-	}
+	/* The listview is virtual. Text and icons are
+	only retrieved for the items that are shown. */
+	ListView_SetItemCountEx(hListView,static_cast<int>(m_fullFilenames.size()),
+		LVSICF_NOINVALIDATEALL);
 
 	SetDlgItemText(m_hDlg,IDC_MASSRENAME_EDIT,_T("/F"));
 	SendMessage(GetDlgItem(m_hDlg,IDC_MASSRENAME_EDIT),
@@ -117,6 +125,46 @@ INT_PTR CMassRenameDialog::OnInitDialog()
 	return 0;
 }
 
+/* The listview has to be virtual (LVS_OWNERDATA), as
+items are never inserted into it. That style can't be
+changed once the control has been created, so if the
+dialog template doesn't include it (e.g. a template from
+an older translation), the control is replaced with one
+that does. */
+HWND CMassRenameDialog::EnsureVirtualListView(HWND hListView)
+{
+	LONG_PTR style = GetWindowLongPtr(hListView,GWL_STYLE);
+
+	if((style & LVS_OWNERDATA) == LVS_OWNERDATA)
+	{
+		return hListView;
+	}
+
+	RECT rc;
+	GetWindowRect(hListView,&rc);
+	MapWindowPoints(HWND_DESKTOP,m_hDlg,reinterpret_cast<LPPOINT>(&rc),sizeof(RECT) / sizeof(POINT));
+
+	HWND hNewListView = CreateWindowEx(static_cast<DWORD>(GetWindowLongPtr(hListView,GWL_EXSTYLE)),
+		WC_LISTVIEW,L"",static_cast<DWORD>(style | LVS_OWNERDATA),rc.left,rc.top,
+		GetRectWidth(&rc),GetRectHeight(&rc),m_hDlg,
+		reinterpret_cast<HMENU>(static_cast<INT_PTR>(IDC_MASSRENAME_FILELISTVIEW)),
+		GetModuleHandle(NULL),NULL);
+
+	if(hNewListView == NULL)
+	{
+		return hListView;
+	}
+
+	SendMessage(hNewListView,WM_SETFONT,SendMessage(hListView,WM_GETFONT,0,0),FALSE);
+
+	/* Places the new control directly after the original
+	one, so that the tab order is unchanged. */
+	SetWindowPos(hNewListView,hListView,0,0,0,0,SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+	DestroyWindow(hListView);
+
+	return hNewListView;
+}
+
 wil::unique_hicon CMassRenameDialog::GetDialogIcon(int iconWidth, int iconHeight) const
 {
 	return m_expp->GetIconResourceLoader()->LoadIconFromPNGAndScale(Icon::MassRename, iconWidth, iconHeight);
@@ -169,39 +217,7 @@ INT_PTR CMassRenameDialog::OnCommand(WPARAM wParam,LPARAM lParam)
 		switch(HIWORD(wParam))
 		{
 		case EN_CHANGE:
-			{
-				TCHAR szNamePattern[MAX_PATH];
-				GetDlgItemText(m_hDlg,IDC_MASSRENAME_EDIT,
-					szNamePattern,SIZEOF_ARRAY(szNamePattern));
-
-				HWND hListView = GetDlgItem(m_hDlg,IDC_MASSRENAME_FILELISTVIEW);
-
-				LVITEM lvItem;
-				std::wstring strNewFilename;
-				TCHAR szFilename[MAX_PATH];
-				TCHAR szNewFilename[MAX_PATH];
-				int iItem = 0;
-
-				for(const auto &strFilename : m_FullFilenameList)
-				{
-					StringCchCopy(szFilename,SIZEOF_ARRAY(szFilename),
-						strFilename.c_str());
-					PathStripPath(szFilename);
-
-					ProcessFileName(szNamePattern,szFilename,iItem,strNewFilename);
-
-					StringCchCopy(szNewFilename,SIZEOF_ARRAY(szNewFilename),
-						strNewFilename.c_str());
-
-					lvItem.mask		= LVIF_TEXT;
-					lvItem.iItem	= iItem;
-					lvItem.iSubItem	= 1;
-					lvItem.pszText	= szNewFilename;
-					ListView_SetItem(hListView,&lvItem);
-
-					iItem++;
-				}
-			}
+			OnPatternChanged();
 			break;
 		}
 	}
@@ -267,12 +283,49 @@ INT_PTR CMassRenameDialog::OnCommand(WPARAM wParam,LPARAM lParam)
 	return 0;
 }
 
+INT_PTR CMassRenameDialog::OnNotify(NMHDR *pnmhdr)
+{
+	if(pnmhdr->idFrom != IDC_MASSRENAME_FILELISTVIEW)
+	{
+		return 0;
+	}
+
+	switch(pnmhdr->code)
+	{
+	case LVN_GETDISPINFO:
+		OnListViewGetDisplayInfo(reinterpret_cast<NMLVDISPINFO *>(pnmhdr)->item);
+		break;
+
+	case NM_CUSTOMDRAW:
+		SetWindowLongPtr(m_hDlg,DWLP_MSGRESULT,
+			OnListViewCustomDraw(reinterpret_cast<NMLVCUSTOMDRAW *>(pnmhdr)));
+		return TRUE;
+	}
+
+	return 0;
+}
+
 INT_PTR CMassRenameDialog::OnClose()
 {
+	CancelPreview();
 	EndDialog(m_hDlg,0);
 	return 0;
 }
 
+INT_PTR CMassRenameDialog::OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
+{
+	UNREFERENCED_PARAMETER(lParam);
+
+	switch(uMsg)
+	{
+	case NMassRenameDialog::WM_APP_PREVIEW_READY:
+		OnPreviewReady(static_cast<int>(wParam));
+		break;
+	}
+
+	return 0;
+}
+
 void CMassRenameDialog::OnOk()
 {
 	TCHAR szNamePattern[MAX_PATH];
@@ -286,30 +339,35 @@ void CMassRenameDialog::OnOk()
 		return;
 	}
 
-	std::list<CFileActionHandler::RenamedItem_t> RenamedItemList;
-	int iItem = 0;
+	CancelPreview();
 
-	for(const auto &strOldFilename : m_FullFilenameList)
+	/* The preview for the current pattern may not have
+	finished yet, so the names are generated again here. */
+	MassRenameTemplate nameTemplate(szNamePattern);
+	std::vector<std::wstring> newNames(m_filenames.size());
+
+	for(std::size_t i = 0;i < m_filenames.size();i++)
 	{
-		TCHAR szFilename[MAX_PATH];
-		StringCchCopy(szFilename,SIZEOF_ARRAY(szFilename),
-			strOldFilename.c_str());
-		PathStripPath(szFilename);
+		nameTemplate.Render(m_filenames[i],static_cast<int>(i),newNames[i]);
+	}
 
-		std::wstring strNewFilename;
-		ProcessFileName(szNamePattern,szFilename,iItem,strNewFilename);
+	std::vector<bool> collisions = FindNameCollisions(m_directories,newNames);
 
-		StringCchCopy(szFilename,SIZEOF_ARRAY(szFilename),
-			strOldFilename.c_str());
-		PathRemoveFileSpec(szFilename);
-		strNewFilename = szFilename + std::wstring(_T("\\")) + strNewFilename;
+	if(std::find(collisions.begin(),collisions.end(),true) != collisions.end())
+	{
+		/* Two or more files would end up with the same name. */
+		SetPreview(std::move(newNames),std::move(collisions));
+		return;
+	}
+
+	std::list<CFileActionHandler::RenamedItem_t> RenamedItemList;
 
+	for(std::size_t i = 0;i < m_fullFilenames.size();i++)
+	{
 		CFileActionHandler::RenamedItem_t RenamedItem;
-		RenamedItem.strOldFilename = strOldFilename;
-		RenamedItem.strNewFilename = strNewFilename;
+		RenamedItem.strOldFilename = m_fullFilenames[i];
+		RenamedItem.strNewFilename = m_directories[i] + std::wstring(_T("\\")) + newNames[i];
 		RenamedItemList.push_back(RenamedItem);
-
-		iItem++;
 	}
 
 	m_pFileActionHandler->RenameFiles(RenamedItemList);
@@ -319,6 +377,7 @@ void CMassRenameDialog::OnOk()
 
 void CMassRenameDialog::OnCancel()
 {
+	CancelPreview();
 	EndDialog(m_hDlg,0);
 }
 
@@ -333,71 +392,148 @@ void CMassRenameDialog::SaveState()
 	m_pmrdps->m_bStateSaved = TRUE;
 }
 
-void CMassRenameDialog::ProcessFileName(const std::wstring &strTarget,
-	const std::wstring &strFilename,int iFileIndex,std::wstring &strOutput)
+void CMassRenameDialog::OnPatternChanged()
 {
-	TCHAR szBaseName[MAX_PATH];
-	StringCchCopy(szBaseName, SIZEOF_ARRAY(szBaseName), strFilename.c_str());
-	PathRemoveExtension(szBaseName);
+	TCHAR szNamePattern[MAX_PATH];
+	GetDlgItemText(m_hDlg,IDC_MASSRENAME_EDIT,
+		szNamePattern,SIZEOF_ARRAY(szNamePattern));
 
-	TCHAR *pExt = PathFindExtension(strFilename.c_str());
+	/* Any preview that's still being generated is for
+	a pattern that's now out of date. */
+	CancelPreview();
 
-	size_t iPos;
+	if(m_filenames.empty())
+	{
+		return;
+	}
 
-	strOutput = strTarget;
+	m_previewGeneration++;
 
-	std::wregex rxPattern;
-	rxPattern.assign(_T("/[0]*N"));
+	auto job = std::make_shared<PreviewJob>(m_previewGeneration,szNamePattern);
+	job->previewNames.resize(m_filenames.size());
 
-	bool bStop = false;
+	std::size_t numChunks = (m_filenames.size() + PREVIEW_CHUNK_SIZE - 1) / PREVIEW_CHUNK_SIZE;
+	job->numRemainingChunks = static_cast<int>(numChunks);
 
-	while(!bStop)
+	for(std::size_t i = 0;i < numChunks;i++)
 	{
-		std::match_results<std::wstring::const_iterator> mr;
-		std::wstring::const_iterator itrStart = strOutput.begin();
-		std::wstring::const_iterator itrEnd = strOutput.end();
+		std::size_t start = i * PREVIEW_CHUNK_SIZE;
+		std::size_t end = (std::min)(start + PREVIEW_CHUNK_SIZE,m_filenames.size());
 
-		if(std::regex_search(itrStart,itrEnd,mr,rxPattern))
-		{
-			std::wstringstream ss;
+		m_previewQueue->Push(TaskScheduler::TaskPriority::Visible,[this,job,start,end] {
+			RenderPreviewChunk(job,start,end);
+		});
+	}
 
-			/* The minimum length is the number of zeros present plus one. */
-			ss << std::setfill(_T('0')) << std::setw((mr.length() - 2) + 1) << iFileIndex;
+	m_previewJob = job;
+}
 
-			strOutput.replace(mr.position(),mr.length(),ss.str());
-		}
-		else
+/* Runs on a background thread. Whichever chunk finishes
+last checks the full set of names for collisions and
+notifies the dialog. */
+void CMassRenameDialog::RenderPreviewChunk(std::shared_ptr<PreviewJob> job,
+	std::size_t start,std::size_t end)
+{
+	for(std::size_t i = start;i < end;i++)
+	{
+		if((i - start) % NMassRenameDialog::CANCELLATION_CHECK_INTERVAL == 0 && job->cancelled)
 		{
-			bStop = true;
+			return;
 		}
+
+		job->nameTemplate.Render(m_filenames[i],static_cast<int>(i),job->previewNames[i]);
 	}
 
-	while((iPos = strOutput.find(_T("/F"))) != std::wstring::npos)
+	if(--job->numRemainingChunks != 0 || job->cancelled)
 	{
-		strOutput.replace(iPos,2,strFilename);
+		return;
 	}
 
-	while((iPos = strOutput.find(_T("/B"))) != std::wstring::npos)
+	job->collisions = FindNameCollisions(m_directories,job->previewNames);
+
+	PostMessage(m_hDlg,NMassRenameDialog::WM_APP_PREVIEW_READY,job->generation,0);
+}
+
+void CMassRenameDialog::OnPreviewReady(int generation)
+{
+	if(!m_previewJob || m_previewJob->generation != generation)
+	{
+		return;
+	}
+
+	auto job = std::move(m_previewJob);
+	SetPreview(std::move(job->previewNames),std::move(job->collisions));
+}
+
+void CMassRenameDialog::SetPreview(std::vector<std::wstring> previewNames,
+	std::vector<bool> collisions)
+{
+	m_previewNames = std::move(previewNames);
+	m_collisions = std::move(collisions);
+
+	bool hasCollisions = std::find(m_collisions.begin(),m_collisions.end(),true) != m_collisions.end();
+	EnableWindow(GetDlgItem(m_hDlg,IDOK),!hasCollisions);
+
+	/* Only the items that are currently shown need to
+	be redrawn. */
+	HWND hListView = GetDlgItem(m_hDlg,IDC_MASSRENAME_FILELISTVIEW);
+	int iTopIndex = ListView_GetTopIndex(hListView);
+	ListView_RedrawItems(hListView,iTopIndex,iTopIndex + ListView_GetCountPerPage(hListView));
+}
+
+void CMassRenameDialog::CancelPreview()
+{
+	if(m_previewJob)
 	{
-		strOutput.replace(iPos,2,szBaseName);
+		m_previewJob->cancelled = true;
+		m_previewJob.reset();
 	}
 
-	while((iPos = strOutput.find(_T("/E"))) != std::wstring::npos)
+	m_previewQueue->Cancel();
+}
+
+void CMassRenameDialog::OnListViewGetDisplayInfo(LVITEM &item)
+{
+	if(WI_IsFlagSet(item.mask,LVIF_TEXT))
 	{
-		strOutput.replace(iPos,2,pExt);
+		const std::wstring &text = (item.iSubItem == 0) ? m_filenames[item.iItem] : m_previewNames[item.iItem];
+		StringCchCopy(item.pszText,item.cchTextMax,text.c_str());
 	}
 
-	while((iPos = strOutput.find(_T("/L"))) != std::wstring::npos)
+	if(WI_IsFlagSet(item.mask,LVIF_IMAGE) && item.iSubItem == 0)
 	{
-		strOutput.replace(iPos,2,strFilename);
-		boost::to_lower(strOutput);
+		int &iconIndex = m_iconIndexes[item.iItem];
+
+		if(iconIndex == -1)
+		{
+			SHFILEINFO shfi;
+			DWORD_PTR res = SHGetFileInfo(m_fullFilenames[item.iItem].c_str(),0,&shfi,
+				sizeof(SHFILEINFO),SHGFI_SYSICONINDEX);
+			iconIndex = (res != 0) ? shfi.iIcon : 0;
+		}
+
+		item.iImage = iconIndex;
 	}
+}
 
-	while((iPos = strOutput.find(_T("/U"))) != std::wstring::npos)
+LRESULT CMassRenameDialog::OnListViewCustomDraw(NMLVCUSTOMDRAW *customDraw)
+{
+	switch(customDraw->nmcd.dwDrawStage)
 	{
-		strOutput.replace(iPos,2,strFilename);
-		boost::to_upper(strOutput);
+	case CDDS_PREPAINT:
+		return CDRF_NOTIFYITEMDRAW;
+
+	case CDDS_ITEMPREPAINT:
+		if(customDraw->nmcd.dwItemSpec < m_collisions.size()
+			&& m_collisions[customDraw->nmcd.dwItemSpec])
+		{
+			customDraw->clrText = NMassRenameDialog::COLLISION_TEXT_COLOR;
+			return CDRF_NEWFONT;
+		}
+		break;
 	}
+
+	return CDRF_DODEFAULT;
 }
 
 CMassRenameDialogPersistentSettings::CMassRenameDialogPersistentSettings() :
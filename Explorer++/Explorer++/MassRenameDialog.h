@@ -5,10 +5,14 @@
 #pragma once
 
 #include "CoreInterface.h"
+#include "MassRenameTemplate.h"
 #include "../Helper/BaseDialog.h"
 #include "../Helper/DialogSettings.h"
 #include "../Helper/FileActionHandler.h"
 #include "../Helper/ResizableDialog.h"
+#include "../Helper/TaskScheduler.h"
+#include <atomic>
+#include <memory>
 
 class CMassRenameDialog;
 
@@ -55,24 +59,74 @@ protected:
 
 	INT_PTR	OnInitDialog();
 	INT_PTR	OnCommand(WPARAM wParam,LPARAM lParam);
+	INT_PTR	OnNotify(NMHDR *pnmhdr);
 	INT_PTR	OnClose();
+	INT_PTR	OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lParam);
 
 	virtual wil::unique_hicon GetDialogIcon(int iconWidth, int iconHeight) const override;
 
 private:
 
+	// The new names for a particular pattern. The names are generated in
+	// chunks, in parallel.
+	struct PreviewJob
+	{
+		int generation;
+		MassRenameTemplate nameTemplate;
+		std::vector<std::wstring> previewNames;
+		std::vector<bool> collisions;
+		std::atomic<int> numRemainingChunks;
+
+		// Set once the pattern has changed again, at which point there's
+		// no need to finish generating the names.
+		std::atomic<bool> cancelled;
+
+		PreviewJob(int jobGeneration, const std::wstring &pattern) :
+			generation(jobGeneration),
+			nameTemplate(pattern),
+			numRemainingChunks(0),
+			cancelled(false)
+		{
+
+		}
+	};
+
+	static const int PREVIEW_CHUNK_SIZE = 4096;
+
 	void	GetResizableControlInformation(CBaseDialog::DialogSizeConstraint &dsc, std::list<CResizableDialog::Control_t> &ControlList);
 	void	SaveState();
 
+	HWND	EnsureVirtualListView(HWND hListView);
+
 	void	OnOk();
 	void	OnCancel();
 
-	void	ProcessFileName(const std::wstring &strTarget,const std::wstring &strFilename,int iFileIndex,std::wstring &strOutput);
+	void	OnPatternChanged();
+	void	RenderPreviewChunk(std::shared_ptr<PreviewJob> job, std::size_t start, std::size_t end);
+	void	OnPreviewReady(int generation);
+	void	CancelPreview();
+	void	OnListViewGetDisplayInfo(LVITEM &item);
+	LRESULT	OnListViewCustomDraw(NMLVCUSTOMDRAW *customDraw);
+	void	SetPreview(std::vector<std::wstring> previewNames,std::vector<bool> collisions);
 
 	IExplorerplusplus *m_expp;
-	std::list<std::wstring> m_FullFilenameList;
 	wil::unique_hicon m_moreIcon;
 	CFileActionHandler *m_pFileActionHandler;
 
+	// Each of these is indexed by the position of the item in the list.
+	std::vector<std::wstring> m_fullFilenames;
+	std::vector<std::wstring> m_directories;
+	std::vector<std::wstring> m_filenames;
+	std::vector<int> m_iconIndexes;
+	std::vector<std::wstring> m_previewNames;
+	std::vector<bool> m_collisions;
+
+	std::shared_ptr<PreviewJob> m_previewJob;
+	int m_previewGeneration;
+
 	CMassRenameDialogPersistentSettings *m_pmrdps;
+
+	// Declared last, so that it's destroyed (and any running preview tasks
+	// have finished) before the data above goes away.
+	std::unique_ptr<TaskScheduler::Queue> m_previewQueue;
 };
\ No newline at end of file
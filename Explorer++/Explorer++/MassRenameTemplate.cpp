@@ -0,0 +1,185 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "MassRenameTemplate.h"
+#include <boost/algorithm/string.hpp>
+#include <unordered_map>
+
+MassRenameTemplate::MassRenameTemplate(const std::wstring &pattern) :
+	m_caseConversion(CaseConversion::None),
+	m_literalLength(0)
+{
+	std::size_t i = 0;
+
+	while (i < pattern.size())
+	{
+		if (pattern[i] != '/' || (i + 1) == pattern.size())
+		{
+			AddLiteral(pattern[i]);
+			i++;
+			continue;
+		}
+
+		std::size_t next = pattern.find_first_not_of('0', i + 1);
+		std::size_t numZeros = (next == std::wstring::npos) ? (pattern.size() - i - 1) : (next - i - 1);
+
+		if (next != std::wstring::npos && pattern[next] == 'N')
+		{
+			// The minimum width is the number of zeros present plus one.
+			m_tokens.push_back({ TokenType::Counter, {}, static_cast<int>(numZeros) + 1 });
+			i = next + 1;
+			continue;
+		}
+
+		if (numZeros > 0)
+		{
+			AddLiteral(pattern[i]);
+			i++;
+			continue;
+		}
+
+		switch (pattern[i + 1])
+		{
+		case 'F':
+			m_tokens.push_back({ TokenType::FileName, {}, 0 });
+			break;
+
+		case 'B':
+			m_tokens.push_back({ TokenType::BaseName, {}, 0 });
+			break;
+
+		case 'E':
+			m_tokens.push_back({ TokenType::Extension, {}, 0 });
+			break;
+
+		case 'L':
+			m_tokens.push_back({ TokenType::FileName, {}, 0 });
+			m_caseConversion = CaseConversion::Lower;
+			break;
+
+		case 'U':
+			m_tokens.push_back({ TokenType::FileName, {}, 0 });
+
+			if (m_caseConversion == CaseConversion::None)
+			{
+				m_caseConversion = CaseConversion::Upper;
+			}
+			break;
+
+		default:
+			AddLiteral(pattern[i]);
+			i++;
+			continue;
+		}
+
+		i += 2;
+	}
+}
+
+void MassRenameTemplate::AddLiteral(wchar_t c)
+{
+	if (m_tokens.empty() || m_tokens.back().type != TokenType::Literal)
+	{
+		m_tokens.push_back({ TokenType::Literal, {}, 0 });
+	}
+
+	m_tokens.back().text.push_back(c);
+	m_literalLength++;
+}
+
+void MassRenameTemplate::Render(const std::wstring &fileName, int index, std::wstring &output) const
+{
+	const TCHAR *extension = PathFindExtension(fileName.c_str());
+	std::size_t baseNameLength = extension - fileName.c_str();
+
+	output.clear();
+	output.reserve(m_literalLength + (fileName.size() * m_tokens.size()));
+
+	for (const auto &token : m_tokens)
+	{
+		switch (token.type)
+		{
+		case TokenType::Literal:
+			output.append(token.text);
+			break;
+
+		case TokenType::Counter:
+		{
+			std::wstring counter = std::to_wstring(index);
+
+			if (counter.size() < static_cast<std::size_t>(token.counterWidth))
+			{
+				output.append(token.counterWidth - counter.size(), '0');
+			}
+
+			output.append(counter);
+		}
+			break;
+
+		case TokenType::FileName:
+			output.append(fileName);
+			break;
+
+		case TokenType::BaseName:
+			output.append(fileName, 0, baseNameLength);
+			break;
+
+		case TokenType::Extension:
+			output.append(extension);
+			break;
+		}
+	}
+
+	switch (m_caseConversion)
+	{
+	case CaseConversion::Lower:
+		boost::to_lower(output);
+		break;
+
+	case CaseConversion::Upper:
+		boost::to_upper(output);
+		break;
+
+	case CaseConversion::None:
+		break;
+	}
+}
+
+std::wstring MassRenameTemplate::Render(const std::wstring &fileName, int index) const
+{
+	std::wstring output;
+	Render(fileName, index, output);
+	return output;
+}
+
+std::vector<bool> FindNameCollisions(const std::vector<std::wstring> &directories,
+	const std::vector<std::wstring> &newNames)
+{
+	std::vector<bool> collisions(newNames.size(), false);
+
+	// Maps each (lowercased) path to the first item that has it.
+	std::unordered_map<std::wstring, std::size_t> paths;
+	paths.reserve(newNames.size());
+
+	std::wstring path;
+
+	for (std::size_t i = 0; i < newNames.size(); i++)
+	{
+		path.assign(directories[i]);
+		path.push_back('\\');
+		path.append(newNames[i]);
+		boost::to_lower(path);
+
+		auto result = paths.insert({ path, i });
+
+		if (!result.second)
+		{
+			collisions[result.first->second] = true;
+			collisions[i] = true;
+		}
+	}
+
+	return collisions;
+}
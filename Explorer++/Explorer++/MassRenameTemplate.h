@@ -0,0 +1,77 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// A mass rename pattern, parsed once into a list of tokens, so that the
+// new name for each file can be built in a single pass. The following
+// special sequences are supported:
+//
+// /N	- Counter (the index of the file). Any zeros between the slash
+//		  and the N set the minimum width (e.g. /00N gives 000, 001...).
+// /F	- Filename
+// /B	- Basename (filename without extension)
+// /E	- Extension
+// /L	- Filename, with the whole of the new name in lowercase
+// /U	- Filename, with the whole of the new name in uppercase
+//
+// If both /L and /U appear, the new name is lowercased. Any other text
+// (including a slash that isn't followed by one of the above) is copied
+// as-is.
+//
+// Rendering doesn't modify the template, so a single template can be used
+// from multiple threads at once.
+class MassRenameTemplate
+{
+public:
+
+	explicit MassRenameTemplate(const std::wstring &pattern);
+
+	void Render(const std::wstring &fileName, int index, std::wstring &output) const;
+	std::wstring Render(const std::wstring &fileName, int index) const;
+
+private:
+
+	enum class TokenType
+	{
+		Literal,
+		Counter,
+		FileName,
+		BaseName,
+		Extension
+	};
+
+	enum class CaseConversion
+	{
+		None,
+		Lower,
+		Upper
+	};
+
+	struct Token
+	{
+		TokenType type;
+
+		// Only used for literal tokens.
+		std::wstring text;
+
+		// Only used for counter tokens.
+		int counterWidth;
+	};
+
+	void AddLiteral(wchar_t c);
+
+	std::vector<Token> m_tokens;
+	CaseConversion m_caseConversion;
+	std::size_t m_literalLength;
+};
+
+// Returns whether each item would end up with the same name (ignoring case)
+// as another item in the same directory. The two vectors should be the
+// same size.
+std::vector<bool> FindNameCollisions(const std::vector<std::wstring> &directories,
+	const std::vector<std::wstring> &newNames);
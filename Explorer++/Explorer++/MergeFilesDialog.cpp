@@ -8,6 +8,7 @@
 #include "IconResourceLoader.h"
 #include "MainResource.h"
 #include "ResourceHelper.h"
+#include "../Helper/ChecksumManifest.h"
 #include "../Helper/FileOperations.h"
 #include "../Helper/Helper.h"
 #include "../Helper/ListViewHelper.h"
@@ -21,10 +22,10 @@
 
 namespace NMergeFilesDialog
 {
-	const int WM_APP_SETTOTALMERGECOUNT		= WM_APP + 1;
-	const int WM_APP_SETCURRENTMERGECOUNT	= WM_APP + 2;
-	const int WM_APP_MERGINGFINISHED		= WM_APP + 3;
-	const int WM_APP_OUTPUTFILEINVALID		= WM_APP + 4;
+	const int WM_APP_SETMERGEPROGRESS		= WM_APP + 1;
+	const int WM_APP_MERGINGFINISHED		= WM_APP + 2;
+
+	const int MERGE_PROGRESS_RANGE			= 1000;
 
 	DWORD WINAPI	MergeFilesThread(LPVOID pParam);
 }
@@ -318,35 +319,12 @@ INT_PTR CMergeFilesDialog::OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lPara
 
 	switch(uMsg)
 	{
-	case NMergeFilesDialog::WM_APP_SETTOTALMERGECOUNT:
-		SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_SETRANGE32,0,wParam);
-		break;
-
-	case NMergeFilesDialog::WM_APP_SETCURRENTMERGECOUNT:
+	case NMergeFilesDialog::WM_APP_SETMERGEPROGRESS:
 		SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_SETPOS,wParam,0);
 		break;
 
 	case NMergeFilesDialog::WM_APP_MERGINGFINISHED:
-		OnFinished();
-		break;
-
-	case NMergeFilesDialog::WM_APP_OUTPUTFILEINVALID:
-		{
-			TCHAR szTemp[64];
-			LoadString(GetInstance(),IDS_MERGE_FILES_OUTPUTFILEINVALID,
-				szTemp,SIZEOF_ARRAY(szTemp));
-			MessageBox(m_hDlg,szTemp,NExplorerplusplus::APP_NAME,MB_ICONWARNING|MB_OK);
-
-			assert(m_pMergeFiles != NULL);
-
-			m_pMergeFiles->Release();
-			m_pMergeFiles = NULL;
-
-			m_bMergingFiles = false;
-			m_bStopMerging = false;
-
-			SetDlgItemText(m_hDlg,IDOK,m_szOk);
-		}
+		OnFinished(static_cast<FileMerger::Result>(wParam));
 		break;
 	}
 
@@ -381,6 +359,7 @@ void CMergeFilesDialog::OnOk()
 
 		m_pMergeFiles = new CMergeFiles(m_hDlg,szOutputFileName,m_FullFilenameList);
 
+		SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_SETRANGE32,0,NMergeFilesDialog::MERGE_PROGRESS_RANGE);
 		SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_SETPOS,0,0);
 
 		GetDlgItemText(m_hDlg,IDOK,m_szOk,SIZEOF_ARRAY(m_szOk));
@@ -391,6 +370,11 @@ void CMergeFilesDialog::OnOk()
 
 		m_bMergingFiles = true;
 
+		/* The thread holds its own reference, so that the merge
+		object remains valid, even if this dialog is closed while
+		the merge is still running. */
+		m_pMergeFiles->AddRef();
+
 		HANDLE hThread = CreateThread(NULL,0,NMergeFilesDialog::MergeFilesThread,
 			reinterpret_cast<LPVOID>(m_pMergeFiles),0,NULL);
 		SetThreadPriority(hThread,THREAD_PRIORITY_LOWEST);
@@ -484,7 +468,7 @@ void CMergeFilesDialog::OnMove(bool bUp)
 	}
 }
 
-void CMergeFilesDialog::OnFinished()
+void CMergeFilesDialog::OnFinished(FileMerger::Result result)
 {
 	assert(m_pMergeFiles != NULL);
 
@@ -494,11 +478,42 @@ void CMergeFilesDialog::OnFinished()
 	m_bMergingFiles = false;
 	m_bStopMerging = false;
 
-	/* Set the progress bar position to the end. */
-	int iHighLimit = static_cast<int>(SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_GETRANGE,FALSE,0));
-	SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_SETPOS,iHighLimit,0);
-
 	SetDlgItemText(m_hDlg,IDOK,m_szOk);
+
+	UINT uErrorId = 0;
+
+	switch(result)
+	{
+	case FileMerger::Result::Succeeded:
+		{
+			/* Set the progress bar position to the end. */
+			int iHighLimit = static_cast<int>(SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_GETRANGE,FALSE,0));
+			SendDlgItemMessage(m_hDlg,IDC_MERGE_PROGRESS,PBM_SETPOS,iHighLimit,0);
+		}
+		break;
+
+	case FileMerger::Result::InputFileInvalid:
+	case FileMerger::Result::ReadFailed:
+		uErrorId = IDS_SPLITFILEDIALOG_INPUTFILEINVALID;
+		break;
+
+	case FileMerger::Result::OutputFileInvalid:
+	case FileMerger::Result::OutOfMemory:
+	case FileMerger::Result::WriteFailed:
+	case FileMerger::Result::VerificationFailed:
+		uErrorId = IDS_MERGE_FILES_OUTPUTFILEINVALID;
+		break;
+
+	case FileMerger::Result::Stopped:
+		break;
+	}
+
+	if(uErrorId != 0)
+	{
+		TCHAR szTemp[64];
+		LoadString(GetInstance(),uErrorId,szTemp,SIZEOF_ARRAY(szTemp));
+		MessageBox(m_hDlg,szTemp,NExplorerplusplus::APP_NAME,MB_ICONWARNING|MB_OK);
+	}
 }
 
 DWORD WINAPI NMergeFilesDialog::MergeFilesThread(LPVOID pParam)
@@ -507,96 +522,75 @@ DWORD WINAPI NMergeFilesDialog::MergeFilesThread(LPVOID pParam)
 
 	CMergeFiles *pMergeFiles = reinterpret_cast<CMergeFiles *>(pParam);
 	pMergeFiles->StartMerging();
+	pMergeFiles->Release();
 
 	return 0;
 }
 
-CMergeFiles::CMergeFiles(HWND hDlg,std::wstring strOutputFilename,std::list<std::wstring> FullFilenameList)
+CMergeFiles::CMergeFiles(HWND hDlg,std::wstring strOutputFilename,std::list<std::wstring> FullFilenameList) :
+	m_hDlg(hDlg),
+	m_strOutputFilename(strOutputFilename),
+	m_fileMerger(strOutputFilename,GetInputFiles(FullFilenameList),GetMergeOptions(FullFilenameList))
 {
-	m_hDlg				= hDlg;
-	m_strOutputFilename	= strOutputFilename;
-	m_FullFilenameList	= FullFilenameList;
-
-	m_bstopMerging		= false;
 
-	InitializeCriticalSection(&m_csStop);
 }
 
 CMergeFiles::~CMergeFiles()
 {
-	DeleteCriticalSection(&m_csStop);
+
 }
 
-void CMergeFiles::StartMerging()
+std::vector<std::wstring> CMergeFiles::GetInputFiles(const std::list<std::wstring> &FullFilenameList)
 {
-	LARGE_INTEGER lMergeFileSize;
-	int nFilesMerged = 1;
-	bool bStop = false;
+	return std::vector<std::wstring>(FullFilenameList.begin(),FullFilenameList.end());
+}
 
-	HANDLE hOutputFile = CreateFile(m_strOutputFilename.c_str(),GENERIC_WRITE,
-		0,NULL,CREATE_NEW,FILE_ATTRIBUTE_NORMAL,NULL);
+/* If the files were produced by the split dialog, there will
+be a manifest alongside them and each file can be verified as
+it's merged. */
+FileMerger::Options CMergeFiles::GetMergeOptions(const std::list<std::wstring> &FullFilenameList)
+{
+	FileMerger::Options options;
+	options.manifest = FindChecksumManifest(GetInputFiles(FullFilenameList));
+	return options;
+}
 
-	if(hOutputFile == INVALID_HANDLE_VALUE)
-	{
-		PostMessage(m_hDlg,NMergeFilesDialog::WM_APP_OUTPUTFILEINVALID,0,0);
-		return;
-	}
+void CMergeFiles::StartMerging()
+{
+	HWND hDlg = m_hDlg;
 
-	PostMessage(m_hDlg,NMergeFilesDialog::WM_APP_SETTOTALMERGECOUNT,
-		static_cast<WPARAM>(m_FullFilenameList.size()),0);
+	/* Progress is reported in terms of bytes, rather than
+	files, so that merging a small number of large files
+	still shows progress. */
+	FileMerger::Result result = m_fileMerger.Merge([hDlg] (const FileMerger::Progress &progress) {
+		int position = NMergeFilesDialog::MERGE_PROGRESS_RANGE;
 
-	for(const auto &strFullFilename : m_FullFilenameList)
-	{
-		if(bStop)
+		if(progress.totalBytes != 0)
 		{
-			break;
+			position = static_cast<int>((progress.bytesWritten * NMergeFilesDialog::MERGE_PROGRESS_RANGE) / progress.totalBytes);
 		}
 
-		HANDLE hInputFile = CreateFile(strFullFilename.c_str(),GENERIC_READ,FILE_SHARE_READ,
-			NULL,OPEN_EXISTING,0,NULL);
-
-		if(hInputFile != INVALID_HANDLE_VALUE)
-		{
-			GetFileSizeEx(hInputFile,&lMergeFileSize);
-
-			if(lMergeFileSize.QuadPart != 0)
-			{
-				auto buffer = std::make_unique<char[]>(lMergeFileSize.LowPart);
-
-				DWORD dwNumberOfBytesRead;
-				ReadFile(hInputFile,reinterpret_cast<LPVOID>(buffer.get()),static_cast<DWORD>(lMergeFileSize.LowPart),
-					&dwNumberOfBytesRead,NULL);
-
-				DWORD dwNumberOfBytesWritten;
-				WriteFile(hOutputFile,reinterpret_cast<LPCVOID>(buffer.get()),dwNumberOfBytesRead,
-					&dwNumberOfBytesWritten,NULL);
-			}
-
-			CloseHandle(hInputFile);
-
-			PostMessage(m_hDlg,NMergeFilesDialog::WM_APP_SETCURRENTMERGECOUNT,nFilesMerged,0);
-
-			nFilesMerged++;
-
-			EnterCriticalSection(&m_csStop);
-			if(m_bstopMerging)
-			{
-				bStop = true;
-			}
-			LeaveCriticalSection(&m_csStop);
-		}
+		PostMessage(hDlg,NMergeFilesDialog::WM_APP_SETMERGEPROGRESS,position,0);
+	});
+
+	/* The output file will only have been created if the input
+	files could all be opened and the output file didn't already
+	exist. A partially merged file isn't of any use, so it's
+	removed. */
+	if(result != FileMerger::Result::Succeeded &&
+		result != FileMerger::Result::InputFileInvalid &&
+		result != FileMerger::Result::OutputFileInvalid &&
+		result != FileMerger::Result::OutOfMemory)
+	{
+		DeleteFile(m_strOutputFilename.c_str());
 	}
 
-	CloseHandle(hOutputFile);
-
-	SendMessage(m_hDlg,NMergeFilesDialog::WM_APP_MERGINGFINISHED,0,0);
+	SendMessage(m_hDlg,NMergeFilesDialog::WM_APP_MERGINGFINISHED,static_cast<WPARAM>(result),0);
 }
 
 void CMergeFiles::StopMerging()
 {
-	EnterCriticalSection(&m_csStop);
-	m_bstopMerging = true;
-	LeaveCriticalSection(&m_csStop);
+	m_fileMerger.Stop();
 }
 
 CMergeFilesDialogPersistentSettings::CMergeFilesDialogPersistentSettings() :
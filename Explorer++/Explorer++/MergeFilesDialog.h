@@ -7,6 +7,7 @@
 #include "CoreInterface.h"
 #include "../Helper/BaseDialog.h"
 #include "../Helper/DialogSettings.h"
+#include "../Helper/FileMerger.h"
 #include "../Helper/ReferenceCount.h"
 #include "../Helper/ResizableDialog.h"
 
@@ -42,13 +43,14 @@ public:
 
 private:
 
+	static std::vector<std::wstring>	GetInputFiles(const std::list<std::wstring> &FullFilenameList);
+	static FileMerger::Options			GetMergeOptions(const std::list<std::wstring> &FullFilenameList);
+
 	HWND					m_hDlg;
 
 	std::wstring			m_strOutputFilename;
-	std::list<std::wstring>	m_FullFilenameList;
 
-	CRITICAL_SECTION		m_csStop;
-	bool					m_bstopMerging;
+	FileMerger				m_fileMerger;
 };
 
 class CMergeFilesDialog : public CBaseDialog
@@ -79,7 +81,7 @@ private:
 	void	OnCancel();
 	void	OnChangeOutputDirectory();
 	void	OnMove(bool bUp);
-	void	OnFinished();
+	void	OnFinished(FileMerger::Result result);
 
 	IExplorerplusplus *m_expp;
 
@@ -305,32 +305,39 @@ void *pData)
 	}
 }
 
-void Explorerplusplus::FolderSizeCallbackStub(int nFolders,int nFiles,PULARGE_INTEGER lTotalFolderSize,LPVOID pData)
+/* Called on one of the folder size calculator's threads,
+both for progress updates and once the calculation has
+finished. */
+void Explorerplusplus::PostFolderSizeResult(int uId,const FolderSizeCalculator::Totals &totals,
+	BOOL bFinal,BOOL bCancelled)
 {
-	Explorerplusplus::FolderSizeExtraInfo_t *pfsei = reinterpret_cast<Explorerplusplus::FolderSizeExtraInfo_t *>(pData);
-	reinterpret_cast<Explorerplusplus *>(pfsei->pContainer)->FolderSizeCallback(pfsei,nFolders,nFiles,lTotalFolderSize);
-	free(pfsei);
-}
-
-void Explorerplusplus::FolderSizeCallback(FolderSizeExtraInfo_t *pfsei,
-int nFolders,int nFiles,PULARGE_INTEGER lTotalFolderSize)
-{
-	UNREFERENCED_PARAMETER(nFolders);
-	UNREFERENCED_PARAMETER(nFiles);
-
 	DWFolderSizeCompletion_t *pDWFolderSizeCompletion = NULL;
 
 	pDWFolderSizeCompletion = (DWFolderSizeCompletion_t *)malloc(sizeof(DWFolderSizeCompletion_t));
 
-	pDWFolderSizeCompletion->liFolderSize = *lTotalFolderSize;
-	pDWFolderSizeCompletion->uId = pfsei->uId;
+	if(pDWFolderSizeCompletion == NULL)
+	{
+		return;
+	}
+
+	pDWFolderSizeCompletion->liFolderSize.QuadPart = totals.size;
+	pDWFolderSizeCompletion->uId = uId;
+	pDWFolderSizeCompletion->bFinal = bFinal;
+	pDWFolderSizeCompletion->bCancelled = bCancelled;
 
 	/* Queue the result back to the main thread, so that
 	the folder size can be displayed. It is up to the main
 	thread to determine whether the folder size should actually
 	be shown. */
-	PostMessage(m_hContainer,WM_APP_FOLDERSIZECOMPLETED,
+	BOOL res = PostMessage(m_hContainer,WM_APP_FOLDERSIZECOMPLETED,
 		(WPARAM)pDWFolderSizeCompletion,0);
+
+	/* The message won't be delivered if the main window has
+	already been destroyed. */
+	if(!res)
+	{
+		free(pDWFolderSizeCompletion);
+	}
 }
 
 void Explorerplusplus::OnSelectColumns()
@@ -556,8 +556,11 @@ int Explorerplusplus::OnClose()
 	m_pluginManager.reset();
 
 	KillTimer(m_hContainer, AUTOSAVE_TIMER_ID);
+	KillTimer(m_hContainer, DISPLAY_WINDOW_UPDATE_TIMER_ID);
 
 	SaveAllSettings();
+	SaveColumnCache();
+	SaveThumbnailCache();
 
 	DestroyWindow(m_hContainer);
 
@@ -1312,49 +1315,14 @@ LRESULT Explorerplusplus::OnCustomDraw(LPARAM lParam)
 
 		case CDDS_ITEMPREPAINT:
 			{
-				DWORD dwAttributes = m_pActiveShellBrowser->GetItemFileFindData(static_cast<int>(pnmcd->dwItemSpec)).dwFileAttributes;
+				/* The color rules have already been checked for
+				this item (when it was added). */
+				auto color = m_pActiveShellBrowser->GetItemColor(static_cast<int>(pnmcd->dwItemSpec));
 
-				TCHAR szFileName[MAX_PATH];
-				m_pActiveShellBrowser->GetItemFullName(static_cast<int>(pnmcd->dwItemSpec),szFileName,SIZEOF_ARRAY(szFileName));
-				PathStripPath(szFileName);
-
-				/* Loop through each filter. Decide whether to change the font of the
-				current item based on its filename and/or attributes. */
-				for(const auto &ColorRule : m_ColorRules)
+				if(color)
 				{
-					BOOL bMatchFileName = FALSE;
-					BOOL bMatchAttributes = FALSE;
-
-					/* Only match against the filename if it's not empty. */
-					if(ColorRule.strFilterPattern.size() > 0)
-					{
-						if(CheckWildcardMatch(ColorRule.strFilterPattern.c_str(),szFileName,!ColorRule.caseInsensitive) == 1)
-						{
-							bMatchFileName = TRUE;
-						}
-					}
-					else
-					{
-						bMatchFileName = TRUE;
-					}
-
-					if(ColorRule.dwFilterAttributes != 0)
-					{
-						if(ColorRule.dwFilterAttributes & dwAttributes)
-						{
-							bMatchAttributes = TRUE;
-						}
-					}
-					else
-					{
-						bMatchAttributes = TRUE;
-					}
-
-					if(bMatchFileName && bMatchAttributes)
-					{
-						pnmlvcd->clrText = ColorRule.rgbColour;
-						return CDRF_NEWFONT;
-					}
+					pnmlvcd->clrText = *color;
+					return CDRF_NEWFONT;
 				}
 			}
 			break;
@@ -1366,6 +1334,17 @@ LRESULT Explorerplusplus::OnCustomDraw(LPARAM lParam)
 	return 0;
 }
 
+void Explorerplusplus::UpdateColorRuleMatcher()
+{
+	m_colorRuleMatcher.Clear();
+
+	for(const auto &colorRule : m_ColorRules)
+	{
+		m_colorRuleMatcher.AddRule(colorRule.strFilterPattern, !colorRule.caseInsensitive,
+			colorRule.dwFilterAttributes, colorRule.rgbColour);
+	}
+}
+
 void Explorerplusplus::OnSortBy(SortMode sortMode)
 {
 	Tab &selectedTab = m_tabContainer->GetSelectedTab();
@@ -1428,6 +1407,88 @@ void Explorerplusplus::SaveAllSettings()
 	delete pLoadSave;
 }
 
+/* The column cache is only created once the settings have been
+loaded, since its size is configurable. */
+void Explorerplusplus::LoadColumnCache()
+{
+	m_columnCache = std::make_unique<ColumnCache>(m_config->columnCacheSize);
+
+	bool res = m_columnCache->LoadFromFile(GetColumnCacheFilePath());
+
+	if (res)
+	{
+		LOG(info) << _T("Loaded ") << m_columnCache->GetNumEntries() << _T(" entries from the column cache");
+	}
+}
+
+void Explorerplusplus::SaveColumnCache() const
+{
+	LOG(info) << _T("Column cache hits: ") << m_columnCache->GetNumHits()
+		<< _T(", misses: ") << m_columnCache->GetNumMisses();
+
+	m_columnCache->SaveToFile(GetColumnCacheFilePath());
+}
+
+std::wstring Explorerplusplus::GetColumnCacheFilePath()
+{
+	TCHAR cacheFilePath[MAX_PATH];
+	GetProcessImageName(GetCurrentProcessId(), cacheFilePath, SIZEOF_ARRAY(cacheFilePath));
+
+	PathRemoveFileSpec(cacheFilePath);
+	PathAppend(cacheFilePath, NExplorerplusplus::COLUMN_CACHE_FILENAME);
+
+	return cacheFilePath;
+}
+
+/* Thumbnails are always cached in memory (and shared between
+tabs). They're only saved to disk if that's been enabled, as the
+cache file can be large. */
+void Explorerplusplus::LoadThumbnailCache()
+{
+	m_thumbnailCache = std::make_unique<ThumbnailCache>(m_config->thumbnailCacheSize);
+
+	if (!m_config->saveThumbnailCache)
+	{
+		return;
+	}
+
+	bool res = m_thumbnailCache->LoadFromFile(GetThumbnailCacheFilePath());
+
+	if (res)
+	{
+		LOG(info) << _T("Loaded ") << m_thumbnailCache->GetNumEntries() << _T(" entries from the thumbnail cache");
+	}
+}
+
+void Explorerplusplus::SaveThumbnailCache() const
+{
+	LOG(info) << _T("Thumbnail cache hits: ") << m_thumbnailCache->GetNumHits()
+		<< _T(", misses: ") << m_thumbnailCache->GetNumMisses();
+
+	if (m_config->saveThumbnailCache)
+	{
+		m_thumbnailCache->SaveToFile(GetThumbnailCacheFilePath());
+	}
+	else
+	{
+		/* Any file left over from when the option was
+		enabled would otherwise be out of date if the
+		option was enabled again. */
+		DeleteFile(GetThumbnailCacheFilePath().c_str());
+	}
+}
+
+std::wstring Explorerplusplus::GetThumbnailCacheFilePath()
+{
+	TCHAR cacheFilePath[MAX_PATH];
+	GetProcessImageName(GetCurrentProcessId(), cacheFilePath, SIZEOF_ARRAY(cacheFilePath));
+
+	PathRemoveFileSpec(cacheFilePath);
+	PathAppend(cacheFilePath, NExplorerplusplus::THUMBNAIL_CACHE_FILENAME);
+
+	return cacheFilePath;
+}
+
 Config *Explorerplusplus::GetConfig() const
 {
 	return m_config.get();
@@ -1483,6 +1544,31 @@ CachedIcons *Explorerplusplus::GetCachedIcons()
 	return &m_cachedIcons;
 }
 
+ColumnCache *Explorerplusplus::GetColumnCache()
+{
+	return m_columnCache.get();
+}
+
+ThumbnailCache *Explorerplusplus::GetThumbnailCache()
+{
+	return m_thumbnailCache.get();
+}
+
+FolderSizeCalculator *Explorerplusplus::GetFolderSizeCalculator()
+{
+	return &m_folderSizeCalculator;
+}
+
+TaskScheduler *Explorerplusplus::GetTaskScheduler()
+{
+	return &m_taskScheduler;
+}
+
+const ColorRuleMatcher *Explorerplusplus::GetColorRuleMatcher() const
+{
+	return &m_colorRuleMatcher;
+}
+
 BOOL Explorerplusplus::GetSavePreferencesToXmlFile() const
 {
 	return m_bSavePreferencesToXMLFile;
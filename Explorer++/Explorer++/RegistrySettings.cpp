@@ -107,6 +107,9 @@ LONG Explorerplusplus::SaveGenericSettingsToRegistry()
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ShowFullTitlePath"),m_config->showFullTitlePath.get());
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("AlwaysOpenNewTab"),m_config->alwaysOpenNewTab);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("TreeViewWidth"), m_config->treeViewWidth);
+		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ColumnCacheSize"), m_config->columnCacheSize);
+		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ThumbnailCacheSize"), m_config->thumbnailCacheSize);
+		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("SaveThumbnailCache"), m_config->saveThumbnailCache);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ShowFriendlyDates"), m_config->globalFolderSettings.showFriendlyDates);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ShowDisplayWindow"),m_config->showDisplayWindow);
 		NRegistrySettings::SaveDwordToRegistry(hSettingsKey,_T("ShowFolderSizes"),m_config->globalFolderSettings.showFolderSizes);
@@ -230,6 +233,9 @@ LONG Explorerplusplus::LoadGenericSettingsFromRegistry()
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ShowApplicationToolbar"),(LPDWORD)&m_config->showApplicationToolbar);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("AlwaysOpenNewTab"),(LPDWORD)&m_config->alwaysOpenNewTab);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("TreeViewWidth"),(LPDWORD)&m_config->treeViewWidth);
+		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ColumnCacheSize"),&m_config->columnCacheSize);
+		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ThumbnailCacheSize"),&m_config->thumbnailCacheSize);
+		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("SaveThumbnailCache"),(LPDWORD)&m_config->saveThumbnailCache);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ShowFriendlyDates"),(LPDWORD)&m_config->globalFolderSettings.showFriendlyDates);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ShowDisplayWindow"),(LPDWORD)&m_config->showDisplayWindow);
 		NRegistrySettings::ReadDwordFromRegistry(hSettingsKey,_T("ShowFolderSizes"),(LPDWORD)&m_config->globalFolderSettings.showFolderSizes);
@@ -665,7 +671,7 @@ int Explorerplusplus::LoadTabSettingsFromRegistry()
 			TabSettings tabSettings;
 
 			tabSettings.index = i;
-			tabSettings.selected = true;
+			tabSettings.deferNavigation = true;
 
 			NRegistrySettings::ReadDwordFromRegistry(hTabKey,_T("Locked"),&value);
 
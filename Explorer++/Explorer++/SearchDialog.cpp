@@ -13,24 +13,20 @@
 #include "../Helper/ComboBox.h"
 #include "../Helper/Controls.h"
 #include "../Helper/FileContextMenuManager.h"
+#include "../Helper/FileSearcher.h"
 #include "../Helper/Helper.h"
 #include "../Helper/Macros.h"
 #include "../Helper/RegistrySettings.h"
 #include "../Helper/ShellHelper.h"
 #include "../Helper/WindowHelper.h"
 #include "../Helper/XMLSettings.h"
-#include <regex>
 
 namespace NSearchDialog
 {
-	const int		WM_APP_SEARCHITEMFOUND = WM_APP + 1;
 	const int		WM_APP_SEARCHFINISHED = WM_APP + 2;
-	const int		WM_APP_SEARCHCHANGEDDIRECTORY = WM_APP + 3;
-	const int		WM_APP_REGULAREXPRESSIONINVALID = WM_APP + 4;
 
 	int CALLBACK	SortResultsStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort);
 
-	DWORD WINAPI	SearchThread(LPVOID pParam);
 	int CALLBACK	BrowseCallbackProc(HWND hwnd,UINT uMsg,LPARAM lParam,LPARAM lpData);
 }
 
@@ -60,21 +56,17 @@ CSearchDialog::CSearchDialog(HINSTANCE hInstance, int iResource,
 	m_tabContainer(tabContainer),
 	m_bSearching(FALSE),
 	m_bStopSearching(FALSE),
-	m_bSetSearchTimer(TRUE),
 	m_iInternalIndex(0),
-	m_iPreviousSelectedColumn(-1),
-	m_pSearch(nullptr)
+	m_iPreviousSelectedColumn(-1)
 {
 	m_sdps = &CSearchDialogPersistentSettings::GetInstance();
 }
 
 CSearchDialog::~CSearchDialog()
 {
-	if(m_pSearch != NULL)
-	{
-		m_pSearch->StopSearching();
-		m_pSearch->Release();
-	}
+	/* If a search is still running, destroying the searcher
+	will stop it and wait for its threads to finish. */
+	m_fileSearcher.reset();
 }
 
 INT_PTR CSearchDialog::OnInitDialog()
@@ -331,7 +323,6 @@ void CSearchDialog::StartSearching()
 	ShowWindow(GetDlgItem(m_hDlg, IDC_LINK_STATUS), SW_HIDE);
 	ShowWindow(GetDlgItem(m_hDlg, IDC_STATIC_STATUS), SW_SHOW);
 
-	m_AwaitingSearchItems.clear();
 	m_SearchItemsMapInternal.clear();
 
 	ListView_DeleteAllItems(GetDlgItem(m_hDlg, IDC_LISTVIEW_SEARCHRESULTS));
@@ -388,9 +379,13 @@ void CSearchDialog::StartSearching()
 	if(IsDlgButtonChecked(m_hDlg, IDC_CHECK_SYSTEM) == BST_CHECKED)
 		dwAttributes |= FILE_ATTRIBUTE_SYSTEM;
 
-	m_pSearch = new CSearch(m_hDlg, szBaseDirectory, szSearchPattern,
-		dwAttributes, bUseRegularExpressions, bCaseInsensitive, bSearchSubFolders);
-	m_pSearch->AddRef();
+	FileSearcher::Options options;
+	options.baseDirectory = szBaseDirectory;
+	options.pattern = szSearchPattern;
+	options.useRegularExpressions = bUseRegularExpressions ? true : false;
+	options.caseInsensitive = bCaseInsensitive ? true : false;
+	options.searchSubFolders = bSearchSubFolders ? true : false;
+	options.attributes = dwAttributes;
 
 	/* Save the search directory and search pattern (only if they are not
 	the same as the most recent entry). */
@@ -420,6 +415,24 @@ void CSearchDialog::StartSearching()
 		SaveEntry(IDC_COMBO_NAME, m_sdps->m_searchPatterns);
 	}
 
+	m_fileSearcher = std::make_unique<FileSearcher>(options, FileSearcher::GetDefaultNumThreads());
+
+	/* The search is run in the background. Once it's finished,
+	a message will be posted back to this dialog. */
+	HWND hDlg = m_hDlg;
+	bool started = m_fileSearcher->Start([hDlg] (bool stopped) {
+		UNREFERENCED_PARAMETER(stopped);
+
+		PostMessage(hDlg, NSearchDialog::WM_APP_SEARCHFINISHED, 0, 0);
+	});
+
+	if(!started)
+	{
+		m_fileSearcher.reset();
+		ShowRegularExpressionError();
+		return;
+	}
+
 	GetDlgItemText(m_hDlg, IDSEARCH, m_szSearchButton, SIZEOF_ARRAY(m_szSearchButton));
 
 	TCHAR szTemp[64];
@@ -429,10 +442,24 @@ void CSearchDialog::StartSearching()
 
 	m_bSearching = TRUE;
 
-	/* Create a background thread, and search using it... */
-	HANDLE hThread = CreateThread(NULL, 0, NSearchDialog::SearchThread,
-		reinterpret_cast<LPVOID>(m_pSearch), 0, NULL);
-	CloseHandle(hThread);
+	/* Results are removed from the searcher and added to the
+	listview in batches. */
+	SetTimer(m_hDlg, SEARCH_PROCESSITEMS_TIMER_ID,
+		SEARCH_PROCESSITEMS_TIMER_ELAPSED, NULL);
+}
+
+void CSearchDialog::ShowRegularExpressionError()
+{
+	/* The link/status controls are in the same position, and
+	have the same size. If one of the controls is showing text,
+	the other should not be visible. */
+	ShowWindow(GetDlgItem(m_hDlg,IDC_LINK_STATUS),SW_SHOW);
+	ShowWindow(GetDlgItem(m_hDlg,IDC_STATIC_STATUS),SW_HIDE);
+
+	TCHAR szTemp[128];
+	LoadString(GetInstance(),IDS_SEARCH_REGULAR_EXPRESSION_INVALID,
+		szTemp,SIZEOF_ARRAY(szTemp));
+	SetDlgItemText(m_hDlg,IDC_LINK_STATUS,szTemp);
 }
 
 void CSearchDialog::SaveEntry(int comboBoxId, boost::circular_buffer<std::wstring> &buffer)
@@ -476,14 +503,14 @@ void CSearchDialog::StopSearching()
 {
 	m_bStopSearching = TRUE;
 
-	if(m_pSearch != NULL)
+	if(m_fileSearcher)
 	{
-		/* Note that m_pSearch does not need to be
-		released here. Once the search object finishes,
-		it will send a WM_APP_SEARCHFINISHED message.
-		The handler for this message will then release
-		m_pSearch. */
-		m_pSearch->StopSearching();
+		/* Note that m_fileSearcher does not need to be
+		destroyed here. Once the search threads have
+		finished, a WM_APP_SEARCHFINISHED message will be
+		posted. The handler for this message will then
+		destroy m_fileSearcher. */
+		m_fileSearcher->Stop();
 	}
 }
 
@@ -805,40 +832,38 @@ INT_PTR CSearchDialog::OnNotify(NMHDR *pnmhdr)
 
 INT_PTR CSearchDialog::OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
 {
+	UNREFERENCED_PARAMETER(wParam);
+	UNREFERENCED_PARAMETER(lParam);
+
 	switch(uMsg)
 	{
-		/* We won't actually process the item here. Instead, we'll
-		add it onto the list of current items, which will be processed
-		in batch. This is done to stop this message from blocking the
-		main GUI (also see http://www.flounder.com/iocompletion.htm). */
-		case NSearchDialog::WM_APP_SEARCHITEMFOUND:
+		case NSearchDialog::WM_APP_SEARCHFINISHED:
 			{
-				m_AwaitingSearchItems.push_back(reinterpret_cast<PIDLIST_ABSOLUTE>(wParam));
+				assert(m_fileSearcher);
 
-				if(m_bSetSearchTimer)
-				{
-					SetTimer(m_hDlg,SEARCH_PROCESSITEMS_TIMER_ID,
-						SEARCH_PROCESSITEMS_TIMER_ELAPSED,NULL);
+				KillTimer(m_hDlg,SEARCH_PROCESSITEMS_TIMER_ID);
 
-					m_bSetSearchTimer = FALSE;
-				}
-			}
-			break;
+				/* Any results that haven't been picked up by the timer
+				yet are added now. */
+				std::vector<FileSearcher::Result> results;
+
+				do
+				{
+					results = m_fileSearcher->TakeResults(SEARCH_MAX_ITEMS_BATCH_PROCESS);
+					AddSearchResults(results);
+				} while(!results.empty());
 
-		case NSearchDialog::WM_APP_SEARCHFINISHED:
-			{
 				TCHAR szStatus[512];
 
 				if(!m_bStopSearching)
 				{
-					int iFoldersFound = LOWORD(lParam);
-					int iFilesFound = HIWORD(lParam);
+					FileSearcher::Statistics statistics = m_fileSearcher->GetStatistics();
 
 					TCHAR szTemp[128];
 					LoadString(GetInstance(),IDS_SEARCH_FINISHED_MESSAGE,
 						szTemp,SIZEOF_ARRAY(szTemp));
 					StringCchPrintf(szStatus,SIZEOF_ARRAY(szStatus),szTemp,
-						iFoldersFound,iFilesFound);
+						statistics.numFoldersFound,statistics.numFilesFound);
 					SetDlgItemText(m_hDlg,IDC_STATIC_STATUS,szStatus);
 				}
 				else
@@ -849,100 +874,85 @@ INT_PTR CSearchDialog::OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
 					SetDlgItemText(m_hDlg,IDC_STATIC_STATUS,szTemp);
 				}
 
-				assert(m_pSearch != NULL);
-
-				m_pSearch->Release();
-				m_pSearch = NULL;
+				m_fileSearcher.reset();
 
 				m_bSearching = FALSE;
 				m_bStopSearching = FALSE;
 				SetDlgItemText(m_hDlg,IDSEARCH,m_szSearchButton);
 			}
 			break;
+	}
 
-		case NSearchDialog::WM_APP_SEARCHCHANGEDDIRECTORY:
-			{
-				TCHAR szStatus[512];
-				TCHAR *pszDirectory = NULL;
-
-				pszDirectory = reinterpret_cast<TCHAR *>(wParam);
-
-				TCHAR szTemp[64];
-				LoadString(GetInstance(),IDS_SEARCHING,
-					szTemp,SIZEOF_ARRAY(szTemp));
-				StringCchPrintf(szStatus,SIZEOF_ARRAY(szStatus),szTemp,
-					pszDirectory);
-				SetDlgItemText(m_hDlg,IDC_STATIC_STATUS,szStatus);
-			}
-			break;
+	return 0;
+}
 
-		case NSearchDialog::WM_APP_REGULAREXPRESSIONINVALID:
-			{
-				/* The link/status controls are in the same position, and
-				have the same size. If one of the controls is showing text,
-				the other should not be visible. */
-				ShowWindow(GetDlgItem(m_hDlg,IDC_LINK_STATUS),SW_SHOW);
-				ShowWindow(GetDlgItem(m_hDlg,IDC_STATIC_STATUS),SW_HIDE);
+INT_PTR CSearchDialog::OnTimer(int iTimerID)
+{
+	if(iTimerID != SEARCH_PROCESSITEMS_TIMER_ID)
+	{
+		return 1;
+	}
 
-				/* The regular expression passed to the search
-				thread was invalid. Show the user an error message. */
-				TCHAR szTemp[128];
-				LoadString(GetInstance(),IDS_SEARCH_REGULAR_EXPRESSION_INVALID,
-					szTemp,SIZEOF_ARRAY(szTemp));
-				SetDlgItemText(m_hDlg,IDC_LINK_STATUS,szTemp);
+	if(!m_fileSearcher)
+	{
+		return 0;
+	}
 
-				assert(m_pSearch != NULL);
+	/* Results are only removed from the searcher here (rather than
+	being sent individually), so that the search threads never block
+	the GUI. */
+	AddSearchResults(m_fileSearcher->TakeResults(SEARCH_MAX_ITEMS_BATCH_PROCESS));
 
-				m_pSearch->Release();
-				m_pSearch = NULL;
+	if(!m_bStopSearching)
+	{
+		std::wstring currentDirectory = m_fileSearcher->GetCurrentSearchDirectory();
 
-				m_bSearching = FALSE;
-				m_bStopSearching = FALSE;
-				SetDlgItemText(m_hDlg,IDSEARCH,m_szSearchButton);
-			}
-			break;
+		if(!currentDirectory.empty())
+		{
+			TCHAR szStatus[512];
+			TCHAR szTemp[64];
+			LoadString(GetInstance(),IDS_SEARCHING,
+				szTemp,SIZEOF_ARRAY(szTemp));
+			StringCchPrintf(szStatus,SIZEOF_ARRAY(szStatus),szTemp,
+				currentDirectory.c_str());
+			SetDlgItemText(m_hDlg,IDC_STATIC_STATUS,szStatus);
+		}
 	}
 
 	return 0;
 }
 
-INT_PTR CSearchDialog::OnTimer(int iTimerID)
+void CSearchDialog::AddSearchResults(const std::vector<FileSearcher::Result> &results)
 {
-	if(iTimerID != SEARCH_PROCESSITEMS_TIMER_ID)
+	if(results.empty())
 	{
-		return 1;
+		return;
 	}
 
 	HWND hListView = GetDlgItem(m_hDlg,IDC_LISTVIEW_SEARCHRESULTS);
 	int nListViewItems = ListView_GetItemCount(hListView);
 
-	int nItems = min(static_cast<int>(m_AwaitingSearchItems.size()),
-		SEARCH_MAX_ITEMS_BATCH_PROCESS);
-	int i = 0;
+	SendMessage(hListView,WM_SETREDRAW,FALSE,0);
 
-	auto itr = m_AwaitingSearchItems.begin();
+	int i = 0;
 
-	while(i < nItems)
+	for(const auto &result : results)
 	{
-		TCHAR szFullFileName[MAX_PATH];
 		TCHAR szDirectory[MAX_PATH];
 		TCHAR szFileName[MAX_PATH];
 		LVITEM lvItem;
 		SHFILEINFO shfi;
 		int iIndex;
 
-		PIDLIST_ABSOLUTE pidl = *itr;
-
-		GetDisplayName(pidl,szDirectory,SIZEOF_ARRAY(szDirectory),SHGDN_FORPARSING);
+		StringCchCopy(szDirectory,SIZEOF_ARRAY(szDirectory),result.path.c_str());
 		PathRemoveFileSpec(szDirectory);
 
-		GetDisplayName(pidl,szFullFileName,SIZEOF_ARRAY(szFullFileName),SHGDN_FORPARSING);
-		GetDisplayName(pidl,szFileName,SIZEOF_ARRAY(szFileName),SHGDN_INFOLDER|SHGDN_FORPARSING);
+		StringCchCopy(szFileName,SIZEOF_ARRAY(szFileName),PathFindFileName(result.path.c_str()));
 
-		SHGetFileInfo((LPCWSTR)pidl,0,&shfi,sizeof(shfi),SHGFI_PIDL|SHGFI_SYSICONINDEX);
+		SHGetFileInfo(result.path.c_str(),0,&shfi,sizeof(shfi),SHGFI_SYSICONINDEX);
 
 		m_SearchItemsMapInternal.insert(std::unordered_map<int,std::wstring>::value_type(m_iInternalIndex,
-			szFullFileName));
+			result.path));
 
 		lvItem.mask		= LVIF_IMAGE|LVIF_TEXT|LVIF_PARAM;
 		lvItem.pszText	= szFileName;
@@ -954,16 +964,10 @@ INT_PTR CSearchDialog::OnTimer(int iTimerID)
 
 		ListView_SetItemText(hListView,iIndex,1,szDirectory);
 
-		CoTaskMemFree(pidl);
-
-		itr = m_AwaitingSearchItems.erase(itr);
-
 		i++;
 	}
 
-	m_bSetSearchTimer = TRUE;
-
-	return 0;
+	SendMessage(hListView,WM_SETREDRAW,TRUE,0);
 }
 
 INT_PTR CSearchDialog::OnClose()
@@ -980,221 +984,6 @@ INT_PTR CSearchDialog::OnNcDestroy()
 	return 0;
 }
 
-DWORD WINAPI NSearchDialog::SearchThread(LPVOID pParam)
-{
-	assert(pParam != NULL);
-
-	CSearch *pSearch = reinterpret_cast<CSearch *>(pParam);
-	pSearch->StartSearching();
-
-	return 0;
-}
-
-CSearch::CSearch(HWND hDlg,TCHAR *szBaseDirectory,
-	TCHAR *szPattern,DWORD dwAttributes,BOOL bUseRegularExpressions,
-	BOOL bCaseInsensitive,BOOL bSearchSubFolders)
-{
-	m_hDlg = hDlg;
-	m_dwAttributes = dwAttributes;
-	m_bUseRegularExpressions = bUseRegularExpressions;
-	m_bCaseInsensitive = bCaseInsensitive;
-	m_bSearchSubFolders = bSearchSubFolders;
-
-	StringCchCopy(m_szBaseDirectory,SIZEOF_ARRAY(m_szBaseDirectory),
-		szBaseDirectory);
-	StringCchCopy(m_szSearchPattern,SIZEOF_ARRAY(m_szSearchPattern),
-		szPattern);
-
-	InitializeCriticalSection(&m_csStop);
-	m_bStopSearching = FALSE;
-}
-
-CSearch::~CSearch()
-{
-	DeleteCriticalSection(&m_csStop);
-}
-
-void CSearch::StartSearching()
-{
-	m_iFoldersFound = 0;
-	m_iFilesFound = 0;
-
-	if(lstrcmp(m_szSearchPattern,EMPTY_STRING) != 0 &&
-		m_bUseRegularExpressions)
-	{
-		try
-		{
-			if(m_bCaseInsensitive)
-			{
-				m_rxPattern.assign(m_szSearchPattern,std::regex_constants::icase);
-			}
-			else
-			{
-				m_rxPattern.assign(m_szSearchPattern);
-			}
-		}
-		catch(std::exception)
-		{
-			SendMessage(m_hDlg,NSearchDialog::WM_APP_REGULAREXPRESSIONINVALID,
-				0,0);
-
-			return;
-		}
-	}
-
-	SearchDirectory(m_szBaseDirectory);
-
-	SendMessage(m_hDlg,NSearchDialog::WM_APP_SEARCHFINISHED,0,
-		MAKELPARAM(m_iFoldersFound,m_iFilesFound));
-
-	Release();
-}
-
-void CSearch::SearchDirectory(const TCHAR *szDirectory)
-{
-	SendMessage(m_hDlg,NSearchDialog::WM_APP_SEARCHCHANGEDDIRECTORY,
-		reinterpret_cast<WPARAM>(szDirectory),0);
-
-	std::list<std::wstring> SubFolderList;
-
-	SearchDirectoryInternal(szDirectory,&SubFolderList);
-
-	bool bStop = false;
-
-	EnterCriticalSection(&m_csStop);
-	if(m_bStopSearching)
-	{
-		bStop = true;
-	}
-	LeaveCriticalSection(&m_csStop);
-
-	if(bStop)
-	{
-		return;
-	}
-
-	if(m_bSearchSubFolders)
-	{
-		for(const auto &strSubFolder : SubFolderList)
-		{
-			SearchDirectory(strSubFolder.c_str());
-		}
-	}
-}
-
-/* Can't recurse, as it would overflow the stack. */
-void CSearch::SearchDirectoryInternal(const TCHAR *szSearchDirectory,
-	std::list<std::wstring> *pSubFolderList)
-{
-	assert(szSearchDirectory != NULL);
-	assert(pSubFolderList != NULL);
-
-	WIN32_FIND_DATA wfd;
-	TCHAR szSearchTerm[MAX_PATH];
-
-	PathCombine(szSearchTerm,szSearchDirectory,_T("*"));
-
-	HANDLE hFindFile = FindFirstFile(szSearchTerm,&wfd);
-
-	if(hFindFile != INVALID_HANDLE_VALUE)
-	{
-		bool bStop = false;
-
-		while(FindNextFile(hFindFile,&wfd) != 0 && !bStop)
-		{
-			if(lstrcmpi(wfd.cFileName,_T(".")) != 0 &&
-				lstrcmpi(wfd.cFileName,_T("..")) != 0)
-			{
-				BOOL bMatchFileName = FALSE;
-				BOOL bMatchAttributes = FALSE;
-
-				/* Only match against the filename if it's not empty. */
-				if(lstrcmp(m_szSearchPattern,EMPTY_STRING) != 0)
-				{
-					if(m_bUseRegularExpressions)
-					{
-						if(std::regex_match(wfd.cFileName,m_rxPattern))
-						{
-							bMatchFileName = TRUE;
-						}
-					}
-					else
-					{
-						if(CheckWildcardMatch(m_szSearchPattern,wfd.cFileName,!m_bCaseInsensitive))
-						{
-							bMatchFileName = TRUE;
-						}
-					}
-				}
-				else
-				{
-					/* No filename constraint, so all filenames match. */
-					bMatchFileName = TRUE;
-				}
-
-				if(m_dwAttributes != 0)
-				{
-					if((wfd.dwFileAttributes & m_dwAttributes) == m_dwAttributes)
-					{
-						bMatchAttributes = TRUE;
-					}
-				}
-				else
-				{
-					bMatchAttributes = TRUE;
-				}
-
-				BOOL bItemMatch = bMatchFileName && bMatchAttributes;
-
-				if(bItemMatch)
-				{
-					if((wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ==
-						FILE_ATTRIBUTE_DIRECTORY)
-						m_iFoldersFound++;
-					else
-						m_iFilesFound++;
-
-					TCHAR szFullFileName[MAX_PATH];
-					PathCombine(szFullFileName,szSearchDirectory,wfd.cFileName);
-
-					unique_pidl_absolute pidl;
-					SHParseDisplayName(szFullFileName, nullptr, wil::out_param(pidl), 0, nullptr);
-
-					PostMessage(m_hDlg,NSearchDialog::WM_APP_SEARCHITEMFOUND,
-						reinterpret_cast<WPARAM>(ILCloneFull(pidl.get())),0);
-				}
-
-				if((wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ==
-					FILE_ATTRIBUTE_DIRECTORY)
-				{
-					TCHAR szSubFolder[MAX_PATH];
-
-					PathCombine(szSubFolder,szSearchDirectory,
-						wfd.cFileName);
-
-					pSubFolderList->push_back(szSubFolder);
-				}
-			}
-
-			EnterCriticalSection(&m_csStop);
-			if(m_bStopSearching)
-			{
-				bStop = true;
-			}
-			LeaveCriticalSection(&m_csStop);
-		}
-
-		FindClose(hFindFile);
-	}
-}
-
-void CSearch::StopSearching()
-{
-	EnterCriticalSection(&m_csStop);
-	m_bStopSearching = TRUE;
-	LeaveCriticalSection(&m_csStop);
-}
-
 void CSearchDialog::SaveState()
 {
 	HWND hListView;
@@ -9,12 +9,12 @@
 #include "../Helper/BaseDialog.h"
 #include "../Helper/DialogSettings.h"
 #include "../Helper/FileContextMenuManager.h"
-#include "../Helper/ReferenceCount.h"
+#include "../Helper/FileSearcher.h"
 #include <boost/circular_buffer.hpp>
 #include <MsXml2.h>
 #include <objbase.h>
 #include <list>
-#include <regex>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -99,39 +99,6 @@ private:
 	int							m_iColumnWidth2;
 };
 
-class CSearch : public CReferenceCount
-{
-public:
-	
-	CSearch(HWND hDlg,TCHAR *szBaseDirectory,TCHAR *szPattern,DWORD dwAttributes,BOOL bUseRegularExpressions,BOOL bCaseInsensitive,BOOL bSearchSubFolders);
-	~CSearch();
-
-	void				StartSearching();
-	void				StopSearching();
-
-private:
-
-	void				SearchDirectory(const TCHAR *szDirectory);
-	void				SearchDirectoryInternal(const TCHAR *szSearchDirectory,std::list<std::wstring> *pSubFolderList);
-
-	HWND				m_hDlg;
-
-	TCHAR				m_szBaseDirectory[MAX_PATH];
-	TCHAR				m_szSearchPattern[MAX_PATH + 2];
-	DWORD				m_dwAttributes;
-	BOOL				m_bUseRegularExpressions;
-	BOOL				m_bCaseInsensitive;
-	BOOL				m_bSearchSubFolders;
-
-	std::wregex			m_rxPattern;
-
-	CRITICAL_SECTION	m_csStop;
-	BOOL				m_bStopSearching;
-
-	int					m_iFoldersFound;
-	int					m_iFilesFound;
-};
-
 class CSearchDialog : public CBaseDialog, public IFileContextMenuExternal
 {
 public:
@@ -167,7 +134,7 @@ private:
 
 	static const int SEARCH_PROCESSITEMS_TIMER_ID = 0;
 	static const int SEARCH_PROCESSITEMS_TIMER_ELAPSED = 50;
-	static const int SEARCH_MAX_ITEMS_BATCH_PROCESS = 100;
+	static const int SEARCH_MAX_ITEMS_BATCH_PROCESS = 1000;
 
 	static const int MIN_SHELL_MENU_ID = 1;
 	static const int MAX_SHELL_MENU_ID = 1000;
@@ -182,6 +149,8 @@ private:
 	void						StopSearching();
 	void						SaveEntry(int comboBoxId, boost::circular_buffer<std::wstring> &buffer);
 	void						UpdateListViewHeader();
+	void						ShowRegularExpressionError();
+	void						AddSearchResults(const std::vector<FileSearcher::Result> &results);
 
 	std::wstring m_searchDirectory;
 	wil::unique_hicon m_directoryIcon;
@@ -189,16 +158,13 @@ private:
 	BOOL m_bStopSearching;
 	TCHAR m_szSearchButton[32];
 
-	CSearch *m_pSearch;
+	std::unique_ptr<FileSearcher> m_fileSearcher;
 
 	/* Listview item information. */
-	std::list<PIDLIST_ABSOLUTE> m_AwaitingSearchItems;
 	std::unordered_map<int,std::wstring> m_SearchItemsMapInternal;
 	int m_iInternalIndex;
 	int m_iPreviousSelectedColumn;
 
-	BOOL m_bSetSearchTimer;
-
 	IExplorerplusplus *m_pexpp;
 	TabContainer *m_tabContainer;
 
@@ -12,10 +12,14 @@
 #include "../Helper/FolderSize.h"
 #include "../Helper/Helper.h"
 #include "../Helper/ListViewHelper.h"
+#include "../Helper/Logging.h"
 #include "../Helper/Macros.h"
 #include "../Helper/ShellHelper.h"
 #include <wil/com.h>
+#include <functional>
 #include <list>
+#include <thread>
+#include <unordered_set>
 
 HRESULT CShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHistoryEntry)
 {
@@ -25,18 +29,39 @@ HRESULT CShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHis
 		SetCursor(LoadCursor(NULL, IDC_ARROW));
 	});
 
+	if(m_folderPending)
+	{
+		/* The pending folder was never shown, so if it's being
+		browsed now (e.g. because the tab was refreshed), its
+		history entry still needs to be added. */
+		if(CompareIdls(pidlDirectory, m_directoryState.pidlDirectory.get()))
+		{
+			addHistoryEntry = addHistoryEntry || m_pendingAddHistoryEntry;
+		}
+
+		m_folderPending = false;
+	}
+
 	if(m_bFolderVisited)
 	{
 		SaveColumnWidths();
 	}
 
+	CancelEnumeration();
 	ClearPendingResults();
 
 	EnterCriticalSection(&m_csDirectoryAltered);
+
+	/* Any items added from here on belong to the new folder. The
+	folder id is also read by the directory monitoring thread. */
+	m_uniqueFolderId++;
+
 	m_FilesAdded.clear();
 	m_FileSelectionList.clear();
 	LeaveCriticalSection(&m_csDirectoryAltered);
 
+	m_pendingFileSelection.reset();
+
 	TCHAR szParsingPath[MAX_PATH];
 	GetDisplayName(pidlDirectory,szParsingPath,SIZEOF_ARRAY(szParsingPath),SHGDN_FORPARSING);
 
@@ -45,12 +70,21 @@ HRESULT CShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHis
 
 	StringCchCopy(m_CurDir,SIZEOF_ARRAY(m_CurDir),szParsingPath);
 
+	/* Changes made within subfolders aren't monitored, so the
+	folder sizes remembered for this folder are discarded each
+	time it's browsed (e.g. when it's refreshed). */
+	if(m_folderSizeCalculator)
+	{
+		m_folderSizeCalculator->InvalidateCachedTotals(m_CurDir);
+	}
+
 	/* Stop the list view from redrawing itself each time is inserted.
-	Redrawing will be allowed once all items have being inserted.
-	(reduces lag when a large number of items are going to be inserted). */
+	Redrawing will be allowed once the first set of items has been
+	inserted (see ProcessEnumerationBatches()). */
 	SendMessage(m_hListView, WM_SETREDRAW, FALSE, NULL);
 
 	ListView_DeleteAllItems(m_hListView);
+	m_itemRowIndex.Clear();
 
 	if(m_bFolderVisited)
 	{
@@ -59,8 +93,6 @@ HRESULT CShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHis
 
 	m_nTotalItems = 0;
 
-	EnumerateFolder(pidlDirectory);
-
 	/* Window updates needs these to be set. */
 	m_NumFilesSelected = 0;
 	m_NumFoldersSelected = 0;
@@ -68,45 +100,69 @@ HRESULT CShellBrowser::BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHis
 	m_ulTotalDirSize.QuadPart = 0;
 	m_ulFileSelectionSize.QuadPart = 0;
 
+	DetermineFolderVirtual(pidlDirectory);
+	m_directoryState.pidlDirectory.reset(ILCloneFull(pidlDirectory));
+
 	SetActiveColumnSet();
 	SetViewModeInternal(m_folderSettings.viewMode);
 
-	InsertAwaitingItems(FALSE);
-
 	VerifySortMode();
-	SortFolder(m_folderSettings.sortMode);
-
-	ListView_EnsureVisible(m_hListView,0,FALSE);
 
-	/* Allow the listview to redraw itself once again. */
-	SendMessage(m_hListView,WM_SETREDRAW,TRUE,NULL);
-
-	/* Set the focus back to the first item. */
-	ListView_SetItemState(m_hListView, 0, LVIS_FOCUSED, LVIS_FOCUSED);
+	/* The items themselves are enumerated on a background thread
+	and inserted into the listview as they arrive. */
+	StartEnumeration(pidlDirectory);
 
 	m_bFolderVisited = TRUE;
 
 	PlayNavigationSound();
 
-	m_uniqueFolderId++;
-
 	navigationCompletedSignal.m_signal(pidlDirectory, addHistoryEntry);
 
 	return S_OK;
 }
 
+void CShellBrowser::SetPendingFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHistoryEntry)
+{
+	assert(!m_bFolderVisited);
+
+	/* Only enough state is set here for the directory to be
+	queried (e.g. to name the tab or save it on exit). */
+	m_directoryState.pidlDirectory.reset(ILCloneFull(pidlDirectory));
+	GetDisplayName(pidlDirectory, m_CurDir, SIZEOF_ARRAY(m_CurDir), SHGDN_FORPARSING);
+
+	m_folderPending = true;
+	m_pendingAddHistoryEntry = addHistoryEntry;
+}
+
+bool CShellBrowser::HasPendingFolder() const
+{
+	return m_folderPending;
+}
+
+HRESULT CShellBrowser::BrowsePendingFolder()
+{
+	assert(m_folderPending);
+
+	auto pidlDirectory = GetDirectoryIdl();
+	return BrowseFolder(pidlDirectory.get(), m_pendingAddHistoryEntry);
+}
+
 void CShellBrowser::ClearPendingResults()
 {
-	m_columnThreadPool.clear_queue();
-	m_columnResults.clear();
+	ClearColumnResults();
 
 	m_iconFetcher->ClearQueue();
 
-	m_thumbnailThreadPool.clear_queue();
-	m_thumbnailResults.clear();
+	ClearThumbnailResults();
 
-	m_infoTipsThreadPool.clear_queue();
+	m_infoTipsTaskQueue->Cancel();
 	m_infoTipResults.clear();
+
+	ClearGroupResults();
+
+	CancelFolderSizeCalculations();
+
+	ClearResyncResults();
 }
 
 void CShellBrowser::ResetFolderState()
@@ -125,86 +181,323 @@ void CShellBrowser::ResetFolderState()
 		ListView_SetImageList(m_hListView, himl, LVSIL_NORMAL);
 
 		ImageList_Destroy(himlOld);
+
+		m_iconThumbnailImages.clear();
 	}
 
 	m_directoryState = DirectoryState();
 
 	EnterCriticalSection(&m_csDirectoryAltered);
-	m_AlteredList.clear();
+	m_changeJournal.Clear();
+	m_resyncRequired = false;
 	LeaveCriticalSection(&m_csDirectoryAltered);
 
 	m_itemInfoMap.clear();
+	m_itemNameIndex.Clear();
 	m_cachedFolderSizes.clear();
 	m_FilteredItemsList.clear();
 	m_AwaitingAddList.clear();
 }
 
-HRESULT CShellBrowser::EnumerateFolder(PCIDLIST_ABSOLUTE pidlDirectory)
+void CShellBrowser::StartEnumeration(PCIDLIST_ABSOLUTE pidlDirectory)
 {
-	DetermineFolderVirtual(pidlDirectory);
+	auto context = std::make_shared<EnumerationContext_t>();
+	context->pidlDirectory.reset(ILCloneFull(pidlDirectory));
+	context->enumFlags = GetEnumerationFlags();
+	context->virtualFolder = m_bVirtualFolder ? true : false;
+	context->folderId = m_uniqueFolderId;
+	context->cancelled = false;
+
+	m_enumerationContext = context;
+	m_enumerationStartTime = std::chrono::steady_clock::now();
+	m_firstEnumerationBatchProcessed = false;
+
+	/* The enumeration can block for a long time (either within
+	the folder's enumerator, or while waiting for the UI thread to
+	consume batches), so it's run on its own thread, rather than
+	tying up one of the shared task scheduler threads. The thread
+	only refers to the context, so it can be left to finish by
+	itself once it's been cancelled. */
+	std::thread([listView = m_hListView, owner = m_hOwner, context] {
+		CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+		EnumerateFolderAsync(listView, owner, context);
+		CoUninitialize();
+	}).detach();
+}
+
+SHCONTF CShellBrowser::GetEnumerationFlags() const
+{
+	SHCONTF enumFlags = SHCONTF_FOLDERS | SHCONTF_NONFOLDERS;
+
+	if (m_folderSettings.showHidden)
+	{
+		enumFlags |= SHCONTF_INCLUDEHIDDEN | SHCONTF_INCLUDESUPERHIDDEN;
+	}
+
+	return enumFlags;
+}
+
+void CShellBrowser::EnumerateFolderAsync(HWND listView, HWND owner, std::shared_ptr<EnumerationContext_t> context)
+{
+	EnumerationBatch_t batch;
+	batch.finished = false;
 
 	wil::com_ptr<IShellFolder> pShellFolder;
-	HRESULT hr = BindToIdl(pidlDirectory, IID_PPV_ARGS(&pShellFolder));
+	HRESULT hr = BindToIdl(context->pidlDirectory.get(), IID_PPV_ARGS(&pShellFolder));
 
-	if (FAILED(hr))
+	wil::com_ptr<IEnumIDList> pEnumIDList;
+
+	if (SUCCEEDED(hr))
 	{
-		return hr;
+		hr = pShellFolder->EnumObjects(owner, context->enumFlags, &pEnumIDList);
 	}
 
-	m_directoryState.pidlDirectory.reset(ILCloneFull(pidlDirectory));
+	if (SUCCEEDED(hr) && pEnumIDList)
+	{
+		auto batchStartTime = std::chrono::steady_clock::now();
+		auto batchInterval = ENUMERATION_FIRST_BATCH_INTERVAL;
 
-	SHCONTF enumFlags = SHCONTF_FOLDERS | SHCONTF_NONFOLDERS;
+		PITEMID_CHILD fetchedItems[ENUMERATION_FETCH_SIZE];
+		ULONG uFetched;
 
-	if (m_folderSettings.showHidden)
+		do
+		{
+			uFetched = 0;
+			hr = pEnumIDList->Next(ENUMERATION_FETCH_SIZE, fetchedItems, &uFetched);
+
+			for (ULONG i = 0; i < uFetched; i++)
+			{
+				unique_pidl_child pidlItem(fetchedItems[i]);
+
+				ULONG uAttributes = SFGAO_FOLDER;
+				PCITEMID_CHILD items[] = { pidlItem.get() };
+				pShellFolder->GetAttributesOf(1, items, &uAttributes);
+
+				STRRET str;
+				HRESULT hrDisplayName;
+
+				/* If this is a virtual folder, only use SHGDN_INFOLDER. If this is
+				a real folder, combine SHGDN_INFOLDER with SHGDN_FORPARSING. This is
+				so that items in real folders can still be shown with extensions, even
+				if the global, Explorer option is disabled.
+				Also use only SHGDN_INFOLDER if this item is a folder. This is to ensure
+				that specific folders in Windows 7 (those under C:\Users\Username) appear
+				correctly. */
+				if (context->virtualFolder || (uAttributes & SFGAO_FOLDER))
+				{
+					hrDisplayName = pShellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER, &str);
+				}
+				else
+				{
+					hrDisplayName = pShellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER | SHGDN_FORPARSING, &str);
+				}
+
+				if (SUCCEEDED(hrDisplayName))
+				{
+					TCHAR szFileName[MAX_PATH];
+					StrRetToBuf(&str, pidlItem.get(), szFileName, SIZEOF_ARRAY(szFileName));
+
+					batch.items.push_back(BuildItemInfo(context->pidlDirectory.get(), pidlItem.get(), szFileName));
+				}
+			}
+
+			if (context->cancelled)
+			{
+				return;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+
+			if (hr == S_OK && !batch.items.empty()
+				&& (batch.items.size() >= ENUMERATION_MAX_BATCH_SIZE || (now - batchStartTime) >= batchInterval))
+			{
+				if (!QueueEnumerationBatch(listView, *context, std::move(batch)))
+				{
+					return;
+				}
+
+				batch = EnumerationBatch_t();
+				batch.finished = false;
+
+				batchStartTime = now;
+				batchInterval = ENUMERATION_BATCH_INTERVAL;
+			}
+		} while (hr == S_OK);
+	}
+
+	batch.finished = true;
+	QueueEnumerationBatch(listView, *context, std::move(batch));
+}
+
+/* Hands a batch of items over to the UI thread. If too many
+batches are already waiting, this will block until the UI thread
+catches up. Returns false if the enumeration was cancelled. */
+bool CShellBrowser::QueueEnumerationBatch(HWND listView, EnumerationContext_t &context, EnumerationBatch_t batch)
+{
+	std::unique_lock<std::mutex> lock(context.mutex);
+
+	context.batchConsumed.wait(lock, [&context] {
+		return context.cancelled || context.pendingBatches.size() < ENUMERATION_MAX_PENDING_BATCHES;
+	});
+
+	if (context.cancelled)
 	{
-		enumFlags |= SHCONTF_INCLUDEHIDDEN | SHCONTF_INCLUDESUPERHIDDEN;
+		return false;
 	}
 
-	wil::com_ptr<IEnumIDList> pEnumIDList;
-	hr = pShellFolder->EnumObjects(m_hOwner, enumFlags, &pEnumIDList);
+	/* The UI thread processes all pending batches in one go, so
+	it only needs to be notified when the queue was empty. */
+	bool notify = context.pendingBatches.empty();
+
+	context.pendingBatches.push_back(std::move(batch));
+
+	lock.unlock();
+
+	if (notify)
+	{
+		PostMessage(listView, WM_APP_ENUMERATION_BATCH_READY, context.folderId, 0);
+	}
 
-	if (FAILED(hr) || !pEnumIDList)
+	return true;
+}
+
+void CShellBrowser::ProcessEnumerationBatches(int folderId)
+{
+	/* The batches may belong to a folder that has since been
+	navigated away from. */
+	if (!m_enumerationContext || m_enumerationContext->folderId != folderId)
 	{
-		return hr;
+		return;
 	}
 
-	ULONG uFetched = 1;
-	unique_pidl_child pidlItem;
+	std::deque<EnumerationBatch_t> batches;
 
-	while (pEnumIDList->Next(1, wil::out_param(pidlItem), &uFetched) == S_OK && (uFetched == 1))
 	{
-		ULONG uAttributes = SFGAO_FOLDER;
-		PCITEMID_CHILD items[] = { pidlItem.get() };
-		pShellFolder->GetAttributesOf(1, items, &uAttributes);
+		std::lock_guard<std::mutex> lock(m_enumerationContext->mutex);
+		batches.swap(m_enumerationContext->pendingBatches);
+	}
+
+	m_enumerationContext->batchConsumed.notify_all();
 
-		STRRET str;
+	bool finished = false;
 
-		/* If this is a virtual folder, only use SHGDN_INFOLDER. If this is
-		a real folder, combine SHGDN_INFOLDER with SHGDN_FORPARSING. This is
-		so that items in real folders can still be shown with extensions, even
-		if the global, Explorer option is disabled.
-		Also use only SHGDN_INFOLDER if this item is a folder. This is to ensure
-		that specific folders in Windows 7 (those under C:\Users\Username) appear
-		correctly. */
-		if (m_bVirtualFolder || (uAttributes & SFGAO_FOLDER))
+	for (auto &batch : batches)
+	{
+		for (auto &item : batch.items)
 		{
-			hr = pShellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER, &str);
+			int itemId = GenerateUniqueItemId();
+			m_itemNameIndex.AddItem(itemId, item.wfd.cFileName, item.wfd.cAlternateFileName);
+			m_itemInfoMap.emplace(itemId, std::move(item));
+
+			AddItemInternal(-1, itemId, FALSE);
 		}
-		else
+
+		if (batch.finished)
 		{
-			hr = pShellFolder->GetDisplayNameOf(pidlItem.get(), SHGDN_INFOLDER | SHGDN_FORPARSING, &str);
+			finished = true;
 		}
+	}
 
-		if (SUCCEEDED(hr))
-		{
-			TCHAR szFileName[MAX_PATH];
-			StrRetToBuf(&str, pidlItem.get(), szFileName, SIZEOF_ARRAY(szFileName));
+	if (!m_firstEnumerationBatchProcessed)
+	{
+		InsertAwaitingItems(FALSE);
+		SortFolder(m_folderSettings.sortMode);
+
+		ListView_EnsureVisible(m_hListView, 0, FALSE);
+
+		/* Allow the listview to redraw itself once again. */
+		SendMessage(m_hListView, WM_SETREDRAW, TRUE, NULL);
+
+		/* Set the focus back to the first item. */
+		ListView_SetItemState(m_hListView, 0, LVIS_FOCUSED, LVIS_FOCUSED);
 
-			AddItemInternal(pidlDirectory, pidlItem.get(), szFileName, -1, FALSE);
+		m_enumerationMetrics.timeToFirstItem = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - m_enumerationStartTime);
+		m_firstEnumerationBatchProcessed = true;
+	}
+	else
+	{
+		/* Resorting the entire folder each time a batch arrives
+		would be too expensive in large folders, so subsequent
+		batches are simply appended. The folder is sorted once the
+		enumeration has finished. */
+		SendMessage(m_hListView, WM_SETREDRAW, FALSE, NULL);
+
+		InsertAwaitingItems(m_folderSettings.showInGroups);
+
+		if (finished)
+		{
+			SortFolder(m_folderSettings.sortMode);
 		}
+
+		SendMessage(m_hListView, WM_SETREDRAW, TRUE, NULL);
 	}
 
-	return hr;
+	if (finished)
+	{
+		OnEnumerationCompleted();
+	}
+
+	SendMessage(m_hOwner, WM_USER_DIRECTORYMODIFIED, m_ID, 0);
+}
+
+void CShellBrowser::OnEnumerationCompleted()
+{
+	m_enumerationMetrics.totalTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - m_enumerationStartTime);
+	m_enumerationMetrics.numItems = static_cast<int>(m_itemInfoMap.size());
+
+	LOG(debug) << _T("ShellBrowser - Enumerated ") << m_enumerationMetrics.numItems
+		<< _T(" items in \"") << m_CurDir << _T("\" (first items after ")
+		<< m_enumerationMetrics.timeToFirstItem.count() << _T("ms, total ")
+		<< m_enumerationMetrics.totalTime.count() << _T("ms)");
+
+	m_enumerationContext.reset();
+
+	if (m_pendingFileSelection)
+	{
+		SelectFiles(m_pendingFileSelection->c_str());
+		m_pendingFileSelection.reset();
+	}
+
+	/* Any changes to the directory that occurred during the
+	enumeration were held back. */
+	EnterCriticalSection(&m_csDirectoryAltered);
+	bool directoryAltered = !m_changeJournal.IsEmpty() || m_resyncRequired;
+	LeaveCriticalSection(&m_csDirectoryAltered);
+
+	if (directoryAltered)
+	{
+		DirectoryAltered();
+	}
+}
+
+void CShellBrowser::CancelEnumeration()
+{
+	if (!m_enumerationContext)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_enumerationContext->mutex);
+		m_enumerationContext->cancelled = true;
+		m_enumerationContext->pendingBatches.clear();
+	}
+
+	m_enumerationContext->batchConsumed.notify_all();
+
+	m_enumerationContext.reset();
+}
+
+bool CShellBrowser::IsEnumerating() const
+{
+	return m_enumerationContext != nullptr;
+}
+
+EnumerationMetrics CShellBrowser::GetEnumerationMetrics() const
+{
+	return m_enumerationMetrics;
 }
 
 HRESULT CShellBrowser::AddItemInternal(PCIDLIST_ABSOLUTE pidlDirectory,
@@ -216,6 +509,8 @@ HRESULT CShellBrowser::AddItemInternal(PCIDLIST_ABSOLUTE pidlDirectory,
 
 HRESULT CShellBrowser::AddItemInternal(int iItemIndex, int iItemId, BOOL bPosition)
 {
+	UpdateItemColor(m_itemInfoMap.at(iItemId));
+
 	AwaitingAdd_t AwaitingAdd;
 
 	if (iItemIndex == -1)
@@ -238,19 +533,29 @@ HRESULT CShellBrowser::AddItemInternal(int iItemIndex, int iItemId, BOOL bPositi
 
 int CShellBrowser::SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory,
 	PCITEMID_CHILD pidlChild, const TCHAR *szFileName)
+{
+	int uItemId = GenerateUniqueItemId();
+	auto itr = m_itemInfoMap.emplace(uItemId, BuildItemInfo(pidlDirectory, pidlChild, szFileName)).first;
+
+	m_itemNameIndex.AddItem(uItemId, itr->second.wfd.cFileName, itr->second.wfd.cAlternateFileName);
+
+	return uItemId;
+}
+
+/* Note that this may be called from a background thread. */
+CShellBrowser::ItemInfo_t CShellBrowser::BuildItemInfo(PCIDLIST_ABSOLUTE pidlDirectory,
+	PCITEMID_CHILD pidlChild, const TCHAR *szFileName)
 {
 	HANDLE			hFirstFile;
 	TCHAR			szPath[MAX_PATH];
-	int				uItemId;
-
-	uItemId = GenerateUniqueItemId();
+	ItemInfo_t		itemInfo = {};
 
 	unique_pidl_absolute pidlItem(ILCombine(pidlDirectory, pidlChild));
 
-	m_itemInfoMap[uItemId].pidlComplete.reset(ILCloneFull(pidlItem.get()));
-	m_itemInfoMap[uItemId].pridl.reset(ILCloneChild(pidlChild));
-	StringCchCopy(m_itemInfoMap[uItemId].szDisplayName,
-		SIZEOF_ARRAY(m_itemInfoMap[uItemId].szDisplayName), szFileName);
+	itemInfo.pidlComplete.reset(ILCloneFull(pidlItem.get()));
+	itemInfo.pridl.reset(ILCloneChild(pidlChild));
+	StringCchCopy(itemInfo.szDisplayName,
+		SIZEOF_ARRAY(itemInfo.szDisplayName), szFileName);
 
 	SHGetPathFromIDList(pidlItem.get(), szPath);
 
@@ -259,18 +564,18 @@ int CShellBrowser::SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory,
 	few seconds. */
 	if (!PathIsRoot(szPath))
 	{
-		m_itemInfoMap[uItemId].bDrive = FALSE;
+		itemInfo.bDrive = FALSE;
 
 		WIN32_FIND_DATA wfd;
 		hFirstFile = FindFirstFile(szPath, &wfd);
 
-		m_itemInfoMap[uItemId].wfd = wfd;
+		itemInfo.wfd = wfd;
 	}
 	else
 	{
-		m_itemInfoMap[uItemId].bDrive = TRUE;
-		StringCchCopy(m_itemInfoMap[uItemId].szDrive,
-			SIZEOF_ARRAY(m_itemInfoMap[uItemId].szDrive),
+		itemInfo.bDrive = TRUE;
+		StringCchCopy(itemInfo.szDrive,
+			SIZEOF_ARRAY(itemInfo.szDrive),
 			szPath);
 
 		hFirstFile = INVALID_HANDLE_VALUE;
@@ -284,17 +589,17 @@ int CShellBrowser::SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory,
 	}
 	else
 	{
-		WIN32_FIND_DATA wfd;
+		WIN32_FIND_DATA wfd = {};
 
 		StringCchCopy(wfd.cFileName, SIZEOF_ARRAY(wfd.cFileName), szFileName);
 		wfd.nFileSizeLow = 0;
 		wfd.nFileSizeHigh = 0;
 		wfd.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
 
-		m_itemInfoMap[uItemId].wfd = wfd;
+		itemInfo.wfd = wfd;
 	}
 
-	return uItemId;
+	return itemInfo;
 }
 
 void CShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
@@ -329,6 +634,9 @@ void CShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 
 	int nAdded = 0;
 
+	bool determineGroupsInBackground = bInsertIntoGroup && IsGroupHeaderExpensive(m_folderSettings.sortMode);
+	std::vector<std::pair<int, int>> backgroundGroupItems;
+
 	for (const auto &awaitingItem : m_AwaitingAddList)
 	{
 		const auto &itemInfo = m_itemInfoMap.at(awaitingItem.iItemInternal);
@@ -348,7 +656,18 @@ void CShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 		if (bInsertIntoGroup)
 		{
 			lv.mask |= LVIF_GROUPID;
-			lv.iGroupId = DetermineItemGroup(awaitingItem.iItemInternal);
+
+			/* The item will be moved into its group once
+			the group has been determined. Until then, it's
+			shown in the pending group. */
+			if (determineGroupsInBackground)
+			{
+				lv.iGroupId = CheckPendingGroup();
+			}
+			else
+			{
+				lv.iGroupId = DetermineItemGroup(awaitingItem.iItemInternal);
+			}
 		}
 
 		lv.iItem = awaitingItem.iItem;
@@ -360,6 +679,16 @@ void CShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 		/* Insert the item into the list view control. */
 		int iItemIndex = ListView_InsertItem(m_hListView,&lv);
 
+		if (iItemIndex != -1)
+		{
+			m_itemRowIndex.InsertRow(iItemIndex, awaitingItem.iItemInternal);
+		}
+
+		if (determineGroupsInBackground)
+		{
+			backgroundGroupItems.emplace_back(iItemIndex, awaitingItem.iItemInternal);
+		}
+
 		if(awaitingItem.bPosition && m_folderSettings.viewMode != +ViewMode::Details)
 		{
 			POINT ptItem;
@@ -416,6 +745,12 @@ void CShellBrowser::InsertAwaitingItems(BOOL bInsertIntoGroup)
 
 	m_nTotalItems = nPrevItems + nAdded;
 
+	if (bInsertIntoGroup)
+	{
+		UpdateGroupHeaders();
+		QueueGroupTasks(backgroundGroupItems);
+	}
+
 	PositionDroppedItems();
 
 	m_AwaitingAddList.clear();
@@ -467,47 +802,79 @@ BOOL CShellBrowser::IsFileFiltered(const ItemInfo_t &itemInfo) const
 
 void CShellBrowser::RemoveItem(int iItemInternal)
 {
-	ULARGE_INTEGER	ulFileSize;
-	LVFINDINFO		lvfi;
-	BOOL			bFolder;
-	int				iItem;
-	int				nItems;
-
 	if(iItemInternal == -1)
 		return;
 
-	/* Is this item a folder? */
-	bFolder = (m_itemInfoMap.at(iItemInternal).wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ==
-	FILE_ATTRIBUTE_DIRECTORY;
+	RemoveItems({ iItemInternal });
+}
 
-	/* Take the file size of the removed file away from the total
-	directory size. */
-	ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
-	ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
+/* Removes a set of items at once. Each of the items is
+located before any of them are removed. They're then
+deleted from the bottom up, so that deleting one item
+doesn't move any of the items that are still to be
+deleted. */
+void CShellBrowser::RemoveItems(const std::vector<int> &itemInternalIndexes)
+{
+	if(itemInternalIndexes.empty())
+	{
+		return;
+	}
+
+	std::vector<int> rows;
+	std::unordered_set<int> filteredItems;
+
+	for(int iItemInternal : itemInternalIndexes)
+	{
+		auto iItem = LocateItemByInternalIndex(iItemInternal);
+
+		if(iItem)
+		{
+			rows.push_back(*iItem);
+		}
+		else
+		{
+			/* The item has been filtered out, so it was never
+			counted as part of the folder. */
+			filteredItems.insert(iItemInternal);
+		}
+	}
 
-	m_ulTotalDirSize.QuadPart -= ulFileSize.QuadPart;
+	std::sort(rows.begin(),rows.end(),std::greater<int>());
+	rows.erase(std::unique(rows.begin(),rows.end()),rows.end());
 
-	/* Locate the item within the listview.
-	Could use filename, providing removed
-	items are always deleted before new
-	items are inserted. */
-	lvfi.flags	= LVFI_PARAM;
-	lvfi.lParam	= iItemInternal;
-	iItem = ListView_FindItem(m_hListView,-1,&lvfi);
-	
-	if(iItem != -1)
+	for(int iItem : rows)
 	{
-		/* Remove the item from the listview. */
+		const auto &itemInfo = m_itemInfoMap.at(m_itemRowIndex.GetInternalIndex(iItem));
+
+		/* Take the file size of the removed file away from the total
+		directory size. */
+		ULARGE_INTEGER ulFileSize;
+		ulFileSize.LowPart = itemInfo.wfd.nFileSizeLow;
+		ulFileSize.HighPart = itemInfo.wfd.nFileSizeHigh;
+
+		m_ulTotalDirSize.QuadPart -= ulFileSize.QuadPart;
+
 		ListView_DeleteItem(m_hListView,iItem);
 	}
 
-	m_itemInfoMap.erase(iItemInternal);
+	m_itemRowIndex.RemoveRows(rows);
+	m_nTotalItems -= static_cast<int>(rows.size());
 
-	nItems = ListView_GetItemCount(m_hListView);
+	if(!filteredItems.empty())
+	{
+		m_FilteredItemsList.remove_if([&filteredItems] (int iItemInternal) {
+			return filteredItems.count(iItemInternal) != 0;
+		});
+	}
 
-	m_nTotalItems--;
+	for(int iItemInternal : itemInternalIndexes)
+	{
+		m_itemNameIndex.RemoveItem(iItemInternal);
+		m_columnFetchQueue.RemoveRow(iItemInternal);
+		m_itemInfoMap.erase(iItemInternal);
+	}
 
-	if(nItems == 0 && !m_folderSettings.applyFilter)
+	if(ListView_GetItemCount(m_hListView) == 0 && !m_folderSettings.applyFilter)
 	{
 		ApplyFolderEmptyBackgroundImage(true);
 	}
@@ -0,0 +1,70 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "CacheFile.h"
+#include <wil/resource.h>
+
+bool LoadCacheFile(const std::wstring &filePath,
+	std::function<bool(const void *data, std::size_t size)> deserialize)
+{
+	wil::unique_hfile file(CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+
+	if (!file)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	BOOL res = GetFileSizeEx(file.get(), &fileSize);
+
+	if (!res || fileSize.QuadPart == 0 || static_cast<ULONGLONG>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		return false;
+	}
+
+	wil::unique_handle mapping(CreateFileMapping(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+
+	if (!mapping)
+	{
+		return false;
+	}
+
+	wil::unique_mapview_ptr<void> view(MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0));
+
+	if (!view)
+	{
+		return false;
+	}
+
+	return deserialize(view.get(), static_cast<std::size_t>(fileSize.QuadPart));
+}
+
+bool SaveCacheFile(const std::wstring &filePath, const std::vector<std::uint8_t> &data)
+{
+	std::wstring tempFilePath = filePath + L".tmp";
+
+	{
+		wil::unique_hfile file(CreateFile(tempFilePath.c_str(), GENERIC_WRITE, 0, nullptr,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+
+		if (!file)
+		{
+			return false;
+		}
+
+		DWORD numBytesWritten;
+		BOOL res = WriteFile(file.get(), data.data(), static_cast<DWORD>(data.size()), &numBytesWritten, nullptr);
+
+		if (!res || numBytesWritten != data.size())
+		{
+			file.reset();
+			DeleteFile(tempFilePath.c_str());
+			return false;
+		}
+	}
+
+	return MoveFileEx(tempFilePath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING);
+}
@@ -0,0 +1,116 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Used by the caches that are saved to disk (e.g. the column and thumbnail
+// caches) to build and parse their file contents.
+class CacheFileWriter
+{
+public:
+
+	CacheFileWriter(std::vector<std::uint8_t> &data) :
+		m_data(data)
+	{
+
+	}
+
+	template <typename T>
+	void Write(T value)
+	{
+		WriteBytes(&value, sizeof(value));
+	}
+
+	void WriteString(const std::wstring &str)
+	{
+		Write(static_cast<std::uint32_t>(str.size()));
+		WriteBytes(str.data(), str.size() * sizeof(wchar_t));
+	}
+
+	void WriteBytes(const void *data, std::size_t size)
+	{
+		auto *bytes = static_cast<const std::uint8_t *>(data);
+		m_data.insert(m_data.end(), bytes, bytes + size);
+	}
+
+private:
+
+	std::vector<std::uint8_t> &m_data;
+};
+
+class CacheFileReader
+{
+public:
+
+	CacheFileReader(const void *data, std::size_t size) :
+		m_data(static_cast<const std::uint8_t *>(data)),
+		m_size(size),
+		m_offset(0)
+	{
+
+	}
+
+	template <typename T>
+	bool Read(T &value)
+	{
+		return ReadBytes(&value, sizeof(value));
+	}
+
+	bool ReadString(std::wstring &str)
+	{
+		std::uint32_t length;
+
+		if (!Read(length))
+		{
+			return false;
+		}
+
+		if ((m_size - m_offset) / sizeof(wchar_t) < length)
+		{
+			return false;
+		}
+
+		str.resize(length);
+		return ReadBytes(str.data(), length * sizeof(wchar_t));
+	}
+
+	bool ReadBytes(void *data, std::size_t size)
+	{
+		if (m_size - m_offset < size)
+		{
+			return false;
+		}
+
+		if (size > 0)
+		{
+			std::memcpy(data, m_data + m_offset, size);
+		}
+
+		m_offset += size;
+
+		return true;
+	}
+
+private:
+
+	const std::uint8_t *m_data;
+	std::size_t m_size;
+	std::size_t m_offset;
+};
+
+// The file is memory-mapped while its contents are passed to the
+// deserialize function. Returns false if the file can't be read, or if
+// the deserialize function fails.
+bool LoadCacheFile(const std::wstring &filePath,
+	std::function<bool(const void *data, std::size_t size)> deserialize);
+
+// The data is written to a temporary file first, so that an existing
+// cache file isn't left in a partially written state if the write fails.
+bool SaveCacheFile(const std::wstring &filePath, const std::vector<std::uint8_t> &data);
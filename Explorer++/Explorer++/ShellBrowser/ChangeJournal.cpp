@@ -0,0 +1,266 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ChangeJournal.h"
+#include <algorithm>
+
+ChangeJournal::ChangeJournal() :
+	m_sequenceNumber(0),
+	m_numEvents(0)
+{
+
+}
+
+void ChangeJournal::AddEvent(DWORD action, const std::wstring &fileName, std::chrono::steady_clock::time_point time)
+{
+	if (m_numEvents == 0)
+	{
+		m_firstEventTime = time;
+	}
+
+	m_numEvents++;
+
+	switch (action)
+	{
+	case FILE_ACTION_ADDED:
+		OnAdded(fileName);
+		break;
+
+	case FILE_ACTION_REMOVED:
+		OnRemoved(fileName);
+		break;
+
+	case FILE_ACTION_MODIFIED:
+		OnModified(fileName);
+		break;
+
+	case FILE_ACTION_RENAMED_OLD_NAME:
+		m_pendingRenameOldName = fileName;
+		break;
+
+	case FILE_ACTION_RENAMED_NEW_NAME:
+		if (m_pendingRenameOldName)
+		{
+			OnRenamed(*m_pendingRenameOldName, fileName);
+			m_pendingRenameOldName.reset();
+		}
+		else
+		{
+			// Without the old name, all that's known is that an item with
+			// this name now exists.
+			OnAdded(fileName);
+		}
+		break;
+	}
+}
+
+void ChangeJournal::OnAdded(const std::wstring &fileName)
+{
+	auto existingItr = m_entries.find(fileName);
+
+	if (existingItr != m_entries.end())
+	{
+		existingItr->second.modified = true;
+		return;
+	}
+
+	Entry entry;
+	entry.modified = false;
+	entry.sequenceNumber = m_sequenceNumber++;
+
+	auto removedItr = m_removedItems.find(fileName);
+
+	if (removedItr != m_removedItems.end())
+	{
+		// The original item was deleted and then a new item was created
+		// with the same name. As far as the listview is concerned, that's
+		// the same as the original item being modified.
+		m_removedItems.erase(removedItr);
+
+		entry.originalName = fileName;
+		entry.existedBefore = true;
+		entry.modified = true;
+	}
+	else
+	{
+		entry.existedBefore = false;
+	}
+
+	m_entries.insert({ fileName, entry });
+}
+
+void ChangeJournal::OnRemoved(const std::wstring &fileName)
+{
+	auto itr = m_entries.find(fileName);
+
+	if (itr == m_entries.end())
+	{
+		m_removedItems.insert({ fileName, m_sequenceNumber++ });
+		return;
+	}
+
+	// If the item didn't exist to begin with, the addition and removal
+	// cancel out.
+	if (itr->second.existedBefore)
+	{
+		m_removedItems.insert({ itr->second.originalName, m_sequenceNumber++ });
+	}
+
+	m_entries.erase(itr);
+}
+
+void ChangeJournal::OnModified(const std::wstring &fileName)
+{
+	auto itr = m_entries.find(fileName);
+
+	if (itr != m_entries.end())
+	{
+		itr->second.modified = true;
+		return;
+	}
+
+	Entry entry;
+	entry.originalName = fileName;
+	entry.existedBefore = true;
+	entry.modified = true;
+	entry.sequenceNumber = m_sequenceNumber++;
+	m_entries.insert({ fileName, entry });
+}
+
+void ChangeJournal::OnRenamed(const std::wstring &oldName, const std::wstring &newName)
+{
+	if (oldName == newName)
+	{
+		return;
+	}
+
+	Entry entry;
+	auto itr = m_entries.find(oldName);
+
+	if (itr != m_entries.end())
+	{
+		entry = itr->second;
+		m_entries.erase(itr);
+	}
+	else
+	{
+		entry.originalName = oldName;
+		entry.existedBefore = true;
+		entry.modified = false;
+		entry.sequenceNumber = m_sequenceNumber++;
+	}
+
+	// An item can only be renamed over an existing item if that item has
+	// been removed, which would normally result in a separate notification.
+	// If that notification hasn't been received, treat the existing item as
+	// having been removed anyway.
+	if (m_entries.count(newName) > 0)
+	{
+		OnRemoved(newName);
+	}
+
+	m_entries.insert({ newName, entry });
+}
+
+std::vector<ChangeJournal::Change> ChangeJournal::TakeChanges()
+{
+	std::vector<std::pair<int, Change>> removals;
+	std::vector<std::pair<int, Change>> renames;
+	std::vector<std::pair<int, Change>> additions;
+	std::vector<std::pair<int, Change>> modifications;
+
+	for (const auto &removedItem : m_removedItems)
+	{
+		removals.push_back({ removedItem.second, { ChangeType::Removed, removedItem.first, L"" } });
+	}
+
+	for (const auto &entry : m_entries)
+	{
+		const std::wstring &name = entry.first;
+
+		if (!entry.second.existedBefore)
+		{
+			additions.push_back({ entry.second.sequenceNumber, { ChangeType::Added, name, L"" } });
+			continue;
+		}
+
+		if (entry.second.originalName != name)
+		{
+			renames.push_back({ entry.second.sequenceNumber, { ChangeType::Renamed, name, entry.second.originalName } });
+		}
+
+		if (entry.second.modified)
+		{
+			modifications.push_back({ entry.second.sequenceNumber, { ChangeType::Modified, name, L"" } });
+		}
+	}
+
+	std::vector<Change> changes;
+	changes.reserve(removals.size() + renames.size() + additions.size() + modifications.size());
+
+	for (auto *group : { &removals, &renames, &additions, &modifications })
+	{
+		std::sort(group->begin(), group->end(), [] (const auto &change1, const auto &change2) {
+			return change1.first < change2.first;
+		});
+
+		for (auto &change : *group)
+		{
+			changes.push_back(std::move(change.second));
+		}
+	}
+
+	m_entries.clear();
+	m_removedItems.clear();
+	m_numEvents = 0;
+
+	return changes;
+}
+
+void ChangeJournal::Clear()
+{
+	m_entries.clear();
+	m_removedItems.clear();
+	m_pendingRenameOldName.reset();
+	m_numEvents = 0;
+}
+
+bool ChangeJournal::IsEmpty() const
+{
+	return m_entries.empty() && m_removedItems.empty();
+}
+
+std::size_t ChangeJournal::GetNumEvents() const
+{
+	return m_numEvents;
+}
+
+std::chrono::milliseconds ChangeJournal::GetDebounceDelay(std::chrono::steady_clock::time_point now) const
+{
+	std::chrono::milliseconds delay = BASE_DEBOUNCE_DELAY;
+
+	if (m_numEvents >= LARGE_EVENT_COUNT)
+	{
+		delay = LARGE_DEBOUNCE_DELAY;
+	}
+	else if (m_numEvents >= MEDIUM_EVENT_COUNT)
+	{
+		delay = MEDIUM_DEBOUNCE_DELAY;
+	}
+
+	if (m_numEvents == 0)
+	{
+		return delay;
+	}
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_firstEventTime);
+
+	if (elapsed >= MAX_EVENT_LATENCY)
+	{
+		return std::chrono::milliseconds(0);
+	}
+
+	return (std::min)(delay, MAX_EVENT_LATENCY - elapsed);
+}
@@ -0,0 +1,99 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Collects the directory change notifications for a folder and collapses
+// them into the net set of changes for each file. For example, a file that
+// is added and then removed before the changes are applied won't appear at
+// all and a file that's renamed several times will only be renamed once.
+class ChangeJournal
+{
+public:
+
+	enum class ChangeType
+	{
+		Removed,
+		Renamed,
+		Added,
+		Modified
+	};
+
+	struct Change
+	{
+		ChangeType type;
+		std::wstring name;
+
+		// Only set for renamed items.
+		std::wstring oldName;
+	};
+
+	ChangeJournal();
+
+	// Takes one of the FILE_ACTION_* values.
+	void AddEvent(DWORD action, const std::wstring &fileName, std::chrono::steady_clock::time_point time);
+
+	// Returns the net changes recorded since the last call, ordered as
+	// removals, renames, additions and then modifications. Once a set of
+	// changes has been applied, each name refers to at most one item.
+	std::vector<Change> TakeChanges();
+
+	void Clear();
+	bool IsEmpty() const;
+	std::size_t GetNumEvents() const;
+
+	// Returns how long to wait for further events before applying the
+	// current set of changes. The more events that arrive, the longer the
+	// delay, up until the point that the oldest event has been waiting for
+	// too long.
+	std::chrono::milliseconds GetDebounceDelay(std::chrono::steady_clock::time_point now) const;
+
+private:
+
+	struct Entry
+	{
+		// The name of the item before any of the recorded events. Only
+		// meaningful if the item existed at that point.
+		std::wstring originalName;
+		bool existedBefore;
+		bool modified;
+
+		// Used to order the resulting changes.
+		int sequenceNumber;
+	};
+
+	static constexpr std::chrono::milliseconds BASE_DEBOUNCE_DELAY{ 200 };
+	static constexpr std::chrono::milliseconds MEDIUM_DEBOUNCE_DELAY{ 500 };
+	static constexpr std::chrono::milliseconds LARGE_DEBOUNCE_DELAY{ 1000 };
+	static constexpr std::chrono::milliseconds MAX_EVENT_LATENCY{ 2000 };
+
+	static const std::size_t MEDIUM_EVENT_COUNT = 100;
+	static const std::size_t LARGE_EVENT_COUNT = 1000;
+
+	void OnAdded(const std::wstring &fileName);
+	void OnRemoved(const std::wstring &fileName);
+	void OnModified(const std::wstring &fileName);
+	void OnRenamed(const std::wstring &oldName, const std::wstring &newName);
+
+	// Keyed by the current name of each item.
+	std::unordered_map<std::wstring, Entry> m_entries;
+
+	// The original names of items that existed before the recorded events
+	// and have since been removed.
+	std::unordered_map<std::wstring, int> m_removedItems;
+
+	// Rename notifications arrive as a pair of events (old name, then new
+	// name).
+	boost::optional<std::wstring> m_pendingRenameOldName;
+
+	int m_sequenceNumber;
+	std::size_t m_numEvents;
+	std::chrono::steady_clock::time_point m_firstEventTime;
+};
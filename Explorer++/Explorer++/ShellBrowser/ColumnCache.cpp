@@ -0,0 +1,229 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ColumnCache.h"
+#include "CacheFile.h"
+
+ColumnCache::ColumnCache(std::size_t maxSize) :
+	m_maxSize(maxSize),
+	m_size(0),
+	m_numHits(0),
+	m_numMisses(0)
+{
+
+}
+
+boost::optional<std::wstring> ColumnCache::Get(const std::wstring &path, unsigned int columnId,
+	std::uint64_t fileSize, std::uint64_t lastWriteTime)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto itr = m_entryMap.find({ path, columnId });
+
+	if (itr == m_entryMap.end())
+	{
+		m_numMisses++;
+		return boost::none;
+	}
+
+	auto entryItr = itr->second;
+
+	if (entryItr->fileSize != fileSize || entryItr->lastWriteTime != lastWriteTime)
+	{
+		// The item has changed since the value was calculated.
+		RemoveLocked(entryItr);
+
+		m_numMisses++;
+		return boost::none;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, entryItr);
+
+	m_numHits++;
+	return entryItr->value;
+}
+
+void ColumnCache::Set(const std::wstring &path, unsigned int columnId,
+	std::uint64_t fileSize, std::uint64_t lastWriteTime, const std::wstring &value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	InsertLocked({ { path, columnId }, fileSize, lastWriteTime, value }, true);
+	EvictLocked();
+}
+
+void ColumnCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_entryMap.clear();
+	m_entries.clear();
+	m_size = 0;
+}
+
+std::size_t ColumnCache::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_size;
+}
+
+std::size_t ColumnCache::GetMaxSize() const
+{
+	return m_maxSize;
+}
+
+std::size_t ColumnCache::GetNumEntries() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+std::uint64_t ColumnCache::GetNumHits() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numHits;
+}
+
+std::uint64_t ColumnCache::GetNumMisses() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numMisses;
+}
+
+void ColumnCache::ResetCounters()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_numHits = 0;
+	m_numMisses = 0;
+}
+
+std::size_t ColumnCache::GetEntrySize(const Entry &entry)
+{
+	return ((entry.key.path.size() + entry.value.size()) * sizeof(wchar_t)) + ENTRY_OVERHEAD;
+}
+
+void ColumnCache::InsertLocked(Entry entry, bool mostRecent)
+{
+	auto existingItr = m_entryMap.find(entry.key);
+
+	if (existingItr != m_entryMap.end())
+	{
+		RemoveLocked(existingItr->second);
+	}
+
+	m_size += GetEntrySize(entry);
+
+	auto itr = m_entries.insert(mostRecent ? m_entries.begin() : m_entries.end(), std::move(entry));
+	m_entryMap.insert({ itr->key, itr });
+}
+
+void ColumnCache::RemoveLocked(EntryList::iterator itr)
+{
+	m_size -= GetEntrySize(*itr);
+	m_entryMap.erase(itr->key);
+	m_entries.erase(itr);
+}
+
+void ColumnCache::EvictLocked()
+{
+	while (m_size > m_maxSize && !m_entries.empty())
+	{
+		RemoveLocked(std::prev(m_entries.end()));
+	}
+}
+
+std::vector<std::uint8_t> ColumnCache::Serialize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<std::uint8_t> data;
+	data.reserve(m_size);
+
+	CacheFileWriter writer(data);
+	writer.Write(FILE_SIGNATURE);
+	writer.Write(FILE_VERSION);
+	writer.Write(static_cast<std::uint32_t>(sizeof(wchar_t)));
+	writer.Write(static_cast<std::uint64_t>(m_entries.size()));
+
+	for (const auto &entry : m_entries)
+	{
+		writer.Write(static_cast<std::uint32_t>(entry.key.columnId));
+		writer.Write(entry.fileSize);
+		writer.Write(entry.lastWriteTime);
+		writer.WriteString(entry.key.path);
+		writer.WriteString(entry.value);
+	}
+
+	return data;
+}
+
+bool ColumnCache::Deserialize(const void *data, std::size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_entryMap.clear();
+	m_entries.clear();
+	m_size = 0;
+
+	CacheFileReader reader(data, size);
+
+	std::uint32_t signature;
+	std::uint32_t version;
+	std::uint32_t charSize;
+	std::uint64_t numEntries;
+
+	if (!reader.Read(signature) || signature != FILE_SIGNATURE
+		|| !reader.Read(version) || version != FILE_VERSION
+		|| !reader.Read(charSize) || charSize != sizeof(wchar_t)
+		|| !reader.Read(numEntries))
+	{
+		return false;
+	}
+
+	for (std::uint64_t i = 0; i < numEntries; i++)
+	{
+		Entry entry;
+		std::uint32_t columnId;
+
+		if (!reader.Read(columnId)
+			|| !reader.Read(entry.fileSize)
+			|| !reader.Read(entry.lastWriteTime)
+			|| !reader.ReadString(entry.key.path)
+			|| !reader.ReadString(entry.value))
+		{
+			m_entryMap.clear();
+			m_entries.clear();
+			m_size = 0;
+
+			return false;
+		}
+
+		entry.key.columnId = columnId;
+
+		if (m_size + GetEntrySize(entry) > m_maxSize)
+		{
+			// Entries are stored most recently used first, so anything
+			// beyond this point would be evicted anyway.
+			break;
+		}
+
+		InsertLocked(std::move(entry), false);
+	}
+
+	return true;
+}
+
+bool ColumnCache::LoadFromFile(const std::wstring &filePath)
+{
+	return LoadCacheFile(filePath, [this] (const void *data, std::size_t size) {
+		return Deserialize(data, size);
+	});
+}
+
+bool ColumnCache::SaveToFile(const std::wstring &filePath) const
+{
+	return SaveCacheFile(filePath, Serialize());
+}
@@ -0,0 +1,118 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Stores the text of columns that are expensive to calculate (e.g. those
+// that require a file to be opened and parsed), so that the values don't
+// have to be recalculated each time a folder is visited or sorted.
+//
+// Each value is stored against the item's full path and the column ID,
+// along with the size and last write time of the item at the time the
+// value was calculated. If either of those has changed by the time the
+// value is next requested, the value is considered out of date and is
+// discarded.
+//
+// Once the size of the cache reaches the specified limit, the least
+// recently used values are evicted. The cache can be saved to disk and
+// loaded on the next run.
+//
+// All methods are thread-safe.
+class ColumnCache
+{
+public:
+
+	ColumnCache(std::size_t maxSize);
+
+	boost::optional<std::wstring> Get(const std::wstring &path, unsigned int columnId,
+		std::uint64_t fileSize, std::uint64_t lastWriteTime);
+	void Set(const std::wstring &path, unsigned int columnId,
+		std::uint64_t fileSize, std::uint64_t lastWriteTime, const std::wstring &value);
+	void Clear();
+
+	std::size_t GetSize() const;
+	std::size_t GetMaxSize() const;
+	std::size_t GetNumEntries() const;
+
+	std::uint64_t GetNumHits() const;
+	std::uint64_t GetNumMisses() const;
+	void ResetCounters();
+
+	// Entries are written most recently used first, so that, if the cache
+	// is loaded with a lower size limit, it's the least recently used
+	// entries that are dropped.
+	std::vector<std::uint8_t> Serialize() const;
+
+	// Returns false if the data isn't in the expected format, in which
+	// case the cache will be left empty.
+	bool Deserialize(const void *data, std::size_t size);
+
+	// The file is memory-mapped while it's being read.
+	bool LoadFromFile(const std::wstring &filePath);
+	bool SaveToFile(const std::wstring &filePath) const;
+
+private:
+
+	struct Key
+	{
+		std::wstring path;
+		unsigned int columnId;
+
+		bool operator==(const Key &other) const
+		{
+			return columnId == other.columnId && path == other.path;
+		}
+	};
+
+	struct KeyHash
+	{
+		std::size_t operator()(const Key &key) const
+		{
+			return std::hash<std::wstring>()(key.path) ^ (std::hash<unsigned int>()(key.columnId) << 1);
+		}
+	};
+
+	struct Entry
+	{
+		Key key;
+		std::uint64_t fileSize;
+		std::uint64_t lastWriteTime;
+		std::wstring value;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	static constexpr std::uint32_t FILE_SIGNATURE = 0x43435845;
+	static constexpr std::uint32_t FILE_VERSION = 1;
+
+	// An approximation of the memory used by each entry, beyond the
+	// strings it contains.
+	static constexpr std::size_t ENTRY_OVERHEAD = 64;
+
+	static std::size_t GetEntrySize(const Entry &entry);
+
+	void InsertLocked(Entry entry, bool mostRecent);
+	void RemoveLocked(EntryList::iterator itr);
+	void EvictLocked();
+
+	mutable std::mutex m_mutex;
+
+	const std::size_t m_maxSize;
+	std::size_t m_size;
+
+	// Ordered from most to least recently used.
+	EntryList m_entries;
+	std::unordered_map<Key, EntryList::iterator, KeyHash> m_entryMap;
+
+	std::uint64_t m_numHits;
+	std::uint64_t m_numMisses;
+};
@@ -4,6 +4,7 @@
 
 #include "stdafx.h"
 #include "ColumnDataRetrieval.h"
+#include "ColumnCache.h"
 #include "Columns.h"
 #include "../Helper/DriveInfo.h"
 #include "../Helper/FileOperations.h"
@@ -18,8 +19,182 @@
 
 BOOL GetPrinterStatusDescription(DWORD dwStatus, TCHAR *szStatus, size_t cchMax);
 
+std::wstring GetItemDetailsColumnText(ItemColumnContext &context, const SHCOLUMNID *pscid, const GlobalFolderSettings &globalFolderSettings);
+std::wstring GetUncachedColumnText(UINT ColumnID, ItemColumnContext &context, const GlobalFolderSettings &globalFolderSettings);
+
+ItemColumnContext::ItemColumnContext(const BasicItemInfo_t &itemInfo, ColumnCache *columnCache,
+	FolderSizeCalculator *folderSizeCalculator) :
+	m_itemInfo(itemInfo),
+	m_columnCache(columnCache),
+	m_folderSizeCalculator(folderSizeCalculator),
+	m_parentFolderRetrieved(false),
+	m_versionInfoRetrieved(false)
+{
+
+}
+
+const BasicItemInfo_t &ItemColumnContext::GetItemInfo() const
+{
+	return m_itemInfo;
+}
+
+ColumnCache *ItemColumnContext::GetColumnCache() const
+{
+	return m_columnCache;
+}
+
+FolderSizeCalculator *ItemColumnContext::GetFolderSizeCalculator() const
+{
+	return m_folderSizeCalculator;
+}
+
+const std::wstring &ItemColumnContext::GetFullPath()
+{
+	if (!m_fullPath)
+	{
+		m_fullPath = m_itemInfo.getFullPath();
+	}
+
+	return *m_fullPath;
+}
+
+IShellFolder2 *ItemColumnContext::GetParentFolder()
+{
+	if (!m_parentFolderRetrieved)
+	{
+		m_parentFolderRetrieved = true;
+
+		HRESULT hr = SHBindToParent(m_itemInfo.pidlComplete.get(), IID_PPV_ARGS(&m_parentFolder), nullptr);
+
+		if (FAILED(hr))
+		{
+			m_parentFolder.reset();
+		}
+	}
+
+	return m_parentFolder.get();
+}
+
+const void *ItemColumnContext::GetVersionInfo()
+{
+	if (!m_versionInfoRetrieved)
+	{
+		m_versionInfoRetrieved = true;
+
+		DWORD versionInfoSize = GetFileVersionInfoSize(GetFullPath().c_str(), nullptr);
+
+		if (versionInfoSize > 0)
+		{
+			m_versionInfo.resize(versionInfoSize);
+
+			BOOL res = GetFileVersionInfo(GetFullPath().c_str(), 0, versionInfoSize, m_versionInfo.data());
+
+			if (!res)
+			{
+				m_versionInfo.clear();
+			}
+		}
+	}
+
+	if (m_versionInfo.empty())
+	{
+		return nullptr;
+	}
+
+	return m_versionInfo.data();
+}
+
 std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings)
+{
+	ItemColumnContext context(basicItemInfo);
+	return GetColumnText(ColumnID, context, globalFolderSettings);
+}
+
+/* Returns true for columns whose values are expensive to
+calculate (typically because the file has to be opened and
+parsed) and that depend only on the contents of the item. The
+values for these columns are validated using the size and last
+write time of the item, so columns that depend on the display
+settings aren't cached. */
+bool IsColumnCacheable(UINT ColumnID)
 {
+	switch (ColumnID)
+	{
+	case CM_OWNER:
+	case CM_PRODUCTNAME:
+	case CM_COMPANY:
+	case CM_DESCRIPTION:
+	case CM_FILEVERSION:
+	case CM_PRODUCTVERSION:
+	case CM_HARDLINKS:
+	case CM_CAMERAMODEL:
+	case CM_DATETAKEN:
+	case CM_WIDTH:
+	case CM_HEIGHT:
+	case CM_MEDIA_BITRATE:
+	case CM_MEDIA_COPYRIGHT:
+	case CM_MEDIA_DURATION:
+	case CM_MEDIA_PROTECTED:
+	case CM_MEDIA_RATING:
+	case CM_MEDIA_ALBUMARTIST:
+	case CM_MEDIA_ALBUM:
+	case CM_MEDIA_BEATSPERMINUTE:
+	case CM_MEDIA_COMPOSER:
+	case CM_MEDIA_CONDUCTOR:
+	case CM_MEDIA_DIRECTOR:
+	case CM_MEDIA_GENRE:
+	case CM_MEDIA_LANGUAGE:
+	case CM_MEDIA_BROADCASTDATE:
+	case CM_MEDIA_CHANNEL:
+	case CM_MEDIA_STATIONNAME:
+	case CM_MEDIA_MOOD:
+	case CM_MEDIA_PARENTALRATING:
+	case CM_MEDIA_PARENTALRATINGREASON:
+	case CM_MEDIA_PERIOD:
+	case CM_MEDIA_PRODUCER:
+	case CM_MEDIA_PUBLISHER:
+	case CM_MEDIA_WRITER:
+	case CM_MEDIA_YEAR:
+		return true;
+	}
+
+	return false;
+}
+
+std::wstring GetColumnText(UINT ColumnID, ItemColumnContext &context, const GlobalFolderSettings &globalFolderSettings)
+{
+	ColumnCache *columnCache = context.GetColumnCache();
+	const BasicItemInfo_t &basicItemInfo = context.GetItemInfo();
+
+	ULARGE_INTEGER lastWriteTime = { basicItemInfo.wfd.ftLastWriteTime.dwLowDateTime,
+		basicItemInfo.wfd.ftLastWriteTime.dwHighDateTime };
+
+	/* Virtual items don't have a last write time, so there's
+	no way of telling whether a cached value is still valid. */
+	if (!columnCache || !IsColumnCacheable(ColumnID) || lastWriteTime.QuadPart == 0)
+	{
+		return GetUncachedColumnText(ColumnID, context, globalFolderSettings);
+	}
+
+	ULARGE_INTEGER fileSize = { basicItemInfo.wfd.nFileSizeLow, basicItemInfo.wfd.nFileSizeHigh };
+
+	auto cachedText = columnCache->Get(context.GetFullPath(), ColumnID, fileSize.QuadPart, lastWriteTime.QuadPart);
+
+	if (cachedText)
+	{
+		return *cachedText;
+	}
+
+	std::wstring text = GetUncachedColumnText(ColumnID, context, globalFolderSettings);
+	columnCache->Set(context.GetFullPath(), ColumnID, fileSize.QuadPart, lastWriteTime.QuadPart, text);
+
+	return text;
+}
+
+std::wstring GetUncachedColumnText(UINT ColumnID, ItemColumnContext &context, const GlobalFolderSettings &globalFolderSettings)
+{
+	const BasicItemInfo_t &basicItemInfo = context.GetItemInfo();
+
 	switch (ColumnID)
 	{
 	case CM_NAME:
@@ -30,7 +205,7 @@ std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo,
 		return GetTypeColumnText(basicItemInfo);
 		break;
 	case CM_SIZE:
-		return GetSizeColumnText(basicItemInfo, globalFolderSettings);
+		return GetSizeColumnText(basicItemInfo, globalFolderSettings, context.GetFolderSizeCalculator());
 		break;
 
 	case CM_DATEMODIFIED:
@@ -57,19 +232,19 @@ std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo,
 		break;
 
 	case CM_PRODUCTNAME:
-		return GetVersionColumnText(basicItemInfo, VERSION_INFO_PRODUCT_NAME);
+		return GetVersionColumnText(context, VERSION_INFO_PRODUCT_NAME);
 		break;
 	case CM_COMPANY:
-		return GetVersionColumnText(basicItemInfo, VERSION_INFO_COMPANY);
+		return GetVersionColumnText(context, VERSION_INFO_COMPANY);
 		break;
 	case CM_DESCRIPTION:
-		return GetVersionColumnText(basicItemInfo, VERSION_INFO_DESCRIPTION);
+		return GetVersionColumnText(context, VERSION_INFO_DESCRIPTION);
 		break;
 	case CM_FILEVERSION:
-		return GetVersionColumnText(basicItemInfo, VERSION_INFO_FILE_VERSION);
+		return GetVersionColumnText(context, VERSION_INFO_FILE_VERSION);
 		break;
 	case CM_PRODUCTVERSION:
-		return GetVersionColumnText(basicItemInfo, VERSION_INFO_PRODUCT_VERSION);
+		return GetVersionColumnText(context, VERSION_INFO_PRODUCT_VERSION);
 		break;
 
 	case CM_SHORTCUTTO:
@@ -83,19 +258,19 @@ std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo,
 		break;
 
 	case CM_TITLE:
-		return GetItemDetailsColumnText(basicItemInfo, &PKEY_Title, globalFolderSettings);
+		return GetItemDetailsColumnText(context, &PKEY_Title, globalFolderSettings);
 		break;
 	case CM_SUBJECT:
-		return GetItemDetailsColumnText(basicItemInfo, &PKEY_Subject, globalFolderSettings);
+		return GetItemDetailsColumnText(context, &PKEY_Subject, globalFolderSettings);
 		break;
 	case CM_AUTHORS:
-		return GetItemDetailsColumnText(basicItemInfo, &PKEY_Author, globalFolderSettings);
+		return GetItemDetailsColumnText(context, &PKEY_Author, globalFolderSettings);
 		break;
 	case CM_KEYWORDS:
-		return GetItemDetailsColumnText(basicItemInfo, &PKEY_Keywords, globalFolderSettings);
+		return GetItemDetailsColumnText(context, &PKEY_Keywords, globalFolderSettings);
 		break;
 	case CM_COMMENT:
-		return GetItemDetailsColumnText(basicItemInfo, &PKEY_Comment, globalFolderSettings);
+		return GetItemDetailsColumnText(context, &PKEY_Comment, globalFolderSettings);
 		break;
 
 	case CM_CAMERAMODEL:
@@ -128,11 +303,11 @@ std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo,
 		break;
 
 	case CM_ORIGINALLOCATION:
-		return GetItemDetailsColumnText(basicItemInfo, &SCID_ORIGINAL_LOCATION, globalFolderSettings);
+		return GetItemDetailsColumnText(context, &SCID_ORIGINAL_LOCATION, globalFolderSettings);
 		break;
 
 	case CM_DATEDELETED:
-		return GetItemDetailsColumnText(basicItemInfo, &SCID_DATE_DELETED, globalFolderSettings);
+		return GetItemDetailsColumnText(context, &SCID_DATE_DELETED, globalFolderSettings);
 		break;
 
 	case CM_NUMPRINTERDOCUMENTS:
@@ -302,25 +477,14 @@ std::wstring GetTypeColumnText(const BasicItemInfo_t &itemInfo)
 	return shfi.szTypeName;
 }
 
-std::wstring GetSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings)
+std::wstring GetSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings,
+	FolderSizeCalculator *folderSizeCalculator)
 {
 	if ((itemInfo.wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY)
 	{
-		TCHAR drive[MAX_PATH];
-		StringCchCopy(drive, SIZEOF_ARRAY(drive), itemInfo.getFullPath().c_str());
-		PathStripToRoot(drive);
-
-		bool bNetworkRemovable = false;
-
-		if (GetDriveType(drive) == DRIVE_REMOVABLE ||
-			GetDriveType(drive) == DRIVE_REMOTE)
-		{
-			bNetworkRemovable = true;
-		}
-
-		if (globalFolderSettings.showFolderSizes && !(globalFolderSettings.disableFolderSizesNetworkRemovable && bNetworkRemovable))
+		if (IsFolderSizeEnabled(itemInfo, globalFolderSettings))
 		{
-			return GetFolderSizeColumnText(itemInfo, globalFolderSettings);
+			return GetFolderSizeColumnText(itemInfo, globalFolderSettings, folderSizeCalculator);
 		}
 		else
 		{
@@ -336,18 +500,11 @@ std::wstring GetSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFold
 	return FileSizeText;
 }
 
-std::wstring GetFolderSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings)
+std::wstring GetFolderSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings,
+	FolderSizeCalculator *folderSizeCalculator)
 {
-	int numFolders;
-	int numFiles;
 	ULARGE_INTEGER totalFolderSize;
-	CalculateFolderSize(itemInfo.getFullPath().c_str(), &numFolders, &numFiles, &totalFolderSize);
-
-	/* TODO: This should
-	be done some other way.
-	Shouldn't depend on
-	the internal index. */
-	//m_cachedFolderSizes.insert({internalIndex, totalFolderSize.QuadPart});
+	totalFolderSize.QuadPart = GetFolderSize(itemInfo.getFullPath(), folderSizeCalculator);
 
 	TCHAR fileSizeText[64];
 	FormatSizeString(totalFolderSize, fileSizeText, SIZEOF_ARRAY(fileSizeText),
@@ -356,6 +513,43 @@ std::wstring GetFolderSizeColumnText(const BasicItemInfo_t &itemInfo, const Glob
 	return fileSizeText;
 }
 
+bool IsFolderSizeEnabled(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings)
+{
+	if (!globalFolderSettings.showFolderSizes)
+	{
+		return false;
+	}
+
+	TCHAR drive[MAX_PATH];
+	StringCchCopy(drive, SIZEOF_ARRAY(drive), itemInfo.getFullPath().c_str());
+	PathStripToRoot(drive);
+
+	bool bNetworkRemovable = false;
+
+	if (GetDriveType(drive) == DRIVE_REMOVABLE ||
+		GetDriveType(drive) == DRIVE_REMOTE)
+	{
+		bNetworkRemovable = true;
+	}
+
+	return !(globalFolderSettings.disableFolderSizesNetworkRemovable && bNetworkRemovable);
+}
+
+ULONGLONG GetFolderSize(const std::wstring &path, FolderSizeCalculator *folderSizeCalculator)
+{
+	if (folderSizeCalculator)
+	{
+		return folderSizeCalculator->Calculate(path).size;
+	}
+
+	int numFolders;
+	int numFiles;
+	ULARGE_INTEGER totalFolderSize;
+	CalculateFolderSize(path.c_str(), &numFolders, &numFiles, &totalFolderSize);
+
+	return totalFolderSize.QuadPart;
+}
+
 std::wstring GetTimeColumnText(const BasicItemInfo_t &itemInfo, TimeType_t TimeType, const GlobalFolderSettings &globalFolderSettings)
 {
 	TCHAR FileTime[64];
@@ -483,6 +677,28 @@ std::wstring GetItemDetailsColumnText(const BasicItemInfo_t &itemInfo, const SHC
 	return EMPTY_STRING;
 }
 
+std::wstring GetItemDetailsColumnText(ItemColumnContext &context, const SHCOLUMNID *pscid, const GlobalFolderSettings &globalFolderSettings)
+{
+	VARIANT vt;
+	HRESULT hr = GetItemDetailsRawData(context, pscid, &vt);
+
+	if (FAILED(hr))
+	{
+		return EMPTY_STRING;
+	}
+
+	TCHAR szDetail[512];
+	hr = ConvertVariantToString(&vt, szDetail, SIZEOF_ARRAY(szDetail), globalFolderSettings.showFriendlyDates);
+	VariantClear(&vt);
+
+	if (FAILED(hr))
+	{
+		return EMPTY_STRING;
+	}
+
+	return szDetail;
+}
+
 HRESULT GetItemDetails(const BasicItemInfo_t &itemInfo, const SHCOLUMNID *pscid, TCHAR *szDetail, size_t cchMax, const GlobalFolderSettings &globalFolderSettings)
 {
 	VARIANT vt;
@@ -510,7 +726,25 @@ HRESULT GetItemDetailsRawData(const BasicItemInfo_t &itemInfo, const SHCOLUMNID
 	return hr;
 }
 
+HRESULT GetItemDetailsRawData(ItemColumnContext &context, const SHCOLUMNID *pscid, VARIANT *vt)
+{
+	IShellFolder2 *parentFolder = context.GetParentFolder();
+
+	if (!parentFolder)
+	{
+		return E_FAIL;
+	}
+
+	return parentFolder->GetDetailsEx(context.GetItemInfo().pridl.get(), pscid, vt);
+}
+
 std::wstring GetVersionColumnText(const BasicItemInfo_t &itemInfo, VersionInfoType_t VersioninfoType)
+{
+	ItemColumnContext context(itemInfo);
+	return GetVersionColumnText(context, VersioninfoType);
+}
+
+std::wstring GetVersionColumnText(ItemColumnContext &context, VersionInfoType_t VersioninfoType)
 {
 	std::wstring VersionInfoName;
 
@@ -541,8 +775,15 @@ std::wstring GetVersionColumnText(const BasicItemInfo_t &itemInfo, VersionInfoTy
 		break;
 	}
 
+	const void *versionInfoBlock = context.GetVersionInfo();
+
+	if (!versionInfoBlock)
+	{
+		return EMPTY_STRING;
+	}
+
 	TCHAR VersionInfo[512];
-	BOOL VersionInfoObtained = GetVersionInfoString(itemInfo.getFullPath().c_str(), VersionInfoName.c_str(),
+	BOOL VersionInfoObtained = GetVersionInfoString(versionInfoBlock, VersionInfoName.c_str(),
 		VersionInfo, SIZEOF_ARRAY(VersionInfo));
 
 	if (!VersionInfoObtained)
@@ -6,7 +6,13 @@
 
 #include "FolderSettings.h"
 #include "ItemData.h"
+#include <boost/optional.hpp>
+#include <wil/com.h>
 #include <string>
+#include <vector>
+
+class ColumnCache;
+class FolderSizeCalculator;
 
 enum TimeType_t
 {
@@ -61,7 +67,49 @@ enum MediaMetadataType_t
 	MEDIAMETADATA_TYPE_YEAR
 };
 
+// Holds the resources that are expensive to acquire and that more than
+// one column for the same item may need (e.g. the parent folder and the
+// file's version information). Each resource is only acquired the first
+// time it's requested, so retrieving an entire row through a single
+// context acquires each resource at most once.
+//
+// If a column cache is provided, the text for expensive columns will be
+// retrieved from (and stored in) the cache.
+class ItemColumnContext
+{
+public:
+
+	ItemColumnContext(const BasicItemInfo_t &itemInfo, ColumnCache *columnCache = nullptr,
+		FolderSizeCalculator *folderSizeCalculator = nullptr);
+
+	const BasicItemInfo_t &GetItemInfo() const;
+	ColumnCache *GetColumnCache() const;
+	FolderSizeCalculator *GetFolderSizeCalculator() const;
+	const std::wstring &GetFullPath();
+	IShellFolder2 *GetParentFolder();
+
+	// Returns nullptr if the file doesn't contain any version
+	// information.
+	const void *GetVersionInfo();
+
+private:
+
+	const BasicItemInfo_t &m_itemInfo;
+	ColumnCache *const m_columnCache;
+	FolderSizeCalculator *const m_folderSizeCalculator;
+
+	boost::optional<std::wstring> m_fullPath;
+
+	bool m_parentFolderRetrieved;
+	wil::com_ptr<IShellFolder2> m_parentFolder;
+
+	bool m_versionInfoRetrieved;
+	std::vector<BYTE> m_versionInfo;
+};
+
+bool IsColumnCacheable(UINT ColumnID);
 std::wstring GetColumnText(UINT ColumnID, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings);
+std::wstring GetColumnText(UINT ColumnID, ItemColumnContext &context, const GlobalFolderSettings &globalFolderSettings);
 std::wstring GetNameColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
 std::wstring ProcessItemFileName(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
 std::wstring GetTypeColumnText(const BasicItemInfo_t &itemInfo);
@@ -74,7 +122,9 @@ std::wstring GetOwnerColumnText(const BasicItemInfo_t &itemInfo);
 std::wstring GetItemDetailsColumnText(const BasicItemInfo_t &itemInfo, const SHCOLUMNID *pscid, const GlobalFolderSettings &globalFolderSettings);
 HRESULT GetItemDetails(const BasicItemInfo_t &itemInfo, const SHCOLUMNID *pscid, TCHAR *szDetail, size_t cchMax, const GlobalFolderSettings &globalFolderSettings);
 HRESULT GetItemDetailsRawData(const BasicItemInfo_t &itemInfo, const SHCOLUMNID *pscid, VARIANT *vt);
+HRESULT GetItemDetailsRawData(ItemColumnContext &context, const SHCOLUMNID *pscid, VARIANT *vt);
 std::wstring GetVersionColumnText(const BasicItemInfo_t &itemInfo, VersionInfoType_t VersioninfoType);
+std::wstring GetVersionColumnText(ItemColumnContext &context, VersionInfoType_t VersioninfoType);
 std::wstring GetShortcutToColumnText(const BasicItemInfo_t &itemInfo);
 std::wstring GetHardLinksColumnText(const BasicItemInfo_t &itemInfo);
 DWORD GetHardLinksColumnRawData(const BasicItemInfo_t &itemInfo);
@@ -88,5 +138,16 @@ std::wstring GetMediaMetadataColumnText(const BasicItemInfo_t &itemInfo, MediaMe
 const TCHAR *GetMediaMetadataAttributeName(MediaMetadataType_t MediaMetaDataType);
 std::wstring GetDriveSpaceColumnText(const BasicItemInfo_t &itemInfo, bool TotalSize, const GlobalFolderSettings &globalFolderSettings);
 BOOL GetDriveSpaceColumnRawData(const BasicItemInfo_t &itemInfo, bool TotalSize, ULARGE_INTEGER &DriveSpace);
-std::wstring GetSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
-std::wstring GetFolderSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
\ No newline at end of file
+std::wstring GetSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings,
+	FolderSizeCalculator *folderSizeCalculator = nullptr);
+std::wstring GetFolderSizeColumnText(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings,
+	FolderSizeCalculator *folderSizeCalculator = nullptr);
+
+// Returns true if the size of the specified folder should be calculated
+// and shown, based on the folder size settings.
+bool IsFolderSizeEnabled(const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings);
+
+// If a calculator is provided, it will be used (meaning that the
+// calculation will be run in parallel and the result remembered).
+// Otherwise, the folder will be walked on the calling thread.
+ULONGLONG GetFolderSize(const std::wstring &path, FolderSizeCalculator *folderSizeCalculator);
\ No newline at end of file
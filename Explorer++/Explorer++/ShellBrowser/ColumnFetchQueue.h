@@ -0,0 +1,353 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Schedules the retrieval of column text one row at a time.
+//
+// The listview requests the text for each cell individually. Those
+// requests are collected here until Flush() is called (typically once the
+// listview has finished painting), at which point each row becomes a
+// single job covering every column that was requested for it. Jobs are
+// handed out newest first, so that the rows that were most recently
+// painted (i.e. the ones the user is currently looking at) are served
+// before anything else. Rows that have scrolled out of view by the time
+// the requests are flushed are dropped, since the listview will simply
+// request their text again if they're ever shown.
+//
+// Flush(), AddRequest() and CompleteJob() are designed to be called from
+// the UI thread, while TakeNextJob() can be called from any thread.
+template <typename RowData>
+class ColumnFetchQueue
+{
+public:
+
+	struct Job
+	{
+		Job(std::uint64_t id, int internalIndex, int itemIndex, std::vector<unsigned int> columnIds, RowData rowData) :
+			id(id),
+			internalIndex(internalIndex),
+			itemIndex(itemIndex),
+			columnIds(std::move(columnIds)),
+			rowData(std::move(rowData))
+		{
+
+		}
+
+		// Identifies this particular job. A row may have more than one
+		// job over its lifetime.
+		std::uint64_t id;
+
+		int internalIndex;
+
+		// The position of the item at the point it was last requested.
+		// This may no longer be accurate by the time the job is processed.
+		int itemIndex;
+
+		std::vector<unsigned int> columnIds;
+		RowData rowData;
+	};
+
+	enum class CompletionResult
+	{
+		// The job was no longer current (e.g. because the row was
+		// removed while the job was being processed). Its results
+		// should be discarded.
+		Stale,
+
+		Completed,
+
+		// Columns were requested while the job was being processed and
+		// have been collected again. A flush needs to be scheduled.
+		CompletedFlushNeeded
+	};
+
+	ColumnFetchQueue() :
+		m_sequenceNumber(0),
+		m_numCollectingRows(0)
+	{
+
+	}
+
+	// Records a request for the text of a single cell. Returns true if
+	// this is the first request since the queue was last flushed (i.e. if
+	// a flush needs to be scheduled).
+	bool AddRequest(int internalIndex, int itemIndex, unsigned int columnId)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		bool flushNeeded = !HasCollectingRowsLocked();
+
+		auto itr = m_rows.find(internalIndex);
+
+		if (itr == m_rows.end())
+		{
+			Row row;
+			row.state = RowState::Collecting;
+			row.itemIndex = itemIndex;
+			row.sequenceNumber = m_sequenceNumber++;
+			row.columnIds.push_back(columnId);
+			m_rows.insert({ internalIndex, std::move(row) });
+
+			m_numCollectingRows++;
+
+			return flushNeeded;
+		}
+
+		Row &row = itr->second;
+		row.itemIndex = itemIndex;
+
+		// A row that's requested again (e.g. because it's scrolled back
+		// into view) becomes the most recently requested row.
+		switch (row.state)
+		{
+		case RowState::Collecting:
+			AddColumn(row.columnIds, columnId);
+			row.sequenceNumber = m_sequenceNumber++;
+			break;
+
+		case RowState::Ready:
+			// The job hasn't been started yet, so it can simply be
+			// extended.
+			AddColumn(row.job->columnIds, columnId);
+
+			m_readyRows.erase(row.sequenceNumber);
+			row.sequenceNumber = m_sequenceNumber++;
+			row.job->id = row.sequenceNumber;
+			row.job->itemIndex = itemIndex;
+			m_readyRows.insert({ row.sequenceNumber, internalIndex });
+			break;
+
+		case RowState::InFlight:
+			if (std::find(row.columnIds.begin(), row.columnIds.end(), columnId) == row.columnIds.end())
+			{
+				AddColumn(row.missedColumnIds, columnId);
+			}
+			break;
+		}
+
+		return false;
+	}
+
+	// Turns each row that has been collected into a job and drops any
+	// queued row that's no longer within the specified range of items.
+	// The row data for each new job is produced by getRowData, which
+	// takes the internal index of the item. Returns the number of new
+	// jobs.
+	template <typename GetRowData>
+	int Flush(int firstVisibleItem, int lastVisibleItem, GetRowData getRowData)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		int numNewJobs = 0;
+
+		for (auto itr = m_rows.begin(); itr != m_rows.end();)
+		{
+			Row &row = itr->second;
+
+			if (row.state == RowState::InFlight)
+			{
+				++itr;
+				continue;
+			}
+
+			if (row.itemIndex < firstVisibleItem || row.itemIndex > lastVisibleItem)
+			{
+				if (row.state == RowState::Ready)
+				{
+					m_readyRows.erase(row.sequenceNumber);
+				}
+
+				itr = m_rows.erase(itr);
+				continue;
+			}
+
+			if (row.state == RowState::Collecting)
+			{
+				row.state = RowState::Ready;
+				row.job.emplace(row.sequenceNumber, itr->first, row.itemIndex, std::move(row.columnIds), getRowData(itr->first));
+				row.columnIds.clear();
+
+				m_readyRows.insert({ row.sequenceNumber, itr->first });
+
+				numNewJobs++;
+			}
+
+			++itr;
+		}
+
+		m_numCollectingRows = 0;
+
+		return numNewJobs;
+	}
+
+	// Returns the job for the most recently requested row, if there is
+	// one.
+	boost::optional<Job> TakeNextJob()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_readyRows.empty())
+		{
+			return boost::none;
+		}
+
+		auto readyItr = std::prev(m_readyRows.end());
+		Row &row = m_rows.at(readyItr->second);
+		m_readyRows.erase(readyItr);
+
+		boost::optional<Job> job(std::move(*row.job));
+		row.job.reset();
+
+		row.state = RowState::InFlight;
+		row.columnIds = job->columnIds;
+
+		return job;
+	}
+
+	// Should be called once a job has been processed, before its results
+	// are applied. Columns that were requested for the row while the job
+	// was being processed will be collected again.
+	CompletionResult CompleteJob(int internalIndex, std::uint64_t jobId)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto itr = m_rows.find(internalIndex);
+
+		if (itr == m_rows.end() || itr->second.state != RowState::InFlight
+			|| itr->second.sequenceNumber != jobId)
+		{
+			return CompletionResult::Stale;
+		}
+
+		Row &row = itr->second;
+
+		if (row.missedColumnIds.empty())
+		{
+			m_rows.erase(itr);
+			return CompletionResult::Completed;
+		}
+
+		bool flushNeeded = !HasCollectingRowsLocked();
+
+		row.state = RowState::Collecting;
+		row.sequenceNumber = m_sequenceNumber++;
+		row.columnIds = std::move(row.missedColumnIds);
+		row.missedColumnIds.clear();
+
+		m_numCollectingRows++;
+
+		return flushNeeded ? CompletionResult::CompletedFlushNeeded : CompletionResult::Completed;
+	}
+
+	// Removes a row entirely. Used when the item has been removed or when
+	// any existing results for it are out of date.
+	void RemoveRow(int internalIndex)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto itr = m_rows.find(internalIndex);
+
+		if (itr == m_rows.end())
+		{
+			return;
+		}
+
+		if (itr->second.state == RowState::Ready)
+		{
+			m_readyRows.erase(itr->second.sequenceNumber);
+		}
+		else if (itr->second.state == RowState::Collecting)
+		{
+			m_numCollectingRows--;
+		}
+
+		m_rows.erase(itr);
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_rows.clear();
+		m_readyRows.clear();
+		m_numCollectingRows = 0;
+	}
+
+	std::size_t GetNumQueuedJobs() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_readyRows.size();
+	}
+
+	std::size_t GetNumRows() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_rows.size();
+	}
+
+private:
+
+	enum class RowState
+	{
+		// Requests are still being collected for this row.
+		Collecting,
+
+		// The row has been flushed and is waiting for a worker.
+		Ready,
+
+		// A worker has taken the job for this row.
+		InFlight
+	};
+
+	struct Row
+	{
+		RowState state;
+		int itemIndex;
+		std::uint64_t sequenceNumber;
+
+		// The columns being collected (Collecting) or retrieved
+		// (InFlight).
+		std::vector<unsigned int> columnIds;
+
+		// Only set while the row is in the Ready state.
+		boost::optional<Job> job;
+
+		// Columns that were requested after the job was taken.
+		std::vector<unsigned int> missedColumnIds;
+	};
+
+	static void AddColumn(std::vector<unsigned int> &columnIds, unsigned int columnId)
+	{
+		if (std::find(columnIds.begin(), columnIds.end(), columnId) == columnIds.end())
+		{
+			columnIds.push_back(columnId);
+		}
+	}
+
+	bool HasCollectingRowsLocked() const
+	{
+		return m_numCollectingRows > 0;
+	}
+
+	mutable std::mutex m_mutex;
+
+	std::unordered_map<int, Row> m_rows;
+
+	// Maps the sequence number of each ready row to its internal index.
+	// A row is given a new sequence number each time it's requested, so
+	// the last element is the most recently requested row.
+	std::map<std::uint64_t, int> m_readyRows;
+
+	std::uint64_t m_sequenceNumber;
+	int m_numCollectingRows;
+};
@@ -15,8 +15,21 @@
 #include "../Helper/ShellHelper.h"
 #include <cassert>
 #include <list>
+#include <thread>
 
-void CShellBrowser::QueueColumnTask(int itemInternalIndex, int columnIndex)
+int CShellBrowser::GetNumColumnThreads()
+{
+	unsigned int numThreads = std::thread::hardware_concurrency();
+
+	if (numThreads == 0)
+	{
+		numThreads = 1;
+	}
+
+	return static_cast<int>((std::min)(numThreads, MAX_COLUMN_THREADS));
+}
+
+void CShellBrowser::QueueColumnTask(int itemInternalIndex, int itemIndex, int columnIndex)
 {
 	auto columnID = GetColumnIdByIndex(columnIndex);
 
@@ -25,39 +38,96 @@ void CShellBrowser::QueueColumnTask(int itemInternalIndex, int columnIndex)
 		return;
 	}
 
-	int columnResultID = m_columnResultIDCounter++;
+	bool flushNeeded = m_columnFetchQueue.AddRequest(itemInternalIndex, itemIndex, *columnID);
 
-	BasicItemInfo_t basicItemInfo = getBasicItemInfo(itemInternalIndex);
-	GlobalFolderSettings globalFolderSettings = m_config->globalFolderSettings;
+	if (flushNeeded)
+	{
+		// The listview requests the text for each cell individually.
+		// Deferring the flush until those requests have been made (i.e.
+		// until the listview has finished painting) means that all the
+		// columns for a row can be retrieved in a single task.
+		PostMessage(m_hListView, WM_APP_COLUMN_REQUESTS_PENDING, 0, 0);
+	}
+}
+
+void CShellBrowser::FlushColumnRequests()
+{
+	if (m_folderSettings.viewMode != +ViewMode::Details)
+	{
+		return;
+	}
 
-	auto result = m_columnThreadPool.push([this, columnResultID, columnID, itemInternalIndex, basicItemInfo, globalFolderSettings](int id) {
-		UNREFERENCED_PARAMETER(id);
+	// Any row that's no longer visible will be dropped. If the row is
+	// scrolled back into view, the listview will request its text again.
+	int firstVisibleItem = ListView_GetTopIndex(m_hListView);
+	int lastVisibleItem = firstVisibleItem + ListView_GetCountPerPage(m_hListView);
 
-		return GetColumnTextAsync(m_hListView, columnResultID, *columnID, itemInternalIndex, basicItemInfo, globalFolderSettings);
+	int numJobs = m_columnFetchQueue.Flush(firstVisibleItem, lastVisibleItem, [this] (int internalIndex) {
+		return getBasicItemInfo(internalIndex);
 	});
 
-	// The function call above might finish before this line runs,
-	// but that doesn't matter, as the results won't be processed
-	// until a message posted to the main thread has been handled
-	// (which can only occur after this function has returned).
-	m_columnResults.insert({ columnResultID, std::move(result) });
+	if (numJobs == 0)
+	{
+		return;
+	}
+
+	auto globalFolderSettings = std::make_shared<const GlobalFolderSettings>(m_config->globalFolderSettings);
+
+	// Each task simply takes the most recently requested row from the
+	// queue, so the tasks themselves don't need to refer to a specific
+	// row.
+	for (int i = 0; i < numJobs; i++)
+	{
+		int columnResultID = m_columnResultIDCounter++;
+
+		auto result = m_columnTaskQueue->Push(TaskScheduler::TaskPriority::Visible,
+			[this, columnResultID, globalFolderSettings] {
+			return GetColumnTextAsync(m_hListView, columnResultID, &m_columnFetchQueue, m_columnCache,
+				m_folderSizeCalculator, globalFolderSettings);
+		});
+
+		// The function call above might finish before this line runs,
+		// but that doesn't matter, as the results won't be processed
+		// until a message posted to the main thread has been handled
+		// (which can only occur after this function has returned).
+		m_columnResults.insert({ columnResultID, std::move(result) });
+	}
 }
 
-CShellBrowser::ColumnResult_t CShellBrowser::GetColumnTextAsync(HWND listView, int columnResultId, unsigned int ColumnID,
-	int InternalIndex, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings)
+boost::optional<CShellBrowser::ColumnResult_t> CShellBrowser::GetColumnTextAsync(HWND listView, int columnResultId,
+	ColumnFetchQueue<BasicItemInfo_t> *columnFetchQueue, ColumnCache *columnCache,
+	FolderSizeCalculator *folderSizeCalculator, std::shared_ptr<const GlobalFolderSettings> globalFolderSettings)
 {
-	std::wstring columnText = GetColumnText(ColumnID, basicItemInfo, globalFolderSettings);
+	auto job = columnFetchQueue->TakeNextJob();
+
+	if (!job)
+	{
+		// The row this task was created for has been dropped (or was
+		// handled by another task). The message is still posted, so that
+		// the result entry is removed.
+		PostMessage(listView, WM_APP_COLUMN_RESULT_READY, columnResultId, 0);
+		return boost::none;
+	}
+
+	ColumnResult_t result;
+	result.jobId = job->id;
+	result.itemInternalIndex = job->internalIndex;
+	result.itemIndex = job->itemIndex;
+
+	// Resources that are needed by more than one column (such as the
+	// file's version information) will only be retrieved once.
+	ItemColumnContext context(job->rowData, columnCache, folderSizeCalculator);
+
+	for (unsigned int columnId : job->columnIds)
+	{
+		result.columnTexts.push_back({ columnId, GetColumnText(columnId, context, *globalFolderSettings) });
+	}
 
 	// This message may be delivered before this function has returned.
 	// That doesn't actually matter, since the message handler will
 	// simply wait for the result to be returned.
 	PostMessage(listView, WM_APP_COLUMN_RESULT_READY, columnResultId, 0);
 
-	ColumnResult_t result;
-	result.itemInternalIndex = InternalIndex;
-	result.columnID = ColumnID;
-	result.columnText = columnText;
-
 	return result;
 }
 
@@ -71,34 +141,76 @@ void CShellBrowser::ProcessColumnResult(int columnResultId)
 		return;
 	}
 
-	if (m_folderSettings.viewMode != +ViewMode::Details)
+	auto result = itr->second.get();
+	m_columnResults.erase(itr);
+
+	if (!result)
 	{
 		return;
 	}
 
-	auto result = itr->second.get();
+	if (m_folderSettings.viewMode != +ViewMode::Details)
+	{
+		return;
+	}
 
-	auto index = LocateItemByInternalIndex(result.itemInternalIndex);
+	auto completionResult = m_columnFetchQueue.CompleteJob(result->itemInternalIndex, result->jobId);
 
-	if (!index)
+	if (completionResult == ColumnFetchQueue<BasicItemInfo_t>::CompletionResult::Stale)
 	{
-		// This is a valid state. The item may simply have been deleted.
+		// The item has either been removed or modified since the text
+		// was retrieved.
 		return;
 	}
 
-	auto columnIndex = GetColumnIndexById(result.columnID);
+	if (completionResult == ColumnFetchQueue<BasicItemInfo_t>::CompletionResult::CompletedFlushNeeded)
+	{
+		PostMessage(m_hListView, WM_APP_COLUMN_REQUESTS_PENDING, 0, 0);
+	}
+
+	boost::optional<int> index;
+
+	// The item will usually still be in the same position it was in when
+	// it was requested, in which case there's no need to search for it.
+	LVITEM lvItem;
+	lvItem.mask = LVIF_PARAM;
+	lvItem.iItem = result->itemIndex;
+	lvItem.iSubItem = 0;
+	BOOL res = ListView_GetItem(m_hListView, &lvItem);
 
-	if (!columnIndex)
+	if (res && static_cast<int>(lvItem.lParam) == result->itemInternalIndex)
+	{
+		index = result->itemIndex;
+	}
+	else
+	{
+		index = LocateItemByInternalIndex(result->itemInternalIndex);
+	}
+
+	if (!index)
 	{
-		// This is also a valid state. The column may have been removed.
 		return;
 	}
 
-	auto columnText = std::make_unique<TCHAR[]>(result.columnText.size() + 1);
-	StringCchCopy(columnText.get(), result.columnText.size() + 1, result.columnText.c_str());
-	ListView_SetItemText(m_hListView, *index, *columnIndex, columnText.get());
+	for (auto &columnText : result->columnTexts)
+	{
+		auto columnIndex = GetColumnIndexById(columnText.first);
 
-	m_columnResults.erase(itr);
+		if (!columnIndex)
+		{
+			// This is a valid state. The column may have been removed.
+			continue;
+		}
+
+		ListView_SetItemText(m_hListView, *index, *columnIndex, columnText.second.data());
+	}
+}
+
+void CShellBrowser::ClearColumnResults()
+{
+	m_columnTaskQueue->Cancel();
+	m_columnResults.clear();
+	m_columnFetchQueue.Clear();
 }
 
 boost::optional<int> CShellBrowser::GetColumnIndexById(unsigned int id) const
@@ -1151,7 +1263,6 @@ void CShellBrowser::ImportColumns(const std::vector<Column_t> &columns)
 	Column_t ci;
 	BOOL bResortFolder = FALSE;
 	int iColumn = 0;
-	int i = 0;
 
 	for (auto itr = columns.begin(); itr != columns.end(); itr++)
 	{
@@ -1184,22 +1295,10 @@ void CShellBrowser::ImportColumns(const std::vector<Column_t> &columns)
 					if (itr2->id == itr->id &&
 						!itr2->bChecked)
 					{
+						// The text for the new column will be requested
+						// as each item is drawn.
 						InsertColumn(itr->id, iColumn, itr->iWidth);
 
-						for (i = 0; i < m_nTotalItems; i++)
-						{
-							LVITEM lvItem;
-							lvItem.mask = LVIF_PARAM;
-							lvItem.iItem = i;
-							lvItem.iSubItem = 0;
-							BOOL res = ListView_GetItem(m_hListView, &lvItem);
-
-							if (res)
-							{
-								QueueColumnTask(static_cast<int>(lvItem.lParam), itr->id);
-							}
-						}
-
 						break;
 					}
 				}
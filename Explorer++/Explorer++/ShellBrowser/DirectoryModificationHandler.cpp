@@ -5,87 +5,114 @@
 #include "stdafx.h"
 #include "ShellBrowser.h"
 #include "Config.h"
+#include "FolderDiff.h"
 #include "ViewModes.h"
 #include "../Helper/Controls.h"
 #include "../Helper/FileOperations.h"
 #include "../Helper/FolderSize.h"
 #include "../Helper/Helper.h"
+#include "../Helper/iDirectoryMonitor.h"
 #include "../Helper/ListViewHelper.h"
 #include "../Helper/Logging.h"
 #include "../Helper/Macros.h"
 #include "../Helper/ShellHelper.h"
 #include <list>
+#include <unordered_set>
 
-BOOL g_bNewFileRenamed = FALSE;
-static int iRenamedItem;
-
-void CShellBrowser::DirectoryAltered(void)
+namespace
 {
-	BOOL bNewItemCreated;
+	FolderDiffItem BuildFolderDiffItem(const WIN32_FIND_DATA &wfd)
+	{
+		ULARGE_INTEGER size = { wfd.nFileSizeLow, wfd.nFileSizeHigh };
+		ULARGE_INTEGER lastWriteTime = { wfd.ftLastWriteTime.dwLowDateTime, wfd.ftLastWriteTime.dwHighDateTime };
 
-	EnterCriticalSection(&m_csDirectoryAltered);
+		return { wfd.cFileName, wfd.dwFileAttributes, size.QuadPart, lastWriteTime.QuadPart };
+	}
 
-	bNewItemCreated = m_bNewItemCreated;
+	/* Matches the items that IShellFolder::EnumObjects()
+	returns for a file system folder, given the same flags.
+	Hidden items need SHCONTF_INCLUDEHIDDEN, while protected
+	operating system files (those that are both hidden and
+	system files, such as desktop.ini) also need
+	SHCONTF_INCLUDESUPERHIDDEN. */
+	bool IsItemEnumerated(DWORD attributes,SHCONTF enumFlags)
+	{
+		if(WI_IsFlagClear(attributes,FILE_ATTRIBUTE_HIDDEN))
+		{
+			return true;
+		}
 
-	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)FALSE,(LPARAM)NULL);
+		if(WI_IsFlagClear(enumFlags,SHCONTF_INCLUDEHIDDEN))
+		{
+			return false;
+		}
 
-	LOG(debug) << _T("ShellBrowser - Starting directory change update for \"") << m_CurDir << _T("\"");
-
-	/* Potential problem:
-	After a file is created, it may be renamed shortly afterwards.
-	If the rename occurs before the file is added here, the
-	addition won't be registered (since technically, the file
-	does not exist), and the rename operation will not take place.
-	Adding an item that does not exist will corrupt the programs
-	state.
-
-	Solution:
-	If a file does not exist when adding it, temporarily remember
-	its filename. On the next rename operation, if the renamed
-	file matches the name of the added file, add the file in-place
-	with its new name.
-	The operation should NOT be queued, as it is possible that
-	other actions for the file will take place before the addition,
-	which will again result in an incorrect state.
-	*/
-	for(const auto &af : m_AlteredList)
-	{
-		/* Only undertake the modification if the unique folder
-		index on the modified item and current folder match up
-		(i.e. ensure the directory has not changed since these
-		files were modified). */
-		if(af.iFolderIndex == m_uniqueFolderId)
+		if(WI_IsFlagSet(attributes,FILE_ATTRIBUTE_SYSTEM)
+			&& WI_IsFlagClear(enumFlags,SHCONTF_INCLUDESUPERHIDDEN))
 		{
-			switch(af.dwAction)
-			{
-			case FILE_ACTION_ADDED:
-				LOG(debug) << _T("ShellBrowser - Adding \"") << af.szFileName << _T("\"");
-				OnFileActionAdded(af.szFileName);
-				break;
+			return false;
+		}
 
-			case FILE_ACTION_MODIFIED:
-				LOG(debug) << _T("ShellBrowser - Modifying \"") << af.szFileName << _T("\"");
-				ModifyItemInternal(af.szFileName);
-				break;
+		return true;
+	}
+}
 
-			case FILE_ACTION_REMOVED:
-				LOG(debug) << _T("ShellBrowser - Removing \"") << af.szFileName << _T("\"");
-				RemoveItemInternal(af.szFileName);
-				break;
+void CShellBrowser::DirectoryAltered(void)
+{
+	/* Changes are held back until the folder has been fully
+	enumerated (OnEnumerationCompleted() will call back into
+	this function). The same applies while the folder's
+	contents are being listed for a resync (see
+	ProcessResyncResult()). */
+	if(IsEnumerating() || !m_resyncResults.empty())
+	{
+		return;
+	}
 
-			case FILE_ACTION_RENAMED_OLD_NAME:
-				LOG(debug) << _T("ShellBrowser - Old name received \"") << af.szFileName << _T("\"");
-				OnFileActionRenamedOldName(af.szFileName);
-				break;
+	/* The individual notifications have already been
+	collapsed into a set of net changes, so each file is
+	only updated once. */
+	EnterCriticalSection(&m_csDirectoryAltered);
+	size_t nEvents = m_changeJournal.GetNumEvents();
+	std::vector<ChangeJournal::Change> changes = m_changeJournal.TakeChanges();
+	bool resyncRequired = m_resyncRequired;
+	m_resyncRequired = false;
+	LeaveCriticalSection(&m_csDirectoryAltered);
 
-			case FILE_ACTION_RENAMED_NEW_NAME:
-				LOG(debug) << _T("ShellBrowser - New name received \"") << af.szFileName << _T("\"");
-				OnFileActionRenamedNewName(af.szFileName);
-				break;
-			}
+	/* If any notifications were lost, the ones that
+	were received can't be relied upon. Instead, the
+	items are compared against the folder's contents,
+	which are listed in the background. */
+	if(resyncRequired)
+	{
+		if(!InVirtualFolder())
+		{
+			StartResync();
+			return;
 		}
+
+		changes.clear();
+		m_FilesAdded.clear();
 	}
 
+	UpdateDirectory(changes,nEvents);
+}
+
+/* Applies a set of changes to the listview, then selects
+any items that were waiting to be selected. */
+void CShellBrowser::UpdateDirectory(const std::vector<ChangeJournal::Change> &changes,size_t nEvents)
+{
+	BOOL bNewItemCreated;
+
+	bNewItemCreated = m_bNewItemCreated;
+
+	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)FALSE,(LPARAM)NULL);
+
+	LOG(debug) << _T("ShellBrowser - Starting directory change update for \"") << m_CurDir << _T("\" (")
+		<< changes.size() << _T(" changes from ") << nEvents << _T(" notifications)");
+
+	ApplyDirectoryChanges(changes);
+
 	LOG(debug) << _T("ShellBrowser - Finished directory change update for \"") << m_CurDir << _T("\"");
 
 	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)TRUE,(LPARAM)NULL);
@@ -104,8 +131,6 @@ void CShellBrowser::DirectoryAltered(void)
 	if(bNewItemCreated && !m_bNewItemCreated)
 		SendMessage(m_hOwner,WM_USER_NEWITEMINSERTED,0,m_iIndexNewItem);
 
-	m_AlteredList.clear();
-
 	BOOL bFocusSet = FALSE;
 	int iIndex;
 
@@ -136,9 +161,318 @@ void CShellBrowser::DirectoryAltered(void)
 		}
 	}
 
+	return;
+}
+
+void CShellBrowser::ApplyDirectoryChanges(const std::vector<ChangeJournal::Change> &changes)
+{
+	std::vector<int> removedItems;
+	std::unordered_set<int> removedItemSet;
+	std::vector<std::pair<int, std::wstring>> renamedItems;
+	std::vector<std::wstring> addedFiles;
+	std::vector<std::wstring> modifiedFiles;
+
+	/* Each of the changes is gathered up first, so that
+	the changes of each type can be applied together
+	below. */
+	for(const auto &change : changes)
+	{
+		InvalidateFolderSize(change.name);
+
+		if(change.type == ChangeJournal::ChangeType::Renamed)
+		{
+			InvalidateFolderSize(change.oldName);
+		}
+
+		switch(change.type)
+		{
+		case ChangeJournal::ChangeType::Removed:
+		{
+			/* If the file was removed before it could be added,
+			there's nothing to remove. */
+			auto itrAdded = std::find_if(m_FilesAdded.begin(), m_FilesAdded.end(),
+				[&change] (const Added_t &added) {
+				return lstrcmp(added.szFileName, change.name.c_str()) == 0;
+			});
+
+			if(itrAdded != m_FilesAdded.end())
+			{
+				m_FilesAdded.erase(itrAdded);
+				break;
+			}
+
+			int iItemInternal = LocateFileItemInternalIndex(change.name.c_str());
+
+			if(iItemInternal != -1 && removedItemSet.insert(iItemInternal).second)
+			{
+				removedItems.push_back(iItemInternal);
+			}
+		}
+			break;
+
+		case ChangeJournal::ChangeType::Renamed:
+		{
+			/* Potential problem:
+			After a file is created, it may be renamed shortly afterwards.
+			If the rename occurs before the file is added here, the
+			addition won't be registered (since technically, the file
+			does not exist).
+
+			Solution:
+			If a file does not exist when adding it, temporarily remember
+			its filename. If the file is then renamed, add it with its
+			new name. */
+			auto itrAdded = std::find_if(m_FilesAdded.begin(), m_FilesAdded.end(),
+				[&change] (const Added_t &added) {
+				return lstrcmp(added.szFileName, change.oldName.c_str()) == 0;
+			});
+
+			if(itrAdded != m_FilesAdded.end())
+			{
+				m_FilesAdded.erase(itrAdded);
+				addedFiles.push_back(change.name);
+				break;
+			}
+
+			/* Each of the renamed items is located before any of them
+			are renamed, since one item may be renamed to the previous
+			name of another. */
+			int iItemInternal = LocateFileItemInternalIndex(change.oldName.c_str());
+
+			/* An item that's being removed can't also be renamed
+			(the file with the old name must be a different
+			file). */
+			if(iItemInternal != -1 && removedItemSet.count(iItemInternal) == 0)
+			{
+				renamedItems.push_back({ iItemInternal, change.name });
+			}
+			else
+			{
+				addedFiles.push_back(change.name);
+			}
+		}
+			break;
+
+		case ChangeJournal::ChangeType::Added:
+			addedFiles.push_back(change.name);
+			break;
+
+		case ChangeJournal::ChangeType::Modified:
+			modifiedFiles.push_back(change.name);
+			break;
+		}
+	}
+
+	/* Removals are applied first, so that a new item can
+	take the name of an item that's been removed. */
+	RemoveItems(removedItems);
+
+	for(const auto &renamedItem : renamedItems)
+	{
+		LOG(debug) << _T("ShellBrowser - Renaming item to \"") << renamedItem.second << _T("\"");
+		RenameItem(renamedItem.first, renamedItem.second.c_str());
+	}
+
+	BOOL bDeferInsertion = addedFiles.size() > DEFERRED_INSERTION_THRESHOLD;
+
+	for(const auto &addedFile : addedFiles)
+	{
+		/* If the file was added while the folder was being
+		enumerated, it may have been picked up by the
+		enumeration as well. */
+		if(LocateFileItemInternalIndex(addedFile.c_str()) != -1)
+		{
+			modifiedFiles.push_back(addedFile);
+			continue;
+		}
+
+		OnFileActionAdded(addedFile.c_str(), bDeferInsertion);
+	}
+
+	if(bDeferInsertion)
+	{
+		/* The added items are merged into the (already sorted)
+		listview in one pass, rather than being appended and
+		then having the entire folder resorted. */
+		if(m_config->globalFolderSettings.insertSorted)
+		{
+			SortAwaitingItems();
+		}
+
+		InsertAwaitingItems(m_folderSettings.showInGroups);
+	}
+
+	/* The rows of the modified items are all located up
+	front. Modifying an item doesn't move it, so the rows
+	remain valid while the items are updated. */
+	std::vector<int> modifiedRows;
+	modifiedRows.reserve(modifiedFiles.size());
+
+	for(const auto &modifiedFile : modifiedFiles)
+	{
+		modifiedRows.push_back(LocateFileItemIndex(modifiedFile.c_str()));
+	}
+
+	for(size_t i = 0;i < modifiedFiles.size();i++)
+	{
+		ModifyItemInternal(modifiedFiles[i].c_str(),modifiedRows[i]);
+	}
+}
+
+/* Works out the changes that have been made to the folder
+by comparing the items that are currently held against the
+items that are on disk. This only needs to read the
+directory, so it's much cheaper than refreshing the folder.
+The directory is read in the background, since it may still
+contain a large number of items. */
+void CShellBrowser::StartResync()
+{
+	LOG(debug) << _T("ShellBrowser - Resynchronizing \"") << m_CurDir << _T("\"");
+
+	int resyncResultId = m_resyncResultIDCounter++;
+
+	auto result = m_resyncTaskQueue->Push(TaskScheduler::TaskPriority::Normal,
+		[listView = m_hListView,resyncResultId,directory = std::wstring(m_CurDir),
+		enumFlags = GetEnumerationFlags()] {
+		return ListFolderItemsAsync(listView,resyncResultId,directory,enumFlags);
+	});
+
+	m_resyncResults.insert({ resyncResultId,std::move(result) });
+}
+
+boost::optional<std::vector<FolderDiffItem>> CShellBrowser::ListFolderItemsAsync(HWND listView,
+	int resyncResultId,const std::wstring &directory,SHCONTF enumFlags)
+{
+	/* As with the other background results, the message
+	handler will wait for the result, if necessary. */
+	auto postResult = wil::scope_exit([listView,resyncResultId] {
+		PostMessage(listView,WM_APP_RESYNC_LISTING_READY,resyncResultId,0);
+	});
+
+	TCHAR szSearchPath[MAX_PATH];
+	PathCombine(szSearchPath,directory.c_str(),_T("*"));
+
+	WIN32_FIND_DATA wfd;
+	HANDLE hFindFile = FindFirstFileEx(szSearchPath,FindExInfoBasic,&wfd,
+		FindExSearchNameMatch,nullptr,FIND_FIRST_EX_LARGE_FETCH);
+
+	if(hFindFile == INVALID_HANDLE_VALUE)
+	{
+		/* The folder itself may have been removed, in which
+		case there's nothing to compare against. */
+		return boost::none;
+	}
+
+	std::vector<FolderDiffItem> folderItems;
+
+	do
+	{
+		if(lstrcmp(wfd.cFileName,_T(".")) == 0 || lstrcmp(wfd.cFileName,_T("..")) == 0)
+		{
+			continue;
+		}
+
+		if(!IsItemEnumerated(wfd.dwFileAttributes,enumFlags))
+		{
+			continue;
+		}
+
+		folderItems.push_back(BuildFolderDiffItem(wfd));
+	} while(FindNextFile(hFindFile,&wfd));
+
+	FindClose(hFindFile);
+
+	return folderItems;
+}
+
+void CShellBrowser::ProcessResyncResult(int resyncResultId)
+{
+	auto itr = m_resyncResults.find(resyncResultId);
+
+	if(itr == m_resyncResults.end())
+	{
+		/* The folder has changed since the listing was
+		requested. */
+		return;
+	}
+
+	auto folderItems = itr->second.get();
+	m_resyncResults.erase(itr);
+
+	std::vector<ChangeJournal::Change> changes;
+
+	if(folderItems)
+	{
+		std::vector<FolderDiffItem> currentItems;
+		currentItems.reserve(m_itemInfoMap.size());
+
+		for(const auto &item : m_itemInfoMap)
+		{
+			currentItems.push_back(BuildFolderDiffItem(item.second.wfd));
+		}
+
+		changes = DiffFolderItems(currentItems,*folderItems);
+	}
+
+	m_FilesAdded.clear();
+
+	UpdateDirectory(changes,0);
+
+	/* Any changes that arrived while the folder was being
+	listed were held back. Some of them may already be
+	reflected in the listing, but applying them again is
+	harmless (an added item that already exists is treated
+	as having been modified). */
+	EnterCriticalSection(&m_csDirectoryAltered);
+	bool directoryAltered = !m_changeJournal.IsEmpty() || m_resyncRequired;
 	LeaveCriticalSection(&m_csDirectoryAltered);
 
-	return;
+	if(directoryAltered)
+	{
+		DirectoryAltered();
+	}
+}
+
+void CShellBrowser::ClearResyncResults()
+{
+	m_resyncTaskQueue->Cancel();
+	m_resyncResults.clear();
+}
+
+/* Any change to an item may alter its total size (if it's
+a folder), as well as the total size of this folder. */
+void CShellBrowser::InvalidateFolderSize(const std::wstring &fileName)
+{
+	int iItemInternal = LocateFileItemInternalIndex(fileName.c_str());
+	bool calculationPending = false;
+
+	if(iItemInternal != -1)
+	{
+		m_cachedFolderSizes.erase(iItemInternal);
+
+		/* A size that's still being calculated for sorting may
+		already be out of date, so the calculation is restarted. */
+		auto itr = m_folderSizeResults.find(iItemInternal);
+
+		if(itr != m_folderSizeResults.end())
+		{
+			m_folderSizeCalculator->CancelCalculation(itr->second.calculationId);
+			m_folderSizeResults.erase(itr);
+			calculationPending = true;
+		}
+	}
+
+	if(m_folderSizeCalculator && !InVirtualFolder())
+	{
+		TCHAR fullPath[MAX_PATH];
+		PathCombine(fullPath,m_CurDir,fileName.c_str());
+		m_folderSizeCalculator->InvalidateCachedTotals(fullPath);
+
+		if(calculationPending)
+		{
+			QueueFolderSizeCalculation(iItemInternal,fullPath);
+		}
+	}
 }
 
 void CALLBACK TimerProc(HWND hwnd,UINT uMsg,UINT_PTR idEvent,DWORD dwTime)
@@ -156,20 +490,37 @@ int EventId,int iFolderIndex)
 {
 	EnterCriticalSection(&m_csDirectoryAltered);
 
-	SetTimer(m_hOwner,EventId,200,TimerProc);
+	/* Only record the modification if the unique folder
+	index on the modified item and current folder match up
+	(i.e. ensure the directory has not changed since these
+	files were modified). */
+	if(iFolderIndex != m_uniqueFolderId)
+	{
+		LeaveCriticalSection(&m_csDirectoryAltered);
+		return;
+	}
 
-	AlteredFile_t af;
+	auto now = std::chrono::steady_clock::now();
 
-	StringCchCopy(af.szFileName,SIZEOF_ARRAY(af.szFileName),FileName);
-	af.dwAction = Action;
-	af.iFolderIndex = iFolderIndex;
+	if(Action == DIRECTORY_MONITOR_ACTION_OVERFLOW)
+	{
+		m_resyncRequired = true;
+	}
+	else
+	{
+		m_changeJournal.AddEvent(Action, FileName, now);
+	}
 
-	m_AlteredList.push_back(af);
+	/* The timer is reset each time a notification arrives. The
+	delay grows as more notifications arrive, so that a large
+	set of changes (e.g. extracting an archive) is applied in as
+	few updates as possible. */
+	SetTimer(m_hOwner,EventId,static_cast<UINT>(m_changeJournal.GetDebounceDelay(now).count()),TimerProc);
 
 	LeaveCriticalSection(&m_csDirectoryAltered);
 }
 
-void CShellBrowser::OnFileActionAdded(const TCHAR *szFileName)
+void CShellBrowser::OnFileActionAdded(const TCHAR *szFileName, BOOL bDeferInsertion)
 {
 	IShellFolder	*pShellFolder = NULL;
 	PCITEMID_CHILD	pidlRelative = NULL;
@@ -225,8 +576,10 @@ void CShellBrowser::OnFileActionAdded(const TCHAR *szFileName)
 				}
 
 				/* Only insert the item in its sorted position if it
-				wasn't dropped in. */
-				if(m_config->globalFolderSettings.insertSorted && !bDropped)
+				wasn't dropped in. If insertion has been deferred, the
+				caller will place all the added items in their sorted
+				positions at once. */
+				if(m_config->globalFolderSettings.insertSorted && !bDropped && !bDeferInsertion)
 				{
 					int iItemId;
 					int iSorted;
@@ -243,7 +596,10 @@ void CShellBrowser::OnFileActionAdded(const TCHAR *szFileName)
 					AddItemInternal(m_directoryState.pidlDirectory.get(),pidlRelative,szDisplayName,-1,FALSE);
 				}
 				
-				InsertAwaitingItems(m_folderSettings.showInGroups);
+				if(!bDeferInsertion)
+				{
+					InsertAwaitingItems(m_folderSettings.showInGroups);
+				}
 
 				bFileAdded = TRUE;
 			}
@@ -263,37 +619,11 @@ void CShellBrowser::OnFileActionAdded(const TCHAR *szFileName)
 	}
 }
 
-void CShellBrowser::RemoveItemInternal(const TCHAR *szFileName)
-{
-	std::list<Added_t>::iterator itr;
-	int iItemInternal;
-	BOOL bFound = FALSE;
-
-	/* First check if this item is in the queue of awaiting
-	items. If it is, remove it. */
-	for(itr = m_FilesAdded.begin();itr != m_FilesAdded.end();itr++)
-	{
-		if(lstrcmp(szFileName,itr->szFileName) == 0)
-		{
-			m_FilesAdded.erase(itr);
-			bFound = TRUE;
-			break;
-		}
-	}
-
-	if(!bFound)
-	{
-		iItemInternal = LocateFileItemInternalIndex(szFileName);
-
-		if(iItemInternal != -1)
-			RemoveItem(iItemInternal);
-	}
-}
-
 /*
  * Modifies the attributes of an item currently in the listview.
+ * iItem is the item's row, or -1 if it's not in the listview.
  */
-void CShellBrowser::ModifyItemInternal(const TCHAR *FileName)
+void CShellBrowser::ModifyItemInternal(const TCHAR *FileName, int iItem)
 {
 	HANDLE			hFirstFile;
 	ULARGE_INTEGER	ulFileSize;
@@ -301,11 +631,8 @@ void CShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 	TCHAR			FullFileName[MAX_PATH];
 	BOOL			bFolder;
 	BOOL			res;
-	int				iItem;
 	int				iItemInternal = -1;
 
-	iItem = LocateFileItemIndex(FileName);
-
 	/* Although an item may not have been added to the listview
 	yet, it is critical that its' size still be updated if
 	necessary.
@@ -400,6 +727,14 @@ void CShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 
 		if(hFirstFile != INVALID_HANDLE_VALUE)
 		{
+			/* The short name may not have been generated
+			at the point the item was added. */
+			m_itemNameIndex.UpdateItem(iItemInternal, m_itemInfoMap.at(iItemInternal).wfd.cFileName,
+				m_itemInfoMap.at(iItemInternal).wfd.cAlternateFileName);
+
+			/* The item's attributes may have changed. */
+			UpdateItemColor(m_itemInfoMap.at(iItemInternal));
+
 			ulFileSize.LowPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeLow;
 			ulFileSize.HighPart = m_itemInfoMap.at(iItemInternal).wfd.nFileSizeHigh;
 
@@ -424,15 +759,19 @@ void CShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 
 			if(m_folderSettings.viewMode == +ViewMode::Details)
 			{
-				if(m_pActiveColumns != NULL)
+				/* Any text that's currently being retrieved
+				is out of date. Resetting each column means
+				that its text will be requested again the
+				next time the item is drawn. The first
+				column holds the item's name and is left
+				as-is. */
+				m_columnFetchQueue.RemoveRow(iItemInternal);
+
+				int nColumns = Header_GetItemCount(ListView_GetHeader(m_hListView));
+
+				for(int i = 1;i < nColumns;i++)
 				{
-					for(auto itrColumn = m_pActiveColumns->begin();itrColumn != m_pActiveColumns->end();itrColumn++)
-					{
-						if(itrColumn->bChecked)
-						{
-							QueueColumnTask(iItemInternal, itrColumn->id);
-						}
-					}
+					ListView_SetItemText(m_hListView,iItem,i,LPSTR_TEXTCALLBACK);
 				}
 			}
 
@@ -455,52 +794,6 @@ void CShellBrowser::ModifyItemInternal(const TCHAR *FileName)
 	}
 }
 
-void CShellBrowser::OnFileActionRenamedOldName(const TCHAR *szFileName)
-{
-	std::list<Added_t>::iterator itrAdded;
-	BOOL bFileHandled = FALSE;
-
-	/* Loop through each file that is awaiting add to check for the
-	renamed file. */
-	for(itrAdded = m_FilesAdded.begin();itrAdded != m_FilesAdded.end();itrAdded++)
-	{
-		if(lstrcmp(szFileName,itrAdded->szFileName) == 0)
-		{
-			bFileHandled = TRUE;
-
-			g_bNewFileRenamed = TRUE;
-
-			m_FilesAdded.erase(itrAdded);
-
-			break;
-		}
-	}
-
-	if(!bFileHandled)
-	{
-		/* Find the index of the item that was renamed...
-		Store the index so that it is known which item needs
-		renaming when the files new name is received. */
-		iRenamedItem = LocateFileItemInternalIndex(szFileName);
-	}
-}
-
-void CShellBrowser::OnFileActionRenamedNewName(const TCHAR *szFileName)
-{
-	if(g_bNewFileRenamed)
-	{
-		/* The file that was previously added was renamed before
-		it could be added. Add the file now. */
-		OnFileActionAdded(szFileName);
-
-		g_bNewFileRenamed = FALSE;
-	}
-	else
-	{
-		RenameItem(iRenamedItem,szFileName);
-	}
-}
-
 /* Renames an item currently in the listview.
  */
 /* TODO: This code should be coalesced with the code that
@@ -512,13 +805,11 @@ void CShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 	IShellFolder	*pShellFolder = NULL;
 	PCITEMID_CHILD	pidlRelative = NULL;
 	SHFILEINFO		shfi;
-	LVFINDINFO		lvfi;
 	TCHAR			szDisplayName[MAX_PATH];
 	LVITEM			lvItem;
 	TCHAR			szFullFileName[MAX_PATH];
 	DWORD_PTR		res;
 	HRESULT			hr;
-	int				iItem;
 
 	if(iItemInternal == -1)
 		return;
@@ -546,6 +837,9 @@ void CShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 				StringCchCopy(itemInfo.szDisplayName, SIZEOF_ARRAY(itemInfo.szDisplayName), szDisplayName);
 				StringCchCopy(itemInfo.wfd.cFileName, SIZEOF_ARRAY(itemInfo.wfd.cFileName), szNewFileName);
 
+				m_itemNameIndex.UpdateItem(iItemInternal, itemInfo.wfd.cFileName, itemInfo.wfd.cAlternateFileName);
+				UpdateItemColor(itemInfo);
+
 				/* The files' type may have changed, so retrieve the files'
 				icon again. */
 				res = SHGetFileInfo((LPTSTR)pidlFull.get(),0,&shfi,
@@ -555,11 +849,9 @@ void CShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 				if(res != 0)
 				{
 					/* Locate the item within the listview. */
-					lvfi.flags	= LVFI_PARAM;
-					lvfi.lParam	= iItemInternal;
-					iItem = ListView_FindItem(m_hListView,-1,&lvfi);
+					auto iItem = LocateItemByInternalIndex(iItemInternal);
 
-					if(iItem != -1)
+					if(iItem)
 					{
 						BasicItemInfo_t basicItemInfo = getBasicItemInfo(iItemInternal);
 						std::wstring filename = ProcessItemFileName(basicItemInfo, m_config->globalFolderSettings);
@@ -568,7 +860,7 @@ void CShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 						StringCchCopy(filenameCopy, SIZEOF_ARRAY(filenameCopy), filename.c_str());
 
 						lvItem.mask			= LVIF_TEXT|LVIF_IMAGE|LVIF_STATE;
-						lvItem.iItem		= iItem;
+						lvItem.iItem		= *iItem;
 						lvItem.iSubItem		= 0;
 						lvItem.iImage		= shfi.iIcon;
 						lvItem.pszText		= filenameCopy;
@@ -585,7 +877,7 @@ void CShellBrowser::RenameItem(int iItemInternal,const TCHAR *szNewFileName)
 						/* TODO: Does the file need to be filtered out? */
 						if(IsFileFiltered(itemInfo))
 						{
-							RemoveFilteredItem(iItem,iItemInternal);
+							RemoveFilteredItem(*iItem,iItemInternal);
 						}
 					}
 
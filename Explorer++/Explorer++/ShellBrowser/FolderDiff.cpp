@@ -0,0 +1,71 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "FolderDiff.h"
+#include <boost/algorithm/string.hpp>
+#include <unordered_map>
+
+std::vector<ChangeJournal::Change> DiffFolderItems(const std::vector<FolderDiffItem> &currentItems,
+	const std::vector<FolderDiffItem> &folderItems)
+{
+	// Maps the lowercased name of each item in the folder to its index.
+	std::unordered_map<std::wstring, std::size_t> folderItemMap;
+	folderItemMap.reserve(folderItems.size());
+
+	for (std::size_t i = 0; i < folderItems.size(); i++)
+	{
+		folderItemMap.insert({ boost::to_lower_copy(folderItems[i].name), i });
+	}
+
+	std::vector<bool> folderItemsMatched(folderItems.size(), false);
+
+	std::vector<ChangeJournal::Change> removedItems;
+	std::vector<ChangeJournal::Change> renamedItems;
+	std::vector<ChangeJournal::Change> addedItems;
+	std::vector<ChangeJournal::Change> modifiedItems;
+
+	for (const auto &currentItem : currentItems)
+	{
+		auto itr = folderItemMap.find(boost::to_lower_copy(currentItem.name));
+
+		if (itr == folderItemMap.end())
+		{
+			removedItems.push_back({ ChangeJournal::ChangeType::Removed, currentItem.name, {} });
+			continue;
+		}
+
+		const FolderDiffItem &folderItem = folderItems[itr->second];
+		folderItemsMatched[itr->second] = true;
+
+		if (currentItem.name != folderItem.name)
+		{
+			renamedItems.push_back({ ChangeJournal::ChangeType::Renamed, folderItem.name, currentItem.name });
+		}
+
+		if (currentItem.attributes != folderItem.attributes
+			|| currentItem.size != folderItem.size
+			|| currentItem.lastWriteTime != folderItem.lastWriteTime)
+		{
+			modifiedItems.push_back({ ChangeJournal::ChangeType::Modified, folderItem.name, {} });
+		}
+	}
+
+	for (std::size_t i = 0; i < folderItems.size(); i++)
+	{
+		if (!folderItemsMatched[i])
+		{
+			addedItems.push_back({ ChangeJournal::ChangeType::Added, folderItems[i].name, {} });
+		}
+	}
+
+	std::vector<ChangeJournal::Change> changes;
+	changes.reserve(removedItems.size() + renamedItems.size() + addedItems.size() + modifiedItems.size());
+	changes.insert(changes.end(), removedItems.begin(), removedItems.end());
+	changes.insert(changes.end(), renamedItems.begin(), renamedItems.end());
+	changes.insert(changes.end(), addedItems.begin(), addedItems.end());
+	changes.insert(changes.end(), modifiedItems.begin(), modifiedItems.end());
+
+	return changes;
+}
@@ -0,0 +1,29 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "ChangeJournal.h"
+#include <string>
+#include <vector>
+
+// The details of an item that are compared when resynchronizing a folder.
+struct FolderDiffItem
+{
+	std::wstring name;
+	DWORD attributes;
+	ULONGLONG size;
+	ULONGLONG lastWriteTime;
+};
+
+// Used when the change notifications for a folder have been lost (e.g.
+// because too many changes were made at once). Compares the items that
+// are currently shown with the items that are actually in the folder and
+// returns the changes needed to bring the former up to date, in the same
+// order that ChangeJournal uses.
+//
+// Names are compared without regard to case. An item whose name now only
+// differs in case is reported as being renamed.
+std::vector<ChangeJournal::Change> DiffFolderItems(const std::vector<FolderDiffItem> &currentItems,
+	const std::vector<FolderDiffItem> &folderItems);
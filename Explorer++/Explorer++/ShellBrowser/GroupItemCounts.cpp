@@ -0,0 +1,62 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "GroupItemCounts.h"
+#include <algorithm>
+#include <cassert>
+
+void GroupItemCounts::AddItem(int groupId)
+{
+	m_numItems[groupId]++;
+	m_changedGroups.insert(groupId);
+}
+
+void GroupItemCounts::RemoveItem(int groupId)
+{
+	auto itr = m_numItems.find(groupId);
+	assert(itr != m_numItems.end() && itr->second > 0);
+
+	if (itr == m_numItems.end() || itr->second == 0)
+	{
+		return;
+	}
+
+	itr->second--;
+	m_changedGroups.insert(groupId);
+}
+
+void GroupItemCounts::RemoveGroup(int groupId)
+{
+	m_numItems.erase(groupId);
+	m_changedGroups.erase(groupId);
+}
+
+void GroupItemCounts::Clear()
+{
+	m_numItems.clear();
+	m_changedGroups.clear();
+}
+
+int GroupItemCounts::GetNumItems(int groupId) const
+{
+	auto itr = m_numItems.find(groupId);
+
+	if (itr == m_numItems.end())
+	{
+		return 0;
+	}
+
+	return itr->second;
+}
+
+std::vector<int> GroupItemCounts::TakeChangedGroups()
+{
+	std::vector<int> changedGroups(m_changedGroups.begin(), m_changedGroups.end());
+	std::sort(changedGroups.begin(), changedGroups.end());
+
+	m_changedGroups.clear();
+
+	return changedGroups;
+}
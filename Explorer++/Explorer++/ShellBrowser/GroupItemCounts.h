@@ -0,0 +1,38 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Tracks the number of items in each listview group. Since each group's
+// header shows its item count, the groups whose counts have changed are
+// also recorded. That way, the headers only need to be updated once for
+// an entire batch of items, rather than once per item.
+class GroupItemCounts
+{
+public:
+
+	void AddItem(int groupId);
+	void RemoveItem(int groupId);
+
+	// Removes the group entirely, so that it won't be returned by
+	// TakeChangedGroups().
+	void RemoveGroup(int groupId);
+
+	void Clear();
+
+	int GetNumItems(int groupId) const;
+
+	// Returns the groups (in ascending order of id) whose counts have
+	// changed since this was last called.
+	std::vector<int> TakeChangedGroups();
+
+private:
+
+	std::unordered_map<int, int> m_numItems;
+	std::unordered_set<int> m_changedGroups;
+};
@@ -45,6 +45,7 @@ void CShellBrowser::SetShowInGroups(BOOL bShowInGroups)
 
 	if(!m_folderSettings.showInGroups)
 	{
+		ClearGroupResults();
 		ListView_EnableGroupView(m_hListView,FALSE);
 		SortFolder(m_folderSettings.sortMode);
 		return;
@@ -58,6 +59,12 @@ void CShellBrowser::SetShowInGroups(BOOL bShowInGroups)
 INT CALLBACK CShellBrowser::GroupNameComparisonStub(INT Group1_ID, INT Group2_ID, void *pvData)
 {
 	CShellBrowser *shellBrowser = reinterpret_cast<CShellBrowser *>(pvData);
+
+	if (auto result = shellBrowser->ComparePendingGroup(Group1_ID, Group2_ID))
+	{
+		return *result;
+	}
+
 	return shellBrowser->GroupNameComparison(Group1_ID, Group2_ID);
 }
 
@@ -96,6 +103,12 @@ INT CALLBACK CShellBrowser::GroupNameComparison(INT Group1_ID, INT Group2_ID)
 INT CALLBACK CShellBrowser::GroupFreeSpaceComparisonStub(INT Group1_ID, INT Group2_ID, void *pvData)
 {
 	CShellBrowser *shellBrowser = reinterpret_cast<CShellBrowser *>(pvData);
+
+	if (auto result = shellBrowser->ComparePendingGroup(Group1_ID, Group2_ID))
+	{
+		return *result;
+	}
+
 	return shellBrowser->GroupFreeSpaceComparison(Group1_ID, Group2_ID);
 }
 
@@ -131,13 +144,25 @@ INT CALLBACK CShellBrowser::GroupFreeSpaceComparison(INT Group1_ID, INT Group2_I
 	return iReturnValue;
 }
 
-std::wstring CShellBrowser::RetrieveGroupHeader(int groupId)
+/* The pending group is always placed after every other
+group, regardless of the sort direction. Returns nothing if
+neither group is the pending group. */
+boost::optional<int> CShellBrowser::ComparePendingGroup(int group1Id, int group2Id) const
 {
-	auto itr = std::find_if(m_GroupList.begin(), m_GroupList.end(), [groupId] (const TypeGroup_t &group) {
-		return group.iGroupId == groupId;
-	});
+	bool isPending1 = (m_pendingGroupId == group1Id);
+	bool isPending2 = (m_pendingGroupId == group2Id);
+
+	if (!isPending1 && !isPending2)
+	{
+		return boost::none;
+	}
 
-	return itr->header;
+	return static_cast<int>(isPending1) - static_cast<int>(isPending2);
+}
+
+std::wstring CShellBrowser::RetrieveGroupHeader(int groupId)
+{
+	return m_groups.at(groupId).header;
 }
 
 /*
@@ -147,88 +172,70 @@ std::wstring CShellBrowser::RetrieveGroupHeader(int groupId)
 int CShellBrowser::DetermineItemGroup(int iItemInternal)
 {
 	BasicItemInfo_t basicItemInfo = getBasicItemInfo(iItemInternal);
-	PFNLVGROUPCOMPARE groupComparison = nullptr;
-	std::wstring groupHeader;
+	std::wstring groupHeader = DetermineItemGroupHeader(basicItemInfo, m_folderSettings.sortMode,
+		m_config->globalFolderSettings);
 
-	switch(m_folderSettings.sortMode)
+	return CheckGroup(groupHeader, GetGroupComparison(m_folderSettings.sortMode));
+}
+
+/*
+ * Determines the header of the group the specified
+ * item belongs to. As this may be called from a
+ * background thread, it only relies on the item
+ * information and settings that are passed in.
+ */
+std::wstring CShellBrowser::DetermineItemGroupHeader(const BasicItemInfo_t &basicItemInfo,
+	SortMode sortMode, const GlobalFolderSettings &globalFolderSettings) const
+{
+	switch(sortMode)
 	{
 		case SortMode::Name:
-			groupHeader = DetermineItemNameGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemNameGroup(basicItemInfo);
 
 		case SortMode::Type:
-			groupHeader = DetermineItemTypeGroupVirtual(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemTypeGroupVirtual(basicItemInfo);
 
 		case SortMode::Size:
-			groupHeader = DetermineItemSizeGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemSizeGroup(basicItemInfo);
 
 		case SortMode::DateModified:
-			groupHeader = DetermineItemDateGroup(basicItemInfo, GroupByDateType::Modified);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemDateGroup(basicItemInfo, GroupByDateType::Modified);
 
 		case SortMode::TotalSize:
-			groupHeader = DetermineItemTotalSizeGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemTotalSizeGroup(basicItemInfo);
 
 		case SortMode::FreeSpace:
-			groupHeader = DetermineItemFreeSpaceGroup(basicItemInfo);
-			groupComparison = GroupFreeSpaceComparisonStub;
-			break;
+			return DetermineItemFreeSpaceGroup(basicItemInfo);
 
 		case SortMode::DateDeleted:
 			break;
 
 		case SortMode::OriginalLocation:
-			groupHeader = DetermineItemSummaryGroup(basicItemInfo, &SCID_ORIGINAL_LOCATION, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemSummaryGroup(basicItemInfo, &SCID_ORIGINAL_LOCATION, globalFolderSettings);
 
 		case SortMode::Attributes:
-			groupHeader = DetermineItemAttributeGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemAttributeGroup(basicItemInfo);
 
 		case SortMode::ShortName:
-			groupHeader = DetermineItemNameGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemNameGroup(basicItemInfo);
 
 		case SortMode::Owner:
-			groupHeader = DetermineItemOwnerGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_OWNER, L"", globalFolderSettings);
 
 		case SortMode::ProductName:
-			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("ProductName"));
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_PRODUCTNAME, L"Unspecified", globalFolderSettings);
 
 		case SortMode::Company:
-			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("CompanyName"));
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_COMPANY, L"Unspecified", globalFolderSettings);
 
 		case SortMode::Description:
-			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("FileDescription"));
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_DESCRIPTION, L"Unspecified", globalFolderSettings);
 
 		case SortMode::FileVersion:
-			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("FileVersion"));
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_FILEVERSION, L"Unspecified", globalFolderSettings);
 
 		case SortMode::ProductVersion:
-			groupHeader = DetermineItemVersionGroup(basicItemInfo,_T("ProductVersion"));
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_PRODUCTVERSION, L"Unspecified", globalFolderSettings);
 
 		case SortMode::ShortcutTo:
 			break;
@@ -237,74 +244,48 @@ int CShellBrowser::DetermineItemGroup(int iItemInternal)
 			break;
 
 		case SortMode::Extension:
-			groupHeader = DetermineItemExtensionGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemExtensionGroup(basicItemInfo);
 
 		case SortMode::Created:
-			groupHeader = DetermineItemDateGroup(basicItemInfo, GroupByDateType::Created);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemDateGroup(basicItemInfo, GroupByDateType::Created);
 
 		case SortMode::Accessed:
-			groupHeader = DetermineItemDateGroup(basicItemInfo, GroupByDateType::Accessed);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemDateGroup(basicItemInfo, GroupByDateType::Accessed);
 
 		case SortMode::Title:
-			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Title, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemSummaryGroup(basicItemInfo,&PKEY_Title, globalFolderSettings);
 
 		case SortMode::Subject:
-			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Subject, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemSummaryGroup(basicItemInfo,&PKEY_Subject, globalFolderSettings);
 
 		case SortMode::Authors:
-			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Author, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemSummaryGroup(basicItemInfo,&PKEY_Author, globalFolderSettings);
 
 		case SortMode::Keywords:
-			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Keywords, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemSummaryGroup(basicItemInfo,&PKEY_Keywords, globalFolderSettings);
 
 		case SortMode::Comments:
-			groupHeader = DetermineItemSummaryGroup(basicItemInfo,&PKEY_Comment, m_config->globalFolderSettings);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemSummaryGroup(basicItemInfo,&PKEY_Comment, globalFolderSettings);
 
 
 		case SortMode::CameraModel:
-			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagEquipModel);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_CAMERAMODEL, L"Other", globalFolderSettings);
 
 		case SortMode::DateTaken:
-			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagDateTime);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_DATETAKEN, L"Other", globalFolderSettings);
 
 		case SortMode::Width:
-			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagImageWidth);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_WIDTH, L"Other", globalFolderSettings);
 
 		case SortMode::Height:
-			groupHeader = DetermineItemCameraPropertyGroup(basicItemInfo,PropertyTagImageHeight);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemColumnGroup(basicItemInfo, CM_HEIGHT, L"Other", globalFolderSettings);
 
 
 		case SortMode::VirtualComments:
 			break;
 
 		case SortMode::FileSystem:
-			groupHeader = DetermineItemFileSystemGroup(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemFileSystemGroup(basicItemInfo);
 
 		case SortMode::NumPrinterDocuments:
 			break;
@@ -319,16 +300,54 @@ int CShellBrowser::DetermineItemGroup(int iItemInternal)
 			break;
 
 		case SortMode::NetworkAdapterStatus:
-			groupHeader = DetermineItemNetworkStatus(basicItemInfo);
-			groupComparison = GroupNameComparisonStub;
-			break;
+			return DetermineItemNetworkStatus(basicItemInfo);
 
 		default:
 			assert(false);
 			break;
 	}
 
-	return CheckGroup(groupHeader, groupComparison);
+	return std::wstring();
+}
+
+PFNLVGROUPCOMPARE CShellBrowser::GetGroupComparison(SortMode sortMode)
+{
+	if (sortMode == +SortMode::FreeSpace)
+	{
+		return GroupFreeSpaceComparisonStub;
+	}
+
+	return GroupNameComparisonStub;
+}
+
+/* Returns true for the sort modes where determining
+an item's group requires the shell to be queried, or
+the item itself to be opened. The groups for all
+other sort modes are based only on the information
+that's already held for each item. */
+bool CShellBrowser::IsGroupHeaderExpensive(SortMode sortMode)
+{
+	switch (sortMode)
+	{
+	case SortMode::Name:
+	case SortMode::Size:
+	case SortMode::DateModified:
+	case SortMode::DateDeleted:
+	case SortMode::ShortName:
+	case SortMode::ShortcutTo:
+	case SortMode::HardLinks:
+	case SortMode::Extension:
+	case SortMode::Created:
+	case SortMode::Accessed:
+	case SortMode::VirtualComments:
+	case SortMode::NumPrinterDocuments:
+	case SortMode::PrinterStatus:
+	case SortMode::PrinterComments:
+	case SortMode::PrinterLocation:
+		return false;
+	}
+
+	return true;
 }
 
 /*
@@ -336,47 +355,38 @@ int CShellBrowser::DetermineItemGroup(int iItemInternal)
  * in the listview. If not, the group is inserted
  * into its sorted position with the specified
  * header text.
+ *
+ * The item count shown in the group's header isn't
+ * updated here. Instead, UpdateGroupHeaders() should
+ * be called once the current set of items has been
+ * placed into groups.
  */
 int CShellBrowser::CheckGroup(std::wstring_view groupHeader, PFNLVGROUPCOMPARE groupComparison)
 {
-	auto itr = std::find_if(m_GroupList.begin(), m_GroupList.end(), [groupHeader] (const TypeGroup_t &group) {
-		return group.header == groupHeader;
-	});
+	std::wstring header(groupHeader);
+	auto itr = m_groupIdsByHeader.find(header);
 
-	auto generateListViewHeader = [] (std::wstring_view header, int numItems) {
-		return std::wstring(header) + L" (" + std::to_wstring(numItems) + L")";
-	};
-
-	if (itr != m_GroupList.end())
+	if (itr != m_groupIdsByHeader.end())
 	{
-		itr->nItems++;
-
-		std::wstring listViewHeader = generateListViewHeader(groupHeader, itr->nItems);
-
-		LVGROUP lvGroup;
-		lvGroup.cbSize = sizeof(LVGROUP);
-		lvGroup.mask = LVGF_HEADER;
-		lvGroup.pszHeader = listViewHeader.data();
-		ListView_SetGroupInfo(m_hListView, itr->iGroupId, &lvGroup);
+		m_groupItemCounts.AddItem(itr->second);
 
-		return itr->iGroupId;
+		return itr->second;
 	}
 
 	int groupId = m_iGroupId++;
 
 	TypeGroup_t typeGroup;
-	typeGroup.header = groupHeader;
+	typeGroup.header = header;
 	typeGroup.iGroupId = groupId;
-	typeGroup.nItems = 1;
-	m_GroupList.push_back(typeGroup);
-
-	std::wstring listViewHeader = generateListViewHeader(groupHeader, typeGroup.nItems);
+	m_groups.insert({ groupId, typeGroup });
+	m_groupIdsByHeader.insert({ header, groupId });
+	m_groupItemCounts.AddItem(groupId);
 
 	LVINSERTGROUPSORTED lvigs;
 	lvigs.lvGroup.cbSize	= sizeof(LVGROUP);
 	lvigs.lvGroup.mask		= LVGF_HEADER | LVGF_GROUPID | LVGF_STATE;
 	lvigs.lvGroup.state		= LVGS_COLLAPSIBLE;
-	lvigs.lvGroup.pszHeader	= listViewHeader.data();
+	lvigs.lvGroup.pszHeader	= header.data();
 	lvigs.lvGroup.iGroupId	= groupId;
 	lvigs.lvGroup.stateMask	= 0;
 	lvigs.pfnGroupCompare	= groupComparison;
@@ -386,6 +396,91 @@ int CShellBrowser::CheckGroup(std::wstring_view groupHeader, PFNLVGROUPCOMPARE g
 	return groupId;
 }
 
+/*
+ * Returns the id of the group that holds items whose
+ * groups are being determined in the background,
+ * inserting the group if necessary. Like CheckGroup(),
+ * this counts an item as having been added to the group.
+ *
+ * The pending group isn't indexed by its header, so
+ * that it stays separate from any real group that
+ * happens to have the same header.
+ */
+int CShellBrowser::CheckPendingGroup(void)
+{
+	if (m_pendingGroupId)
+	{
+		m_groupItemCounts.AddItem(*m_pendingGroupId);
+
+		return *m_pendingGroupId;
+	}
+
+	int groupId = m_iGroupId++;
+
+	TypeGroup_t typeGroup;
+	typeGroup.header = ResourceHelper::LoadString(m_hResourceModule, IDS_GROUPBY_PENDING);
+	typeGroup.iGroupId = groupId;
+	m_groups.insert({ groupId, typeGroup });
+	m_groupItemCounts.AddItem(groupId);
+	m_pendingGroupId = groupId;
+
+	LVGROUP lvGroup;
+	lvGroup.cbSize		= sizeof(LVGROUP);
+	lvGroup.mask		= LVGF_HEADER | LVGF_GROUPID | LVGF_STATE;
+	lvGroup.state		= LVGS_COLLAPSIBLE;
+	lvGroup.pszHeader	= typeGroup.header.data();
+	lvGroup.iGroupId	= groupId;
+	lvGroup.stateMask	= 0;
+	ListView_InsertGroup(m_hListView,-1,&lvGroup);
+
+	return groupId;
+}
+
+/* Called once the specified number of items have been
+moved out of the pending group (or removed). The group is
+removed once it's empty. */
+void CShellBrowser::RemovePendingItems(int numItems)
+{
+	if (!m_pendingGroupId)
+	{
+		return;
+	}
+
+	for (int i = 0; i < numItems; i++)
+	{
+		m_groupItemCounts.RemoveItem(*m_pendingGroupId);
+	}
+
+	if (m_groupItemCounts.GetNumItems(*m_pendingGroupId) > 0)
+	{
+		return;
+	}
+
+	ListView_RemoveGroup(m_hListView, *m_pendingGroupId);
+	m_groupItemCounts.RemoveGroup(*m_pendingGroupId);
+	m_groups.erase(*m_pendingGroupId);
+	m_pendingGroupId.reset();
+}
+
+/* Sets the header text (including the item count) of
+each group that's changed since this was last called. */
+void CShellBrowser::UpdateGroupHeaders(void)
+{
+	for (int groupId : m_groupItemCounts.TakeChangedGroups())
+	{
+		const TypeGroup_t &group = m_groups.at(groupId);
+
+		std::wstring listViewHeader = group.header + L" ("
+			+ std::to_wstring(m_groupItemCounts.GetNumItems(groupId)) + L")";
+
+		LVGROUP lvGroup;
+		lvGroup.cbSize = sizeof(LVGROUP);
+		lvGroup.mask = LVGF_HEADER;
+		lvGroup.pszHeader = listViewHeader.data();
+		ListView_SetGroupInfo(m_hListView, groupId, &lvGroup);
+	}
+}
+
 /*
  * Determines the id of the group to which the specified
  * item belongs, based on the item's name.
@@ -694,51 +789,23 @@ std::wstring CShellBrowser::DetermineItemAttributeGroup(const BasicItemInfo_t &i
 	return szAttributes;
 }
 
-std::wstring CShellBrowser::DetermineItemOwnerGroup(const BasicItemInfo_t &itemInfo) const
-{
-	std::wstring fullFileName = itemInfo.getFullPath();
-
-	TCHAR szOwner[512];
-	BOOL ret = GetFileOwner(fullFileName.c_str(), szOwner, std::size(szOwner));
-
-	if(ret)
-	{
-		return szOwner;
-	}
-
-	return std::wstring();
-}
-
-std::wstring CShellBrowser::DetermineItemVersionGroup(const BasicItemInfo_t &itemInfo, const TCHAR *szVersionType) const
-{
-	std::wstring fullFileName = itemInfo.getFullPath();
-
-	TCHAR szVersion[512];
-	BOOL bVersionInfoObtained = GetVersionInfoString(fullFileName.c_str(),
-		szVersionType, szVersion, static_cast<UINT>(std::size(szVersion)));
-
-	if (bVersionInfoObtained)
-	{
-		return szVersion;
-	}
-
-	return L"Unspecified";
-}
-
-std::wstring CShellBrowser::DetermineItemCameraPropertyGroup(const BasicItemInfo_t &itemInfo, PROPID PropertyId) const
+/* Used for the groups whose header is the same as the
+text of one of the item's columns. The text is retrieved
+through the column cache, so that the value is only
+calculated once, whether it's needed first by the column
+or by the group. */
+std::wstring CShellBrowser::DetermineItemColumnGroup(const BasicItemInfo_t &itemInfo, unsigned int columnId,
+	const std::wstring &defaultHeader, const GlobalFolderSettings &globalFolderSettings) const
 {
-	std::wstring fullFileName = itemInfo.getFullPath();
-
-	TCHAR szProperty[512];
-	BOOL bRes = ReadImageProperty(fullFileName.c_str(), PropertyId, szProperty,
-		static_cast<int>(std::size(szProperty)));
+	ItemColumnContext context(itemInfo, m_columnCache, m_folderSizeCalculator);
+	std::wstring columnText = GetColumnText(columnId, context, globalFolderSettings);
 
-	if (bRes)
+	if (columnText.empty())
 	{
-		return szProperty;
+		return defaultHeader;
 	}
 
-	return L"Other";
+	return columnText;
 }
 
 std::wstring CShellBrowser::DetermineItemExtensionGroup(const BasicItemInfo_t &itemInfo) const
@@ -874,6 +941,8 @@ void CShellBrowser::MoveItemsIntoGroups(void)
 	int iGroupId;
 	int i = 0;
 
+	ClearGroupResults();
+
 	ListView_RemoveAllGroups(m_hListView);
 	ListView_EnableGroupView(m_hListView,TRUE);
 
@@ -881,9 +950,15 @@ void CShellBrowser::MoveItemsIntoGroups(void)
 
 	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)FALSE,(LPARAM)NULL);
 
-	m_GroupList.clear();
+	m_groups.clear();
+	m_groupIdsByHeader.clear();
+	m_groupItemCounts.Clear();
+	m_pendingGroupId.reset();
 	m_iGroupId = 0;
 
+	bool determineInBackground = IsGroupHeaderExpensive(m_folderSettings.sortMode);
+	std::vector<std::pair<int, int>> backgroundItems;
+
 	for(i = 0;i < nItems ;i++)
 	{
 		Item.mask		= LVIF_PARAM;
@@ -891,10 +966,156 @@ void CShellBrowser::MoveItemsIntoGroups(void)
 		Item.iSubItem	= 0;
 		ListView_GetItem(m_hListView,&Item);
 
+		/* Items whose groups are determined in the
+		background are held in the pending group
+		until they've been placed into their real
+		groups. */
+		if(determineInBackground)
+		{
+			InsertItemIntoGroup(i,CheckPendingGroup());
+			backgroundItems.emplace_back(i,(int)Item.lParam);
+			continue;
+		}
+
 		iGroupId = DetermineItemGroup((int)Item.lParam);
 
 		InsertItemIntoGroup(i,iGroupId);
 	}
 
+	UpdateGroupHeaders();
+
 	SendMessage(m_hListView,WM_SETREDRAW,(WPARAM)TRUE,(LPARAM)NULL);
-}
\ No newline at end of file
+
+	QueueGroupTasks(backgroundItems);
+}
+
+/* Determines the groups for the specified items (given
+as pairs of item index and internal index) in the
+background. The items are split into batches, with each
+batch being placed into its groups as soon as it's
+ready. */
+void CShellBrowser::QueueGroupTasks(const std::vector<std::pair<int, int>> &items)
+{
+	if (items.empty())
+	{
+		return;
+	}
+
+	SortMode sortMode = m_folderSettings.sortMode;
+	auto globalFolderSettings = std::make_shared<const GlobalFolderSettings>(m_config->globalFolderSettings);
+
+	for (std::size_t batchStart = 0; batchStart < items.size(); batchStart += GROUP_BATCH_SIZE)
+	{
+		std::size_t batchEnd = (std::min)(batchStart + GROUP_BATCH_SIZE, items.size());
+
+		std::vector<GroupHeaderRequest_t> requests;
+		requests.reserve(batchEnd - batchStart);
+
+		for (std::size_t i = batchStart; i < batchEnd; i++)
+		{
+			requests.push_back({ items[i].second, items[i].first, getBasicItemInfo(items[i].second) });
+		}
+
+		int groupResultID = m_groupResultIDCounter++;
+
+		// The first batch contains the items at the top of the
+		// folder, which is the part the user will see first.
+		auto priority = (batchStart == 0) ? TaskScheduler::TaskPriority::Visible : TaskScheduler::TaskPriority::Normal;
+
+		auto result = m_groupTaskQueue->Push(priority,
+			[this, groupResultID, requests = std::move(requests), sortMode, globalFolderSettings] {
+			return DetermineGroupHeadersAsync(groupResultID, requests, sortMode, globalFolderSettings);
+		});
+
+		m_groupResults.insert({ groupResultID, std::move(result) });
+	}
+}
+
+std::vector<CShellBrowser::GroupHeaderResult_t> CShellBrowser::DetermineGroupHeadersAsync(int groupResultId,
+	const std::vector<GroupHeaderRequest_t> &requests, SortMode sortMode,
+	std::shared_ptr<const GlobalFolderSettings> globalFolderSettings) const
+{
+	std::vector<GroupHeaderResult_t> results;
+	results.reserve(requests.size());
+
+	for (const auto &request : requests)
+	{
+		results.push_back({ request.itemInternalIndex, request.itemIndex,
+			DetermineItemGroupHeader(request.itemInfo, sortMode, *globalFolderSettings) });
+	}
+
+	// As with column results, the message handler will wait for
+	// the result to be returned, if necessary.
+	PostMessage(m_hListView, WM_APP_GROUP_RESULT_READY, groupResultId, 0);
+
+	return results;
+}
+
+void CShellBrowser::ProcessGroupResult(int groupResultId)
+{
+	auto itr = m_groupResults.find(groupResultId);
+
+	if (itr == m_groupResults.end())
+	{
+		// The items have been regrouped (or the folder has
+		// changed) since this result was requested.
+		return;
+	}
+
+	auto results = itr->second.get();
+	m_groupResults.erase(itr);
+
+	if (!m_folderSettings.showInGroups)
+	{
+		return;
+	}
+
+	PFNLVGROUPCOMPARE groupComparison = GetGroupComparison(m_folderSettings.sortMode);
+
+	SendMessage(m_hListView, WM_SETREDRAW, FALSE, NULL);
+
+	for (const auto &result : results)
+	{
+		boost::optional<int> index;
+
+		// Unless items have been added or removed, each item will
+		// still be in the position it was in when it was queued.
+		LVITEM lvItem;
+		lvItem.mask = LVIF_PARAM;
+		lvItem.iItem = result.itemIndex;
+		lvItem.iSubItem = 0;
+		BOOL res = ListView_GetItem(m_hListView, &lvItem);
+
+		if (res && static_cast<int>(lvItem.lParam) == result.itemInternalIndex)
+		{
+			index = result.itemIndex;
+		}
+		else
+		{
+			index = LocateItemByInternalIndex(result.itemInternalIndex);
+		}
+
+		if (!index)
+		{
+			// The item has been removed.
+			continue;
+		}
+
+		int groupId = CheckGroup(result.header, groupComparison);
+		InsertItemIntoGroup(*index, groupId);
+	}
+
+	// Every item in the result has now left the pending group,
+	// including any that have since been removed.
+	RemovePendingItems(static_cast<int>(results.size()));
+
+	UpdateGroupHeaders();
+
+	SendMessage(m_hListView, WM_SETREDRAW, TRUE, NULL);
+}
+
+void CShellBrowser::ClearGroupResults(void)
+{
+	m_groupTaskQueue->Cancel();
+	m_groupResults.clear();
+}
@@ -18,6 +18,56 @@
 #define THUMBNAIL_TYPE_ICON			0
 #define THUMBNAIL_TYPE_EXTRACTED	1
 
+namespace
+{
+	struct ThumbnailCacheKey
+	{
+		std::wstring path;
+		ULONGLONG fileSize;
+		ULONGLONG lastWriteTime;
+	};
+
+	/* As with column values, virtual items don't have a last
+	write time, so there's no way of telling whether a cached
+	thumbnail is still valid. Thumbnails for those items aren't
+	cached. */
+	boost::optional<ThumbnailCacheKey> GetThumbnailCacheKey(PCIDLIST_ABSOLUTE pidl, const WIN32_FIND_DATA &wfd)
+	{
+		ULARGE_INTEGER lastWriteTime = { wfd.ftLastWriteTime.dwLowDateTime, wfd.ftLastWriteTime.dwHighDateTime };
+
+		if (lastWriteTime.QuadPart == 0)
+		{
+			return boost::none;
+		}
+
+		TCHAR fullPath[MAX_PATH];
+		HRESULT hr = GetDisplayName(pidl, fullPath, SIZEOF_ARRAY(fullPath), SHGDN_FORPARSING);
+
+		if (FAILED(hr))
+		{
+			return boost::none;
+		}
+
+		ULARGE_INTEGER fileSize = { wfd.nFileSizeLow, wfd.nFileSizeHigh };
+
+		return ThumbnailCacheKey{ fullPath, fileSize.QuadPart, lastWriteTime.QuadPart };
+	}
+
+	/* Thumbnail pixels are always stored top-down. */
+	BITMAPINFO BuildThumbnailBitmapInfo(int width, int height)
+	{
+		BITMAPINFO bmi = {};
+		bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+		bmi.bmiHeader.biWidth = width;
+		bmi.bmiHeader.biHeight = -height;
+		bmi.bmiHeader.biPlanes = 1;
+		bmi.bmiHeader.biBitCount = 32;
+		bmi.bmiHeader.biCompression = BI_RGB;
+
+		return bmi;
+	}
+}
+
 void CShellBrowser::SetupThumbnailsView(void)
 {
 	HIMAGELIST himl;
@@ -46,6 +96,8 @@ void CShellBrowser::SetupThumbnailsView(void)
 	himl = ImageList_Create(THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT,ILC_COLOR32,nItems,nItems + 100);
 	ListView_SetImageList(m_hListView,himl,LVSIL_NORMAL);
 
+	m_iconThumbnailImages.clear();
+
 	for(i = 0;i < nItems;i++)
 	{
 		lvItem.mask		= LVIF_IMAGE;
@@ -73,8 +125,7 @@ void CShellBrowser::RemoveThumbnailsView(void)
 
 	nItems = ListView_GetItemCount(m_hListView);
 
-	m_thumbnailThreadPool.clear_queue();
-	m_thumbnailResults.clear();
+	ClearThumbnailResults();
 
 	for(i = 0;i < nItems;i++)
 	{
@@ -90,33 +141,101 @@ void CShellBrowser::RemoveThumbnailsView(void)
 
 	ImageList_Destroy(himl);
 
+	m_iconThumbnailImages.clear();
+
+	m_thumbnailBitmap.reset();
+	m_thumbnailDC.reset();
+
 	m_bThumbnailsSetup = FALSE;
 }
 
-void CShellBrowser::QueueThumbnailTask(int internalIndex)
+/* If the item's thumbnail is in the cache (e.g. because it
+was extracted when the folder was previously visited, or
+because the folder is open in another tab), it can be shown
+straight away. */
+int CShellBrowser::GetThumbnailImageIndex(int internalIndex, int itemIndex)
+{
+	const ItemInfo_t &itemInfo = m_itemInfoMap.at(internalIndex);
+	auto cacheKey = GetThumbnailCacheKey(itemInfo.pidlComplete.get(), itemInfo.wfd);
+
+	if (cacheKey)
+	{
+		auto thumbnail = m_thumbnailCache->Get(cacheKey->path, cacheKey->fileSize, cacheKey->lastWriteTime);
+
+		if (thumbnail)
+		{
+			return GetExtractedThumbnail(*thumbnail);
+		}
+	}
+
+	int iconImageIndex = GetIconThumbnail(internalIndex);
+
+	QueueThumbnailTask(internalIndex, itemIndex);
+
+	return iconImageIndex;
+}
+
+void CShellBrowser::QueueThumbnailTask(int internalIndex, int itemIndex)
 {
 	int thumbnailResultID = m_thumbnailResultIDCounter++;
 
 	BasicItemInfo_t basicItemInfo = getBasicItemInfo(internalIndex);
+	auto cancelled = std::make_shared<std::atomic<bool>>(false);
 
-	auto result = m_thumbnailThreadPool.push([this, thumbnailResultID, internalIndex, basicItemInfo](int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		return FindThumbnailAsync(m_hListView, thumbnailResultID, internalIndex, basicItemInfo);
+	auto result = m_thumbnailTaskQueue->Push(TaskScheduler::TaskPriority::Visible,
+		[this, thumbnailResultID, basicItemInfo, thumbnailCache = m_thumbnailCache, cancelled] {
+		return FindThumbnailAsync(m_hListView, thumbnailResultID, basicItemInfo, thumbnailCache, cancelled);
 	});
 
-	m_thumbnailResults.insert({ thumbnailResultID, std::move(result) });
+	ThumbnailResult_t thumbnailResult;
+	thumbnailResult.itemInternalIndex = internalIndex;
+	thumbnailResult.itemIndex = itemIndex;
+	thumbnailResult.cancelled = cancelled;
+	thumbnailResult.thumbnail = std::move(result);
+
+	m_thumbnailResults.insert({ thumbnailResultID, std::move(thumbnailResult) });
 }
 
-boost::optional<CShellBrowser::ThumbnailResult_t> CShellBrowser::FindThumbnailAsync(HWND listView,
-	int thumbnailResultId, int internalIndex, const BasicItemInfo_t &basicItemInfo)
+std::shared_ptr<const ThumbnailCache::Thumbnail> CShellBrowser::FindThumbnailAsync(HWND listView,
+	int thumbnailResultId, const BasicItemInfo_t &basicItemInfo, ThumbnailCache *thumbnailCache,
+	std::shared_ptr<std::atomic<bool>> cancelled)
+{
+	if (*cancelled)
+	{
+		return nullptr;
+	}
+
+	auto thumbnail = ExtractThumbnail(basicItemInfo);
+
+	if (thumbnail)
+	{
+		/* The thumbnail is cached even if the task has been
+		cancelled in the meantime, since it will be needed if
+		the item is scrolled back into view. */
+		auto cacheKey = GetThumbnailCacheKey(basicItemInfo.pidlComplete.get(), basicItemInfo.wfd);
+
+		if (cacheKey)
+		{
+			thumbnailCache->Set(cacheKey->path, cacheKey->fileSize, cacheKey->lastWriteTime, thumbnail);
+		}
+	}
+
+	if (!*cancelled)
+	{
+		PostMessage(listView, WM_APP_THUMBNAIL_RESULT_READY, thumbnailResultId, 0);
+	}
+
+	return thumbnail;
+}
+
+std::shared_ptr<const ThumbnailCache::Thumbnail> CShellBrowser::ExtractThumbnail(const BasicItemInfo_t &basicItemInfo)
 {
 	IShellFolder *pShellFolder = nullptr;
 	HRESULT hr = SHBindToParent(basicItemInfo.pidlComplete.get(), IID_PPV_ARGS(&pShellFolder), nullptr);
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
 	BOOST_SCOPE_EXIT(pShellFolder) {
@@ -129,7 +248,7 @@ boost::optional<CShellBrowser::ThumbnailResult_t> CShellBrowser::FindThumbnailAs
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
 	BOOST_SCOPE_EXIT(pExtractImage) {
@@ -150,7 +269,7 @@ boost::optional<CShellBrowser::ThumbnailResult_t> CShellBrowser::FindThumbnailAs
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
 	wil::unique_hbitmap thumbnailBitmap;
@@ -158,16 +277,48 @@ boost::optional<CShellBrowser::ThumbnailResult_t> CShellBrowser::FindThumbnailAs
 
 	if (FAILED(hr))
 	{
-		return boost::none;
+		return nullptr;
 	}
 
-	PostMessage(listView, WM_APP_THUMBNAIL_RESULT_READY, thumbnailResultId, 0);
+	return GetThumbnailPixels(thumbnailBitmap.get());
+}
+
+/* Copies the pixels out of the extracted bitmap, so that they
+can be cached and drawn without the bitmap itself having to be
+kept around. */
+std::shared_ptr<const ThumbnailCache::Thumbnail> CShellBrowser::GetThumbnailPixels(HBITMAP bitmap)
+{
+	BITMAP bm;
+
+	if (GetObject(bitmap, sizeof(bm), &bm) == 0)
+	{
+		return nullptr;
+	}
 
-	ThumbnailResult_t result;
-	result.itemInternalIndex = internalIndex;
-	result.bitmap = std::move(thumbnailBitmap);
+	int width = bm.bmWidth;
+	int height = std::abs(bm.bmHeight);
 
-	return result;
+	if (width <= 0 || height <= 0)
+	{
+		return nullptr;
+	}
+
+	auto thumbnail = std::make_shared<ThumbnailCache::Thumbnail>();
+	thumbnail->width = width;
+	thumbnail->height = height;
+	thumbnail->pixels.resize(static_cast<size_t>(width) * height);
+
+	BITMAPINFO bmi = BuildThumbnailBitmapInfo(width, height);
+
+	wil::unique_hdc hdc(CreateCompatibleDC(nullptr));
+	int res = GetDIBits(hdc.get(), bitmap, 0, height, thumbnail->pixels.data(), &bmi, DIB_RGB_COLORS);
+
+	if (res == 0)
+	{
+		return nullptr;
+	}
+
+	return thumbnail;
 }
 
 void CShellBrowser::ProcessThumbnailResult(int thumbnailResultId)
@@ -179,22 +330,23 @@ void CShellBrowser::ProcessThumbnailResult(int thumbnailResultId)
 		return;
 	}
 
+	auto thumbnail = itr->second.thumbnail.get();
+	int internalIndex = itr->second.itemInternalIndex;
+	int itemIndex = itr->second.itemIndex;
+	m_thumbnailResults.erase(itr);
+
 	if (m_folderSettings.viewMode != +ViewMode::Thumbnails)
 	{
 		return;
 	}
 
-	auto result = itr->second.get();
-
-	if (!result)
+	if (!thumbnail)
 	{
 		// Thumbnail lookup failed.
 		return;
 	}
 
-	int imageIndex = GetExtractedThumbnail(result->bitmap.get());
-
-	auto index = LocateItemByInternalIndex(result->itemInternalIndex);
+	auto index = LocateItemByInternalIndex(internalIndex, itemIndex);
 
 	if (!index)
 	{
@@ -205,82 +357,146 @@ void CShellBrowser::ProcessThumbnailResult(int thumbnailResultId)
 	lvItem.mask = LVIF_IMAGE;
 	lvItem.iItem = *index;
 	lvItem.iSubItem = 0;
-	lvItem.iImage = imageIndex;
+	lvItem.iImage = GetExtractedThumbnail(*thumbnail);
 	ListView_SetItem(m_hListView, &lvItem);
 }
 
-/* Draws a thumbnail based on an items icon. */
-int CShellBrowser::GetIconThumbnail(int iInternalIndex) const
+/* Thumbnails are requested as items are drawn. If an item is
+scrolled out of view before its thumbnail has been extracted,
+there's no need to extract it now. The item's image is reset,
+so that the thumbnail will be requested again if the item is
+scrolled back into view. */
+void CShellBrowser::DropOffscreenThumbnailTasks()
+{
+	RECT clientRect;
+	GetClientRect(m_hListView, &clientRect);
+
+	for (auto itr = m_thumbnailResults.begin(); itr != m_thumbnailResults.end();)
+	{
+		auto index = LocateItemByInternalIndex(itr->second.itemInternalIndex, itr->second.itemIndex);
+
+		if (index)
+		{
+			RECT itemRect;
+			RECT intersection;
+			BOOL res = ListView_GetItemRect(m_hListView, *index, &itemRect, LVIR_BOUNDS);
+
+			if (res && IntersectRect(&intersection, &clientRect, &itemRect))
+			{
+				itr->second.itemIndex = *index;
+				++itr;
+				continue;
+			}
+
+			LVITEM lvItem;
+			lvItem.mask = LVIF_IMAGE;
+			lvItem.iItem = *index;
+			lvItem.iSubItem = 0;
+			lvItem.iImage = I_IMAGECALLBACK;
+			ListView_SetItem(m_hListView, &lvItem);
+		}
+
+		*itr->second.cancelled = true;
+		itr = m_thumbnailResults.erase(itr);
+	}
+}
+
+void CShellBrowser::ClearThumbnailResults()
+{
+	m_thumbnailTaskQueue->Cancel();
+
+	/* Any tasks that are already running won't post their
+	results. */
+	for (auto &thumbnailResult : m_thumbnailResults)
+	{
+		*thumbnailResult.second.cancelled = true;
+	}
+
+	m_thumbnailResults.clear();
+}
+
+/* Draws a thumbnail based on an items icon. Items
+that share an icon share the same thumbnail image. */
+int CShellBrowser::GetIconThumbnail(int iInternalIndex)
 {
-	return GetThumbnailInternal(THUMBNAIL_TYPE_ICON,iInternalIndex,
-		NULL);
+	SHFILEINFO shfi;
+
+	SHGetFileInfo((LPCTSTR)m_itemInfoMap.at(iInternalIndex).pidlComplete.get(),0,&shfi,sizeof(shfi),SHGFI_PIDL|SHGFI_SYSICONINDEX);
+
+	auto itr = m_iconThumbnailImages.find(shfi.iIcon);
+
+	if(itr != m_iconThumbnailImages.end())
+	{
+		return itr->second;
+	}
+
+	int iImage = GetThumbnailInternal(THUMBNAIL_TYPE_ICON,shfi.iIcon,nullptr);
+
+	if(iImage != -1)
+	{
+		m_iconThumbnailImages.insert({shfi.iIcon,iImage});
+	}
+
+	return iImage;
 }
 
 /* Draws an items extracted thumbnail. */
-int CShellBrowser::GetExtractedThumbnail(HBITMAP hThumbnailBitmap) const
+int CShellBrowser::GetExtractedThumbnail(const ThumbnailCache::Thumbnail &thumbnail)
 {
 	return GetThumbnailInternal(THUMBNAIL_TYPE_EXTRACTED,0,
-		hThumbnailBitmap);
+		&thumbnail);
 }
 
 int CShellBrowser::GetThumbnailInternal(int iType,
-int iInternalIndex,HBITMAP hThumbnailBitmap) const
+int iIconIndex,const ThumbnailCache::Thumbnail *thumbnail)
 {
-	HDC hdc;
-	HDC hdcBacking;
-	HBITMAP hBackingBitmap;
 	HBITMAP hBackingBitmapOld;
 	HIMAGELIST himl;
-	HBRUSH hbr;
 	int iImage;
 
-	hdc = GetDC(m_hListView);
-	hdcBacking = CreateCompatibleDC(hdc);
+	/* The same surface is used to draw every
+	thumbnail, rather than a new DC and bitmap
+	being created each time. */
+	if(!m_thumbnailDC)
+	{
+		wil::unique_hdc_window hdc = wil::GetDC(m_hListView);
+		m_thumbnailDC.reset(CreateCompatibleDC(hdc.get()));
+		m_thumbnailBitmap.reset(CreateCompatibleBitmap(hdc.get(),THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT));
+	}
 
-	/* Backing bitmap. */
-	hBackingBitmap = CreateCompatibleBitmap(hdc,THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT);
-	hBackingBitmapOld = (HBITMAP)SelectObject(hdcBacking,hBackingBitmap);
+	hBackingBitmapOld = (HBITMAP)SelectObject(m_thumbnailDC.get(),m_thumbnailBitmap.get());
 
 	/* Set the background of the new bitmap to be the same color as the
 	background in the listview. */
-	hbr = CreateSolidBrush(ListView_GetBkColor(m_hListView));
+	wil::unique_hbrush hbr(CreateSolidBrush(ListView_GetBkColor(m_hListView)));
 	RECT rect = {0,0,THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT};
-	FillRect(hdcBacking,&rect,hbr);
+	FillRect(m_thumbnailDC.get(),&rect,hbr.get());
 
 	if(iType == THUMBNAIL_TYPE_ICON)
-		DrawIconThumbnailInternal(hdcBacking,iInternalIndex);
+		DrawIconThumbnailInternal(m_thumbnailDC.get(),iIconIndex);
 	else if(iType == THUMBNAIL_TYPE_EXTRACTED)
-		DrawThumbnailInternal(hdcBacking,hThumbnailBitmap);
+		DrawThumbnailInternal(m_thumbnailDC.get(),*thumbnail);
 
-	/* Clean up...
-	Everything EXCEPT the backing bitmap should be
-	deleted here (at the very least, the backing
-	bitmap needs to be selected out of its DC). */
-	SelectObject(hdcBacking,hBackingBitmapOld);
-	DeleteDC(hdcBacking);
-	ReleaseDC(m_hListView,hdc);
+	/* The backing bitmap needs to be selected out
+	of its DC before it's added to the imagelist. */
+	SelectObject(m_thumbnailDC.get(),hBackingBitmapOld);
 
-	/* Add the new bitmap to the imagelist. */
+	/* Add the new bitmap to the imagelist. The
+	imagelist takes a copy of the bitmap. */
 	himl = ListView_GetImageList(m_hListView,LVSIL_NORMAL);
-	iImage = ImageList_Add(himl,hBackingBitmap,NULL);
-
-	/* Now delete the backing bitmap. */
-	DeleteObject(hBackingBitmap);
+	iImage = ImageList_Add(himl,m_thumbnailBitmap.get(),NULL);
 
 	return iImage;
 }
 
-void CShellBrowser::DrawIconThumbnailInternal(HDC hdcBacking,int iInternalIndex) const
+void CShellBrowser::DrawIconThumbnailInternal(HDC hdcBacking,int iIconIndex) const
 {
 	HICON hIcon;
-	SHFILEINFO shfi;
 	int iIconWidth;
 	int iIconHeight;
 
-	SHGetFileInfo((LPCTSTR)m_itemInfoMap.at(iInternalIndex).pidlComplete.get(),0,&shfi,sizeof(shfi),SHGFI_PIDL|SHGFI_SYSICONINDEX);
-
 	hIcon = ImageList_GetIcon(m_hListViewImageList,
-		shfi.iIcon,ILD_NORMAL);
+		iIconIndex,ILD_NORMAL);
 
 	ImageList_GetIconSize(m_hListViewImageList,&iIconWidth,&iIconHeight);
 
@@ -290,25 +506,14 @@ void CShellBrowser::DrawIconThumbnailInternal(HDC hdcBacking,int iInternalIndex)
 	DestroyIcon(hIcon);
 }
 
-void CShellBrowser::DrawThumbnailInternal(HDC hdcBacking,HBITMAP hThumbnailBitmap) const
+void CShellBrowser::DrawThumbnailInternal(HDC hdcBacking,const ThumbnailCache::Thumbnail &thumbnail) const
 {
-	HDC hdcThumbnail;
-	HBITMAP hThumbnailBitmapOld;
-	BITMAP bm;
-
-	/* Thumbnail bitmap. */
-	hdcThumbnail = CreateCompatibleDC(hdcBacking);
-	hThumbnailBitmapOld = (HBITMAP)SelectObject(hdcThumbnail,hThumbnailBitmap);
-
-	GetObject(hThumbnailBitmap,sizeof(BITMAP),&bm);
-
-	/* Now, draw the thumbnail bitmap (in its centered position)
-	directly on top of the new bitmap. */
-	BitBlt(hdcBacking,(THUMBNAIL_ITEM_WIDTH - bm.bmWidth) / 2,
-		(THUMBNAIL_ITEM_HEIGHT - bm.bmHeight) / 2,
-		THUMBNAIL_ITEM_WIDTH,THUMBNAIL_ITEM_HEIGHT,
-		hdcThumbnail,0,0,SRCCOPY);
-
-	SelectObject(hdcThumbnail,hThumbnailBitmapOld);
-	DeleteDC(hdcThumbnail);
-}
\ No newline at end of file
+	BITMAPINFO bmi = BuildThumbnailBitmapInfo(thumbnail.width,thumbnail.height);
+
+	/* Draw the thumbnail (in its centered position)
+	directly on top of the backing bitmap. */
+	SetDIBitsToDevice(hdcBacking,(THUMBNAIL_ITEM_WIDTH - thumbnail.width) / 2,
+		(THUMBNAIL_ITEM_HEIGHT - thumbnail.height) / 2,
+		thumbnail.width,thumbnail.height,0,0,0,thumbnail.height,
+		thumbnail.pixels.data(),&bmi,DIB_RGB_COLORS);
+}
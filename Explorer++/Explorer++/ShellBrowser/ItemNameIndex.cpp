@@ -0,0 +1,92 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ItemNameIndex.h"
+
+void ItemNameIndex::AddItem(int internalIndex, const std::wstring &name, const std::wstring &shortName)
+{
+	AddName(name, internalIndex);
+
+	if (shortName != name)
+	{
+		AddName(shortName, internalIndex);
+	}
+
+	m_itemNames[internalIndex] = { name, shortName };
+}
+
+void ItemNameIndex::RemoveItem(int internalIndex)
+{
+	auto itr = m_itemNames.find(internalIndex);
+
+	if (itr == m_itemNames.end())
+	{
+		return;
+	}
+
+	RemoveName(itr->second.name, internalIndex);
+	RemoveName(itr->second.shortName, internalIndex);
+
+	m_itemNames.erase(itr);
+}
+
+void ItemNameIndex::UpdateItem(int internalIndex, const std::wstring &name, const std::wstring &shortName)
+{
+	RemoveItem(internalIndex);
+	AddItem(internalIndex, name, shortName);
+}
+
+void ItemNameIndex::Clear()
+{
+	m_nameMap.clear();
+	m_itemNames.clear();
+}
+
+boost::optional<int> ItemNameIndex::FindItem(const std::wstring &name) const
+{
+	if (name.empty())
+	{
+		return boost::none;
+	}
+
+	auto itr = m_nameMap.find(name);
+
+	if (itr == m_nameMap.end())
+	{
+		return boost::none;
+	}
+
+	return itr->second;
+}
+
+std::size_t ItemNameIndex::GetNumItems() const
+{
+	return m_itemNames.size();
+}
+
+void ItemNameIndex::AddName(const std::wstring &name, int internalIndex)
+{
+	// Most items won't have a short name.
+	if (name.empty())
+	{
+		return;
+	}
+
+	m_nameMap.emplace(name, internalIndex);
+}
+
+void ItemNameIndex::RemoveName(const std::wstring &name, int internalIndex)
+{
+	auto range = m_nameMap.equal_range(name);
+
+	for (auto itr = range.first; itr != range.second; ++itr)
+	{
+		if (itr->second == internalIndex)
+		{
+			m_nameMap.erase(itr);
+			return;
+		}
+	}
+}
@@ -0,0 +1,41 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <string>
+#include <unordered_map>
+
+// Maps the long and short (8.3) names of the items in a folder to their
+// internal indexes, so that an item can be located by name without
+// having to walk the entire listview.
+class ItemNameIndex
+{
+public:
+
+	void AddItem(int internalIndex, const std::wstring &name, const std::wstring &shortName);
+	void RemoveItem(int internalIndex);
+	void UpdateItem(int internalIndex, const std::wstring &name, const std::wstring &shortName);
+	void Clear();
+
+	boost::optional<int> FindItem(const std::wstring &name) const;
+	std::size_t GetNumItems() const;
+
+private:
+
+	struct ItemNames
+	{
+		std::wstring name;
+		std::wstring shortName;
+	};
+
+	void AddName(const std::wstring &name, int internalIndex);
+	void RemoveName(const std::wstring &name, int internalIndex);
+
+	// A long name can, in theory, be the same as the short name of another
+	// item, so a single name may map to more than one item.
+	std::unordered_multimap<std::wstring, int> m_nameMap;
+	std::unordered_map<int, ItemNames> m_itemNames;
+};
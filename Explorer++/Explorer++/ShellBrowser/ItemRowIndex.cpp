@@ -0,0 +1,153 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ItemRowIndex.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	const int NO_ROW = -1;
+}
+
+ItemRowIndex::ItemRowIndex() :
+	m_firstStaleRow(0)
+{
+
+}
+
+void ItemRowIndex::InsertRow(int row, int internalIndex)
+{
+	assert(row >= 0 && static_cast<std::size_t>(row) <= m_rows.size());
+	assert(internalIndex >= 0);
+
+	bool upToDate = (m_firstStaleRow == m_rows.size());
+
+	m_rows.insert(m_rows.begin() + row, internalIndex);
+	SetItemRow(internalIndex, row);
+
+	// Appending an item doesn't move any of the other items.
+	if (upToDate && static_cast<std::size_t>(row) == m_rows.size() - 1)
+	{
+		m_firstStaleRow = m_rows.size();
+	}
+	else
+	{
+		m_firstStaleRow = (std::min)(m_firstStaleRow, static_cast<std::size_t>(row));
+	}
+}
+
+void ItemRowIndex::RemoveRow(int row)
+{
+	RemoveRows({ row });
+}
+
+void ItemRowIndex::RemoveRows(const std::vector<int> &rows)
+{
+	if (rows.empty())
+	{
+		return;
+	}
+
+	for (int row : rows)
+	{
+		assert(row >= 0 && static_cast<std::size_t>(row) < m_rows.size());
+		assert(m_rows[row] != NO_ROW);
+
+		m_itemRows[m_rows[row]] = NO_ROW;
+		m_rows[row] = NO_ROW;
+	}
+
+	int firstRow = *std::min_element(rows.begin(), rows.end());
+
+	m_rows.erase(std::remove(m_rows.begin() + firstRow, m_rows.end(), NO_ROW), m_rows.end());
+	m_firstStaleRow = (std::min)(m_firstStaleRow, static_cast<std::size_t>(firstRow));
+}
+
+void ItemRowIndex::SetRows(std::vector<int> internalIndexes)
+{
+	m_rows = std::move(internalIndexes);
+	m_firstStaleRow = 0;
+}
+
+void ItemRowIndex::Clear()
+{
+	m_rows.clear();
+	m_itemRows.clear();
+	m_firstStaleRow = 0;
+}
+
+boost::optional<int> ItemRowIndex::FindRow(int internalIndex) const
+{
+	if (internalIndex < 0)
+	{
+		return boost::none;
+	}
+
+	auto isCurrent = [this, internalIndex] {
+		if (static_cast<std::size_t>(internalIndex) >= m_itemRows.size())
+		{
+			return false;
+		}
+
+		int row = m_itemRows[internalIndex];
+		return row != NO_ROW && static_cast<std::size_t>(row) < m_rows.size()
+			&& m_rows[row] == internalIndex;
+	};
+
+	if (!isCurrent())
+	{
+		if (m_firstStaleRow == m_rows.size())
+		{
+			return boost::none;
+		}
+
+		UpdateStaleRows();
+
+		if (!isCurrent())
+		{
+			return boost::none;
+		}
+	}
+
+	return m_itemRows[internalIndex];
+}
+
+int ItemRowIndex::GetInternalIndex(int row) const
+{
+	assert(row >= 0 && static_cast<std::size_t>(row) < m_rows.size());
+
+	return m_rows[row];
+}
+
+const std::vector<int> &ItemRowIndex::GetRows() const
+{
+	return m_rows;
+}
+
+std::size_t ItemRowIndex::GetNumRows() const
+{
+	return m_rows.size();
+}
+
+void ItemRowIndex::SetItemRow(int internalIndex, int row) const
+{
+	if (static_cast<std::size_t>(internalIndex) >= m_itemRows.size())
+	{
+		m_itemRows.resize(internalIndex + 1, NO_ROW);
+	}
+
+	m_itemRows[internalIndex] = row;
+}
+
+void ItemRowIndex::UpdateStaleRows() const
+{
+	for (std::size_t i = m_firstStaleRow; i < m_rows.size(); i++)
+	{
+		SetItemRow(m_rows[i], static_cast<int>(i));
+	}
+
+	m_firstStaleRow = m_rows.size();
+}
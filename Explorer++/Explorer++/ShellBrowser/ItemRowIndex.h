@@ -0,0 +1,58 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <vector>
+
+// Tracks the listview row that each item is in, so that an item can be
+// located from its internal index without searching the listview. Every
+// change made to the rows in the listview (insertions, removals and
+// sorts) needs to be mirrored here.
+//
+// Inserting or removing a row shifts each of the rows after it. Rather
+// than updating the position of every one of those items straight away,
+// they're only updated the next time a lookup needs them. That way, a
+// batch of insertions or removals only results in a single update.
+class ItemRowIndex
+{
+public:
+
+	ItemRowIndex();
+
+	void InsertRow(int row, int internalIndex);
+	void RemoveRow(int row);
+
+	// Removes each of the specified rows in a single pass. The rows are
+	// given by their positions before any of them are removed.
+	void RemoveRows(const std::vector<int> &rows);
+
+	// Replaces the contents of every row (e.g. once the listview has
+	// been sorted).
+	void SetRows(std::vector<int> internalIndexes);
+
+	void Clear();
+
+	boost::optional<int> FindRow(int internalIndex) const;
+	int GetInternalIndex(int row) const;
+	const std::vector<int> &GetRows() const;
+	std::size_t GetNumRows() const;
+
+private:
+
+	void SetItemRow(int internalIndex, int row) const;
+	void UpdateStaleRows() const;
+
+	// The internal index of the item in each row.
+	std::vector<int> m_rows;
+
+	// The last known row of each item, indexed by internal index. An entry
+	// is current if the row it refers to still holds the item.
+	mutable std::vector<int> m_itemRows;
+
+	// Each row from this point onwards may have moved since its entry
+	// above was last updated.
+	mutable std::size_t m_firstStaleRow;
+};
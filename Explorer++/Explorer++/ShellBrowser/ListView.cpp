@@ -42,6 +42,10 @@ LRESULT CALLBACK CShellBrowser::ListViewProc(HWND hwnd, UINT uMsg, WPARAM wParam
 		ProcessColumnResult(static_cast<int>(wParam));
 		break;
 
+	case WM_APP_COLUMN_REQUESTS_PENDING:
+		FlushColumnRequests();
+		break;
+
 	case WM_APP_THUMBNAIL_RESULT_READY:
 		ProcessThumbnailResult(static_cast<int>(wParam));
 		break;
@@ -49,6 +53,22 @@ LRESULT CALLBACK CShellBrowser::ListViewProc(HWND hwnd, UINT uMsg, WPARAM wParam
 	case WM_APP_INFO_TIP_READY:
 		ProcessInfoTipResult(static_cast<int>(wParam));
 		break;
+
+	case WM_APP_ENUMERATION_BATCH_READY:
+		ProcessEnumerationBatches(static_cast<int>(wParam));
+		break;
+
+	case WM_APP_GROUP_RESULT_READY:
+		ProcessGroupResult(static_cast<int>(wParam));
+		break;
+
+	case WM_APP_FOLDER_SIZE_READY:
+		ProcessFolderSizeResult(static_cast<int>(wParam), static_cast<int>(lParam));
+		break;
+
+	case WM_APP_RESYNC_LISTING_READY:
+		ProcessResyncResult(static_cast<int>(wParam));
+		break;
 	}
 
 	return DefSubclassProc(hwnd, uMsg, wParam, lParam);
@@ -82,6 +102,13 @@ LRESULT CALLBACK CShellBrowser::ListViewParentProc(HWND hwnd, UINT uMsg, WPARAM
 			case LVN_COLUMNCLICK:
 				ColumnClicked(reinterpret_cast<NMLISTVIEW *>(lParam)->iSubItem);
 				break;
+
+			case LVN_ENDSCROLL:
+				if (m_folderSettings.viewMode == +ViewMode::Thumbnails)
+				{
+					DropOffscreenThumbnailTasks();
+				}
+				break;
 			}
 		}
 		break;
@@ -148,36 +175,29 @@ void CShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
 
 	int internalIndex = static_cast<int>(plvItem->lParam);
 
-	/* Construct an image here using the items
-	actual icon. This image will be shown initially.
-	If the item also has a thumbnail image, this
-	will be found later, and will overwrite any
-	image settings made here.
-	Note that the initial icon image MUST be drawn
-	first, or else it may be possible for the
-	thumbnail to be drawn before the initial
-	image. */
+	/* If the item's thumbnail has previously been
+	extracted, it will be shown straight away. Otherwise,
+	an image constructed from the item's icon will be
+	shown until the thumbnail has been found. */
 	if (m_folderSettings.viewMode == +ViewMode::Thumbnails && (plvItem->mask & LVIF_IMAGE) == LVIF_IMAGE)
 	{
-		plvItem->iImage = GetIconThumbnail(internalIndex);
+		plvItem->iImage = GetThumbnailImageIndex(internalIndex, plvItem->iItem);
 		plvItem->mask |= LVIF_DI_SETITEM;
 
-		QueueThumbnailTask(internalIndex);
-
 		return;
 	}
 
 	if (m_folderSettings.viewMode == +ViewMode::Details && (plvItem->mask & LVIF_TEXT) == LVIF_TEXT)
 	{
-		QueueColumnTask(internalIndex, plvItem->iSubItem);
+		QueueColumnTask(internalIndex, plvItem->iItem, plvItem->iSubItem);
 	}
 
 	if ((plvItem->mask & LVIF_IMAGE) == LVIF_IMAGE)
 	{
 		const ItemInfo_t &itemInfo = m_itemInfoMap.at(internalIndex);
-		auto cachedIconIndex = GetCachedIconIndex(itemInfo);
+		auto cachedIcon = GetCachedIcon(itemInfo);
 
-		if (cachedIconIndex)
+		if (cachedIcon)
 		{
 			// The icon retrieval method specifies the
 			// SHGFI_OVERLAYINDEX value. That means that cached icons
@@ -194,7 +214,7 @@ void CShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
 			// Rather than doing that, only the icon is set here. Any
 			// overlay will be added by the icon retrieval task
 			// (scheduled below).
-			plvItem->iImage = (*cachedIconIndex & 0x0FFF);
+			plvItem->iImage = (cachedIcon->iconIndex & 0x0FFF);
 		}
 		else
 		{
@@ -208,17 +228,28 @@ void CShellBrowser::OnListViewGetDisplayInfo(LPARAM lParam)
 			}
 		}
 
-		m_iconFetcher->QueueIconTask(itemInfo.pidlComplete.get(), [this, internalIndex] (PCIDLIST_ABSOLUTE pidl, int iconIndex) {
+		auto callback = [this, internalIndex] (PCIDLIST_ABSOLUTE pidl, int iconIndex) {
 			UNREFERENCED_PARAMETER(pidl);
 
 			ProcessIconResult(internalIndex, iconIndex);
-		});
+		};
+
+		// If the icon is shared by all files of this type, it's already
+		// correct and only the overlay (if any) needs to be found.
+		if (cachedIcon && cachedIcon->sharedByType)
+		{
+			m_iconFetcher->QueueOverlayTask(itemInfo.pidlComplete.get(), cachedIcon->iconIndex, callback);
+		}
+		else
+		{
+			m_iconFetcher->QueueIconTask(itemInfo.pidlComplete.get(), callback);
+		}
 	}
 
 	plvItem->mask |= LVIF_DI_SETITEM;
 }
 
-boost::optional<int> CShellBrowser::GetCachedIconIndex(const ItemInfo_t &itemInfo)
+boost::optional<CachedItemIcon> CShellBrowser::GetCachedIcon(const ItemInfo_t &itemInfo)
 {
 	TCHAR filePath[MAX_PATH];
 	HRESULT hr = GetDisplayName(itemInfo.pidlComplete.get(),
@@ -229,14 +260,8 @@ boost::optional<int> CShellBrowser::GetCachedIconIndex(const ItemInfo_t &itemInf
 		return boost::none;
 	}
 
-	auto cachedItr = m_cachedIcons->findByPath(filePath);
-
-	if (cachedItr == m_cachedIcons->end())
-	{
-		return boost::none;
-	}
-
-	return cachedItr->iconIndex;
+	return m_cachedIcons->findItemIcon(filePath,
+		WI_IsFlagSet(itemInfo.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY));
 }
 
 void CShellBrowser::ProcessIconResult(int internalIndex, int iconIndex)
@@ -279,10 +304,8 @@ void CShellBrowser::QueueInfoTipTask(int internalIndex, const std::wstring &exis
 	Config configCopy = *m_config;
 	bool virtualFolder = InVirtualFolder();
 
-	auto result = m_infoTipsThreadPool.push([this, infoTipResultId, internalIndex,
-		basicItemInfo, configCopy, virtualFolder, existingInfoTip](int id) {
-		UNREFERENCED_PARAMETER(id);
-
+	auto result = m_infoTipsTaskQueue->Push(TaskScheduler::TaskPriority::Visible,
+		[this, infoTipResultId, internalIndex, basicItemInfo, configCopy, virtualFolder, existingInfoTip] {
 		auto result = GetInfoTipAsync(m_hListView, infoTipResultId, internalIndex, basicItemInfo, configCopy,
 			m_hResourceModule, virtualFolder);
 
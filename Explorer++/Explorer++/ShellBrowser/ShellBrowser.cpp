@@ -7,8 +7,11 @@
 #include "Config.h"
 #include "ItemData.h"
 #include "MainResource.h"
+#include "SortHelper.h"
 #include "SortModes.h"
+#include "SortedInsertion.h"
 #include "ViewModes.h"
+#include "../Helper/ColorRuleMatcher.h"
 #include "../Helper/Controls.h"
 #include "../Helper/DriveInfo.h"
 #include "../Helper/FileOperations.h"
@@ -65,39 +68,61 @@ ULONG __stdcall CShellBrowser::Release(void)
 }
 
 CShellBrowser *CShellBrowser::CreateNew(int id, HINSTANCE resourceInstance, HWND hOwner,
-	CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
-	const FolderSettings &folderSettings, boost::optional<FolderColumns> initialColumns)
+	CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache,
+	FolderSizeCalculator *folderSizeCalculator, TaskScheduler *taskScheduler,
+	const ColorRuleMatcher *colorRuleMatcher, const Config *config,
+	TabNavigationInterface *tabNavigation, const FolderSettings &folderSettings,
+	boost::optional<FolderColumns> initialColumns)
 {
-	return new CShellBrowser(id, resourceInstance, hOwner, cachedIcons, config, tabNavigation,
-		folderSettings, initialColumns);
+	return new CShellBrowser(id, resourceInstance, hOwner, cachedIcons, columnCache, thumbnailCache,
+		folderSizeCalculator, taskScheduler, colorRuleMatcher, config, tabNavigation, folderSettings,
+		initialColumns);
 }
 
 CShellBrowser::CShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner,
-	CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
-	const FolderSettings &folderSettings, boost::optional<FolderColumns> initialColumns) :
+	CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache,
+	FolderSizeCalculator *folderSizeCalculator, TaskScheduler *taskScheduler,
+	const ColorRuleMatcher *colorRuleMatcher, const Config *config,
+	TabNavigationInterface *tabNavigation, const FolderSettings &folderSettings,
+	boost::optional<FolderColumns> initialColumns) :
 	m_ID(id),
 	m_hResourceModule(resourceInstance),
 	m_hOwner(hOwner),
 	m_cachedIcons(cachedIcons),
 	m_config(config),
+	m_colorRuleMatcher(colorRuleMatcher),
 	m_tabNavigation(tabNavigation),
 	m_folderSettings(folderSettings),
+	m_filterPattern(folderSettings.filter, folderSettings.filterCaseSensitive ? true : false),
 	m_folderColumns(initialColumns ? *initialColumns : config->globalFolderSettings.folderColumns),
-	m_columnThreadPool(1),
+	m_columnTaskQueue(taskScheduler->CreateQueue(GetNumColumnThreads())),
 	m_columnResultIDCounter(0),
-	m_thumbnailThreadPool(1),
+	m_columnCache(columnCache),
+	m_folderSizeCalculator(folderSizeCalculator),
+	m_thumbnailTaskQueue(taskScheduler->CreateQueue(MAX_THUMBNAIL_TASKS)),
 	m_thumbnailResultIDCounter(0),
-	m_infoTipsThreadPool(1),
-	m_infoTipResultIDCounter(0)
+	m_thumbnailCache(thumbnailCache),
+	m_infoTipsTaskQueue(taskScheduler->CreateQueue()),
+	m_infoTipResultIDCounter(0),
+	m_firstEnumerationBatchProcessed(false),
+	m_enumerationMetrics(),
+	m_folderSizeResultIDCounter(0),
+	m_resyncTaskQueue(taskScheduler->CreateQueue()),
+	m_resyncResultIDCounter(0),
+	m_iGroupId(0),
+	m_groupTaskQueue(taskScheduler->CreateQueue(GetNumColumnThreads())),
+	m_groupResultIDCounter(0)
 {
 	m_iRefCount = 1;
 
 	m_hListView = SetUpListView(hOwner);
-	m_iconFetcher = std::make_unique<IconFetcher>(m_hListView, cachedIcons);
+	m_iconFetcher = std::make_unique<IconFetcher>(m_hListView, cachedIcons, taskScheduler);
 
 	InitializeDragDropHelpers();
 
 	m_bFolderVisited = FALSE;
+	m_folderPending = false;
+	m_pendingAddHistoryEntry = false;
 
 	m_bColumnsPlaced = FALSE;
 	m_bOverFolder = FALSE;
@@ -114,6 +139,7 @@ CShellBrowser::CShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner,
 	m_middleButtonItem = -1;
 
 	m_uniqueFolderId = 0;
+	m_resyncRequired = false;
 
 	m_PreviousSortColumnExists = false;
 
@@ -121,27 +147,23 @@ CShellBrowser::CShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner,
 
 	m_iFolderIcon = GetDefaultFolderIconIndex();
 	m_iFileIcon = GetDefaultFileIconIndex();
-
-	m_thumbnailThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-	});
 }
 
 CShellBrowser::~CShellBrowser()
 {
 	DestroyWindow(m_hListView);
 
-	m_columnThreadPool.clear_queue();
-	m_thumbnailThreadPool.clear_queue();
-	m_infoTipsThreadPool.clear_queue();
+	/* Any tasks that are still running will be waited
+	on when the queues are destroyed. */
+	m_columnTaskQueue->Cancel();
+	ClearThumbnailResults();
+	m_infoTipsTaskQueue->Cancel();
+	m_groupTaskQueue->Cancel();
+	m_resyncTaskQueue->Cancel();
 
-	m_thumbnailThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
+	CancelEnumeration();
 
-		CoUninitialize();
-	});
+	CancelFolderSizeCalculations();
 
 	/* Release the drag and drop helpers. */
 	m_pDropTargetHelper->Release();
@@ -345,8 +367,7 @@ void CShellBrowser::SetViewModeInternal(ViewMode viewMode)
 
 	if (viewMode != +ViewMode::Details)
 	{
-		m_columnThreadPool.clear_queue();
-		m_columnResults.clear();
+		ClearColumnResults();
 	}
 
 	SendMessage(m_hListView, LVM_SETVIEW, dwStyle, 0);
@@ -426,7 +447,7 @@ void CShellBrowser::UpdateFileSelectionInfo(int iCacheIndex,BOOL Selected)
 
 BOOL CShellBrowser::IsFilenameFiltered(const TCHAR *FileName) const
 {
-	if(CheckWildcardMatch(m_folderSettings.filter.c_str(),FileName,m_folderSettings.filterCaseSensitive))
+	if(m_filterPattern.Matches(FileName))
 		return FALSE;
 
 	return TRUE;
@@ -492,65 +513,71 @@ int CShellBrowser::SelectFiles(const TCHAR *FileNamePattern)
 		return 1;
 	}
 
+	/* The file may simply not have been enumerated yet. If so,
+	it will be selected once the enumeration has finished. */
+	if(IsEnumerating())
+	{
+		m_pendingFileSelection = FileNamePattern;
+	}
+
 	return 0;
 }
 
 int CShellBrowser::LocateFileItemIndex(const TCHAR *szFileName) const
 {
-	LV_FINDINFO	lvFind;
-	int			iItem;
-	int			iInternalIndex;
-
-	iInternalIndex = LocateFileItemInternalIndex(szFileName);
+	int iInternalIndex = LocateFileItemInternalIndex(szFileName);
 
-	if(iInternalIndex != -1)
+	if(iInternalIndex == -1)
 	{
-		lvFind.flags	= LVFI_PARAM;
-		lvFind.lParam	= iInternalIndex;
-		iItem			= ListView_FindItem(m_hListView,-1,&lvFind);
+		return -1;
+	}
+
+	auto iItem = LocateItemByInternalIndex(iInternalIndex);
 
-		return iItem;
+	if(!iItem)
+	{
+		return -1;
 	}
 
-	return -1;
+	return *iItem;
 }
 
+/* Finds an item by its long or short name. Note that
+this will also find items that have been filtered out. */
 int CShellBrowser::LocateFileItemInternalIndex(const TCHAR *szFileName) const
 {
-	LVITEM	lvItem;
-	int		i = 0;
+	auto internalIndex = m_itemNameIndex.FindItem(szFileName);
 
-	for(i = 0;i < m_nTotalItems;i++)
+	if(!internalIndex)
 	{
-		lvItem.mask		= LVIF_PARAM;
-		lvItem.iItem	= i;
-		lvItem.iSubItem	= 0;
-		ListView_GetItem(m_hListView,&lvItem);
-
-		if((lstrcmp(m_itemInfoMap.at((int)lvItem.lParam).wfd.cFileName,szFileName) == 0) ||
-			(lstrcmp(m_itemInfoMap.at((int)lvItem.lParam).wfd.cAlternateFileName,szFileName) == 0))
-		{
-			return (int)lvItem.lParam;
-			break;
-		}
+		return -1;
 	}
 
-	return -1;
+	return *internalIndex;
 }
 
 boost::optional<int> CShellBrowser::LocateItemByInternalIndex(int internalIndex) const
 {
-	LVFINDINFO lvfi;
-	lvfi.flags = LVFI_PARAM;
-	lvfi.lParam = internalIndex;
-	int item = ListView_FindItem(m_hListView, -1, &lvfi);
+	return m_itemRowIndex.FindRow(internalIndex);
+}
 
-	if (item == -1)
+/* The item will usually still be at the position it was at
+when it was last seen, in which case there's no need to search
+for it. */
+boost::optional<int> CShellBrowser::LocateItemByInternalIndex(int internalIndex, int expectedIndex) const
+{
+	LVITEM lvItem;
+	lvItem.mask = LVIF_PARAM;
+	lvItem.iItem = expectedIndex;
+	lvItem.iSubItem = 0;
+	BOOL res = ListView_GetItem(m_hListView, &lvItem);
+
+	if (res && static_cast<int>(lvItem.lParam) == internalIndex)
 	{
-		return boost::none;
+		return expectedIndex;
 	}
 
-	return item;
+	return LocateItemByInternalIndex(internalIndex);
 }
 
 WIN32_FIND_DATA CShellBrowser::GetItemFileFindData(int iItem) const
@@ -559,6 +586,28 @@ WIN32_FIND_DATA CShellBrowser::GetItemFileFindData(int iItem) const
 	return m_itemInfoMap.at(internalIndex).wfd;
 }
 
+boost::optional<COLORREF> CShellBrowser::GetItemColor(int iItem) const
+{
+	int internalIndex = GetItemInternalIndex(iItem);
+	return m_itemInfoMap.at(internalIndex).color;
+}
+
+/* Called when the color rules change. */
+void CShellBrowser::UpdateItemColors()
+{
+	for(auto &item : m_itemInfoMap)
+	{
+		UpdateItemColor(item.second);
+	}
+
+	InvalidateRect(m_hListView, nullptr, FALSE);
+}
+
+void CShellBrowser::UpdateItemColor(ItemInfo_t &itemInfo) const
+{
+	itemInfo.color = m_colorRuleMatcher->GetColor(itemInfo.wfd.cFileName, itemInfo.wfd.dwFileAttributes);
+}
+
 void CShellBrowser::DragStarted(int iFirstItem,POINT *ptCursor)
 {
 	DraggedFile_t	df;
@@ -856,44 +905,22 @@ void CShellBrowser::PositionDroppedItems(void)
 	}
 }
 
+/* Returns the position at which the item should be inserted
+so that the listview remains sorted. The item is placed before
+the first item it doesn't sort after (e.g. 0 places it at the
+start of the list and the item count places it at the end).
+Since the listview is already sorted, a binary search is used,
+with the key for the new item only being built once. */
 int CShellBrowser::DetermineItemSortedPosition(LPARAM lParam) const
 {
-	LVITEM	lvItem;
-	BOOL	bItem;
-	int		res = 1;
-	int		nItems = 0;
-	int		i = 0;
-
-	nItems = ListView_GetItemCount(m_hListView);
+	SortKey_t newKey = BuildItemSortKey(static_cast<int>(lParam));
 
-	while(res > 0 && i < nItems)
-	{
-		lvItem.mask		= LVIF_PARAM;
-		lvItem.iItem	= i;
-		lvItem.iSubItem	= 0;
-		bItem = ListView_GetItem(m_hListView,&lvItem);
+	bool sortFoldersFirst = !CompareVirtualFolders(CSIDL_BITBUCKET);
+	bool sortAscending = m_folderSettings.sortAscending ? true : false;
 
-		if(bItem)
-			res = Sort(static_cast<int>(lParam),static_cast<int>(lvItem.lParam));
-		else
-			res = 0;
-
-		i++;
-	}
-
-	/* The item will always be inserted BEFORE
-	the item at position i that we specify here.
-	For example, specifying 0, will place the item
-	at 0 (and push 0 to 1), specifying 1 will place
-	the item at 1 (and push 1 to 2).
-	Therefore, to place in the last position, need
-	to place AFTER last item. */
-	if((i - 1) == nItems - 1 && res > 0)
-	{
-		i++;
-	}
-
-	return i - 1;
+	return FindSortedInsertionPosition(ListView_GetItemCount(m_hListView),[this,&newKey,sortFoldersFirst,sortAscending] (int item) {
+		return CompareSortKeys(newKey,BuildItemSortKey(GetItemInternalIndex(item)),sortFoldersFirst,sortAscending);
+	});
 }
 
 void CShellBrowser::RemoveFilteredItems(void)
@@ -943,6 +970,7 @@ void CShellBrowser::RemoveFilteredItem(int iItem,int iItemInternal)
 
 	/* Remove the item from the m_hListView. */
 	ListView_DeleteItem(m_hListView,iItem);
+	m_itemRowIndex.RemoveRow(iItem);
 
 	m_nTotalItems--;
 
@@ -1001,6 +1029,7 @@ std::wstring CShellBrowser::GetFilter() const
 void CShellBrowser::SetFilter(std::wstring_view filter)
 {
 	m_folderSettings.filter = filter;
+	m_filterPattern = WildcardPattern(m_folderSettings.filter, m_folderSettings.filterCaseSensitive ? true : false);
 
 	if(m_folderSettings.applyFilter)
 	{
@@ -1024,6 +1053,7 @@ BOOL CShellBrowser::GetFilterStatus(void) const
 void CShellBrowser::SetFilterCaseSensitive(BOOL bFilterCaseSensitive)
 {
 	m_folderSettings.filterCaseSensitive = bFilterCaseSensitive;
+	m_filterPattern = WildcardPattern(m_folderSettings.filter, m_folderSettings.filterCaseSensitive ? true : false);
 }
 
 BOOL CShellBrowser::GetFilterCaseSensitive(void) const
@@ -1052,23 +1082,23 @@ void CShellBrowser::UpdateFiltering(void)
 
 void CShellBrowser::UnfilterAllItems(void)
 {
-	std::list<int>::iterator	itr;
-	AwaitingAdd_t		AwaitingAdd;
-
-	for(itr = m_FilteredItemsList.begin();itr != m_FilteredItemsList.end();itr++)
+	for(int internalIndex : m_FilteredItemsList)
 	{
-		int iSorted = DetermineItemSortedPosition(*itr);
+		AwaitingAdd_t awaitingAdd;
+		awaitingAdd.iItem = -1;
+		awaitingAdd.iItemInternal = internalIndex;
+		awaitingAdd.bPosition = TRUE;
+		awaitingAdd.iAfter = -1;
 
-		AwaitingAdd.iItem			= iSorted;
-		AwaitingAdd.bPosition		= TRUE;
-		AwaitingAdd.iAfter			= iSorted - 1;
-		AwaitingAdd.iItemInternal	= *itr;
-
-		m_AwaitingAddList.push_back(AwaitingAdd);
+		m_AwaitingAddList.push_back(awaitingAdd);
 	}
 
 	m_FilteredItemsList.clear();
 
+	/* All the items are placed in a single pass, rather than
+	searching for the position of each item individually. */
+	SortAwaitingItems();
+
 	InsertAwaitingItems(m_folderSettings.showInGroups);
 
 	SendMessage(m_hOwner,WM_USER_UPDATEWINDOWS,0,0);
@@ -1291,7 +1321,7 @@ void CShellBrowser::OnDeviceChange(WPARAM wParam,LPARAM lParam)
 					}
 					else
 					{
-						OnFileActionAdded(szDrive);
+						OnFileActionAdded(szDrive,FALSE);
 					}
 				}
 			}
@@ -1450,6 +1480,16 @@ IconFetcher *CShellBrowser::GetIconFetcher()
 	return m_iconFetcher.get();
 }
 
+void CShellBrowser::SetTasksActive(bool active)
+{
+	m_columnTaskQueue->SetActive(active);
+	m_thumbnailTaskQueue->SetActive(active);
+	m_infoTipsTaskQueue->SetActive(active);
+	m_groupTaskQueue->SetActive(active);
+	m_resyncTaskQueue->SetActive(active);
+	m_iconFetcher->SetActive(active);
+}
+
 FolderSettings CShellBrowser::GetFolderSettings() const
 {
 	return m_folderSettings;
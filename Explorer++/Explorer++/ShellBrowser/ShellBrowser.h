@@ -4,12 +4,19 @@
 
 #pragma once
 
+#include "ChangeJournal.h"
 #include "ColumnDataRetrieval.h"
+#include "ColumnFetchQueue.h"
 #include "Columns.h"
+#include "FolderDiff.h"
 #include "FolderSettings.h"
+#include "GroupItemCounts.h"
+#include "ItemNameIndex.h"
+#include "ItemRowIndex.h"
 #include "SignalWrapper.h"
 #include "SortModes.h"
 #include "TabNavigationInterface.h"
+#include "ThumbnailCache.h"
 #include "ViewModes.h"
 #include "../Helper/DropHandler.h"
 #include "../Helper/Helper.h"
@@ -17,13 +24,19 @@
 #include "../Helper/Macros.h"
 #include "../Helper/ShellHelper.h"
 #include "../Helper/StringHelper.h"
+#include "../Helper/TaskScheduler.h"
 #include "../Helper/WindowSubclassWrapper.h"
-#include "../ThirdParty/CTPL/cpl_stl.h"
 #include <boost/optional.hpp>
 #include <wil/resource.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <future>
 #include <list>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 #define WM_USER_UPDATEWINDOWS		(WM_APP + 17)
 #define WM_USER_FILESADDED			(WM_APP + 51)
@@ -41,23 +54,38 @@ typedef struct
 {
 	std::wstring header;
 	int iGroupId;
-
-	/* Used to record the number of items in this group.
-	Mimics the feature available in Windows Vista and later. */
-	int nItems;
 } TypeGroup_t;
 
+struct EnumerationMetrics
+{
+	/* The time between the start of the enumeration and
+	the first set of items being inserted into the
+	listview. */
+	std::chrono::milliseconds timeToFirstItem;
+
+	std::chrono::milliseconds totalTime;
+	int numItems;
+};
+
 struct BasicItemInfo_t;
+struct SortKey_t;
 class CachedIcons;
+struct CachedItemIcon;
+class ColorRuleMatcher;
+class ColumnCache;
 struct Config;
+class FolderSizeCalculator;
 
 class CShellBrowser : public IDropTarget, public IDropFilesCallback
 {
 public:
 
 	static CShellBrowser *CreateNew(int id, HINSTANCE resourceInstance, HWND hOwner,
-		CachedIcons *cachedIcons, const Config *config, TabNavigationInterface *tabNavigation,
-		const FolderSettings &folderSettings, boost::optional<FolderColumns> initialColumns);
+		CachedIcons *cachedIcons, ColumnCache *columnCache, ThumbnailCache *thumbnailCache,
+		FolderSizeCalculator *folderSizeCalculator, TaskScheduler *taskScheduler,
+		const ColorRuleMatcher *colorRuleMatcher, const Config *config,
+		TabNavigationInterface *tabNavigation, const FolderSettings &folderSettings,
+		boost::optional<FolderColumns> initialColumns);
 
 	/* IUnknown methods. */
 	HRESULT __stdcall	QueryInterface(REFIID iid,void **ppvObject);
@@ -68,9 +96,20 @@ public:
 	IconFetcher			*GetIconFetcher();
 	FolderSettings		GetFolderSettings() const;
 
+	/* Tasks queued by the selected tab are run ahead of
+	those queued by background tabs. */
+	void				SetTasksActive(bool active);
+
 	/* Navigation. */
 	HRESULT				BrowseFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHistoryEntry = true);
 
+	/* Records the folder without enumerating it (e.g. for tabs
+	restored in the background). The folder is only browsed once
+	BrowsePendingFolder() is called. */
+	void				SetPendingFolder(PCIDLIST_ABSOLUTE pidlDirectory, bool addHistoryEntry);
+	bool				HasPendingFolder() const;
+	HRESULT				BrowsePendingFolder();
+
 	/* Drag and Drop. */
 	void				DragStarted(int iFirstItem,POINT *ptCursor);
 	void				DragStopped(void);
@@ -111,6 +150,10 @@ public:
 	int					GetDirMonitorId(void) const;
 	int					GetUniqueFolderId() const;
 
+	/* Enumeration. */
+	bool				IsEnumerating() const;
+	EnumerationMetrics	GetEnumerationMetrics() const;
+
 	/* Item information. */
 	WIN32_FIND_DATA		GetItemFileFindData(int iItem) const;
 	unique_pidl_absolute	GetItemCompleteIdl(int iItem) const;
@@ -118,6 +161,12 @@ public:
 	int					GetItemDisplayName(int iItem,UINT BufferSize,TCHAR *Buffer) const;
 	HRESULT				GetItemFullName(int iIndex,TCHAR *FullItemPath,UINT cchMax) const;
 
+	/* The color is determined from the color rules when the
+	item is added (or changed), so that it doesn't have to be
+	worked out each time the item is drawn. */
+	boost::optional<COLORREF>	GetItemColor(int iItem) const;
+	void				UpdateItemColors();
+
 	void				ShowPropertiesForSelectedFiles() const;
 	
 	/* Column support. */
@@ -194,16 +243,37 @@ private:
 		BOOL			bDrive;
 		TCHAR			szDrive[4];
 
+		/* Set from the first color rule the item matches. */
+		boost::optional<COLORREF>	color;
+
 		/* Used for temporary sorting in details mode (i.e.
 		when items need to be rearranged). */
 		int				iRelativeSort;
 	};
 
-	struct AlteredFile_t
+	struct EnumerationBatch_t
 	{
-		TCHAR	szFileName[MAX_PATH];
-		DWORD	dwAction;
-		int		iFolderIndex;
+		std::vector<ItemInfo_t>	items;
+
+		/* Set on the last batch for a folder. */
+		bool			finished;
+	};
+
+	/* State shared between the UI thread and the enumeration
+	thread. The enumeration thread holds its own reference to
+	this, so the shell browser can move on to another folder
+	(or be destroyed) while an enumeration is still running. */
+	struct EnumerationContext_t
+	{
+		unique_pidl_absolute	pidlDirectory;
+		SHCONTF			enumFlags;
+		bool			virtualFolder;
+		int				folderId;
+
+		std::mutex		mutex;
+		std::condition_variable	batchConsumed;
+		std::deque<EnumerationBatch_t>	pendingBatches;
+		std::atomic<bool>	cancelled;
 	};
 
 	struct AwaitingAdd_t
@@ -231,17 +301,25 @@ private:
 		TCHAR szFileName[MAX_PATH];
 	};
 
+	/* Holds the text for each of the columns that were
+	retrieved for a single row. */
 	struct ColumnResult_t
 	{
+		std::uint64_t jobId;
 		int itemInternalIndex;
-		int columnID;
-		std::wstring columnText;
+		int itemIndex;
+		std::vector<std::pair<unsigned int, std::wstring>> columnTexts;
 	};
 
+	/* The cancelled flag is set if the thumbnail is no
+	longer needed by the time the task runs (e.g. because
+	the item has been scrolled out of view). */
 	struct ThumbnailResult_t
 	{
 		int itemInternalIndex;
-		wil::unique_hbitmap bitmap;
+		int itemIndex;
+		std::shared_ptr<std::atomic<bool>> cancelled;
+		std::future<std::shared_ptr<const ThumbnailCache::Thumbnail>> thumbnail;
 	};
 
 	struct InfoTipResult
@@ -250,6 +328,32 @@ private:
 		std::wstring infoTip;
 	};
 
+	/* The item index is the position of the item at the
+	time its group header was requested. */
+	struct GroupHeaderRequest_t
+	{
+		int itemInternalIndex;
+		int itemIndex;
+		BasicItemInfo_t itemInfo;
+	};
+
+	struct GroupHeaderResult_t
+	{
+		int itemInternalIndex;
+		int itemIndex;
+		std::wstring header;
+	};
+
+	/* A folder size that's being calculated so that the
+	folder can be sorted by size. The result will be empty
+	if the calculation was cancelled. */
+	struct FolderSizeResult_t
+	{
+		int folderSizeResultId;
+		int calculationId;
+		std::future<boost::optional<ULONGLONG>> size;
+	};
+
 	enum class GroupByDateType
 	{
 		Created,
@@ -265,13 +369,56 @@ private:
 	static const UINT WM_APP_COLUMN_RESULT_READY = WM_APP + 150;
 	static const UINT WM_APP_THUMBNAIL_RESULT_READY = WM_APP + 151;
 	static const UINT WM_APP_INFO_TIP_READY = WM_APP + 152;
+	static const UINT WM_APP_ENUMERATION_BATCH_READY = WM_APP + 153;
+	static const UINT WM_APP_COLUMN_REQUESTS_PENDING = WM_APP + 154;
+	static const UINT WM_APP_GROUP_RESULT_READY = WM_APP + 155;
+	static const UINT WM_APP_FOLDER_SIZE_READY = WM_APP + 156;
+	static const UINT WM_APP_RESYNC_LISTING_READY = WM_APP + 157;
+
+	/* The upper limit on the number of tasks used to
+	retrieve column text that can run at once. The actual
+	number depends on the number of processors available. */
+	static constexpr unsigned int MAX_COLUMN_THREADS = 8;
+
+	/* The number of thumbnails that can be extracted at
+	once. */
+	static const int MAX_THUMBNAIL_TASKS = 4;
+
+	/* The number of items whose group headers are
+	determined by each background task. The counts shown
+	in the group headers are updated once per batch. */
+	static const int GROUP_BATCH_SIZE = 500;
+
+	/* The maximum number of items requested from the enumerator
+	in a single call. */
+	static const ULONG ENUMERATION_FETCH_SIZE = 256;
+
+	/* Batches are handed to the UI thread once they reach this
+	size, or once the relevant interval below has elapsed. The
+	first batch uses a shorter interval, so that the first set of
+	items appears quickly, even in folders that are slow to
+	enumerate. */
+	static const size_t ENUMERATION_MAX_BATCH_SIZE = 4096;
+	static constexpr std::chrono::milliseconds ENUMERATION_FIRST_BATCH_INTERVAL{ 50 };
+	static constexpr std::chrono::milliseconds ENUMERATION_BATCH_INTERVAL{ 250 };
+
+	/* The enumeration thread will wait once this many batches
+	are waiting to be processed by the UI thread. */
+	static const size_t ENUMERATION_MAX_PENDING_BATCHES = 8;
+
+	/* If more than this number of files are added in a
+	single update, they're appended to the listview and
+	the folder is then resorted once, rather than each
+	file being inserted into its sorted position. */
+	static const size_t DEFERRED_INSERTION_THRESHOLD = 50;
 
 	static const int THUMBNAIL_ITEM_WIDTH = 120;
 	static const int THUMBNAIL_ITEM_HEIGHT = 120;
 
 	CShellBrowser(int id, HINSTANCE resourceInstance, HWND hOwner, CachedIcons *cachedIcons,
-		const Config *config, TabNavigationInterface *tabNavigation, const FolderSettings &folderSettings,
-		boost::optional<FolderColumns> initialColumns);
+		ColumnCache *columnCache, ThumbnailCache *thumbnailCache, FolderSizeCalculator *folderSizeCalculator,
+		TaskScheduler *taskScheduler, const ColorRuleMatcher *colorRuleMatcher, const Config *config,
+		TabNavigationInterface *tabNavigation, const FolderSettings &folderSettings, boost::optional<FolderColumns> initialColumns);
 	~CShellBrowser();
 
 	HWND				SetUpListView(HWND parent);
@@ -281,7 +428,12 @@ private:
 	void				VerifySortMode();
 
 	/* Browsing support. */
-	HRESULT				EnumerateFolder(PCIDLIST_ABSOLUTE pidlDirectory);
+	void				StartEnumeration(PCIDLIST_ABSOLUTE pidlDirectory);
+	static void			EnumerateFolderAsync(HWND listView, HWND owner, std::shared_ptr<EnumerationContext_t> context);
+	static bool			QueueEnumerationBatch(HWND listView, EnumerationContext_t &context, EnumerationBatch_t batch);
+	void				ProcessEnumerationBatches(int folderId);
+	void				OnEnumerationCompleted();
+	void				CancelEnumeration();
 	void				ClearPendingResults();
 	void				ResetFolderState();
 	void				InsertAwaitingItems(BOOL bInsertIntoGroup);
@@ -289,6 +441,8 @@ private:
 	HRESULT				AddItemInternal(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild, const TCHAR *szFileName, int iItemIndex, BOOL bPosition);
 	HRESULT				AddItemInternal(int iItemIndex,int iItemId,BOOL bPosition);
 	int					SetItemInformation(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild, const TCHAR *szFileName);
+	static ItemInfo_t	BuildItemInfo(PCIDLIST_ABSOLUTE pidlDirectory, PCITEMID_CHILD pidlChild, const TCHAR *szFileName);
+	void				UpdateItemColor(ItemInfo_t &itemInfo) const;
 	void				SetViewModeInternal(ViewMode viewMode);
 	void				ApplyFolderEmptyBackgroundImage(bool apply);
 	void				ApplyFilteringBackgroundImage(bool apply);
@@ -320,12 +474,20 @@ private:
 	BasicItemInfo_t		getBasicItemInfo(int internalIndex) const;
 
 	/* Sorting. */
-	int CALLBACK		Sort(int InternalIndex1,int InternalIndex2) const;
+	SortKey_t			BuildItemSortKey(int internalIndex) const;
+	std::vector<int>	DetermineSortedPositions() const;
+	void				QueueFolderSizesForSort();
+	void				QueueFolderSizeCalculation(int internalIndex, const std::wstring &path);
+	void				ProcessFolderSizeResult(int internalIndex, int folderSizeResultId);
+	void				CancelFolderSizeCalculations();
 
 	/* Listview column support. */
 	void				PlaceColumns();
-	void				QueueColumnTask(int itemInternalIndex, int columnIndex);
-	static ColumnResult_t	GetColumnTextAsync(HWND listView, int columnResultId, unsigned int ColumnID, int InternalIndex, const BasicItemInfo_t &basicItemInfo, const GlobalFolderSettings &globalFolderSettings);
+	static int			GetNumColumnThreads();
+	void				QueueColumnTask(int itemInternalIndex, int itemIndex, int columnIndex);
+	void				FlushColumnRequests();
+	static boost::optional<ColumnResult_t>	GetColumnTextAsync(HWND listView, int columnResultId, ColumnFetchQueue<BasicItemInfo_t> *columnFetchQueue, ColumnCache *columnCache, FolderSizeCalculator *folderSizeCalculator, std::shared_ptr<const GlobalFolderSettings> globalFolderSettings);
+	void				ClearColumnResults();
 	void				InsertColumn(unsigned int ColumnId,int iColumndIndex,int iWidth);
 	void				SetActiveColumnSet();
 	void				GetColumnInternal(unsigned int id,Column_t *pci) const;
@@ -339,14 +501,22 @@ private:
 	void				RemoveDrive(const TCHAR *szDrive);
 	
 	/* Directory altered support. */
-	void				OnFileActionAdded(const TCHAR *szFileName);
+	void				UpdateDirectory(const std::vector<ChangeJournal::Change> &changes, size_t nEvents);
+	void				ApplyDirectoryChanges(const std::vector<ChangeJournal::Change> &changes);
+	void				StartResync();
+	static boost::optional<std::vector<FolderDiffItem>>	ListFolderItemsAsync(HWND listView, int resyncResultId,
+		const std::wstring &directory, SHCONTF enumFlags);
+	void				ProcessResyncResult(int resyncResultId);
+	void				ClearResyncResults();
+	SHCONTF				GetEnumerationFlags() const;
+	void				InvalidateFolderSize(const std::wstring &fileName);
+	void				OnFileActionAdded(const TCHAR *szFileName, BOOL bDeferInsertion);
 	void				RemoveItem(int iItemInternal);
-	void				RemoveItemInternal(const TCHAR *szFileName);
-	void				ModifyItemInternal(const TCHAR *FileName);
-	void				OnFileActionRenamedOldName(const TCHAR *szFileName);
-	void				OnFileActionRenamedNewName(const TCHAR *szFileName);
+	void				RemoveItems(const std::vector<int> &itemInternalIndexes);
+	void				ModifyItemInternal(const TCHAR *FileName, int iItem);
 	void				RenameItem(int iItemInternal, const TCHAR *szNewFileName);
 	int					DetermineItemSortedPosition(LPARAM lParam) const;
+	void				SortAwaitingItems();
 
 	/* Filtering support. */
 	BOOL				IsFilenameFiltered(const TCHAR *FileName) const;
@@ -360,8 +530,13 @@ private:
 	INT CALLBACK		GroupNameComparison(INT Group1_ID, INT Group2_ID);
 	static INT CALLBACK	GroupFreeSpaceComparisonStub(INT Group1_ID, INT Group2_ID, void *pvData);
 	INT CALLBACK		GroupFreeSpaceComparison(INT Group1_ID, INT Group2_ID);
+	boost::optional<int>	ComparePendingGroup(int group1Id, int group2Id) const;
 	std::wstring		RetrieveGroupHeader(int groupId);
 	int					DetermineItemGroup(int iItemInternal);
+	std::wstring		DetermineItemGroupHeader(const BasicItemInfo_t &itemInfo, SortMode sortMode,
+		const GlobalFolderSettings &globalFolderSettings) const;
+	static PFNLVGROUPCOMPARE	GetGroupComparison(SortMode sortMode);
+	static bool			IsGroupHeaderExpensive(SortMode sortMode);
 	std::wstring		DetermineItemNameGroup(const BasicItemInfo_t &itemInfo) const;
 	std::wstring		DetermineItemSizeGroup(const BasicItemInfo_t &itemInfo) const;
 	std::wstring		DetermineItemTotalSizeGroup(const BasicItemInfo_t &itemInfo) const;
@@ -371,33 +546,46 @@ private:
 		const GlobalFolderSettings &globalFolderSettings) const;
 	std::wstring		DetermineItemFreeSpaceGroup(const BasicItemInfo_t &itemInfo) const;
 	std::wstring		DetermineItemAttributeGroup(const BasicItemInfo_t &itemInfo) const;
-	std::wstring		DetermineItemOwnerGroup(const BasicItemInfo_t &itemInfo) const;
-	std::wstring		DetermineItemVersionGroup(const BasicItemInfo_t &itemInfo, const TCHAR *szVersionType) const;
-	std::wstring		DetermineItemCameraPropertyGroup(const BasicItemInfo_t &itemInfo, PROPID PropertyId) const;
+	std::wstring		DetermineItemColumnGroup(const BasicItemInfo_t &itemInfo, unsigned int columnId,
+		const std::wstring &defaultHeader, const GlobalFolderSettings &globalFolderSettings) const;
 	std::wstring		DetermineItemExtensionGroup(const BasicItemInfo_t &itemInfo) const;
 	std::wstring		DetermineItemFileSystemGroup(const BasicItemInfo_t &itemInfo) const;
 	std::wstring		DetermineItemNetworkStatus(const BasicItemInfo_t &itemInfo) const;
 
 	/* Other grouping support. */
 	int					CheckGroup(std::wstring_view groupHeader, PFNLVGROUPCOMPARE groupComparison);
+	int					CheckPendingGroup(void);
+	void				RemovePendingItems(int numItems);
+	void				UpdateGroupHeaders(void);
 	void				InsertItemIntoGroup(int iItem,int iGroupId);
 	void				MoveItemsIntoGroups(void);
+	void				QueueGroupTasks(const std::vector<std::pair<int, int>> &items);
+	std::vector<GroupHeaderResult_t>	DetermineGroupHeadersAsync(int groupResultId,
+		const std::vector<GroupHeaderRequest_t> &requests, SortMode sortMode,
+		std::shared_ptr<const GlobalFolderSettings> globalFolderSettings) const;
+	void				ProcessGroupResult(int groupResultId);
+	void				ClearGroupResults(void);
 
 	/* Listview icons. */
 	void				ProcessIconResult(int internalIndex, int iconIndex);
-	boost::optional<int>	GetCachedIconIndex(const ItemInfo_t &itemInfo);
+	boost::optional<CachedItemIcon>	GetCachedIcon(const ItemInfo_t &itemInfo);
 
 	/* Thumbnails view. */
-	void				QueueThumbnailTask(int internalIndex);
-	static boost::optional<ThumbnailResult_t>	FindThumbnailAsync(HWND listView, int thumbnailResultId, int internalIndex, const BasicItemInfo_t &basicItemInfo);
+	int					GetThumbnailImageIndex(int internalIndex, int itemIndex);
+	void				QueueThumbnailTask(int internalIndex, int itemIndex);
+	static std::shared_ptr<const ThumbnailCache::Thumbnail>	FindThumbnailAsync(HWND listView, int thumbnailResultId, const BasicItemInfo_t &basicItemInfo, ThumbnailCache *thumbnailCache, std::shared_ptr<std::atomic<bool>> cancelled);
+	static std::shared_ptr<const ThumbnailCache::Thumbnail>	ExtractThumbnail(const BasicItemInfo_t &basicItemInfo);
+	static std::shared_ptr<const ThumbnailCache::Thumbnail>	GetThumbnailPixels(HBITMAP bitmap);
 	void				ProcessThumbnailResult(int thumbnailResultId);
+	void				DropOffscreenThumbnailTasks();
+	void				ClearThumbnailResults();
 	void				SetupThumbnailsView(void);
 	void				RemoveThumbnailsView(void);
-	int					GetIconThumbnail(int iInternalIndex) const;
-	int					GetExtractedThumbnail(HBITMAP hThumbnailBitmap) const;
-	int					GetThumbnailInternal(int iType, int iInternalIndex, HBITMAP hThumbnailBitmap) const;
-	void				DrawIconThumbnailInternal(HDC hdcBacking, int iInternalIndex) const;
-	void				DrawThumbnailInternal(HDC hdcBacking, HBITMAP hThumbnailBitmap) const;
+	int					GetIconThumbnail(int iInternalIndex);
+	int					GetExtractedThumbnail(const ThumbnailCache::Thumbnail &thumbnail);
+	int					GetThumbnailInternal(int iType, int iIconIndex, const ThumbnailCache::Thumbnail *thumbnail);
+	void				DrawIconThumbnailInternal(HDC hdcBacking, int iIconIndex) const;
+	void				DrawThumbnailInternal(HDC hdcBacking, const ThumbnailCache::Thumbnail &thumbnail) const;
 
 	/* Tiles view. */
 	void				InsertTileViewColumns();
@@ -418,6 +606,7 @@ private:
 	BOOL				CompareVirtualFolders(UINT uFolderCSIDL) const;
 	int					LocateFileItemInternalIndex(const TCHAR *szFileName) const;
 	boost::optional<int>	LocateItemByInternalIndex(int internalIndex) const;
+	boost::optional<int>	LocateItemByInternalIndex(int internalIndex, int expectedIndex) const;
 	void				ApplyHeaderSortArrow();
 	void				QueryFullItemNameInternal(int iItemInternal,TCHAR *szFullFileName,UINT cchMax) const;
 
@@ -446,23 +635,57 @@ private:
 	as display name. */
 	std::unordered_map<int, ItemInfo_t>	m_itemInfoMap;
 
-	ctpl::thread_pool	m_columnThreadPool;
-	std::unordered_map<int, std::future<ColumnResult_t>> m_columnResults;
+	/* Allows items to be looked up by their
+	long or short name. */
+	ItemNameIndex		m_itemNameIndex;
+
+	/* Allows the listview row of an item to be
+	found from its internal index. Needs to be
+	updated whenever items are inserted into,
+	removed from or reordered within the
+	listview. */
+	ItemRowIndex		m_itemRowIndex;
+
+	/* Must be declared before the task queue, as the
+	tasks in the queue refer to it. */
+	ColumnFetchQueue<BasicItemInfo_t> m_columnFetchQueue;
+
+	std::unique_ptr<TaskScheduler::Queue>	m_columnTaskQueue;
+	std::unordered_map<int, std::future<boost::optional<ColumnResult_t>>> m_columnResults;
 	int					m_columnResultIDCounter;
+	ColumnCache			*m_columnCache;
+	FolderSizeCalculator	*m_folderSizeCalculator;
 
 	std::unique_ptr<IconFetcher> m_iconFetcher;
 	CachedIcons			*m_cachedIcons;
 
-	ctpl::thread_pool	m_thumbnailThreadPool;
-	std::unordered_map<int, std::future<boost::optional<ThumbnailResult_t>>> m_thumbnailResults;
+	std::unique_ptr<TaskScheduler::Queue>	m_thumbnailTaskQueue;
+	std::unordered_map<int, ThumbnailResult_t> m_thumbnailResults;
 	int					m_thumbnailResultIDCounter;
+	ThumbnailCache		*m_thumbnailCache;
 
-	ctpl::thread_pool	m_infoTipsThreadPool;
+	std::unique_ptr<TaskScheduler::Queue>	m_infoTipsTaskQueue;
 	std::unordered_map<int, std::future<boost::optional<InfoTipResult>>> m_infoTipResults;
 	int					m_infoTipResultIDCounter;
 
-	/* Cached folder size data. */
-	mutable std::unordered_map<int, ULONGLONG>	m_cachedFolderSizes;
+	std::shared_ptr<EnumerationContext_t>	m_enumerationContext;
+	std::chrono::steady_clock::time_point	m_enumerationStartTime;
+	bool				m_firstEnumerationBatchProcessed;
+	EnumerationMetrics	m_enumerationMetrics;
+
+	/* Set if a file selection was requested before the
+	file was enumerated. */
+	boost::optional<std::wstring>	m_pendingFileSelection;
+
+	/* Folder sizes used when sorting by size, indexed by
+	internal index. */
+	std::unordered_map<int, ULONGLONG>	m_cachedFolderSizes;
+
+	/* The folder sizes that are still being calculated,
+	indexed by internal index. The folder is resorted once
+	all of them have been returned. */
+	std::unordered_map<int, FolderSizeResult_t>	m_folderSizeResults;
+	int					m_folderSizeResultIDCounter;
 
 	/* Internal state. */
 	const HINSTANCE		m_hResourceModule;
@@ -471,6 +694,8 @@ private:
 	ULARGE_INTEGER		m_ulFileSelectionSize;
 	BOOL				m_bVirtualFolder;
 	BOOL				m_bFolderVisited;
+	bool				m_folderPending;
+	bool				m_pendingAddHistoryEntry;
 	int					m_nTotalItems;
 	int					m_NumFilesSelected;
 	int					m_NumFoldersSelected;
@@ -486,8 +711,13 @@ private:
 	int					m_uniqueFolderId;
 
 	const Config		*m_config;
+	const ColorRuleMatcher	*m_colorRuleMatcher;
 	FolderSettings		m_folderSettings;
 
+	/* Parsed from the filter in m_folderSettings, so
+	that it doesn't have to be reparsed for each item. */
+	WildcardPattern		m_filterPattern;
+
 	/* ID. */
 	const int			m_ID;
 
@@ -495,9 +725,22 @@ private:
 	have been modified (i.e. created, deleted,
 	renamed, etc). */
 	CRITICAL_SECTION	m_csDirectoryAltered;
-	std::list<AlteredFile_t>	m_AlteredList;
+	ChangeJournal		m_changeJournal;
 	std::list<Added_t>	m_FilesAdded;
 
+	/* Set when some of the change notifications for
+	the folder have been lost, in which case the
+	folder will be compared against its contents on
+	disk. */
+	bool				m_resyncRequired;
+
+	/* The folder's contents are listed in the background
+	when it's resynchronized. Any further changes are held
+	back until the listing has been applied. */
+	std::unique_ptr<TaskScheduler::Queue>	m_resyncTaskQueue;
+	std::unordered_map<int, std::future<boost::optional<std::vector<FolderDiffItem>>>> m_resyncResults;
+	int					m_resyncResultIDCounter;
+
 	/* Stores information on files that have
 	been created and are awaiting insertion
 	into the listview. */
@@ -516,6 +759,18 @@ private:
 	/* Thumbnails. */
 	BOOL				m_bThumbnailsSetup;
 
+	/* Items that don't have a thumbnail (or whose thumbnail
+	hasn't been extracted yet) are shown using their icon.
+	Each of those images is added to the image list once per
+	icon, rather than once per item. Indexed by system icon
+	index. */
+	std::unordered_map<int, int>	m_iconThumbnailImages;
+
+	/* Every thumbnail is drawn onto this surface before being
+	added to the image list. Created when it's first needed. */
+	wil::unique_hdc		m_thumbnailDC;
+	wil::unique_hbitmap	m_thumbnailBitmap;
+
 	/* Column related data. */
 	std::vector<Column_t>	*m_pActiveColumns;
 	FolderColumns		m_folderColumns;
@@ -539,13 +794,30 @@ private:
 	int					m_bOverFolder;
 	int					m_iDropFolder;
 
-	/* Listview groups. The group id is declared
-	explicitly, rather than taken from the size
-	of the group list, to avoid warnings concerning
+	/* Listview groups, indexed by id. Each group can
+	also be looked up by its header. The group id is
+	declared explicitly, rather than taken from the size
+	of the group map, to avoid warnings concerning
 	size_t and int. */
-	std::list<TypeGroup_t>	m_GroupList;
+	std::unordered_map<int, TypeGroup_t>	m_groups;
+	std::unordered_map<std::wstring, int>	m_groupIdsByHeader;
 	int					m_iGroupId;
 
+	/* The number of items in each group. This is shown in
+	each group's header, mimicking the feature available in
+	Windows Vista and later. */
+	GroupItemCounts		m_groupItemCounts;
+
+	/* Items whose groups are being determined in the
+	background are held in this group in the meantime. */
+	boost::optional<int>	m_pendingGroupId;
+
+	/* Group headers that are expensive to determine are
+	retrieved in the background. */
+	std::unique_ptr<TaskScheduler::Queue>	m_groupTaskQueue;
+	std::unordered_map<int, std::future<std::vector<GroupHeaderResult_t>>> m_groupResults;
+	int					m_groupResultIDCounter;
+
 	/* Filtering related data. */
 	std::list<int>		m_FilteredItemsList;
 };
\ No newline at end of file
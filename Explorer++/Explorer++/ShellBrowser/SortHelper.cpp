@@ -4,322 +4,488 @@
 
 #include "stdafx.h"
 #include "SortHelper.h"
+#include "Columns.h"
 #include <wil/common.h>
+#include <propkey.h>
 #include <propvarutil.h>
 
-int SortByName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const GlobalFolderSettings &globalFolderSettings)
+namespace
 {
-	if (itemInfo1.isRoot && !itemInfo2.isRoot)
+	void SetTextKey(SortKey_t &key, std::wstring text)
 	{
-		return -1;
+		key.value = std::move(text);
 	}
-	else if (!itemInfo1.isRoot && itemInfo2.isRoot)
+
+	void SetNumberKey(SortKey_t &key, ULONGLONG number)
 	{
-		return 1;
+		key.value = number;
 	}
-	else if (itemInfo1.isRoot && itemInfo2.isRoot)
+
+	/* Used for columns whose values are expensive to
+	retrieve. If a column cache is provided, the value
+	will be taken from the cache where possible. */
+	void SetCachedTextKey(SortKey_t &key, unsigned int columnId, const BasicItemInfo_t &itemInfo,
+		const GlobalFolderSettings &globalFolderSettings, ColumnCache *columnCache)
 	{
-		/* If the items been compared are both drives,
-		sort by drive letter, rather than display name. */
-		return StrCmpLogicalW(itemInfo1.getFullPath().c_str(), itemInfo2.getFullPath().c_str());
+		ItemColumnContext context(itemInfo, columnCache);
+		SetTextKey(key, GetColumnText(columnId, context, globalFolderSettings));
 	}
 
-	std::wstring Name1 = GetNameColumnText(itemInfo1, globalFolderSettings);
-	std::wstring Name2 = GetNameColumnText(itemInfo2, globalFolderSettings);
-
-	return StrCmpLogicalW(Name1.c_str(), Name2.c_str());
-}
+	ULONGLONG FileTimeToNumber(const FILETIME &fileTime)
+	{
+		ULARGE_INTEGER value = { fileTime.dwLowDateTime, fileTime.dwHighDateTime };
+		return value.QuadPart;
+	}
 
-int SortBySize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	bool IsFolder1 = WI_IsFlagSet(itemInfo1.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY);
-	bool IsFolder2 = WI_IsFlagSet(itemInfo2.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY);
+	void SetNameKey(SortKey_t &key, const BasicItemInfo_t &itemInfo, const GlobalFolderSettings &globalFolderSettings)
+	{
+		/* Drives are always placed before other items and are
+		sorted by drive letter, rather than display name. */
+		if (itemInfo.isRoot)
+		{
+			key.rank = 0;
+			SetTextKey(key, itemInfo.getFullPath());
+			return;
+		}
 
-	ULONGLONG size1;
-	ULONGLONG size2;
+		key.rank = 1;
+		SetTextKey(key, GetNameColumnText(itemInfo, globalFolderSettings));
+	}
 
-	if (IsFolder1 && IsFolder2)
+	void SetTypeKey(SortKey_t &key, const BasicItemInfo_t &itemInfo)
 	{
-		// Temporarily disabled.
-		/*auto itr1 = m_cachedFolderSizes.find(InternalIndex1);
-		auto itr2 = m_cachedFolderSizes.find(InternalIndex2);
+		key.rank = itemInfo.isRoot ? 0 : 1;
+		SetTextKey(key, GetTypeColumnText(itemInfo));
+	}
 
-		if (itr1 == m_cachedFolderSizes.end() && itr2 == m_cachedFolderSizes.end())
-		{
-			return 0;
-		}
-		else if (itr1 != m_cachedFolderSizes.end() && itr2 == m_cachedFolderSizes.end())
-		{
-			return 1;
-		}
-		else if (itr1 == m_cachedFolderSizes.end() && itr2 != m_cachedFolderSizes.end())
+	void SetSizeKey(SortKey_t &key, const BasicItemInfo_t &itemInfo, boost::optional<ULONGLONG> folderSize)
+	{
+		/* Folders don't have a size of their own, so, unless
+		their total size is known, they're sorted by name
+		only. */
+		if (WI_IsFlagSet(itemInfo.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY))
 		{
-			return -1;
+			SetNumberKey(key, folderSize ? *folderSize : 0);
+			return;
 		}
 
-		size1 = itr1->second;
-		size2 = itr2->second;*/
-
-		size1 = 0;
-		size2 = 0;
+		ULARGE_INTEGER fileSize = { itemInfo.wfd.nFileSizeLow, itemInfo.wfd.nFileSizeHigh };
+		SetNumberKey(key, fileSize.QuadPart);
 	}
-	else
+
+	void SetDriveSpaceKey(SortKey_t &key, const BasicItemInfo_t &itemInfo, bool totalSize)
 	{
-		// Both items are files (as opposed to folders).
-		ULARGE_INTEGER FileSize1 = { itemInfo1.wfd.nFileSizeLow, itemInfo1.wfd.nFileSizeHigh };
-		ULARGE_INTEGER FileSize2 = { itemInfo2.wfd.nFileSizeLow, itemInfo2.wfd.nFileSizeHigh };
+		ULARGE_INTEGER driveSpace;
+		BOOL res = GetDriveSpaceColumnRawData(itemInfo, totalSize, driveSpace);
 
-		size1 = FileSize1.QuadPart;
-		size2 = FileSize2.QuadPart;
+		key.rank = res ? 1 : 0;
+		SetNumberKey(key, res ? driveSpace.QuadPart : 0);
 	}
 
-	if (size1 > size2)
+	void SetRealSizeKey(SortKey_t &key, const BasicItemInfo_t &itemInfo)
 	{
-		return 1;
+		ULARGE_INTEGER realFileSize;
+		bool res = GetRealSizeColumnRawData(itemInfo, realFileSize);
+
+		key.rank = res ? 1 : 0;
+		SetNumberKey(key, res ? realFileSize.QuadPart : 0);
 	}
-	else if (size1 < size2)
+
+	void SetHardLinksKey(SortKey_t &key, const BasicItemInfo_t &itemInfo,
+		const GlobalFolderSettings &globalFolderSettings, ColumnCache *columnCache)
 	{
-		return -1;
+		/* The column text is used here (rather than the raw
+		value), so that the number of links can be cached. The
+		text will be empty if the number couldn't be
+		retrieved. */
+		ItemColumnContext context(itemInfo, columnCache);
+		std::wstring numHardLinksText = GetColumnText(CM_HARDLINKS, context, globalFolderSettings);
+		bool res = !numHardLinksText.empty();
+
+		key.rank = res ? 1 : 0;
+		SetNumberKey(key, res ? wcstoul(numHardLinksText.c_str(), nullptr, 10) : 0);
 	}
 
-	return 0;
-}
-
-int SortByType(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	if (itemInfo1.isRoot && !itemInfo2.isRoot)
+	void SetItemDetailsKey(SortKey_t &key, const BasicItemInfo_t &itemInfo, const SHCOLUMNID *pscid)
 	{
-		return -1;
+		wil::unique_variant variant;
+		HRESULT hr = GetItemDetailsRawData(itemInfo, pscid, variant.reset_and_addressof());
+
+		/* Items without a value are placed before those that have
+		one. */
+		key.rank = SUCCEEDED(hr) ? 1 : 0;
+
+		if (FAILED(hr))
+		{
+			variant.reset();
+		}
+
+		key.value = std::move(variant);
 	}
-	else if (!itemInfo1.isRoot && itemInfo2.isRoot)
+
+	int CompareNumbers(ULONGLONG number1, ULONGLONG number2)
 	{
-		return 1;
+		if (number1 > number2)
+		{
+			return 1;
+		}
+		else if (number1 < number2)
+		{
+			return -1;
+		}
+
+		return 0;
 	}
 
-	std::wstring Type1 = GetTypeColumnText(itemInfo1);
-	std::wstring Type2 = GetTypeColumnText(itemInfo2);
+	class CompareValuesVisitor : public boost::static_visitor<int>
+	{
+	public:
+
+		int operator()(ULONGLONG number1, ULONGLONG number2) const
+		{
+			return CompareNumbers(number1, number2);
+		}
+
+		int operator()(const std::wstring &text1, const std::wstring &text2) const
+		{
+			return StrCmpLogicalW(text1.c_str(), text2.c_str());
+		}
+
+		int operator()(const wil::unique_variant &variant1, const wil::unique_variant &variant2) const
+		{
+			/* Values can only be compared directly if their types
+			match. Otherwise, they're ordered by type, so that the
+			resulting ordering is always consistent. */
+			if (variant1.vt != variant2.vt)
+			{
+				return CompareNumbers(variant1.vt, variant2.vt);
+			}
+
+			if (variant1.vt == VT_EMPTY)
+			{
+				return 0;
+			}
+
+			return VariantCompare(variant1, variant2);
+		}
+
+		/* All the keys in a sort are built for the same sort
+		mode, so their values are always of the same kind. */
+		template <typename T1, typename T2>
+		int operator()(const T1 &, const T2 &) const
+		{
+			assert(false);
+			return 0;
+		}
+	};
+
+	int CompareValues(const SortKey_t &key1, const SortKey_t &key2)
+	{
+		if (key1.rank != key2.rank)
+		{
+			return key1.rank < key2.rank ? -1 : 1;
+		}
 
-	return StrCmpLogicalW(Type1.c_str(), Type2.c_str());
+		return boost::apply_visitor(CompareValuesVisitor(), key1.value, key2.value);
+	}
 }
 
-int SortByDate(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, DateType_t DateType)
+/* Also see NBookmarkHelper::Sort. */
+SortKey_t BuildSortKey(SortMode sortMode, int internalIndex, const BasicItemInfo_t &itemInfo,
+	const GlobalFolderSettings &globalFolderSettings, ColumnCache *columnCache,
+	boost::optional<ULONGLONG> folderSize)
 {
-	switch (DateType)
+	SortKey_t key;
+	key.internalIndex = internalIndex;
+	key.isFolder = WI_IsFlagSet(itemInfo.wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY);
+	key.rank = 0;
+	key.value = 0ULL;
+	key.displayName = itemInfo.szDisplayName;
+
+	switch (sortMode)
 	{
-	case DATE_TYPE_CREATED:
-		return CompareFileTime(&itemInfo1.wfd.ftCreationTime, &itemInfo2.wfd.ftCreationTime);
+	case SortMode::Name:
+		SetNameKey(key, itemInfo, globalFolderSettings);
 		break;
 
-	case DATE_TYPE_MODIFIED:
-		return CompareFileTime(&itemInfo1.wfd.ftLastWriteTime, &itemInfo2.wfd.ftLastWriteTime);
+	case SortMode::Type:
+		SetTypeKey(key, itemInfo);
 		break;
 
-	case DATE_TYPE_ACCESSED:
-		return CompareFileTime(&itemInfo1.wfd.ftLastAccessTime, &itemInfo2.wfd.ftLastAccessTime);
+	case SortMode::Size:
+		SetSizeKey(key, itemInfo, folderSize);
 		break;
 
-	default:
-		assert(false);
+	case SortMode::DateModified:
+		SetNumberKey(key, FileTimeToNumber(itemInfo.wfd.ftLastWriteTime));
 		break;
-	}
 
-	return 0;
-}
+	case SortMode::Created:
+		SetNumberKey(key, FileTimeToNumber(itemInfo.wfd.ftCreationTime));
+		break;
 
-int SortByTotalSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, bool TotalSize)
-{
-	ULARGE_INTEGER DriveSpace1;
-	BOOL Res1 = GetDriveSpaceColumnRawData(itemInfo1, TotalSize, DriveSpace1);
+	case SortMode::Accessed:
+		SetNumberKey(key, FileTimeToNumber(itemInfo.wfd.ftLastAccessTime));
+		break;
 
-	ULARGE_INTEGER DriveSpace2;
-	BOOL Res2 = GetDriveSpaceColumnRawData(itemInfo2, TotalSize, DriveSpace2);
+	case SortMode::TotalSize:
+		SetDriveSpaceKey(key, itemInfo, true);
+		break;
 
-	if (Res1 && !Res2)
-	{
-		return 1;
-	}
-	else if (!Res1 && Res2)
-	{
-		return -1;
-	}
-	else if (!Res1 && !Res2)
-	{
-		return 0;
-	}
+	case SortMode::FreeSpace:
+		SetDriveSpaceKey(key, itemInfo, false);
+		break;
 
-	if (DriveSpace1.QuadPart > DriveSpace2.QuadPart)
-	{
-		return 1;
-	}
-	else if (DriveSpace1.QuadPart < DriveSpace2.QuadPart)
-	{
-		return -1;
-	}
+	case SortMode::RealSize:
+		SetRealSizeKey(key, itemInfo);
+		break;
 
-	return 0;
-}
+	case SortMode::HardLinks:
+		SetHardLinksKey(key, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByAttributes(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring AttributeString1 = GetAttributeColumnText(itemInfo1);
-	std::wstring AttributeString2 = GetAttributeColumnText(itemInfo2);
+	case SortMode::DateDeleted:
+		SetItemDetailsKey(key, itemInfo, &SCID_DATE_DELETED);
+		break;
 
-	return StrCmpLogicalW(AttributeString1.c_str(), AttributeString2.c_str());
-}
+	case SortMode::OriginalLocation:
+		SetItemDetailsKey(key, itemInfo, &SCID_ORIGINAL_LOCATION);
+		break;
 
-int SortByRealSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	ULARGE_INTEGER RealFileSize1;
-	bool Res1 = GetRealSizeColumnRawData(itemInfo1, RealFileSize1);
+	case SortMode::Title:
+		SetItemDetailsKey(key, itemInfo, &PKEY_Title);
+		break;
 
-	ULARGE_INTEGER RealFileSize2;
-	bool Res2 = GetRealSizeColumnRawData(itemInfo2, RealFileSize2);
+	case SortMode::Subject:
+		SetItemDetailsKey(key, itemInfo, &PKEY_Subject);
+		break;
 
-	if (Res1 && !Res2)
-	{
-		return 1;
-	}
-	else if (!Res1 && Res2)
-	{
-		return -1;
-	}
-	else if (!Res1 && !Res2)
-	{
-		return 0;
-	}
+	case SortMode::Authors:
+		SetItemDetailsKey(key, itemInfo, &PKEY_Author);
+		break;
 
-	if (RealFileSize1.QuadPart > RealFileSize2.QuadPart)
-	{
-		return 1;
-	}
-	else if (RealFileSize1.QuadPart < RealFileSize2.QuadPart)
-	{
-		return -1;
-	}
+	case SortMode::Keywords:
+		SetItemDetailsKey(key, itemInfo, &PKEY_Keywords);
+		break;
 
-	return 0;
-}
+	case SortMode::Comments:
+		SetItemDetailsKey(key, itemInfo, &PKEY_Comment);
+		break;
 
-int SortByShortName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring ShortName1 = GetShortNameColumnText(itemInfo1);
-	std::wstring ShortName2 = GetShortNameColumnText(itemInfo2);
+	case SortMode::Attributes:
+		SetTextKey(key, GetAttributeColumnText(itemInfo));
+		break;
 
-	return StrCmpLogicalW(ShortName1.c_str(), ShortName2.c_str());
-}
+	case SortMode::ShortName:
+		SetTextKey(key, GetShortNameColumnText(itemInfo));
+		break;
 
-int SortByOwner(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring Owner1 = GetOwnerColumnText(itemInfo1);
-	std::wstring Owner2 = GetOwnerColumnText(itemInfo2);
+	case SortMode::Owner:
+		SetCachedTextKey(key, CM_OWNER, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(Owner1.c_str(), Owner2.c_str());
-}
+	case SortMode::ProductName:
+		SetCachedTextKey(key, CM_PRODUCTNAME, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByVersionInfo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, VersionInfoType_t VersioninfoType)
-{
-	std::wstring VersionInfo1 = GetVersionColumnText(itemInfo1, VersioninfoType);
-	std::wstring VersionInfo2 = GetVersionColumnText(itemInfo2, VersioninfoType);
+	case SortMode::Company:
+		SetCachedTextKey(key, CM_COMPANY, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(VersionInfo1.c_str(), VersionInfo2.c_str());
-}
+	case SortMode::Description:
+		SetCachedTextKey(key, CM_DESCRIPTION, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByShortcutTo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring ResolvedLinkPath1 = GetShortcutToColumnText(itemInfo1);
-	std::wstring ResolvedLinkPath2 = GetShortcutToColumnText(itemInfo2);
+	case SortMode::FileVersion:
+		SetCachedTextKey(key, CM_FILEVERSION, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(ResolvedLinkPath1.c_str(), ResolvedLinkPath2.c_str());
-}
+	case SortMode::ProductVersion:
+		SetCachedTextKey(key, CM_PRODUCTVERSION, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByHardlinks(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	DWORD NumHardLinks1 = GetHardLinksColumnRawData(itemInfo1);
-	DWORD NumHardLinks2 = GetHardLinksColumnRawData(itemInfo2);
+	case SortMode::ShortcutTo:
+		SetTextKey(key, GetShortcutToColumnText(itemInfo));
+		break;
 
-	return NumHardLinks1 - NumHardLinks2;
-}
+	case SortMode::Extension:
+		SetTextKey(key, GetExtensionColumnText(itemInfo));
+		break;
 
-int SortByExtension(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring Extension1 = GetExtensionColumnText(itemInfo1);
-	std::wstring Extension2 = GetExtensionColumnText(itemInfo2);
+	case SortMode::CameraModel:
+		SetCachedTextKey(key, CM_CAMERAMODEL, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(Extension1.c_str(), Extension2.c_str());
-}
+	case SortMode::DateTaken:
+		SetCachedTextKey(key, CM_DATETAKEN, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByItemDetails(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const SHCOLUMNID *pscid)
-{
-	VARIANT vt1;
-	HRESULT hr1 = GetItemDetailsRawData(itemInfo1, pscid, &vt1);
+	case SortMode::Width:
+		SetCachedTextKey(key, CM_WIDTH, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	VARIANT vt2;
-	HRESULT hr2 = GetItemDetailsRawData(itemInfo2, pscid, &vt2);
+	case SortMode::Height:
+		SetCachedTextKey(key, CM_HEIGHT, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	int ret = 0;
+	case SortMode::VirtualComments:
+		SetTextKey(key, GetControlPanelCommentsColumnText(itemInfo));
+		break;
 
-	if (SUCCEEDED(hr1) && SUCCEEDED(hr2) && vt1.vt == vt2.vt)
-	{
-		ret = VariantCompare(vt1, vt2);
-	}
+	case SortMode::FileSystem:
+		SetTextKey(key, GetFileSystemColumnText(itemInfo));
+		break;
 
-	if (SUCCEEDED(hr1))
-	{
-		VariantClear(&vt1);
-	}
+	case SortMode::NumPrinterDocuments:
+		SetTextKey(key, GetPrinterColumnText(itemInfo, PRINTER_INFORMATION_TYPE_NUM_JOBS));
+		break;
 
-	if (SUCCEEDED(hr2))
-	{
-		VariantClear(&vt2);
-	}
+	case SortMode::PrinterStatus:
+		SetTextKey(key, GetPrinterColumnText(itemInfo, PRINTER_INFORMATION_TYPE_STATUS));
+		break;
 
-	return ret;
-}
+	case SortMode::PrinterComments:
+		SetTextKey(key, GetPrinterColumnText(itemInfo, PRINTER_INFORMATION_TYPE_COMMENTS));
+		break;
 
-int SortByImageProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PROPID PropertyId)
-{
-	std::wstring ImageProperty1 = GetImageColumnText(itemInfo1, PropertyId);
-	std::wstring ImageProperty2 = GetImageColumnText(itemInfo2, PropertyId);
+	case SortMode::PrinterLocation:
+		SetTextKey(key, GetPrinterColumnText(itemInfo, PRINTER_INFORMATION_TYPE_LOCATION));
+		break;
 
-	return StrCmpLogicalW(ImageProperty1.c_str(), ImageProperty2.c_str());
-}
+	case SortMode::NetworkAdapterStatus:
+		SetTextKey(key, GetNetworkAdapterColumnText(itemInfo));
+		break;
 
-int SortByVirtualComments(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring Comments1 = GetControlPanelCommentsColumnText(itemInfo1);
-	std::wstring Comments2 = GetControlPanelCommentsColumnText(itemInfo2);
+	case SortMode::MediaBitrate:
+		SetCachedTextKey(key, CM_MEDIA_BITRATE, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(Comments1.c_str(), Comments2.c_str());
-}
+	case SortMode::MediaCopyright:
+		SetCachedTextKey(key, CM_MEDIA_COPYRIGHT, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByFileSystem(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring FileSystemName1 = GetFileSystemColumnText(itemInfo1);
-	std::wstring FileSystemName2 = GetFileSystemColumnText(itemInfo2);
+	case SortMode::MediaDuration:
+		SetCachedTextKey(key, CM_MEDIA_DURATION, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(FileSystemName1.c_str(), FileSystemName2.c_str());
-}
+	case SortMode::MediaProtected:
+		SetCachedTextKey(key, CM_MEDIA_PROTECTED, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByPrinterProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PrinterInformationType_t PrinterInformationType)
-{
-	std::wstring PrinterInformation1 = GetPrinterColumnText(itemInfo1, PrinterInformationType);
-	std::wstring PrinterInformation2 = GetPrinterColumnText(itemInfo2, PrinterInformationType);
+	case SortMode::MediaRating:
+		SetCachedTextKey(key, CM_MEDIA_RATING, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(PrinterInformation1.c_str(), PrinterInformation2.c_str());
-}
+	case SortMode::MediaAlbumArtist:
+		SetCachedTextKey(key, CM_MEDIA_ALBUMARTIST, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-int SortByNetworkAdapterStatus(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2)
-{
-	std::wstring Status1 = GetNetworkAdapterColumnText(itemInfo1);
-	std::wstring Status2 = GetNetworkAdapterColumnText(itemInfo2);
+	case SortMode::MediaAlbum:
+		SetCachedTextKey(key, CM_MEDIA_ALBUM, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaBeatsPerMinute:
+		SetCachedTextKey(key, CM_MEDIA_BEATSPERMINUTE, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaComposer:
+		SetCachedTextKey(key, CM_MEDIA_COMPOSER, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaConductor:
+		SetCachedTextKey(key, CM_MEDIA_CONDUCTOR, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaDirector:
+		SetCachedTextKey(key, CM_MEDIA_DIRECTOR, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaGenre:
+		SetCachedTextKey(key, CM_MEDIA_GENRE, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaLanguage:
+		SetCachedTextKey(key, CM_MEDIA_LANGUAGE, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaBroadcastDate:
+		SetCachedTextKey(key, CM_MEDIA_BROADCASTDATE, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaChannel:
+		SetCachedTextKey(key, CM_MEDIA_CHANNEL, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaStationName:
+		SetCachedTextKey(key, CM_MEDIA_STATIONNAME, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaMood:
+		SetCachedTextKey(key, CM_MEDIA_MOOD, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaParentalRating:
+		SetCachedTextKey(key, CM_MEDIA_PARENTALRATING, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaParentalRatingReason:
+		SetCachedTextKey(key, CM_MEDIA_PARENTALRATINGREASON, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaPeriod:
+		SetCachedTextKey(key, CM_MEDIA_PERIOD, itemInfo, globalFolderSettings, columnCache);
+		break;
 
-	return StrCmpLogicalW(Status1.c_str(), Status2.c_str());
+	case SortMode::MediaProducer:
+		SetCachedTextKey(key, CM_MEDIA_PRODUCER, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaPublisher:
+		SetCachedTextKey(key, CM_MEDIA_PUBLISHER, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaWriter:
+		SetCachedTextKey(key, CM_MEDIA_WRITER, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	case SortMode::MediaYear:
+		SetCachedTextKey(key, CM_MEDIA_YEAR, itemInfo, globalFolderSettings, columnCache);
+		break;
+
+	default:
+		assert(false);
+		break;
+	}
+
+	return key;
 }
 
-int SortByMediaMetadata(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, MediaMetadataType_t MediaMetaDataType)
+int CompareSortKeys(const SortKey_t &key1, const SortKey_t &key2, bool sortFoldersFirst, bool sortAscending)
 {
-	std::wstring MediaMetadata1 = GetMediaMetadataColumnText(itemInfo1, MediaMetaDataType);
-	std::wstring MediaMetadata2 = GetMediaMetadataColumnText(itemInfo2, MediaMetaDataType);
+	int comparisonResult = 0;
 
-	return StrCmpLogicalW(MediaMetadata1.c_str(), MediaMetadata2.c_str());
-}
\ No newline at end of file
+	/* Folders will always be sorted separately from files,
+	except in the recycle bin. */
+	if (sortFoldersFirst && key1.isFolder != key2.isFolder)
+	{
+		comparisonResult = key1.isFolder ? -1 : 1;
+	}
+	else
+	{
+		comparisonResult = CompareValues(key1, key2);
+	}
+
+	if (comparisonResult == 0)
+	{
+		/* By default, items that are equal will be sub-sorted
+		by their display names. */
+		comparisonResult = StrCmpLogicalW(key1.displayName, key2.displayName);
+	}
+
+	if (!sortAscending)
+	{
+		comparisonResult = -comparisonResult;
+	}
+
+	return comparisonResult;
+}
@@ -7,31 +7,47 @@
 #include "ColumnDataRetrieval.h"
 #include "FolderSettings.h"
 #include "ItemData.h"
+#include "SortModes.h"
+#include <boost/variant.hpp>
+#include <wil/resource.h>
+#include <string>
 
-enum DateType_t
+/* Holds the value an item is sorted on for a particular
+sort mode. Keys are extracted once per item, so that
+comparing two items never has to go back to the shell
+(or the file system) to retrieve column data.
+
+Only the value used by the current sort mode is held.
+Text values need their own string, since column text (e.g.
+the type name) isn't stored with the item. Property values
+are kept as variants, as they can only be compared with
+VariantCompare(). */
+struct SortKey_t
 {
-	DATE_TYPE_CREATED,
-	DATE_TYPE_MODIFIED,
-	DATE_TYPE_ACCESSED
+	int internalIndex;
+
+	/* Items are ordered by rank first. This is used, for
+	example, to place drives before other items or items
+	whose value couldn't be retrieved before those whose
+	value could. */
+	int rank;
+
+	bool isFolder;
+
+	boost::variant<ULONGLONG, std::wstring, wil::unique_variant> value;
+
+	/* Items that are otherwise equal are sub-sorted by
+	their display names. This points to the display name
+	in the item info the key was built from, so that
+	name has to outlive the key. */
+	const TCHAR *displayName;
 };
 
-int SortByName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const GlobalFolderSettings &globalFolderSettings);
-int SortBySize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByType(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByDate(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, DateType_t DateType);
-int SortByTotalSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, bool TotalSize);
-int SortByAttributes(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByRealSize(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByShortName(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByOwner(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByVersionInfo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, VersionInfoType_t VersioninfoType);
-int SortByShortcutTo(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByHardlinks(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByExtension(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByItemDetails(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, const SHCOLUMNID *pscid);
-int SortByImageProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PROPID PropertyId);
-int SortByVirtualComments(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByFileSystem(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByPrinterProperty(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, PrinterInformationType_t PrinterInformationType);
-int SortByNetworkAdapterStatus(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2);
-int SortByMediaMetadata(const BasicItemInfo_t &itemInfo1, const BasicItemInfo_t &itemInfo2, MediaMetadataType_t MediaMetaDataType);
\ No newline at end of file
+/* The column cache is optional. If it's provided, it will
+be used for sort modes that are expensive to retrieve.
+If the item is a folder and its total size is provided, it
+will be used when sorting by size. */
+SortKey_t BuildSortKey(SortMode sortMode, int internalIndex, const BasicItemInfo_t &itemInfo,
+	const GlobalFolderSettings &globalFolderSettings, ColumnCache *columnCache = nullptr,
+	boost::optional<ULONGLONG> folderSize = boost::none);
+int CompareSortKeys(const SortKey_t &key1, const SortKey_t &key2, bool sortFoldersFirst, bool sortAscending);
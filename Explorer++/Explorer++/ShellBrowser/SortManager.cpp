@@ -7,14 +7,45 @@
 #include "Config.h"
 #include "SortHelper.h"
 #include "SortModes.h"
+#include "SortedInsertion.h"
 #include "ViewModes.h"
-#include <propkey.h>
-#include <cassert>
+#include "../Helper/FolderSize.h"
+#include <wil/common.h>
+#include <future>
+#include <numeric>
 
 void CShellBrowser::SortFolder(SortMode sortMode)
 {
 	m_folderSettings.sortMode = sortMode;
 
+	if(m_folderSettings.sortMode == +SortMode::Size)
+	{
+		QueueFolderSizesForSort();
+	}
+
+	/* The sort keys are extracted once per item and the
+	items are then sorted in a single pass. The listview
+	itself only needs to compare the resulting positions. */
+	std::vector<int> itemPositions = DetermineSortedPositions();
+
+	/* LVM_SORTITEMS is the only way of reordering the items in
+	a listview that isn't owner data, short of deleting and
+	reinserting each item, which would also lose its state
+	(selection, icon, overlay, position, etc.). The callback
+	is only used to compare two precomputed positions. */
+
+	SendMessage(m_hListView,LVM_SORTITEMS,reinterpret_cast<WPARAM>(&itemPositions),reinterpret_cast<LPARAM>(SortStub));
+
+	/* The row index needs to reflect the new order. */
+	std::vector<int> rows = m_itemRowIndex.GetRows();
+	std::sort(rows.begin(),rows.end(),[&itemPositions] (int internalIndex1,int internalIndex2) {
+		return itemPositions[internalIndex1] < itemPositions[internalIndex2];
+	});
+	m_itemRowIndex.SetRows(std::move(rows));
+
+	/* The items are grouped once they've been sorted, so
+	that any groups determined in the background can find
+	the items in the positions they were queued from. */
 	if(m_folderSettings.showInGroups)
 	{
 		ListView_EnableGroupView(m_hListView,FALSE);
@@ -24,8 +55,6 @@ void CShellBrowser::SortFolder(SortMode sortMode)
 		SetShowInGroups(TRUE);
 	}
 
-	SendMessage(m_hListView,LVM_SORTITEMS,reinterpret_cast<WPARAM>(this),reinterpret_cast<LPARAM>(SortStub));
-
 	/* If in details view, the column sort
 	arrow will need to be changed to reflect
 	the new sorting mode. */
@@ -35,303 +64,236 @@ void CShellBrowser::SortFolder(SortMode sortMode)
 	}
 }
 
-int CALLBACK CShellBrowser::SortStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort)
-{
-	CShellBrowser *pShellBrowser = reinterpret_cast<CShellBrowser *>(lParamSort);
-	return pShellBrowser->Sort(static_cast<int>(lParam1),static_cast<int>(lParam2));
-}
-
-/* Also see NBookmarkHelper::Sort. */
-int CALLBACK CShellBrowser::Sort(int InternalIndex1,int InternalIndex2) const
+/* Returns the sorted position of each item, indexed by the
+item's internal index. */
+std::vector<int> CShellBrowser::DetermineSortedPositions() const
 {
-	int ComparisonResult = 0;
+	std::vector<SortKey_t> sortKeys;
+	sortKeys.reserve(m_itemInfoMap.size());
 
-	BasicItemInfo_t basicItemInfo1 = getBasicItemInfo(InternalIndex1);
-	BasicItemInfo_t basicItemInfo2 = getBasicItemInfo(InternalIndex2);
-
-	bool IsFolder1 = ((basicItemInfo1.wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) ? true : false;
-	bool IsFolder2 = ((basicItemInfo2.wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) ? true : false;
-	
-	/* Folders will always be sorted separately from files,
-	except in the recycle bin. */
-	if(IsFolder1 && !IsFolder2 && !CompareVirtualFolders(CSIDL_BITBUCKET))
+	for(const auto &item : m_itemInfoMap)
 	{
-		ComparisonResult = -1;
+		sortKeys.push_back(BuildItemSortKey(item.first));
 	}
-	else if(!IsFolder1 && IsFolder2 && !CompareVirtualFolders(CSIDL_BITBUCKET))
-	{
-		ComparisonResult = 1;
-	}
-	else
-	{
-		switch(m_folderSettings.sortMode)
-		{
-		case SortMode::Name:
-			ComparisonResult = SortByName(basicItemInfo1, basicItemInfo2, m_config->globalFolderSettings);
-			break;
-
-		case SortMode::Type:
-			ComparisonResult = SortByType(basicItemInfo1,basicItemInfo2);
-			break;
-
-		case SortMode::Size:
-			ComparisonResult = SortBySize(basicItemInfo1,basicItemInfo2);
-			break;
-
-		case SortMode::DateModified:
-			ComparisonResult = SortByDate(basicItemInfo1,basicItemInfo2,DATE_TYPE_MODIFIED);
-			break;
-
-		case SortMode::TotalSize:
-			ComparisonResult = SortByTotalSize(basicItemInfo1,basicItemInfo2,TRUE);
-			break;
-
-		case SortMode::FreeSpace:
-			ComparisonResult = SortByTotalSize(basicItemInfo1,basicItemInfo2,FALSE);
-			break;
-
-		case SortMode::DateDeleted:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2, &SCID_DATE_DELETED);
-			break;
 
-		case SortMode::OriginalLocation:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2, &SCID_ORIGINAL_LOCATION);
-			break;
+	std::vector<size_t> sortedOrder(sortKeys.size());
+	std::iota(sortedOrder.begin(),sortedOrder.end(),0);
 
-		case SortMode::Attributes:
-			ComparisonResult = SortByAttributes(basicItemInfo1, basicItemInfo2);
-			break;
+	bool sortFoldersFirst = !CompareVirtualFolders(CSIDL_BITBUCKET);
+	bool sortAscending = m_folderSettings.sortAscending ? true : false;
 
-		case SortMode::RealSize:
-			ComparisonResult = SortByRealSize(basicItemInfo1, basicItemInfo2);
-			break;
+	std::sort(sortedOrder.begin(),sortedOrder.end(),[&sortKeys,sortFoldersFirst,sortAscending] (size_t index1,size_t index2) {
+		return CompareSortKeys(sortKeys[index1],sortKeys[index2],sortFoldersFirst,sortAscending) < 0;
+	});
 
-		case SortMode::ShortName:
-			ComparisonResult = SortByShortName(basicItemInfo1, basicItemInfo2);
-			break;
+	std::vector<int> itemPositions(m_directoryState.itemIDCounter,0);
 
-		case SortMode::Owner:
-			ComparisonResult = SortByOwner(basicItemInfo1, basicItemInfo2);
-			break;
-
-		case SortMode::ProductName:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_PRODUCT_NAME);
-			break;
-
-		case SortMode::Company:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_COMPANY);
-			break;
-
-		case SortMode::Description:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_DESCRIPTION);
-			break;
-
-		case SortMode::FileVersion:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_FILE_VERSION);
-			break;
-
-		case SortMode::ProductVersion:
-			ComparisonResult = SortByVersionInfo(basicItemInfo1, basicItemInfo2,VERSION_INFO_PRODUCT_VERSION);
-			break;
-
-		case SortMode::ShortcutTo:
-			ComparisonResult = SortByShortcutTo(basicItemInfo1, basicItemInfo2);
-			break;
-
-		case SortMode::HardLinks:
-			ComparisonResult = SortByHardlinks(basicItemInfo1, basicItemInfo2);
-			break;
-
-		case SortMode::Extension:
-			ComparisonResult = SortByExtension(basicItemInfo1,basicItemInfo2);
-			break;
-
-		case SortMode::Created:
-			ComparisonResult = SortByDate(basicItemInfo1,basicItemInfo2,DATE_TYPE_CREATED);
-			break;
-
-		case SortMode::Accessed:
-			ComparisonResult = SortByDate(basicItemInfo1,basicItemInfo2,DATE_TYPE_ACCESSED);
-			break;
-
-		case SortMode::Title:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Title);
-			break;
-
-		case SortMode::Subject:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Subject);
-			break;
+	for(size_t i = 0;i < sortedOrder.size();i++)
+	{
+		itemPositions[sortKeys[sortedOrder[i]].internalIndex] = static_cast<int>(i);
+	}
 
-		case SortMode::Authors:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Author);
-			break;
+	return itemPositions;
+}
 
-		case SortMode::Keywords:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Keywords);
-			break;
+/* Places each of the items waiting to be added into its
+sorted position. The keys for the items already in the
+listview are only built once, with the waiting items then
+being merged in, in a single pass. This is considerably
+cheaper than searching for each item's position separately,
+or adding the items to the end and resorting the entire
+folder. */
+void CShellBrowser::SortAwaitingItems()
+{
+	if(m_AwaitingAddList.empty())
+	{
+		return;
+	}
 
-		case SortMode::Comments:
-			ComparisonResult = SortByItemDetails(basicItemInfo1, basicItemInfo2,&PKEY_Comment);
-			break;
+	if(m_folderSettings.sortMode == +SortMode::Size)
+	{
+		QueueFolderSizesForSort();
+	}
 
-		case SortMode::CameraModel:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagEquipModel);
-			break;
+	int nItems = ListView_GetItemCount(m_hListView);
 
-		case SortMode::DateTaken:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagDateTime);
-			break;
+	std::vector<SortKey_t> existingKeys;
+	existingKeys.reserve(nItems);
 
-		case SortMode::Width:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagImageWidth);
-			break;
+	for(int i = 0;i < nItems;i++)
+	{
+		existingKeys.push_back(BuildItemSortKey(GetItemInternalIndex(i)));
+	}
 
-		case SortMode::Height:
-			ComparisonResult = SortByImageProperty(basicItemInfo1, basicItemInfo2,PropertyTagImageHeight);
-			break;
+	std::vector<SortKey_t> newKeys;
+	newKeys.reserve(m_AwaitingAddList.size());
 
-		case SortMode::VirtualComments:
-			ComparisonResult = SortByVirtualComments(basicItemInfo1, basicItemInfo2);
-			break;
+	for(const auto &awaitingItem : m_AwaitingAddList)
+	{
+		newKeys.push_back(BuildItemSortKey(awaitingItem.iItemInternal));
+	}
 
-		case SortMode::FileSystem:
-			ComparisonResult = SortByFileSystem(basicItemInfo1,basicItemInfo2);
-			break;
+	bool sortFoldersFirst = !CompareVirtualFolders(CSIDL_BITBUCKET);
+	bool sortAscending = m_folderSettings.sortAscending ? true : false;
 
-		case SortMode::NumPrinterDocuments:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_NUM_JOBS);
-			break;
+	auto insertions = MergeSortedInsertions(existingKeys,newKeys,[sortFoldersFirst,sortAscending] (const SortKey_t &key1,const SortKey_t &key2) {
+		return CompareSortKeys(key1,key2,sortFoldersFirst,sortAscending);
+	});
 
-		case SortMode::PrinterStatus:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_STATUS);
-			break;
+	/* The items are inserted one at a time, so they need to
+	be queued in order of their final positions. */
+	std::list<AwaitingAdd_t> sortedAwaitingList;
 
-		case SortMode::PrinterComments:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_COMMENTS);
-			break;
+	for(const auto &insertion : insertions)
+	{
+		AwaitingAdd_t awaitingAdd;
+		awaitingAdd.iItem = insertion.position;
+		awaitingAdd.iItemInternal = newKeys[insertion.batchIndex].internalIndex;
+		awaitingAdd.bPosition = TRUE;
+		awaitingAdd.iAfter = insertion.position - 1;
 
-		case SortMode::PrinterLocation:
-			ComparisonResult = SortByPrinterProperty(basicItemInfo1,basicItemInfo2,PRINTER_INFORMATION_TYPE_LOCATION);
-			break;
+		sortedAwaitingList.push_back(awaitingAdd);
+	}
 
-		case SortMode::NetworkAdapterStatus:
-			ComparisonResult = SortByNetworkAdapterStatus(basicItemInfo1,basicItemInfo2);
-			break;
+	m_AwaitingAddList = std::move(sortedAwaitingList);
+}
 
-		case SortMode::MediaBitrate:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_BITRATE);
-			break;
+int CALLBACK CShellBrowser::SortStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort)
+{
+	auto *itemPositions = reinterpret_cast<const std::vector<int> *>(lParamSort);
+	return (*itemPositions)[lParam1] - (*itemPositions)[lParam2];
+}
 
-		case SortMode::MediaCopyright:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_COPYRIGHT);
-			break;
+SortKey_t CShellBrowser::BuildItemSortKey(int internalIndex) const
+{
+	boost::optional<ULONGLONG> folderSize;
+	auto itr = m_cachedFolderSizes.find(internalIndex);
 
-		case SortMode::MediaDuration:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_DURATION);
-			break;
+	if(itr != m_cachedFolderSizes.end())
+	{
+		folderSize = itr->second;
+	}
 
-		case SortMode::MediaProtected:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PROTECTED);
-			break;
+	SortKey_t key = BuildSortKey(m_folderSettings.sortMode,internalIndex,getBasicItemInfo(internalIndex),
+		m_config->globalFolderSettings,m_columnCache,folderSize);
 
-		case SortMode::MediaRating:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_RATING);
-			break;
+	/* The item info built above is a temporary copy, so the key
+	refers to the display name held with the item instead. */
+	key.displayName = m_itemInfoMap.at(internalIndex).szDisplayName;
 
-		case SortMode::MediaAlbumArtist:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_ALBUM_ARTIST);
-			break;
+	return key;
+}
 
-		case SortMode::MediaAlbum:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_ALBUM_TITLE);
-			break;
+/* When sorting by size, folders are sorted by their total
+size. Calculating those sizes can take a long time, so the
+folder is sorted straight away, using whatever sizes are
+already known, and then resorted once the remaining sizes
+have been calculated in the background. Sizes that were
+previously calculated (e.g. for the size column) are
+remembered by the calculator and will be returned almost
+immediately. */
+void CShellBrowser::QueueFolderSizesForSort()
+{
+	if(!m_folderSizeCalculator || InVirtualFolder())
+	{
+		return;
+	}
 
-		case SortMode::MediaBeatsPerMinute:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_BEATS_PER_MINUTE);
-			break;
+	bool settingsChecked = false;
 
-		case SortMode::MediaComposer:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_COMPOSER);
-			break;
+	for(const auto &item : m_itemInfoMap)
+	{
+		if(!WI_IsFlagSet(item.second.wfd.dwFileAttributes,FILE_ATTRIBUTE_DIRECTORY)
+			|| m_cachedFolderSizes.count(item.first) != 0
+			|| m_folderSizeResults.count(item.first) != 0)
+		{
+			continue;
+		}
 
-		case SortMode::MediaConductor:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_CONDUCTOR);
-			break;
+		BasicItemInfo_t basicItemInfo = getBasicItemInfo(item.first);
 
-		case SortMode::MediaDirector:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_DIRECTOR);
-			break;
+		/* Each of the items is on the same drive, so the
+		settings only need to be checked once. */
+		if(!settingsChecked)
+		{
+			if(!IsFolderSizeEnabled(basicItemInfo,m_config->globalFolderSettings))
+			{
+				return;
+			}
 
-		case SortMode::MediaGenre:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_GENRE);
-			break;
+			settingsChecked = true;
+		}
 
-		case SortMode::MediaLanguage:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_LANGUAGE);
-			break;
+		QueueFolderSizeCalculation(item.first,basicItemInfo.getFullPath());
+	}
+}
 
-		case SortMode::MediaBroadcastDate:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_BROADCASTDATE);
-			break;
+void CShellBrowser::QueueFolderSizeCalculation(int internalIndex,const std::wstring &path)
+{
+	int folderSizeResultID = m_folderSizeResultIDCounter++;
 
-		case SortMode::MediaChannel:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_CHANNEL);
-			break;
+	auto promise = std::make_shared<std::promise<boost::optional<ULONGLONG>>>();
+	auto size = promise->get_future();
 
-		case SortMode::MediaStationName:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_STATIONNAME);
-			break;
+	/* The completion callback is invoked on one of the
+	calculator's threads. It may also run after this object
+	has been destroyed, so it only refers to the listview
+	window (and the message won't be delivered once that's
+	been destroyed). */
+	HWND listView = m_hListView;
 
-		case SortMode::MediaMood:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_MOOD);
-			break;
+	int calculationId = m_folderSizeCalculator->StartCalculation(path,nullptr,
+		[listView,internalIndex,folderSizeResultID,promise] (const FolderSizeCalculator::Totals &totals,bool cancelled) {
+		promise->set_value(cancelled ? boost::none : boost::optional<ULONGLONG>(totals.size));
 
-		case SortMode::MediaParentalRating:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PARENTALRATING);
-			break;
+		PostMessage(listView,WM_APP_FOLDER_SIZE_READY,internalIndex,folderSizeResultID);
+	});
 
-		case SortMode::MediaParentalRatingReason:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PARENTALRATINGREASON);
-			break;
+	m_folderSizeResults[internalIndex] = { folderSizeResultID,calculationId,std::move(size) };
+}
 
-		case SortMode::MediaPeriod:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PERIOD);
-			break;
+void CShellBrowser::ProcessFolderSizeResult(int internalIndex,int folderSizeResultId)
+{
+	auto itr = m_folderSizeResults.find(internalIndex);
 
-		case SortMode::MediaProducer:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PRODUCER);
-			break;
+	if(itr == m_folderSizeResults.end() || itr->second.folderSizeResultId != folderSizeResultId)
+	{
+		/* The folder has changed, or the item has been
+		modified, since this size was requested. */
+		return;
+	}
 
-		case SortMode::MediaPublisher:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_PUBLISHER);
-			break;
+	auto size = itr->second.size.get();
+	m_folderSizeResults.erase(itr);
 
-		case SortMode::MediaWriter:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_WRITER);
-			break;
+	if(!size || m_itemInfoMap.count(internalIndex) == 0)
+	{
+		return;
+	}
 
-		case SortMode::MediaYear:
-			ComparisonResult = SortByMediaMetadata(basicItemInfo1, basicItemInfo2,MEDIAMETADATA_TYPE_YEAR);
-			break;
+	m_cachedFolderSizes[internalIndex] = *size;
 
-		default:
-			assert(false);
-			break;
-		}
+	/* Resorting is relatively expensive, so it's only done
+	once every outstanding size has been returned. */
+	if(!m_folderSizeResults.empty() || m_folderSettings.sortMode != +SortMode::Size)
+	{
+		return;
 	}
 
-	if(ComparisonResult == 0)
+	SortFolder(m_folderSettings.sortMode);
+}
+
+void CShellBrowser::CancelFolderSizeCalculations()
+{
+	if(!m_folderSizeCalculator)
 	{
-		/* By default, items that are equal will be sub-sorted
-		by their display names. */
-		ComparisonResult = StrCmpLogicalW(basicItemInfo1.szDisplayName,
-			basicItemInfo2.szDisplayName);
+		return;
 	}
 
-	if(!m_folderSettings.sortAscending)
+	for(const auto &folderSizeResult : m_folderSizeResults)
 	{
-		ComparisonResult = -ComparisonResult;
+		m_folderSizeCalculator->CancelCalculation(folderSizeResult.second.calculationId);
 	}
 
-	return ComparisonResult;
-}
\ No newline at end of file
+	m_folderSizeResults.clear();
+}
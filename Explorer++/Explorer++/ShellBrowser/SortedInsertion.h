@@ -0,0 +1,91 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+// Returns the position at which a new item should be inserted into a list
+// of items that's already sorted. compareWithItem(i) should compare the
+// new item with the item currently at position i, returning a negative
+// value, zero or a positive value (in the same way as CompareSortKeys()).
+//
+// The new item is placed before the first item it doesn't sort after, so
+// only O(log n) comparisons are needed.
+template <typename CompareWithItem>
+int FindSortedInsertionPosition(int numItems, CompareWithItem compareWithItem)
+{
+	int low = 0;
+	int high = numItems;
+
+	while (low < high)
+	{
+		int mid = low + ((high - low) / 2);
+
+		if (compareWithItem(mid) > 0)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+struct SortedInsertion
+{
+	// The index of the item within the batch that was passed in.
+	size_t batchIndex;
+
+	// The position the item will have once the entire batch has been
+	// inserted.
+	int position;
+};
+
+// Determines where each of a batch of new items should be inserted into a
+// list of items that's already sorted. The batch is sorted by itself and
+// then merged with the existing items in a single pass, so the whole
+// operation is O(n + k log k), rather than O(k log n) comparisons spread
+// across separate searches.
+//
+// The results are returned in order of position. Inserting the items in
+// that order (at the position given for each) leaves the list sorted. As
+// with FindSortedInsertionPosition(), new items are placed before existing
+// items they compare equal to. New items that compare equal to each other
+// keep their relative order from the batch.
+template <typename Key, typename Compare>
+std::vector<SortedInsertion> MergeSortedInsertions(const std::vector<Key> &existingKeys,
+	const std::vector<Key> &newKeys, Compare compare)
+{
+	std::vector<size_t> sortedOrder(newKeys.size());
+	std::iota(sortedOrder.begin(), sortedOrder.end(), 0);
+
+	std::stable_sort(sortedOrder.begin(), sortedOrder.end(), [&newKeys, &compare] (size_t index1, size_t index2) {
+		return compare(newKeys[index1], newKeys[index2]) < 0;
+	});
+
+	std::vector<SortedInsertion> insertions;
+	insertions.reserve(newKeys.size());
+
+	size_t existingIndex = 0;
+
+	for (size_t i = 0; i < sortedOrder.size(); i++)
+	{
+		const Key &newKey = newKeys[sortedOrder[i]];
+
+		while (existingIndex < existingKeys.size() && compare(newKey, existingKeys[existingIndex]) > 0)
+		{
+			existingIndex++;
+		}
+
+		insertions.push_back({ sortedOrder[i], static_cast<int>(existingIndex + i) });
+	}
+
+	return insertions;
+}
@@ -0,0 +1,257 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ThumbnailCache.h"
+#include "CacheFile.h"
+
+ThumbnailCache::ThumbnailCache(std::size_t maxSize) :
+	m_maxSize(maxSize),
+	m_size(0),
+	m_numHits(0),
+	m_numMisses(0)
+{
+
+}
+
+std::shared_ptr<const ThumbnailCache::Thumbnail> ThumbnailCache::Get(const std::wstring &path,
+	std::uint64_t fileSize, std::uint64_t lastWriteTime)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto itr = m_entryMap.find(path);
+
+	if (itr == m_entryMap.end())
+	{
+		m_numMisses++;
+		return nullptr;
+	}
+
+	auto entryItr = itr->second;
+
+	if (entryItr->fileSize != fileSize || entryItr->lastWriteTime != lastWriteTime)
+	{
+		// The item has changed since the thumbnail was extracted.
+		RemoveLocked(entryItr);
+
+		m_numMisses++;
+		return nullptr;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, entryItr);
+
+	m_numHits++;
+	return entryItr->thumbnail;
+}
+
+void ThumbnailCache::Set(const std::wstring &path, std::uint64_t fileSize, std::uint64_t lastWriteTime,
+	std::shared_ptr<const Thumbnail> thumbnail)
+{
+	if (thumbnail->width > static_cast<int>(MAX_THUMBNAIL_DIMENSION)
+		|| thumbnail->height > static_cast<int>(MAX_THUMBNAIL_DIMENSION))
+	{
+		// The cache file wouldn't be loadable if it contained this
+		// thumbnail.
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	InsertLocked({ path, fileSize, lastWriteTime, std::move(thumbnail) }, true);
+	EvictLocked();
+}
+
+void ThumbnailCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_entryMap.clear();
+	m_entries.clear();
+	m_size = 0;
+}
+
+std::size_t ThumbnailCache::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_size;
+}
+
+std::size_t ThumbnailCache::GetMaxSize() const
+{
+	return m_maxSize;
+}
+
+std::size_t ThumbnailCache::GetNumEntries() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+std::uint64_t ThumbnailCache::GetNumHits() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numHits;
+}
+
+std::uint64_t ThumbnailCache::GetNumMisses() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numMisses;
+}
+
+void ThumbnailCache::ResetCounters()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_numHits = 0;
+	m_numMisses = 0;
+}
+
+std::size_t ThumbnailCache::GetEntrySize(const Entry &entry)
+{
+	return (entry.path.size() * sizeof(wchar_t))
+		+ (entry.thumbnail->pixels.size() * sizeof(std::uint32_t))
+		+ ENTRY_OVERHEAD;
+}
+
+void ThumbnailCache::InsertLocked(Entry entry, bool mostRecent)
+{
+	auto existingItr = m_entryMap.find(entry.path);
+
+	if (existingItr != m_entryMap.end())
+	{
+		RemoveLocked(existingItr->second);
+	}
+
+	m_size += GetEntrySize(entry);
+
+	auto itr = m_entries.insert(mostRecent ? m_entries.begin() : m_entries.end(), std::move(entry));
+	m_entryMap.insert({ itr->path, itr });
+}
+
+void ThumbnailCache::RemoveLocked(EntryList::iterator itr)
+{
+	m_size -= GetEntrySize(*itr);
+	m_entryMap.erase(itr->path);
+	m_entries.erase(itr);
+}
+
+void ThumbnailCache::EvictLocked()
+{
+	while (m_size > m_maxSize && !m_entries.empty())
+	{
+		RemoveLocked(std::prev(m_entries.end()));
+	}
+}
+
+std::vector<std::uint8_t> ThumbnailCache::Serialize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<std::uint8_t> data;
+	data.reserve(m_size);
+
+	CacheFileWriter writer(data);
+	writer.Write(FILE_SIGNATURE);
+	writer.Write(FILE_VERSION);
+	writer.Write(static_cast<std::uint32_t>(sizeof(wchar_t)));
+	writer.Write(static_cast<std::uint64_t>(m_entries.size()));
+
+	for (const auto &entry : m_entries)
+	{
+		writer.Write(entry.fileSize);
+		writer.Write(entry.lastWriteTime);
+		writer.WriteString(entry.path);
+		writer.Write(static_cast<std::uint32_t>(entry.thumbnail->width));
+		writer.Write(static_cast<std::uint32_t>(entry.thumbnail->height));
+		writer.WriteBytes(entry.thumbnail->pixels.data(), entry.thumbnail->pixels.size() * sizeof(std::uint32_t));
+	}
+
+	return data;
+}
+
+bool ThumbnailCache::Deserialize(const void *data, std::size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_entryMap.clear();
+	m_entries.clear();
+	m_size = 0;
+
+	CacheFileReader reader(data, size);
+
+	std::uint32_t signature;
+	std::uint32_t version;
+	std::uint32_t charSize;
+	std::uint64_t numEntries;
+
+	if (!reader.Read(signature) || signature != FILE_SIGNATURE
+		|| !reader.Read(version) || version != FILE_VERSION
+		|| !reader.Read(charSize) || charSize != sizeof(wchar_t)
+		|| !reader.Read(numEntries))
+	{
+		return false;
+	}
+
+	for (std::uint64_t i = 0; i < numEntries; i++)
+	{
+		Entry entry;
+		std::uint32_t width;
+		std::uint32_t height;
+
+		bool res = reader.Read(entry.fileSize)
+			&& reader.Read(entry.lastWriteTime)
+			&& reader.ReadString(entry.path)
+			&& reader.Read(width)
+			&& reader.Read(height)
+			&& width > 0 && width <= MAX_THUMBNAIL_DIMENSION
+			&& height > 0 && height <= MAX_THUMBNAIL_DIMENSION;
+
+		std::shared_ptr<Thumbnail> thumbnail;
+
+		if (res)
+		{
+			thumbnail = std::make_shared<Thumbnail>();
+			thumbnail->width = static_cast<int>(width);
+			thumbnail->height = static_cast<int>(height);
+			thumbnail->pixels.resize(static_cast<std::size_t>(width) * height);
+
+			res = reader.ReadBytes(thumbnail->pixels.data(), thumbnail->pixels.size() * sizeof(std::uint32_t));
+		}
+
+		if (!res)
+		{
+			m_entryMap.clear();
+			m_entries.clear();
+			m_size = 0;
+
+			return false;
+		}
+
+		entry.thumbnail = std::move(thumbnail);
+
+		if (m_size + GetEntrySize(entry) > m_maxSize)
+		{
+			// Entries are stored most recently used first, so anything
+			// beyond this point would be evicted anyway.
+			break;
+		}
+
+		InsertLocked(std::move(entry), false);
+	}
+
+	return true;
+}
+
+bool ThumbnailCache::LoadFromFile(const std::wstring &filePath)
+{
+	return LoadCacheFile(filePath, [this] (const void *data, std::size_t size) {
+		return Deserialize(data, size);
+	});
+}
+
+bool ThumbnailCache::SaveToFile(const std::wstring &filePath) const
+{
+	return SaveCacheFile(filePath, Serialize());
+}
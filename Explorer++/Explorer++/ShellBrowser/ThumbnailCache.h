@@ -0,0 +1,117 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Stores the thumbnails that have been extracted for items, so that they
+// don't have to be extracted again when a folder is revisited (in the
+// same tab or in any other tab).
+//
+// Thumbnails are stored as pixel data, rather than as bitmaps, so that a
+// thumbnail can be extracted on one thread and drawn on another without
+// any GDI objects being shared between them.
+//
+// As with the column cache, each thumbnail is stored against the item's
+// full path, along with the size and last write time of the item at the
+// time the thumbnail was extracted. If either of those has changed by the
+// time the thumbnail is next requested, it's discarded.
+//
+// Once the size of the cache reaches the specified limit, the least
+// recently used thumbnails are evicted. The cache can be saved to disk and
+// loaded on the next run.
+//
+// All methods are thread-safe.
+class ThumbnailCache
+{
+public:
+
+	struct Thumbnail
+	{
+		int width;
+		int height;
+
+		// 32-bpp pixels, stored top-down.
+		std::vector<std::uint32_t> pixels;
+	};
+
+	ThumbnailCache(std::size_t maxSize);
+
+	// Returns nullptr if there's no up-to-date thumbnail for the item.
+	// Thumbnails larger than MAX_THUMBNAIL_DIMENSION aren't stored.
+	std::shared_ptr<const Thumbnail> Get(const std::wstring &path, std::uint64_t fileSize,
+		std::uint64_t lastWriteTime);
+	void Set(const std::wstring &path, std::uint64_t fileSize, std::uint64_t lastWriteTime,
+		std::shared_ptr<const Thumbnail> thumbnail);
+	void Clear();
+
+	std::size_t GetSize() const;
+	std::size_t GetMaxSize() const;
+	std::size_t GetNumEntries() const;
+
+	std::uint64_t GetNumHits() const;
+	std::uint64_t GetNumMisses() const;
+	void ResetCounters();
+
+	// Entries are written most recently used first, so that, if the cache
+	// is loaded with a lower size limit, it's the least recently used
+	// entries that are dropped.
+	std::vector<std::uint8_t> Serialize() const;
+
+	// Returns false if the data isn't in the expected format, in which
+	// case the cache will be left empty.
+	bool Deserialize(const void *data, std::size_t size);
+
+	// The file is memory-mapped while it's being read.
+	bool LoadFromFile(const std::wstring &filePath);
+	bool SaveToFile(const std::wstring &filePath) const;
+
+private:
+
+	struct Entry
+	{
+		std::wstring path;
+		std::uint64_t fileSize;
+		std::uint64_t lastWriteTime;
+		std::shared_ptr<const Thumbnail> thumbnail;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	static constexpr std::uint32_t FILE_SIGNATURE = 0x43545845;
+	static constexpr std::uint32_t FILE_VERSION = 1;
+
+	// Thumbnails are only ever extracted at a small size. Anything larger
+	// than this in a cache file indicates that the file is corrupt.
+	static constexpr std::uint32_t MAX_THUMBNAIL_DIMENSION = 1024;
+
+	// An approximation of the memory used by each entry, beyond the path
+	// and pixel data it contains.
+	static constexpr std::size_t ENTRY_OVERHEAD = 128;
+
+	static std::size_t GetEntrySize(const Entry &entry);
+
+	void InsertLocked(Entry entry, bool mostRecent);
+	void RemoveLocked(EntryList::iterator itr);
+	void EvictLocked();
+
+	mutable std::mutex m_mutex;
+
+	const std::size_t m_maxSize;
+	std::size_t m_size;
+
+	// Ordered from most to least recently used.
+	EntryList m_entries;
+	std::unordered_map<std::wstring, EntryList::iterator> m_entryMap;
+
+	std::uint64_t m_numHits;
+	std::uint64_t m_numMisses;
+};
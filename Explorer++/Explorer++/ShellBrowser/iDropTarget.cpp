@@ -9,6 +9,7 @@
 
 #include "stdafx.h"
 #include "ShellBrowser.h"
+#include "FileProgressSink.h"
 #include "ViewModes.h"
 #include "../Helper/DropHandler.h"
 #include "../Helper/FileOperations.h"
@@ -474,6 +475,10 @@ DWORD grfKeyState,POINTL ptl,DWORD *pdwEffect)
 		{
 			CDropHandler *pDropHandler = CDropHandler::CreateNew();
 
+			FileProgressSink *progressSink = FileProgressSink::CreateNew();
+			pDropHandler->SetProgressSink(progressSink);
+			progressSink->Release();
+
 			/* The drop handler will call Release(), so we
 			need to AddRef() here. In the future, this should
 			be switched to an independent class. */
@@ -608,6 +613,12 @@ void CShellBrowser::RepositionLocalFiles(const POINT *ppt)
 				}
 
 				ListView_SortItems(m_hListView,SortTemporaryStub,(LPARAM)this);
+
+				std::vector<int> rows = m_itemRowIndex.GetRows();
+				std::sort(rows.begin(),rows.end(),[this] (int internalIndex1,int internalIndex2) {
+					return SortTemporary(internalIndex1,internalIndex2) < 0;
+				});
+				m_itemRowIndex.SetRows(std::move(rows));
 			}
 			else
 			{
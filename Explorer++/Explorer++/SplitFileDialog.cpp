@@ -8,6 +8,7 @@
 #include "IconResourceLoader.h"
 #include "MainResource.h"
 #include "ResourceHelper.h"
+#include "../Helper/ChecksumManifest.h"
 #include "../Helper/FileOperations.h"
 #include "../Helper/Helper.h"
 #include "../Helper/Macros.h"
@@ -24,10 +25,10 @@
 
 namespace NSplitFileDialog
 {
-	const int		WM_APP_SETTOTALSPLITCOUNT	= WM_APP + 1;
-	const int		WM_APP_SETCURRENTSPLITCOUNT	= WM_APP + 2;
-	const int		WM_APP_SPLITFINISHED		= WM_APP + 3;
-	const int		WM_APP_INPUTFILEINVALID		= WM_APP + 4;
+	const int		WM_APP_SETSPLITPROGRESS		= WM_APP + 1;
+	const int		WM_APP_SPLITFINISHED		= WM_APP + 2;
+
+	const int		SPLIT_PROGRESS_RANGE		= 1000;
 
 	const TCHAR		COUNTER_PATTERN[] = _T("/N");
 
@@ -283,37 +284,12 @@ INT_PTR CSplitFileDialog::OnPrivateMessage(UINT uMsg,WPARAM wParam,LPARAM lParam
 
 	switch(uMsg)
 	{
-	case NSplitFileDialog::WM_APP_SETTOTALSPLITCOUNT:
-		SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_SETRANGE32,0,wParam);
-		break;
-
-	case NSplitFileDialog::WM_APP_SETCURRENTSPLITCOUNT:
+	case NSplitFileDialog::WM_APP_SETSPLITPROGRESS:
 		SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_SETPOS,wParam,0);
 		break;
 
 	case NSplitFileDialog::WM_APP_SPLITFINISHED:
-		OnSplitFinished();
-		break;
-
-	case NSplitFileDialog::WM_APP_INPUTFILEINVALID:
-		{
-			TCHAR szTemp[128];
-			LoadString(GetInstance(),IDS_SPLITFILEDIALOG_INPUTFILEINVALID,
-				szTemp,SIZEOF_ARRAY(szTemp));
-			SetDlgItemText(m_hDlg,IDC_SPLIT_STATIC_MESSAGE,szTemp);
-
-			assert(m_pSplitFile != NULL);
-
-			m_pSplitFile->Release();
-			m_pSplitFile = NULL;
-
-			m_bSplittingFile = false;
-			m_bStopSplitting = false;
-
-			KillTimer(m_hDlg,ELPASED_TIMER_ID);
-
-			SetDlgItemText(m_hDlg,IDOK,m_szOk);
-		}
+		OnSplitFinished(static_cast<FileSplitter::Result>(wParam));
 		break;
 	}
 
@@ -383,9 +359,9 @@ void CSplitFileDialog::OnOk()
 		GetWindowString(hEditOutputDirectory,strOutputDirectory);
 
 		BOOL bTranslated;
-		UINT uSplitSize = GetDlgItemInt(m_hDlg,IDC_SPLIT_EDIT_SIZE,&bTranslated,FALSE);
+		ULONGLONG uSplitSize = GetDlgItemInt(m_hDlg,IDC_SPLIT_EDIT_SIZE,&bTranslated,FALSE);
 
-		if(!bTranslated)
+		if(!bTranslated || uSplitSize == 0)
 		{
 			TCHAR szTemp[128];
 
@@ -431,6 +407,9 @@ void CSplitFileDialog::OnOk()
 		m_pSplitFile = new CSplitFile(m_hDlg,m_strFullFilename,strOutputFilename,
 			strOutputDirectory,uSplitSize);
 
+		SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_SETRANGE32,0,NSplitFileDialog::SPLIT_PROGRESS_RANGE);
+		SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_SETPOS,0,0);
+
 		GetDlgItemText(m_hDlg,IDOK,m_szOk,SIZEOF_ARRAY(m_szOk));
 
 		TCHAR szTemp[64];
@@ -446,6 +425,10 @@ void CSplitFileDialog::OnOk()
 			szTemp,SIZEOF_ARRAY(szTemp));
 		SetDlgItemText(m_hDlg,IDC_SPLIT_STATIC_MESSAGE,szTemp);
 
+		/* As with the merge dialog, the thread holds its own
+		reference to the split object. */
+		m_pSplitFile->AddRef();
+
 		HANDLE hThread = CreateThread(NULL,0,NSplitFileDialog::SplitFileThreadProcStub,
 			reinterpret_cast<LPVOID>(m_pSplitFile),0,NULL);
 		SetThreadPriority(hThread,THREAD_PRIORITY_LOWEST);
@@ -503,21 +486,32 @@ void CSplitFileDialog::OnChangeOutputDirectory()
 	SetDlgItemText(m_hDlg, IDC_SPLIT_EDIT_OUTPUT, parsingName);
 }
 
-void CSplitFileDialog::OnSplitFinished()
+void CSplitFileDialog::OnSplitFinished(FileSplitter::Result result)
 {
-	TCHAR szTemp[64];
+	UINT uMessageId = IDS_SPLITFILEDIALOG_FINISHED;
 
-	if(!m_bStopSplitting)
-	{
-		LoadString(GetInstance(),IDS_SPLITFILEDIALOG_FINISHED,
-			szTemp,SIZEOF_ARRAY(szTemp));
-	}
-	else
+	switch(result)
 	{
-		LoadString(GetInstance(),IDS_SPLITFILEDIALOG_CANCELLED,
-			szTemp,SIZEOF_ARRAY(szTemp));
+	case FileSplitter::Result::Succeeded:
+		break;
+
+	case FileSplitter::Result::Stopped:
+		uMessageId = IDS_SPLITFILEDIALOG_CANCELLED;
+		break;
+
+	case FileSplitter::Result::InputFileInvalid:
+	case FileSplitter::Result::ReadFailed:
+		uMessageId = IDS_SPLITFILEDIALOG_INPUTFILEINVALID;
+		break;
+
+	case FileSplitter::Result::OutputFileInvalid:
+	case FileSplitter::Result::WriteFailed:
+		uMessageId = IDS_MERGE_FILES_OUTPUTFILEINVALID;
+		break;
 	}
 
+	TCHAR szTemp[128];
+	LoadString(GetInstance(),uMessageId,szTemp,SIZEOF_ARRAY(szTemp));
 	SetDlgItemText(m_hDlg,IDC_SPLIT_STATIC_MESSAGE,szTemp);
 
 	assert(m_pSplitFile != NULL);
@@ -530,8 +524,11 @@ void CSplitFileDialog::OnSplitFinished()
 
 	KillTimer(m_hDlg,ELPASED_TIMER_ID);
 
-	int iHighLimit = static_cast<int>(SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_GETRANGE,FALSE,0));
-	SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_SETPOS,iHighLimit,0);
+	if(result == FileSplitter::Result::Succeeded)
+	{
+		int iHighLimit = static_cast<int>(SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_GETRANGE,FALSE,0));
+		SendDlgItemMessage(m_hDlg,IDC_SPLIT_PROGRESS,PBM_SETPOS,iHighLimit,0);
+	}
 
 	SetDlgItemText(m_hDlg,IDOK,m_szOk);
 }
@@ -542,107 +539,59 @@ DWORD WINAPI NSplitFileDialog::SplitFileThreadProcStub(LPVOID pParam)
 
 	CSplitFile *pSplitFile = reinterpret_cast<CSplitFile *>(pParam);
 	pSplitFile->SplitFile();
+	pSplitFile->Release();
 
 	return 0;
 }
 
 CSplitFile::CSplitFile(HWND hDlg,std::wstring strFullFilename,
 	std::wstring strOutputFilename,std::wstring strOutputDirectory,
-	UINT uSplitSize)
+	ULONGLONG uSplitSize) :
+	m_hDlg(hDlg),
+	m_strOutputFilename(strOutputFilename),
+	m_strOutputDirectory(strOutputDirectory),
+	m_fileSplitter(strFullFilename,uSplitSize,[this] (std::uint64_t partNumber) {
+		return ProcessFilename(partNumber);
+	},GetSplitOptions(strFullFilename,strOutputDirectory))
 {
-	m_hDlg					= hDlg;
-	m_strFullFilename		= strFullFilename;
-	m_strOutputFilename		= strOutputFilename;
-	m_strOutputDirectory	= strOutputDirectory;
-	m_uSplitSize			= uSplitSize;
-
-	m_bStopSplitting		= false;
 
-	InitializeCriticalSection(&m_csStop);
 }
 
 CSplitFile::~CSplitFile()
 {
-	DeleteCriticalSection(&m_csStop);
+
 }
 
-void CSplitFile::SplitFile()
+/* The manifest is named after the input file and placed
+alongside the parts, so that the merge dialog can find it. */
+FileSplitter::Options CSplitFile::GetSplitOptions(const std::wstring &strFullFilename,
+	const std::wstring &strOutputDirectory)
 {
-	HANDLE hInputFile = CreateFile(m_strFullFilename.c_str(),GENERIC_READ,
-		FILE_SHARE_READ,NULL,OPEN_EXISTING,0,NULL);
-
-	if(hInputFile == INVALID_HANDLE_VALUE)
-	{
-		PostMessage(m_hDlg,NSplitFileDialog::WM_APP_INPUTFILEINVALID,0,0);
-		return;
-	}
-
-	LARGE_INTEGER lFileSize;
-	GetFileSizeEx(hInputFile,&lFileSize);
-
-	LONGLONG nSplits = lFileSize.QuadPart / m_uSplitSize;
-
-	if((lFileSize.QuadPart % m_uSplitSize) != 0)
-		nSplits++;
-
-	PostMessage(m_hDlg,NSplitFileDialog::WM_APP_SETTOTALSPLITCOUNT,
-		static_cast<WPARAM>(nSplits),0);
-
-	SplitFileInternal(hInputFile,lFileSize);
-
-	CloseHandle(hInputFile);
-
-	SendMessage(m_hDlg,NSplitFileDialog::WM_APP_SPLITFINISHED,0,0);
+	FileSplitter::Options options;
+	options.manifestPath = strOutputDirectory + _T("\\") + PathFindFileName(strFullFilename.c_str())
+		+ ChecksumManifest::FILE_EXTENSION;
+	return options;
 }
 
-void CSplitFile::SplitFileInternal(HANDLE hInputFile,const LARGE_INTEGER &lFileSize)
+void CSplitFile::SplitFile()
 {
-	LARGE_INTEGER lRunningSplitSize = {0};
-
-	char *pBuffer = new char[m_uSplitSize];
-	bool bStop = false;
-	int nSplitsMade = 1;
-
-	while(lRunningSplitSize.QuadPart < lFileSize.QuadPart &&
-		!bStop)
-	{
-		DWORD dwNumberOfBytesRead;
-		ReadFile(hInputFile,reinterpret_cast<LPVOID>(pBuffer),m_uSplitSize,&dwNumberOfBytesRead,NULL);
+	HWND hDlg = m_hDlg;
 
-		std::wstring strOutputFullFilename;
-		ProcessFilename(nSplitsMade,strOutputFullFilename);
+	FileSplitter::Result result = m_fileSplitter.Split([hDlg] (const FileSplitter::Progress &progress) {
+		int position = NSplitFileDialog::SPLIT_PROGRESS_RANGE;
 
-		HANDLE hOutputFile = CreateFile(strOutputFullFilename.c_str(),GENERIC_WRITE,0,NULL,CREATE_NEW,
-			FILE_ATTRIBUTE_NORMAL,NULL);
-
-		if(hOutputFile != INVALID_HANDLE_VALUE)
+		if(progress.totalBytes != 0)
 		{
-			DWORD dwNumberOfBytesWritten;
-			WriteFile(hOutputFile,reinterpret_cast<LPCVOID>(pBuffer),dwNumberOfBytesRead,
-				&dwNumberOfBytesWritten,NULL);
-
-			CloseHandle(hOutputFile);
+			position = static_cast<int>((progress.bytesWritten * NSplitFileDialog::SPLIT_PROGRESS_RANGE) / progress.totalBytes);
 		}
 
-		/* TODO: Wait for a set period of time before sending message
-		(so as not to block the GUI). */
-		PostMessage(m_hDlg,NSplitFileDialog::WM_APP_SETCURRENTSPLITCOUNT,nSplitsMade,0);
-
-		lRunningSplitSize.QuadPart += dwNumberOfBytesRead;
-		nSplitsMade++;
-
-		EnterCriticalSection(&m_csStop);
-		if(m_bStopSplitting)
-		{
-			bStop = true;
-		}
-		LeaveCriticalSection(&m_csStop);
-	}
+		PostMessage(hDlg,NSplitFileDialog::WM_APP_SETSPLITPROGRESS,position,0);
+	});
 
-	delete[] pBuffer;
+	SendMessage(m_hDlg,NSplitFileDialog::WM_APP_SPLITFINISHED,static_cast<WPARAM>(result),0);
 }
 
-void CSplitFile::ProcessFilename(int nSplitsMade,std::wstring &strOutputFullFilename)
+std::wstring CSplitFile::ProcessFilename(ULONGLONG nSplitsMade) const
 {
 	std::wstring strOutputFilename = m_strOutputFilename;
 
@@ -650,14 +599,12 @@ void CSplitFile::ProcessFilename(int nSplitsMade,std::wstring &strOutputFullFile
 	ss << nSplitsMade;
 	strOutputFilename.replace(strOutputFilename.find(NSplitFileDialog::COUNTER_PATTERN),2,ss.str());
 
-	strOutputFullFilename = m_strOutputDirectory + _T("\\") + strOutputFilename;
+	return m_strOutputDirectory + _T("\\") + strOutputFilename;
 }
 
 void CSplitFile::StopSplitting()
 {
-	EnterCriticalSection(&m_csStop);
-	m_bStopSplitting = true;
-	LeaveCriticalSection(&m_csStop);
+	m_fileSplitter.Stop();
 }
 
 CSplitFileDialogPersistentSettings::CSplitFileDialogPersistentSettings() :
@@ -7,6 +7,7 @@
 #include "CoreInterface.h"
 #include "../Helper/BaseDialog.h"
 #include "../Helper/DialogSettings.h"
+#include "../Helper/FileSplitter.h"
 #include "../Helper/ReferenceCount.h"
 #include <list>
 #include <string>
@@ -48,7 +49,7 @@ class CSplitFile : public CReferenceCount
 {
 public:
 	
-	CSplitFile(HWND hDlg,std::wstring strFullFilename,std::wstring strOutputFilename,std::wstring strOutputDirectory,UINT uSplitSize);
+	CSplitFile(HWND hDlg,std::wstring strFullFilename,std::wstring strOutputFilename,std::wstring strOutputDirectory,ULONGLONG uSplitSize);
 	~CSplitFile();
 
 	void	SplitFile();
@@ -56,18 +57,16 @@ public:
 
 private:
 
-	void				SplitFileInternal(HANDLE hInputFile,const LARGE_INTEGER &lFileSize);
-	void				ProcessFilename(int nSplitsMade,std::wstring &strOutputFullFilename);
+	static FileSplitter::Options	GetSplitOptions(const std::wstring &strFullFilename,const std::wstring &strOutputDirectory);
+
+	std::wstring		ProcessFilename(ULONGLONG nSplitsMade) const;
 
 	HWND				m_hDlg;
 
-	std::wstring		m_strFullFilename;
 	std::wstring		m_strOutputFilename;
 	std::wstring		m_strOutputDirectory;
-	UINT				m_uSplitSize;
 
-	CRITICAL_SECTION	m_csStop;
-	bool				m_bStopSplitting;
+	FileSplitter		m_fileSplitter;
 };
 
 class CSplitFileDialog : public CBaseDialog
@@ -124,7 +123,7 @@ private:
 	void	OnOk();
 	void	OnCancel();
 	void	OnChangeOutputDirectory();
-	void	OnSplitFinished();
+	void	OnSplitFinished(FileSplitter::Result result);
 
 	IExplorerplusplus *m_expp;
 
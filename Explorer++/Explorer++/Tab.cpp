@@ -28,8 +28,9 @@ Tab::Tab(IExplorerplusplus *expp, TabNavigationInterface *tabNavigation,
 	}
 
 	m_shellBrowser = CShellBrowser::CreateNew(m_id, expp->GetLanguageModule(),
-		expp->GetMainWindow(), expp->GetCachedIcons(), expp->GetConfig(), tabNavigation,
-		folderSettingsFinal, initialColumns);
+		expp->GetMainWindow(), expp->GetCachedIcons(), expp->GetColumnCache(), expp->GetThumbnailCache(),
+		expp->GetFolderSizeCalculator(), expp->GetTaskScheduler(), expp->GetColorRuleMatcher(), expp->GetConfig(),
+		tabNavigation, folderSettingsFinal, initialColumns);
 
 	m_navigationController = std::make_unique<NavigationController>(m_shellBrowser, tabNavigation);
 }
@@ -41,7 +42,8 @@ Tab::Tab(const PreservedTab &preservedTab, IExplorerplusplus *expp, TabNavigatio
 	m_lockState(preservedTab.lockState)
 {
 	m_shellBrowser = CShellBrowser::CreateNew(m_id, expp->GetLanguageModule(),
-		expp->GetMainWindow(), expp->GetCachedIcons(), expp->GetConfig(),
+		expp->GetMainWindow(), expp->GetCachedIcons(), expp->GetColumnCache(), expp->GetThumbnailCache(),
+		expp->GetFolderSizeCalculator(), expp->GetTaskScheduler(), expp->GetColorRuleMatcher(), expp->GetConfig(),
 		tabNavigation, preservedTab.preservedFolderState.folderSettings, boost::none);
 
 	m_navigationController = std::make_unique<NavigationController>(m_shellBrowser,
@@ -56,7 +56,7 @@ TabContainer::TabContainer(HWND parent, TabNavigationInterface *tabNavigation,
 	m_config(config),
 	m_bTabBeenDragged(FALSE),
 	m_iPreviousTabSelectionId(-1),
-	m_iconFetcher(m_hwnd, cachedIcons),
+	m_iconFetcher(m_hwnd, cachedIcons, expp->GetTaskScheduler()),
 	m_defaultFolderIconSystemImageListIndex(GetDefaultFolderIconIndex())
 {
 	Initialize(parent);
@@ -208,6 +208,14 @@ LRESULT CALLBACK TabContainer::WndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPAR
 			m_bTabBeenDragged = FALSE;
 		}
 		break;
+
+		case WM_TIMER:
+			if (wParam == WARM_UP_TIMER_ID)
+			{
+				OnWarmUpTimer();
+				return 0;
+			}
+			break;
 	}
 
 	return DefSubclassProc(hwnd, uMsg, wParam, lParam);
@@ -574,7 +582,7 @@ LRESULT CALLBACK TabContainer::ParentWndProc(HWND hwnd, UINT uMsg, WPARAM wParam
 			break;
 
 		case TCN_SELCHANGE:
-			tabSelectedSignal.m_signal(GetSelectedTab());
+			OnSelectionChanged(GetSelectedTab());
 			break;
 		}
 		break;
@@ -642,6 +650,110 @@ void TabContainer::OnTabSelected(const Tab &tab)
 	m_iPreviousTabSelectionId = tab.GetId();
 }
 
+// The folder in a deferred tab is browsed before any observers are
+// notified of the selection, since most of them will query the folder
+// that's shown in the tab.
+void TabContainer::OnSelectionChanged(const Tab &tab)
+{
+	BrowsePendingFolder(tab);
+
+	tabSelectedSignal.m_signal(tab);
+}
+
+// The folder in a deferred tab wasn't checked when the tab was created,
+// so it's checked here, as it would be for any other navigation. If the
+// folder can't be browsed (e.g. because it's since been removed), the
+// default folder is shown instead, as it is when a new tab is opened.
+void TabContainer::BrowsePendingFolder(const Tab &tab)
+{
+	CShellBrowser *shellBrowser = tab.GetShellBrowser();
+
+	if (!shellBrowser->HasPendingFolder())
+	{
+		return;
+	}
+
+	auto pidlDirectory = shellBrowser->GetDirectoryIdl();
+	HRESULT hr = E_FAIL;
+
+	if (IsIdlDirectory(pidlDirectory.get()))
+	{
+		hr = shellBrowser->BrowsePendingFolder();
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		return;
+	}
+
+	for (const auto &defaultDirectory : { m_config->defaultTabDirectory, m_config->defaultTabDirectoryStatic })
+	{
+		unique_pidl_absolute pidlDefault;
+		hr = SHParseDisplayName(defaultDirectory.c_str(), nullptr, wil::out_param(pidlDefault), 0, nullptr);
+
+		if (SUCCEEDED(hr) && IsIdlDirectory(pidlDefault.get()))
+		{
+			hr = shellBrowser->BrowseFolder(pidlDefault.get(), true);
+
+			if (SUCCEEDED(hr))
+			{
+				return;
+			}
+		}
+	}
+}
+
+// Browses the folder in one of the tabs whose navigation was deferred.
+// Timer messages are only generated when there are no other messages
+// waiting, but the user may still be in the middle of something, so
+// this also waits for a period without any input.
+void TabContainer::OnWarmUpTimer()
+{
+	LASTINPUTINFO lastInputInfo;
+	lastInputInfo.cbSize = sizeof(lastInputInfo);
+
+	if (GetLastInputInfo(&lastInputInfo)
+		&& (GetTickCount() - lastInputInfo.dwTime) < WARM_UP_IDLE_TIME)
+	{
+		return;
+	}
+
+	int numTabs = GetNumTabs();
+	int selectedIndex = (std::max)(GetSelectedTabIndex(), 0);
+
+	// The tabs closest to the selected tab are the most likely to be
+	// selected next, so they're browsed first.
+	for (int offset = 0; offset < numTabs; offset++)
+	{
+		for (int index : { selectedIndex + offset, selectedIndex - offset })
+		{
+			if (index < 0 || index >= numTabs)
+			{
+				continue;
+			}
+
+			CShellBrowser *shellBrowser = GetTabByIndex(index).GetShellBrowser();
+
+			if (!shellBrowser->HasPendingFolder())
+			{
+				continue;
+			}
+
+			BrowsePendingFolder(GetTabByIndex(index));
+
+			// If neither the folder nor the default folder could be
+			// browsed, the tab is skipped, so that the remaining tabs can
+			// still be browsed. It will be tried again once it's selected.
+			if (!shellBrowser->HasPendingFolder())
+			{
+				return;
+			}
+		}
+	}
+
+	KillTimer(m_hwnd, WARM_UP_TIMER_ID);
+}
+
 void TabContainer::OnAlwaysShowTabBarUpdated(BOOL newValue)
 {
 	if (newValue)
@@ -850,7 +962,12 @@ HRESULT TabContainer::CreateNewTab(PCIDLIST_ABSOLUTE pidlDirectory,
 	const TabSettings &tabSettings, const FolderSettings *folderSettings,
 	boost::optional<FolderColumns> initialColumns, int *newTabId)
 {
-	if (!CheckIdl(pidlDirectory) || !IsIdlDirectory(pidlDirectory))
+	// Checking whether the item is a directory may mean contacting a
+	// remote server. For deferred tabs, that's left until the folder is
+	// actually browsed.
+	bool deferNavigation = tabSettings.deferNavigation.value_or(false);
+
+	if (!CheckIdl(pidlDirectory) || (!deferNavigation && !IsIdlDirectory(pidlDirectory)))
 	{
 		return E_FAIL;
 	}
@@ -932,13 +1049,23 @@ HRESULT TabContainer::SetUpNewTab(Tab &tab, PCIDLIST_ABSOLUTE pidlDirectory,
 		tabNavigationCompletedSignal.m_signal(tab);
 	});
 
-	HRESULT hr = tab.GetShellBrowser()->BrowseFolder(pidlDirectory, addHistoryEntry);
+	if (!selected && tabSettings.deferNavigation.value_or(false))
+	{
+		tab.GetShellBrowser()->SetPendingFolder(pidlDirectory, addHistoryEntry);
+		SetTabIcon(tab);
 
-	if (hr != S_OK)
+		SetTimer(m_hwnd, WARM_UP_TIMER_ID, WARM_UP_TIMER_INTERVAL, nullptr);
+	}
+	else
 	{
-		/* Folder was not browsed. Likely that the path does not exist
-		(or is locked, cannot be found, etc). */
-		return E_FAIL;
+		HRESULT hr = tab.GetShellBrowser()->BrowseFolder(pidlDirectory, addHistoryEntry);
+
+		if (hr != S_OK)
+		{
+			/* Folder was not browsed. Likely that the path does not exist
+			(or is locked, cannot be found, etc). */
+			return E_FAIL;
+		}
 	}
 
 	if (selected)
@@ -947,7 +1074,7 @@ HRESULT TabContainer::SetUpNewTab(Tab &tab, PCIDLIST_ABSOLUTE pidlDirectory,
 
 		if (previousIndex != -1)
 		{
-			tabSelectedSignal.m_signal(tab);
+			OnSelectionChanged(tab);
 		}
 	}
 
@@ -1143,7 +1270,7 @@ void TabContainer::SelectTabAtIndex(int index)
 		return;
 	}
 
-	tabSelectedSignal.m_signal(GetTabByIndex(index));
+	OnSelectionChanged(GetTabByIndex(index));
 }
 
 Tab &TabContainer::GetSelectedTab()
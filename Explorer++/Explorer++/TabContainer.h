@@ -28,6 +28,7 @@ BOOST_PARAMETER_NAME(name)
 BOOST_PARAMETER_NAME(index)
 BOOST_PARAMETER_NAME(selected)
 BOOST_PARAMETER_NAME(lockState)
+BOOST_PARAMETER_NAME(deferNavigation)
 
 // The use of Boost Parameter here allows values to be set by name
 // during construction. It would be better (and simpler) for this to be
@@ -42,12 +43,18 @@ struct TabSettingsImpl
 		lockState = args[_lockState | boost::none];
 		index = args[_index | boost::none];
 		selected = args[_selected | boost::none];
+		deferNavigation = args[_deferNavigation | boost::none];
 	}
 
 	boost::optional<std::wstring> name;
 	boost::optional<Tab::LockState> lockState;
 	boost::optional<int> index;
 	boost::optional<bool> selected;
+
+	// If set, the folder won't be browsed until the tab is first
+	// selected (or until the application is idle). Has no effect on a
+	// tab that's selected when it's created.
+	boost::optional<bool> deferNavigation;
 };
 
 // Used when creating a tab.
@@ -62,6 +69,7 @@ struct TabSettings : TabSettingsImpl
 			(lockState, (Tab::LockState))
 			(index, (int))
 			(selected, (bool))
+			(deferNavigation, (bool))
 		)
 	)
 };
@@ -121,6 +129,13 @@ private:
 
 	static const int ICON_SIZE_96DPI = 16;
 
+	static const UINT_PTR WARM_UP_TIMER_ID = 100;
+	static const UINT WARM_UP_TIMER_INTERVAL = 250;
+
+	// Tabs with a deferred navigation will only be browsed in the
+	// background once there's been no input for at least this long.
+	static const DWORD WARM_UP_IDLE_TIME = 2000;
+
 	TabContainer(HWND parent, TabNavigationInterface *tabNavigation, Navigation *navigation,
 		IExplorerplusplus *expp, CachedIcons *cachedIcons, HINSTANCE instance,
 		std::shared_ptr<Config> config);
@@ -168,6 +183,10 @@ private:
 	void OnTabRemoved(int tabId);
 
 	void OnTabSelected(const Tab &tab);
+	void OnSelectionChanged(const Tab &tab);
+	void BrowsePendingFolder(const Tab &tab);
+
+	void OnWarmUpTimer();
 
 	void OnAlwaysShowTabBarUpdated(BOOL newValue);
 	void OnForceSameTabWidthUpdated(BOOL newValue);
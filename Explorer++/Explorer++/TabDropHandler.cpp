@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include <list>
 #include "TabDropHandler.h"
+#include "FileProgressSink.h"
 #include "../Helper/ShellHelper.h"
 #include "../Helper/Macros.h"
 
@@ -262,10 +263,14 @@ HRESULT __stdcall CTabDropHandler::Drop(IDataObject *pDataObject,DWORD grfKeySta
 
 		std::wstring destDirectory = tab.GetShellBrowser()->GetDirectory();
 
+		FileProgressSink *progressSink = FileProgressSink::CreateNew();
+
 		CDropHandler *pDropHandler = CDropHandler::CreateNew();
+		pDropHandler->SetProgressSink(progressSink);
 		pDropHandler->Drop(pDataObject, grfKeyState, pt, pdwEffect, m_hTabCtrl,
 			m_DragType, destDirectory.data(), NULL, FALSE);
 		pDropHandler->Release();
+		progressSink->Release();
 	}
 
 	m_pDropTargetHelper->Drop(pDataObject,reinterpret_cast<POINT *>(&pt),*pdwEffect);
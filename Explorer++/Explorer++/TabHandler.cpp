@@ -15,6 +15,7 @@
 #include "../Helper/Helper.h"
 #include "../Helper/iDirectoryMonitor.h"
 #include "../Helper/ListViewHelper.h"
+#include "../Helper/Logging.h"
 #include "../Helper/Macros.h"
 #include "../Helper/MenuHelper.h"
 #include "../Helper/ShellHelper.h"
@@ -22,6 +23,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <algorithm>
+#include <chrono>
 #include <list>
 
 static const UINT TAB_WINDOW_HEIGHT_96DPI = 24;
@@ -119,6 +121,8 @@ HRESULT Explorerplusplus::RestoreTabs(ILoadSave *pLoadSave)
 	HRESULT							hr;
 	int								nTabsCreated = 0;
 
+	auto startTime = std::chrono::steady_clock::now();
+
 	if(!g_commandLineDirectories.empty())
 	{
 		for(const auto &strDirectory : g_commandLineDirectories)
@@ -188,6 +192,10 @@ HRESULT Explorerplusplus::RestoreTabs(ILoadSave *pLoadSave)
 	was last closed. */
 	m_tabContainer->SelectTabAtIndex(m_iLastSelectedTab);
 
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - startTime);
+	LOG(info) << _T("Restored ") << nTabsCreated << _T(" tab(s) in ") << duration.count() << _T("ms");
+
 	return S_OK;
 }
 
@@ -199,6 +207,13 @@ void Explorerplusplus::OnTabSelected(const Tab &tab)
 	m_hActiveListView = tab.GetShellBrowser()->GetListView();
 	m_pActiveShellBrowser = tab.GetShellBrowser();
 
+	/* Background work for the selected tab takes priority
+	over work for any of the other tabs. */
+	for(const auto &item : m_tabContainer->GetAllTabs())
+	{
+		item.second->GetShellBrowser()->SetTasksActive(item.first == tab.GetId());
+	}
+
 	/* The selected tab has changed, so update the current
 	directory. Although this is not needed internally, context
 	menu extensions may need the current directory to be
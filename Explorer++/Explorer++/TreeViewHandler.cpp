@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "Explorer++.h"
 #include "Config.h"
+#include "FileProgressSink.h"
 #include "HolderWindow.h"
 #include "MainResource.h"
 #include "MainToolbar.h"
@@ -45,7 +46,7 @@ void Explorerplusplus::CreateFolderControls(void)
 	SetWindowTheme(m_hTreeView,L"Explorer",NULL);
 
 	SetWindowLongPtr(m_hTreeView,GWL_EXSTYLE,WS_EX_CLIENTEDGE);
-	m_pMyTreeView = new CMyTreeView(m_hTreeView, m_hHolder, m_pDirMon, &m_cachedIcons);
+	m_pMyTreeView = new CMyTreeView(m_hTreeView, m_hHolder, m_pDirMon, &m_cachedIcons, &m_taskScheduler);
 
 	/* Now, subclass the treeview again. This is needed for messages
 	such as WM_MOUSEWHEEL, which need to be intercepted before they
@@ -686,7 +687,10 @@ void Explorerplusplus::OnTreeViewPaste(void)
 
 		if(hr == S_OK)
 		{
+			FileProgressSink *progressSink = FileProgressSink::CreateNew();
+
 			CDropHandler *pDropHandler = CDropHandler::CreateNew();
+			pDropHandler->SetProgressSink(progressSink);
 
 			auto pidl = m_pMyTreeView->GetItemPidl(hItem);
 
@@ -700,6 +704,7 @@ void Explorerplusplus::OnTreeViewPaste(void)
 				!m_config->overwriteExistingFilesConfirmation);
 
 			pDropHandler->Release();
+			progressSink->Release();
 			pClipboardObject->Release();
 		}
 	}
@@ -12,6 +12,7 @@
 #include "../Helper/ListViewHelper.h"
 #include "../Helper/Macros.h"
 #include "../Helper/RegistrySettings.h"
+#include "../Helper/StringHelper.h"
 #include "../Helper/XMLSettings.h"
 
 const TCHAR CWildcardSelectDialogPersistentSettings::SETTINGS_KEY[] = _T("WildcardSelect");
@@ -145,12 +146,14 @@ void CWildcardSelectDialog::SelectItems(TCHAR *szPattern)
 
 	int nItems = ListView_GetItemCount(hListView);
 
+	WildcardPattern pattern(szPattern, false);
+
 	for(int i = 0;i < nItems;i++)
 	{
 		TCHAR szFilename[MAX_PATH];
 		m_pexpp->GetActiveShellBrowser()->GetItemDisplayName(i,SIZEOF_ARRAY(szFilename),szFilename);
 
-		if(CheckWildcardMatch(szPattern,szFilename,FALSE) == 1)
+		if(pattern.Matches(szFilename))
 		{
 			NListView::ListView_SelectItem(hListView,i,m_bSelect);
 		}
@@ -109,6 +109,9 @@ will need to be changed correspondingly. */
 #define HASH_LARGETOOLBARICONS		10895007
 #define HASH_PLAYNAVIGATIONSOUND	1987363412
 #define HASH_ICON_THEME				3998265761
+#define HASH_COLUMNCACHESIZE		641293058
+#define HASH_THUMBNAILCACHESIZE		3178542232
+#define HASH_SAVETHUMBNAILCACHE		3379268684
 
 struct ColumnXMLSaveData
 {
@@ -605,6 +608,17 @@ IXMLDOMElement *pRoot)
 	_itow_s(m_config->treeViewWidth,szValue,SIZEOF_ARRAY(szValue),10);
 	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("TreeViewWidth"),szValue);
 
+	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
+	_ultow_s(m_config->columnCacheSize,szValue,SIZEOF_ARRAY(szValue),10);
+	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("ColumnCacheSize"),szValue);
+
+	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
+	_ultow_s(m_config->thumbnailCacheSize,szValue,SIZEOF_ARRAY(szValue),10);
+	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("ThumbnailCacheSize"),szValue);
+
+	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
+	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("SaveThumbnailCache"),NXMLSettings::EncodeBoolValue(m_config->saveThumbnailCache));
+
 	NXMLSettings::AddWhiteSpaceToNode(pXMLDom,bstr_wsntt,pe);
 	_itow_s(m_config->defaultFolderSettings.viewMode,szValue,SIZEOF_ARRAY(szValue),10);
 	NXMLSettings::WriteStandardSetting(pXMLDom,pe,_T("Setting"),_T("ViewModeGlobal"),szValue);
@@ -670,7 +684,7 @@ int Explorerplusplus::LoadTabSettingsFromXML(IXMLDOMDocument *pXMLDom)
 				if(SUCCEEDED(hr))
 				{
 					tabSettings.index = i;
-					tabSettings.selected = true;
+					tabSettings.deferNavigation = true;
 
 					/* Retrieve the total number of attributes
 					attached to this node. */
@@ -1715,6 +1729,18 @@ WCHAR *wszName,WCHAR *wszValue)
 		m_config->treeViewWidth = NXMLSettings::DecodeIntValue(wszValue);
 		break;
 
+	case HASH_COLUMNCACHESIZE:
+		m_config->columnCacheSize = NXMLSettings::DecodeIntValue(wszValue);
+		break;
+
+	case HASH_THUMBNAILCACHESIZE:
+		m_config->thumbnailCacheSize = NXMLSettings::DecodeIntValue(wszValue);
+		break;
+
+	case HASH_SAVETHUMBNAILCACHE:
+		m_config->saveThumbnailCache = NXMLSettings::DecodeBoolValue(wszValue);
+		break;
+
 	case HASH_VIEWMODEGLOBAL:
 		m_config->defaultFolderSettings.viewMode = ViewMode::_from_integral(NXMLSettings::DecodeIntValue(wszValue));
 		break;
@@ -140,6 +140,7 @@
 #define IDS_TOOLBAR_MERGE_FILES         323
 #define IDS_TOOLBAR_CLOSE_TAB           324
 #define IDS_NO_RECENT_TABS              325
+#define IDS_GROUPBY_PENDING             326
 #define IDC_DEFAULTCOLUMNS_DESCRIPTION  1001
 #define IDC_COLUMNS_DESCRIPTION         1001
 #define IDC_SETTINGS_CHECK_EXTENSIONS   1002
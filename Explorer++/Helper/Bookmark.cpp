@@ -237,7 +237,10 @@ CBookmarkFolder CBookmarkFolder::UnserializeFromRegistry(const std::wstring &str
 	return CBookmarkFolder(strKey,INITIALIZATION_TYPE_REGISTRY, NULL);
 }
 
-CBookmarkFolder::CBookmarkFolder(const std::wstring &str,InitializationType_t InitializationType,GUID *guid)
+CBookmarkFolder::CBookmarkFolder(const std::wstring &str,InitializationType_t InitializationType,GUID *guid) :
+	m_pParent(NULL),
+	m_pIndex(std::make_unique<ItemIndex_t>()),
+	m_nChildFolders(0)
 {
 	switch(InitializationType)
 	{
@@ -251,6 +254,43 @@ CBookmarkFolder::CBookmarkFolder(const std::wstring &str,InitializationType_t In
 	}
 }
 
+/* Only folders that haven't yet been inserted into
+another folder should be moved. */
+CBookmarkFolder::CBookmarkFolder(CBookmarkFolder &&other) :
+	m_guid(other.m_guid),
+	m_strName(std::move(other.m_strName)),
+	m_pParent(NULL),
+	m_pIndex(std::move(other.m_pIndex)),
+	m_nChildFolders(other.m_nChildFolders),
+	m_ftCreated(other.m_ftCreated),
+	m_ftModified(other.m_ftModified),
+	m_ChildList(std::move(other.m_ChildList))
+{
+	assert(other.m_pParent == NULL);
+
+	/* The children themselves don't move (they're still
+	held in the same list nodes), but they now belong to
+	this object. */
+	for(auto itr = m_ChildList.begin();itr != m_ChildList.end();++itr)
+	{
+		GUID guid;
+
+		if(CBookmarkFolder *pBookmarkFolder = boost::get<CBookmarkFolder>(&*itr))
+		{
+			pBookmarkFolder->m_pParent = this;
+			guid = pBookmarkFolder->GetGUID();
+		}
+		else
+		{
+			guid = boost::get<CBookmark>(*itr).GetGUID();
+		}
+
+		(*m_pIndex)[guid].pParent = this;
+	}
+
+	other.m_nChildFolders = 0;
+}
+
 void CBookmarkFolder::Initialize(const std::wstring &strName,GUID *guid)
 {
 	if(guid != NULL)
@@ -263,7 +303,6 @@ void CBookmarkFolder::Initialize(const std::wstring &strName,GUID *guid)
 	}
 
 	m_strName = strName;
-	m_nChildFolders = 0;
 
 	GetSystemTimeAsFileTime(&m_ftCreated);
 
@@ -302,13 +341,11 @@ void CBookmarkFolder::InitializeFromRegistry(const std::wstring &strKey)
 
 			if(CheckWildcardMatch(_T("BookmarkFolder_*"),szSubKeyName,FALSE))
 			{
-				CBookmarkFolder BookmarkFolder = CBookmarkFolder::UnserializeFromRegistry(szSubKey);
-				m_ChildList.push_back(BookmarkFolder);
+				AddChild(CBookmarkFolder::UnserializeFromRegistry(szSubKey),m_ChildList.size());
 			}
 			else if(CheckWildcardMatch(_T("Bookmark_*"),szSubKeyName,FALSE))
 			{
-				CBookmark bookmark = CBookmark::UnserializeFromRegistry(szSubKey);
-				m_ChildList.push_back(bookmark);
+				AddChild(CBookmark::UnserializeFromRegistry(szSubKey),m_ChildList.size());
 			}
 
 			dwSize = SIZEOF_ARRAY(szSubKeyName);
@@ -338,7 +375,7 @@ void CBookmarkFolder::SerializeToRegistry(const std::wstring &strKey)
 
 		int iItem = 0;
 
-		for(auto Variant : m_ChildList)
+		for(auto &Variant : m_ChildList)
 		{
 			TCHAR szSubKey[256];
 
@@ -401,45 +438,177 @@ void CBookmarkFolder::InsertBookmark(const CBookmark &Bookmark)
 
 void CBookmarkFolder::InsertBookmark(const CBookmark &Bookmark,std::size_t Position)
 {
-	if(Position > (m_ChildList.size() - 1))
+	VariantBookmark &variantBookmark = AddChild(Bookmark,Position);
+
+	GetSystemTimeAsFileTime(&m_ftModified);
+
+	CBookmarkItemNotifier::GetInstance().NotifyObserversBookmarkAdded(*this,
+		boost::get<CBookmark>(variantBookmark),Position);
+}
+
+void CBookmarkFolder::InsertBookmarkFolder(CBookmarkFolder &&BookmarkFolder)
+{
+	InsertBookmarkFolder(std::move(BookmarkFolder),m_ChildList.size());
+}
+
+void CBookmarkFolder::InsertBookmarkFolder(CBookmarkFolder &&BookmarkFolder,std::size_t Position)
+{
+	VariantBookmark &variantBookmark = AddChild(std::move(BookmarkFolder),Position);
+
+	GetSystemTimeAsFileTime(&m_ftModified);
+
+	CBookmarkItemNotifier::GetInstance().NotifyObserversBookmarkFolderAdded(*this,
+		boost::get<CBookmarkFolder>(variantBookmark),Position);
+}
+
+VariantBookmark &CBookmarkFolder::AddChild(VariantBookmark &&variantBookmark,std::size_t Position)
+{
+	auto itr = m_ChildList.begin();
+	std::advance(itr,(std::min)(Position,m_ChildList.size()));
+	itr = m_ChildList.insert(itr,std::move(variantBookmark));
+
+	ItemIndex_t &index = GetIndex();
+	GUID guid;
+
+	if(CBookmarkFolder *pBookmarkFolder = boost::get<CBookmarkFolder>(&*itr))
 	{
-		m_ChildList.push_back(Bookmark);
+		/* The folder is now part of this tree, so the items
+		within it are recorded in this tree's index. */
+		pBookmarkFolder->m_pParent = this;
+		index.insert(pBookmarkFolder->m_pIndex->begin(),pBookmarkFolder->m_pIndex->end());
+		pBookmarkFolder->m_pIndex.reset();
+
+		m_nChildFolders++;
+
+		guid = pBookmarkFolder->GetGUID();
 	}
 	else
 	{
-		auto itr = m_ChildList.begin();
-		std::advance(itr,Position);
-		m_ChildList.insert(itr,Bookmark);
+		guid = boost::get<CBookmark>(*itr).GetGUID();
+	}
+
+	index[guid] = {itr,this};
+
+	return *itr;
+}
+
+bool CBookmarkFolder::RemoveBookmarkItem(const GUID &guid)
+{
+	ItemIndex_t &index = GetIndex();
+	auto itrIndex = index.find(guid);
+
+	if(itrIndex == index.end() || itrIndex->second.pParent != this)
+	{
+		return false;
+	}
+
+	auto itr = itrIndex->second.itr;
+	index.erase(itrIndex);
+
+	bool bFolder = false;
+
+	if(const CBookmarkFolder *pBookmarkFolder = boost::get<CBookmarkFolder>(&*itr))
+	{
+		pBookmarkFolder->RemoveFromIndex(index);
+		m_nChildFolders--;
+		bFolder = true;
 	}
 
+	m_ChildList.erase(itr);
+
 	GetSystemTimeAsFileTime(&m_ftModified);
 
-	CBookmarkItemNotifier::GetInstance().NotifyObserversBookmarkAdded(*this,Bookmark,Position);
+	if(bFolder)
+	{
+		CBookmarkItemNotifier::GetInstance().NotifyObserversBookmarkFolderRemoved(guid);
+	}
+	else
+	{
+		CBookmarkItemNotifier::GetInstance().NotifyObserversBookmarkRemoved(guid);
+	}
+
+	return true;
 }
 
-void CBookmarkFolder::InsertBookmarkFolder(const CBookmarkFolder &BookmarkFolder)
+void CBookmarkFolder::RemoveFromIndex(ItemIndex_t &index) const
 {
-	InsertBookmarkFolder(BookmarkFolder,m_ChildList.size());
+	for(const auto &variantBookmark : m_ChildList)
+	{
+		if(const CBookmarkFolder *pBookmarkFolder = boost::get<CBookmarkFolder>(&variantBookmark))
+		{
+			index.erase(pBookmarkFolder->GetGUID());
+			pBookmarkFolder->RemoveFromIndex(index);
+		}
+		else
+		{
+			index.erase(boost::get<CBookmark>(variantBookmark).GetGUID());
+		}
+	}
+}
+
+CBookmarkFolder *CBookmarkFolder::GetParent() const
+{
+	return m_pParent;
 }
 
-void CBookmarkFolder::InsertBookmarkFolder(const CBookmarkFolder &BookmarkFolder,std::size_t Position)
+VariantBookmark *CBookmarkFolder::FindItem(const GUID &guid)
 {
-	if(Position > (m_ChildList.size() - 1))
+	ItemIndex_t &index = GetIndex();
+	auto itr = index.find(guid);
+
+	if(itr == index.end())
 	{
-		m_ChildList.push_back(BookmarkFolder);
+		return NULL;
 	}
-	else
+
+	return &*itr->second.itr;
+}
+
+const VariantBookmark *CBookmarkFolder::FindItem(const GUID &guid) const
+{
+	return const_cast<CBookmarkFolder *>(this)->FindItem(guid);
+}
+
+CBookmarkFolder *CBookmarkFolder::FindParent(const GUID &guid) const
+{
+	ItemIndex_t &index = GetIndex();
+	auto itr = index.find(guid);
+
+	if(itr == index.end())
 	{
-		auto itr = m_ChildList.begin();
-		std::advance(itr,Position);
-		m_ChildList.insert(itr,BookmarkFolder);
+		return NULL;
 	}
 
-	m_nChildFolders++;
+	return itr->second.pParent;
+}
 
-	GetSystemTimeAsFileTime(&m_ftModified);
+VariantBookmark *CBookmarkFolder::GetChild(const GUID &guid)
+{
+	if(FindParent(guid) != this)
+	{
+		return NULL;
+	}
 
-	CBookmarkItemNotifier::GetInstance().NotifyObserversBookmarkFolderAdded(*this,BookmarkFolder,Position);
+	return FindItem(guid);
+}
+
+const CBookmarkFolder &CBookmarkFolder::GetRoot() const
+{
+	const CBookmarkFolder *pBookmarkFolder = this;
+
+	while(pBookmarkFolder->m_pParent != NULL)
+	{
+		pBookmarkFolder = pBookmarkFolder->m_pParent;
+	}
+
+	return *pBookmarkFolder;
+}
+
+CBookmarkFolder::ItemIndex_t &CBookmarkFolder::GetIndex() const
+{
+	const CBookmarkFolder &root = GetRoot();
+	assert(root.m_pIndex);
+	return *root.m_pIndex;
 }
 
 std::list<VariantBookmark>::iterator CBookmarkFolder::begin()
@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include <functional>
 #include <list>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <boost/variant.hpp>
 
@@ -13,6 +16,29 @@ class CBookmarkFolder;
 
 namespace NBookmark
 {
+	struct GuidEq
+	{
+		bool operator () (const GUID &guid1,const GUID &guid2) const
+		{
+			return (IsEqualGUID(guid1,guid2) == TRUE);
+		}
+	};
+
+	/* All the fields are combined, since the statically
+	defined GUID's (for example) only differ in their last
+	field. */
+	struct GuidHash
+	{
+		size_t operator () (const GUID &guid) const
+		{
+			ULONGLONG parts[2];
+			static_assert(sizeof(parts) == sizeof(guid),"Unexpected GUID size");
+			memcpy(parts,&guid,sizeof(parts));
+
+			return std::hash<ULONGLONG>()(parts[0] ^ (parts[1] * 0x9E3779B97F4A7C15ULL));
+		}
+	};
+
 	__interface IBookmarkItemNotification
 	{
 		void	OnBookmarkAdded(const CBookmarkFolder &ParentBookmarkFolder,const CBookmark &Bookmark,std::size_t Position);
@@ -28,10 +54,26 @@ namespace NBookmark
 
 typedef boost::variant<CBookmarkFolder, CBookmark> VariantBookmark;
 
+/* Folders own their children (and therefore their entire
+subtree), so they can be moved, but not copied.
+
+Every item in a tree is recorded in an index held by the
+root folder, keyed by the item's GUID. This allows any item
+(and its parent) to be found without having to search (or
+copy) any part of the tree. Finding the root takes time
+proportional to the depth of the folder the lookup starts
+from; the lookup itself is a single hash lookup. Since the
+children of a folder are held in a list, pointers to them
+remain valid until the item is removed. */
 class CBookmarkFolder
 {
 public:
 
+	CBookmarkFolder(CBookmarkFolder &&other);
+	CBookmarkFolder(const CBookmarkFolder &) = delete;
+	CBookmarkFolder &operator=(const CBookmarkFolder &) = delete;
+	CBookmarkFolder &operator=(CBookmarkFolder &&) = delete;
+
 	static CBookmarkFolder	Create(const std::wstring &strName,GUID &guid);
 	static CBookmarkFolder	Create(const std::wstring &strName);
 	static CBookmarkFolder	*CreateNew(const std::wstring &strName,GUID &guid);
@@ -54,6 +96,23 @@ public:
 	one child folder. */
 	bool			HasChildFolder() const;
 
+	/* The folder this folder has been inserted into, or
+	NULL if this is the root of the tree. */
+	CBookmarkFolder	*GetParent() const;
+
+	/* Finds an item anywhere within the tree this folder
+	belongs to. Returns NULL if there's no such item. */
+	VariantBookmark	*FindItem(const GUID &guid);
+	const VariantBookmark	*FindItem(const GUID &guid) const;
+
+	/* Returns the folder that directly contains the
+	specified item, or NULL if the item isn't in the tree. */
+	CBookmarkFolder	*FindParent(const GUID &guid) const;
+
+	/* Returns the specified item, if it's a direct child
+	of this folder. */
+	VariantBookmark	*GetChild(const GUID &guid);
+
 	std::list<VariantBookmark>::iterator	begin();
 	std::list<VariantBookmark>::iterator	end();
 
@@ -62,14 +121,24 @@ public:
 
 	void			InsertBookmark(const CBookmark &Bookmark);
 	void			InsertBookmark(const CBookmark &Bookmark,std::size_t Position);
-	void			InsertBookmarkFolder(const CBookmarkFolder &BookmarkFolder);
-	void			InsertBookmarkFolder(const CBookmarkFolder &BookmarkFolder,std::size_t Position);
+	void			InsertBookmarkFolder(CBookmarkFolder &&BookmarkFolder);
+	void			InsertBookmarkFolder(CBookmarkFolder &&BookmarkFolder,std::size_t Position);
 
-	void			RemoveBookmark();
-	void			RemoveBookmarkFolder();
+	/* Removes a direct child of this folder (along with
+	all of its children, if it's a folder). Returns false
+	if the item isn't a child of this folder. */
+	bool			RemoveBookmarkItem(const GUID &guid);
 
 private:
 
+	struct IndexEntry_t
+	{
+		std::list<VariantBookmark>::iterator	itr;
+		CBookmarkFolder							*pParent;
+	};
+
+	typedef std::unordered_map<GUID,IndexEntry_t,NBookmark::GuidHash,NBookmark::GuidEq> ItemIndex_t;
+
 	enum InitializationType_t
 	{
 		INITIALIZATION_TYPE_NORMAL,
@@ -84,10 +153,22 @@ private:
 
 	void			UpdateModificationTime();
 
+	VariantBookmark	&AddChild(VariantBookmark &&variantBookmark,std::size_t Position);
+	void			RemoveFromIndex(ItemIndex_t &index) const;
+	const CBookmarkFolder	&GetRoot() const;
+	ItemIndex_t		&GetIndex() const;
+
 	GUID			m_guid;
 
 	std::wstring	m_strName;
 
+	CBookmarkFolder	*m_pParent;
+
+	/* Only held by the root of a tree. When a folder is
+	inserted into another folder, its index is merged into
+	the index for the tree it's been inserted into. */
+	std::unique_ptr<ItemIndex_t>	m_pIndex;
+
 	/* Keeps track of the number of child
 	folders that are added. Used purely as
 	an optimization for the HasChildFolder()
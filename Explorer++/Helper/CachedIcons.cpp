@@ -4,10 +4,53 @@
 
 #include "stdafx.h"
 #include "CachedIcons.h"
+#include "RegistrySettings.h"
 #include "ShellHelper.h"
+#include <boost/algorithm/string.hpp>
+#include <wil/resource.h>
+
+namespace
+{
+	// The icon for each of these types is extracted from the file itself
+	// (or from the target, in the case of shortcuts).
+	const TCHAR *PER_FILE_ICON_EXTENSIONS[] = {
+		_T(".exe"), _T(".ico"), _T(".cur"), _T(".ani"), _T(".lnk"), _T(".url"),
+		_T(".scr"), _T(".cpl"), _T(".msc"), _T(".pif"), _T(".appref-ms"), _T(".website")
+	};
+
+	bool DoesKeyExist(HKEY parent, const std::wstring &subKey)
+	{
+		wil::unique_hkey key;
+		LONG res = RegOpenKeyEx(parent, subKey.c_str(), 0, KEY_READ, &key);
+		return res == ERROR_SUCCESS;
+	}
+
+	bool ReadDefaultValue(HKEY parent, const std::wstring &subKey, std::wstring &value)
+	{
+		wil::unique_hkey key;
+		LONG res = RegOpenKeyEx(parent, subKey.c_str(), 0, KEY_READ, &key);
+
+		if (res != ERROR_SUCCESS)
+		{
+			return false;
+		}
+
+		return NRegistrySettings::ReadStringFromRegistry(key.get(), _T(""), value) == ERROR_SUCCESS;
+	}
+}
 
 CachedIcons::CachedIcons(std::size_t maxItems) :
-	m_maxItems(maxItems)
+	CachedIcons(maxItems, doesFileTypeHavePerFileIcons)
+{
+
+}
+
+CachedIcons::CachedIcons(std::size_t maxItems, PerFileIconCheck perFileIconCheck) :
+	m_maxItems(maxItems),
+	m_perFileIconCheck(perFileIconCheck),
+	m_numPathHits(0),
+	m_numTypeHits(0),
+	m_numMisses(0)
 {
 
 }
@@ -64,4 +107,173 @@ CachedIcons::iterator CachedIcons::findByPath(const std::wstring &filePath)
 {
 	CachedIconSetByPath &pathIndex = m_cachedIconSet.get<1>();
 	return pathIndex.find(filePath);
-}
\ No newline at end of file
+}
+
+boost::optional<CachedItemIcon> CachedIcons::findItemIcon(const std::wstring &filePath, bool isFolder)
+{
+	auto typeKey = getTypeKey(filePath, isFolder);
+
+	if (typeKey)
+	{
+		auto itr = m_typeIcons.find(*typeKey);
+
+		if (itr != m_typeIcons.end())
+		{
+			m_numTypeHits++;
+			return CachedItemIcon{ itr->second, true };
+		}
+
+		m_numMisses++;
+		return boost::none;
+	}
+
+	auto itr = findByPath(filePath);
+
+	if (itr != end())
+	{
+		m_numPathHits++;
+		return CachedItemIcon{ itr->iconIndex, false };
+	}
+
+	m_numMisses++;
+	return boost::none;
+}
+
+void CachedIcons::addOrUpdateItemIcon(const std::wstring &filePath, bool isFolder, int iconIndex)
+{
+	auto typeKey = getTypeKey(filePath, isFolder);
+
+	if (typeKey)
+	{
+		// The overlay is specific to the file the icon was retrieved for,
+		// so it's not stored.
+		m_typeIcons[*typeKey] = iconIndex & 0x00FFFFFF;
+		return;
+	}
+
+	addOrUpdateFileIcon(filePath, iconIndex);
+}
+
+bool CachedIcons::isIconSharedByType(const std::wstring &filePath, bool isFolder)
+{
+	return getTypeKey(filePath, isFolder).is_initialized();
+}
+
+// Returns the extension that the item's icon should be cached under, or
+// nothing if the icon needs to be cached by path.
+boost::optional<std::wstring> CachedIcons::getTypeKey(const std::wstring &filePath, bool isFolder)
+{
+	// Folders can have custom icons (set through desktop.ini).
+	if (isFolder)
+	{
+		return boost::none;
+	}
+
+	// Only files in the filesystem (either on a drive or a network share)
+	// are cached by type. The icons for virtual items are determined by
+	// the folder they're in.
+	bool isDrivePath = (filePath.size() >= 3) && (filePath[1] == ':') && (filePath[2] == '\\');
+	bool isNetworkPath = boost::starts_with(filePath, L"\\\\");
+
+	if (!isDrivePath && !isNetworkPath)
+	{
+		return boost::none;
+	}
+
+	std::wstring extension = PathFindExtension(filePath.c_str());
+	boost::to_lower(extension);
+
+	auto itr = m_perFileIconTypes.find(extension);
+
+	if (itr == m_perFileIconTypes.end())
+	{
+		itr = m_perFileIconTypes.insert({ extension, m_perFileIconCheck(extension) }).first;
+	}
+
+	if (itr->second)
+	{
+		return boost::none;
+	}
+
+	return extension;
+}
+
+std::size_t CachedIcons::getNumPathEntries() const
+{
+	return m_cachedIconSet.size();
+}
+
+std::size_t CachedIcons::getNumTypeEntries() const
+{
+	return m_typeIcons.size();
+}
+
+std::uint64_t CachedIcons::getNumPathHits() const
+{
+	return m_numPathHits;
+}
+
+std::uint64_t CachedIcons::getNumTypeHits() const
+{
+	return m_numTypeHits;
+}
+
+std::uint64_t CachedIcons::getNumMisses() const
+{
+	return m_numMisses;
+}
+
+void CachedIcons::resetCounters()
+{
+	m_numPathHits = 0;
+	m_numTypeHits = 0;
+	m_numMisses = 0;
+}
+
+bool CachedIcons::doesFileTypeHavePerFileIcons(const std::wstring &extension)
+{
+	for (auto perFileIconExtension : PER_FILE_ICON_EXTENSIONS)
+	{
+		if (extension == perFileIconExtension)
+		{
+			return true;
+		}
+	}
+
+	// Files without an extension use the default icon.
+	if (extension.empty())
+	{
+		return false;
+	}
+
+	if (DoesKeyExist(HKEY_CLASSES_ROOT, extension + _T("\\shellex\\IconHandler"))
+		|| DoesKeyExist(HKEY_CLASSES_ROOT, _T("SystemFileAssociations\\") + extension + _T("\\shellex\\IconHandler")))
+	{
+		return true;
+	}
+
+	std::wstring progId;
+
+	if (!ReadDefaultValue(HKEY_CLASSES_ROOT, extension, progId) || progId.empty())
+	{
+		return false;
+	}
+
+	// An icon handler extracts the icon from each individual file. A
+	// DefaultIcon value of "%1" indicates that the file contains its own
+	// icon.
+	if (DoesKeyExist(HKEY_CLASSES_ROOT, progId + _T("\\shellex\\IconHandler")))
+	{
+		return true;
+	}
+
+	std::wstring defaultIcon;
+
+	if (ReadDefaultValue(HKEY_CLASSES_ROOT, progId + _T("\\DefaultIcon"), defaultIcon)
+		&& defaultIcon.find(_T("%1")) != std::wstring::npos)
+	{
+		return true;
+	}
+
+	return false;
+}
@@ -9,6 +9,9 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/optional.hpp>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
 
 struct CachedIcon
 {
@@ -16,6 +19,24 @@ struct CachedIcon
 	int iconIndex;
 };
 
+struct CachedItemIcon
+{
+	int iconIndex;
+
+	// True if the icon was found from the item's file type, rather than
+	// from the item itself. In that case, the icon index won't include
+	// an overlay.
+	bool sharedByType;
+};
+
+// Icons are cached at two levels. Files whose icon is determined entirely
+// by their type (e.g. text files) share a single entry per extension, so
+// that a large folder of files of the same type only takes up one entry.
+// Everything else (folders, as well as files such as executables and
+// shortcuts, whose icons vary from file to file) is cached by path, in a
+// list that's limited in size.
+//
+// Should only be used from the main thread.
 class CachedIcons
 {
 public:
@@ -31,7 +52,13 @@ public:
 	typedef CachedIconSet::nth_index<1>::type CachedIconSetByPath;
 	typedef CachedIconSetByPath::iterator iterator;
 
+	// Returns true if files with the specified extension (which will be
+	// in lowercase and include the leading period) can each have a
+	// different icon.
+	using PerFileIconCheck = std::function<bool(const std::wstring &extension)>;
+
 	CachedIcons(std::size_t maxItems);
+	CachedIcons(std::size_t maxItems, PerFileIconCheck perFileIconCheck);
 
 	iterator end();
 
@@ -40,8 +67,40 @@ public:
 	void replace(CachedIconSetByPath::iterator itr, const CachedIcon &cachedIcon);
 	iterator findByPath(const std::wstring &filePath);
 
+	// These methods decide which of the two levels an item belongs to.
+	boost::optional<CachedItemIcon> findItemIcon(const std::wstring &filePath, bool isFolder);
+	void addOrUpdateItemIcon(const std::wstring &filePath, bool isFolder, int iconIndex);
+	bool isIconSharedByType(const std::wstring &filePath, bool isFolder);
+
+	std::size_t getNumPathEntries() const;
+	std::size_t getNumTypeEntries() const;
+
+	std::uint64_t getNumPathHits() const;
+	std::uint64_t getNumTypeHits() const;
+	std::uint64_t getNumMisses() const;
+	void resetCounters();
+
+	// Checks the registry to determine whether files of the specified
+	// type have their own icons.
+	static bool doesFileTypeHavePerFileIcons(const std::wstring &extension);
+
 private:
 
+	boost::optional<std::wstring> getTypeKey(const std::wstring &filePath, bool isFolder);
+
 	CachedIconSet m_cachedIconSet;
 	std::size_t m_maxItems;
+
+	// Indexed by extension.
+	std::unordered_map<std::wstring, int> m_typeIcons;
+
+	// The result of checking whether each extension has per-file icons.
+	// The check involves several registry lookups, so it's only
+	// performed once per extension.
+	PerFileIconCheck m_perFileIconCheck;
+	std::unordered_map<std::wstring, bool> m_perFileIconTypes;
+
+	std::uint64_t m_numPathHits;
+	std::uint64_t m_numTypeHits;
+	std::uint64_t m_numMisses;
 };
\ No newline at end of file
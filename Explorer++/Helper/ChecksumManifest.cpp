@@ -0,0 +1,209 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ChecksumManifest.h"
+#include "StringHelper.h"
+#include <algorithm>
+#include <iomanip>
+
+const TCHAR ChecksumManifest::FILE_EXTENSION[] = _T(".sfv");
+
+namespace
+{
+	// Manifests are only expected to list a few hundred files at most, so
+	// anything larger than this is rejected.
+	const DWORD MAX_MANIFEST_SIZE = 1024 * 1024;
+
+	std::wstring GetFileName(const std::wstring &path)
+	{
+		auto pos = path.find_last_of(L"\\/");
+
+		if (pos == std::wstring::npos)
+		{
+			return path;
+		}
+
+		return path.substr(pos + 1);
+	}
+
+	bool ParseChecksum(const std::string &text, std::uint32_t &checksum)
+	{
+		if (text.size() != 8 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+		{
+			return false;
+		}
+
+		checksum = static_cast<std::uint32_t>(std::stoul(text, nullptr, 16));
+		return true;
+	}
+}
+
+void ChecksumManifest::AddEntry(const std::wstring &fileName, std::uint32_t checksum)
+{
+	m_entries.emplace_back(fileName, checksum);
+}
+
+boost::optional<std::uint32_t> ChecksumManifest::GetChecksum(const std::wstring &fileName) const
+{
+	for (const auto &entry : m_entries)
+	{
+		if (lstrcmpi(entry.first.c_str(), fileName.c_str()) == 0)
+		{
+			return entry.second;
+		}
+	}
+
+	return boost::none;
+}
+
+std::size_t ChecksumManifest::GetNumEntries() const
+{
+	return m_entries.size();
+}
+
+std::string ChecksumManifest::Serialize() const
+{
+	std::stringstream ss;
+
+	for (const auto &entry : m_entries)
+	{
+		ss << wstrToStr(entry.first) << " " << std::hex << std::uppercase << std::setw(8)
+			<< std::setfill('0') << entry.second << "\r\n";
+	}
+
+	return ss.str();
+}
+
+boost::optional<ChecksumManifest> ChecksumManifest::Parse(const std::string &data)
+{
+	ChecksumManifest manifest;
+	std::istringstream stream(data);
+	std::string line;
+
+	while (std::getline(stream, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		if (line.empty() || line[0] == ';')
+		{
+			continue;
+		}
+
+		/* The file name may itself contain spaces, so the checksum is
+		taken from the end of the line. */
+		auto pos = line.find_last_of(' ');
+
+		if (pos == std::string::npos || pos == 0)
+		{
+			return boost::none;
+		}
+
+		std::uint32_t checksum;
+
+		if (!ParseChecksum(line.substr(pos + 1), checksum))
+		{
+			return boost::none;
+		}
+
+		std::wstring fileName;
+
+		try
+		{
+			fileName = strToWstr(line.substr(0, pos));
+		}
+		catch (const std::range_error &)
+		{
+			return boost::none;
+		}
+
+		TrimStringRight(fileName, L" ");
+		manifest.AddEntry(fileName, checksum);
+	}
+
+	return manifest;
+}
+
+boost::optional<ChecksumManifest> ChecksumManifest::Load(const std::wstring &path)
+{
+	HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return boost::none;
+	}
+
+	LARGE_INTEGER size;
+
+	if (!GetFileSizeEx(file, &size) || size.QuadPart > MAX_MANIFEST_SIZE)
+	{
+		CloseHandle(file);
+		return boost::none;
+	}
+
+	std::string data(static_cast<std::size_t>(size.QuadPart), '\0');
+	DWORD numBytesRead = 0;
+	BOOL res = TRUE;
+
+	if (!data.empty())
+	{
+		res = ReadFile(file, &data[0], static_cast<DWORD>(data.size()), &numBytesRead, nullptr);
+	}
+
+	CloseHandle(file);
+
+	if (!res || numBytesRead != data.size())
+	{
+		return boost::none;
+	}
+
+	return Parse(data);
+}
+
+boost::optional<ChecksumManifest> FindChecksumManifest(const std::vector<std::wstring> &files)
+{
+	if (files.empty())
+	{
+		return boost::none;
+	}
+
+	std::wstring directory = files[0].substr(0, files[0].size() - GetFileName(files[0]).size());
+
+	WIN32_FIND_DATA wfd;
+	HANDLE hFindFile = FindFirstFile((directory + L"*" + ChecksumManifest::FILE_EXTENSION).c_str(), &wfd);
+
+	if (hFindFile == INVALID_HANDLE_VALUE)
+	{
+		return boost::none;
+	}
+
+	boost::optional<ChecksumManifest> result;
+
+	do
+	{
+		auto manifest = ChecksumManifest::Load(directory + wfd.cFileName);
+
+		if (!manifest)
+		{
+			continue;
+		}
+
+		bool containsAllFiles = std::all_of(files.begin(), files.end(), [&manifest] (const std::wstring &file) {
+			return manifest->GetChecksum(GetFileName(file)).is_initialized();
+		});
+
+		if (containsAllFiles)
+		{
+			result = manifest;
+			break;
+		}
+	} while (FindNextFile(hFindFile, &wfd));
+
+	FindClose(hFindFile);
+
+	return result;
+}
@@ -0,0 +1,45 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A list of file names and their CRC-32 checksums. Manifests are stored in
+// the Simple File Verification (SFV) format, where each line consists of a
+// file name, followed by a space and the checksum (as 8 hex digits). Lines
+// that start with a semicolon are comments.
+class ChecksumManifest
+{
+public:
+
+	static const TCHAR FILE_EXTENSION[];
+
+	void AddEntry(const std::wstring &fileName, std::uint32_t checksum);
+
+	// File names are compared case-insensitively.
+	boost::optional<std::uint32_t> GetChecksum(const std::wstring &fileName) const;
+	std::size_t GetNumEntries() const;
+
+	std::string Serialize() const;
+
+	// Returns none if any of the lines is invalid.
+	static boost::optional<ChecksumManifest> Parse(const std::string &data);
+
+	static boost::optional<ChecksumManifest> Load(const std::wstring &path);
+
+private:
+
+	// Manifests are only ever expected to contain a relatively small
+	// number of entries, so they're simply stored in order.
+	std::vector<std::pair<std::wstring, std::uint32_t>> m_entries;
+};
+
+// Searches the folder containing the first of the specified files for a
+// manifest that has an entry for every one of the files.
+boost::optional<ChecksumManifest> FindChecksumManifest(const std::vector<std::wstring> &files);
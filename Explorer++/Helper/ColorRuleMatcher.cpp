@@ -0,0 +1,48 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ColorRuleMatcher.h"
+
+void ColorRuleMatcher::AddRule(std::wstring_view filterPattern, bool caseSensitive,
+	DWORD filterAttributes, COLORREF color)
+{
+	Rule rule;
+
+	if (!filterPattern.empty())
+	{
+		rule.pattern.emplace(filterPattern, caseSensitive);
+	}
+
+	rule.filterAttributes = filterAttributes;
+	rule.color = color;
+
+	m_rules.push_back(std::move(rule));
+}
+
+void ColorRuleMatcher::Clear()
+{
+	m_rules.clear();
+}
+
+boost::optional<COLORREF> ColorRuleMatcher::GetColor(std::wstring_view fileName, DWORD attributes) const
+{
+	for (const auto &rule : m_rules)
+	{
+		// The attribute check is much cheaper, so it's done first.
+		if (rule.filterAttributes != 0 && (rule.filterAttributes & attributes) == 0)
+		{
+			continue;
+		}
+
+		if (rule.pattern && !rule.pattern->Matches(fileName))
+		{
+			continue;
+		}
+
+		return rule.color;
+	}
+
+	return boost::none;
+}
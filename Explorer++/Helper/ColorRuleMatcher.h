@@ -0,0 +1,39 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "StringHelper.h"
+#include <boost/optional.hpp>
+#include <string_view>
+#include <vector>
+
+// An ordered set of color rules, in a form that can be checked cheaply
+// against each item in a folder. An item is given the color of the first
+// rule it matches.
+//
+// A rule matches an item if the item's name matches the rule's pattern
+// and the item has at least one of the rule's attributes. An empty
+// pattern matches any name and an attribute mask of 0 matches any set of
+// attributes.
+class ColorRuleMatcher
+{
+public:
+
+	void AddRule(std::wstring_view filterPattern, bool caseSensitive, DWORD filterAttributes, COLORREF color);
+	void Clear();
+
+	boost::optional<COLORREF> GetColor(std::wstring_view fileName, DWORD attributes) const;
+
+private:
+
+	struct Rule
+	{
+		boost::optional<WildcardPattern> pattern;
+		DWORD filterAttributes;
+		COLORREF color;
+	};
+
+	std::vector<Rule> m_rules;
+};
@@ -11,9 +11,13 @@
 #include "ContextMenuManager.h"
 #include "Macros.h"
 #include "Logging.h"
+#include "VirtualFileCopy.h"
+#include <atomic>
 
 
 #define WM_APP_COPYOPERATIONFINISHED	(WM_APP + 1)
+#define WM_APP_VIRTUALFILECOPYPROGRESS	(WM_APP + 2)
+#define WM_APP_VIRTUALFILECOPYFINISHED	(WM_APP + 3)
 #define SUBCLASS_ID	10000
 
 struct HANDLETOMAPPINGS
@@ -45,11 +49,61 @@ struct AsyncOperationInfo_t
 	DWORD			dwEffect;
 };
 
+struct VirtualFileCopyInfo_t
+{
+	HWND									hwnd;
+	wil::com_ptr<IDataObject>				pDataObject;
+	wil::com_ptr<IDataObjectAsyncCapability>	pac;
+	wil::com_ptr<IDropFilesCallback>		pDropFilesCallback;
+	wil::com_ptr<IFileOperationProgressSink>	pProgressSink;
+	POINT									pt;
+
+	std::vector<NVirtualFileCopy::CopyItem>	Items;
+
+	/* The result of each copy, in the same
+	order as the items above. */
+	std::vector<HRESULT>					Results;
+
+	/* The mediums the file contents were retrieved
+	from. These are only released once the copy has
+	finished. */
+	std::vector<STGMEDIUM>					Mediums;
+
+	/* Set before the copy thread is started. */
+	bool									bReportProgress = false;
+
+	/* Set on the original thread if the drop window is
+	destroyed while the copy is in progress. From that
+	point, the copy thread is responsible for ending the
+	operation and freeing this structure. */
+	std::atomic<bool>						bCancelled{false};
+
+	/* If the copy is cancelled, the async capability is
+	marshaled here, so that the copy thread can end the
+	operation. */
+	wil::com_ptr<IStream>					marshaledAsyncCapability;
+};
+
+struct VirtualFileCopyProgress_t
+{
+	ULONGLONG	ullTotalBytes;
+	ULONGLONG	ullBytesCopied;
+};
+
 int CopyFileDescriptorAToW(FILEDESCRIPTORW *pfdw, const FILEDESCRIPTORA *pfda);
 DWORD WINAPI CopyDroppedFilesInternalAsyncStub(LPVOID lpParameter);
 BOOL CopyDroppedFilesInternalAsync(PastedFilesInfo_t *ppfi);
 LRESULT CALLBACK DropWindowSubclass(HWND hwnd,UINT uMsg,
 WPARAM wParam,LPARAM lParam,UINT_PTR uIdSubclass,DWORD_PTR dwRefData);
+HRESULT GetFileContents(IDataObject *pDataObject,LONG lindex,STGMEDIUM *pstg);
+void SetPerformedDropEffect(IDataObject *pDataObject,DWORD dwEffect);
+DWORD WINAPI VirtualFileCopyThread(LPVOID lpParameter);
+HRESULT GetVirtualFileCopyResult(const VirtualFileCopyInfo_t *pvfci,std::list<std::wstring> &PastedFileList);
+void FinishVirtualFileCopy(VirtualFileCopyInfo_t *pvfci);
+void CancelVirtualFileCopy(VirtualFileCopyInfo_t *pvfci);
+void FinishCancelledVirtualFileCopy(VirtualFileCopyInfo_t *pvfci);
+LRESULT CALLBACK VirtualFileCopySubclass(HWND hwnd,UINT uMsg,
+WPARAM wParam,LPARAM lParam,UINT_PTR uIdSubclass,DWORD_PTR dwRefData);
 
 /* TODO: */
 void CreateDropOptionsMenu(HWND hDrop,LPCITEMIDLIST pidlDirectory,IDataObject *pDataObject);
@@ -119,9 +173,15 @@ BOOL bRenameOnCollision)
 	m_pDropFilesCallback	= pDropFilesCallback;
 	m_bRenameOnCollision	= bRenameOnCollision;
 
-	POINTL ptl = {0,0};
+	m_ptl.x = 0;
+	m_ptl.y = 0;
 
-	HandleLeftClickDrop(m_pDataObject,&ptl);
+	HandleLeftClickDrop(m_pDataObject,&m_ptl);
+}
+
+void CDropHandler::SetProgressSink(IFileOperationProgressSink *progressSink)
+{
+	m_progressSink = progressSink;
 }
 
 void CDropHandler::HandleLeftClickDrop(IDataObject *pDataObject,POINTL *pptl)
@@ -419,252 +479,517 @@ HRESULT CDropHandler::CopyUnicodeFileDescriptorData(IDataObject *pDataObject,
 HRESULT CDropHandler::CopyFileDescriptorData(IDataObject *pDataObject,
 	FILEGROUPDESCRIPTORW *pfgd,std::list<std::wstring> &PastedFileList)
 {
-	FILETIME *pftCreationTime = NULL;
-	FILETIME *pftLastAccessTime = NULL;
-	FILETIME *pftLastWriteTime = NULL;
-	DWORD dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
-	DWORD nBytesToWrite = 0;
-
+	VirtualFileCopyInfo_t *pvfci = new VirtualFileCopyInfo_t;
+	BOOL bStorageCopied = FALSE;
 	HRESULT hr = E_FAIL;
 
 	for(unsigned int i = 0;i < pfgd->cItems;i++)
 	{
-		if(pfgd->fgd[i].dwFlags & FD_ATTRIBUTES)
+		const FILEDESCRIPTORW *pfd = &pfgd->fgd[i];
+
+		TCHAR szFullFileName[MAX_PATH];
+		StringCchCopy(szFullFileName,SIZEOF_ARRAY(szFullFileName),m_szDestDirectory);
+		PathAppend(szFullFileName,pfd->cFileName);
+
+		DWORD dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+
+		if(pfd->dwFlags & FD_ATTRIBUTES)
 		{
-			dwFileAttributes = pfgd->fgd[i].dwFileAttributes;
+			dwFileAttributes = pfd->dwFileAttributes;
 		}
 
-		if(pfgd->fgd[i].dwFlags & FD_FILESIZE)
+		/* Folders (e.g. those dragged out of an archive) have
+		no contents of their own, but need to exist before any
+		of the files within them can be created. The descriptor
+		for a folder always comes before the descriptors for the
+		items within it. */
+		if(dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 		{
-			nBytesToWrite = pfgd->fgd[i].nFileSizeLow;
+			if(CreateDirectory(szFullFileName,NULL) ||
+				GetLastError() == ERROR_ALREADY_EXISTS)
+			{
+				PastedFileList.push_back(PathFindFileName(szFullFileName));
+				hr = S_OK;
+			}
+
+			continue;
 		}
 
-		if(pfgd->fgd[i].dwFlags & FD_LINKUI)
+		STGMEDIUM stgFileContents;
+		hr = GetFileContents(pDataObject,i,&stgFileContents);
+
+		if(hr != S_OK)
 		{
-			/* TODO: Complete. */
+			continue;
 		}
 
-		if(pfgd->fgd[i].dwFlags & FD_CREATETIME)
+		/* Some applications (e.g. Thunderbird) may return data
+		in a different format than the one requested. So, take
+		action based on what they return, rather than what
+		was requested. */
+		if(stgFileContents.tymed == TYMED_ISTORAGE)
 		{
-			pftCreationTime = &pfgd->fgd[i].ftCreationTime;
+			IStorage *pStorage = NULL;
+			hr = StgCreateStorageEx(szFullFileName,STGM_READWRITE|STGM_TRANSACTED|STGM_CREATE,STGFMT_STORAGE,
+				0,NULL,NULL,IID_PPV_ARGS(&pStorage));
+
+			if(hr == S_OK)
+			{
+				hr = stgFileContents.pstg->CopyTo(0,NULL,NULL,pStorage);
+
+				if(hr == S_OK)
+				{
+					hr = pStorage->Commit(STGC_DEFAULT);
+
+					if(hr == S_OK)
+					{
+						PastedFileList.push_back(PathFindFileName(szFullFileName));
+
+						bStorageCopied = TRUE;
+					}
+				}
+
+				pStorage->Release();
+			}
+
+			ReleaseStgMedium(&stgFileContents);
+			continue;
 		}
 
-		if(pfgd->fgd[i].dwFlags & FD_ACCESSTIME)
+		NVirtualFileCopy::CopyItem item;
+		item.destinationPath = szFullFileName;
+		item.attributes = dwFileAttributes;
+		item.size = NVirtualFileCopy::UNKNOWN_SIZE;
+
+		if(pfd->dwFlags & FD_FILESIZE)
 		{
-			pftLastAccessTime = &pfgd->fgd[i].ftLastAccessTime;
+			item.size = (static_cast<ULONGLONG>(pfd->nFileSizeHigh) << 32) | pfd->nFileSizeLow;
 		}
 
-		if(pfgd->fgd[i].dwFlags & FD_WRITESTIME)
+		if(pfd->dwFlags & FD_CREATETIME)
 		{
-			pftLastWriteTime = &pfgd->fgd[i].ftLastWriteTime;
+			item.creationTime = pfd->ftCreationTime;
 		}
 
-		/*if(pfgd->fgd[i].dwFlags & FD_UNICODE)
+		if(pfd->dwFlags & FD_ACCESSTIME)
 		{
-		}*/
-
-		FORMATETC ftcfchg;
-		FORMATETC ftcfcis;
-		FORMATETC ftcfcstg;
-		STGMEDIUM stgFileContents = {0};
-		BOOL bDataCopied = FALSE;
-		BOOL bDataRetrieved = FALSE;
-		LPBYTE pBuffer = NULL;
-
-		SetFORMATETC(&ftcfchg,(CLIPFORMAT)RegisterClipboardFormat(CFSTR_FILECONTENTS),
-			NULL,DVASPECT_CONTENT,i,TYMED_HGLOBAL);
-		SetFORMATETC(&ftcfcis,(CLIPFORMAT)RegisterClipboardFormat(CFSTR_FILECONTENTS),
-			NULL,DVASPECT_CONTENT,i,TYMED_ISTREAM);
-		SetFORMATETC(&ftcfcstg,(CLIPFORMAT)RegisterClipboardFormat(CFSTR_FILECONTENTS),
-			NULL,DVASPECT_CONTENT,i,TYMED_ISTORAGE);
-
-		BOOL bDataExtracted = FALSE;
-
-		if(CheckDropFormatSupported(pDataObject,&ftcfchg))
+			item.lastAccessTime = pfd->ftLastAccessTime;
+		}
+
+		if(pfd->dwFlags & FD_WRITESTIME)
 		{
-			hr = pDataObject->GetData(&ftcfchg,&stgFileContents);
+			item.lastWriteTime = pfd->ftLastWriteTime;
+		}
 
-			if(hr == S_OK)
+		/* The contents are read directly from the stream (or the
+		HGLOBAL) in chunks, rather than being copied into a buffer
+		first. */
+		wil::com_ptr<IStream> pStream;
+
+		if(stgFileContents.tymed == TYMED_HGLOBAL)
+		{
+			/* If the file size isn't explicitly given, use the size of
+			the memory block. */
+			if(item.size == NVirtualFileCopy::UNKNOWN_SIZE)
 			{
-				bDataExtracted = TRUE;
+				item.size = GlobalSize(stgFileContents.hGlobal);
 			}
+
+			hr = CreateStreamOnHGlobal(stgFileContents.hGlobal,FALSE,&pStream);
 		}
-		else if(CheckDropFormatSupported(pDataObject,&ftcfcis))
+		else if(stgFileContents.tymed == TYMED_ISTREAM)
 		{
-			hr = pDataObject->GetData(&ftcfcis,&stgFileContents);
+			/* If the file size isn't explicitly given, use the size of
+			the stream (if it's known). */
+			STATSTG sstg;
 
-			if(hr == S_OK)
+			if(item.size == NVirtualFileCopy::UNKNOWN_SIZE &&
+				stgFileContents.pstm->Stat(&sstg,STATFLAG_NONAME) == S_OK)
 			{
-				bDataExtracted = TRUE;
+				item.size = sstg.cbSize.QuadPart;
 			}
+
+			pStream = stgFileContents.pstm;
+			hr = S_OK;
 		}
-		else if(CheckDropFormatSupported(pDataObject,&ftcfcstg))
+		else
 		{
-			hr = pDataObject->GetData(&ftcfcstg,&stgFileContents);
+			hr = DV_E_TYMED;
+		}
 
-			if(hr == S_OK)
-			{
-				bDataExtracted = TRUE;
-			}
+		if(hr == S_OK)
+		{
+			hr = CoMarshalInterThreadInterfaceInStream(IID_IStream,pStream.get(),&item.marshaledStream);
 		}
 
-		if(bDataExtracted)
+		if(hr != S_OK)
 		{
-			/* Some applications (e.g. Thunderbird) may return data
-			in a different format than the one requested. So, take
-			action based on what they return, rather than what
-			was requested. */
-			switch(stgFileContents.tymed)
-			{
-			case TYMED_HGLOBAL:
-				{
-					pBuffer = (LPBYTE)malloc(GlobalSize(stgFileContents.hGlobal) * sizeof(BYTE));
+			ReleaseStgMedium(&stgFileContents);
+			continue;
+		}
 
-					if(pBuffer != NULL)
-					{
-						if(!(pfgd->fgd[i].dwFlags & FD_FILESIZE))
-							nBytesToWrite = (DWORD)GlobalSize(stgFileContents.hGlobal);
+		pvfci->Items.push_back(std::move(item));
 
-						LPBYTE pTemp = (LPBYTE)GlobalLock(stgFileContents.hGlobal);
+		/* The stream (or the memory backing it) has to remain valid
+		until the copy has finished. */
+		pvfci->Mediums.push_back(stgFileContents);
+	}
 
-						if(pTemp != NULL)
-						{
-							memcpy(pBuffer,pTemp,GlobalSize(stgFileContents.hGlobal));
+	if(bStorageCopied)
+	{
+		SetPerformedDropEffect(pDataObject,DROPEFFECT_COPY);
+	}
 
-							GlobalUnlock(stgFileContents.hGlobal);
+	if(pvfci->Items.empty())
+	{
+		delete pvfci;
+		return hr;
+	}
 
-							bDataRetrieved = TRUE;
-						}
-					}
-				}
-				break;
+	return StartVirtualFileCopy(pvfci,pDataObject);
+}
 
-			case TYMED_ISTREAM:
-				{
-					STATSTG sstg;
-					ULONG cbRead;
+/* Copies the file contents on a background thread. The
+results are passed back to the drop window once the copy
+has finished, at which point the caller is notified. */
+HRESULT CDropHandler::StartVirtualFileCopy(VirtualFileCopyInfo_t *pvfci,IDataObject *pDataObject)
+{
+	pvfci->hwnd					= m_hwndDrop;
+	pvfci->pDataObject			= pDataObject;
+	pvfci->pDropFilesCallback	= m_pDropFilesCallback;
+	pvfci->pProgressSink		= m_progressSink;
+	pvfci->pt.x					= m_ptl.x;
+	pvfci->pt.y					= m_ptl.y;
+
+	/* If the drop source supports asynchronous operation,
+	let it know that the data is still in use. Sources that
+	don't will consider the drop complete once this method
+	returns, though the streams retrieved above will remain
+	valid, since they're still referenced. */
+	IDataObjectAsyncCapability *pac = NULL;
+	HRESULT hr = pDataObject->QueryInterface(IID_PPV_ARGS(&pac));
 
-					hr = stgFileContents.pstm->Stat(&sstg,STATFLAG_NONAME);
+	if(hr == S_OK)
+	{
+		BOOL bAsyncSupported = FALSE;
+		pac->GetAsyncMode(&bAsyncSupported);
 
-					if(hr == S_OK)
-					{
-						pBuffer = (LPBYTE)malloc(sstg.cbSize.LowPart * sizeof(BYTE));
+		if(bAsyncSupported)
+		{
+			pac->StartOperation(NULL);
+			pvfci->pac = pac;
+		}
 
-						if(pBuffer != NULL)
-						{
-							/* If the file size isn't explicitly given,
-							use the size of the stream. */
-							if(!(pfgd->fgd[i].dwFlags & FD_FILESIZE))
-								nBytesToWrite = sstg.cbSize.LowPart;
+		pac->Release();
+	}
 
-							stgFileContents.pstm->Read(pBuffer,sstg.cbSize.LowPart,&cbRead);
+	if(pvfci->pProgressSink)
+	{
+		pvfci->pProgressSink->StartOperations();
+		pvfci->bReportProgress = true;
+	}
 
-							bDataRetrieved = TRUE;
-						}
-					}
-				}
-				break;
+	/* Each copy is identified by its own subclass, so that several
+	copies to the same window can be in progress at once. */
+	UINT_PTR uIdSubclass = reinterpret_cast<UINT_PTR>(pvfci);
+	SetWindowSubclass(m_hwndDrop,VirtualFileCopySubclass,uIdSubclass,
+		reinterpret_cast<DWORD_PTR>(pvfci));
 
-			case TYMED_ISTORAGE:
-				{
-					TCHAR szFullFileName[MAX_PATH];
-					StringCchCopy(szFullFileName,SIZEOF_ARRAY(szFullFileName),m_szDestDirectory);
-					PathAppend(szFullFileName,pfgd->fgd[i].cFileName);
+	HANDLE hThread = CreateThread(NULL,0,VirtualFileCopyThread,
+		reinterpret_cast<LPVOID>(pvfci),0,NULL);
 
-					IStorage *pStorage = NULL;
-					hr = StgCreateStorageEx(szFullFileName,STGM_READWRITE|STGM_TRANSACTED|STGM_CREATE,STGFMT_STORAGE,
-						0,NULL,NULL,IID_PPV_ARGS(&pStorage));
+	if(hThread == NULL)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
 
-					if(hr == S_OK)
-					{
-						hr = stgFileContents.pstg->CopyTo(0,NULL,NULL,pStorage);
+		/* The copy can't simply be performed on this thread, as
+		the streams may need to call back into it. */
+		for(auto &item : pvfci->Items)
+		{
+			CoReleaseMarshalData(item.marshaledStream.get());
+		}
 
-						if(hr == S_OK)
-						{
-							hr = pStorage->Commit(STGC_DEFAULT);
+		pvfci->Results.assign(pvfci->Items.size(),hr);
+		SendMessage(m_hwndDrop,WM_APP_VIRTUALFILECOPYFINISHED,uIdSubclass,0);
 
-							if(hr == S_OK)
-							{
-								PastedFileList.push_back(pfgd->fgd[i].cFileName);
+		return hr;
+	}
 
-								bDataCopied = TRUE;
-							}
-						}
+	CloseHandle(hThread);
 
-						pStorage->Release();
-					}
-				}
-				break;
-			}
+	return S_OK;
+}
 
-			ReleaseStgMedium(&stgFileContents);
+/* Prefers a stream, since that allows the contents to be
+read incrementally (rather than requiring the source to
+place the entire file in memory). */
+HRESULT GetFileContents(IDataObject *pDataObject,LONG lindex,STGMEDIUM *pstg)
+{
+	const DWORD tymeds[] = {TYMED_ISTREAM,TYMED_HGLOBAL,TYMED_ISTORAGE};
+	HRESULT hr = E_FAIL;
+
+	for(DWORD tymed : tymeds)
+	{
+		FORMATETC ftc;
+		SetFORMATETC(&ftc,(CLIPFORMAT)RegisterClipboardFormat(CFSTR_FILECONTENTS),
+			NULL,DVASPECT_CONTENT,lindex,tymed);
+
+		hr = pDataObject->GetData(&ftc,pstg);
+
+		if(hr == S_OK)
+		{
+			break;
 		}
+	}
+
+	return hr;
+}
+
+void SetPerformedDropEffect(IDataObject *pDataObject,DWORD dwEffect)
+{
+	FORMATETC ftc;
+	ftc.cfFormat	= (CLIPFORMAT)RegisterClipboardFormat(CFSTR_PERFORMEDDROPEFFECT);
+	ftc.ptd			= NULL;
+	ftc.dwAspect	= DVASPECT_CONTENT;
+	ftc.lindex		= -1;
+	ftc.tymed		= TYMED_HGLOBAL;
+
+	HGLOBAL hGlobal = GlobalAlloc(GMEM_MOVEABLE,sizeof(DWORD));
 
-		if(bDataRetrieved &&
-			!bDataCopied)
+	if(hGlobal != NULL)
+	{
+		DWORD *pdwEffect = (DWORD *) GlobalLock(hGlobal);
+
+		if(pdwEffect != NULL)
 		{
-			TCHAR szFullFileName[MAX_PATH];
+			*pdwEffect = dwEffect;
+			GlobalUnlock(hGlobal);
 
-			StringCchCopy(szFullFileName,SIZEOF_ARRAY(szFullFileName),m_szDestDirectory);
-			PathAppend(szFullFileName,pfgd->fgd[i].cFileName);
+			STGMEDIUM stg;
+			stg.tymed = TYMED_HGLOBAL;
+			stg.pUnkForRelease = NULL;
+			stg.hGlobal = hGlobal;
 
-			HANDLE hFile = CreateFile(szFullFileName,GENERIC_WRITE,0,NULL,
-				CREATE_ALWAYS,dwFileAttributes,NULL);
+			pDataObject->SetData(&ftc, &stg, FALSE);
+		}
 
-			if(hFile != INVALID_HANDLE_VALUE)
-			{
-				DWORD nBytesWritten;
+		GlobalFree(hGlobal);
+	}
+}
 
-				SetFileTime(hFile,pftCreationTime,pftLastAccessTime,pftLastWriteTime);
+DWORD WINAPI VirtualFileCopyThread(LPVOID lpParameter)
+{
+	assert(lpParameter != NULL);
 
-				WriteFile(hFile,pBuffer,nBytesToWrite,&nBytesWritten,NULL);
+	VirtualFileCopyInfo_t *pvfci = reinterpret_cast<VirtualFileCopyInfo_t *>(lpParameter);
+	WPARAM wParam = reinterpret_cast<WPARAM>(pvfci);
 
-				CloseHandle(hFile);
+	/* The progress sink is called on the original thread. If the
+	window has since been destroyed, SendMessage() will return 0,
+	which cancels the copy. */
+	auto progressCallback = [pvfci,wParam] (ULONGLONG ullTotalBytes,ULONGLONG ullBytesCopied) {
+		if(pvfci->bCancelled)
+		{
+			return false;
+		}
 
-				TCHAR szFileName[MAX_PATH];
-				StringCchCopy(szFileName,SIZEOF_ARRAY(szFileName),szFullFileName);
-				PathStripPath(szFileName);
+		if(!pvfci->bReportProgress)
+		{
+			return true;
+		}
 
-				PastedFileList.push_back(szFileName);
-			}
+		VirtualFileCopyProgress_t vfcp = {ullTotalBytes,ullBytesCopied};
+		return SendMessage(pvfci->hwnd,WM_APP_VIRTUALFILECOPYPROGRESS,
+			wParam,reinterpret_cast<LPARAM>(&vfcp)) != 0;
+	};
 
-			FORMATETC ftc;
-			ftc.cfFormat	= (CLIPFORMAT)RegisterClipboardFormat(CFSTR_PERFORMEDDROPEFFECT);
-			ftc.ptd			= NULL;
-			ftc.dwAspect	= DVASPECT_CONTENT;
-			ftc.lindex		= -1;
-			ftc.tymed		= TYMED_HGLOBAL;
+	pvfci->Results = NVirtualFileCopy::CopyItems(pvfci->Items,
+		NVirtualFileCopy::CHUNK_SIZE,progressCallback);
 
-			HGLOBAL hGlobal = GlobalAlloc(GMEM_MOVEABLE,sizeof(DWORD));
+	/* As with the CF_HDROP copy, the drop source (and the
+	caller) need to be notified on the original thread. The
+	message is only handled (and pvfci freed) if the window
+	still exists. */
+	if(pvfci->bCancelled ||
+		!SendMessage(pvfci->hwnd,WM_APP_VIRTUALFILECOPYFINISHED,wParam,0))
+	{
+		FinishCancelledVirtualFileCopy(pvfci);
+		delete pvfci;
+	}
 
-			if(hGlobal != NULL)
-			{
-				DWORD *pdwCopyEffect = (DWORD *) GlobalLock(hGlobal);
+	return 0;
+}
 
-				if(pdwCopyEffect != NULL)
-				{
-					*pdwCopyEffect = DROPEFFECT_COPY;
-					GlobalUnlock(hGlobal);
+/* Returns the result of the copy as a whole. The name of
+each file that was copied is added to PastedFileList. */
+HRESULT GetVirtualFileCopyResult(const VirtualFileCopyInfo_t *pvfci,std::list<std::wstring> &PastedFileList)
+{
+	HRESULT hr = S_OK;
 
-					STGMEDIUM stg;
-					stg.tymed = TYMED_HGLOBAL;
-					stg.pUnkForRelease = NULL;
-					stg.hGlobal = hGlobal;
+	for(size_t i = 0;i < pvfci->Items.size();i++)
+	{
+		if(SUCCEEDED(pvfci->Results[i]))
+		{
+			PastedFileList.push_back(PathFindFileName(pvfci->Items[i].destinationPath.c_str()));
+		}
+		else
+		{
+			LOG(warning) << _T("Helper - Failed to copy virtual file ")
+				<< pvfci->Items[i].destinationPath << _T(" (") << pvfci->Results[i] << _T(")");
 
-					pDataObject->SetData(&ftc, &stg, FALSE);
-				}
+			hr = pvfci->Results[i];
+		}
+	}
 
-				GlobalFree(hGlobal);
-			}
+	return hr;
+}
+
+void FinishVirtualFileCopy(VirtualFileCopyInfo_t *pvfci)
+{
+	std::list<std::wstring> PastedFileList;
+	HRESULT hr = GetVirtualFileCopyResult(pvfci,PastedFileList);
+
+	DWORD dwEffect = PastedFileList.empty() ? DROPEFFECT_NONE : DROPEFFECT_COPY;
+
+	if(!PastedFileList.empty())
+	{
+		SetPerformedDropEffect(pvfci->pDataObject.get(),dwEffect);
+
+		if(pvfci->pDropFilesCallback)
+		{
+			pvfci->pDropFilesCallback->OnDropFile(PastedFileList,&pvfci->pt);
 		}
+	}
 
-		if(pBuffer != NULL)
+	if(pvfci->pProgressSink)
+	{
+		pvfci->pProgressSink->FinishOperations(hr);
+	}
+
+	if(pvfci->pac)
+	{
+		pvfci->pac->EndOperation(hr,NULL,dwEffect);
+	}
+
+	for(auto &stg : pvfci->Mediums)
+	{
+		ReleaseStgMedium(&stg);
+	}
+}
+
+/* Called on the original thread when the drop window is
+destroyed before the copy has finished. Everything that
+belongs to the window is released here. The rest is left
+for the copy thread, which is still using the mediums. */
+void CancelVirtualFileCopy(VirtualFileCopyInfo_t *pvfci)
+{
+	if(pvfci->pProgressSink)
+	{
+		pvfci->pProgressSink->FinishOperations(HRESULT_FROM_WIN32(ERROR_CANCELLED));
+		pvfci->pProgressSink.reset();
+	}
+
+	pvfci->pDropFilesCallback.reset();
+
+	if(pvfci->pac)
+	{
+		HRESULT hr = CoMarshalInterThreadInterfaceInStream(__uuidof(IDataObjectAsyncCapability),
+			pvfci->pac.get(),&pvfci->marshaledAsyncCapability);
+
+		if(FAILED(hr))
 		{
-			free(pBuffer);
+			/* Rather than leaving the drop source waiting,
+			end the operation now. */
+			pvfci->pac->EndOperation(HRESULT_FROM_WIN32(ERROR_CANCELLED),NULL,DROPEFFECT_NONE);
 		}
+
+		pvfci->pac.reset();
 	}
 
-	return hr;
+	pvfci->pDataObject.reset();
+
+	pvfci->bCancelled = true;
+}
+
+/* Called on the copy thread once a cancelled copy has
+stopped. Any files that were copied before the window was
+destroyed are left in place. */
+void FinishCancelledVirtualFileCopy(VirtualFileCopyInfo_t *pvfci)
+{
+	CoInitializeEx(NULL,COINIT_MULTITHREADED);
+
+	std::list<std::wstring> PastedFileList;
+	HRESULT hr = GetVirtualFileCopyResult(pvfci,PastedFileList);
+
+	if(pvfci->marshaledAsyncCapability)
+	{
+		wil::com_ptr<IDataObjectAsyncCapability> pac;
+		HRESULT hrUnmarshal = CoGetInterfaceAndReleaseStream(pvfci->marshaledAsyncCapability.detach(),
+			IID_PPV_ARGS(&pac));
+
+		if(SUCCEEDED(hrUnmarshal))
+		{
+			pac->EndOperation(hr,NULL,PastedFileList.empty() ? DROPEFFECT_NONE : DROPEFFECT_COPY);
+		}
+	}
+
+	for(auto &stg : pvfci->Mediums)
+	{
+		ReleaseStgMedium(&stg);
+	}
+
+	CoUninitialize();
+}
+
+LRESULT CALLBACK VirtualFileCopySubclass(HWND hwnd,UINT uMsg,
+WPARAM wParam,LPARAM lParam,UINT_PTR uIdSubclass,DWORD_PTR dwRefData)
+{
+	VirtualFileCopyInfo_t *pvfci = reinterpret_cast<VirtualFileCopyInfo_t *>(dwRefData);
+
+	/* Messages for other copies are passed on to their
+	own subclasses. */
+	switch(uMsg)
+	{
+	case WM_APP_VIRTUALFILECOPYPROGRESS:
+		if(wParam == uIdSubclass)
+		{
+			VirtualFileCopyProgress_t *pvfcp = reinterpret_cast<VirtualFileCopyProgress_t *>(lParam);
+
+			UINT uWorkTotal;
+			UINT uWorkSoFar;
+			NVirtualFileCopy::ScaleProgress(pvfcp->ullTotalBytes,pvfcp->ullBytesCopied,
+				uWorkTotal,uWorkSoFar);
+
+			HRESULT hr = pvfci->pProgressSink->UpdateProgress(uWorkTotal,uWorkSoFar);
+
+			/* Returning FALSE cancels the copy. */
+			return SUCCEEDED(hr);
+		}
+		break;
+
+	case WM_APP_VIRTUALFILECOPYFINISHED:
+		if(wParam == uIdSubclass)
+		{
+			FinishVirtualFileCopy(pvfci);
+			delete pvfci;
+
+			RemoveWindowSubclass(hwnd,VirtualFileCopySubclass,uIdSubclass);
+
+			/* Lets the copy thread know that pvfci has been
+			freed. */
+			return TRUE;
+		}
+		break;
+
+	/* The copy thread may still be running, so it takes over
+	the remaining cleanup. */
+	case WM_NCDESTROY:
+		CancelVirtualFileCopy(pvfci);
+		RemoveWindowSubclass(hwnd,VirtualFileCopySubclass,uIdSubclass);
+		break;
+	}
+
+	return DefSubclassProc(hwnd,uMsg,wParam,lParam);
 }
 
 HRESULT CDropHandler::CopyUnicodeTextData(IDataObject *pDataObject,
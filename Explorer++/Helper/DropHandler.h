@@ -5,6 +5,7 @@
 #pragma once
 
 #include <list>
+#include <wil/com.h>
 #include "Helper.h"
 #include "FileOperations.h"
 #include "ReferenceCount.h"
@@ -22,6 +23,8 @@ __interface IDropFilesCallback : public IUnknown
 	void OnDropFile(const std::list<std::wstring> &PastedFileList, const POINT *ppt);
 };
 
+struct VirtualFileCopyInfo_t;
+
 class CDropHandler : public CReferenceCount
 {
 public:
@@ -36,6 +39,12 @@ public:
 	void	Drop(IDataObject *pDataObject,DWORD grfKeyState,POINTL ptl,DWORD *pdwEffect,HWND hwndDrop,DragTypes_t DragType,TCHAR *szDestDirectory,IDropFilesCallback *pDropFilesCallback,BOOL bRenameOnCollision);
 	void	CopyClipboardData(IDataObject *pDataObject,HWND hwndDrop,TCHAR *szDestDirectory,IDropFilesCallback *pDropFilesCallback,BOOL bRenameOnCollision);
 
+	/* Virtual files (e.g. email attachments) are copied in the
+	background. If set, the sink will be notified of the progress
+	of the copy. It's always called on the thread the drop occurred
+	on. */
+	void	SetProgressSink(IFileOperationProgressSink *progressSink);
+
 private:
 
 	CDropHandler() = default;
@@ -51,6 +60,7 @@ private:
 	HRESULT CopyAnsiFileDescriptorData(IDataObject *pDataObject,std::list<std::wstring> &PastedFileList);
 	HRESULT CopyUnicodeFileDescriptorData(IDataObject *pDataObject,std::list<std::wstring> &PastedFileList);
 	HRESULT CopyFileDescriptorData(IDataObject *pDataObject,FILEGROUPDESCRIPTORW *pfgd,std::list<std::wstring> &PastedFileList);
+	HRESULT	StartVirtualFileCopy(VirtualFileCopyInfo_t *pvfci,IDataObject *pDataObject);
 	HRESULT	CopyUnicodeTextData(IDataObject *pDataObject,std::list<std::wstring> &PastedFileList);
 	HRESULT	CopyAnsiTextData(IDataObject *pDataObject,std::list<std::wstring> &PastedFileList);
 	HRESULT	CopyDIBV5Data(IDataObject *pDataObject,std::list<std::wstring> &PastedFileList);
@@ -79,4 +89,6 @@ private:
 	DragTypes_t			m_DragType;
 	TCHAR				*m_szDestDirectory;
 	BOOL				m_bRenameOnCollision;
+
+	wil::com_ptr<IFileOperationProgressSink>	m_progressSink;
 };
\ No newline at end of file
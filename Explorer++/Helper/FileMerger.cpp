@@ -0,0 +1,498 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "FileMerger.h"
+#include <boost/crc.hpp>
+#include <thread>
+
+namespace
+{
+	class FileMergeInputImpl : public FileMergeInput
+	{
+	public:
+
+		FileMergeInputImpl(HANDLE file, std::uint64_t size) :
+			m_file(file),
+			m_size(size)
+		{
+		}
+
+		~FileMergeInputImpl()
+		{
+			CloseHandle(m_file);
+		}
+
+		std::uint64_t GetSize() const override
+		{
+			return m_size;
+		}
+
+		bool Read(void *buffer, std::size_t size, std::size_t &bytesRead) override
+		{
+			bytesRead = 0;
+
+			/* ReadFile can only read up to 4GB at a time. */
+			while (bytesRead < size)
+			{
+				DWORD bytesToRead = static_cast<DWORD>((std::min)(size - bytesRead, static_cast<std::size_t>(MAXDWORD)));
+				DWORD numBytesRead;
+				BOOL res = ReadFile(m_file, static_cast<std::uint8_t *>(buffer) + bytesRead, bytesToRead,
+					&numBytesRead, nullptr);
+
+				if (!res)
+				{
+					return false;
+				}
+
+				bytesRead += numBytesRead;
+
+				/* A short read means that the end of the file has been
+				reached. Another read shouldn't be attempted, since, for a
+				file opened without buffering, the remaining size and the
+				position in the buffer will no longer be sector aligned and
+				the read would fail. */
+				if (numBytesRead < bytesToRead)
+				{
+					break;
+				}
+			}
+
+			return true;
+		}
+
+	private:
+
+		const HANDLE m_file;
+		const std::uint64_t m_size;
+	};
+
+	class FileMergeOutputImpl : public FileMergeOutput
+	{
+	public:
+
+		FileMergeOutputImpl(HANDLE file) :
+			m_file(file)
+		{
+		}
+
+		~FileMergeOutputImpl()
+		{
+			CloseHandle(m_file);
+		}
+
+		bool Write(const void *buffer, std::size_t size) override
+		{
+			std::size_t bytesWritten = 0;
+
+			while (bytesWritten < size)
+			{
+				DWORD bytesToWrite = static_cast<DWORD>((std::min)(size - bytesWritten, static_cast<std::size_t>(MAXDWORD)));
+				DWORD numBytesWritten;
+				BOOL res = WriteFile(m_file, static_cast<const std::uint8_t *>(buffer) + bytesWritten, bytesToWrite,
+					&numBytesWritten, nullptr);
+
+				if (!res || numBytesWritten == 0)
+				{
+					return false;
+				}
+
+				bytesWritten += numBytesWritten;
+			}
+
+			return true;
+		}
+
+	private:
+
+		const HANDLE m_file;
+	};
+
+	std::unique_ptr<FileMergeInput> OpenFileMergeInputWithFlags(const std::wstring &path, DWORD flags)
+	{
+		HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			flags, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+
+		LARGE_INTEGER size;
+
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		return std::make_unique<FileMergeInputImpl>(file, size.QuadPart);
+	}
+}
+
+std::unique_ptr<FileMergeInput> OpenFileMergeInput(const std::wstring &path)
+{
+	return OpenFileMergeInputWithFlags(path, FILE_FLAG_SEQUENTIAL_SCAN);
+}
+
+std::unique_ptr<FileMergeInput> OpenUnbufferedFileMergeInput(const std::wstring &path)
+{
+	return OpenFileMergeInputWithFlags(path, FILE_FLAG_NO_BUFFERING);
+}
+
+std::unique_ptr<FileMergeOutput> CreateFileMergeOutput(const std::wstring &path)
+{
+	HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+
+	return std::make_unique<FileMergeOutputImpl>(file);
+}
+
+void FileMerger::BufferDeleter::operator()(std::uint8_t *buffer) const
+{
+	VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+FileMerger::FileMerger(const std::wstring &outputFile, const std::vector<std::wstring> &inputFiles,
+	const Options &options, OpenInput openInput, CreateOutput createOutput) :
+	m_outputFile(outputFile),
+	m_inputFiles(inputFiles),
+	m_options(options),
+	m_openInput(openInput),
+	m_createOutput(createOutput),
+	m_stop(false),
+	m_readingFinished(false),
+	m_readResult(Result::Succeeded),
+	m_checksum(0)
+{
+}
+
+FileMerger::~FileMerger() = default;
+
+FileMerger::Result FileMerger::Merge(ProgressCallback progressCallback)
+{
+	/* Each of the input files is opened up front, so that the total size
+	is known (for progress updates) and so that the output file isn't
+	created if one of the input files can't be opened. */
+	std::vector<std::unique_ptr<FileMergeInput>> inputs;
+	std::uint64_t totalBytes = 0;
+
+	for (const auto &inputFile : m_inputFiles)
+	{
+		auto input = m_openInput(inputFile);
+
+		if (!input)
+		{
+			return Result::InputFileInvalid;
+		}
+
+		totalBytes += input->GetSize();
+		inputs.push_back(std::move(input));
+	}
+
+	/* Buffers are allocated with VirtualAlloc, so that they're page
+	aligned and don't fragment the heap. As with the input files, this
+	is done before the output file is created. */
+	for (int i = 0; i < m_options.numBuffers; i++)
+	{
+		auto buffer = static_cast<std::uint8_t *>(VirtualAlloc(nullptr, m_options.bufferSize,
+			MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+		if (!buffer)
+		{
+			return Result::OutOfMemory;
+		}
+
+		m_buffers.emplace_back(buffer);
+		m_freeBuffers.push_back(i);
+	}
+
+	auto output = m_createOutput(m_outputFile);
+
+	if (!output)
+	{
+		return Result::OutputFileInvalid;
+	}
+
+	std::thread reader(&FileMerger::ReaderMain, this, std::ref(inputs));
+
+	boost::crc_32_type checksum;
+	Result result = Result::Succeeded;
+	Progress progress = { 0, totalBytes, 0, 0 };
+	auto startTime = std::chrono::steady_clock::now();
+	auto lastProgressTime = startTime;
+
+	auto updateProgress = [&] (std::chrono::steady_clock::time_point now) {
+		std::chrono::duration<double> elapsed = now - startTime;
+
+		if (elapsed.count() > 0)
+		{
+			progress.bytesPerSecond = progress.bytesWritten / elapsed.count();
+		}
+
+		if (progressCallback)
+		{
+			progressCallback(progress);
+		}
+
+		lastProgressTime = now;
+	};
+
+	Chunk chunk;
+
+	while (TakeChunk(chunk))
+	{
+		if (chunk.bufferIndex == -1)
+		{
+			progress.filesMerged++;
+			continue;
+		}
+
+		const std::uint8_t *data = m_buffers[chunk.bufferIndex].get();
+		bool written = output->Write(data, chunk.size);
+
+		if (written && m_options.verify)
+		{
+			checksum.process_bytes(data, chunk.size);
+		}
+
+		ReturnFreeBuffer(chunk.bufferIndex);
+
+		if (!written)
+		{
+			result = Result::WriteFailed;
+			Stop();
+			break;
+		}
+
+		progress.bytesWritten += chunk.size;
+
+		auto now = std::chrono::steady_clock::now();
+
+		if (now - lastProgressTime >= PROGRESS_INTERVAL)
+		{
+			updateProgress(now);
+		}
+	}
+
+	reader.join();
+
+	if (result == Result::Succeeded)
+	{
+		result = m_readResult;
+	}
+
+	if (result == Result::Succeeded && m_stop)
+	{
+		result = Result::Stopped;
+	}
+
+	updateProgress(std::chrono::steady_clock::now());
+
+	output.reset();
+
+	if (result == Result::Succeeded && m_options.verify)
+	{
+		m_checksum = checksum.checksum();
+		result = Verify();
+	}
+
+	return result;
+}
+
+void FileMerger::ReaderMain(std::vector<std::unique_ptr<FileMergeInput>> &inputs)
+{
+	for (std::size_t i = 0; i < inputs.size(); i++)
+	{
+		auto &input = inputs[i];
+		boost::crc_32_type inputChecksum;
+
+		while (true)
+		{
+			int bufferIndex;
+
+			if (!TakeFreeBuffer(bufferIndex))
+			{
+				FinishReading(Result::Stopped);
+				return;
+			}
+
+			std::size_t bytesRead;
+			bool res = input->Read(m_buffers[bufferIndex].get(), m_options.bufferSize, bytesRead);
+
+			if (!res)
+			{
+				ReturnFreeBuffer(bufferIndex);
+				FinishReading(Result::ReadFailed);
+				return;
+			}
+
+			if (bytesRead == 0)
+			{
+				ReturnFreeBuffer(bufferIndex);
+				break;
+			}
+
+			if (m_options.manifest)
+			{
+				inputChecksum.process_bytes(m_buffers[bufferIndex].get(), bytesRead);
+			}
+
+			AddChunk({ bufferIndex, bytesRead });
+
+			if (bytesRead < m_options.bufferSize)
+			{
+				break;
+			}
+		}
+
+		/* The file is closed as soon as it's been read. */
+		input.reset();
+
+		if (m_options.manifest)
+		{
+			auto expectedChecksum = m_options.manifest->GetChecksum(PathFindFileName(m_inputFiles[i].c_str()));
+
+			if (!expectedChecksum || *expectedChecksum != inputChecksum.checksum())
+			{
+				FinishReading(Result::VerificationFailed);
+				return;
+			}
+		}
+
+		AddChunk({ -1, 0 });
+	}
+
+	FinishReading(Result::Succeeded);
+}
+
+bool FileMerger::TakeFreeBuffer(int &bufferIndex)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this] { return m_stop || !m_freeBuffers.empty(); });
+
+	if (m_stop)
+	{
+		return false;
+	}
+
+	bufferIndex = m_freeBuffers.front();
+	m_freeBuffers.pop_front();
+
+	return true;
+}
+
+void FileMerger::ReturnFreeBuffer(int bufferIndex)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_freeBuffers.push_back(bufferIndex);
+	}
+
+	m_condition.notify_all();
+}
+
+void FileMerger::AddChunk(Chunk chunk)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_chunks.push_back(chunk);
+	}
+
+	m_condition.notify_all();
+}
+
+bool FileMerger::TakeChunk(Chunk &chunk)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this] { return m_stop || !m_chunks.empty() || m_readingFinished; });
+
+	if (m_stop || m_chunks.empty())
+	{
+		return false;
+	}
+
+	chunk = m_chunks.front();
+	m_chunks.pop_front();
+
+	return true;
+}
+
+void FileMerger::FinishReading(Result result)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_readingFinished = true;
+		m_readResult = result;
+	}
+
+	m_condition.notify_all();
+}
+
+FileMerger::Result FileMerger::Verify()
+{
+	auto output = m_openInput(m_outputFile);
+
+	if (!output)
+	{
+		return Result::VerificationFailed;
+	}
+
+	boost::crc_32_type checksum;
+	std::uint8_t *buffer = m_buffers[0].get();
+
+	while (true)
+	{
+		if (m_stop)
+		{
+			return Result::Stopped;
+		}
+
+		std::size_t bytesRead;
+
+		if (!output->Read(buffer, m_options.bufferSize, bytesRead))
+		{
+			return Result::VerificationFailed;
+		}
+
+		if (bytesRead == 0)
+		{
+			break;
+		}
+
+		checksum.process_bytes(buffer, bytesRead);
+	}
+
+	if (checksum.checksum() != m_checksum)
+	{
+		return Result::VerificationFailed;
+	}
+
+	return Result::Succeeded;
+}
+
+void FileMerger::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_condition.notify_all();
+}
+
+std::size_t FileMerger::GetBufferMemorySize() const
+{
+	return m_options.bufferSize * m_options.numBuffers;
+}
+
+std::uint32_t FileMerger::GetChecksum() const
+{
+	return m_checksum;
+}
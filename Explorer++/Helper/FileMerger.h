@@ -0,0 +1,185 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "ChecksumManifest.h"
+#include <boost/optional.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A file that's read as part of a merge.
+class FileMergeInput
+{
+public:
+
+	virtual ~FileMergeInput() = default;
+
+	virtual std::uint64_t GetSize() const = 0;
+
+	// Reads up to the specified number of bytes. bytesRead will only be
+	// less than size once the end of the file has been reached.
+	virtual bool Read(void *buffer, std::size_t size, std::size_t &bytesRead) = 0;
+};
+
+// The file that's written by a merge.
+class FileMergeOutput
+{
+public:
+
+	virtual ~FileMergeOutput() = default;
+
+	virtual bool Write(const void *buffer, std::size_t size) = 0;
+};
+
+// Returns null if the file couldn't be opened.
+std::unique_ptr<FileMergeInput> OpenFileMergeInput(const std::wstring &path);
+
+// Opens the file for unbuffered access. Each read must then be a multiple
+// of the sector size and the buffer must be sector aligned.
+std::unique_ptr<FileMergeInput> OpenUnbufferedFileMergeInput(const std::wstring &path);
+
+// Returns null if the file couldn't be created (including when it
+// already exists).
+std::unique_ptr<FileMergeOutput> CreateFileMergeOutput(const std::wstring &path);
+
+// Concatenates a set of files into a single output file, using a fixed
+// amount of memory, regardless of how large the input files are.
+//
+// The data is passed through a fixed pool of page-aligned buffers. A
+// separate thread fills the buffers from the input files, while the
+// calling thread writes them out, so the next buffer (which may belong to
+// the next input file) is read while the current one is being written.
+class FileMerger
+{
+public:
+
+	enum class Result
+	{
+		Succeeded,
+		Stopped,
+		OutputFileInvalid,
+		InputFileInvalid,
+		ReadFailed,
+		WriteFailed,
+		VerificationFailed,
+
+		// The buffers couldn't be allocated. The output file won't have
+		// been created.
+		OutOfMemory
+	};
+
+	static constexpr std::size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+	static constexpr int DEFAULT_NUM_BUFFERS = 4;
+
+	struct Options
+	{
+		std::size_t bufferSize = DEFAULT_BUFFER_SIZE;
+		int numBuffers = DEFAULT_NUM_BUFFERS;
+
+		// If set, the output file will be read back once it's been
+		// written and its checksum compared against the checksum of the
+		// input files.
+		bool verify = false;
+
+		// If set, the checksum of each input file will be compared against
+		// the entry for that file in the manifest, as the file is read.
+		boost::optional<ChecksumManifest> manifest;
+	};
+
+	struct Progress
+	{
+		std::uint64_t bytesWritten;
+		std::uint64_t totalBytes;
+		std::size_t filesMerged;
+		double bytesPerSecond;
+	};
+
+	using OpenInput = std::function<std::unique_ptr<FileMergeInput>(const std::wstring &path)>;
+	using CreateOutput = std::function<std::unique_ptr<FileMergeOutput>(const std::wstring &path)>;
+
+	// Invoked on the thread that called Merge, at most once every
+	// PROGRESS_INTERVAL and once more when the merge has finished.
+	using ProgressCallback = std::function<void(const Progress &progress)>;
+
+	FileMerger(const std::wstring &outputFile, const std::vector<std::wstring> &inputFiles,
+		const Options &options, OpenInput openInput = OpenFileMergeInput,
+		CreateOutput createOutput = CreateFileMergeOutput);
+	~FileMerger();
+
+	FileMerger(const FileMerger &) = delete;
+	FileMerger &operator=(const FileMerger &) = delete;
+
+	// Performs the merge and returns once it's complete. Should only be
+	// called once.
+	Result Merge(ProgressCallback progressCallback);
+
+	// May be called from any thread.
+	void Stop();
+
+	// The total amount of memory used for buffers, which is allocated up
+	// front.
+	std::size_t GetBufferMemorySize() const;
+
+	// The CRC-32 of the merged data. Only calculated if verification was
+	// requested.
+	std::uint32_t GetChecksum() const;
+
+private:
+
+	static constexpr std::chrono::milliseconds PROGRESS_INTERVAL = std::chrono::milliseconds(100);
+
+	struct BufferDeleter
+	{
+		void operator()(std::uint8_t *buffer) const;
+	};
+
+	using Buffer = std::unique_ptr<std::uint8_t, BufferDeleter>;
+
+	// A filled buffer, or (if bufferIndex is -1) a marker indicating that
+	// the end of an input file has been reached.
+	struct Chunk
+	{
+		int bufferIndex;
+		std::size_t size;
+	};
+
+	void ReaderMain(std::vector<std::unique_ptr<FileMergeInput>> &inputs);
+	bool TakeFreeBuffer(int &bufferIndex);
+	void ReturnFreeBuffer(int bufferIndex);
+	void AddChunk(Chunk chunk);
+	bool TakeChunk(Chunk &chunk);
+	void FinishReading(Result result);
+	Result Verify();
+
+	const std::wstring m_outputFile;
+	const std::vector<std::wstring> m_inputFiles;
+	const Options m_options;
+	const OpenInput m_openInput;
+	const CreateOutput m_createOutput;
+
+	std::vector<Buffer> m_buffers;
+
+	std::atomic<bool> m_stop;
+
+	// Protects each of the members below. Buffers move from the free list,
+	// to the reader thread, to the list of chunks, to the writing thread
+	// and back to the free list.
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<int> m_freeBuffers;
+	std::deque<Chunk> m_chunks;
+	bool m_readingFinished;
+	Result m_readResult;
+
+	std::uint32_t m_checksum;
+};
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "FileShredder.h"
 #include <list>
 #include <vector>
 
@@ -17,6 +18,7 @@ namespace NFileOperations
 
 	HRESULT	RenameFile(IShellItem *item, const std::wstring &newName);
 	HRESULT	DeleteFiles(HWND hwnd, std::vector<PCIDLIST_ABSOLUTE> &pidls, bool permanent, bool silent);
+	std::vector<FileShredder::Pattern>	GetOverwritePasses(OverwriteMethod_t uOverwriteMethod);
 	void	DeleteFileSecurely(const std::wstring &strFilename,OverwriteMethod_t uOverwriteMethod);
 	HRESULT	CopyFilesToFolder(HWND hOwner, const std::wstring &strTitle, std::vector<PCIDLIST_ABSOLUTE> &pidls, bool move);
 	HRESULT	CopyFiles(HWND hwnd, IShellItem *destinationFolder, std::vector<PCIDLIST_ABSOLUTE> &pidls, bool move);
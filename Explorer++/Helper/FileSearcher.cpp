@@ -0,0 +1,399 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "FileSearcher.h"
+#include "StringHelper.h"
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+	std::wstring CombinePath(const std::wstring &directory, const std::wstring &name)
+	{
+		std::wstring path = directory;
+
+		if (!path.empty() && path.back() != '\\')
+		{
+			path += '\\';
+		}
+
+		path += name;
+
+		return path;
+	}
+}
+
+bool EnumerateDirectoryEntries(const std::wstring &path, std::vector<FileSearchEntry> &entries)
+{
+	WIN32_FIND_DATA wfd;
+	HANDLE hFindFile = FindFirstFileEx(CombinePath(path, L"*").c_str(), FindExInfoBasic, &wfd,
+		FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+
+	if (hFindFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	do
+	{
+		if (lstrcmp(wfd.cFileName, _T(".")) == 0 || lstrcmp(wfd.cFileName, _T("..")) == 0)
+		{
+			continue;
+		}
+
+		entries.push_back({ wfd.cFileName, wfd.dwFileAttributes });
+	} while (FindNextFile(hFindFile, &wfd) != 0);
+
+	FindClose(hFindFile);
+
+	return true;
+}
+
+FileNameMatcher::FileNameMatcher(const std::wstring &pattern, bool useRegularExpressions, bool caseInsensitive) :
+	m_pattern(pattern),
+	m_useRegularExpressions(useRegularExpressions),
+	m_caseInsensitive(caseInsensitive),
+	m_wildcardPattern(useRegularExpressions ? std::wstring_view() : pattern, !caseInsensitive)
+{
+	if (m_useRegularExpressions && !m_pattern.empty())
+	{
+		auto flags = std::regex_constants::ECMAScript | std::regex_constants::optimize;
+
+		if (m_caseInsensitive)
+		{
+			flags |= std::regex_constants::icase;
+		}
+
+		m_regex.assign(m_pattern, flags);
+	}
+}
+
+bool FileNameMatcher::Matches(const std::wstring &name) const
+{
+	if (m_pattern.empty())
+	{
+		return true;
+	}
+
+	if (m_useRegularExpressions)
+	{
+		return std::regex_match(name, m_regex);
+	}
+
+	return m_wildcardPattern.Matches(name);
+}
+
+int FileSearcher::GetDefaultNumThreads()
+{
+	// Searching is largely I/O bound, so a small number of threads is
+	// enough to keep the disk busy.
+	unsigned int numThreads = std::thread::hardware_concurrency();
+	return static_cast<int>((std::max)(2U, (std::min)(numThreads, 8U)));
+}
+
+FileSearcher::FileSearcher(const Options &options, int numThreads, std::size_t maxBufferedResults,
+	EnumerateDirectory enumerateDirectory) :
+	m_options(options),
+	m_numThreads((std::max)(numThreads, 1)),
+	m_enumerateDirectory(enumerateDirectory),
+	m_stopSearching(false),
+	m_numActiveWorkers(0),
+	m_numRunningWorkers(0),
+	m_finished(false),
+	m_results((std::max)(maxBufferedResults, static_cast<std::size_t>(1))),
+	m_numDirectoriesSearched(0),
+	m_numEntriesExamined(0),
+	m_numFoldersFound(0),
+	m_numFilesFound(0)
+{
+
+}
+
+FileSearcher::~FileSearcher()
+{
+	Stop();
+
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+bool FileSearcher::Start(CompletionCallback completionCallback)
+{
+	try
+	{
+		// Each thread will construct its own matcher. This is simply done
+		// to verify that the pattern is valid.
+		FileNameMatcher matcher(m_options.pattern, m_options.useRegularExpressions, m_options.caseInsensitive);
+	}
+	catch (const std::regex_error &)
+	{
+		return false;
+	}
+
+	m_completionCallback = completionCallback;
+
+	m_pendingDirectories.push_back(m_options.baseDirectory);
+	m_numRunningWorkers = m_numThreads;
+
+	for (int i = 0; i < m_numThreads; i++)
+	{
+		m_workers.emplace_back(&FileSearcher::WorkerMain, this);
+	}
+
+	return true;
+}
+
+void FileSearcher::Stop()
+{
+	// The flag is set while each of the mutexes is held, so that a
+	// thread that's about to wait can't miss the change.
+	{
+		std::lock_guard<std::mutex> directoriesLock(m_directoriesMutex);
+		std::lock_guard<std::mutex> resultsLock(m_resultsMutex);
+		m_stopSearching = true;
+	}
+
+	m_directoriesCondition.notify_all();
+	m_resultsSpaceCondition.notify_all();
+}
+
+void FileSearcher::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_directoriesMutex);
+	m_directoriesCondition.wait(lock, [this] {
+		return m_finished || m_workers.empty();
+	});
+}
+
+std::vector<FileSearcher::Result> FileSearcher::TakeResults(std::size_t maxResults)
+{
+	std::vector<Result> results;
+
+	{
+		std::lock_guard<std::mutex> lock(m_resultsMutex);
+
+		std::size_t numResults = (std::min)(maxResults, m_results.size());
+		results.reserve(numResults);
+
+		for (std::size_t i = 0; i < numResults; i++)
+		{
+			results.push_back(std::move(m_results.front()));
+			m_results.pop_front();
+		}
+	}
+
+	if (!results.empty())
+	{
+		m_resultsSpaceCondition.notify_all();
+	}
+
+	return results;
+}
+
+bool FileSearcher::IsFinished() const
+{
+	std::lock_guard<std::mutex> lock(m_directoriesMutex);
+	return m_finished;
+}
+
+FileSearcher::Statistics FileSearcher::GetStatistics() const
+{
+	Statistics statistics;
+	statistics.numDirectoriesSearched = m_numDirectoriesSearched;
+	statistics.numEntriesExamined = m_numEntriesExamined;
+	statistics.numFoldersFound = m_numFoldersFound;
+	statistics.numFilesFound = m_numFilesFound;
+	return statistics;
+}
+
+std::wstring FileSearcher::GetCurrentSearchDirectory() const
+{
+	std::lock_guard<std::mutex> lock(m_currentDirectoryMutex);
+	return m_currentDirectory;
+}
+
+void FileSearcher::WorkerMain()
+{
+	// The pattern has already been validated, so this won't throw.
+	FileNameMatcher matcher(m_options.pattern, m_options.useRegularExpressions, m_options.caseInsensitive);
+
+	std::wstring directory;
+
+	while (TakeDirectory(directory))
+	{
+		SearchDirectory(directory, matcher);
+		FinishDirectory();
+	}
+
+	FinishWorker();
+}
+
+bool FileSearcher::TakeDirectory(std::wstring &directory)
+{
+	std::unique_lock<std::mutex> lock(m_directoriesMutex);
+
+	m_directoriesCondition.wait(lock, [this] {
+		return m_stopSearching || !m_pendingDirectories.empty() || m_numActiveWorkers == 0;
+	});
+
+	// If there are no directories left and no other thread is searching
+	// a directory, there's nothing else to do.
+	if (m_stopSearching || m_pendingDirectories.empty())
+	{
+		return false;
+	}
+
+	// Directories are taken from the back of the queue, so the tree is
+	// searched (roughly) depth-first. That keeps the number of pending
+	// directories small.
+	directory = std::move(m_pendingDirectories.back());
+	m_pendingDirectories.pop_back();
+	m_numActiveWorkers++;
+
+	return true;
+}
+
+void FileSearcher::FinishDirectory()
+{
+	bool searchFinished;
+
+	{
+		std::lock_guard<std::mutex> lock(m_directoriesMutex);
+		m_numActiveWorkers--;
+		searchFinished = (m_numActiveWorkers == 0 && m_pendingDirectories.empty());
+	}
+
+	if (searchFinished)
+	{
+		m_directoriesCondition.notify_all();
+	}
+}
+
+void FileSearcher::SearchDirectory(const std::wstring &directory, const FileNameMatcher &matcher)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_currentDirectoryMutex);
+		m_currentDirectory = directory;
+	}
+
+	std::vector<FileSearchEntry> entries;
+	m_enumerateDirectory(directory, entries);
+
+	m_numDirectoriesSearched++;
+	m_numEntriesExamined += entries.size();
+
+	std::vector<std::wstring> subdirectories;
+
+	for (const auto &entry : entries)
+	{
+		if (m_stopSearching)
+		{
+			return;
+		}
+
+		bool isFolder = ((entry.attributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY);
+
+		if (MatchesAttributes(entry.attributes) && matcher.Matches(entry.name))
+		{
+			if (isFolder)
+			{
+				m_numFoldersFound++;
+			}
+			else
+			{
+				m_numFilesFound++;
+			}
+
+			if (!AddResult({ CombinePath(directory, entry.name), isFolder }))
+			{
+				return;
+			}
+		}
+
+		// Junctions aren't followed, as they could lead to the same items
+		// being found more than once (or to a cycle).
+		if (isFolder && m_options.searchSubFolders
+			&& (entry.attributes & FILE_ATTRIBUTE_REPARSE_POINT) != FILE_ATTRIBUTE_REPARSE_POINT)
+		{
+			subdirectories.push_back(CombinePath(directory, entry.name));
+		}
+	}
+
+	if (subdirectories.empty())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_directoriesMutex);
+
+		// Added in reverse, so that they're taken in their original
+		// order.
+		std::move(subdirectories.rbegin(), subdirectories.rend(), std::back_inserter(m_pendingDirectories));
+	}
+
+	if (subdirectories.size() > 1)
+	{
+		m_directoriesCondition.notify_all();
+	}
+	else
+	{
+		m_directoriesCondition.notify_one();
+	}
+}
+
+bool FileSearcher::MatchesAttributes(DWORD attributes) const
+{
+	return (attributes & m_options.attributes) == m_options.attributes;
+}
+
+// Blocks while the result buffer is full. Returns false if the search
+// was stopped in the meantime.
+bool FileSearcher::AddResult(Result result)
+{
+	std::unique_lock<std::mutex> lock(m_resultsMutex);
+
+	m_resultsSpaceCondition.wait(lock, [this] {
+		return m_stopSearching || !m_results.full();
+	});
+
+	if (m_stopSearching)
+	{
+		return false;
+	}
+
+	m_results.push_back(std::move(result));
+
+	return true;
+}
+
+void FileSearcher::FinishWorker()
+{
+	bool lastWorker;
+
+	{
+		std::lock_guard<std::mutex> lock(m_directoriesMutex);
+		lastWorker = (--m_numRunningWorkers == 0);
+	}
+
+	if (!lastWorker)
+	{
+		return;
+	}
+
+	if (m_completionCallback)
+	{
+		m_completionCallback(m_stopSearching);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_directoriesMutex);
+		m_finished = true;
+	}
+
+	m_directoriesCondition.notify_all();
+}
@@ -0,0 +1,178 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "StringHelper.h"
+#include <boost/circular_buffer.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FileSearchEntry
+{
+	std::wstring name;
+	DWORD attributes;
+};
+
+// Retrieves the items contained within a directory (excluding the "."
+// and ".." entries).
+bool EnumerateDirectoryEntries(const std::wstring &path, std::vector<FileSearchEntry> &entries);
+
+// Determines whether an item name matches a search pattern. Each search
+// thread creates its own matcher, so that no state is shared between
+// threads while matching.
+class FileNameMatcher
+{
+public:
+
+	// Throws std::regex_error if regular expressions are being used and
+	// the pattern is invalid.
+	FileNameMatcher(const std::wstring &pattern, bool useRegularExpressions, bool caseInsensitive);
+
+	bool Matches(const std::wstring &name) const;
+
+private:
+
+	const std::wstring m_pattern;
+	const bool m_useRegularExpressions;
+	const bool m_caseInsensitive;
+	std::wregex m_regex;
+	WildcardPattern m_wildcardPattern;
+};
+
+// Searches a directory tree for items that match a pattern and set of
+// attributes.
+//
+// Directories are searched by a pool of threads, each of which takes the
+// next directory from a shared queue and adds any subdirectories it finds
+// back onto the queue. Matching items are placed into a bounded buffer,
+// from which they can be removed in batches (e.g. on a timer). If the
+// buffer fills up, the search threads will wait until there's space, so
+// the amount of memory used is bounded, even if there are a very large
+// number of results.
+//
+// This class doesn't depend on any UI, so it can also be used (and
+// measured) on its own.
+class FileSearcher
+{
+public:
+
+	struct Options
+	{
+		std::wstring baseDirectory;
+
+		// If empty, all items will match.
+		std::wstring pattern;
+
+		bool useRegularExpressions = false;
+		bool caseInsensitive = false;
+		bool searchSubFolders = true;
+
+		// Items must have all of these attributes in order to match.
+		DWORD attributes = 0;
+	};
+
+	struct Result
+	{
+		std::wstring path;
+		bool isFolder;
+	};
+
+	struct Statistics
+	{
+		std::uint64_t numDirectoriesSearched = 0;
+		std::uint64_t numEntriesExamined = 0;
+		int numFoldersFound = 0;
+		int numFilesFound = 0;
+	};
+
+	using EnumerateDirectory = std::function<bool(const std::wstring &path, std::vector<FileSearchEntry> &entries)>;
+
+	// Invoked on one of the search threads, once the search has either
+	// finished or been stopped. There may still be results in the buffer
+	// at that point.
+	using CompletionCallback = std::function<void(bool stopped)>;
+
+	static constexpr std::size_t DEFAULT_MAX_BUFFERED_RESULTS = 10000;
+
+	static int GetDefaultNumThreads();
+
+	FileSearcher(const Options &options, int numThreads, std::size_t maxBufferedResults = DEFAULT_MAX_BUFFERED_RESULTS,
+		EnumerateDirectory enumerateDirectory = EnumerateDirectoryEntries);
+	~FileSearcher();
+
+	FileSearcher(const FileSearcher &) = delete;
+	FileSearcher &operator=(const FileSearcher &) = delete;
+
+	// Returns false if the search pattern is an invalid regular
+	// expression, in which case the search won't be started. Should only
+	// be called once.
+	bool Start(CompletionCallback completionCallback);
+
+	// Causes each of the search threads to finish as soon as possible.
+	void Stop();
+
+	// Waits for the search to finish. If the result buffer fills up,
+	// results will need to be removed on another thread, or this will
+	// never return.
+	void Wait();
+
+	// Removes up to the specified number of results from the buffer.
+	std::vector<Result> TakeResults(std::size_t maxResults);
+
+	bool IsFinished() const;
+	Statistics GetStatistics() const;
+
+	// Returns the directory that was most recently started. This is
+	// intended for status messages only.
+	std::wstring GetCurrentSearchDirectory() const;
+
+private:
+
+	void WorkerMain();
+	bool TakeDirectory(std::wstring &directory);
+	void FinishDirectory();
+	void SearchDirectory(const std::wstring &directory, const FileNameMatcher &matcher);
+	bool MatchesAttributes(DWORD attributes) const;
+	bool AddResult(Result result);
+	void FinishWorker();
+
+	const Options m_options;
+	const int m_numThreads;
+	const EnumerateDirectory m_enumerateDirectory;
+	CompletionCallback m_completionCallback;
+
+	std::vector<std::thread> m_workers;
+	std::atomic<bool> m_stopSearching;
+
+	// The directories that are yet to be searched. The search is finished
+	// once this is empty and no thread is searching a directory (since
+	// that directory may contain further subdirectories).
+	mutable std::mutex m_directoriesMutex;
+	std::condition_variable m_directoriesCondition;
+	std::deque<std::wstring> m_pendingDirectories;
+	int m_numActiveWorkers;
+	int m_numRunningWorkers;
+	bool m_finished;
+
+	mutable std::mutex m_resultsMutex;
+	std::condition_variable m_resultsSpaceCondition;
+	boost::circular_buffer<Result> m_results;
+
+	std::atomic<std::uint64_t> m_numDirectoriesSearched;
+	std::atomic<std::uint64_t> m_numEntriesExamined;
+	std::atomic<int> m_numFoldersFound;
+	std::atomic<int> m_numFilesFound;
+
+	mutable std::mutex m_currentDirectoryMutex;
+	std::wstring m_currentDirectory;
+};
@@ -0,0 +1,438 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "FileShredder.h"
+#include "DriveInfo.h"
+#include "Macros.h"
+#include <algorithm>
+
+namespace
+{
+	class ShredTargetImpl : public ShredTarget
+	{
+	public:
+
+		ShredTargetImpl(const std::wstring &path, HANDLE file, std::uint64_t size) :
+			m_path(path),
+			m_file(file),
+			m_size(size)
+		{
+		}
+
+		~ShredTargetImpl()
+		{
+			CloseFile();
+		}
+
+		std::uint64_t GetSize() const override
+		{
+			return m_size;
+		}
+
+		bool Write(std::uint64_t offset, const void *buffer, std::size_t size) override
+		{
+			OVERLAPPED overlapped = GetOverlapped(offset);
+			DWORD numBytesWritten;
+			BOOL res = WriteFile(m_file, buffer, static_cast<DWORD>(size), &numBytesWritten, &overlapped);
+			return res && numBytesWritten == size;
+		}
+
+		bool Read(std::uint64_t offset, void *buffer, std::size_t size) override
+		{
+			OVERLAPPED overlapped = GetOverlapped(offset);
+			DWORD numBytesRead;
+			BOOL res = ReadFile(m_file, buffer, static_cast<DWORD>(size), &numBytesRead, &overlapped);
+			return res && numBytesRead == size;
+		}
+
+		bool Flush() override
+		{
+			return FlushFileBuffers(m_file) != FALSE;
+		}
+
+		bool Delete() override
+		{
+			CloseFile();
+			return DeleteFile(m_path.c_str()) != FALSE;
+		}
+
+	private:
+
+		/* The file is opened for synchronous access, so the offset
+		given here simply determines where the read or write begins. */
+		static OVERLAPPED GetOverlapped(std::uint64_t offset)
+		{
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			return overlapped;
+		}
+
+		void CloseFile()
+		{
+			if (m_file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(m_file);
+				m_file = INVALID_HANDLE_VALUE;
+			}
+		}
+
+		const std::wstring m_path;
+		HANDLE m_file;
+		const std::uint64_t m_size;
+	};
+
+	BOOL GetFileClusterSize(const std::wstring &strFilename, PLARGE_INTEGER lpRealFileSize)
+	{
+		DWORD dwClusterSize;
+
+		LARGE_INTEGER lFileSize;
+		BOOL bRet = GetFileSizeEx(strFilename.c_str(), &lFileSize);
+
+		if(!bRet)
+		{
+			return FALSE;
+		}
+
+		TCHAR szRoot[MAX_PATH];
+		HRESULT hr = StringCchCopy(szRoot, SIZEOF_ARRAY(szRoot), strFilename.c_str());
+
+		if(FAILED(hr))
+		{
+			return FALSE;
+		}
+
+		bRet = PathStripToRoot(szRoot);
+
+		if(!bRet)
+		{
+			return FALSE;
+		}
+
+		bRet = GetClusterSize(szRoot, &dwClusterSize);
+
+		if(!bRet)
+		{
+			return FALSE;
+		}
+
+		if((lFileSize.QuadPart % dwClusterSize) != 0)
+		{
+			/* The real size is the logical file size rounded up to the end of the
+			nearest cluster. */
+			lFileSize.QuadPart += dwClusterSize - (lFileSize.QuadPart % dwClusterSize);
+		}
+
+		*lpRealFileSize = lFileSize;
+
+		return TRUE;
+	}
+}
+
+std::unique_ptr<ShredTarget> OpenShredTarget(const std::wstring &path)
+{
+	DWORD attributes = GetFileAttributes(path.c_str());
+
+	if (attributes == INVALID_FILE_ATTRIBUTES || (attributes & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		return nullptr;
+	}
+
+	/* Determine the actual size of the file on disk (i.e. how many
+	clusters it is allocated). Since the cluster size is a multiple of
+	the sector size, this also means that every write can be sector
+	aligned, which is required for unbuffered I/O. If the cluster size
+	can't be determined, the file will only be overwritten up to its
+	logical size, using buffered (but still write-through) I/O. */
+	LARGE_INTEGER realSize;
+	BOOL unbuffered = GetFileClusterSize(path, &realSize);
+
+	if (!unbuffered)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributeData;
+
+		if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attributeData))
+		{
+			return nullptr;
+		}
+
+		realSize.LowPart = attributeData.nFileSizeLow;
+		realSize.HighPart = attributeData.nFileSizeHigh;
+	}
+
+	DWORD flags = FILE_FLAG_WRITE_THROUGH;
+
+	if (unbuffered)
+	{
+		flags |= FILE_FLAG_NO_BUFFERING;
+	}
+
+	/* No sharing is allowed, so that the file can't be opened while it's
+	being overwritten. */
+	HANDLE file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+		flags, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+
+	/* Extend the file out to the end of its last cluster. */
+	if (!SetFilePointerEx(file, realSize, nullptr, FILE_BEGIN) || !SetEndOfFile(file))
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	return std::make_unique<ShredTargetImpl>(path, file, realSize.QuadPart);
+}
+
+int FileShredder::GetDefaultNumThreads()
+{
+	// Overwriting is I/O bound, so there's little point in using more
+	// threads than are needed to keep several writes in flight.
+	unsigned int numThreads = std::thread::hardware_concurrency();
+	return static_cast<int>((std::max)(2U, (std::min)(numThreads, 4U)));
+}
+
+FileShredder::FileShredder(const std::vector<Pattern> &passes, int numThreads, std::size_t blockSize,
+	OpenTarget openTarget) :
+	m_passes(passes),
+	m_numThreads((std::max)(numThreads, 1)),
+	m_blockSize(blockSize),
+	m_openTarget(openTarget),
+	m_stop(false),
+	m_failed(false),
+	m_nextTarget(0),
+	m_bytesWritten(0),
+	m_filesDestroyed(0),
+	m_totalBytes(0)
+{
+}
+
+FileShredder::~FileShredder() = default;
+
+void FileShredder::BufferDeleter::operator()(std::uint8_t *buffer) const
+{
+	VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+FileShredder::Result FileShredder::Shred(const std::vector<std::wstring> &paths, ProgressCallback progressCallback,
+	PassCallback passCallback)
+{
+	m_progressCallback = progressCallback;
+	m_passCallback = passCallback;
+
+	/* Each of the files is opened up front, so that the total amount of
+	data that will be written is known before any progress is reported. */
+	std::vector<Target> targets;
+
+	for (const auto &path : paths)
+	{
+		Target target;
+		target.path = path;
+		target.target = m_openTarget(path);
+
+		if (target.target)
+		{
+			m_totalBytes += target.target->GetSize() * m_passes.size();
+		}
+		else
+		{
+			m_failed = true;
+		}
+
+		targets.push_back(std::move(target));
+	}
+
+	m_startTime = std::chrono::steady_clock::now();
+	m_lastProgressTime = m_startTime;
+
+	int numThreads = static_cast<int>((std::min)(static_cast<std::size_t>(m_numThreads), targets.size()));
+	std::vector<std::thread> workers;
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		workers.emplace_back(&FileShredder::WorkerMain, this, std::ref(targets));
+	}
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+
+	if (m_progressCallback)
+	{
+		m_progressCallback(GetProgress());
+	}
+
+	if (m_stop)
+	{
+		return Result::Stopped;
+	}
+
+	return m_failed ? Result::Failed : Result::Succeeded;
+}
+
+void FileShredder::Stop()
+{
+	m_stop = true;
+}
+
+void FileShredder::WorkerMain(std::vector<Target> &targets)
+{
+	/* Each worker has its own buffer, so that the pattern being written
+	by one worker isn't affected by the others. */
+	Buffer buffer(static_cast<std::uint8_t *>(VirtualAlloc(nullptr, m_blockSize,
+		MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)));
+
+	if (!buffer)
+	{
+		m_failed = true;
+		return;
+	}
+
+	HCRYPTPROV cryptProvider = 0;
+
+	if (std::find(m_passes.begin(), m_passes.end(), Pattern::Random) != m_passes.end()
+		&& !CryptAcquireContext(&cryptProvider, nullptr, nullptr, PROV_RSA_AES, CRYPT_VERIFYCONTEXT))
+	{
+		m_failed = true;
+		return;
+	}
+
+	while (!m_stop)
+	{
+		std::size_t index = m_nextTarget++;
+
+		if (index >= targets.size())
+		{
+			break;
+		}
+
+		Target &target = targets[index];
+
+		if (!target.target)
+		{
+			continue;
+		}
+
+		if (ShredFile(target, buffer.get(), cryptProvider))
+		{
+			m_filesDestroyed++;
+		}
+		else if (!m_stop)
+		{
+			m_failed = true;
+		}
+
+		target.target.reset();
+	}
+
+	if (cryptProvider != 0)
+	{
+		CryptReleaseContext(cryptProvider, 0);
+	}
+}
+
+bool FileShredder::ShredFile(Target &target, std::uint8_t *buffer, HCRYPTPROV cryptProvider)
+{
+	std::uint64_t size = target.target->GetSize();
+
+	for (std::size_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		Pattern pattern = m_passes[passIndex];
+
+		if (pattern != Pattern::Random)
+		{
+			memset(buffer, (pattern == Pattern::Ones) ? 0xFF : 0x00, m_blockSize);
+		}
+
+		for (std::uint64_t offset = 0; offset < size; offset += m_blockSize)
+		{
+			if (m_stop)
+			{
+				return false;
+			}
+
+			auto blockSize = static_cast<std::size_t>((std::min)(static_cast<std::uint64_t>(m_blockSize), size - offset));
+
+			if (pattern == Pattern::Random
+				&& !CryptGenRandom(cryptProvider, static_cast<DWORD>(blockSize), buffer))
+			{
+				return false;
+			}
+
+			if (!target.target->Write(offset, buffer, blockSize))
+			{
+				return false;
+			}
+
+			AddBytesWritten(blockSize);
+		}
+
+		/* Each pass needs to reach the disk before the next one starts,
+		otherwise it may simply be replaced by the next pass in the
+		cache. */
+		if (!target.target->Flush())
+		{
+			return false;
+		}
+
+		if (m_passCallback)
+		{
+			m_passCallback(target.path, passIndex, *target.target);
+		}
+	}
+
+	return target.target->Delete();
+}
+
+void FileShredder::AddBytesWritten(std::uint64_t bytesWritten)
+{
+	m_bytesWritten += bytesWritten;
+
+	if (!m_progressCallback)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_progressMutex, std::try_to_lock);
+
+	/* If another thread is currently reporting progress, there's no need
+	to wait for it. */
+	if (!lock.owns_lock())
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+
+	if (now - m_lastProgressTime < PROGRESS_INTERVAL)
+	{
+		return;
+	}
+
+	m_lastProgressTime = now;
+	m_progressCallback(GetProgress());
+}
+
+FileShredder::Progress FileShredder::GetProgress()
+{
+	Progress progress;
+	progress.bytesWritten = m_bytesWritten;
+	progress.totalBytes = m_totalBytes;
+	progress.filesDestroyed = m_filesDestroyed;
+	progress.bytesPerSecond = 0;
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_startTime;
+
+	if (elapsed.count() > 0)
+	{
+		progress.bytesPerSecond = progress.bytesWritten / elapsed.count();
+	}
+
+	return progress;
+}
@@ -0,0 +1,162 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A file that's being overwritten. Access to the file is exclusive for as
+// long as this object exists.
+class ShredTarget
+{
+public:
+
+	virtual ~ShredTarget() = default;
+
+	// The number of bytes that will be overwritten. For files on disk,
+	// this is the size of the file rounded up to the end of its last
+	// cluster, so that any slack space is overwritten as well.
+	virtual std::uint64_t GetSize() const = 0;
+
+	// For files on disk, the offset, size and buffer address should all be
+	// sector aligned (a page-aligned buffer and whole clusters are
+	// sufficient).
+	virtual bool Write(std::uint64_t offset, const void *buffer, std::size_t size) = 0;
+	virtual bool Read(std::uint64_t offset, void *buffer, std::size_t size) = 0;
+
+	// Returns once everything that's been written has reached the disk.
+	virtual bool Flush() = 0;
+
+	// Closes and then deletes the file.
+	virtual bool Delete() = 0;
+};
+
+// Returns null if the path refers to a folder, or if the file couldn't be
+// opened. Where possible, the file is opened for unbuffered, write-through
+// access, so that each pass is written directly to the disk, rather than
+// simply replacing the previous pass in the cache.
+std::unique_ptr<ShredTarget> OpenShredTarget(const std::wstring &path);
+
+// Securely deletes a set of files by overwriting their contents one or
+// more times, before deleting them.
+//
+// Each pass is written in large blocks from a page-aligned buffer that's
+// either filled with a fixed pattern once (at the start of the pass) or
+// filled with cryptographically random data for each block. Files are
+// processed by a small set of worker threads, so that several files can
+// be overwritten at once.
+class FileShredder
+{
+public:
+
+	enum class Pattern
+	{
+		Zeros,
+		Ones,
+		Random
+	};
+
+	enum class Result
+	{
+		Succeeded,
+		Stopped,
+
+		// At least one of the files couldn't be opened, overwritten or
+		// deleted. The remaining files will still have been processed.
+		Failed
+	};
+
+	struct Progress
+	{
+		std::uint64_t bytesWritten;
+		std::uint64_t totalBytes;
+		std::size_t filesDestroyed;
+		double bytesPerSecond;
+	};
+
+	// Invoked on one of the worker threads, at most once every
+	// PROGRESS_INTERVAL. Invoked once more, on the thread that called
+	// Shred, when the operation has finished.
+	using ProgressCallback = std::function<void(const Progress &progress)>;
+
+	// Invoked on a worker thread, once a pass has been written and flushed.
+	// The target can be read at this point, in order to check what was
+	// written.
+	using PassCallback = std::function<void(const std::wstring &path, std::size_t passIndex, ShredTarget &target)>;
+
+	using OpenTarget = std::function<std::unique_ptr<ShredTarget>(const std::wstring &path)>;
+
+	// Must be a multiple of the sector size, since unbuffered writes need
+	// to be sector aligned.
+	static constexpr std::size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+	static int GetDefaultNumThreads();
+
+	FileShredder(const std::vector<Pattern> &passes, int numThreads, std::size_t blockSize = DEFAULT_BLOCK_SIZE,
+		OpenTarget openTarget = OpenShredTarget);
+	~FileShredder();
+
+	FileShredder(const FileShredder &) = delete;
+	FileShredder &operator=(const FileShredder &) = delete;
+
+	// Overwrites and deletes the specified files, returning once that's
+	// complete. Should only be called once.
+	Result Shred(const std::vector<std::wstring> &paths, ProgressCallback progressCallback,
+		PassCallback passCallback = nullptr);
+
+	// May be called from any thread. Files that have been partially
+	// overwritten won't be deleted.
+	void Stop();
+
+private:
+
+	static constexpr std::chrono::milliseconds PROGRESS_INTERVAL = std::chrono::milliseconds(100);
+
+	struct Target
+	{
+		std::wstring path;
+		std::unique_ptr<ShredTarget> target;
+	};
+
+	struct BufferDeleter
+	{
+		void operator()(std::uint8_t *buffer) const;
+	};
+
+	using Buffer = std::unique_ptr<std::uint8_t, BufferDeleter>;
+
+	void WorkerMain(std::vector<Target> &targets);
+	bool ShredFile(Target &target, std::uint8_t *buffer, HCRYPTPROV cryptProvider);
+	void AddBytesWritten(std::uint64_t bytesWritten);
+	Progress GetProgress();
+
+	const std::vector<Pattern> m_passes;
+	const int m_numThreads;
+	const std::size_t m_blockSize;
+	const OpenTarget m_openTarget;
+
+	ProgressCallback m_progressCallback;
+	PassCallback m_passCallback;
+
+	std::atomic<bool> m_stop;
+	std::atomic<bool> m_failed;
+	std::atomic<std::size_t> m_nextTarget;
+	std::atomic<std::uint64_t> m_bytesWritten;
+	std::atomic<std::size_t> m_filesDestroyed;
+	std::uint64_t m_totalBytes;
+
+	std::chrono::steady_clock::time_point m_startTime;
+
+	// Ensures that only one thread reports progress at a time.
+	std::mutex m_progressMutex;
+	std::chrono::steady_clock::time_point m_lastProgressTime;
+};
@@ -0,0 +1,353 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "FileSplitter.h"
+#include <boost/crc.hpp>
+#include <thread>
+
+std::unique_ptr<FileMergeInput> OpenFileSplitInput(const std::wstring &path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributeData;
+
+	if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attributeData))
+	{
+		return nullptr;
+	}
+
+	ULARGE_INTEGER size = { attributeData.nFileSizeLow, attributeData.nFileSizeHigh };
+
+	if (size.QuadPart >= FileSplitter::UNBUFFERED_INPUT_THRESHOLD)
+	{
+		return OpenUnbufferedFileMergeInput(path);
+	}
+
+	return OpenFileMergeInput(path);
+}
+
+void FileSplitter::BufferDeleter::operator()(std::uint8_t *buffer) const
+{
+	VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+FileSplitter::FileSplitter(const std::wstring &inputFile, std::uint64_t partSize, GetPartPath getPartPath,
+	const Options &options, OpenInput openInput, CreateOutput createOutput) :
+	m_inputFile(inputFile),
+	m_partSize(partSize),
+	m_getPartPath(getPartPath),
+	m_options(options),
+	m_openInput(openInput),
+	m_createOutput(createOutput),
+	m_stop(false),
+	m_readingFinished(false),
+	m_readResult(Result::Succeeded)
+{
+}
+
+FileSplitter::~FileSplitter() = default;
+
+FileSplitter::Result FileSplitter::Split(ProgressCallback progressCallback)
+{
+	if (m_partSize == 0)
+	{
+		return Result::OutputFileInvalid;
+	}
+
+	auto input = m_openInput(m_inputFile);
+
+	if (!input)
+	{
+		return Result::InputFileInvalid;
+	}
+
+	/* Buffers are allocated with VirtualAlloc, so that they're page
+	aligned (as required for unbuffered reads). */
+	for (int i = 0; i < m_options.numBuffers; i++)
+	{
+		auto buffer = static_cast<std::uint8_t *>(VirtualAlloc(nullptr, m_options.bufferSize,
+			MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+		if (!buffer)
+		{
+			return Result::ReadFailed;
+		}
+
+		m_buffers.emplace_back(buffer);
+		m_freeBuffers.push_back(i);
+	}
+
+	std::uint64_t totalBytes = input->GetSize();
+	std::uint64_t totalParts = (totalBytes / m_partSize) + (((totalBytes % m_partSize) != 0) ? 1 : 0);
+
+	std::thread reader(&FileSplitter::ReaderMain, this, std::ref(*input));
+
+	const bool createManifest = !m_options.manifestPath.empty();
+	Result result = Result::Succeeded;
+	Progress progress = { 0, totalBytes, 0, totalParts, 0 };
+	auto startTime = std::chrono::steady_clock::now();
+	auto lastProgressTime = startTime;
+
+	auto updateProgress = [&] (std::chrono::steady_clock::time_point now) {
+		std::chrono::duration<double> elapsed = now - startTime;
+
+		if (elapsed.count() > 0)
+		{
+			progress.bytesPerSecond = progress.bytesWritten / elapsed.count();
+		}
+
+		if (progressCallback)
+		{
+			progressCallback(progress);
+		}
+
+		lastProgressTime = now;
+	};
+
+	std::unique_ptr<FileMergeOutput> output;
+	std::wstring outputPath;
+	std::uint64_t partBytesWritten = 0;
+	boost::crc_32_type partChecksum;
+
+	auto finishPart = [&] {
+		output.reset();
+
+		if (createManifest)
+		{
+			m_manifest.AddEntry(outputPath.substr(outputPath.find_last_of(L"\\/") + 1), partChecksum.checksum());
+		}
+
+		progress.partsWritten++;
+		partBytesWritten = 0;
+		partChecksum.reset();
+	};
+
+	Chunk chunk;
+
+	while (result == Result::Succeeded && TakeChunk(chunk))
+	{
+		const std::uint8_t *data = m_buffers[chunk.bufferIndex].get();
+		std::size_t offset = 0;
+
+		/* The chunk may contain the end of one part and the start of the
+		next. */
+		while (offset < chunk.size)
+		{
+			if (!output)
+			{
+				outputPath = m_getPartPath(progress.partsWritten + 1);
+				output = m_createOutput(outputPath);
+
+				if (!output)
+				{
+					result = Result::OutputFileInvalid;
+					break;
+				}
+			}
+
+			auto size = static_cast<std::size_t>((std::min)(static_cast<std::uint64_t>(chunk.size - offset),
+				m_partSize - partBytesWritten));
+
+			if (!output->Write(data + offset, size))
+			{
+				result = Result::WriteFailed;
+				break;
+			}
+
+			if (createManifest)
+			{
+				partChecksum.process_bytes(data + offset, size);
+			}
+
+			offset += size;
+			partBytesWritten += size;
+			progress.bytesWritten += size;
+
+			if (partBytesWritten == m_partSize)
+			{
+				finishPart();
+			}
+		}
+
+		ReturnFreeBuffer(chunk.bufferIndex);
+
+		auto now = std::chrono::steady_clock::now();
+
+		if (now - lastProgressTime >= PROGRESS_INTERVAL)
+		{
+			updateProgress(now);
+		}
+	}
+
+	if (result != Result::Succeeded)
+	{
+		Stop();
+	}
+
+	reader.join();
+
+	if (result == Result::Succeeded)
+	{
+		result = m_readResult;
+	}
+
+	if (result == Result::Succeeded && m_stop)
+	{
+		result = Result::Stopped;
+	}
+
+	/* The last part will only be partially filled if the file size isn't
+	a multiple of the part size. */
+	if (result == Result::Succeeded && output)
+	{
+		finishPart();
+	}
+
+	updateProgress(std::chrono::steady_clock::now());
+
+	output.reset();
+
+	if (result == Result::Succeeded && createManifest && !WriteManifest())
+	{
+		result = Result::WriteFailed;
+	}
+
+	return result;
+}
+
+bool FileSplitter::WriteManifest()
+{
+	auto output = m_createOutput(m_options.manifestPath);
+
+	if (!output)
+	{
+		return false;
+	}
+
+	std::string data = m_manifest.Serialize();
+	return output->Write(data.data(), data.size());
+}
+
+void FileSplitter::ReaderMain(FileMergeInput &input)
+{
+	while (true)
+	{
+		int bufferIndex;
+
+		if (!TakeFreeBuffer(bufferIndex))
+		{
+			FinishReading(Result::Stopped);
+			return;
+		}
+
+		/* Each read fills an entire buffer, regardless of where the
+		parts begin and end, so that reads stay aligned. */
+		std::size_t bytesRead;
+		bool res = input.Read(m_buffers[bufferIndex].get(), m_options.bufferSize, bytesRead);
+
+		if (!res)
+		{
+			ReturnFreeBuffer(bufferIndex);
+			FinishReading(Result::ReadFailed);
+			return;
+		}
+
+		if (bytesRead == 0)
+		{
+			ReturnFreeBuffer(bufferIndex);
+			break;
+		}
+
+		AddChunk({ bufferIndex, bytesRead });
+
+		if (bytesRead < m_options.bufferSize)
+		{
+			break;
+		}
+	}
+
+	FinishReading(Result::Succeeded);
+}
+
+bool FileSplitter::TakeFreeBuffer(int &bufferIndex)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this] { return m_stop || !m_freeBuffers.empty(); });
+
+	if (m_stop)
+	{
+		return false;
+	}
+
+	bufferIndex = m_freeBuffers.front();
+	m_freeBuffers.pop_front();
+
+	return true;
+}
+
+void FileSplitter::ReturnFreeBuffer(int bufferIndex)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_freeBuffers.push_back(bufferIndex);
+	}
+
+	m_condition.notify_all();
+}
+
+void FileSplitter::AddChunk(Chunk chunk)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_chunks.push_back(chunk);
+	}
+
+	m_condition.notify_all();
+}
+
+bool FileSplitter::TakeChunk(Chunk &chunk)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this] { return m_stop || !m_chunks.empty() || m_readingFinished; });
+
+	if (m_stop || m_chunks.empty())
+	{
+		return false;
+	}
+
+	chunk = m_chunks.front();
+	m_chunks.pop_front();
+
+	return true;
+}
+
+void FileSplitter::FinishReading(Result result)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_readingFinished = true;
+		m_readResult = result;
+	}
+
+	m_condition.notify_all();
+}
+
+void FileSplitter::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_condition.notify_all();
+}
+
+std::size_t FileSplitter::GetBufferMemorySize() const
+{
+	return m_options.bufferSize * m_options.numBuffers;
+}
+
+const ChecksumManifest &FileSplitter::GetManifest() const
+{
+	return m_manifest;
+}
@@ -0,0 +1,158 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include "ChecksumManifest.h"
+#include "FileMerger.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Opens the file that's going to be split. Files of at least
+// FileSplitter::UNBUFFERED_INPUT_THRESHOLD bytes are opened for unbuffered
+// access, since there's little chance of the data being read again before
+// it's evicted from the cache.
+std::unique_ptr<FileMergeInput> OpenFileSplitInput(const std::wstring &path);
+
+// Splits a file into a set of parts, using a fixed amount of memory,
+// regardless of how large the parts are.
+//
+// This is the reverse of FileMerger and is structured in the same way. A
+// separate thread fills a fixed pool of page-aligned buffers from the
+// input file, while the calling thread writes them out. A single buffer
+// may be written to two (or more) parts, so the buffer size and the part
+// size are independent of each other.
+//
+// As each part is written, its CRC-32 is calculated, so that a manifest
+// listing the checksum of every part can be written once the split is
+// complete. FileMerger can then use that manifest to verify the parts.
+class FileSplitter
+{
+public:
+
+	enum class Result
+	{
+		Succeeded,
+		Stopped,
+		InputFileInvalid,
+		OutputFileInvalid,
+		ReadFailed,
+		WriteFailed
+	};
+
+	// Must be a multiple of the sector size, since the input file may be
+	// read without buffering.
+	static constexpr std::size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+	static constexpr int DEFAULT_NUM_BUFFERS = 4;
+
+	static constexpr std::uint64_t UNBUFFERED_INPUT_THRESHOLD = 1024 * 1024 * 1024;
+
+	struct Options
+	{
+		std::size_t bufferSize = DEFAULT_BUFFER_SIZE;
+		int numBuffers = DEFAULT_NUM_BUFFERS;
+
+		// If not empty, a checksum manifest will be written to this path
+		// once all of the parts have been written.
+		std::wstring manifestPath;
+	};
+
+	struct Progress
+	{
+		std::uint64_t bytesWritten;
+		std::uint64_t totalBytes;
+		std::uint64_t partsWritten;
+		std::uint64_t totalParts;
+		double bytesPerSecond;
+	};
+
+	using OpenInput = FileMerger::OpenInput;
+	using CreateOutput = FileMerger::CreateOutput;
+
+	// Returns the path of the specified part. Parts are numbered from 1.
+	using GetPartPath = std::function<std::wstring(std::uint64_t partNumber)>;
+
+	// Invoked on the thread that called Split, at most once every
+	// PROGRESS_INTERVAL and once more when the split has finished.
+	using ProgressCallback = std::function<void(const Progress &progress)>;
+
+	FileSplitter(const std::wstring &inputFile, std::uint64_t partSize, GetPartPath getPartPath,
+		const Options &options, OpenInput openInput = OpenFileSplitInput,
+		CreateOutput createOutput = CreateFileMergeOutput);
+	~FileSplitter();
+
+	FileSplitter(const FileSplitter &) = delete;
+	FileSplitter &operator=(const FileSplitter &) = delete;
+
+	// Performs the split and returns once it's complete. Should only be
+	// called once.
+	Result Split(ProgressCallback progressCallback);
+
+	// May be called from any thread.
+	void Stop();
+
+	// The total amount of memory used for buffers, which is allocated up
+	// front.
+	std::size_t GetBufferMemorySize() const;
+
+	// Contains an entry for each of the parts that have been written. Only
+	// filled in if a manifest was requested.
+	const ChecksumManifest &GetManifest() const;
+
+private:
+
+	static constexpr std::chrono::milliseconds PROGRESS_INTERVAL = std::chrono::milliseconds(100);
+
+	struct BufferDeleter
+	{
+		void operator()(std::uint8_t *buffer) const;
+	};
+
+	using Buffer = std::unique_ptr<std::uint8_t, BufferDeleter>;
+
+	struct Chunk
+	{
+		int bufferIndex;
+		std::size_t size;
+	};
+
+	void ReaderMain(FileMergeInput &input);
+	bool TakeFreeBuffer(int &bufferIndex);
+	void ReturnFreeBuffer(int bufferIndex);
+	void AddChunk(Chunk chunk);
+	bool TakeChunk(Chunk &chunk);
+	void FinishReading(Result result);
+	bool WriteManifest();
+
+	const std::wstring m_inputFile;
+	const std::uint64_t m_partSize;
+	const GetPartPath m_getPartPath;
+	const Options m_options;
+	const OpenInput m_openInput;
+	const CreateOutput m_createOutput;
+
+	std::vector<Buffer> m_buffers;
+
+	std::atomic<bool> m_stop;
+
+	// Protects each of the members below. Buffers move from the free list,
+	// to the reader thread, to the list of chunks, to the writing thread
+	// and back to the free list.
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<int> m_freeBuffers;
+	std::deque<Chunk> m_chunks;
+	bool m_readingFinished;
+	Result m_readResult;
+
+	ChecksumManifest m_manifest;
+};
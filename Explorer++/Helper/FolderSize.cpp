@@ -3,107 +3,676 @@
 // See LICENSE in the top level directory
 
 #include "stdafx.h"
-#include <list>
 #include "FolderSize.h"
-#include "Macros.h"
+#include <algorithm>
+#include <future>
 
+struct FolderSizeCalculator::Calculation
+{
+	int id;
+	std::atomic<bool> cancelled;
 
-HRESULT CalculateFolderSize(const TCHAR *szPath,int *nFolders,
-int *nFiles,PULARGE_INTEGER lTotalFolderSize)
+	ProgressCallback progressCallback;
+	CompletionCallback completionCallback;
+
+	// Running totals, used for progress updates.
+	std::atomic<int> numFolders;
+	std::atomic<int> numFiles;
+	std::atomic<ULONGLONG> size;
+
+	std::mutex progressMutex;
+	std::chrono::steady_clock::time_point lastProgressTime;
+	bool completed;
+};
+
+struct FolderSizeCalculator::FolderNode
 {
-	HANDLE			hFirstFile;
-	WIN32_FIND_DATA	wfd;
-	TCHAR			InitialPath[MAX_PATH + 2];
-	TCHAR			TempPath[MAX_PATH + 2];
-	ULARGE_INTEGER	l_TotalFolderSize;
-	ULARGE_INTEGER	r_TotalFolderSize;
-	ULARGE_INTEGER	lFileSize;
-	int				l_NumFiles = 0;
-	int				l_NumFolders = 0;
-	int				r_NumFiles = 0;
-	int				r_NumFolders = 0;
+	std::shared_ptr<Calculation> calculation;
+	std::shared_ptr<FolderNode> parent;
+	std::wstring path;
 
-	if(!szPath || ! nFolders || !nFiles || !lTotalFolderSize)
-		return E_INVALIDARG;
+	// The number of subfolders that haven't been completed yet, plus one
+	// for the enumeration of this folder.
+	std::atomic<int> numPending;
 
-	l_TotalFolderSize.QuadPart	= 0;
-	r_TotalFolderSize.QuadPart	= 0;
+	// Totals for the entire subtree. These are only complete once
+	// numPending reaches 0.
+	std::atomic<int> numFolders;
+	std::atomic<int> numFiles;
+	std::atomic<ULONGLONG> size;
 
-	StringCchCopy(InitialPath,SIZEOF_ARRAY(InitialPath),szPath);
-	StringCchCat(InitialPath,SIZEOF_ARRAY(InitialPath),_T("\\*"));
+	// Set to false if this folder, or any folder beneath it, couldn't be
+	// enumerated. Totals for incomplete subtrees aren't cached.
+	std::atomic<bool> complete;
 
-	hFirstFile = FindFirstFile(InitialPath,&wfd);
+	// Retrieved immediately before the folder is enumerated. If it can't
+	// be retrieved, the totals for the folder won't be cached.
+	boost::optional<ULONGLONG> lastWriteTime;
+};
 
-	if(hFirstFile == INVALID_HANDLE_VALUE)
-		return S_OK;
-	
-	if(StrCmp(wfd.cFileName,_T(".")) != 0)
+namespace
+{
+	// File systems on Windows treat paths case-insensitively, so the
+	// cache does the same. The mapping here matches the one NTFS uses.
+	std::wstring GetCacheKey(const std::wstring &path)
 	{
-		if((wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY)
+		if (path.empty())
 		{
-			l_NumFolders++;
+			return path;
 		}
-		else
+
+		std::wstring key(path.size(), '\0');
+		int res = LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, path.c_str(),
+			static_cast<int>(path.size()), key.data(), static_cast<int>(key.size()),
+			nullptr, nullptr, 0);
+
+		if (res == 0)
 		{
-			l_NumFiles++;
+			return path;
 		}
+
+		key.resize(res);
+
+		return key;
 	}
+}
+
+bool EnumerateFolderContents(const std::wstring &path, FolderContents &contents)
+{
+	std::wstring searchPath = path;
 
-	while(FindNextFile(hFirstFile,&wfd) != 0)
+	if (!searchPath.empty() && searchPath.back() != '\\')
 	{
-		if(StrCmp(wfd.cFileName,_T("..")) != 0)
-		{
-			if((wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY)
-			{
-				l_NumFolders++;
+		searchPath += '\\';
+	}
 
-				StringCchCopy(TempPath,SIZEOF_ARRAY(TempPath),szPath);
-				PathAppend(TempPath,wfd.cFileName);
+	searchPath += '*';
 
-				CalculateFolderSize(TempPath,&r_NumFolders,&r_NumFiles,&r_TotalFolderSize);
+	WIN32_FIND_DATA wfd;
+	HANDLE hFirstFile = FindFirstFileEx(searchPath.c_str(), FindExInfoBasic, &wfd,
+		FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
 
-				l_NumFolders				+= r_NumFolders;
-				l_NumFiles					+= r_NumFiles;
-				l_TotalFolderSize.QuadPart	+= r_TotalFolderSize.QuadPart;
-			}
-			else
+	if (hFirstFile == INVALID_HANDLE_VALUE)
+	{
+		// An empty folder will still contain the "." and ".." entries, so
+		// this indicates an actual error.
+		return false;
+	}
+
+	do
+	{
+		if (lstrcmp(wfd.cFileName, _T(".")) == 0 || lstrcmp(wfd.cFileName, _T("..")) == 0)
+		{
+			continue;
+		}
+
+		if ((wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY)
+		{
+			contents.numFolders++;
+
+			if ((wfd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == FILE_ATTRIBUTE_REPARSE_POINT)
 			{
-				l_NumFiles++;
-				lFileSize.LowPart = wfd.nFileSizeLow;
-				lFileSize.HighPart = wfd.nFileSizeHigh;
+				// Following junctions could result in the same files being
+				// counted more than once (or in an infinite loop).
+				continue;
+			}
 
-				l_TotalFolderSize.QuadPart += lFileSize.QuadPart;
+			std::wstring subfolderPath = path;
+
+			if (!subfolderPath.empty() && subfolderPath.back() != '\\')
+			{
+				subfolderPath += '\\';
 			}
+
+			subfolderPath += wfd.cFileName;
+			contents.subfolders.push_back(std::move(subfolderPath));
+		}
+		else
+		{
+			ULARGE_INTEGER fileSize = { wfd.nFileSizeLow, wfd.nFileSizeHigh };
+
+			contents.numFiles++;
+			contents.size += fileSize.QuadPart;
+		}
+	} while (FindNextFile(hFirstFile, &wfd) != 0);
+
+	FindClose(hFirstFile);
+
+	return true;
+}
+
+boost::optional<ULONGLONG> GetFolderLastWriteTime(const std::wstring &path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributeData;
+	BOOL res = GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attributeData);
+
+	if (!res)
+	{
+		return boost::none;
+	}
+
+	ULARGE_INTEGER lastWriteTime = { attributeData.ftLastWriteTime.dwLowDateTime,
+		attributeData.ftLastWriteTime.dwHighDateTime };
+
+	return lastWriteTime.QuadPart;
+}
+
+HRESULT CalculateFolderSize(const TCHAR *szPath,int *nFolders,
+int *nFiles,PULARGE_INTEGER lTotalFolderSize)
+{
+	if(!szPath || ! nFolders || !nFiles || !lTotalFolderSize)
+		return E_INVALIDARG;
+
+	int l_NumFolders = 0;
+	int l_NumFiles = 0;
+	ULONGLONG l_TotalFolderSize = 0;
+
+	std::vector<std::wstring> pendingFolders = { szPath };
+
+	while(!pendingFolders.empty())
+	{
+		std::wstring folder = std::move(pendingFolders.back());
+		pendingFolders.pop_back();
+
+		FolderContents contents;
+		EnumerateFolderContents(folder, contents);
+
+		l_NumFolders		+= contents.numFolders;
+		l_NumFiles			+= contents.numFiles;
+		l_TotalFolderSize	+= contents.size;
+
+		for(auto &subfolder : contents.subfolders)
+		{
+			pendingFolders.push_back(std::move(subfolder));
 		}
 	}
 
 	*nFolders					= l_NumFolders;
 	*nFiles						= l_NumFiles;
-	lTotalFolderSize->QuadPart	= l_TotalFolderSize.QuadPart;
-
-	FindClose(hFirstFile);
+	lTotalFolderSize->QuadPart	= l_TotalFolderSize;
 
 	return S_OK;
 }
 
-DWORD WINAPI Thread_CalculateFolderSize(LPVOID lpParameter)
+int FolderSizeCalculator::GetDefaultNumThreads()
+{
+	// Enumerating folders is mostly I/O bound, so there's little point
+	// using a large number of threads.
+	unsigned int numThreads = std::thread::hardware_concurrency();
+	return static_cast<int>((std::max)(2U, (std::min)(numThreads, 8U)));
+}
+
+FolderSizeCalculator::FolderSizeCalculator(int numThreads, EnumerateFolder enumerateFolder,
+	GetLastWriteTime getLastWriteTime) :
+	m_enumerateFolder(enumerateFolder),
+	m_getLastWriteTime(getLastWriteTime),
+	m_nextQueue(0),
+	m_numQueuedTasks(0),
+	m_stop(false),
+	m_calculationIdCounter(0)
+{
+	numThreads = (std::max)(numThreads, 1);
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_workers.emplace_back(&FolderSizeCalculator::WorkerMain, this, i);
+	}
+}
+
+FolderSizeCalculator::~FolderSizeCalculator()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_stop = true;
+	}
+
+	m_idleCondition.notify_all();
+
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+
+	// Any tasks that remain are simply dropped. Each outstanding
+	// calculation is still completed, so that anyone waiting on a result
+	// isn't left waiting indefinitely.
+	std::unordered_map<int, std::shared_ptr<Calculation>> calculations;
+
+	{
+		std::lock_guard<std::mutex> lock(m_calculationsMutex);
+		calculations.swap(m_calculations);
+	}
+
+	for (auto &item : calculations)
+	{
+		Totals totals;
+		totals.numFolders = item.second->numFolders;
+		totals.numFiles = item.second->numFiles;
+		totals.size = item.second->size;
+
+		item.second->cancelled = true;
+		item.second->completionCallback(totals, true);
+	}
+}
+
+int FolderSizeCalculator::GetNumThreads() const
+{
+	return static_cast<int>(m_workers.size());
+}
+
+int FolderSizeCalculator::StartCalculation(const std::wstring &path, ProgressCallback progressCallback,
+	CompletionCallback completionCallback)
+{
+	auto calculation = std::make_shared<Calculation>();
+	calculation->cancelled = false;
+	calculation->progressCallback = progressCallback;
+	calculation->completionCallback = completionCallback;
+	calculation->numFolders = 0;
+	calculation->numFiles = 0;
+	calculation->size = 0;
+	calculation->lastProgressTime = std::chrono::steady_clock::now();
+	calculation->completed = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_calculationsMutex);
+		calculation->id = m_calculationIdCounter++;
+		m_calculations.insert({ calculation->id, calculation });
+	}
+
+	auto node = std::make_shared<FolderNode>();
+	node->calculation = calculation;
+	node->path = path;
+	node->numPending = 1;
+	node->numFolders = 0;
+	node->numFiles = 0;
+	node->size = 0;
+	node->complete = true;
+
+	PushTask(m_nextQueue++ % m_queues.size(), node);
+
+	return calculation->id;
+}
+
+void FolderSizeCalculator::CancelCalculation(int calculationId)
+{
+	std::lock_guard<std::mutex> lock(m_calculationsMutex);
+
+	auto itr = m_calculations.find(calculationId);
+
+	if (itr == m_calculations.end())
+	{
+		return;
+	}
+
+	// Any folders that remain will be skipped, which allows the
+	// calculation to complete quickly.
+	itr->second->cancelled = true;
+}
+
+FolderSizeCalculator::Totals FolderSizeCalculator::Calculate(const std::wstring &path)
+{
+	auto promise = std::make_shared<std::promise<Totals>>();
+	std::future<Totals> future = promise->get_future();
+
+	StartCalculation(path, nullptr, [promise] (const Totals &totals, bool cancelled) {
+		UNREFERENCED_PARAMETER(cancelled);
+
+		promise->set_value(totals);
+	});
+
+	return future.get();
+}
+
+void FolderSizeCalculator::WorkerMain(int workerIndex)
+{
+	while (true)
+	{
+		auto node = TakeTask(workerIndex);
+
+		if (node)
+		{
+			ProcessFolder(workerIndex, node);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_idleMutex);
+		m_idleCondition.wait(lock, [this] {
+			return m_stop || m_numQueuedTasks > 0;
+		});
+
+		if (m_stop)
+		{
+			return;
+		}
+	}
+}
+
+void FolderSizeCalculator::PushTask(int workerIndex, std::shared_ptr<FolderNode> node)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queues[workerIndex]->mutex);
+		m_queues[workerIndex]->tasks.push_back(std::move(node));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_numQueuedTasks++;
+	}
+
+	m_idleCondition.notify_one();
+}
+
+std::shared_ptr<FolderSizeCalculator::FolderNode> FolderSizeCalculator::TakeTask(int workerIndex)
+{
+	{
+		WorkerQueue &queue = *m_queues[workerIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty())
+		{
+			auto node = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			m_numQueuedTasks--;
+			return node;
+		}
+	}
+
+	for (std::size_t i = 1; i < m_queues.size(); i++)
+	{
+		WorkerQueue &queue = *m_queues[(workerIndex + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty())
+		{
+			auto node = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			m_numQueuedTasks--;
+			return node;
+		}
+	}
+
+	return nullptr;
+}
+
+void FolderSizeCalculator::ProcessFolder(int workerIndex, const std::shared_ptr<FolderNode> &node)
+{
+	Calculation &calculation = *node->calculation;
+
+	if (calculation.cancelled)
+	{
+		node->complete = false;
+		FinishFolder(node);
+		return;
+	}
+
+	auto cachedTotals = GetCachedTotals(node->path);
+
+	if (cachedTotals)
+	{
+		node->numFolders += cachedTotals->numFolders;
+		node->numFiles += cachedTotals->numFiles;
+		node->size += cachedTotals->size;
+
+		calculation.numFolders += cachedTotals->numFolders;
+		calculation.numFiles += cachedTotals->numFiles;
+		calculation.size += cachedTotals->size;
+
+		ReportProgress(calculation);
+		FinishFolder(node);
+		return;
+	}
+
+	// Retrieving this first means that any change made during the
+	// enumeration will cause the cached totals to be discarded.
+	node->lastWriteTime = m_getLastWriteTime(node->path);
+
+	FolderContents contents;
+	bool res = m_enumerateFolder(node->path, contents);
+
+	if (!res)
+	{
+		node->complete = false;
+	}
+
+	node->numFolders += contents.numFolders;
+	node->numFiles += contents.numFiles;
+	node->size += contents.size;
+
+	calculation.numFolders += contents.numFolders;
+	calculation.numFiles += contents.numFiles;
+	calculation.size += contents.size;
+
+	for (auto &subfolder : contents.subfolders)
+	{
+		auto child = std::make_shared<FolderNode>();
+		child->calculation = node->calculation;
+		child->parent = node;
+		child->path = std::move(subfolder);
+		child->numPending = 1;
+		child->numFolders = 0;
+		child->numFiles = 0;
+		child->size = 0;
+		child->complete = true;
+
+		// The parent's pending count has to be incremented before the
+		// child is queued, since the child could be completed by
+		// another worker straight away.
+		node->numPending++;
+
+		PushTask(workerIndex, std::move(child));
+	}
+
+	ReportProgress(calculation);
+	FinishFolder(node);
+}
+
+// Called once a folder has been enumerated and each time one of its
+// subfolders is completed. Once every part of the folder has been
+// processed, its totals are added to its parent's.
+void FolderSizeCalculator::FinishFolder(std::shared_ptr<FolderNode> node)
 {
-	FolderSize_t	*pFolderSize = NULL;
-	static int		nFiles;
-	static int		nFolders;
-	ULARGE_INTEGER	lTotalDirSize;
-	HRESULT			hr;
+	while (node)
+	{
+		if (--node->numPending != 0)
+		{
+			return;
+		}
 
-	if(lpParameter == NULL)
-		return 0;
+		Totals totals;
+		totals.numFolders = node->numFolders;
+		totals.numFiles = node->numFiles;
+		totals.size = node->size;
 
-	pFolderSize = (FolderSize_t *)lpParameter;
+		// Folders whose totals came from the cache don't have a last
+		// write time, so they won't be stored again (which would extend
+		// how long their totals are trusted).
+		if (node->complete && !node->calculation->cancelled && node->lastWriteTime)
+		{
+			StoreCachedTotals(node->path, totals, *node->lastWriteTime);
+		}
+
+		auto parent = node->parent;
+
+		if (!parent)
+		{
+			CompleteCalculation(node->calculation, totals);
+			return;
+		}
 
-	hr = CalculateFolderSize(pFolderSize->szPath,&nFolders,&nFiles,&lTotalDirSize);
+		parent->numFolders += totals.numFolders;
+		parent->numFiles += totals.numFiles;
+		parent->size += totals.size;
 
-	pFolderSize->pfnCallback(nFolders,nFiles,&lTotalDirSize,pFolderSize->pData);
+		if (!node->complete)
+		{
+			parent->complete = false;
+		}
+
+		node = std::move(parent);
+	}
+}
+
+void FolderSizeCalculator::ReportProgress(Calculation &calculation)
+{
+	if (!calculation.progressCallback)
+	{
+		return;
+	}
+
+	// If another worker is already reporting progress, there's no need
+	// to wait for it.
+	std::unique_lock<std::mutex> lock(calculation.progressMutex, std::try_to_lock);
+
+	if (!lock.owns_lock() || calculation.completed)
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+
+	if (now - calculation.lastProgressTime < PROGRESS_INTERVAL)
+	{
+		return;
+	}
 
-	free(pFolderSize);
+	calculation.lastProgressTime = now;
 
-	return 1;
-}
\ No newline at end of file
+	Totals totals;
+	totals.numFolders = calculation.numFolders;
+	totals.numFiles = calculation.numFiles;
+	totals.size = calculation.size;
+
+	calculation.progressCallback(totals);
+}
+
+void FolderSizeCalculator::CompleteCalculation(const std::shared_ptr<Calculation> &calculation, const Totals &totals)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_calculationsMutex);
+
+		// If this object is being destroyed, the calculation will
+		// already have been completed.
+		if (m_calculations.erase(calculation->id) == 0)
+		{
+			return;
+		}
+	}
+
+	{
+		// Ensures that no progress update can be delivered after the
+		// calculation has completed.
+		std::lock_guard<std::mutex> lock(calculation->progressMutex);
+		calculation->completed = true;
+	}
+
+	calculation->completionCallback(totals, calculation->cancelled);
+}
+
+boost::optional<FolderSizeCalculator::Totals> FolderSizeCalculator::GetCachedTotals(const std::wstring &path) const
+{
+	CacheEntry entry;
+
+	{
+		std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+		auto itr = m_cachedTotals.find(GetCacheKey(path));
+
+		if (itr == m_cachedTotals.end())
+		{
+			return boost::none;
+		}
+
+		entry = itr->second;
+	}
+
+	if (std::chrono::steady_clock::now() - entry.storeTime >= MAX_CACHED_TOTALS_AGE)
+	{
+		return boost::none;
+	}
+
+	// The lock isn't held here, since this requires a file system query.
+	auto lastWriteTime = m_getLastWriteTime(path);
+
+	if (!lastWriteTime || *lastWriteTime != entry.lastWriteTime)
+	{
+		return boost::none;
+	}
+
+	return entry.totals;
+}
+
+void FolderSizeCalculator::StoreCachedTotals(const std::wstring &path, const Totals &totals,
+	ULONGLONG lastWriteTime)
+{
+	CacheEntry entry;
+	entry.totals = totals;
+	entry.lastWriteTime = lastWriteTime;
+	entry.storeTime = std::chrono::steady_clock::now();
+
+	std::wstring key = GetCacheKey(path);
+
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+	if (m_cachedTotals.size() >= MAX_CACHED_TOTALS)
+	{
+		m_cachedTotals.clear();
+	}
+
+	m_cachedTotals[key] = entry;
+}
+
+void FolderSizeCalculator::InvalidateCachedTotals(const std::wstring &path)
+{
+	std::wstring key = GetCacheKey(path);
+
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+	std::wstring subfolderPrefix = key;
+
+	if (!subfolderPrefix.empty() && subfolderPrefix.back() != '\\')
+	{
+		subfolderPrefix += '\\';
+	}
+
+	auto itr = m_cachedTotals.lower_bound(subfolderPrefix);
+
+	while (itr != m_cachedTotals.end()
+		&& itr->first.compare(0, subfolderPrefix.size(), subfolderPrefix) == 0)
+	{
+		itr = m_cachedTotals.erase(itr);
+	}
+
+	std::wstring currentPath = key;
+
+	while (!currentPath.empty())
+	{
+		m_cachedTotals.erase(currentPath);
+
+		auto lastSeparator = currentPath.find_last_of('\\');
+
+		if (lastSeparator == std::wstring::npos)
+		{
+			break;
+		}
+
+		// Removes the trailing separator in the case of a root folder
+		// (e.g. C:\), as well as the final path component.
+		currentPath.erase(lastSeparator);
+
+		if (currentPath.size() == 2 && currentPath[1] == ':')
+		{
+			m_cachedTotals.erase(currentPath + L"\\");
+		}
+	}
+}
+
+void FolderSizeCalculator::ClearCache()
+{
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	m_cachedTotals.clear();
+}
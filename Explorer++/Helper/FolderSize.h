@@ -4,13 +4,169 @@
 
 #pragma once
 
-typedef struct
+#include <boost/optional.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct FolderContents
+{
+	// The full paths of the subfolders that should be enumerated.
+	std::vector<std::wstring> subfolders;
+
+	int numFolders = 0;
+	int numFiles = 0;
+	ULONGLONG size = 0;
+};
+
+// Retrieves the immediate contents of a folder. Folders that are reparse
+// points (e.g. junctions) are counted, but aren't returned as subfolders,
+// so that they won't be followed.
+bool EnumerateFolderContents(const std::wstring &path, FolderContents &contents);
+
+boost::optional<ULONGLONG> GetFolderLastWriteTime(const std::wstring &path);
+
+HRESULT CalculateFolderSize(const TCHAR *szPath, int *nFolders, int *nFiles, PULARGE_INTEGER lTotalFolderSize);
+
+// Calculates folder sizes using a fixed set of worker threads.
+//
+// Each folder that's encountered becomes a separate task. Workers process
+// their own tasks newest first (so that each worker walks its part of the
+// tree depth-first) and, when they run out, steal the oldest task from
+// another worker. Since the oldest tasks are those closest to the root,
+// a steal will typically take a large subtree.
+//
+// The total for every folder that's fully enumerated is remembered, so
+// that the size of a folder (or any folder beneath it) can be returned
+// immediately the next time it's requested. A total is only reused while
+// the folder's last write time is unchanged and for a limited period
+// afterwards. The last write time only reflects changes to the folder's
+// immediate contents, so it's still up to the caller to invalidate the
+// totals when it knows of a change further down.
+//
+// All methods are thread-safe. Callbacks are invoked on the worker
+// threads.
+class FolderSizeCalculator
 {
-	TCHAR szPath[MAX_PATH];
-	LPVOID pData;
-	void (* pfnCallback)(int nFolders,int nFiles,
-	PULARGE_INTEGER lTotalFolderSize,LPVOID pData);
-} FolderSize_t;
-
-DWORD WINAPI	Thread_CalculateFolderSize(LPVOID lpParameter);
-HRESULT			CalculateFolderSize(const TCHAR *szPath, int *nFolders, int *nFiles, PULARGE_INTEGER lTotalFolderSize);
\ No newline at end of file
+public:
+
+	struct Totals
+	{
+		int numFolders = 0;
+		int numFiles = 0;
+		ULONGLONG size = 0;
+	};
+
+	using EnumerateFolder = std::function<bool(const std::wstring &path, FolderContents &contents)>;
+	using GetLastWriteTime = std::function<boost::optional<ULONGLONG>(const std::wstring &path)>;
+	using ProgressCallback = std::function<void(const Totals &partialTotals)>;
+	using CompletionCallback = std::function<void(const Totals &totals, bool cancelled)>;
+
+	static int GetDefaultNumThreads();
+
+	FolderSizeCalculator(int numThreads, EnumerateFolder enumerateFolder = EnumerateFolderContents,
+		GetLastWriteTime getLastWriteTime = GetFolderLastWriteTime);
+	~FolderSizeCalculator();
+
+	FolderSizeCalculator(const FolderSizeCalculator &) = delete;
+	FolderSizeCalculator &operator=(const FolderSizeCalculator &) = delete;
+
+	// Starts calculating the size of the specified folder and returns an
+	// ID that can be used to cancel the calculation. The progress
+	// callback (which is optional) is periodically passed the totals so
+	// far. The completion callback is always invoked exactly once (unless
+	// this object is destroyed first, in which case it will be invoked
+	// during destruction, with the calculation marked as cancelled).
+	int StartCalculation(const std::wstring &path, ProgressCallback progressCallback,
+		CompletionCallback completionCallback);
+	void CancelCalculation(int calculationId);
+
+	// Calculates the size of the specified folder and waits for the
+	// result. This shouldn't be called from within one of the callbacks.
+	Totals Calculate(const std::wstring &path);
+
+	// Returns the cached totals for the specified folder, provided they're
+	// still considered to be up to date. Paths are compared
+	// case-insensitively.
+	boost::optional<Totals> GetCachedTotals(const std::wstring &path) const;
+
+	// Removes the totals for the specified folder, for each of its parent
+	// folders (whose totals include it) and for each of the folders
+	// beneath it.
+	void InvalidateCachedTotals(const std::wstring &path);
+	void ClearCache();
+
+	int GetNumThreads() const;
+
+private:
+
+	struct Calculation;
+	struct FolderNode;
+
+	struct CacheEntry
+	{
+		Totals totals;
+		ULONGLONG lastWriteTime;
+		std::chrono::steady_clock::time_point storeTime;
+	};
+
+	// The minimum amount of time between progress updates for a single
+	// calculation.
+	static constexpr std::chrono::milliseconds PROGRESS_INTERVAL = std::chrono::milliseconds(100);
+
+	// Once this many folder totals have been stored, the cache is reset.
+	static constexpr std::size_t MAX_CACHED_TOTALS = 100000;
+
+	// Changes beneath a folder won't necessarily update its last write
+	// time, so a cached total is only trusted for this long.
+	static constexpr std::chrono::minutes MAX_CACHED_TOTALS_AGE = std::chrono::minutes(5);
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<std::shared_ptr<FolderNode>> tasks;
+	};
+
+	void WorkerMain(int workerIndex);
+	void PushTask(int workerIndex, std::shared_ptr<FolderNode> node);
+	std::shared_ptr<FolderNode> TakeTask(int workerIndex);
+	void ProcessFolder(int workerIndex, const std::shared_ptr<FolderNode> &node);
+	void FinishFolder(std::shared_ptr<FolderNode> node);
+	void ReportProgress(Calculation &calculation);
+	void CompleteCalculation(const std::shared_ptr<Calculation> &calculation, const Totals &totals);
+	void StoreCachedTotals(const std::wstring &path, const Totals &totals, ULONGLONG lastWriteTime);
+
+	const EnumerateFolder m_enumerateFolder;
+	const GetLastWriteTime m_getLastWriteTime;
+
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::vector<std::thread> m_workers;
+	std::atomic<unsigned int> m_nextQueue;
+
+	// Used to put idle workers to sleep. m_numQueuedTasks is only
+	// incremented while m_idleMutex is held, so that a worker can't miss
+	// a wakeup.
+	std::mutex m_idleMutex;
+	std::condition_variable m_idleCondition;
+	std::atomic<int> m_numQueuedTasks;
+	bool m_stop;
+
+	std::mutex m_calculationsMutex;
+	std::unordered_map<int, std::shared_ptr<Calculation>> m_calculations;
+	int m_calculationIdCounter;
+
+	// Ordered, so that the folders beneath a particular folder can be
+	// found without having to examine every entry. Keys are case-folded
+	// paths.
+	mutable std::mutex m_cacheMutex;
+	std::map<std::wstring, CacheEntry> m_cachedTotals;
+};
@@ -587,6 +587,26 @@ BOOL GetFileVersionValue(const TCHAR *szFullFileName, VersionSubBlockType_t subB
 	return bSuccess;
 }
 
+/* Retrieves a value from a version information block that
+has already been loaded (via GetFileVersionInfo). Useful when
+several values are needed from the same file. */
+BOOL GetVersionInfoString(const void *pVersionInfo, const TCHAR *szVersionInfo,
+	TCHAR *szVersionBuffer, UINT cchMax)
+{
+	LangAndCodePage *plcp = NULL;
+	UINT uLen;
+	BOOL bRet = VerQueryValue(pVersionInfo, _T("\\VarFileInfo\\Translation"),
+		reinterpret_cast<LPVOID *>(&plcp), &uLen);
+
+	if(!bRet || (uLen < sizeof(LangAndCodePage)))
+	{
+		return FALSE;
+	}
+
+	return GetStringTableValue(const_cast<void *>(pVersionInfo), plcp, uLen / sizeof(LangAndCodePage),
+		szVersionInfo, szVersionBuffer, cchMax);
+}
+
 BOOL GetStringTableValue(void *pBlock, LangAndCodePage *plcp, UINT nItems,
 	const TCHAR *szVersionInfo, TCHAR *szVersionBuffer, UINT cchMax)
 {
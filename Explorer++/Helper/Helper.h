@@ -40,6 +40,7 @@ BOOL			IsImage(const TCHAR *FileName);
 BOOL			GetFileProductVersion(const TCHAR *szFullFileName, DWORD *pdwProductVersionLS, DWORD *pdwProductVersionMS);
 BOOL			GetFileLanguage(const TCHAR *szFullFileName, WORD *pwLanguage);
 BOOL			GetVersionInfoString(const TCHAR *szFullFileName, const TCHAR *szVersionInfo, TCHAR *szVersionBuffer, UINT cchMax);
+BOOL			GetVersionInfoString(const void *pVersionInfo, const TCHAR *szVersionInfo, TCHAR *szVersionBuffer, UINT cchMax);
 
 /* Ownership and access. */
 BOOL			CheckGroupMembership(GroupType_t GroupType);
@@ -5,32 +5,22 @@
 #include "stdafx.h"
 #include "IconFetcher.h"
 #include "CachedIcons.h"
+#include <wil/com.h>
+#include <wil/resource.h>
 
-IconFetcher::IconFetcher(HWND hwnd, CachedIcons *cachedIcons) :
+IconFetcher::IconFetcher(HWND hwnd, CachedIcons *cachedIcons, TaskScheduler *taskScheduler) :
 	m_hwnd(hwnd),
 	m_cachedIcons(cachedIcons),
-	m_iconThreadPool(1),
+	m_iconTaskQueue(taskScheduler->CreateQueue()),
 	m_iconResultIDCounter(0)
 {
 	m_windowSubclasses.push_back(WindowSubclassWrapper(hwnd, WindowSubclassStub,
 		SUBCLASS_ID, reinterpret_cast<DWORD_PTR>(this)));
-
-	m_iconThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-	});
 }
 
 IconFetcher::~IconFetcher()
 {
-	m_iconThreadPool.clear_queue();
-
-	m_iconThreadPool.push([] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoUninitialize();
-	});
+	m_iconTaskQueue->Cancel();
 }
 
 LRESULT CALLBACK IconFetcher::WindowSubclassStub(HWND hwnd, UINT uMsg,
@@ -63,27 +53,54 @@ void IconFetcher::QueueIconTask(PCIDLIST_ABSOLUTE pidl, Callback callback)
 	BasicItemInfo basicItemInfo;
 	basicItemInfo.pidl.reset(ILCloneFull(pidl));
 
-	auto iconResult = m_iconThreadPool.push([this, iconResultID, basicItemInfo] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
+	auto iconResult = m_iconTaskQueue->Push(TaskScheduler::TaskPriority::Visible,
+		[this, iconResultID, basicItemInfo] {
 		return FindIconAsync(m_hwnd, iconResultID, basicItemInfo.pidl.get());
 	});
 
+	AddIconResult(iconResultID, pidl, callback, std::move(iconResult));
+}
+
+void IconFetcher::QueueOverlayTask(PCIDLIST_ABSOLUTE pidl, int iconIndex, Callback callback)
+{
+	int iconResultID = m_iconResultIDCounter++;
+
+	BasicItemInfo basicItemInfo;
+	basicItemInfo.pidl.reset(ILCloneFull(pidl));
+
+	auto iconResult = m_iconTaskQueue->Push(TaskScheduler::TaskPriority::Visible,
+		[this, iconResultID, basicItemInfo, iconIndex] {
+		return FindOverlayAsync(m_hwnd, iconResultID, basicItemInfo.pidl.get(), iconIndex);
+	});
+
+	AddIconResult(iconResultID, pidl, callback, std::move(iconResult));
+}
+
+void IconFetcher::AddIconResult(int iconResultId, PCIDLIST_ABSOLUTE pidl, Callback callback,
+	std::future<std::optional<IconResult>> iconResult)
+{
 	FutureResult futureResult;
 	futureResult.callback = callback;
 	futureResult.pidl.reset(ILCloneFull(pidl));
 	futureResult.iconResult = std::move(iconResult);
-	m_iconResults.insert({ iconResultID, std::move(futureResult) });
+	m_iconResults.insert({ iconResultId, std::move(futureResult) });
 }
 
 std::optional<IconFetcher::IconResult> IconFetcher::FindIconAsync(HWND hwnd, int iconResultId,
 	PCIDLIST_ABSOLUTE pidl)
 {
+	// The result is always posted (even on failure), so that it can be
+	// removed from the set of pending results.
+	auto postResult = wil::scope_exit([hwnd, iconResultId] () {
+		PostMessage(hwnd, WM_APP_ICON_RESULT_READY, iconResultId, 0);
+	});
+
 	// Must use SHGFI_ICON here, rather than SHGFO_SYSICONINDEX, or else 
 	// icon overlays won't be applied.
 	SHFILEINFO shfi;
+	shfi.dwAttributes = SFGAO_FOLDER;
 	DWORD_PTR res = SHGetFileInfo(reinterpret_cast<LPCTSTR>(pidl), 0, &shfi,
-		sizeof(SHFILEINFO), SHGFI_PIDL | SHGFI_ICON | SHGFI_OVERLAYINDEX);
+		sizeof(SHFILEINFO), SHGFI_PIDL | SHGFI_ICON | SHGFI_OVERLAYINDEX | SHGFI_ATTRIBUTES | SHGFI_ATTR_SPECIFIED);
 
 	if (res == 0)
 	{
@@ -94,6 +111,7 @@ std::optional<IconFetcher::IconResult> IconFetcher::FindIconAsync(HWND hwnd, int
 
 	IconResult result;
 	result.iconIndex = shfi.iIcon;
+	result.isFolder = WI_IsFlagSet(shfi.dwAttributes, SFGAO_FOLDER);
 
 	TCHAR filePath[MAX_PATH];
 	HRESULT hr = GetDisplayName(pidl, filePath, static_cast<UINT>(std::size(filePath)),
@@ -104,7 +122,49 @@ std::optional<IconFetcher::IconResult> IconFetcher::FindIconAsync(HWND hwnd, int
 		result.path = filePath;
 	}
 
-	PostMessage(hwnd, WM_APP_ICON_RESULT_READY, iconResultId, 0);
+	return result;
+}
+
+// Retrieving the overlay alone is significantly cheaper than retrieving
+// the icon, since there's no need to extract anything from the file.
+std::optional<IconFetcher::IconResult> IconFetcher::FindOverlayAsync(HWND hwnd, int iconResultId,
+	PCIDLIST_ABSOLUTE pidl, int iconIndex)
+{
+	auto postResult = wil::scope_exit([hwnd, iconResultId] () {
+		PostMessage(hwnd, WM_APP_ICON_RESULT_READY, iconResultId, 0);
+	});
+
+	// A result is returned even if the item has no overlay, so that the
+	// icon is set on the item and it won't be requested again.
+	IconResult result;
+	result.iconIndex = iconIndex & 0x00FFFFFF;
+	result.isFolder = false;
+
+	wil::com_ptr<IShellFolder> parent;
+	PCITEMID_CHILD child;
+	HRESULT hr = SHBindToParent(pidl, IID_PPV_ARGS(&parent), &child);
+
+	if (FAILED(hr))
+	{
+		return result;
+	}
+
+	auto shellIconOverlay = parent.try_query<IShellIconOverlay>();
+
+	if (!shellIconOverlay)
+	{
+		return result;
+	}
+
+	int overlayIndex = 0;
+	hr = shellIconOverlay->GetOverlayIndex(child, &overlayIndex);
+
+	if (hr != S_OK || overlayIndex <= 0)
+	{
+		return result;
+	}
+
+	result.iconIndex |= (overlayIndex << 24);
 
 	return result;
 }
@@ -118,6 +178,10 @@ void IconFetcher::ProcessIconResult(int iconResultId)
 		return;
 	}
 
+	auto cleanup = wil::scope_exit([this, itr] () {
+		m_iconResults.erase(itr);
+	});
+
 	auto &futureResult = itr->second;
 	auto result = futureResult.iconResult.get();
 
@@ -129,7 +193,7 @@ void IconFetcher::ProcessIconResult(int iconResultId)
 
 	if (!result->path.empty())
 	{
-		m_cachedIcons->addOrUpdateFileIcon(result->path, result->iconIndex);
+		m_cachedIcons->addOrUpdateItemIcon(result->path, result->isFolder, result->iconIndex);
 	}
 
 	futureResult.callback(futureResult.pidl.get(), result->iconIndex);
@@ -137,6 +201,11 @@ void IconFetcher::ProcessIconResult(int iconResultId)
 
 void IconFetcher::ClearQueue()
 {
-	m_iconThreadPool.clear_queue();
+	m_iconTaskQueue->Cancel();
 	m_iconResults.clear();
+}
+
+void IconFetcher::SetActive(bool active)
+{
+	m_iconTaskQueue->SetActive(active);
 }
\ No newline at end of file
@@ -5,8 +5,8 @@
 #pragma once
 
 #include "ShellHelper.h"
+#include "TaskScheduler.h"
 #include "WindowSubclassWrapper.h"
-#include "../ThirdParty/CTPL/cpl_stl.h"
 #include <future>
 #include <functional>
 #include <optional>
@@ -20,11 +20,18 @@ public:
 
 	using Callback = std::function<void(PCIDLIST_ABSOLUTE pidl, int iconIndex)>;
 
-	IconFetcher(HWND hwnd, CachedIcons *cachedIcons);
+	IconFetcher(HWND hwnd, CachedIcons *cachedIcons, TaskScheduler *taskScheduler);
 	~IconFetcher();
 
 	void QueueIconTask(PCIDLIST_ABSOLUTE pidl, Callback callback);
+
+	// Used when the item's icon is already known (e.g. because it was
+	// cached for the item's type) and only the overlay needs to be
+	// retrieved. The icon index passed to the callback will include the
+	// overlay, if there is one.
+	void QueueOverlayTask(PCIDLIST_ABSOLUTE pidl, int iconIndex, Callback callback);
 	void ClearQueue();
+	void SetActive(bool active);
 
 private:
 
@@ -44,10 +51,13 @@ private:
 		unique_pidl_absolute pidl;
 	};
 
+	// The path is left empty for overlay results, as there's nothing
+	// to add to the cache in that case.
 	struct IconResult
 	{
 		int iconIndex;
 		std::wstring path;
+		bool isFolder;
 	};
 
 	struct FutureResult
@@ -60,13 +70,17 @@ private:
 	static LRESULT CALLBACK WindowSubclassStub(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
 	LRESULT CALLBACK WindowSubclass(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
+	void AddIconResult(int iconResultId, PCIDLIST_ABSOLUTE pidl, Callback callback,
+		std::future<std::optional<IconResult>> iconResult);
 	static std::optional<IconResult> FindIconAsync(HWND hwnd, int iconResultId, PCIDLIST_ABSOLUTE pidl);
+	static std::optional<IconResult> FindOverlayAsync(HWND hwnd, int iconResultId, PCIDLIST_ABSOLUTE pidl,
+		int iconIndex);
 	void ProcessIconResult(int iconResultId);
 
 	const HWND m_hwnd;
 	std::vector<WindowSubclassWrapper> m_windowSubclasses;
 
-	ctpl::thread_pool m_iconThreadPool;
+	std::unique_ptr<TaskScheduler::Queue> m_iconTaskQueue;
 	std::unordered_map<int, FutureResult> m_iconResults;
 	int m_iconResultIDCounter;
 	CachedIcons *m_cachedIcons;
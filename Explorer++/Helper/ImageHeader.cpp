@@ -0,0 +1,391 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "ImageHeader.h"
+#include <wil/resource.h>
+#include <climits>
+#include <cstring>
+
+namespace
+{
+	const double INCHES_PER_METER = 0.0254;
+	const double CENTIMETERS_PER_INCH = 2.54;
+
+	// Bounds the number of PNG chunks and JPEG segments that are examined,
+	// so that a corrupt file can't cause an excessive number of reads.
+	const int MAX_BLOCKS = 256;
+
+	UINT ReadBigEndian16(const BYTE *data)
+	{
+		return (data[0] << 8) | data[1];
+	}
+
+	UINT ReadBigEndian32(const BYTE *data)
+	{
+		return (static_cast<UINT>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+	}
+
+	UINT ReadLittleEndian16(const BYTE *data)
+	{
+		return data[0] | (data[1] << 8);
+	}
+
+	UINT ReadLittleEndian32(const BYTE *data)
+	{
+		return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<UINT>(data[3]) << 24);
+	}
+
+	bool ParsePng(const ImageHeaderReader &reader, ImageHeaderInfo &info)
+	{
+		const BYTE PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+		// The signature, followed by the IHDR chunk, which is required to
+		// come first.
+		BYTE header[29];
+
+		if (!reader(0, header, sizeof(header))
+			|| memcmp(header, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0
+			|| memcmp(header + 12, "IHDR", 4) != 0)
+		{
+			return false;
+		}
+
+		int numChannels;
+
+		switch (header[25])
+		{
+		case 0:
+		case 3:
+			numChannels = 1;
+			break;
+
+		case 2:
+			numChannels = 3;
+			break;
+
+		case 4:
+			numChannels = 2;
+			break;
+
+		case 6:
+			numChannels = 4;
+			break;
+
+		default:
+			return false;
+		}
+
+		info.width = ReadBigEndian32(header + 16);
+		info.height = ReadBigEndian32(header + 20);
+		info.bitDepth = header[24] * numChannels;
+
+		// The resolution is stored in a separate (optional) chunk, which
+		// has to appear before the image data.
+		ULONGLONG offset = 8 + 8 + 13 + 4;
+
+		for (int i = 0; i < MAX_BLOCKS; i++)
+		{
+			BYTE chunkHeader[8];
+
+			if (!reader(offset, chunkHeader, sizeof(chunkHeader)))
+			{
+				break;
+			}
+
+			UINT chunkLength = ReadBigEndian32(chunkHeader);
+
+			if (memcmp(chunkHeader + 4, "IDAT", 4) == 0 || memcmp(chunkHeader + 4, "IEND", 4) == 0)
+			{
+				break;
+			}
+
+			if (memcmp(chunkHeader + 4, "pHYs", 4) == 0 && chunkLength >= 9)
+			{
+				BYTE physicalDimensions[9];
+
+				// A unit of 1 indicates that the values are in pixels per
+				// meter. Otherwise, they only give the aspect ratio.
+				if (reader(offset + 8, physicalDimensions, sizeof(physicalDimensions))
+					&& physicalDimensions[8] == 1)
+				{
+					info.horizontalResolution = ReadBigEndian32(physicalDimensions) * INCHES_PER_METER;
+					info.verticalResolution = ReadBigEndian32(physicalDimensions + 4) * INCHES_PER_METER;
+				}
+
+				break;
+			}
+
+			offset += 12ULL + chunkLength;
+		}
+
+		return true;
+	}
+
+	bool IsJpegStartOfFrame(BYTE marker)
+	{
+		// SOF0 - SOF15, excluding DHT, JPG and DAC, which share the same
+		// range.
+		return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+	}
+
+	bool ParseJpeg(const ImageHeaderReader &reader, ImageHeaderInfo &info)
+	{
+		BYTE startOfImage[2];
+
+		if (!reader(0, startOfImage, sizeof(startOfImage)) || startOfImage[0] != 0xFF
+			|| startOfImage[1] != 0xD8)
+		{
+			return false;
+		}
+
+		ULONGLONG offset = 2;
+
+		for (int i = 0; i < MAX_BLOCKS; i++)
+		{
+			BYTE markerHeader[2];
+
+			if (!reader(offset, markerHeader, sizeof(markerHeader)) || markerHeader[0] != 0xFF)
+			{
+				return false;
+			}
+
+			offset += 2;
+
+			// Any number of fill bytes can appear before a marker.
+			BYTE marker = markerHeader[1];
+
+			while (marker == 0xFF)
+			{
+				if (!reader(offset, &marker, 1))
+				{
+					return false;
+				}
+
+				offset++;
+			}
+
+			// The image data (or the end of the image) has been reached
+			// without a frame header being found.
+			if (marker == 0xD9 || marker == 0xDA)
+			{
+				return false;
+			}
+
+			// TEM and RST0 - RST7 don't have a length or any data.
+			if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+			{
+				continue;
+			}
+
+			BYTE lengthData[2];
+
+			if (!reader(offset, lengthData, sizeof(lengthData)))
+			{
+				return false;
+			}
+
+			// The length includes the two bytes used to store it.
+			UINT segmentLength = ReadBigEndian16(lengthData);
+
+			if (segmentLength < 2)
+			{
+				return false;
+			}
+
+			if (IsJpegStartOfFrame(marker))
+			{
+				BYTE frameHeader[6];
+
+				if (segmentLength < 2 + sizeof(frameHeader)
+					|| !reader(offset + 2, frameHeader, sizeof(frameHeader)))
+				{
+					return false;
+				}
+
+				info.height = ReadBigEndian16(frameHeader + 1);
+				info.width = ReadBigEndian16(frameHeader + 3);
+				info.bitDepth = frameHeader[0] * frameHeader[5];
+
+				// A height of 0 indicates that the actual height is given
+				// after the first scan, which isn't worth searching for.
+				return info.width != 0 && info.height != 0;
+			}
+
+			// The JFIF header (if there is one) comes before the frame
+			// header.
+			if (marker == 0xE0 && segmentLength >= 2 + 12)
+			{
+				BYTE jfifHeader[12];
+
+				if (reader(offset + 2, jfifHeader, sizeof(jfifHeader))
+					&& memcmp(jfifHeader, "JFIF\0", 5) == 0)
+				{
+					double xDensity = ReadBigEndian16(jfifHeader + 8);
+					double yDensity = ReadBigEndian16(jfifHeader + 10);
+
+					// A unit of 0 indicates that the densities only give
+					// the aspect ratio.
+					if (jfifHeader[7] == 1)
+					{
+						info.horizontalResolution = xDensity;
+						info.verticalResolution = yDensity;
+					}
+					else if (jfifHeader[7] == 2)
+					{
+						info.horizontalResolution = xDensity * CENTIMETERS_PER_INCH;
+						info.verticalResolution = yDensity * CENTIMETERS_PER_INCH;
+					}
+				}
+			}
+
+			offset += segmentLength;
+		}
+
+		return false;
+	}
+
+	bool ParseGif(const ImageHeaderReader &reader, ImageHeaderInfo &info)
+	{
+		// The signature, followed by the logical screen descriptor.
+		BYTE header[13];
+
+		if (!reader(0, header, sizeof(header))
+			|| (memcmp(header, "GIF87a", 6) != 0 && memcmp(header, "GIF89a", 6) != 0))
+		{
+			return false;
+		}
+
+		info.width = ReadLittleEndian16(header + 6);
+		info.height = ReadLittleEndian16(header + 8);
+
+		BYTE flags = header[10];
+
+		// If there's a global color table, its size gives the number of
+		// bits used for each pixel. Otherwise, the color resolution is
+		// used instead.
+		if (flags & 0x80)
+		{
+			info.bitDepth = (flags & 0x07) + 1;
+		}
+		else
+		{
+			info.bitDepth = ((flags >> 4) & 0x07) + 1;
+		}
+
+		return true;
+	}
+
+	bool ParseBmp(const ImageHeaderReader &reader, ImageHeaderInfo &info)
+	{
+		// BITMAPFILEHEADER, followed by the size of the info header.
+		BYTE header[18];
+
+		if (!reader(0, header, sizeof(header)) || header[0] != 'B' || header[1] != 'M')
+		{
+			return false;
+		}
+
+		UINT infoHeaderSize = ReadLittleEndian32(header + 14);
+
+		if (infoHeaderSize == 12)
+		{
+			// BITMAPCOREHEADER
+			BYTE coreHeader[12];
+
+			if (!reader(14, coreHeader, sizeof(coreHeader)))
+			{
+				return false;
+			}
+
+			info.width = ReadLittleEndian16(coreHeader + 4);
+			info.height = ReadLittleEndian16(coreHeader + 6);
+			info.bitDepth = ReadLittleEndian16(coreHeader + 10);
+
+			return true;
+		}
+
+		if (infoHeaderSize < 40)
+		{
+			return false;
+		}
+
+		// BITMAPINFOHEADER, or one of the later versions, each of which
+		// starts with the same fields.
+		BYTE infoHeader[40];
+
+		if (!reader(14, infoHeader, sizeof(infoHeader)))
+		{
+			return false;
+		}
+
+		auto width = static_cast<LONG>(ReadLittleEndian32(infoHeader + 4));
+		auto height = static_cast<LONG>(ReadLittleEndian32(infoHeader + 8));
+
+		// A negative height indicates a top-down bitmap.
+		if (width <= 0 || height == 0 || height == LONG_MIN)
+		{
+			return false;
+		}
+
+		info.width = width;
+		info.height = (height < 0) ? -height : height;
+		info.bitDepth = ReadLittleEndian16(infoHeader + 14);
+
+		auto xPixelsPerMeter = static_cast<LONG>(ReadLittleEndian32(infoHeader + 24));
+		auto yPixelsPerMeter = static_cast<LONG>(ReadLittleEndian32(infoHeader + 28));
+
+		if (xPixelsPerMeter > 0 && yPixelsPerMeter > 0)
+		{
+			info.horizontalResolution = xPixelsPerMeter * INCHES_PER_METER;
+			info.verticalResolution = yPixelsPerMeter * INCHES_PER_METER;
+		}
+
+		return true;
+	}
+}
+
+bool ParseImageHeader(const ImageHeaderReader &reader, ImageHeaderInfo &info)
+{
+	using Parser = bool (*)(const ImageHeaderReader &reader, ImageHeaderInfo &info);
+
+	// Each parser checks the file signature first, so only the parser
+	// for the actual format does any real work.
+	const Parser parsers[] = { ParsePng, ParseJpeg, ParseGif, ParseBmp };
+
+	for (Parser parser : parsers)
+	{
+		ImageHeaderInfo currentInfo = {};
+
+		if (parser(reader, currentInfo))
+		{
+			info = currentInfo;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ReadImageHeader(const std::wstring &path, ImageHeaderInfo &info)
+{
+	wil::unique_hfile file(CreateFile(path.c_str(), GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr));
+
+	if (!file)
+	{
+		return false;
+	}
+
+	return ParseImageHeader([&file] (ULONGLONG offset, void *buffer, size_t size) {
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+		DWORD bytesRead;
+		BOOL res = ReadFile(file.get(), buffer, static_cast<DWORD>(size), &bytesRead, &overlapped);
+
+		return res && bytesRead == size;
+	}, info);
+}
@@ -0,0 +1,38 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <functional>
+#include <string>
+
+// Reads the basic properties of an image (dimensions, bit depth and
+// resolution) directly from its header, without decoding the image. Only
+// a few hundred bytes are read in the common case, so this is far cheaper
+// than loading the image through GDI+.
+//
+// PNG, JPEG, GIF and BMP files are supported. For anything else, the
+// functions below fail and the caller will need to fall back to decoding
+// the image.
+struct ImageHeaderInfo
+{
+	UINT width;
+	UINT height;
+
+	// The number of bits per pixel. Zero if it couldn't be determined.
+	UINT bitDepth;
+
+	// In dots per inch. These are only set if the file specifies a
+	// resolution.
+	boost::optional<double> horizontalResolution;
+	boost::optional<double> verticalResolution;
+};
+
+// Should read exactly size bytes, starting at the specified offset,
+// returning false if that's not possible.
+using ImageHeaderReader = std::function<bool(ULONGLONG offset, void *buffer, size_t size)>;
+
+bool ParseImageHeader(const ImageHeaderReader &reader, ImageHeaderInfo &info);
+bool ReadImageHeader(const std::wstring &path, ImageHeaderInfo &info);
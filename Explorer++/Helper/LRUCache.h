@@ -0,0 +1,102 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cassert>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// A fixed-size map that evicts the least recently used entry once it's
+// full. Both looking up and adding an entry mark it as the most recently
+// used.
+//
+// Not thread-safe. Each cache should only be used from a single thread.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LRUCache
+{
+public:
+
+	explicit LRUCache(std::size_t maxEntries) :
+		m_maxEntries(maxEntries)
+	{
+		assert(maxEntries > 0);
+	}
+
+	boost::optional<Value> Get(const Key &key)
+	{
+		auto itr = m_entryMap.find(key);
+
+		if (itr == m_entryMap.end())
+		{
+			return boost::none;
+		}
+
+		m_entries.splice(m_entries.begin(), m_entries, itr->second);
+
+		return itr->second->second;
+	}
+
+	void Set(const Key &key, Value value)
+	{
+		auto itr = m_entryMap.find(key);
+
+		if (itr != m_entryMap.end())
+		{
+			itr->second->second = std::move(value);
+			m_entries.splice(m_entries.begin(), m_entries, itr->second);
+			return;
+		}
+
+		m_entries.emplace_front(key, std::move(value));
+		m_entryMap.emplace(key, m_entries.begin());
+
+		if (m_entries.size() > m_maxEntries)
+		{
+			m_entryMap.erase(m_entries.back().first);
+			m_entries.pop_back();
+		}
+	}
+
+	void Remove(const Key &key)
+	{
+		auto itr = m_entryMap.find(key);
+
+		if (itr == m_entryMap.end())
+		{
+			return;
+		}
+
+		m_entries.erase(itr->second);
+		m_entryMap.erase(itr);
+	}
+
+	void Clear()
+	{
+		m_entries.clear();
+		m_entryMap.clear();
+	}
+
+	std::size_t GetNumEntries() const
+	{
+		return m_entries.size();
+	}
+
+	std::size_t GetMaxEntries() const
+	{
+		return m_maxEntries;
+	}
+
+private:
+
+	using EntryList = std::list<std::pair<Key, Value>>;
+
+	const std::size_t m_maxEntries;
+
+	// Ordered from most to least recently used.
+	EntryList m_entries;
+	std::unordered_map<Key, typename EntryList::iterator, Hash> m_entryMap;
+};
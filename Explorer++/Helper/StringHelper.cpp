@@ -7,8 +7,6 @@
 #include "Macros.h"
 #include <codecvt>
 
-BOOL CheckWildcardMatchInternal(const TCHAR *szWildcard, const TCHAR *szString, BOOL bCaseSensitive);
-
 void FormatSizeString(ULARGE_INTEGER lFileSize, TCHAR *pszFileSize,
 	size_t cchBuf)
 {
@@ -158,128 +156,253 @@ TCHAR *PrintCommaLargeNum(LARGE_INTEGER lPrint)
 
 BOOL CheckWildcardMatch(const TCHAR *szWildcard, const TCHAR *szString, BOOL bCaseSensitive)
 {
-	/* Handles multiple wildcard patterns. If the wildcard pattern contains ':',
-	split the pattern into multiple subpatterns.
-	For example "*.h: *.cpp" would match against "*.h" and "*.cpp" */
-	BOOL bMultiplePattern = FALSE;
+	/* Callers that match the same pattern repeatedly should use
+	WildcardPattern directly, so that the pattern is only parsed once. */
+	WildcardPattern pattern(szWildcard, bCaseSensitive ? true : false);
+	return pattern.Matches(szString);
+}
 
-	for(int i = 0; i < lstrlen(szWildcard); i++)
+namespace
+{
+	/* Converts a string to lowercase. Most filenames only contain ASCII
+	characters, which can be converted directly. Anything else is converted
+	in a single call to LCMapString. */
+	void ToLowerCase(std::wstring_view str, std::wstring &output)
 	{
-		if(szWildcard[i] == ':')
+		output.assign(str.data(), str.size());
+
+		bool ascii = true;
+
+		for (auto &c : output)
 		{
-			bMultiplePattern = TRUE;
-			break;
+			if (c >= 0x80)
+			{
+				ascii = false;
+				break;
+			}
+
+			if (c >= 'A' && c <= 'Z')
+			{
+				c = c - 'A' + 'a';
+			}
 		}
+
+		if (ascii || output.empty())
+		{
+			return;
+		}
+
+		output.assign(str.data(), str.size());
+		LCMapString(LOCALE_USER_DEFAULT, LCMAP_LOWERCASE, str.data(), static_cast<int>(str.size()),
+			output.data(), static_cast<int>(output.size()));
 	}
+}
+
+WildcardPattern::WildcardPattern(std::wstring_view pattern, bool caseSensitive) :
+	m_caseSensitive(caseSensitive)
+{
+	std::wstring caseFoldedPattern;
 
-	if(!bMultiplePattern)
+	if (!caseSensitive)
 	{
-		return CheckWildcardMatchInternal(szWildcard, szString, bCaseSensitive);
+		ToLowerCase(pattern, caseFoldedPattern);
+		pattern = caseFoldedPattern;
 	}
-	else
+
+	/* If the pattern contains ':', it's split into multiple patterns.
+	For example, "*.h: *.cpp" will match against "*.h" and "*.cpp". Empty
+	patterns are skipped and each pattern has any surrounding spaces
+	removed. */
+	if (pattern.find(':') == std::wstring_view::npos)
 	{
-		TCHAR szWildcardPattern[512];
-		TCHAR *szSinglePattern = NULL;
-		TCHAR *szSearchPattern = NULL;
-		TCHAR *szRemainingPattern = NULL;
+		m_alternatives.push_back(ParseAlternative(pattern));
+		return;
+	}
 
-		StringCchCopy(szWildcardPattern, SIZEOF_ARRAY(szWildcardPattern), szWildcard);
+	std::size_t start = 0;
 
-		szSinglePattern = cstrtok_s(szWildcardPattern, _T(":"), &szRemainingPattern);
-		PathRemoveBlanks(szSinglePattern);
+	while (start <= pattern.size())
+	{
+		std::size_t end = pattern.find(':', start);
 
-		while(szSinglePattern != NULL)
+		if (end == std::wstring_view::npos)
 		{
-			if(CheckWildcardMatchInternal(szSinglePattern, szString, bCaseSensitive))
+			end = pattern.size();
+		}
+
+		std::wstring_view alternative = pattern.substr(start, end - start);
+
+		if (!alternative.empty())
+		{
+			std::size_t first = alternative.find_first_not_of(' ');
+
+			if (first == std::wstring_view::npos)
+			{
+				alternative = std::wstring_view();
+			}
+			else
 			{
-				return TRUE;
+				alternative = alternative.substr(first, alternative.find_last_not_of(' ') - first + 1);
 			}
 
-			szSearchPattern = szRemainingPattern;
-			szSinglePattern = cstrtok_s(szSearchPattern, _T(":"), &szRemainingPattern);
-			PathRemoveBlanks(szSinglePattern);
+			m_alternatives.push_back(ParseAlternative(alternative));
+		}
+
+		start = end + 1;
+	}
+}
+
+WildcardPattern::Alternative WildcardPattern::ParseAlternative(std::wstring_view pattern)
+{
+	Alternative alternative;
+	alternative.containsStar = false;
+	alternative.minLength = 0;
+
+	std::size_t start = 0;
+
+	while (true)
+	{
+		std::size_t end = pattern.find('*', start);
+		std::wstring_view text = pattern.substr(start,
+			(end == std::wstring_view::npos) ? std::wstring_view::npos : end - start);
+
+		/* Consecutive '*' characters are equivalent to a single '*', so
+		there's no need to store empty segments, other than those at the
+		start and end. */
+		if (!text.empty() || start == 0 || end == std::wstring_view::npos)
+		{
+			Segment segment;
+			segment.text = text;
+			segment.containsQuestionMark = (text.find('?') != std::wstring_view::npos);
+			alternative.segments.push_back(segment);
+
+			alternative.minLength += text.size();
+		}
+
+		if (end == std::wstring_view::npos)
+		{
+			break;
 		}
+
+		alternative.containsStar = true;
+		start = end + 1;
 	}
 
-	return FALSE;
+	return alternative;
 }
 
-BOOL CheckWildcardMatchInternal(const TCHAR *szWildcard, const TCHAR *szString, BOOL bCaseSensitive)
+bool WildcardPattern::Matches(std::wstring_view str) const
 {
-	BOOL bMatched;
-	BOOL bCurrentMatch = TRUE;
+	if (!m_caseSensitive)
+	{
+		/* Reused, so that no memory needs to be allocated for most
+		strings. */
+		thread_local std::wstring caseFoldedString;
 
-	while(*szWildcard != '\0' && *szString != '\0' && bCurrentMatch)
+		ToLowerCase(str, caseFoldedString);
+		str = caseFoldedString;
+	}
+
+	for (const auto &alternative : m_alternatives)
 	{
-		switch(*szWildcard)
+		if (MatchesAlternative(alternative, str))
 		{
-			/* Match against the next part of the wildcard string.
-			If there is a match, then return true, else consume
-			the next character, and check again. */
-		case '*':
-			bMatched = FALSE;
+			return true;
+		}
+	}
 
-			if(*(szWildcard + 1) != '\0')
-			{
-				bMatched = CheckWildcardMatch(++szWildcard, szString, bCaseSensitive);
-			}
+	return false;
+}
 
-			while(*szWildcard != '\0' && *szString != '\0' && !bMatched)
-			{
-				/* Consume one more character on the input string,
-				and keep (recursively) trying to match. */
-				bMatched = CheckWildcardMatch(szWildcard, ++szString, bCaseSensitive);
-			}
+bool WildcardPattern::MatchesAlternative(const Alternative &alternative, std::wstring_view str)
+{
+	if (str.size() < alternative.minLength)
+	{
+		return false;
+	}
 
-			if(bMatched)
-			{
-				while(*szWildcard != '\0')
-					szWildcard++;
+	const Segment &firstSegment = alternative.segments.front();
 
-				szWildcard--;
+	if (!alternative.containsStar)
+	{
+		return str.size() == firstSegment.text.size() && MatchesSegmentAt(firstSegment, str, 0);
+	}
 
-				while(*szString != '\0')
-					szString++;
-			}
+	/* Since the string is at least as long as all the segments combined,
+	the first and last segments can't overlap. The most common patterns
+	(e.g. "*.txt" or "abc*") are fully handled here. */
+	const Segment &lastSegment = alternative.segments.back();
+	std::size_t end = str.size() - lastSegment.text.size();
 
-			bCurrentMatch = bMatched;
-			break;
+	if (!MatchesSegmentAt(firstSegment, str, 0) || !MatchesSegmentAt(lastSegment, str, end))
+	{
+		return false;
+	}
 
-		case '?':
-			szString++;
-			break;
+	/* Each of the remaining segments is matched at the first position
+	it appears. Matching a segment any later could only leave less room
+	for the segments that follow, so there's never any need to try
+	another position. */
+	std::size_t start = firstSegment.text.size();
 
-		default:
-			if(bCaseSensitive)
-			{
-				bCurrentMatch = (*szWildcard == *szString);
-			}
-			else
-			{
-				TCHAR szCharacter1[1];
-				LCMapString(LOCALE_USER_DEFAULT, LCMAP_LOWERCASE, szWildcard, 1, szCharacter1, SIZEOF_ARRAY(szCharacter1));
+	for (std::size_t i = 1; i + 1 < alternative.segments.size(); i++)
+	{
+		const Segment &segment = alternative.segments[i];
+		std::size_t position = FindSegment(segment, str, start, end);
 
-				TCHAR szCharacter2[1];
-				LCMapString(LOCALE_USER_DEFAULT, LCMAP_LOWERCASE, szString, 1, szCharacter2, SIZEOF_ARRAY(szCharacter2));
+		if (position == std::wstring_view::npos)
+		{
+			return false;
+		}
 
-				bCurrentMatch = (szCharacter1[0] == szCharacter2[0]);
-			}
+		start = position + segment.text.size();
+	}
 
-			szString++;
-			break;
+	return true;
+}
+
+bool WildcardPattern::MatchesSegmentAt(const Segment &segment, std::wstring_view str, std::size_t position)
+{
+	if (!segment.containsQuestionMark)
+	{
+		return str.compare(position, segment.text.size(), segment.text) == 0;
+	}
+
+	for (std::size_t i = 0; i < segment.text.size(); i++)
+	{
+		if (segment.text[i] != '?' && segment.text[i] != str[position + i])
+		{
+			return false;
 		}
+	}
+
+	return true;
+}
 
-		szWildcard++;
+/* Returns the first position in [start, end) at which the segment fully
+appears, or npos if there's no such position. */
+std::size_t WildcardPattern::FindSegment(const Segment &segment, std::wstring_view str,
+	std::size_t start, std::size_t end)
+{
+	if (end < start || end - start < segment.text.size())
+	{
+		return std::wstring_view::npos;
 	}
 
-	/* Skip past any trailing wildcards. */
-	while(*szWildcard == '*')
-		szWildcard++;
+	if (!segment.containsQuestionMark)
+	{
+		return str.substr(0, end).find(segment.text, start);
+	}
 
-	if(*szWildcard == '\0' && *szString == '\0' && bCurrentMatch)
-		return TRUE;
+	for (std::size_t position = start; position + segment.text.size() <= end; position++)
+	{
+		if (MatchesSegmentAt(segment, str, position))
+		{
+			return position;
+		}
+	}
 
-	return FALSE;
+	return std::wstring_view::npos;
 }
 
 void ReplaceCharacter(TCHAR *str, TCHAR ch, TCHAR chReplacement)
@@ -4,6 +4,10 @@
 
 #pragma once
 
+#include <string>
+#include <string_view>
+#include <vector>
+
 enum SizeDisplayFormat_t
 {
 	SIZE_FORMAT_NONE,
@@ -28,4 +32,50 @@ void TrimStringLeft(std::wstring &str, const std::wstring &strWhitespace);
 void TrimStringRight(std::wstring &str, const std::wstring &strWhitespace);
 void TrimString(std::wstring &str, const std::wstring &strWhitespace);
 std::string wstrToStr(std::wstring source);
-std::wstring strToWstr(std::string source);
\ No newline at end of file
+std::wstring strToWstr(std::string source);
+
+// A wildcard pattern, in the same format accepted by CheckWildcardMatch
+// ('*' matches any sequence of characters, '?' matches any single
+// character and multiple patterns can be separated by ':').
+//
+// The pattern is parsed (and, if necessary, converted to lowercase) once,
+// so that it can be matched cheaply against a large number of strings.
+// Matching is done without backtracking, so it takes time proportional to
+// the length of the string multiplied by the length of the pattern, at
+// worst.
+class WildcardPattern
+{
+public:
+
+	WildcardPattern(std::wstring_view pattern, bool caseSensitive);
+
+	bool Matches(std::wstring_view str) const;
+
+private:
+
+	struct Segment
+	{
+		std::wstring text;
+		bool containsQuestionMark;
+	};
+
+	// A single pattern, split at each '*'. If the pattern contains at
+	// least one '*', the first segment is anchored to the start of the
+	// string and the last segment to the end. Each of the segments in
+	// between can then appear anywhere in the remaining part of the string.
+	struct Alternative
+	{
+		std::vector<Segment> segments;
+		bool containsStar;
+		std::size_t minLength;
+	};
+
+	static Alternative ParseAlternative(std::wstring_view pattern);
+	static bool MatchesAlternative(const Alternative &alternative, std::wstring_view str);
+	static bool MatchesSegmentAt(const Segment &segment, std::wstring_view str, std::size_t position);
+	static std::size_t FindSegment(const Segment &segment, std::wstring_view str,
+		std::size_t start, std::size_t end);
+
+	bool m_caseSensitive;
+	std::vector<Alternative> m_alternatives;
+};
\ No newline at end of file
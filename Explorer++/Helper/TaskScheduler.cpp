@@ -0,0 +1,263 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cassert>
+
+int TaskScheduler::GetDefaultNumThreads()
+{
+	// Most tasks spend their time waiting on the shell or the disk, so
+	// there's some benefit to having at least a couple of threads, even
+	// on a single core system.
+	unsigned int numThreads = std::thread::hardware_concurrency();
+	return static_cast<int>((std::max)(2U, (std::min)(numThreads, 16U)));
+}
+
+TaskScheduler::TaskScheduler(int numThreads) :
+	m_nextWorker(0),
+	m_nextQueue(0),
+	m_stop(false)
+{
+	assert(numThreads > 0);
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_workers.emplace_back(&TaskScheduler::WorkerMain, this, i);
+	}
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		assert(m_queues.empty());
+		m_stop = true;
+	}
+
+	m_taskCondition.notify_all();
+
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+std::unique_ptr<TaskScheduler::Queue> TaskScheduler::CreateQueue(int maxConcurrency)
+{
+	assert(maxConcurrency > 0);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	int worker = static_cast<int>(m_nextWorker++ % m_workers.size());
+
+	// The constructor is private, so make_unique can't be used here.
+	std::unique_ptr<Queue> queue(new Queue(this, maxConcurrency, worker));
+	m_queues.push_back(queue.get());
+
+	return queue;
+}
+
+int TaskScheduler::GetNumThreads() const
+{
+	return static_cast<int>(m_workers.size());
+}
+
+void TaskScheduler::WorkerMain(int workerIndex)
+{
+	CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+
+	while (true)
+	{
+		Queue *queue = nullptr;
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskCondition.wait(lock, [this, workerIndex, &queue, &task] {
+				return m_stop || TakeTask(workerIndex, queue, task);
+			});
+
+			if (!task)
+			{
+				break;
+			}
+		}
+
+		task();
+
+		// Anything captured by the task is destroyed here, outside the
+		// lock.
+		task = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// The queue may be destroyed as soon as the lock is released,
+			// so it can't be accessed after this point.
+			queue->m_numRunningTasks--;
+		}
+
+		m_taskFinishedCondition.notify_all();
+	}
+
+	CoUninitialize();
+}
+
+// Must be called with m_mutex held.
+bool TaskScheduler::TakeTask(int workerIndex, Queue *&queue, std::function<void()> &task)
+{
+	if (m_queues.empty())
+	{
+		return false;
+	}
+
+	// The starting point rotates, so that queues at the same priority
+	// level are served in turn.
+	std::size_t start = m_nextQueue++ % m_queues.size();
+
+	for (int priorityClass = 0; priorityClass < NUM_PRIORITY_CLASSES; priorityClass++)
+	{
+		// The first pass only considers this worker's own queues. The
+		// second pass steals from the queues belonging to the other
+		// workers.
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (std::size_t i = 0; i < m_queues.size(); i++)
+			{
+				Queue *currentQueue = m_queues[(start + i) % m_queues.size()];
+				bool ownQueue = (currentQueue->m_worker == workerIndex);
+
+				if (ownQueue != (pass == 0))
+				{
+					continue;
+				}
+
+				if (TakeTaskFromQueue(currentQueue, priorityClass, task))
+				{
+					queue = currentQueue;
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+// Must be called with m_mutex held.
+bool TaskScheduler::TakeTaskFromQueue(Queue *queue, int priorityClass, std::function<void()> &task)
+{
+	if (queue->m_numRunningTasks >= queue->m_maxConcurrency)
+	{
+		return false;
+	}
+
+	std::deque<std::function<void()>> *tasks = nullptr;
+
+	if (queue->m_active)
+	{
+		if (priorityClass == 0)
+		{
+			tasks = &queue->m_visibleTasks;
+		}
+		else if (priorityClass == 1)
+		{
+			tasks = &queue->m_normalTasks;
+		}
+	}
+	else if (priorityClass == 2)
+	{
+		tasks = !queue->m_visibleTasks.empty() ? &queue->m_visibleTasks : &queue->m_normalTasks;
+	}
+
+	if (!tasks || tasks->empty())
+	{
+		return false;
+	}
+
+	task = std::move(tasks->front());
+	tasks->pop_front();
+
+	queue->m_numRunningTasks++;
+
+	return true;
+}
+
+void TaskScheduler::AddTask(Queue *queue, TaskPriority priority, std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (priority == TaskPriority::Visible)
+		{
+			queue->m_visibleTasks.push_back(std::move(task));
+		}
+		else
+		{
+			queue->m_normalTasks.push_back(std::move(task));
+		}
+	}
+
+	m_taskCondition.notify_one();
+}
+
+void TaskScheduler::RemoveQueue(Queue *queue)
+{
+	CancelQueue(queue);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_queues.erase(std::remove(m_queues.begin(), m_queues.end(), queue), m_queues.end());
+
+	m_taskFinishedCondition.wait(lock, [queue] {
+		return queue->m_numRunningTasks == 0;
+	});
+}
+
+void TaskScheduler::CancelQueue(Queue *queue)
+{
+	std::deque<std::function<void()>> visibleTasks;
+	std::deque<std::function<void()>> normalTasks;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		visibleTasks.swap(queue->m_visibleTasks);
+		normalTasks.swap(queue->m_normalTasks);
+	}
+
+	// The tasks are destroyed once this function returns, outside of the
+	// lock.
+}
+
+void TaskScheduler::SetQueueActive(Queue *queue, bool active)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	queue->m_active = active;
+}
+
+TaskScheduler::Queue::Queue(TaskScheduler *scheduler, int maxConcurrency, int worker) :
+	m_scheduler(scheduler),
+	m_maxConcurrency(maxConcurrency),
+	m_worker(worker),
+	m_numRunningTasks(0),
+	m_active(false)
+{
+}
+
+TaskScheduler::Queue::~Queue()
+{
+	m_scheduler->RemoveQueue(this);
+}
+
+void TaskScheduler::Queue::Cancel()
+{
+	m_scheduler->CancelQueue(this);
+}
+
+void TaskScheduler::Queue::SetActive(bool active)
+{
+	m_scheduler->SetQueueActive(this, active);
+}
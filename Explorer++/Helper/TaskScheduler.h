@@ -0,0 +1,141 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A single, application-wide set of worker threads that background work
+// (e.g. retrieving icons, thumbnails and column text) is run on.
+//
+// Work isn't submitted to the scheduler directly. Instead, each component
+// (typically one per tab) creates its own queue. Tasks are then picked
+// in the following order:
+//
+// 1. Visible tasks from active queues (e.g. rows that are currently
+//    shown in the selected tab).
+// 2. Other tasks from active queues.
+// 3. Tasks from inactive queues (e.g. background tabs).
+//
+// Each queue is assigned to one of the workers. A worker will take a task
+// from one of its own queues if there's one available at the current
+// priority level. If not, it steals a task from a queue belonging to
+// another worker, so that no worker sits idle while work is waiting.
+//
+// Each worker thread is initialized as a single-threaded COM apartment,
+// since the majority of tasks make use of the shell.
+class TaskScheduler
+{
+public:
+
+	enum class TaskPriority
+	{
+		// The result of the task will be shown straight away (e.g. an
+		// icon for an item that's on screen).
+		Visible,
+
+		Normal
+	};
+
+	class Queue;
+
+	static int GetDefaultNumThreads();
+
+	explicit TaskScheduler(int numThreads);
+
+	// All queues should be destroyed before the scheduler is.
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler &) = delete;
+	TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+	// At most maxConcurrency tasks from the queue will run at once. A
+	// value of 1 means that tasks from the queue will run one after
+	// another, in the order they were queued. Queues are initially
+	// inactive.
+	std::unique_ptr<Queue> CreateQueue(int maxConcurrency = 1);
+
+	int GetNumThreads() const;
+
+private:
+
+	static constexpr int NUM_PRIORITY_CLASSES = 3;
+
+	void WorkerMain(int workerIndex);
+	bool TakeTask(int workerIndex, Queue *&queue, std::function<void()> &task);
+	bool TakeTaskFromQueue(Queue *queue, int priorityClass, std::function<void()> &task);
+	void AddTask(Queue *queue, TaskPriority priority, std::function<void()> task);
+	void RemoveQueue(Queue *queue);
+	void CancelQueue(Queue *queue);
+	void SetQueueActive(Queue *queue, bool active);
+
+	std::vector<std::thread> m_workers;
+
+	// Protects each of the members below, as well as the contents of each
+	// queue.
+	std::mutex m_mutex;
+	std::condition_variable m_taskCondition;
+	std::condition_variable m_taskFinishedCondition;
+	std::vector<Queue *> m_queues;
+	unsigned int m_nextWorker;
+	unsigned int m_nextQueue;
+	bool m_stop;
+};
+
+class TaskScheduler::Queue
+{
+public:
+
+	// Removes any tasks that haven't started yet and waits for the tasks
+	// that are currently running to finish.
+	~Queue();
+
+	Queue(const Queue &) = delete;
+	Queue &operator=(const Queue &) = delete;
+
+	template <typename Function>
+	auto Push(TaskPriority priority, Function &&function)
+	{
+		using Result = decltype(function());
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+		auto future = task->get_future();
+
+		m_scheduler->AddTask(this, priority, [task] {
+			(*task)();
+		});
+
+		return future;
+	}
+
+	// Removes any tasks that haven't started yet (e.g. because the folder
+	// they were queued for is no longer being shown). The futures for
+	// those tasks will be abandoned.
+	void Cancel();
+
+	void SetActive(bool active);
+
+private:
+
+	friend TaskScheduler;
+
+	Queue(TaskScheduler *scheduler, int maxConcurrency, int worker);
+
+	TaskScheduler *const m_scheduler;
+	const int m_maxConcurrency;
+	const int m_worker;
+
+	// These are protected by the scheduler's mutex.
+	std::deque<std::function<void()>> m_visibleTasks;
+	std::deque<std::function<void()>> m_normalTasks;
+	int m_numRunningTasks;
+	bool m_active;
+};
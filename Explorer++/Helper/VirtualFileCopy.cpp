@@ -0,0 +1,320 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "VirtualFileCopy.h"
+#include <wil/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	HRESULT CopyItemToFile(NVirtualFileCopy::CopyItem &item, size_t chunkSize,
+		const NVirtualFileCopy::ChunkCallback &chunkCallback)
+	{
+		wil::com_ptr<IStream> stream;
+		HRESULT hr = CoGetInterfaceAndReleaseStream(item.marshaledStream.detach(), IID_PPV_ARGS(&stream));
+
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		wil::unique_hfile file(CreateFile(item.destinationPath.c_str(), GENERIC_WRITE, 0, nullptr,
+			CREATE_ALWAYS, item.attributes | FILE_FLAG_OVERLAPPED, nullptr));
+
+		if (!file)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		if (item.size != NVirtualFileCopy::UNKNOWN_SIZE)
+		{
+			// Reserving the space up front avoids having the file extended
+			// (and potentially fragmented) one chunk at a time.
+			FILE_ALLOCATION_INFO allocationInfo;
+			allocationInfo.AllocationSize.QuadPart = item.size;
+			SetFileInformationByHandle(file.get(), FileAllocationInfo, &allocationInfo,
+				sizeof(allocationInfo));
+		}
+
+		hr = NVirtualFileCopy::CopyStreamToFile(stream.get(), file.get(), item.size, chunkSize,
+			chunkCallback);
+
+		if (SUCCEEDED(hr))
+		{
+			// This is done after the data has been written, since writing
+			// to the file would otherwise update the last write time.
+			SetFileTime(file.get(), item.creationTime.get_ptr(), item.lastAccessTime.get_ptr(),
+				item.lastWriteTime.get_ptr());
+		}
+
+		file.reset();
+
+		if (FAILED(hr))
+		{
+			// The file may have been created read-only.
+			SetFileAttributes(item.destinationPath.c_str(), FILE_ATTRIBUTE_NORMAL);
+			DeleteFile(item.destinationPath.c_str());
+		}
+
+		return hr;
+	}
+}
+
+HRESULT NVirtualFileCopy::CopyStreamToFile(IStream *stream, HANDLE file, ULONGLONG maxBytes,
+	size_t chunkSize, const ChunkCallback &chunkCallback)
+{
+	assert(chunkSize > 0 && chunkSize <= ULONG_MAX);
+
+	wil::unique_event writeEvent;
+
+	if (!writeEvent.try_create(wil::EventOptions::ManualReset, nullptr))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	// The next chunk is read into one buffer while the previous chunk is
+	// being written out from the other.
+	std::vector<BYTE> buffers[2] = { std::vector<BYTE>(chunkSize), std::vector<BYTE>(chunkSize) };
+	int currentBuffer = 0;
+
+	OVERLAPPED overlapped = {};
+	bool writePending = false;
+	ULONG pendingWriteSize = 0;
+	ULONGLONG offset = 0;
+
+	auto finishPendingWrite = [&] () -> HRESULT {
+		if (!writePending)
+		{
+			return S_OK;
+		}
+
+		writePending = false;
+
+		DWORD bytesWritten;
+
+		if (!GetOverlappedResult(file, &overlapped, &bytesWritten, TRUE))
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		if (bytesWritten != pendingWriteSize)
+		{
+			return HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+		}
+
+		if (chunkCallback && !chunkCallback(bytesWritten))
+		{
+			return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+		}
+
+		return S_OK;
+	};
+
+	HRESULT hr = S_OK;
+
+	while (offset < maxBytes)
+	{
+		std::vector<BYTE> &buffer = buffers[currentBuffer];
+
+		ULONG bytesToRead = static_cast<ULONG>((std::min)(static_cast<ULONGLONG>(chunkSize), maxBytes - offset));
+		ULONG bytesRead = 0;
+		hr = stream->Read(buffer.data(), bytesToRead, &bytesRead);
+
+		if (FAILED(hr))
+		{
+			break;
+		}
+
+		// A stream can return fewer bytes than were requested without
+		// having reached the end, so the copy only stops once no data is
+		// returned at all.
+		if (bytesRead == 0)
+		{
+			break;
+		}
+
+		hr = finishPendingWrite();
+
+		if (FAILED(hr))
+		{
+			break;
+		}
+
+		overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		overlapped.hEvent = writeEvent.get();
+
+		if (!WriteFile(file, buffer.data(), bytesRead, nullptr, &overlapped)
+			&& GetLastError() != ERROR_IO_PENDING)
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			break;
+		}
+
+		writePending = true;
+		pendingWriteSize = bytesRead;
+		offset += bytesRead;
+		currentBuffer = 1 - currentBuffer;
+	}
+
+	// A write that's still in progress refers to one of the buffers, so
+	// it always has to be waited on.
+	HRESULT hrWrite = finishPendingWrite();
+
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (FAILED(hrWrite))
+	{
+		return hrWrite;
+	}
+
+	return S_OK;
+}
+
+std::vector<HRESULT> NVirtualFileCopy::CopyItems(std::vector<CopyItem> &items, size_t chunkSize,
+	const ProgressCallback &progressCallback)
+{
+	std::vector<HRESULT> results(items.size(), E_FAIL);
+
+	if (items.empty())
+	{
+		return results;
+	}
+
+	ULONGLONG knownTotal = 0;
+
+	for (const auto &item : items)
+	{
+		if (item.size != UNKNOWN_SIZE)
+		{
+			knownTotal += item.size;
+		}
+	}
+
+	std::atomic<size_t> nextItem(0);
+	std::atomic<ULONGLONG> bytesCopied(0);
+	std::atomic<ULONGLONG> unknownSizeBytesCopied(0);
+	std::atomic<bool> cancelled(false);
+
+	int numWorkers = static_cast<int>((std::min)(items.size(), static_cast<size_t>(MAX_CONCURRENT_COPIES)));
+
+	std::mutex mutex;
+	std::condition_variable workerFinishedCondition;
+	int numRunningWorkers = numWorkers;
+
+	auto workerMain = [&] {
+		// The worker doesn't pump messages, so it's placed in the
+		// multithreaded apartment.
+		CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+		size_t index;
+
+		while ((index = nextItem++) < items.size())
+		{
+			CopyItem &item = items[index];
+
+			if (cancelled)
+			{
+				// The stream still needs to be unmarshaled, so that the
+				// marshaling data is released.
+				wil::com_ptr<IStream> stream;
+				CoGetInterfaceAndReleaseStream(item.marshaledStream.detach(), IID_PPV_ARGS(&stream));
+
+				results[index] = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+				continue;
+			}
+
+			bool sizeKnown = (item.size != UNKNOWN_SIZE);
+
+			results[index] = CopyItemToFile(item, chunkSize, [&] (ULONG bytesWritten) {
+				// The unknown size count is updated first, so that the
+				// total read by the progress loop below is never less
+				// than the number of bytes copied.
+				if (!sizeKnown)
+				{
+					unknownSizeBytesCopied += bytesWritten;
+				}
+
+				bytesCopied += bytesWritten;
+
+				return !cancelled;
+			});
+		}
+
+		CoUninitialize();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			numRunningWorkers--;
+		}
+
+		workerFinishedCondition.notify_one();
+	};
+
+	std::vector<std::thread> workers;
+
+	for (int i = 0; i < numWorkers; i++)
+	{
+		workers.emplace_back(workerMain);
+	}
+
+	auto reportProgress = [&] {
+		if (!progressCallback)
+		{
+			return;
+		}
+
+		ULONGLONG copied = bytesCopied;
+		ULONGLONG total = knownTotal + unknownSizeBytesCopied;
+
+		if (!progressCallback(total, copied))
+		{
+			cancelled = true;
+		}
+	};
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (!workerFinishedCondition.wait_for(lock, std::chrono::milliseconds(PROGRESS_INTERVAL),
+			[&numRunningWorkers] { return numRunningWorkers == 0; }))
+		{
+			lock.unlock();
+			reportProgress();
+			lock.lock();
+		}
+	}
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+
+	reportProgress();
+
+	return results;
+}
+
+void NVirtualFileCopy::ScaleProgress(ULONGLONG totalBytes, ULONGLONG bytesCopied, UINT &workTotal,
+	UINT &workSoFar)
+{
+	while (totalBytes > UINT_MAX)
+	{
+		totalBytes >>= 1;
+		bytesCopied >>= 1;
+	}
+
+	workTotal = static_cast<UINT>(totalBytes);
+	workSoFar = static_cast<UINT>((std::min)(bytesCopied, totalBytes));
+}
@@ -0,0 +1,87 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <wil/com.h>
+#include <climits>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Copies virtual files (i.e. files that are provided as CFSTR_FILECONTENTS
+// streams, rather than existing on disk) to the filesystem.
+//
+// Each stream is read in fixed-size chunks. While one chunk is being
+// written out (using overlapped I/O), the next is read into a second
+// buffer. Several files are copied at once, each on its own worker thread.
+// The memory used is therefore bounded by
+// 2 * CHUNK_SIZE * MAX_CONCURRENT_COPIES, regardless of how large the
+// files are.
+namespace NVirtualFileCopy
+{
+	constexpr size_t CHUNK_SIZE = 1024 * 1024;
+	constexpr int MAX_CONCURRENT_COPIES = 4;
+
+	// How often progress is reported while a set of files is being
+	// copied, in milliseconds.
+	constexpr int PROGRESS_INTERVAL = 100;
+
+	// Used when the size of a file isn't known ahead of time. In that
+	// case, the entire stream is copied.
+	constexpr ULONGLONG UNKNOWN_SIZE = ULLONG_MAX;
+
+	// Called each time a chunk has been written to the file. Returning
+	// false cancels the copy.
+	using ChunkCallback = std::function<bool(ULONG bytesWritten)>;
+
+	// Called periodically while files are being copied. The total will
+	// only increase during a copy if the size of one or more of the files
+	// wasn't known in advance. Returning false cancels all outstanding
+	// copies.
+	using ProgressCallback = std::function<bool(ULONGLONG totalBytes, ULONGLONG bytesCopied)>;
+
+	struct CopyItem
+	{
+		// The stream that the contents should be read from. This should
+		// have been marshaled using CoMarshalInterThreadInterfaceInStream(),
+		// since it will be unmarshaled and read on a worker thread.
+		wil::com_ptr<IStream> marshaledStream;
+
+		// At most this many bytes will be copied from the stream.
+		ULONGLONG size;
+
+		std::wstring destinationPath;
+		DWORD attributes;
+
+		boost::optional<FILETIME> creationTime;
+		boost::optional<FILETIME> lastAccessTime;
+		boost::optional<FILETIME> lastWriteTime;
+	};
+
+	// Copies data from the current position of the stream to the file,
+	// until either the end of the stream is reached or maxBytes have been
+	// copied. If the file was opened with FILE_FLAG_OVERLAPPED, each
+	// chunk is read while the previous chunk is still being written.
+	// Either way, the data is written starting at the beginning of the
+	// file.
+	HRESULT CopyStreamToFile(IStream *stream, HANDLE file, ULONGLONG maxBytes,
+		size_t chunkSize, const ChunkCallback &chunkCallback);
+
+	// Copies each of the items, with up to MAX_CONCURRENT_COPIES copies
+	// running at once, and blocks until they've all finished. The
+	// progress callback is invoked on the calling thread. If a copy
+	// fails, the partially written file is deleted.
+	//
+	// Returns the result of each copy, in the same order as the items.
+	std::vector<HRESULT> CopyItems(std::vector<CopyItem> &items, size_t chunkSize,
+		const ProgressCallback &progressCallback);
+
+	// IFileOperationProgressSink::UpdateProgress() only accepts 32-bit
+	// values. This scales a pair of 64-bit values down (keeping their
+	// ratio) so that they fit.
+	void ScaleProgress(ULONGLONG totalBytes, ULONGLONG bytesCopied, UINT &workTotal,
+		UINT &workSoFar);
+}
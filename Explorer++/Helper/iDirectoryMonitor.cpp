@@ -3,13 +3,30 @@
 // See LICENSE in the top level directory
 
 #include "stdafx.h"
-#include <list>
 #include "iDirectoryMonitor.h"
-#include "Macros.h"
-
-
-DWORD WINAPI Thread_DirModifiedInternal(LPVOID Container);
-
+#include "Logging.h"
+#include <wil/resource.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Each watched directory has a single outstanding call to
+ReadDirectoryChangesW at any one time. All of the reads are
+associated with an I/O completion port, which is serviced by
+a small set of worker threads.
+
+While a completion is being processed (and the callback for the
+watch is being invoked), no read is outstanding for that watch.
+That's fine, since the system continues to record changes for the
+directory between reads; they'll be returned by the next read.
+This also means that the events for a single watch are always
+delivered in order.
+
+If the system isn't able to record all of the changes (e.g.
+because the read buffer wasn't large enough), the callback will be
+invoked with DIRECTORY_MONITOR_ACTION_OVERFLOW. */
 class CDirectoryMonitor : public IDirectoryMonitor
 {
 public:
@@ -28,52 +45,80 @@ public:
 		UINT WatchFlags, OnDirectoryAltered onDirectoryAltered,
 		BOOL bWatchSubTree, void *pData);
 	BOOL	StopDirectoryMonitor(int iStopId);
+	BOOL	GetWatchStatistics(int iWatchId, DirectoryWatchStatistics *pStatistics);
 
 private:
 
-	#define PRIMARY_BUFFER_SIZE 1000 * sizeof(FILE_NOTIFY_INFORMATION)
+	struct Watch
+	{
+		OVERLAPPED					overlapped;
+		HANDLE						hDirectory;
+		std::wstring				path;
+		UINT						watchFlags;
+		BOOL						watchSubTree;
+		OnDirectoryAltered			onDirectoryAltered;
+		void						*pData;
+
+		std::unique_ptr<DWORD[]>	buffer;
+		DWORD						bufferSize;
+
+		/* Set while a read is outstanding. */
+		bool						ioPending;
+
+		/* Set while the callback is being invoked for
+		the results of a read. */
+		bool						dispatching;
+
+		/* Set once the watch has been stopped. The watch
+		will be removed as soon as it's idle. */
+		bool						stopped;
+
+		DirectoryWatchStatistics	statistics;
+		ULONGLONG					currentSecondStart;
+		DWORD						eventsInCurrentSecond;
+	};
 
-	/* These function are only ever queued as APC's. */
-	static void CALLBACK	WatchAndCreateDirectoryInternal(ULONG_PTR dwParam);
-	static void CALLBACK	CompletionRoutine(DWORD dwErrorCode,DWORD NumberOfBytesTransferred,LPOVERLAPPED lpOverlapped);
-	static void CALLBACK	StopDirectoryWatch(ULONG_PTR dwParam);
+	using WatchMap = std::unordered_map<int, std::unique_ptr<Watch>>;
 
-	/* This function is called as an APC, and stops
-	the worker thread on exit. */
-	static void CALLBACK	ExitWorkerThread(ULONG_PTR dwParam);
+	static const int NUM_WORKER_THREADS = 2;
 
-	/* These are only called in the context of the
-	worker thread (i.e. they are called from APC's,
-	but are not queued as APC's themselves). */
-	static void CALLBACK	WatchDirectoryInternal(ULONG_PTR dwParam);
-	static void				DeleteRequest(ULONG_PTR dwParam);
+	static const DWORD FOLDER_BUFFER_SIZE = 32 * 1024;
+	static const DWORD SUBTREE_BUFFER_SIZE = 256 * 1024;
 
-	class CDirInfo
-	{
-	public:
-		OnDirectoryAltered		m_OnDirectoryAltered;
-
-		CDirectoryMonitor		*m_pDirectoryMonitor;
-		FILE_NOTIFY_INFORMATION	*m_FileNotifyBuffer;
-		HANDLE					m_hThread;
-		HANDLE					m_hDirectory;
-		OVERLAPPED				m_Async;
-		LPVOID					m_pData;
-		TCHAR					m_DirPath[MAX_PATH];
-		UINT					m_WatchFlags;
-		BOOL					m_bWatchSubTree;
-		BOOL					m_bMarkedForDeletion;
-		BOOL					m_bDirMonitored;
-		int						m_UniqueId;
-	};
+	/* ReadDirectoryChangesW will fail if a buffer larger than
+	this is used when watching a directory over the network. */
+	static const DWORD MAX_NETWORK_BUFFER_SIZE = 64 * 1024;
+
+	static const std::size_t MAX_POOLED_BUFFERS_PER_SIZE = 8;
+
+	static DWORD GetBufferSize(const TCHAR *directory, BOOL watchSubTree);
+
+	int AddWatch(HANDLE hDirectory, const TCHAR *directory, UINT watchFlags,
+		OnDirectoryAltered onDirectoryAltered, BOOL watchSubTree, void *pData);
+	bool IssueReadLocked(Watch &watch);
+	void StopWatchLocked(WatchMap::iterator itr);
+	void RemoveWatchLocked(WatchMap::iterator itr);
+
+	void WorkerThread();
+	void OnReadCompleted(int watchId, DWORD error, DWORD numBytesTransferred);
+	DWORD DispatchEvents(Watch &watch, DWORD error, DWORD numBytesTransferred);
+	static void UpdateEventRate(Watch &watch, ULONGLONG now);
+
+	std::unique_ptr<DWORD[]> AcquireBufferLocked(DWORD size);
+	void ReleaseBufferLocked(std::unique_ptr<DWORD[]> buffer, DWORD size);
 
 	int					m_iRefCount;
-	DWORD				m_ThreadId;
-	HANDLE				m_hThread;
-	std::list<CDirInfo>	m_DirWatchInfoList;
-	CRITICAL_SECTION	m_cs;
-	HANDLE				m_hStopThreadEvent;
+
+	wil::unique_handle	m_completionPort;
+	std::vector<std::thread>	m_workerThreads;
+
+	std::mutex			m_mutex;
+	std::condition_variable	m_watchRemovedCondition;
+	WatchMap			m_watches;
 	int					m_UniqueId;
+
+	/* Buffers that are no longer in use, keyed by size. */
+	std::unordered_map<DWORD, std::vector<std::unique_ptr<DWORD[]>>>	m_bufferPool;
 };
 
 HRESULT CreateDirectoryMonitor(IDirectoryMonitor **pDirectoryMonitor)
@@ -83,32 +128,45 @@ HRESULT CreateDirectoryMonitor(IDirectoryMonitor **pDirectoryMonitor)
 	return S_OK;
 }
 
-CDirectoryMonitor::CDirectoryMonitor(void)
+CDirectoryMonitor::CDirectoryMonitor(void) :
+	m_iRefCount(1),
+	m_UniqueId(0)
 {
-	m_iRefCount	= 1;
-	m_UniqueId	= 0;
-	m_hThread	= CreateThread(NULL,0,Thread_DirModifiedInternal,NULL,0,&m_ThreadId);
-
-	InitializeCriticalSection(&m_cs);
+	m_completionPort.reset(CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, NUM_WORKER_THREADS));
 
-	m_hStopThreadEvent = CreateEvent(NULL,TRUE,FALSE,NULL);
+	for (int i = 0; i < NUM_WORKER_THREADS; i++)
+	{
+		m_workerThreads.emplace_back(&CDirectoryMonitor::WorkerThread, this);
+	}
 }
 
 CDirectoryMonitor::~CDirectoryMonitor()
 {
-	/* Queue the APC that will stop the worker
-	thread. */
-	QueueUserAPC(ExitWorkerThread,m_hThread,(ULONG_PTR)this);
-	CloseHandle(m_hThread);
-
-	/* Wait for the worker thread to stop. Once it
-	has been stopped, delete any dependent data
-	(such as any critical sections). */
-	WaitForSingleObject(m_hStopThreadEvent,INFINITE);
-
-	DeleteCriticalSection(&m_cs);
-	m_DirWatchInfoList.clear();
-	CloseHandle(m_hStopThreadEvent);
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		for (auto itr = m_watches.begin(); itr != m_watches.end();)
+		{
+			auto next = std::next(itr);
+			StopWatchLocked(itr);
+			itr = next;
+		}
+
+		/* Any watches that still have a read outstanding (or are
+		in the middle of invoking their callback) will be removed by
+		a worker thread once they're idle. */
+		m_watchRemovedCondition.wait(lock, [this] { return m_watches.empty(); });
+	}
+
+	for (std::size_t i = 0; i < m_workerThreads.size(); i++)
+	{
+		PostQueuedCompletionStatus(m_completionPort.get(), 0, 0, nullptr);
+	}
+
+	for (auto &workerThread : m_workerThreads)
+	{
+		workerThread.join();
+	}
 }
 
 /* IUnknown interface members. */
@@ -148,286 +206,376 @@ ULONG __stdcall CDirectoryMonitor::Release(void)
 	return m_iRefCount;
 }
 
-DWORD WINAPI Thread_DirModifiedInternal(LPVOID lpParameter)
+int CDirectoryMonitor::WatchDirectory(const TCHAR *Directory, UINT WatchFlags,
+	OnDirectoryAltered onDirectoryAltered, BOOL bWatchSubTree, void *pData)
 {
-	UNREFERENCED_PARAMETER(lpParameter);
-
-	/* This is the main thread. Sleeps until woken up by a
-	change notification, and then goes back to sleep. */
+	if(Directory == NULL)
+		return -1;
 
+	/* This suppresses crtical error message boxes, such as the one
+	that mey arise from CreateFile() when opening attempting to
+	open a floppy drive that doesn't have a floppy disk (also
+	CD/DVD drives etc). */
 	SetErrorMode(SEM_FAILCRITICALERRORS);
 
-	/* Warning C4127 (conditional expression is
-	constant) temporarily disabled for this function. */
-	#pragma warning(push)
-	#pragma warning(disable:4127)
-	while(TRUE)
-	{
-		SleepEx(INFINITE,TRUE);
-	}
-	#pragma warning(pop)
+	HANDLE hDirectory = CreateFile(Directory,
+	FILE_LIST_DIRECTORY,FILE_SHARE_READ|FILE_SHARE_DELETE|FILE_SHARE_WRITE,
+	NULL,OPEN_EXISTING,FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED,NULL);
 
-	return 0;
+	return AddWatch(hDirectory, Directory, WatchFlags, onDirectoryAltered, bWatchSubTree, pData);
 }
 
-void CALLBACK CDirectoryMonitor::ExitWorkerThread(ULONG_PTR dwParam)
+int CDirectoryMonitor::WatchDirectory(HANDLE hDirectory, const TCHAR *Directory,
+	UINT WatchFlags, OnDirectoryAltered onDirectoryAltered, BOOL bWatchSubTree, void *pData)
 {
-	CDirectoryMonitor	*pdm = NULL;
-
-	pdm = (CDirectoryMonitor *)dwParam;
-
-	/* Set the event indicating that it is now
-	safe to destroy data that is shared between
-	threads. */
-	SetEvent(pdm->m_hStopThreadEvent);
+	if(Directory == NULL)
+		return -1;
 
-	ExitThread(0);
+	return AddWatch(hDirectory, Directory, WatchFlags, onDirectoryAltered, bWatchSubTree, pData);
 }
 
-int CDirectoryMonitor::WatchDirectory(const TCHAR *Directory, UINT WatchFlags,
-	OnDirectoryAltered onDirectoryAltered, BOOL bWatchSubTree, void *pData)
+DWORD CDirectoryMonitor::GetBufferSize(const TCHAR *directory, BOOL watchSubTree)
 {
-	CDirInfo	pDirInfo;
+	/* Watching an entire subtree can generate a much larger
+	number of changes in a short period of time. */
+	DWORD bufferSize = watchSubTree ? SUBTREE_BUFFER_SIZE : FOLDER_BUFFER_SIZE;
 
-	if(Directory == NULL)
-		return -1;
-
-	pDirInfo.m_pDirectoryMonitor	= this;
-	pDirInfo.m_hThread				= m_hThread;
-	pDirInfo.m_WatchFlags			= WatchFlags;
-	pDirInfo.m_UniqueId				= m_UniqueId;
-	pDirInfo.m_OnDirectoryAltered	= onDirectoryAltered;
-	pDirInfo.m_pData				= pData;
-	pDirInfo.m_bWatchSubTree		= bWatchSubTree;
-	pDirInfo.m_bMarkedForDeletion	= FALSE;
-
-	/* This suppresses crtical error message boxes, such as the one
-	that mey arise from CreateFile() when opening attempting to
-	open a floppy drive that doesn't have a floppy disk (also
-	CD/DVD drives etc). */
-	SetErrorMode(SEM_FAILCRITICALERRORS);
+	if (PathIsNetworkPath(directory) && bufferSize > MAX_NETWORK_BUFFER_SIZE)
+	{
+		bufferSize = MAX_NETWORK_BUFFER_SIZE;
+	}
 
-	StringCchCopy(pDirInfo.m_DirPath, SIZEOF_ARRAY(pDirInfo.m_DirPath), Directory);
+	return bufferSize;
+}
 
-	pDirInfo.m_hDirectory = CreateFile(pDirInfo.m_DirPath,
-	FILE_LIST_DIRECTORY,FILE_SHARE_READ|FILE_SHARE_DELETE|FILE_SHARE_WRITE,
-	NULL,OPEN_EXISTING,FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED,NULL);
+/* Takes ownership of both the directory handle and the
+user data, even if the directory can't be watched. */
+int CDirectoryMonitor::AddWatch(HANDLE hDirectory, const TCHAR *directory, UINT watchFlags,
+	OnDirectoryAltered onDirectoryAltered, BOOL watchSubTree, void *pData)
+{
+	if (hDirectory == INVALID_HANDLE_VALUE)
+	{
+		free(pData);
+		return -1;
+	}
 
-	if(pDirInfo.m_hDirectory == INVALID_HANDLE_VALUE)
+	auto watch = std::make_unique<Watch>();
+	watch->hDirectory = hDirectory;
+	watch->path = directory;
+	watch->watchFlags = watchFlags;
+	watch->watchSubTree = watchSubTree;
+	watch->onDirectoryAltered = onDirectoryAltered;
+	watch->pData = pData;
+	watch->bufferSize = GetBufferSize(directory, watchSubTree);
+	watch->ioPending = false;
+	watch->dispatching = false;
+	watch->stopped = false;
+	watch->statistics = {};
+	watch->statistics.bufferSize = watch->bufferSize;
+	watch->currentSecondStart = GetTickCount64();
+	watch->eventsInCurrentSecond = 0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	int watchId = m_UniqueId++;
+
+	/* The watch ID is used as the completion key, so that the
+	watch can be looked up once a read completes. */
+	if (!CreateIoCompletionPort(hDirectory, m_completionPort.get(), static_cast<ULONG_PTR>(watchId), 0))
 	{
+		CloseHandle(hDirectory);
 		free(pData);
 		return -1;
 	}
 
-	EnterCriticalSection(&m_cs);
+	watch->buffer = AcquireBufferLocked(watch->bufferSize);
 
-	/* TODO: This operation alters the list, including the
-	previously inserted item (e.g by updating list pointers).
-	Therefore, need to lock access between this function and
-	other reads of the inserted item. */
-	m_DirWatchInfoList.push_back(pDirInfo);
+	if (!IssueReadLocked(*watch))
+	{
+		LOG(warning) << _T("Unable to watch directory ") << watch->path << _T(" (error ") << GetLastError() << _T(")");
 
-	m_DirWatchInfoList.back().m_Async.hEvent = &m_DirWatchInfoList.back();
-	QueueUserAPC(WatchDirectoryInternal,m_hThread,(ULONG_PTR)&m_DirWatchInfoList.back());
+		ReleaseBufferLocked(std::move(watch->buffer), watch->bufferSize);
+		CloseHandle(hDirectory);
+		free(pData);
+		return -1;
+	}
 
-	LeaveCriticalSection(&m_cs);
+	m_watches.emplace(watchId, std::move(watch));
 
-	return m_UniqueId++;
+	return watchId;
 }
 
-int CDirectoryMonitor::WatchDirectory(HANDLE hDirectory, const TCHAR *Directory,
-	UINT WatchFlags, OnDirectoryAltered onDirectoryAltered, BOOL bWatchSubTree, void *pData)
+bool CDirectoryMonitor::IssueReadLocked(Watch &watch)
 {
-	CDirInfo	pDirInfo;
+	ZeroMemory(&watch.overlapped, sizeof(watch.overlapped));
 
-	if(Directory == NULL)
-		return -1;
+	BOOL res = ReadDirectoryChangesW(watch.hDirectory, watch.buffer.get(), watch.bufferSize,
+		watch.watchSubTree, watch.watchFlags, nullptr, &watch.overlapped, nullptr);
 
-	pDirInfo.m_pDirectoryMonitor	= this;
-	pDirInfo.m_hThread				= m_hThread;
-	pDirInfo.m_WatchFlags			= WatchFlags;
-	pDirInfo.m_UniqueId				= m_UniqueId;
-	pDirInfo.m_OnDirectoryAltered	= onDirectoryAltered;
-	pDirInfo.m_pData				= pData;
-	pDirInfo.m_bWatchSubTree		= bWatchSubTree;
-	pDirInfo.m_bMarkedForDeletion	= FALSE;
+	if (!res)
+	{
+		return false;
+	}
 
-	/* This suppresses crtical error message boxes, such as the one
-	that mey arise from CreateFile() when opening attempting to
-	open a floppy drive that doesn't have a floppy disk (also
-	CD/DVD drives etc). */
-	SetErrorMode(SEM_FAILCRITICALERRORS);
+	watch.ioPending = true;
 
-	StringCchCopy(pDirInfo.m_DirPath, SIZEOF_ARRAY(pDirInfo.m_DirPath), Directory);
+	return true;
+}
 
-	pDirInfo.m_hDirectory = hDirectory;
+BOOL CDirectoryMonitor::StopDirectoryMonitor(int iStopId)
+{
+	if(iStopId < 0)
+		return FALSE;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-	EnterCriticalSection(&m_cs);
+	auto itr = m_watches.find(iStopId);
 
-	m_DirWatchInfoList.push_back(pDirInfo);
-	m_DirWatchInfoList.back().m_Async.hEvent = &m_DirWatchInfoList.back();
-	//QueueUserAPC(WatchAndCreateDirectoryInternal,m_hThread,(ULONG_PTR)&m_DirWatchInfoList.back());
-	QueueUserAPC(WatchDirectoryInternal,m_hThread,(ULONG_PTR)&m_DirWatchInfoList.back());
+	if (itr == m_watches.end())
+	{
+		return FALSE;
+	}
 
-	LeaveCriticalSection(&m_cs);
+	StopWatchLocked(itr);
 
-	return m_UniqueId++;
+	return TRUE;
 }
 
-/* These functions (CreateFile and ReadDirectoryChangesW) DO NOT appear
-to put the thread in an alertable wait state. */
-void CALLBACK CDirectoryMonitor::WatchAndCreateDirectoryInternal(ULONG_PTR dwParam)
+void CDirectoryMonitor::StopWatchLocked(WatchMap::iterator itr)
 {
-	CDirInfo	*pDirInfo = NULL;
+	Watch &watch = *itr->second;
 
-	pDirInfo = reinterpret_cast<CDirInfo *>(dwParam);
+	if (watch.stopped)
+	{
+		return;
+	}
 
-	pDirInfo->m_hDirectory = CreateFile(pDirInfo->m_DirPath,
-	FILE_LIST_DIRECTORY,FILE_SHARE_READ|FILE_SHARE_DELETE|FILE_SHARE_WRITE,
-	NULL,OPEN_EXISTING,FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED,NULL);
+	watch.stopped = true;
 
-	WatchDirectoryInternal(dwParam);
+	if (watch.ioPending)
+	{
+		/* The watch will be removed once the cancelled
+		read completes. */
+		CancelIoEx(watch.hDirectory, &watch.overlapped);
+	}
+	else if (!watch.dispatching)
+	{
+		RemoveWatchLocked(itr);
+	}
 }
 
-void CDirectoryMonitor::WatchDirectoryInternal(ULONG_PTR dwParam)
+void CDirectoryMonitor::RemoveWatchLocked(WatchMap::iterator itr)
 {
-	CDirInfo	*pDirInfo = NULL;
+	Watch &watch = *itr->second;
 
-	pDirInfo = reinterpret_cast<CDirInfo *>(dwParam);
+	LOG(debug) << _T("Stopped watching directory ") << watch.path << _T(" (")
+		<< watch.statistics.numEvents << _T(" events, ")
+		<< watch.statistics.numOverflows << _T(" overflows, maximum queue depth ")
+		<< watch.statistics.maxQueueDepth << _T(")");
 
-	if(pDirInfo->m_hDirectory == INVALID_HANDLE_VALUE)
-	{
-		free(pDirInfo->m_pData);
+	CloseHandle(watch.hDirectory);
+	ReleaseBufferLocked(std::move(watch.buffer), watch.bufferSize);
+	free(watch.pData);
 
-		return;
-	}
+	m_watches.erase(itr);
 
-	pDirInfo->m_FileNotifyBuffer = (FILE_NOTIFY_INFORMATION *)malloc(PRIMARY_BUFFER_SIZE);
+	m_watchRemovedCondition.notify_all();
+}
 
-	pDirInfo->m_bDirMonitored = ReadDirectoryChangesW(pDirInfo->m_hDirectory,
-	pDirInfo->m_FileNotifyBuffer,PRIMARY_BUFFER_SIZE,
-	pDirInfo->m_bWatchSubTree,pDirInfo->m_WatchFlags,NULL,&pDirInfo->m_Async,
-	CompletionRoutine);
+void CDirectoryMonitor::WorkerThread()
+{
+	SetErrorMode(SEM_FAILCRITICALERRORS);
 
-	if(!pDirInfo->m_bDirMonitored)
+	while (true)
 	{
-		free(pDirInfo->m_FileNotifyBuffer);
-		CancelIo(pDirInfo->m_hDirectory);
-		CloseHandle(pDirInfo->m_hDirectory);
+		DWORD numBytesTransferred;
+		ULONG_PTR completionKey;
+		OVERLAPPED *overlapped;
+
+		BOOL res = GetQueuedCompletionStatus(m_completionPort.get(), &numBytesTransferred,
+			&completionKey, &overlapped, INFINITE);
+
+		/* A packet without an OVERLAPPED structure is only ever
+		posted when the worker threads are being stopped. */
+		if (overlapped == nullptr)
+		{
+			break;
+		}
+
+		DWORD error = res ? ERROR_SUCCESS : GetLastError();
+		OnReadCompleted(static_cast<int>(completionKey), error, numBytesTransferred);
 	}
 }
 
-void CALLBACK CDirectoryMonitor::CompletionRoutine(DWORD dwErrorCode,
-DWORD NumberOfBytesTransferred,LPOVERLAPPED lpOverlapped)
+void CDirectoryMonitor::OnReadCompleted(int watchId, DWORD error, DWORD numBytesTransferred)
 {
-	CDirInfo				*pDirInfo = NULL;
-	FILE_NOTIFY_INFORMATION	*pfni = NULL;
-	TCHAR					szFileName[MAX_PATH];
+	Watch *watch;
 
-	if((dwErrorCode == ERROR_SUCCESS) && (NumberOfBytesTransferred != 0))
 	{
-		if(lpOverlapped->hEvent == NULL)
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto itr = m_watches.find(watchId);
+
+		if (itr == m_watches.end())
+		{
 			return;
+		}
 
-		pDirInfo = reinterpret_cast<CDirInfo *>(lpOverlapped->hEvent);
+		watch = itr->second.get();
+		watch->ioPending = false;
 
-		pfni = pDirInfo->m_FileNotifyBuffer;
-		int i = 0;
+		if (watch->stopped)
+		{
+			RemoveWatchLocked(itr);
+			return;
+		}
 
-		do
+		if (error != ERROR_SUCCESS && error != ERROR_NOTIFY_ENUM_DIR)
 		{
-			if(i != 0)
-			{
-				pfni = (FILE_NOTIFY_INFORMATION *) ((LPBYTE) pfni + pfni->NextEntryOffset);
-			}
+			/* This can happen if the directory is deleted, or a
+			network connection is lost. There's nothing more that
+			can be done with the watch, so it's simply left idle
+			until it's stopped. */
+			LOG(warning) << _T("Stopped receiving changes for directory ") << watch->path
+				<< _T(" (error ") << error << _T(")");
+			return;
+		}
 
-			/* FileNameLength is size in bytes NOT characters. */
-			StringCchCopyN(szFileName,SIZEOF_ARRAY(szFileName),
-				pfni->FileName,pfni->FileNameLength / sizeof(TCHAR));
-			pDirInfo->m_OnDirectoryAltered(szFileName,pfni->Action,pDirInfo->m_pData);
+		watch->dispatching = true;
+	}
 
-			i++;
-		} while(pfni->NextEntryOffset != 0);
+	/* The lock isn't held while the callback is invoked, so that
+	the callback is free to stop this (or any other) watch. The
+	watch won't be removed while it's dispatching. */
+	DWORD numEvents = DispatchEvents(*watch, error, numBytesTransferred);
 
-		free(pDirInfo->m_FileNotifyBuffer);
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-		pDirInfo->m_FileNotifyBuffer = NULL;
+	auto itr = m_watches.find(watchId);
+	assert(itr != m_watches.end());
 
-		/* Rewatch the directory. */
-		WatchDirectoryInternal((ULONG_PTR)pDirInfo);
-	}
-	else if(dwErrorCode == ERROR_OPERATION_ABORTED)
+	watch->dispatching = false;
+
+	UpdateEventRate(*watch, GetTickCount64());
+	watch->eventsInCurrentSecond += numEvents;
+	watch->statistics.numEvents += numEvents;
+	watch->statistics.queueDepth = numEvents;
+	watch->statistics.maxQueueDepth = (std::max)(watch->statistics.maxQueueDepth, numEvents);
+
+	if (watch->stopped)
 	{
-		pDirInfo = reinterpret_cast<CDirInfo *>(lpOverlapped->hEvent);
+		RemoveWatchLocked(itr);
+		return;
+	}
 
-		/* The specified directory has stop been watched.
-		Remove its entry from the queue. */
-		DeleteRequest((ULONG_PTR)pDirInfo);
+	if (!IssueReadLocked(*watch))
+	{
+		LOG(warning) << _T("Unable to continue watching directory ") << watch->path
+			<< _T(" (error ") << GetLastError() << _T(")");
 	}
 }
 
-void CDirectoryMonitor::DeleteRequest(ULONG_PTR dwParam)
+/* Returns the number of events that were delivered. */
+DWORD CDirectoryMonitor::DispatchEvents(Watch &watch, DWORD error, DWORD numBytesTransferred)
 {
-	CDirInfo					*pDirInfo = NULL;
-	CDirectoryMonitor			*pDirectoryMonitor = NULL;
-	std::list<CDirInfo>::iterator	itr;
+	/* A successful read that returns no data indicates that the
+	changes didn't fit into the buffer. */
+	if (error == ERROR_NOTIFY_ENUM_DIR || numBytesTransferred == 0)
+	{
+		LOG(debug) << _T("Change buffer overflowed for directory ") << watch.path;
 
-	pDirInfo = reinterpret_cast<CDirInfo *>(dwParam);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			watch.statistics.numOverflows++;
+		}
 
-	pDirectoryMonitor = pDirInfo->m_pDirectoryMonitor;
+		watch.onDirectoryAltered(_T(""), DIRECTORY_MONITOR_ACTION_OVERFLOW, watch.pData);
 
-	free(pDirInfo->m_FileNotifyBuffer);
-	free(pDirInfo->m_pData);
+		return 0;
+	}
 
-	EnterCriticalSection(&pDirectoryMonitor->m_cs);
+	auto *buffer = reinterpret_cast<const BYTE *>(watch.buffer.get());
+	DWORD offset = 0;
+	DWORD numEvents = 0;
+	std::wstring fileName;
 
-	for(itr = pDirectoryMonitor->m_DirWatchInfoList.begin();itr != pDirectoryMonitor->m_DirWatchInfoList.end();itr++)
+	while (true)
 	{
-		if(itr->m_UniqueId == pDirInfo->m_UniqueId)
+		auto *fileNotifyInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(buffer + offset);
+
+		/* FileNameLength is size in bytes NOT characters. */
+		fileName.assign(fileNotifyInfo->FileName, fileNotifyInfo->FileNameLength / sizeof(WCHAR));
+		watch.onDirectoryAltered(fileName.c_str(), fileNotifyInfo->Action, watch.pData);
+
+		numEvents++;
+
+		if (fileNotifyInfo->NextEntryOffset == 0)
 		{
-			pDirectoryMonitor->m_DirWatchInfoList.erase(itr);
 			break;
 		}
+
+		offset += fileNotifyInfo->NextEntryOffset;
 	}
 
-	LeaveCriticalSection(&pDirectoryMonitor->m_cs);
+	return numEvents;
 }
 
-BOOL CDirectoryMonitor::StopDirectoryMonitor(int iStopId)
+void CDirectoryMonitor::UpdateEventRate(Watch &watch, ULONGLONG now)
 {
-	std::list<CDirInfo>::iterator	itr;
+	ULONGLONG elapsed = now - watch.currentSecondStart;
 
-	if(iStopId < 0)
-		return FALSE;
+	if (elapsed < 1000)
+	{
+		return;
+	}
 
-	EnterCriticalSection(&m_cs);
+	/* If more than a second has passed since the end of the
+	last period, no events were received in the last second. */
+	watch.statistics.eventsPerSecond = (elapsed < 2000) ? watch.eventsInCurrentSecond : 0;
+	watch.currentSecondStart = now;
+	watch.eventsInCurrentSecond = 0;
+}
 
-	for(itr = m_DirWatchInfoList.begin();itr != m_DirWatchInfoList.end();itr++)
-	{
-		if(itr->m_UniqueId == iStopId)
-		{
-			/* Only stop monitoring the directory if it was
-			actually monitored in the first place! */
-			if(itr->m_bDirMonitored)
-				QueueUserAPC(StopDirectoryWatch,m_hThread,(ULONG_PTR)itr->m_hDirectory);
+BOOL CDirectoryMonitor::GetWatchStatistics(int iWatchId, DirectoryWatchStatistics *pStatistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-			break;
-		}
+	auto itr = m_watches.find(iWatchId);
+
+	if (itr == m_watches.end())
+	{
+		return FALSE;
 	}
 
-	LeaveCriticalSection(&m_cs);
+	UpdateEventRate(*itr->second, GetTickCount64());
+
+	*pStatistics = itr->second->statistics;
 
 	return TRUE;
 }
 
-void CALLBACK CDirectoryMonitor::StopDirectoryWatch(ULONG_PTR dwParam)
+std::unique_ptr<DWORD[]> CDirectoryMonitor::AcquireBufferLocked(DWORD size)
 {
-	HANDLE	hDirectory;
+	auto &buffers = m_bufferPool[size];
+
+	if (!buffers.empty())
+	{
+		auto buffer = std::move(buffers.back());
+		buffers.pop_back();
+		return buffer;
+	}
 
-	hDirectory = reinterpret_cast<HANDLE>(dwParam);
+	/* Allocated as an array of DWORDs, since the buffer passed to
+	ReadDirectoryChangesW needs to be DWORD-aligned. */
+	return std::make_unique<DWORD[]>(size / sizeof(DWORD));
+}
 
-	CancelIo(hDirectory);
-	CloseHandle(hDirectory);
+void CDirectoryMonitor::ReleaseBufferLocked(std::unique_ptr<DWORD[]> buffer, DWORD size)
+{
+	auto &buffers = m_bufferPool[size];
 
-	hDirectory = NULL;
-}
\ No newline at end of file
+	if (buffers.size() < MAX_POOLED_BUFFERS_PER_SIZE)
+	{
+		buffers.push_back(std::move(buffer));
+	}
+}
@@ -6,6 +6,28 @@
 
 #include <windows.h>
 
+/* Passed to the callback (with an empty filename) when the
+system wasn't able to record all of the changes made to a
+watched directory (e.g. because too many changes were made
+in a short period of time). In that case, the contents of the
+directory should be resynchronized. */
+const DWORD DIRECTORY_MONITOR_ACTION_OVERFLOW = 0xFFFF;
+
+struct DirectoryWatchStatistics
+{
+	ULONGLONG	numEvents;
+	ULONGLONG	numOverflows;
+
+	/* The number of events received in the last full second. */
+	DWORD		eventsPerSecond;
+
+	/* The number of events delivered by the most recent
+	completion, along with the highest number seen. */
+	DWORD		queueDepth;
+	DWORD		maxQueueDepth;
+
+	DWORD		bufferSize;
+};
 
 typedef void (*OnDirectoryAltered)(const TCHAR *szFileName, DWORD dwAction, void *pData);
 
@@ -19,6 +41,7 @@ __interface IDirectoryMonitor : IUnknown
 		UINT WatchFlags, OnDirectoryAltered onDirectoryAltered,
 		BOOL bWatchSubTree, void *pData);
 	BOOL StopDirectoryMonitor(int iStopIndex);
+	BOOL GetWatchStatistics(int iWatchId, DirectoryWatchStatistics *pStatistics);
 };
 
-HRESULT CreateDirectoryMonitor(IDirectoryMonitor **pDirectoryMonitor);
\ No newline at end of file
+HRESULT CreateDirectoryMonitor(IDirectoryMonitor **pDirectoryMonitor);
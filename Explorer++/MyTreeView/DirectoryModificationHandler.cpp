@@ -7,6 +7,8 @@
 #include "../Helper/Helper.h"
 #include "../Helper/Macros.h"
 #include "../Helper/ShellHelper.h"
+#include <boost/algorithm/string.hpp>
+#include <wil/common.h>
 
 const UINT DIRECTORYMODIFIED_TIMER_ID = 0;
 const UINT DIRECTORYMODIFIED_TIMER_ELAPSE = 500;
@@ -66,6 +68,12 @@ void CMyTreeView::DirectoryAltered(void)
 			case FILE_ACTION_RENAMED_NEW_NAME:
 				DirectoryAlteredRenameFile(af.szFileName);
 				break;
+
+			/* Some of the notifications for the drive were
+			lost, so anything within it may have changed. */
+			case DIRECTORY_MONITOR_ACTION_OVERFLOW:
+				ResyncExpandedFolders(af.szFileName);
+				break;
 		}
 	}
 
@@ -267,6 +275,153 @@ void CMyTreeView::DirectoryAlteredRenameFile(const TCHAR *szFullFileName)
 	}
 }
 
+/* Compares each of the expanded folders under the specified
+root against its contents on disk. Collapsed folders don't
+need to be checked, since their children are re-enumerated
+when they're expanded. */
+void CMyTreeView::ResyncExpandedFolders(const TCHAR *szRoot)
+{
+	std::vector<std::wstring> folders;
+	std::unordered_set<std::wstring> folderSet;
+	FindExpandedFolders(TreeView_GetRoot(m_hTreeView), szRoot, folders, folderSet);
+
+	for(const auto &folder : folders)
+	{
+		ResyncFolder(folder.c_str());
+	}
+}
+
+/* A folder can appear more than once in the tree (e.g. folders
+on the desktop), so each folder is only returned once. */
+void CMyTreeView::FindExpandedFolders(HTREEITEM hItem, const TCHAR *szRoot,
+	std::vector<std::wstring> &folders, std::unordered_set<std::wstring> &folderSet)
+{
+	for(; hItem != NULL; hItem = TreeView_GetNextSibling(m_hTreeView, hItem))
+	{
+		if(!(TreeView_GetItemState(m_hTreeView, hItem, TVIS_EXPANDED) & TVIS_EXPANDED))
+		{
+			continue;
+		}
+
+		auto pidl = GetItemPidl(hItem);
+
+		TCHAR szPath[MAX_PATH];
+		HRESULT hr = GetDisplayName(pidl.get(), szPath, SIZEOF_ARRAY(szPath), SHGDN_FORPARSING);
+
+		if(SUCCEEDED(hr) && PathIsPrefix(szRoot, szPath)
+			&& folderSet.insert(boost::to_lower_copy(std::wstring(szPath))).second)
+		{
+			folders.push_back(szPath);
+		}
+
+		FindExpandedFolders(TreeView_GetChild(m_hTreeView, hItem), szRoot, folders, folderSet);
+	}
+}
+
+void CMyTreeView::ResyncFolder(const TCHAR *szDirectory)
+{
+	HTREEITEM hParent = LocateExistingItem(szDirectory);
+
+	if(hParent == NULL)
+	{
+		return;
+	}
+
+	/* Every item is recorded when checking for removed items, since
+	the tree can contain items that aren't folders (e.g. zip files).
+	Only folders are added though. */
+	std::unordered_set<std::wstring> existingItems;
+	std::vector<std::wstring> folders;
+
+	TCHAR szSearchPath[MAX_PATH];
+	PathCombine(szSearchPath, szDirectory, _T("*"));
+
+	WIN32_FIND_DATA wfd;
+	HANDLE hFindFile = FindFirstFileEx(szSearchPath, FindExInfoBasic, &wfd,
+		FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+
+	/* If the folder can't be read, there's nothing to compare
+	against. If it's been removed, that will be picked up when
+	its parent is checked. */
+	if(hFindFile == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	do
+	{
+		if(lstrcmp(wfd.cFileName, _T(".")) == 0 || lstrcmp(wfd.cFileName, _T("..")) == 0)
+		{
+			continue;
+		}
+
+		existingItems.insert(boost::to_lower_copy(std::wstring(wfd.cFileName)));
+
+		if(WI_IsFlagSet(wfd.dwFileAttributes, FILE_ATTRIBUTE_DIRECTORY)
+			&& (m_bShowHidden || WI_IsFlagClear(wfd.dwFileAttributes, FILE_ATTRIBUTE_HIDDEN)))
+		{
+			folders.push_back(wfd.cFileName);
+		}
+	} while(FindNextFile(hFindFile, &wfd));
+
+	FindClose(hFindFile);
+
+	std::vector<std::wstring> removedItems;
+	std::unordered_set<std::wstring> currentItems;
+
+	for(HTREEITEM hChild = TreeView_GetChild(m_hTreeView, hParent); hChild != NULL;
+		hChild = TreeView_GetNextSibling(m_hTreeView, hChild))
+	{
+		auto pidl = GetItemPidl(hChild);
+
+		TCHAR szPath[MAX_PATH];
+		HRESULT hr = GetDisplayName(pidl.get(), szPath, SIZEOF_ARRAY(szPath), SHGDN_FORPARSING);
+
+		if(FAILED(hr))
+		{
+			continue;
+		}
+
+		/* Only items that are actually stored within the folder are
+		compared (virtual items, such as those that appear under the
+		desktop, are left alone). */
+		TCHAR szParent[MAX_PATH];
+		StringCchCopy(szParent, SIZEOF_ARRAY(szParent), szPath);
+		PathRemoveFileSpec(szParent);
+
+		if(lstrcmpi(szParent, szDirectory) != 0)
+		{
+			continue;
+		}
+
+		std::wstring name = boost::to_lower_copy(std::wstring(PathFindFileName(szPath)));
+
+		if(existingItems.count(name) == 0)
+		{
+			removedItems.push_back(szPath);
+		}
+
+		currentItems.insert(name);
+	}
+
+	for(const auto &removedItem : removedItems)
+	{
+		DirectoryAlteredRemoveFile(removedItem.c_str());
+	}
+
+	for(const auto &folder : folders)
+	{
+		if(currentItems.count(boost::to_lower_copy(folder)) != 0)
+		{
+			continue;
+		}
+
+		TCHAR szFullFileName[MAX_PATH];
+		PathCombine(szFullFileName, szDirectory, folder.c_str());
+		AddItem(szFullFileName);
+	}
+}
+
 void CMyTreeView::DirectoryAlteredCallback(const TCHAR *szFileName, DWORD dwAction, void *pData)
 {
 	DirectoryAltered_t	*pDirectoryAltered = NULL;
@@ -27,16 +27,17 @@
 int CALLBACK		CompareItemsStub(LPARAM lParam1,LPARAM lParam2,LPARAM lParamSort);
 DWORD WINAPI		Thread_MonitorAllDrives(LPVOID pParam);
 
-CMyTreeView::CMyTreeView(HWND hTreeView, HWND hParent, IDirectoryMonitor *pDirMon, CachedIcons *cachedIcons) :
+CMyTreeView::CMyTreeView(HWND hTreeView, HWND hParent, IDirectoryMonitor *pDirMon, CachedIcons *cachedIcons,
+	TaskScheduler *taskScheduler) :
 	m_hTreeView(hTreeView),
 	m_pDirMon(pDirMon),
 	m_cachedIcons(cachedIcons),
 	m_iRefCount(1),
 	m_itemIDCounter(0),
 	m_bDragDropRegistered(FALSE),
-	m_iconThreadPool(1),
+	m_iconTaskQueue(taskScheduler->CreateQueue()),
 	m_iconResultIDCounter(0),
-	m_subfoldersThreadPool(1),
+	m_subfoldersTaskQueue(taskScheduler->CreateQueue()),
 	m_subfoldersResultIDCounter(0)
 {
 	m_windowSubclasses.push_back(WindowSubclassWrapper(m_hTreeView, TreeViewProcStub,
@@ -53,14 +54,10 @@ CMyTreeView::CMyTreeView(HWND hTreeView, HWND hParent, IDirectoryMonitor *pDirMo
 	m_bDragAllowed		= FALSE;
 	m_bShowHidden		= TRUE;
 
-	auto initializeComTask = [] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-	};
-
-	m_iconThreadPool.push(initializeComTask);
-	m_subfoldersThreadPool.push(initializeComTask);
+	/* The treeview is always visible, so its tasks are
+	treated in the same way as those from the selected tab. */
+	m_iconTaskQueue->SetActive(true);
+	m_subfoldersTaskQueue->SetActive(true);
 
 	AddRoot();
 
@@ -75,16 +72,7 @@ CMyTreeView::~CMyTreeView()
 {
 	DeleteCriticalSection(&m_cs);
 
-	m_iconThreadPool.clear_queue();
-
-	auto uninitializeComTask = [] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
-		CoUninitialize();
-	};
-
-	m_iconThreadPool.push(uninitializeComTask);
-	m_subfoldersThreadPool.push(uninitializeComTask);
+	m_iconTaskQueue->Cancel();
 }
 
 LRESULT CALLBACK CMyTreeView::TreeViewProcStub(HWND hwnd, UINT uMsg, WPARAM wParam,
@@ -357,9 +345,8 @@ void CMyTreeView::QueueIconTask(HTREEITEM item, int internalIndex)
 
 	int iconResultID = m_iconResultIDCounter++;
 
-	auto result = m_iconThreadPool.push([this, iconResultID, item, internalIndex, basicItemInfo](int id) {
-		UNREFERENCED_PARAMETER(id);
-
+	auto result = m_iconTaskQueue->Push(TaskScheduler::TaskPriority::Visible,
+		[this, iconResultID, item, internalIndex, basicItemInfo] {
 		return FindIconAsync(m_hTreeView, iconResultID, item, internalIndex, basicItemInfo.pidl.get());
 	});
 
@@ -437,9 +424,8 @@ void CMyTreeView::QueueSubfoldersTask(HTREEITEM item)
 
 	int subfoldersResultID = m_subfoldersResultIDCounter++;
 
-	auto result = m_subfoldersThreadPool.push([this, subfoldersResultID, item, basicItemInfo] (int id) {
-		UNREFERENCED_PARAMETER(id);
-
+	auto result = m_subfoldersTaskQueue->Push(TaskScheduler::TaskPriority::Normal,
+		[this, subfoldersResultID, item, basicItemInfo] {
 		return CheckSubfoldersAsync(m_hTreeView, subfoldersResultID, item, basicItemInfo.pidl.get());
 	});
 
@@ -7,9 +7,11 @@
 #include "../Helper/DropHandler.h"
 #include "../Helper/iDirectoryMonitor.h"
 #include "../Helper/ShellHelper.h"
+#include "../Helper/TaskScheduler.h"
 #include "../Helper/WindowSubclassWrapper.h"
-#include "../ThirdParty/CTPL/cpl_stl.h"
 #include <optional>
+#include <unordered_set>
+#include <vector>
 
 class CachedIcons;
 
@@ -22,7 +24,8 @@ public:
 	ULONG __stdcall		AddRef(void);
 	ULONG __stdcall		Release(void);
 
-	CMyTreeView(HWND hTreeView, HWND hParent, IDirectoryMonitor *pDirMon, CachedIcons *cachedIcons);
+	CMyTreeView(HWND hTreeView, HWND hParent, IDirectoryMonitor *pDirMon, CachedIcons *cachedIcons,
+		TaskScheduler *taskScheduler);
 	~CMyTreeView();
 
 	/* Drop source functions. */
@@ -146,6 +149,10 @@ private:
 	void		DirectoryAlteredAddFile(const TCHAR *szFullFileName);
 	void		DirectoryAlteredRemoveFile(const TCHAR *szFullFileName);
 	void		DirectoryAlteredRenameFile(const TCHAR *szFullFileName);
+	void		ResyncExpandedFolders(const TCHAR *szRoot);
+	void		FindExpandedFolders(HTREEITEM hItem, const TCHAR *szRoot,
+		std::vector<std::wstring> &folders, std::unordered_set<std::wstring> &folderSet);
+	void		ResyncFolder(const TCHAR *szDirectory);
 
 	/* Icons. */
 	void		QueueIconTask(HTREEITEM item, int internalIndex);
@@ -187,11 +194,11 @@ private:
 	BOOL				m_bShowHidden;
 	std::vector<WindowSubclassWrapper>	m_windowSubclasses;
 
-	ctpl::thread_pool	m_iconThreadPool;
+	std::unique_ptr<TaskScheduler::Queue>	m_iconTaskQueue;
 	std::unordered_map<int, std::future<std::optional<IconResult>>>	m_iconResults;
 	int					m_iconResultIDCounter;
 
-	ctpl::thread_pool	m_subfoldersThreadPool;
+	std::unique_ptr<TaskScheduler::Queue>	m_subfoldersTaskQueue;
 	std::unordered_map<int, std::future<std::optional<SubfoldersResult>>>	m_subfoldersResults;
 	int					m_subfoldersResultIDCounter;
 
@@ -3,7 +3,15 @@
 // See LICENSE in the top level directory
 
 #include "pch.h"
-#include "../Explorer++/ShellBrowser/CachedIcons.h"
+#include "../Helper/CachedIcons.h"
+
+namespace
+{
+	bool DoesTestFileTypeHavePerFileIcons(const std::wstring &extension)
+	{
+		return extension == L".exe" || extension == L".lnk";
+	}
+}
 
 TEST(TestCachedIcons, TestMaxSize)
 {
@@ -85,4 +93,158 @@ TEST(TestCachedIcons, TestReplace)
 	// The replaced item should still exist.
 	itr = cachedIcons.findByPath(L"C:\\file1");
 	EXPECT_TRUE(itr != cachedIcons.end());
+}
+
+TEST(TestCachedIcons, TestSharedByType)
+{
+	CachedIcons cachedIcons(2, DoesTestFileTypeHavePerFileIcons);
+
+	EXPECT_FALSE(cachedIcons.findItemIcon(L"C:\\file1.txt", false));
+
+	cachedIcons.addOrUpdateItemIcon(L"C:\\file1.txt", false, 5);
+
+	// Any other text file should share the same icon, regardless of the
+	// case of its extension.
+	auto cachedIcon = cachedIcons.findItemIcon(L"C:\\folder\\file2.TXT", false);
+	ASSERT_TRUE(cachedIcon);
+	EXPECT_EQ(cachedIcon->iconIndex, 5);
+	EXPECT_TRUE(cachedIcon->sharedByType);
+
+	EXPECT_FALSE(cachedIcons.findItemIcon(L"C:\\file1.doc", false));
+
+	EXPECT_EQ(cachedIcons.getNumTypeEntries(), 1U);
+	EXPECT_EQ(cachedIcons.getNumPathEntries(), 0U);
+}
+
+TEST(TestCachedIcons, TestPerFileTypes)
+{
+	CachedIcons cachedIcons(2, DoesTestFileTypeHavePerFileIcons);
+
+	cachedIcons.addOrUpdateItemIcon(L"C:\\app1.exe", false, 5);
+
+	EXPECT_FALSE(cachedIcons.isIconSharedByType(L"C:\\app1.exe", false));
+	EXPECT_FALSE(cachedIcons.findItemIcon(L"C:\\app2.exe", false));
+
+	auto cachedIcon = cachedIcons.findItemIcon(L"C:\\app1.exe", false);
+	ASSERT_TRUE(cachedIcon);
+	EXPECT_EQ(cachedIcon->iconIndex, 5);
+	EXPECT_FALSE(cachedIcon->sharedByType);
+	EXPECT_EQ(cachedIcons.getNumTypeEntries(), 0U);
+}
+
+TEST(TestCachedIcons, TestFoldersAndVirtualItems)
+{
+	CachedIcons cachedIcons(2, DoesTestFileTypeHavePerFileIcons);
+
+	// Folders (even those with an extension) and virtual items are always
+	// cached by path.
+	EXPECT_FALSE(cachedIcons.isIconSharedByType(L"C:\\folder.txt", true));
+	EXPECT_FALSE(cachedIcons.isIconSharedByType(L"::{20D04FE0-3AEA-1069-A2D8-08002B30309D}\\item.txt", false));
+	EXPECT_TRUE(cachedIcons.isIconSharedByType(L"\\\\server\\share\\file.txt", false));
+
+	cachedIcons.addOrUpdateItemIcon(L"C:\\folder.txt", true, 3);
+	EXPECT_EQ(cachedIcons.getNumPathEntries(), 1U);
+	EXPECT_FALSE(cachedIcons.findItemIcon(L"C:\\file.txt", false));
+}
+
+TEST(TestCachedIcons, TestOverlayNotShared)
+{
+	CachedIcons cachedIcons(2, DoesTestFileTypeHavePerFileIcons);
+
+	cachedIcons.addOrUpdateItemIcon(L"C:\\file1.txt", false, (2 << 24) | 5);
+
+	auto cachedIcon = cachedIcons.findItemIcon(L"C:\\file2.txt", false);
+	ASSERT_TRUE(cachedIcon);
+	EXPECT_EQ(cachedIcon->iconIndex, 5);
+}
+
+TEST(TestCachedIcons, TestCounters)
+{
+	CachedIcons cachedIcons(2, DoesTestFileTypeHavePerFileIcons);
+
+	cachedIcons.findItemIcon(L"C:\\file1.txt", false);
+	cachedIcons.addOrUpdateItemIcon(L"C:\\file1.txt", false, 1);
+	cachedIcons.findItemIcon(L"C:\\file2.txt", false);
+
+	cachedIcons.addOrUpdateItemIcon(L"C:\\folder", true, 2);
+	cachedIcons.findItemIcon(L"C:\\folder", true);
+
+	EXPECT_EQ(cachedIcons.getNumMisses(), 1U);
+	EXPECT_EQ(cachedIcons.getNumTypeHits(), 1U);
+	EXPECT_EQ(cachedIcons.getNumPathHits(), 1U);
+
+	cachedIcons.resetCounters();
+	EXPECT_EQ(cachedIcons.getNumMisses(), 0U);
+	EXPECT_EQ(cachedIcons.getNumTypeHits(), 0U);
+	EXPECT_EQ(cachedIcons.getNumPathHits(), 0U);
+}
+
+TEST(TestCachedIcons, TestPathEntriesNotEvictedByType)
+{
+	CachedIcons cachedIcons(2, DoesTestFileTypeHavePerFileIcons);
+
+	cachedIcons.addOrUpdateItemIcon(L"C:\\folder", true, 1);
+
+	for (int i = 0; i < 100; i++)
+	{
+		cachedIcons.addOrUpdateItemIcon(L"C:\\file" + std::to_wstring(i) + L".txt", false, 2);
+	}
+
+	EXPECT_TRUE(cachedIcons.findItemIcon(L"C:\\folder", true));
+	EXPECT_EQ(cachedIcons.getNumPathEntries(), 1U);
+	EXPECT_EQ(cachedIcons.getNumTypeEntries(), 1U);
+}
+
+// Lists a large folder of files that all share the same type twice, with
+// the cache sized as it is in the application. Each miss stands in for a
+// call to SHGetFileInfo that would be needed to find the icon.
+TEST(TestCachedIcons, TestLargeFolder)
+{
+	const int NUM_FILES = 200000;
+	const std::size_t MAX_CACHED_ICONS = 1000;
+
+	auto listFolder = [&] (CachedIcons &cachedIcons, bool byType) {
+		int numMisses = 0;
+
+		for (int i = 0; i < NUM_FILES; i++)
+		{
+			std::wstring filePath = L"C:\\logs\\file" + std::to_wstring(i) + L".log";
+
+			bool found = byType
+				? cachedIcons.findItemIcon(filePath, false).is_initialized()
+				: (cachedIcons.findByPath(filePath) != cachedIcons.end());
+
+			if (found)
+			{
+				continue;
+			}
+
+			numMisses++;
+
+			if (byType)
+			{
+				cachedIcons.addOrUpdateItemIcon(filePath, false, 1);
+			}
+			else
+			{
+				cachedIcons.addOrUpdateFileIcon(filePath, 1);
+			}
+		}
+
+		return numMisses;
+	};
+
+	// When cached by path, the folder is too large for the cache, so
+	// every file misses again when the folder is relisted.
+	CachedIcons pathCache(MAX_CACHED_ICONS, DoesTestFileTypeHavePerFileIcons);
+	EXPECT_EQ(listFolder(pathCache, false), NUM_FILES);
+	EXPECT_EQ(listFolder(pathCache, false), NUM_FILES);
+
+	// When cached by type, only the very first file misses.
+	CachedIcons typeCache(MAX_CACHED_ICONS, DoesTestFileTypeHavePerFileIcons);
+	EXPECT_EQ(listFolder(typeCache, true), 1);
+	EXPECT_EQ(listFolder(typeCache, true), 0);
+
+	EXPECT_EQ(typeCache.getNumMisses(), 1U);
+	EXPECT_EQ(typeCache.getNumTypeHits(), static_cast<std::uint64_t>(NUM_FILES * 2 - 1));
 }
\ No newline at end of file
@@ -0,0 +1,189 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/ChangeJournal.h"
+
+using namespace std::chrono_literals;
+
+class ChangeJournalTest : public ::testing::Test
+{
+protected:
+
+	void AddEvent(DWORD action, const std::wstring &fileName)
+	{
+		m_changeJournal.AddEvent(action, fileName, m_startTime);
+	}
+
+	void Rename(const std::wstring &oldName, const std::wstring &newName)
+	{
+		AddEvent(FILE_ACTION_RENAMED_OLD_NAME, oldName);
+		AddEvent(FILE_ACTION_RENAMED_NEW_NAME, newName);
+	}
+
+	ChangeJournal m_changeJournal;
+	std::chrono::steady_clock::time_point m_startTime = std::chrono::steady_clock::now();
+};
+
+TEST_F(ChangeJournalTest, AddRemoveCancels)
+{
+	AddEvent(FILE_ACTION_ADDED, L"file.txt");
+	AddEvent(FILE_ACTION_MODIFIED, L"file.txt");
+	AddEvent(FILE_ACTION_REMOVED, L"file.txt");
+
+	EXPECT_TRUE(m_changeJournal.IsEmpty());
+	EXPECT_TRUE(m_changeJournal.TakeChanges().empty());
+}
+
+TEST_F(ChangeJournalTest, RepeatedModify)
+{
+	for (int i = 0; i < 100; i++)
+	{
+		AddEvent(FILE_ACTION_MODIFIED, L"file.txt");
+	}
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 1U);
+	EXPECT_EQ(changes[0].type, ChangeJournal::ChangeType::Modified);
+	EXPECT_EQ(changes[0].name, L"file.txt");
+}
+
+TEST_F(ChangeJournalTest, RenameChain)
+{
+	Rename(L"a.txt", L"b.txt");
+	Rename(L"b.txt", L"c.txt");
+	Rename(L"c.txt", L"d.txt");
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 1U);
+	EXPECT_EQ(changes[0].type, ChangeJournal::ChangeType::Renamed);
+	EXPECT_EQ(changes[0].oldName, L"a.txt");
+	EXPECT_EQ(changes[0].name, L"d.txt");
+}
+
+TEST_F(ChangeJournalTest, RenameBack)
+{
+	Rename(L"a.txt", L"b.txt");
+	Rename(L"b.txt", L"a.txt");
+
+	EXPECT_TRUE(m_changeJournal.TakeChanges().empty());
+}
+
+TEST_F(ChangeJournalTest, AddThenRename)
+{
+	// A file that's created and then renamed before the change is applied
+	// should simply be added with its final name.
+	AddEvent(FILE_ACTION_ADDED, L"New Text Document.txt");
+	Rename(L"New Text Document.txt", L"notes.txt");
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 1U);
+	EXPECT_EQ(changes[0].type, ChangeJournal::ChangeType::Added);
+	EXPECT_EQ(changes[0].name, L"notes.txt");
+}
+
+TEST_F(ChangeJournalTest, RemoveThenAdd)
+{
+	AddEvent(FILE_ACTION_REMOVED, L"file.txt");
+	AddEvent(FILE_ACTION_ADDED, L"file.txt");
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 1U);
+	EXPECT_EQ(changes[0].type, ChangeJournal::ChangeType::Modified);
+	EXPECT_EQ(changes[0].name, L"file.txt");
+}
+
+TEST_F(ChangeJournalTest, RenamedThenRemoved)
+{
+	Rename(L"a.txt", L"b.txt");
+	AddEvent(FILE_ACTION_REMOVED, L"b.txt");
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 1U);
+	EXPECT_EQ(changes[0].type, ChangeJournal::ChangeType::Removed);
+	EXPECT_EQ(changes[0].name, L"a.txt");
+}
+
+TEST_F(ChangeJournalTest, Swap)
+{
+	Rename(L"a.txt", L"tmp");
+	Rename(L"b.txt", L"a.txt");
+	Rename(L"tmp", L"b.txt");
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 2U);
+
+	for (const auto &change : changes)
+	{
+		EXPECT_EQ(change.type, ChangeJournal::ChangeType::Renamed);
+		EXPECT_NE(change.oldName, change.name);
+	}
+}
+
+TEST_F(ChangeJournalTest, Ordering)
+{
+	AddEvent(FILE_ACTION_MODIFIED, L"modified.txt");
+	AddEvent(FILE_ACTION_ADDED, L"added.txt");
+	Rename(L"old.txt", L"new.txt");
+	AddEvent(FILE_ACTION_REMOVED, L"removed.txt");
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 4U);
+	EXPECT_EQ(changes[0].type, ChangeJournal::ChangeType::Removed);
+	EXPECT_EQ(changes[1].type, ChangeJournal::ChangeType::Renamed);
+	EXPECT_EQ(changes[2].type, ChangeJournal::ChangeType::Added);
+	EXPECT_EQ(changes[3].type, ChangeJournal::ChangeType::Modified);
+}
+
+TEST_F(ChangeJournalTest, LargeBurst)
+{
+	// Simulates extracting an archive: each file is created, written to
+	// several times and, in some cases, created under a temporary name
+	// first.
+	for (int i = 0; i < 50000; i++)
+	{
+		std::wstring name = L"file" + std::to_wstring(i);
+
+		if (i % 2 == 0)
+		{
+			AddEvent(FILE_ACTION_ADDED, name + L".tmp");
+			Rename(name + L".tmp", name);
+		}
+		else
+		{
+			AddEvent(FILE_ACTION_ADDED, name);
+		}
+
+		AddEvent(FILE_ACTION_MODIFIED, name);
+		AddEvent(FILE_ACTION_MODIFIED, name);
+	}
+
+	auto changes = m_changeJournal.TakeChanges();
+	ASSERT_EQ(changes.size(), 50000U);
+
+	for (const auto &change : changes)
+	{
+		EXPECT_EQ(change.type, ChangeJournal::ChangeType::Added);
+	}
+
+	EXPECT_TRUE(m_changeJournal.IsEmpty());
+	EXPECT_EQ(m_changeJournal.GetNumEvents(), 0U);
+}
+
+TEST_F(ChangeJournalTest, DebounceDelay)
+{
+	AddEvent(FILE_ACTION_ADDED, L"file.txt");
+	auto initialDelay = m_changeJournal.GetDebounceDelay(m_startTime);
+
+	for (int i = 0; i < 5000; i++)
+	{
+		AddEvent(FILE_ACTION_MODIFIED, L"file.txt");
+	}
+
+	// The delay should grow as events continue to arrive...
+	EXPECT_GT(m_changeJournal.GetDebounceDelay(m_startTime), initialDelay);
+
+	// ...but the changes shouldn't be held back indefinitely.
+	EXPECT_EQ(m_changeJournal.GetDebounceDelay(m_startTime + 10s), 0ms);
+}
@@ -0,0 +1,236 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/ColumnCache.h"
+
+namespace
+{
+	const std::size_t CACHE_SIZE = 1024 * 1024;
+
+	std::wstring GetPath(int index)
+	{
+		return L"C:\\Media\\track" + std::to_wstring(index) + L".mp3";
+	}
+}
+
+TEST(TestColumnCache, TestHitAndMiss)
+{
+	ColumnCache cache(CACHE_SIZE);
+
+	EXPECT_FALSE(cache.Get(GetPath(0), 1, 100, 200));
+	EXPECT_EQ(cache.GetNumMisses(), 1U);
+
+	cache.Set(GetPath(0), 1, 100, 200, L"value");
+
+	auto value = cache.Get(GetPath(0), 1, 100, 200);
+	ASSERT_TRUE(value);
+	EXPECT_EQ(*value, L"value");
+	EXPECT_EQ(cache.GetNumHits(), 1U);
+
+	// Values are stored per column.
+	EXPECT_FALSE(cache.Get(GetPath(0), 2, 100, 200));
+	EXPECT_EQ(cache.GetNumMisses(), 2U);
+
+	cache.ResetCounters();
+	EXPECT_EQ(cache.GetNumHits(), 0U);
+	EXPECT_EQ(cache.GetNumMisses(), 0U);
+}
+
+TEST(TestColumnCache, TestStaleEntry)
+{
+	ColumnCache cache(CACHE_SIZE);
+
+	cache.Set(GetPath(0), 1, 100, 200, L"value");
+
+	// A change in either the size or the last write time should
+	// invalidate the entry.
+	EXPECT_FALSE(cache.Get(GetPath(0), 1, 101, 200));
+	EXPECT_EQ(cache.GetNumEntries(), 0U);
+
+	cache.Set(GetPath(0), 1, 100, 200, L"value");
+	EXPECT_FALSE(cache.Get(GetPath(0), 1, 100, 201));
+	EXPECT_EQ(cache.GetNumEntries(), 0U);
+	EXPECT_EQ(cache.GetSize(), 0U);
+}
+
+TEST(TestColumnCache, TestReplace)
+{
+	ColumnCache cache(CACHE_SIZE);
+
+	cache.Set(GetPath(0), 1, 100, 200, L"old");
+	cache.Set(GetPath(0), 1, 100, 300, L"new");
+	EXPECT_EQ(cache.GetNumEntries(), 1U);
+
+	auto value = cache.Get(GetPath(0), 1, 100, 300);
+	ASSERT_TRUE(value);
+	EXPECT_EQ(*value, L"new");
+}
+
+TEST(TestColumnCache, TestLruEviction)
+{
+	ColumnCache cache(CACHE_SIZE);
+
+	for (int i = 0; cache.GetSize() < CACHE_SIZE / 2; i++)
+	{
+		cache.Set(GetPath(i), 1, 0, 1, L"value");
+	}
+
+	std::size_t numEntries = cache.GetNumEntries();
+
+	// Use the first entry, so that it becomes the most recently used.
+	EXPECT_TRUE(cache.Get(GetPath(0), 1, 0, 1));
+
+	// This will take the cache beyond its maximum size.
+	std::size_t lastEntry = (numEntries * 5) / 2;
+
+	for (std::size_t i = numEntries; i <= lastEntry; i++)
+	{
+		cache.Set(GetPath(static_cast<int>(i)), 1, 0, 1, L"value");
+	}
+
+	EXPECT_LE(cache.GetSize(), CACHE_SIZE);
+
+	EXPECT_TRUE(cache.Get(GetPath(0), 1, 0, 1));
+	EXPECT_FALSE(cache.Get(GetPath(1), 1, 0, 1));
+	EXPECT_TRUE(cache.Get(GetPath(static_cast<int>(lastEntry)), 1, 0, 1));
+}
+
+TEST(TestColumnCache, TestSerialization)
+{
+	ColumnCache cache(CACHE_SIZE);
+
+	for (int i = 0; i < 100; i++)
+	{
+		cache.Set(GetPath(i), i % 5, i, i + 1, L"value" + std::to_wstring(i));
+	}
+
+	cache.Set(GetPath(100), 1, 0, 1, L"");
+
+	auto data = cache.Serialize();
+
+	ColumnCache loadedCache(CACHE_SIZE);
+	ASSERT_TRUE(loadedCache.Deserialize(data.data(), data.size()));
+	EXPECT_EQ(loadedCache.GetNumEntries(), cache.GetNumEntries());
+	EXPECT_EQ(loadedCache.GetSize(), cache.GetSize());
+
+	for (int i = 0; i < 100; i++)
+	{
+		auto value = loadedCache.Get(GetPath(i), i % 5, i, i + 1);
+		ASSERT_TRUE(value);
+		EXPECT_EQ(*value, L"value" + std::to_wstring(i));
+	}
+
+	auto emptyValue = loadedCache.Get(GetPath(100), 1, 0, 1);
+	ASSERT_TRUE(emptyValue);
+	EXPECT_TRUE(emptyValue->empty());
+}
+
+TEST(TestColumnCache, TestDeserializeSmallerCache)
+{
+	ColumnCache cache(CACHE_SIZE);
+
+	for (int i = 0; i < 1000; i++)
+	{
+		cache.Set(GetPath(i), 1, 0, 1, L"value");
+	}
+
+	auto data = cache.Serialize();
+
+	// Only the most recently used entries should be kept.
+	ColumnCache loadedCache(CACHE_SIZE / 100);
+	ASSERT_TRUE(loadedCache.Deserialize(data.data(), data.size()));
+	EXPECT_LE(loadedCache.GetSize(), CACHE_SIZE / 100);
+	EXPECT_GT(loadedCache.GetNumEntries(), 0U);
+	EXPECT_TRUE(loadedCache.Get(GetPath(999), 1, 0, 1));
+	EXPECT_FALSE(loadedCache.Get(GetPath(0), 1, 0, 1));
+}
+
+TEST(TestColumnCache, TestDeserializeInvalid)
+{
+	ColumnCache cache(CACHE_SIZE);
+	cache.Set(GetPath(0), 1, 0, 1, L"value");
+
+	auto data = cache.Serialize();
+
+	ColumnCache loadedCache(CACHE_SIZE);
+
+	// Truncated data.
+	EXPECT_FALSE(loadedCache.Deserialize(data.data(), data.size() - 1));
+	EXPECT_EQ(loadedCache.GetNumEntries(), 0U);
+
+	// Invalid signature.
+	data[0] = 0;
+	EXPECT_FALSE(loadedCache.Deserialize(data.data(), data.size()));
+	EXPECT_EQ(loadedCache.GetNumEntries(), 0U);
+
+	EXPECT_FALSE(loadedCache.Deserialize(data.data(), 0));
+}
+
+TEST(TestColumnCache, TestSaveAndLoad)
+{
+	TCHAR tempPath[MAX_PATH];
+	ASSERT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+
+	std::wstring filePath = std::wstring(tempPath) + L"TestColumnCache.dat";
+
+	ColumnCache cache(CACHE_SIZE);
+	cache.Set(GetPath(0), 1, 100, 200, L"value");
+	ASSERT_TRUE(cache.SaveToFile(filePath));
+
+	ColumnCache loadedCache(CACHE_SIZE);
+	ASSERT_TRUE(loadedCache.LoadFromFile(filePath));
+
+	auto value = loadedCache.Get(GetPath(0), 1, 100, 200);
+	ASSERT_TRUE(value);
+	EXPECT_EQ(*value, L"value");
+
+	DeleteFile(filePath.c_str());
+}
+
+// Simulates visiting a large media folder twice, once with an empty cache
+// and once with the cache populated by the first visit. Each column value
+// that isn't cached would require the file to be opened and parsed, so
+// the second visit shouldn't need to calculate anything.
+TEST(TestColumnCache, TestWarmVersusCold)
+{
+	const int numItems = 2000;
+	const unsigned int numColumns = 4;
+
+	ColumnCache cache(16 * 1024 * 1024);
+	int numCalculations = 0;
+
+	auto visitFolder = [&cache, &numCalculations]() {
+		for (int i = 0; i < numItems; i++)
+		{
+			for (unsigned int column = 0; column < numColumns; column++)
+			{
+				auto value = cache.Get(GetPath(i), column, i, 1);
+
+				if (!value)
+				{
+					numCalculations++;
+
+					cache.Set(GetPath(i), column, i, 1, L"3:25");
+				}
+			}
+		}
+	};
+
+	visitFolder();
+	EXPECT_EQ(numCalculations, numItems * static_cast<int>(numColumns));
+	EXPECT_EQ(cache.GetNumMisses(), static_cast<std::uint64_t>(numItems * numColumns));
+
+	// The cache is saved and reloaded between the two visits, as it would
+	// be between runs.
+	auto data = cache.Serialize();
+	ASSERT_TRUE(cache.Deserialize(data.data(), data.size()));
+	cache.ResetCounters();
+	numCalculations = 0;
+
+	visitFolder();
+	EXPECT_EQ(numCalculations, 0);
+	EXPECT_EQ(cache.GetNumHits(), static_cast<std::uint64_t>(numItems * numColumns));
+	EXPECT_EQ(cache.GetNumMisses(), 0U);
+}
@@ -0,0 +1,254 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/ColumnFetchQueue.h"
+#include <string>
+
+using TestQueue = ColumnFetchQueue<std::wstring>;
+using CompletionResult = TestQueue::CompletionResult;
+
+namespace
+{
+	std::wstring GetRowData(int internalIndex)
+	{
+		return L"item" + std::to_wstring(internalIndex);
+	}
+}
+
+TEST(TestColumnFetchQueue, TestRowGrouping)
+{
+	TestQueue queue;
+
+	// Only the first request requires a flush to be scheduled.
+	EXPECT_TRUE(queue.AddRequest(10, 0, 1));
+	EXPECT_FALSE(queue.AddRequest(10, 0, 2));
+	EXPECT_FALSE(queue.AddRequest(10, 0, 3));
+	EXPECT_FALSE(queue.AddRequest(10, 0, 2));
+
+	EXPECT_EQ(queue.Flush(0, 10, GetRowData), 1);
+
+	auto job = queue.TakeNextJob();
+	ASSERT_TRUE(job);
+	EXPECT_EQ(job->internalIndex, 10);
+	EXPECT_EQ(job->rowData, L"item10");
+	EXPECT_EQ(job->columnIds, (std::vector<unsigned int>{ 1, 2, 3 }));
+
+	EXPECT_FALSE(queue.TakeNextJob());
+}
+
+TEST(TestColumnFetchQueue, TestLifoOrder)
+{
+	TestQueue queue;
+
+	for (int i = 0; i < 5; i++)
+	{
+		queue.AddRequest(i, i, 1);
+	}
+
+	EXPECT_EQ(queue.Flush(0, 10, GetRowData), 5);
+
+	for (int i = 4; i >= 0; i--)
+	{
+		auto job = queue.TakeNextJob();
+		ASSERT_TRUE(job);
+		EXPECT_EQ(job->internalIndex, i);
+	}
+}
+
+TEST(TestColumnFetchQueue, TestRequestedAgain)
+{
+	TestQueue queue;
+
+	for (int i = 0; i < 5; i++)
+	{
+		queue.AddRequest(i, i, 1);
+	}
+
+	// Row 1 is requested again before the flush, and row 2 after it (e.g.
+	// because they've scrolled back into view). Each should then be served
+	// before the rows that were last requested earlier.
+	queue.AddRequest(1, 1, 1);
+	EXPECT_EQ(queue.Flush(0, 10, GetRowData), 5);
+	EXPECT_FALSE(queue.AddRequest(2, 2, 2));
+
+	std::vector<int> order;
+
+	while (auto job = queue.TakeNextJob())
+	{
+		order.push_back(job->internalIndex);
+
+		if (job->internalIndex == 2)
+		{
+			EXPECT_EQ(job->columnIds, (std::vector<unsigned int>{ 1, 2 }));
+		}
+
+		EXPECT_EQ(queue.CompleteJob(job->internalIndex, job->id), CompletionResult::Completed);
+	}
+
+	EXPECT_EQ(order, (std::vector<int>{ 2, 1, 4, 3, 0 }));
+	EXPECT_EQ(queue.GetNumRows(), 0U);
+}
+
+TEST(TestColumnFetchQueue, TestReadyJobExtended)
+{
+	TestQueue queue;
+
+	queue.AddRequest(0, 0, 1);
+	queue.Flush(0, 10, GetRowData);
+
+	// The job hasn't been taken yet, so there's no need for a separate job.
+	EXPECT_FALSE(queue.AddRequest(0, 0, 2));
+	EXPECT_EQ(queue.Flush(0, 10, GetRowData), 0);
+
+	auto job = queue.TakeNextJob();
+	ASSERT_TRUE(job);
+	EXPECT_EQ(job->columnIds, (std::vector<unsigned int>{ 1, 2 }));
+}
+
+TEST(TestColumnFetchQueue, TestInFlight)
+{
+	TestQueue queue;
+
+	queue.AddRequest(0, 0, 1);
+	queue.Flush(0, 10, GetRowData);
+
+	auto job = queue.TakeNextJob();
+	ASSERT_TRUE(job);
+
+	// Requests for columns that are already being retrieved are ignored.
+	EXPECT_FALSE(queue.AddRequest(0, 0, 1));
+	EXPECT_EQ(queue.CompleteJob(0, job->id), CompletionResult::Completed);
+	EXPECT_EQ(queue.GetNumRows(), 0U);
+
+	queue.AddRequest(0, 0, 1);
+	queue.Flush(0, 10, GetRowData);
+	job = queue.TakeNextJob();
+	ASSERT_TRUE(job);
+
+	// A column that's requested while the job is being processed should
+	// result in a second job once the first is complete.
+	EXPECT_FALSE(queue.AddRequest(0, 0, 2));
+	EXPECT_EQ(queue.CompleteJob(0, job->id), CompletionResult::CompletedFlushNeeded);
+	EXPECT_EQ(queue.Flush(0, 10, GetRowData), 1);
+
+	job = queue.TakeNextJob();
+	ASSERT_TRUE(job);
+	EXPECT_EQ(job->columnIds, (std::vector<unsigned int>{ 2 }));
+}
+
+TEST(TestColumnFetchQueue, TestDropOutOfRange)
+{
+	TestQueue queue;
+
+	for (int i = 0; i < 100; i++)
+	{
+		queue.AddRequest(i, i, 1);
+	}
+
+	queue.Flush(0, 100, GetRowData);
+	EXPECT_EQ(queue.GetNumQueuedJobs(), 100U);
+
+	// The user scrolls down, which results in a different set of rows
+	// being requested.
+	for (int i = 200; i < 220; i++)
+	{
+		queue.AddRequest(i, i, 1);
+	}
+
+	EXPECT_EQ(queue.Flush(200, 219, GetRowData), 20);
+	EXPECT_EQ(queue.GetNumQueuedJobs(), 20U);
+	EXPECT_EQ(queue.GetNumRows(), 20U);
+
+	// A dropped row can be requested again.
+	EXPECT_TRUE(queue.AddRequest(0, 0, 1));
+	EXPECT_EQ(queue.Flush(0, 0, GetRowData), 1);
+}
+
+TEST(TestColumnFetchQueue, TestInFlightNotDropped)
+{
+	TestQueue queue;
+
+	queue.AddRequest(0, 0, 1);
+	queue.Flush(0, 10, GetRowData);
+	auto job = queue.TakeNextJob();
+	ASSERT_TRUE(job);
+
+	queue.Flush(100, 110, GetRowData);
+	EXPECT_EQ(queue.GetNumRows(), 1U);
+
+	EXPECT_EQ(queue.CompleteJob(0, job->id), CompletionResult::Completed);
+	EXPECT_EQ(queue.GetNumRows(), 0U);
+}
+
+TEST(TestColumnFetchQueue, TestRemoveRow)
+{
+	TestQueue queue;
+
+	queue.AddRequest(0, 0, 1);
+	queue.RemoveRow(0);
+
+	// With no rows being collected, the next request should require a new
+	// flush.
+	EXPECT_TRUE(queue.AddRequest(1, 1, 1));
+	EXPECT_EQ(queue.Flush(0, 10, GetRowData), 1);
+
+	queue.RemoveRow(1);
+	EXPECT_FALSE(queue.TakeNextJob());
+}
+
+TEST(TestColumnFetchQueue, TestStaleJob)
+{
+	TestQueue queue;
+
+	queue.AddRequest(0, 0, 1);
+	queue.Flush(0, 10, GetRowData);
+	auto staleJob = queue.TakeNextJob();
+	ASSERT_TRUE(staleJob);
+
+	// The item is modified while the job is in progress, so its text is
+	// requested again.
+	queue.RemoveRow(0);
+	queue.AddRequest(0, 0, 1);
+	queue.Flush(0, 10, GetRowData);
+	auto currentJob = queue.TakeNextJob();
+	ASSERT_TRUE(currentJob);
+	EXPECT_NE(staleJob->id, currentJob->id);
+
+	EXPECT_EQ(queue.CompleteJob(0, staleJob->id), CompletionResult::Stale);
+	EXPECT_EQ(queue.CompleteJob(0, currentJob->id), CompletionResult::Completed);
+	EXPECT_EQ(queue.CompleteJob(0, currentJob->id), CompletionResult::Stale);
+}
+
+// Simulates rapidly scrolling through a very large folder. The number of
+// queued jobs should remain bounded by the number of visible rows,
+// regardless of how many rows are scrolled past.
+TEST(TestColumnFetchQueue, TestFastScroll)
+{
+	TestQueue queue;
+
+	const int numItems = 100000;
+	const int rowsPerPage = 40;
+
+	for (int top = 0; top + rowsPerPage <= numItems; top += 7)
+	{
+		for (int i = top; i < top + rowsPerPage; i++)
+		{
+			for (unsigned int column = 1; column <= 5; column++)
+			{
+				queue.AddRequest(i, i, column);
+			}
+		}
+
+		queue.Flush(top, top + rowsPerPage - 1, GetRowData);
+
+		ASSERT_LE(queue.GetNumRows(), static_cast<size_t>(rowsPerPage));
+
+		// Only a single job is processed each time the view scrolls.
+		auto job = queue.TakeNextJob();
+		ASSERT_TRUE(job);
+		EXPECT_EQ(job->columnIds.size(), 5U);
+		EXPECT_EQ(queue.CompleteJob(job->internalIndex, job->id), CompletionResult::Completed);
+	}
+}
@@ -0,0 +1,82 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/FolderDiff.h"
+
+namespace
+{
+	FolderDiffItem BuildItem(const std::wstring &name, ULONGLONG size = 0, ULONGLONG lastWriteTime = 0,
+		DWORD attributes = FILE_ATTRIBUTE_NORMAL)
+	{
+		return { name, attributes, size, lastWriteTime };
+	}
+
+	void ExpectChange(const ChangeJournal::Change &change, ChangeJournal::ChangeType type,
+		const std::wstring &name, const std::wstring &oldName = L"")
+	{
+		EXPECT_EQ(change.type, type);
+		EXPECT_EQ(change.name, name);
+		EXPECT_EQ(change.oldName, oldName);
+	}
+}
+
+TEST(FolderDiff, Unchanged)
+{
+	std::vector<FolderDiffItem> items = { BuildItem(L"a.txt", 10, 20), BuildItem(L"b.txt", 30, 40) };
+	EXPECT_TRUE(DiffFolderItems(items, items).empty());
+	EXPECT_TRUE(DiffFolderItems({}, {}).empty());
+}
+
+TEST(FolderDiff, AddedAndRemoved)
+{
+	std::vector<FolderDiffItem> currentItems = { BuildItem(L"a.txt"), BuildItem(L"b.txt") };
+	std::vector<FolderDiffItem> folderItems = { BuildItem(L"b.txt"), BuildItem(L"c.txt"), BuildItem(L"d.txt") };
+
+	auto changes = DiffFolderItems(currentItems, folderItems);
+	ASSERT_EQ(changes.size(), 3U);
+	ExpectChange(changes[0], ChangeJournal::ChangeType::Removed, L"a.txt");
+	ExpectChange(changes[1], ChangeJournal::ChangeType::Added, L"c.txt");
+	ExpectChange(changes[2], ChangeJournal::ChangeType::Added, L"d.txt");
+}
+
+TEST(FolderDiff, Modified)
+{
+	std::vector<FolderDiffItem> currentItems = { BuildItem(L"size", 1, 1), BuildItem(L"time", 1, 1),
+		BuildItem(L"attributes", 1, 1), BuildItem(L"same", 1, 1) };
+	std::vector<FolderDiffItem> folderItems = { BuildItem(L"size", 2, 1), BuildItem(L"time", 1, 2),
+		BuildItem(L"attributes", 1, 1, FILE_ATTRIBUTE_HIDDEN), BuildItem(L"same", 1, 1) };
+
+	auto changes = DiffFolderItems(currentItems, folderItems);
+	ASSERT_EQ(changes.size(), 3U);
+	ExpectChange(changes[0], ChangeJournal::ChangeType::Modified, L"size");
+	ExpectChange(changes[1], ChangeJournal::ChangeType::Modified, L"time");
+	ExpectChange(changes[2], ChangeJournal::ChangeType::Modified, L"attributes");
+}
+
+TEST(FolderDiff, CaseChange)
+{
+	std::vector<FolderDiffItem> currentItems = { BuildItem(L"file.txt", 1) };
+	std::vector<FolderDiffItem> folderItems = { BuildItem(L"File.TXT", 2) };
+
+	auto changes = DiffFolderItems(currentItems, folderItems);
+	ASSERT_EQ(changes.size(), 2U);
+	ExpectChange(changes[0], ChangeJournal::ChangeType::Renamed, L"File.TXT", L"file.txt");
+	ExpectChange(changes[1], ChangeJournal::ChangeType::Modified, L"File.TXT");
+}
+
+TEST(FolderDiff, Ordering)
+{
+	std::vector<FolderDiffItem> currentItems = { BuildItem(L"modified", 1), BuildItem(L"removed"),
+		BuildItem(L"renamed") };
+	std::vector<FolderDiffItem> folderItems = { BuildItem(L"added"), BuildItem(L"modified", 2),
+		BuildItem(L"RENAMED") };
+
+	auto changes = DiffFolderItems(currentItems, folderItems);
+	ASSERT_EQ(changes.size(), 4U);
+	ExpectChange(changes[0], ChangeJournal::ChangeType::Removed, L"removed");
+	ExpectChange(changes[1], ChangeJournal::ChangeType::Renamed, L"RENAMED", L"renamed");
+	ExpectChange(changes[2], ChangeJournal::ChangeType::Added, L"added");
+	ExpectChange(changes[3], ChangeJournal::ChangeType::Modified, L"modified");
+}
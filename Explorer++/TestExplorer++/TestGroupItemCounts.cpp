@@ -0,0 +1,66 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/GroupItemCounts.h"
+#include <vector>
+
+TEST(TestGroupItemCounts, TestCounts)
+{
+	GroupItemCounts counts;
+
+	counts.AddItem(0);
+	counts.AddItem(0);
+	counts.AddItem(1);
+	EXPECT_EQ(counts.GetNumItems(0), 2);
+	EXPECT_EQ(counts.GetNumItems(1), 1);
+	EXPECT_EQ(counts.GetNumItems(2), 0);
+
+	counts.RemoveItem(0);
+	EXPECT_EQ(counts.GetNumItems(0), 1);
+
+	counts.RemoveGroup(1);
+	EXPECT_EQ(counts.GetNumItems(1), 0);
+
+	counts.Clear();
+	EXPECT_EQ(counts.GetNumItems(0), 0);
+	EXPECT_TRUE(counts.TakeChangedGroups().empty());
+}
+
+// Each group should only be reported once per batch, no matter how many
+// items were added to it.
+TEST(TestGroupItemCounts, TestBatchedChanges)
+{
+	GroupItemCounts counts;
+
+	for (int i = 0; i < 100; i++)
+	{
+		counts.AddItem(i % 3);
+	}
+
+	EXPECT_EQ(counts.TakeChangedGroups(), (std::vector<int>{ 0, 1, 2 }));
+	EXPECT_TRUE(counts.TakeChangedGroups().empty());
+
+	EXPECT_EQ(counts.GetNumItems(0), 34);
+	EXPECT_EQ(counts.GetNumItems(1), 33);
+	EXPECT_EQ(counts.GetNumItems(2), 33);
+
+	// Moving items from one group to another (e.g. out of a provisional
+	// group) changes both groups.
+	for (int i = 0; i < 10; i++)
+	{
+		counts.RemoveItem(2);
+		counts.AddItem(1);
+	}
+
+	EXPECT_EQ(counts.TakeChangedGroups(), (std::vector<int>{ 1, 2 }));
+	EXPECT_EQ(counts.GetNumItems(1), 43);
+	EXPECT_EQ(counts.GetNumItems(2), 23);
+
+	// A group that's been removed shouldn't have its header updated.
+	counts.AddItem(0);
+	counts.AddItem(2);
+	counts.RemoveGroup(2);
+	EXPECT_EQ(counts.TakeChangedGroups(), (std::vector<int>{ 0 }));
+}
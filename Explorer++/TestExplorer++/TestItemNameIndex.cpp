@@ -0,0 +1,200 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/ItemNameIndex.h"
+#include <map>
+#include <random>
+#include <vector>
+
+TEST(TestItemNameIndex, TestLookup)
+{
+	ItemNameIndex index;
+	index.AddItem(0, L"Long file name.txt", L"LONGFI~1.TXT");
+	index.AddItem(1, L"short.txt", L"");
+
+	auto item = index.FindItem(L"Long file name.txt");
+	ASSERT_TRUE(item);
+	EXPECT_EQ(*item, 0);
+
+	item = index.FindItem(L"LONGFI~1.TXT");
+	ASSERT_TRUE(item);
+	EXPECT_EQ(*item, 0);
+
+	item = index.FindItem(L"short.txt");
+	ASSERT_TRUE(item);
+	EXPECT_EQ(*item, 1);
+
+	// Lookups are case-sensitive.
+	EXPECT_FALSE(index.FindItem(L"SHORT.TXT"));
+
+	// Items without a short name shouldn't be found by an empty name.
+	EXPECT_FALSE(index.FindItem(L""));
+}
+
+TEST(TestItemNameIndex, TestRemove)
+{
+	ItemNameIndex index;
+	index.AddItem(0, L"file.txt", L"");
+	index.AddItem(1, L"Long file name.txt", L"LONGFI~1.TXT");
+
+	index.RemoveItem(1);
+
+	EXPECT_FALSE(index.FindItem(L"Long file name.txt"));
+	EXPECT_FALSE(index.FindItem(L"LONGFI~1.TXT"));
+	EXPECT_TRUE(index.FindItem(L"file.txt"));
+	EXPECT_EQ(index.GetNumItems(), 1U);
+
+	// Removing an item that doesn't exist should have no effect.
+	index.RemoveItem(1);
+	EXPECT_EQ(index.GetNumItems(), 1U);
+}
+
+TEST(TestItemNameIndex, TestUpdate)
+{
+	ItemNameIndex index;
+	index.AddItem(0, L"old.txt", L"");
+
+	index.UpdateItem(0, L"new.txt", L"");
+
+	EXPECT_FALSE(index.FindItem(L"old.txt"));
+
+	auto item = index.FindItem(L"new.txt");
+	ASSERT_TRUE(item);
+	EXPECT_EQ(*item, 0);
+}
+
+TEST(TestItemNameIndex, TestSharedName)
+{
+	ItemNameIndex index;
+	index.AddItem(0, L"ABCDEF~1.TXT", L"");
+	index.AddItem(1, L"abcdefghijkl.txt", L"ABCDEF~1.TXT");
+
+	index.RemoveItem(0);
+
+	// The name is still in use by the second item.
+	auto item = index.FindItem(L"ABCDEF~1.TXT");
+	ASSERT_TRUE(item);
+	EXPECT_EQ(*item, 1);
+}
+
+// Replays a large, randomly generated sequence of additions, removals and
+// renames (similar to what would be seen when a large number of files are
+// modified at once) and checks the index against a simple reference
+// implementation.
+TEST(TestItemNameIndex, TestChangeLog)
+{
+	ItemNameIndex index;
+
+	// Maps each item to its name and each name (long or short) back to
+	// the item.
+	std::map<int, std::pair<std::wstring, std::wstring>> referenceItems;
+	std::map<std::wstring, int> referenceNames;
+
+	// Used to pick an existing item at random.
+	std::vector<int> liveItems;
+
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> actionDistribution(0, 9);
+	std::uniform_int_distribution<int> nameDistribution(0, 19999);
+
+	auto generateName = [&generator, &nameDistribution] {
+		return L"file" + std::to_wstring(nameDistribution(generator)) + L".txt";
+	};
+
+	auto findInReference = [&referenceNames] (const std::wstring &name) -> boost::optional<int> {
+		auto itr = referenceNames.find(name);
+
+		if (itr == referenceNames.end())
+		{
+			return boost::none;
+		}
+
+		return itr->second;
+	};
+
+	int internalIndexCounter = 0;
+
+	for (int i = 0; i < 100000; i++)
+	{
+		int action = actionDistribution(generator);
+
+		if (action < 5 || referenceItems.empty())
+		{
+			std::wstring name = generateName();
+
+			// As in a real folder, names are unique.
+			if (findInReference(name))
+			{
+				continue;
+			}
+
+			std::wstring shortName;
+
+			if (action == 0)
+			{
+				shortName = L"FILE~" + std::to_wstring(internalIndexCounter) + L".TXT";
+				referenceNames[shortName] = internalIndexCounter;
+			}
+
+			index.AddItem(internalIndexCounter, name, shortName);
+			referenceItems[internalIndexCounter] = { name, shortName };
+			referenceNames[name] = internalIndexCounter;
+			liveItems.push_back(internalIndexCounter);
+			internalIndexCounter++;
+		}
+		else
+		{
+			size_t liveIndex = std::uniform_int_distribution<size_t>(0, liveItems.size() - 1)(generator);
+			auto itr = referenceItems.find(liveItems[liveIndex]);
+
+			if (action < 8)
+			{
+				index.RemoveItem(itr->first);
+				referenceNames.erase(itr->second.first);
+				referenceNames.erase(itr->second.second);
+				referenceItems.erase(itr);
+
+				liveItems[liveIndex] = liveItems.back();
+				liveItems.pop_back();
+			}
+			else
+			{
+				std::wstring newName = generateName();
+
+				if (findInReference(newName))
+				{
+					continue;
+				}
+
+				index.UpdateItem(itr->first, newName, itr->second.second);
+				referenceNames.erase(itr->second.first);
+				referenceNames[newName] = itr->first;
+				itr->second.first = newName;
+			}
+		}
+
+		if (i % 1000 == 0)
+		{
+			ASSERT_EQ(index.GetNumItems(), referenceItems.size());
+
+			for (const auto &item : referenceItems)
+			{
+				auto result = index.FindItem(item.second.first);
+				ASSERT_TRUE(result);
+				EXPECT_EQ(*result, item.first);
+
+				if (!item.second.second.empty())
+				{
+					result = index.FindItem(item.second.second);
+					ASSERT_TRUE(result);
+					EXPECT_EQ(*result, item.first);
+				}
+			}
+		}
+
+		std::wstring name = generateName();
+		EXPECT_TRUE(index.FindItem(name) == findInReference(name));
+	}
+}
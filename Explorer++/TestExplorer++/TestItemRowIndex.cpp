@@ -0,0 +1,185 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/ItemRowIndex.h"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+	void CheckRows(const ItemRowIndex &index, const std::vector<int> &expectedRows)
+	{
+		ASSERT_EQ(index.GetNumRows(), expectedRows.size());
+
+		for (size_t i = 0; i < expectedRows.size(); i++)
+		{
+			EXPECT_EQ(index.GetInternalIndex(static_cast<int>(i)), expectedRows[i]);
+
+			auto row = index.FindRow(expectedRows[i]);
+			ASSERT_TRUE(row);
+			EXPECT_EQ(*row, static_cast<int>(i));
+		}
+	}
+}
+
+TEST(TestItemRowIndex, TestInsert)
+{
+	ItemRowIndex index;
+	index.InsertRow(0, 10);
+	index.InsertRow(1, 11);
+	index.InsertRow(0, 12);
+	index.InsertRow(2, 13);
+
+	CheckRows(index, { 12, 10, 13, 11 });
+
+	EXPECT_FALSE(index.FindRow(14));
+	EXPECT_FALSE(index.FindRow(-1));
+}
+
+TEST(TestItemRowIndex, TestRemove)
+{
+	ItemRowIndex index;
+
+	for (int i = 0; i < 6; i++)
+	{
+		index.InsertRow(i, i);
+	}
+
+	index.RemoveRow(1);
+	CheckRows(index, { 0, 2, 3, 4, 5 });
+	EXPECT_FALSE(index.FindRow(1));
+
+	// The rows are given by their positions before any of them are
+	// removed, in any order.
+	index.RemoveRows({ 4, 0, 2 });
+	CheckRows(index, { 2, 4 });
+	EXPECT_FALSE(index.FindRow(0));
+	EXPECT_FALSE(index.FindRow(3));
+	EXPECT_FALSE(index.FindRow(5));
+
+	index.RemoveRows({});
+	CheckRows(index, { 2, 4 });
+}
+
+TEST(TestItemRowIndex, TestSetRows)
+{
+	ItemRowIndex index;
+
+	for (int i = 0; i < 5; i++)
+	{
+		index.InsertRow(i, i);
+	}
+
+	std::vector<int> rows = index.GetRows();
+	std::reverse(rows.begin(), rows.end());
+	index.SetRows(rows);
+
+	CheckRows(index, { 4, 3, 2, 1, 0 });
+
+	// An item can be reinserted once it's been removed.
+	index.RemoveRow(4);
+	index.InsertRow(0, 0);
+	CheckRows(index, { 0, 4, 3, 2, 1 });
+}
+
+TEST(TestItemRowIndex, TestClear)
+{
+	ItemRowIndex index;
+	index.InsertRow(0, 0);
+	index.InsertRow(1, 1);
+
+	index.Clear();
+
+	EXPECT_EQ(index.GetNumRows(), 0U);
+	EXPECT_FALSE(index.FindRow(0));
+	EXPECT_FALSE(index.FindRow(1));
+
+	index.InsertRow(0, 1);
+	CheckRows(index, { 1 });
+}
+
+// Applies a long sequence of random changes, interleaved with lookups,
+// and checks the index against a plain vector after each one.
+TEST(TestItemRowIndex, TestRandomChanges)
+{
+	std::mt19937 generator(1234);
+
+	ItemRowIndex index;
+	std::vector<int> referenceRows;
+	int nextInternalIndex = 0;
+
+	for (int i = 0; i < 20000; i++)
+	{
+		int numRows = static_cast<int>(referenceRows.size());
+		int action = std::uniform_int_distribution<int>(0, 9)(generator);
+
+		if (action < 5 || numRows == 0)
+		{
+			int row = std::uniform_int_distribution<int>(0, numRows)(generator);
+			index.InsertRow(row, nextInternalIndex);
+			referenceRows.insert(referenceRows.begin() + row, nextInternalIndex);
+			nextInternalIndex++;
+		}
+		else if (action < 7)
+		{
+			int row = std::uniform_int_distribution<int>(0, numRows - 1)(generator);
+			index.RemoveRow(row);
+			referenceRows.erase(referenceRows.begin() + row);
+		}
+		else if (action < 8)
+		{
+			std::vector<int> rows(numRows);
+			std::iota(rows.begin(), rows.end(), 0);
+			std::shuffle(rows.begin(), rows.end(), generator);
+			rows.resize(std::uniform_int_distribution<int>(0, (std::min)(numRows, 10))(generator));
+
+			index.RemoveRows(rows);
+
+			std::sort(rows.begin(), rows.end(), std::greater<int>());
+
+			for (int row : rows)
+			{
+				referenceRows.erase(referenceRows.begin() + row);
+			}
+		}
+		else if (action < 9)
+		{
+			std::shuffle(referenceRows.begin(), referenceRows.end(), generator);
+			index.SetRows(referenceRows);
+		}
+
+		ASSERT_EQ(index.GetNumRows(), referenceRows.size());
+
+		if (referenceRows.empty())
+		{
+			continue;
+		}
+
+		int row = std::uniform_int_distribution<int>(0, static_cast<int>(referenceRows.size()) - 1)(generator);
+		auto foundRow = index.FindRow(referenceRows[row]);
+		ASSERT_TRUE(foundRow);
+		ASSERT_EQ(*foundRow, row);
+
+		// Items that have been removed shouldn't be found.
+		int internalIndex = std::uniform_int_distribution<int>(0, nextInternalIndex - 1)(generator);
+		auto itr = std::find(referenceRows.begin(), referenceRows.end(), internalIndex);
+		foundRow = index.FindRow(internalIndex);
+
+		if (itr == referenceRows.end())
+		{
+			ASSERT_FALSE(foundRow);
+		}
+		else
+		{
+			ASSERT_TRUE(foundRow);
+			ASSERT_EQ(*foundRow, itr - referenceRows.begin());
+		}
+	}
+
+	CheckRows(index, referenceRows);
+}
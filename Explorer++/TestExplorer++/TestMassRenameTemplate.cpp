@@ -0,0 +1,174 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/MassRenameTemplate.h"
+#include <boost/algorithm/string.hpp>
+#include <iomanip>
+#include <regex>
+#include <sstream>
+
+namespace
+{
+	// The way names were previously generated: the pattern is re-scanned
+	// for each file, with a regular expression used to find counters.
+	std::wstring ReferenceRender(const std::wstring &pattern, const std::wstring &fileName, int index)
+	{
+		const TCHAR *extension = PathFindExtension(fileName.c_str());
+		std::wstring baseName(fileName.c_str(), extension);
+
+		std::wstring output = pattern;
+		std::wregex rxPattern(L"/[0]*N");
+		std::wsmatch mr;
+
+		while (std::regex_search(output, mr, rxPattern))
+		{
+			std::wstringstream ss;
+			ss << std::setfill(L'0') << std::setw((mr.length() - 2) + 1) << index;
+			output.replace(mr.position(), mr.length(), ss.str());
+		}
+
+		std::size_t pos;
+
+		while ((pos = output.find(L"/F")) != std::wstring::npos)
+		{
+			output.replace(pos, 2, fileName);
+		}
+
+		while ((pos = output.find(L"/B")) != std::wstring::npos)
+		{
+			output.replace(pos, 2, baseName);
+		}
+
+		while ((pos = output.find(L"/E")) != std::wstring::npos)
+		{
+			output.replace(pos, 2, extension);
+		}
+
+		while ((pos = output.find(L"/L")) != std::wstring::npos)
+		{
+			output.replace(pos, 2, fileName);
+			boost::to_lower(output);
+		}
+
+		while ((pos = output.find(L"/U")) != std::wstring::npos)
+		{
+			output.replace(pos, 2, fileName);
+			boost::to_upper(output);
+		}
+
+		return output;
+	}
+
+	std::vector<std::wstring> BuildFileNames(int numFiles)
+	{
+		const wchar_t *extensions[] = { L".jpg", L".txt", L".Log", L"" };
+
+		std::vector<std::wstring> fileNames;
+		fileNames.reserve(numFiles);
+
+		for (int i = 0; i < numFiles; i++)
+		{
+			fileNames.push_back(L"File Name " + std::to_wstring(i) + extensions[i % std::size(extensions)]);
+		}
+
+		return fileNames;
+	}
+}
+
+TEST(MassRenameTemplate, Tokens)
+{
+	MassRenameTemplate nameTemplate(L"/B - /F (/N)/E");
+	EXPECT_EQ(nameTemplate.Render(L"photo.jpg", 3), L"photo - photo.jpg (3).jpg");
+}
+
+TEST(MassRenameTemplate, CounterWidth)
+{
+	MassRenameTemplate nameTemplate(L"/000N");
+	EXPECT_EQ(nameTemplate.Render(L"file", 7), L"0007");
+	EXPECT_EQ(nameTemplate.Render(L"file", 12345), L"12345");
+
+	MassRenameTemplate multipleCounters(L"/N_/0N");
+	EXPECT_EQ(multipleCounters.Render(L"file", 4), L"4_04");
+}
+
+TEST(MassRenameTemplate, CaseConversion)
+{
+	MassRenameTemplate lowerTemplate(L"Prefix_/L");
+	EXPECT_EQ(lowerTemplate.Render(L"File.TXT", 0), L"prefix_file.txt");
+
+	MassRenameTemplate upperTemplate(L"/B_/U");
+	EXPECT_EQ(upperTemplate.Render(L"file.txt", 0), L"FILE_FILE.TXT");
+
+	MassRenameTemplate bothTemplate(L"/U/L");
+	EXPECT_EQ(bothTemplate.Render(L"File", 0), L"filefile");
+}
+
+TEST(MassRenameTemplate, Literals)
+{
+	EXPECT_EQ(MassRenameTemplate(L"").Render(L"file", 0), L"");
+	EXPECT_EQ(MassRenameTemplate(L"plain").Render(L"file", 0), L"plain");
+	EXPECT_EQ(MassRenameTemplate(L"a/Xb/").Render(L"file", 0), L"a/Xb/");
+	EXPECT_EQ(MassRenameTemplate(L"/0F/0").Render(L"file", 0), L"/0F/0");
+	EXPECT_EQ(MassRenameTemplate(L"/n/f").Render(L"file", 0), L"/n/f");
+}
+
+TEST(MassRenameTemplate, NoExtension)
+{
+	MassRenameTemplate nameTemplate(L"/B|/E");
+	EXPECT_EQ(nameTemplate.Render(L"README", 0), L"README|");
+	EXPECT_EQ(nameTemplate.Render(L"archive.tar.gz", 0), L"archive.tar|.gz");
+}
+
+TEST(MassRenameTemplate, MatchesReference)
+{
+	const wchar_t *patterns[] = { L"/F", L"/B/E", L"/N", L"/00N - /B/E", L"x/L", L"/U_/N",
+		L"/E/B/F/N", L"no tokens", L"/Q/F" };
+	auto fileNames = BuildFileNames(20);
+
+	for (auto pattern : patterns)
+	{
+		MassRenameTemplate nameTemplate(pattern);
+
+		for (int i = 0; i < static_cast<int>(fileNames.size()); i++)
+		{
+			EXPECT_EQ(nameTemplate.Render(fileNames[i], i), ReferenceRender(pattern, fileNames[i], i))
+				<< pattern << L" " << fileNames[i];
+		}
+	}
+}
+
+TEST(MassRenameTemplate, Collisions)
+{
+	std::vector<std::wstring> directories = { L"C:\\a", L"C:\\a", L"C:\\b", L"C:\\A", L"C:\\a" };
+	std::vector<std::wstring> newNames = { L"file1", L"file2", L"file1", L"FILE1", L"file3" };
+
+	auto collisions = FindNameCollisions(directories, newNames);
+	EXPECT_EQ(collisions, std::vector<bool>({ true, false, false, true, false }));
+
+	EXPECT_TRUE(FindNameCollisions({}, {}).empty());
+}
+
+// Checks that the compiled template generates the same names as the
+// original approach for a large number of files.
+TEST(MassRenameTemplate, GeneratedNames)
+{
+	const int NUM_FILES = 100000;
+	const std::wstring PATTERN = L"/B (/0000N)/E";
+
+	auto fileNames = BuildFileNames(NUM_FILES);
+
+	MassRenameTemplate nameTemplate(PATTERN);
+	std::vector<std::wstring> newNames(fileNames.size());
+
+	for (int i = 0; i < NUM_FILES; i++)
+	{
+		nameTemplate.Render(fileNames[i], i, newNames[i]);
+		EXPECT_EQ(newNames[i], ReferenceRender(PATTERN, fileNames[i], i));
+	}
+
+	std::vector<std::wstring> directories(fileNames.size(), L"C:\\Folder");
+	auto collisions = FindNameCollisions(directories, newNames);
+	EXPECT_EQ(std::count(collisions.begin(), collisions.end(), true), 0);
+}
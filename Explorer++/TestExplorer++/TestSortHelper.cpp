@@ -0,0 +1,170 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/SortHelper.h"
+#include <propvarutil.h>
+
+namespace
+{
+	BasicItemInfo_t BuildItem(const std::wstring &name, ULONGLONG size, bool isFolder = false)
+	{
+		BasicItemInfo_t itemInfo = {};
+		itemInfo.wfd.dwFileAttributes = isFolder ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+		itemInfo.wfd.nFileSizeLow = static_cast<DWORD>(size);
+		itemInfo.wfd.nFileSizeHigh = static_cast<DWORD>(size >> 32);
+		StringCchCopy(itemInfo.szDisplayName, SIZEOF_ARRAY(itemInfo.szDisplayName), name.c_str());
+		itemInfo.isRoot = false;
+		return itemInfo;
+	}
+
+	SortKey_t BuildSizeKey(const BasicItemInfo_t &itemInfo, boost::optional<ULONGLONG> folderSize = boost::none)
+	{
+		GlobalFolderSettings globalFolderSettings = {};
+		return BuildSortKey(SortMode::Size, 0, itemInfo, globalFolderSettings, nullptr, folderSize);
+	}
+
+	SortKey_t BuildVariantKey(const TCHAR *displayName, wil::unique_variant variant)
+	{
+		SortKey_t key;
+		key.internalIndex = 0;
+		key.rank = (variant.vt == VT_EMPTY) ? 0 : 1;
+		key.isFolder = false;
+		key.value = std::move(variant);
+		key.displayName = displayName;
+		return key;
+	}
+
+	wil::unique_variant BuildInt32Variant(int value)
+	{
+		wil::unique_variant variant;
+		InitVariantFromInt32(value, &variant);
+		return variant;
+	}
+
+	wil::unique_variant BuildStringVariant(const WCHAR *value)
+	{
+		wil::unique_variant variant;
+		variant.vt = VT_BSTR;
+		variant.bstrVal = SysAllocString(value);
+		return variant;
+	}
+}
+
+TEST(SortHelper, CompareSizes)
+{
+	auto small = BuildItem(L"b", 10);
+	auto large = BuildItem(L"a", 20);
+
+	auto smallKey = BuildSizeKey(small);
+	auto largeKey = BuildSizeKey(large);
+
+	EXPECT_LT(CompareSortKeys(smallKey, largeKey, true, true), 0);
+	EXPECT_GT(CompareSortKeys(largeKey, smallKey, true, true), 0);
+
+	auto largerThan4GB = BuildItem(L"c", 5ULL * 1024 * 1024 * 1024);
+	EXPECT_LT(CompareSortKeys(largeKey, BuildSizeKey(largerThan4GB), true, true), 0);
+}
+
+TEST(SortHelper, FoldersFirst)
+{
+	auto folder = BuildItem(L"b", 0, true);
+	auto file = BuildItem(L"a", 0);
+
+	// The folder's total size is larger than the file, but the folder is
+	// still placed first.
+	auto folderKey = BuildSizeKey(folder, 100ULL);
+	auto fileKey = BuildSizeKey(file);
+
+	EXPECT_LT(CompareSortKeys(folderKey, fileKey, true, true), 0);
+	EXPECT_GT(CompareSortKeys(fileKey, folderKey, true, true), 0);
+
+	// In descending order, folders are placed last.
+	EXPECT_GT(CompareSortKeys(folderKey, fileKey, true, false), 0);
+
+	// Without folders first (as in the recycle bin), the folder's size is
+	// compared directly.
+	EXPECT_GT(CompareSortKeys(folderKey, fileKey, false, true), 0);
+}
+
+TEST(SortHelper, RankOrdering)
+{
+	auto item1 = BuildItem(L"a", 100);
+	auto item2 = BuildItem(L"b", 1);
+
+	auto key1 = BuildSizeKey(item1);
+	auto key2 = BuildSizeKey(item2);
+
+	// Items with a lower rank are placed first, regardless of their values.
+	key1.rank = 0;
+	key2.rank = 1;
+
+	EXPECT_LT(CompareSortKeys(key1, key2, true, true), 0);
+	EXPECT_GT(CompareSortKeys(key2, key1, true, true), 0);
+
+	key2.rank = 0;
+	EXPECT_GT(CompareSortKeys(key1, key2, true, true), 0);
+}
+
+TEST(SortHelper, Descending)
+{
+	auto small = BuildItem(L"a", 10);
+	auto large = BuildItem(L"b", 20);
+
+	auto smallKey = BuildSizeKey(small);
+	auto largeKey = BuildSizeKey(large);
+
+	EXPECT_GT(CompareSortKeys(smallKey, largeKey, true, false), 0);
+	EXPECT_LT(CompareSortKeys(largeKey, smallKey, true, false), 0);
+	EXPECT_EQ(CompareSortKeys(smallKey, smallKey, true, false), 0);
+}
+
+TEST(SortHelper, DisplayNameTiebreak)
+{
+	// Display names are compared logically, so "file2" comes before
+	// "file10".
+	auto item1 = BuildItem(L"file10", 10);
+	auto item2 = BuildItem(L"file2", 10);
+
+	auto key1 = BuildSizeKey(item1);
+	auto key2 = BuildSizeKey(item2);
+
+	EXPECT_GT(CompareSortKeys(key1, key2, true, true), 0);
+	EXPECT_LT(CompareSortKeys(key2, key1, true, true), 0);
+
+	// The tiebreak is reversed along with the rest of the comparison.
+	EXPECT_LT(CompareSortKeys(key1, key2, true, false), 0);
+}
+
+TEST(SortHelper, Variants)
+{
+	auto key1 = BuildVariantKey(L"b", BuildInt32Variant(1));
+	auto key2 = BuildVariantKey(L"a", BuildInt32Variant(2));
+
+	EXPECT_LT(CompareSortKeys(key1, key2, true, true), 0);
+	EXPECT_GT(CompareSortKeys(key2, key1, true, true), 0);
+
+	// Items without a value are placed first and are only ordered by
+	// their display names.
+	auto emptyKey1 = BuildVariantKey(L"d", wil::unique_variant());
+	auto emptyKey2 = BuildVariantKey(L"c", wil::unique_variant());
+
+	EXPECT_LT(CompareSortKeys(emptyKey1, key1, true, true), 0);
+	EXPECT_GT(CompareSortKeys(emptyKey1, emptyKey2, true, true), 0);
+}
+
+TEST(SortHelper, VariantTypeMismatch)
+{
+	auto intKey = BuildVariantKey(L"b", BuildInt32Variant(100));
+	auto stringKey = BuildVariantKey(L"a", BuildStringVariant(L"1"));
+
+	// Values of different types can't be compared directly, so they're
+	// ordered by type. The result has to be consistent in both directions.
+	int result = CompareSortKeys(intKey, stringKey, true, true);
+	EXPECT_NE(result, 0);
+	EXPECT_EQ(CompareSortKeys(stringKey, intKey, true, true), -result);
+
+	// VT_I4 is less than VT_BSTR.
+	EXPECT_LT(result, 0);
+}
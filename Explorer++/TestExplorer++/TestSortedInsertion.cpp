@@ -0,0 +1,154 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/SortedInsertion.h"
+#include <random>
+
+namespace
+{
+	int Compare(int value1, int value2)
+	{
+		return (value1 > value2) - (value1 < value2);
+	}
+
+	// Inserts the batch one item at a time, in the same way the listview
+	// does, and returns the resulting list.
+	std::vector<int> ApplyInsertions(std::vector<int> list, const std::vector<int> &batch,
+		const std::vector<SortedInsertion> &insertions)
+	{
+		for (const auto &insertion : insertions)
+		{
+			list.insert(list.begin() + insertion.position, batch[insertion.batchIndex]);
+		}
+
+		return list;
+	}
+}
+
+TEST(SortedInsertion, FindPosition)
+{
+	std::vector<int> list = { 1, 3, 3, 5 };
+
+	auto findPosition = [&list] (int value) {
+		return FindSortedInsertionPosition(static_cast<int>(list.size()), [&list, value] (int item) {
+			return Compare(value, list[item]);
+		});
+	};
+
+	EXPECT_EQ(findPosition(0), 0);
+	EXPECT_EQ(findPosition(1), 0);
+	EXPECT_EQ(findPosition(2), 1);
+	EXPECT_EQ(findPosition(3), 1);
+	EXPECT_EQ(findPosition(4), 3);
+	EXPECT_EQ(findPosition(6), 4);
+
+	EXPECT_EQ(FindSortedInsertionPosition(0, [] (int) { return 1; }), 0);
+}
+
+TEST(SortedInsertion, FindPositionComparisons)
+{
+	int numComparisons = 0;
+
+	FindSortedInsertionPosition(1000000, [&numComparisons] (int item) {
+		numComparisons++;
+		return Compare(123456, item);
+	});
+
+	EXPECT_LE(numComparisons, 21);
+}
+
+TEST(SortedInsertion, Merge)
+{
+	std::vector<int> list = { 2, 4, 6, 8 };
+	std::vector<int> batch = { 9, 1, 5, 4, 5 };
+
+	auto insertions = MergeSortedInsertions(list, batch, Compare);
+	ASSERT_EQ(insertions.size(), batch.size());
+
+	// Returned in order of position.
+	for (size_t i = 1; i < insertions.size(); i++)
+	{
+		EXPECT_LT(insertions[i - 1].position, insertions[i].position);
+	}
+
+	// Equal items in the batch keep their relative order.
+	EXPECT_EQ(insertions[2].batchIndex, 2U);
+	EXPECT_EQ(insertions[3].batchIndex, 4U);
+
+	// New items are placed before equal existing items.
+	EXPECT_EQ(insertions[1].batchIndex, 3U);
+	EXPECT_EQ(insertions[1].position, 2);
+
+	EXPECT_EQ(ApplyInsertions(list, batch, insertions),
+		std::vector<int>({ 1, 2, 4, 4, 5, 5, 6, 8, 9 }));
+}
+
+TEST(SortedInsertion, MergeEmpty)
+{
+	std::vector<int> empty;
+	std::vector<int> values = { 3, 1, 2 };
+
+	EXPECT_TRUE(MergeSortedInsertions(values, empty, Compare).empty());
+
+	auto insertions = MergeSortedInsertions(empty, values, Compare);
+	EXPECT_EQ(ApplyInsertions(empty, values, insertions), std::vector<int>({ 1, 2, 3 }));
+}
+
+TEST(SortedInsertion, MergeMatchesIndividualInsertion)
+{
+	std::mt19937 generator(0);
+	std::uniform_int_distribution<int> distribution(0, 1000);
+
+	std::vector<int> list(2000);
+	std::generate(list.begin(), list.end(), [&] { return distribution(generator); });
+	std::sort(list.begin(), list.end());
+
+	std::vector<int> batch(500);
+	std::generate(batch.begin(), batch.end(), [&] { return distribution(generator); });
+
+	std::vector<int> expected = list;
+
+	for (int value : batch)
+	{
+		int position = FindSortedInsertionPosition(static_cast<int>(expected.size()), [&expected, value] (int item) {
+			return Compare(value, expected[item]);
+		});
+
+		expected.insert(expected.begin() + position, value);
+	}
+
+	auto insertions = MergeSortedInsertions(list, batch, Compare);
+	EXPECT_EQ(ApplyInsertions(list, batch, insertions), expected);
+}
+
+// Inserting a large batch into a large list previously required a linear
+// scan of the list for each item.
+TEST(SortedInsertion, LargeBatch)
+{
+	const int NUM_ITEMS = 100000;
+
+	std::vector<int> list(NUM_ITEMS);
+	std::vector<int> batch(NUM_ITEMS);
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		list[i] = i * 2;
+		batch[i] = (NUM_ITEMS - i) * 2 - 1;
+	}
+
+	int numComparisons = 0;
+
+	auto insertions = MergeSortedInsertions(list, batch, [&numComparisons] (int value1, int value2) {
+		numComparisons++;
+		return Compare(value1, value2);
+	});
+
+	ASSERT_EQ(insertions.size(), batch.size());
+	EXPECT_EQ(insertions.front().position, 1);
+	EXPECT_EQ(insertions.back().position, (NUM_ITEMS * 2) - 1);
+
+	// O(n + k log k), rather than O(n * k).
+	EXPECT_LT(numComparisons, NUM_ITEMS * 40);
+}
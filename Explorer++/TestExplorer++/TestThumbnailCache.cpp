@@ -0,0 +1,187 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "pch.h"
+#include "../Explorer++/ShellBrowser/ThumbnailCache.h"
+
+namespace
+{
+	const std::size_t CACHE_SIZE = 4 * 1024 * 1024;
+	const int THUMBNAIL_SIZE = 120;
+
+	std::wstring GetPath(int index)
+	{
+		return L"C:\\Pictures\\image" + std::to_wstring(index) + L".jpg";
+	}
+
+	std::shared_ptr<const ThumbnailCache::Thumbnail> BuildThumbnail(std::uint32_t color,
+		int width = THUMBNAIL_SIZE, int height = THUMBNAIL_SIZE)
+	{
+		auto thumbnail = std::make_shared<ThumbnailCache::Thumbnail>();
+		thumbnail->width = width;
+		thumbnail->height = height;
+		thumbnail->pixels.assign(static_cast<std::size_t>(width) * height, color);
+		return thumbnail;
+	}
+}
+
+TEST(TestThumbnailCache, TestHitAndMiss)
+{
+	ThumbnailCache cache(CACHE_SIZE);
+
+	EXPECT_FALSE(cache.Get(GetPath(0), 100, 200));
+	EXPECT_EQ(cache.GetNumMisses(), 1U);
+
+	auto thumbnail = BuildThumbnail(0xFF0000FF);
+	cache.Set(GetPath(0), 100, 200, thumbnail);
+
+	// The same thumbnail should be shared, rather than copied.
+	EXPECT_EQ(cache.Get(GetPath(0), 100, 200), thumbnail);
+	EXPECT_EQ(cache.GetNumHits(), 1U);
+
+	cache.ResetCounters();
+	EXPECT_EQ(cache.GetNumHits(), 0U);
+	EXPECT_EQ(cache.GetNumMisses(), 0U);
+}
+
+TEST(TestThumbnailCache, TestStaleEntry)
+{
+	ThumbnailCache cache(CACHE_SIZE);
+
+	cache.Set(GetPath(0), 100, 200, BuildThumbnail(0));
+
+	EXPECT_FALSE(cache.Get(GetPath(0), 101, 200));
+	EXPECT_EQ(cache.GetNumEntries(), 0U);
+
+	cache.Set(GetPath(0), 100, 200, BuildThumbnail(0));
+	EXPECT_FALSE(cache.Get(GetPath(0), 100, 201));
+	EXPECT_EQ(cache.GetNumEntries(), 0U);
+	EXPECT_EQ(cache.GetSize(), 0U);
+}
+
+TEST(TestThumbnailCache, TestReplace)
+{
+	ThumbnailCache cache(CACHE_SIZE);
+
+	cache.Set(GetPath(0), 100, 200, BuildThumbnail(1));
+	std::size_t size = cache.GetSize();
+
+	auto thumbnail = BuildThumbnail(2);
+	cache.Set(GetPath(0), 100, 300, thumbnail);
+	EXPECT_EQ(cache.GetNumEntries(), 1U);
+	EXPECT_EQ(cache.GetSize(), size);
+	EXPECT_EQ(cache.Get(GetPath(0), 100, 300), thumbnail);
+}
+
+TEST(TestThumbnailCache, TestLruEviction)
+{
+	ThumbnailCache cache(CACHE_SIZE);
+
+	for (int i = 0; cache.GetSize() < CACHE_SIZE / 2; i++)
+	{
+		cache.Set(GetPath(i), 0, 1, BuildThumbnail(0));
+	}
+
+	std::size_t numEntries = cache.GetNumEntries();
+
+	EXPECT_TRUE(cache.Get(GetPath(0), 0, 1));
+
+	std::size_t lastEntry = (numEntries * 5) / 2;
+
+	for (std::size_t i = numEntries; i <= lastEntry; i++)
+	{
+		cache.Set(GetPath(static_cast<int>(i)), 0, 1, BuildThumbnail(0));
+	}
+
+	EXPECT_LE(cache.GetSize(), CACHE_SIZE);
+
+	EXPECT_TRUE(cache.Get(GetPath(0), 0, 1));
+	EXPECT_FALSE(cache.Get(GetPath(1), 0, 1));
+	EXPECT_TRUE(cache.Get(GetPath(static_cast<int>(lastEntry)), 0, 1));
+}
+
+TEST(TestThumbnailCache, TestSerialization)
+{
+	ThumbnailCache cache(CACHE_SIZE);
+
+	for (int i = 0; i < 20; i++)
+	{
+		cache.Set(GetPath(i), i, i + 1, BuildThumbnail(static_cast<std::uint32_t>(i), THUMBNAIL_SIZE, 60 + i));
+	}
+
+	auto data = cache.Serialize();
+
+	ThumbnailCache loadedCache(CACHE_SIZE);
+	ASSERT_TRUE(loadedCache.Deserialize(data.data(), data.size()));
+	EXPECT_EQ(loadedCache.GetNumEntries(), cache.GetNumEntries());
+	EXPECT_EQ(loadedCache.GetSize(), cache.GetSize());
+
+	for (int i = 0; i < 20; i++)
+	{
+		auto thumbnail = loadedCache.Get(GetPath(i), i, i + 1);
+		ASSERT_TRUE(thumbnail);
+		EXPECT_EQ(thumbnail->width, THUMBNAIL_SIZE);
+		EXPECT_EQ(thumbnail->height, 60 + i);
+		EXPECT_EQ(thumbnail->pixels, BuildThumbnail(static_cast<std::uint32_t>(i), THUMBNAIL_SIZE, 60 + i)->pixels);
+	}
+}
+
+TEST(TestThumbnailCache, TestDeserializeSmallerCache)
+{
+	ThumbnailCache cache(CACHE_SIZE);
+
+	for (int i = 0; i < 50; i++)
+	{
+		cache.Set(GetPath(i), 0, 1, BuildThumbnail(0));
+	}
+
+	auto data = cache.Serialize();
+
+	ThumbnailCache loadedCache(CACHE_SIZE / 8);
+	ASSERT_TRUE(loadedCache.Deserialize(data.data(), data.size()));
+	EXPECT_LE(loadedCache.GetSize(), CACHE_SIZE / 8);
+	EXPECT_GT(loadedCache.GetNumEntries(), 0U);
+	EXPECT_TRUE(loadedCache.Get(GetPath(49), 0, 1));
+	EXPECT_FALSE(loadedCache.Get(GetPath(0), 0, 1));
+}
+
+TEST(TestThumbnailCache, TestDeserializeInvalid)
+{
+	ThumbnailCache cache(CACHE_SIZE);
+	cache.Set(GetPath(0), 0, 1, BuildThumbnail(0));
+
+	auto data = cache.Serialize();
+
+	ThumbnailCache loadedCache(CACHE_SIZE);
+
+	EXPECT_FALSE(loadedCache.Deserialize(data.data(), data.size() - 1));
+	EXPECT_EQ(loadedCache.GetNumEntries(), 0U);
+
+	data[0] = 0;
+	EXPECT_FALSE(loadedCache.Deserialize(data.data(), data.size()));
+	EXPECT_EQ(loadedCache.GetNumEntries(), 0U);
+
+	EXPECT_FALSE(loadedCache.Deserialize(data.data(), 0));
+}
+
+TEST(TestThumbnailCache, TestSaveAndLoad)
+{
+	TCHAR tempPath[MAX_PATH];
+	ASSERT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+
+	std::wstring filePath = std::wstring(tempPath) + L"TestThumbnailCache.dat";
+
+	ThumbnailCache cache(CACHE_SIZE);
+	cache.Set(GetPath(0), 100, 200, BuildThumbnail(0xFF00FF00));
+	ASSERT_TRUE(cache.SaveToFile(filePath));
+
+	ThumbnailCache loadedCache(CACHE_SIZE);
+	ASSERT_TRUE(loadedCache.LoadFromFile(filePath));
+
+	auto thumbnail = loadedCache.Get(GetPath(0), 100, 200);
+	ASSERT_TRUE(thumbnail);
+	EXPECT_EQ(thumbnail->pixels, BuildThumbnail(0xFF00FF00)->pixels);
+
+	DeleteFile(filePath.c_str());
+}
@@ -79,15 +79,16 @@ TEST(BookmarkTest,BookmarkFolderChild)
 	CBookmarkFolder BookmarkFolderParent = CBookmarkFolder::Create(L"Test");
 	CBookmarkFolder BookmarkFolder = CBookmarkFolder::Create(L"Test name");
 
-	BookmarkFolderParent.InsertBookmarkFolder(BookmarkFolder);
+	std::wstring Name = BookmarkFolder.GetName();
+	BookmarkFolderParent.InsertBookmarkFolder(std::move(BookmarkFolder));
 
 	ASSERT_EQ(true,BookmarkFolderParent.HasChildFolder());
 
 	auto itr = BookmarkFolderParent.begin();
 
-	CBookmarkFolder ChildBookmarkFolder = boost::get<CBookmarkFolder>(*itr);
+	const CBookmarkFolder &ChildBookmarkFolder = boost::get<CBookmarkFolder>(*itr);
 
-	EXPECT_EQ(BookmarkFolder.GetName(),ChildBookmarkFolder.GetName());
+	EXPECT_EQ(Name,ChildBookmarkFolder.GetName());
 }
 
 class CTestBookmarkItemNotifier : public NBookmark::IBookmarkItemNotification
@@ -153,4 +154,216 @@ TEST(BookmarkTest,UpdateNotifications)
 	BookmarkFolderParent.InsertBookmark(Bookmark);
 
 	Bookmark.SetName(L"New test folder name");
-}
\ No newline at end of file
+
+	CBookmarkItemNotifier::GetInstance().RemoveObserver(ptbn);
+	delete ptbn;
+}
+
+TEST(BookmarkTest,ItemIndex)
+{
+	CBookmarkFolder Root = CBookmarkFolder::Create(L"Root");
+
+	/* The folders are built up before being inserted, so
+	that the items already within them have to be added to
+	the root's index. */
+	CBookmarkFolder Folder = CBookmarkFolder::Create(L"Folder");
+	CBookmarkFolder SubFolder = CBookmarkFolder::Create(L"Sub folder");
+	CBookmark Bookmark = CBookmark::Create(L"Test name",L"Test location",L"Test description");
+
+	GUID FolderGuid = Folder.GetGUID();
+	GUID SubFolderGuid = SubFolder.GetGUID();
+	GUID BookmarkGuid = Bookmark.GetGUID();
+
+	SubFolder.InsertBookmark(Bookmark);
+	Folder.InsertBookmarkFolder(std::move(SubFolder));
+	Root.InsertBookmarkFolder(std::move(Folder));
+
+	VariantBookmark *pFolderItem = Root.FindItem(FolderGuid);
+	ASSERT_NE(nullptr,pFolderItem);
+	CBookmarkFolder &StoredFolder = boost::get<CBookmarkFolder>(*pFolderItem);
+	EXPECT_EQ(&Root,StoredFolder.GetParent());
+	EXPECT_TRUE(StoredFolder.HasChildFolder());
+
+	VariantBookmark *pSubFolderItem = Root.FindItem(SubFolderGuid);
+	ASSERT_NE(nullptr,pSubFolderItem);
+	CBookmarkFolder &StoredSubFolder = boost::get<CBookmarkFolder>(*pSubFolderItem);
+	EXPECT_EQ(&StoredFolder,StoredSubFolder.GetParent());
+
+	VariantBookmark *pBookmarkItem = Root.FindItem(BookmarkGuid);
+	ASSERT_NE(nullptr,pBookmarkItem);
+	EXPECT_EQ(std::wstring(L"Test name"),boost::get<CBookmark>(*pBookmarkItem).GetName());
+	EXPECT_EQ(&StoredSubFolder,Root.FindParent(BookmarkGuid));
+
+	/* Lookups can be made from any folder in the tree. */
+	EXPECT_EQ(pBookmarkItem,StoredSubFolder.FindItem(BookmarkGuid));
+	EXPECT_EQ(pFolderItem,StoredSubFolder.FindItem(FolderGuid));
+
+	EXPECT_EQ(pBookmarkItem,StoredSubFolder.GetChild(BookmarkGuid));
+	EXPECT_EQ(nullptr,StoredFolder.GetChild(BookmarkGuid));
+	EXPECT_EQ(nullptr,Root.FindParent(Root.GetGUID()));
+}
+
+TEST(BookmarkTest,RemoveItem)
+{
+	CBookmarkFolder Root = CBookmarkFolder::Create(L"Root");
+	CBookmarkFolder Folder = CBookmarkFolder::Create(L"Folder");
+	CBookmark Bookmark = CBookmark::Create(L"Test name",L"Test location",L"Test description");
+
+	GUID FolderGuid = Folder.GetGUID();
+	GUID BookmarkGuid = Bookmark.GetGUID();
+
+	Folder.InsertBookmark(Bookmark);
+	Root.InsertBookmarkFolder(std::move(Folder));
+
+	/* Items can only be removed from their direct parent. */
+	EXPECT_FALSE(Root.RemoveBookmarkItem(BookmarkGuid));
+
+	EXPECT_TRUE(Root.RemoveBookmarkItem(FolderGuid));
+	EXPECT_FALSE(Root.HasChildren());
+	EXPECT_FALSE(Root.HasChildFolder());
+	EXPECT_EQ(nullptr,Root.FindItem(FolderGuid));
+	EXPECT_EQ(nullptr,Root.FindItem(BookmarkGuid));
+
+	EXPECT_FALSE(Root.RemoveBookmarkItem(FolderGuid));
+}
+
+TEST(BookmarkTest,MoveFolder)
+{
+	CBookmarkFolder Folder = CBookmarkFolder::Create(L"Folder");
+	CBookmarkFolder SubFolder = CBookmarkFolder::Create(L"Sub folder");
+	CBookmark Bookmark = CBookmark::Create(L"Test name",L"Test location",L"Test description");
+
+	GUID SubFolderGuid = SubFolder.GetGUID();
+	GUID BookmarkGuid = Bookmark.GetGUID();
+
+	Folder.InsertBookmark(Bookmark);
+	Folder.InsertBookmarkFolder(std::move(SubFolder));
+
+	CBookmarkFolder MovedFolder(std::move(Folder));
+
+	EXPECT_EQ(&MovedFolder,MovedFolder.FindParent(BookmarkGuid));
+	EXPECT_EQ(&MovedFolder,MovedFolder.FindParent(SubFolderGuid));
+
+	VariantBookmark *pSubFolderItem = MovedFolder.GetChild(SubFolderGuid);
+	ASSERT_NE(nullptr,pSubFolderItem);
+	EXPECT_EQ(&MovedFolder,boost::get<CBookmarkFolder>(*pSubFolderItem).GetParent());
+}
+
+namespace
+{
+	class CCountingBookmarkItemNotifier : public NBookmark::IBookmarkItemNotification
+	{
+	public:
+
+		void	OnBookmarkAdded(const CBookmarkFolder &ParentBookmarkFolder,const CBookmark &Bookmark,std::size_t Position)
+		{
+			UNREFERENCED_PARAMETER(ParentBookmarkFolder);
+			UNREFERENCED_PARAMETER(Bookmark);
+			UNREFERENCED_PARAMETER(Position);
+
+			m_nAdded++;
+		}
+
+		void	OnBookmarkFolderAdded(const CBookmarkFolder &ParentBookmarkFolder,const CBookmarkFolder &BookmarkFolder,std::size_t Position)
+		{
+			UNREFERENCED_PARAMETER(ParentBookmarkFolder);
+			UNREFERENCED_PARAMETER(BookmarkFolder);
+			UNREFERENCED_PARAMETER(Position);
+
+			m_nAdded++;
+		}
+
+		void	OnBookmarkModified(const GUID &guid)
+		{
+			UNREFERENCED_PARAMETER(guid);
+
+			m_nModified++;
+		}
+
+		void	OnBookmarkFolderModified(const GUID &guid)
+		{
+			UNREFERENCED_PARAMETER(guid);
+
+			m_nModified++;
+		}
+
+		void	OnBookmarkRemoved(const GUID &guid)
+		{
+			UNREFERENCED_PARAMETER(guid);
+
+			m_nRemoved++;
+		}
+
+		void	OnBookmarkFolderRemoved(const GUID &guid)
+		{
+			UNREFERENCED_PARAMETER(guid);
+
+			m_nRemoved++;
+		}
+
+		int		m_nAdded = 0;
+		int		m_nModified = 0;
+		int		m_nRemoved = 0;
+	};
+}
+
+/* Loads, searches and then modifies a tree containing
+50,000 bookmarks. */
+TEST(BookmarkTest,LargeTree)
+{
+	const int NUM_FOLDERS = 500;
+	const int NUM_BOOKMARKS_PER_FOLDER = 100;
+
+	CCountingBookmarkItemNotifier Notifier;
+	CBookmarkItemNotifier::GetInstance().AddObserver(&Notifier);
+
+	CBookmarkFolder Root = CBookmarkFolder::Create(L"Root");
+	std::vector<GUID> FolderGuids;
+	std::vector<GUID> BookmarkGuids;
+
+	for(int i = 0;i < NUM_FOLDERS;i++)
+	{
+		CBookmarkFolder Folder = CBookmarkFolder::Create(L"Folder " + std::to_wstring(i));
+		FolderGuids.push_back(Folder.GetGUID());
+
+		for(int j = 0;j < NUM_BOOKMARKS_PER_FOLDER;j++)
+		{
+			CBookmark Bookmark = CBookmark::Create(L"Bookmark " + std::to_wstring(j),
+				L"C:\\Folder " + std::to_wstring(i) + L"\\" + std::to_wstring(j),L"");
+			BookmarkGuids.push_back(Bookmark.GetGUID());
+			Folder.InsertBookmark(Bookmark);
+		}
+
+		Root.InsertBookmarkFolder(std::move(Folder));
+	}
+
+	for(std::size_t i = 0;i < BookmarkGuids.size();i++)
+	{
+		CBookmarkFolder *pParent = Root.FindParent(BookmarkGuids[i]);
+		ASSERT_NE(nullptr,pParent);
+		EXPECT_TRUE(IsEqualGUID(pParent->GetGUID(),FolderGuids[i / NUM_BOOKMARKS_PER_FOLDER]));
+		ASSERT_NE(nullptr,pParent->GetChild(BookmarkGuids[i]));
+	}
+
+	for(const auto &guid : BookmarkGuids)
+	{
+		VariantBookmark *pItem = Root.FindItem(guid);
+		boost::get<CBookmark>(*pItem).SetName(L"Renamed");
+	}
+
+	/* Removes every second folder, along with the
+	bookmarks inside it. */
+	for(std::size_t i = 0;i < FolderGuids.size();i += 2)
+	{
+		EXPECT_TRUE(Root.RemoveBookmarkItem(FolderGuids[i]));
+	}
+
+	CBookmarkItemNotifier::GetInstance().RemoveObserver(&Notifier);
+
+	EXPECT_EQ(NUM_FOLDERS * (NUM_BOOKMARKS_PER_FOLDER + 1),Notifier.m_nAdded);
+	EXPECT_EQ(NUM_FOLDERS * NUM_BOOKMARKS_PER_FOLDER,Notifier.m_nModified);
+	EXPECT_EQ(NUM_FOLDERS / 2,Notifier.m_nRemoved);
+
+	EXPECT_EQ(nullptr,Root.FindItem(BookmarkGuids[0]));
+	EXPECT_NE(nullptr,Root.FindItem(BookmarkGuids[NUM_BOOKMARKS_PER_FOLDER]));
+}
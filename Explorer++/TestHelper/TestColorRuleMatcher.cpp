@@ -0,0 +1,210 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ColorRuleMatcher.h"
+
+namespace
+{
+	const COLORREF RED = RGB(255, 0, 0);
+	const COLORREF GREEN = RGB(0, 255, 0);
+	const COLORREF BLUE = RGB(0, 0, 255);
+
+	struct TestRule
+	{
+		std::wstring pattern;
+		bool caseSensitive;
+		DWORD attributes;
+		COLORREF color;
+	};
+
+	struct TestItem
+	{
+		std::wstring fileName;
+		DWORD attributes;
+	};
+
+	// The checks that were previously made for each item, each time it
+	// was drawn.
+	boost::optional<COLORREF> ReferenceGetColor(const std::vector<TestRule> &rules,
+		const std::wstring &fileName, DWORD attributes)
+	{
+		for (const auto &rule : rules)
+		{
+			BOOL bMatchFileName = FALSE;
+			BOOL bMatchAttributes = FALSE;
+
+			if (rule.pattern.size() > 0)
+			{
+				if (CheckWildcardMatch(rule.pattern.c_str(), fileName.c_str(), rule.caseSensitive) == 1)
+				{
+					bMatchFileName = TRUE;
+				}
+			}
+			else
+			{
+				bMatchFileName = TRUE;
+			}
+
+			if (rule.attributes != 0)
+			{
+				if (rule.attributes & attributes)
+				{
+					bMatchAttributes = TRUE;
+				}
+			}
+			else
+			{
+				bMatchAttributes = TRUE;
+			}
+
+			if (bMatchFileName && bMatchAttributes)
+			{
+				return rule.color;
+			}
+		}
+
+		return boost::none;
+	}
+
+	ColorRuleMatcher BuildMatcher(const std::vector<TestRule> &rules)
+	{
+		ColorRuleMatcher matcher;
+
+		for (const auto &rule : rules)
+		{
+			matcher.AddRule(rule.pattern, rule.caseSensitive, rule.attributes, rule.color);
+		}
+
+		return matcher;
+	}
+
+	std::vector<TestRule> BuildRules(int numRules)
+	{
+		std::vector<TestRule> rules;
+
+		// Most rules are expected to be simple extension matches, which
+		// the majority of items won't match.
+		for (int i = 0; i < numRules - 2; i++)
+		{
+			rules.push_back({ L"*.ext" + std::to_wstring(i), false, 0, RGB(i, 0, 0) });
+		}
+
+		rules.push_back({ L"", false, FILE_ATTRIBUTE_COMPRESSED, BLUE });
+		rules.push_back({ L"", false, FILE_ATTRIBUTE_ENCRYPTED, GREEN });
+
+		return rules;
+	}
+
+	std::vector<TestItem> BuildItems(int numItems)
+	{
+		std::vector<TestItem> items;
+
+		for (int i = 0; i < numItems; i++)
+		{
+			DWORD attributes = (i % 10 == 0) ? FILE_ATTRIBUTE_ENCRYPTED : FILE_ATTRIBUTE_NORMAL;
+			items.push_back({ L"File number " + std::to_wstring(i) + L".ext" + std::to_wstring(i % 100),
+				attributes });
+		}
+
+		return items;
+	}
+}
+
+TEST(ColorRuleMatcher, NoRules)
+{
+	ColorRuleMatcher matcher;
+	EXPECT_FALSE(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_NORMAL).is_initialized());
+}
+
+TEST(ColorRuleMatcher, FirstMatchingRule)
+{
+	ColorRuleMatcher matcher;
+	matcher.AddRule(L"*.txt", false, 0, RED);
+	matcher.AddRule(L"file.*", false, 0, GREEN);
+
+	EXPECT_EQ(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_NORMAL).value_or(0), RED);
+	EXPECT_EQ(matcher.GetColor(L"file.doc", FILE_ATTRIBUTE_NORMAL).value_or(0), GREEN);
+	EXPECT_FALSE(matcher.GetColor(L"other.doc", FILE_ATTRIBUTE_NORMAL).is_initialized());
+}
+
+TEST(ColorRuleMatcher, Attributes)
+{
+	ColorRuleMatcher matcher;
+	matcher.AddRule(L"*.txt", false, FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM, RED);
+	matcher.AddRule(L"", false, FILE_ATTRIBUTE_COMPRESSED, BLUE);
+
+	// Only one of the attributes needs to be present.
+	EXPECT_EQ(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_HIDDEN).value_or(0), RED);
+	EXPECT_EQ(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_SYSTEM).value_or(0), RED);
+
+	EXPECT_FALSE(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_NORMAL).is_initialized());
+	EXPECT_EQ(matcher.GetColor(L"file.doc", FILE_ATTRIBUTE_COMPRESSED).value_or(0), BLUE);
+}
+
+TEST(ColorRuleMatcher, CaseSensitivity)
+{
+	ColorRuleMatcher matcher;
+	matcher.AddRule(L"*.TXT", true, 0, RED);
+	matcher.AddRule(L"*.DOC", false, 0, GREEN);
+
+	EXPECT_EQ(matcher.GetColor(L"file.TXT", FILE_ATTRIBUTE_NORMAL).value_or(0), RED);
+	EXPECT_FALSE(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_NORMAL).is_initialized());
+	EXPECT_EQ(matcher.GetColor(L"file.doc", FILE_ATTRIBUTE_NORMAL).value_or(0), GREEN);
+}
+
+TEST(ColorRuleMatcher, Clear)
+{
+	ColorRuleMatcher matcher;
+	matcher.AddRule(L"", false, 0, RED);
+	EXPECT_TRUE(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_NORMAL).is_initialized());
+
+	matcher.Clear();
+	EXPECT_FALSE(matcher.GetColor(L"file.txt", FILE_ATTRIBUTE_NORMAL).is_initialized());
+}
+
+TEST(ColorRuleMatcher, MatchesReference)
+{
+	std::vector<TestRule> rules = {
+		{ L"*.txt:*.log", false, 0, RED },
+		{ L"Read?e*", true, FILE_ATTRIBUTE_READONLY, GREEN },
+		{ L"", false, FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM, BLUE }
+	};
+
+	std::vector<TestItem> items = {
+		{ L"notes.TXT", FILE_ATTRIBUTE_NORMAL },
+		{ L"server.log", FILE_ATTRIBUTE_HIDDEN },
+		{ L"Readme.md", FILE_ATTRIBUTE_READONLY },
+		{ L"readme.md", FILE_ATTRIBUTE_READONLY },
+		{ L"Readme.md", FILE_ATTRIBUTE_NORMAL },
+		{ L"desktop.ini", FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM },
+		{ L"image.png", FILE_ATTRIBUTE_NORMAL }
+	};
+
+	ColorRuleMatcher matcher = BuildMatcher(rules);
+
+	for (const auto &item : items)
+	{
+		EXPECT_TRUE(matcher.GetColor(item.fileName, item.attributes)
+			== ReferenceGetColor(rules, item.fileName, item.attributes)) << item.fileName;
+	}
+}
+
+// Checks a large, generated set of rules against a large folder.
+TEST(ColorRuleMatcher, GeneratedRules)
+{
+	const int NUM_RULES = 50;
+	const int NUM_ITEMS = 100000;
+
+	std::vector<TestRule> rules = BuildRules(NUM_RULES);
+	std::vector<TestItem> items = BuildItems(NUM_ITEMS);
+
+	ColorRuleMatcher matcher = BuildMatcher(rules);
+
+	for (const auto &item : items)
+	{
+		EXPECT_TRUE(matcher.GetColor(item.fileName, item.attributes)
+			== ReferenceGetColor(rules, item.fileName, item.attributes)) << item.fileName;
+	}
+}
@@ -0,0 +1,290 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/iDirectoryMonitor.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	struct Event
+	{
+		DWORD action;
+		std::wstring fileName;
+	};
+
+	class EventRecorder
+	{
+	public:
+
+		void AddEvent(DWORD action, const std::wstring &fileName)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			// Used to hold up the worker thread, so that changes build up
+			// while no read is outstanding.
+			m_condition.wait(lock, [this] { return !m_blocked; });
+
+			m_events.push_back({ action, fileName });
+			m_condition.notify_all();
+		}
+
+		void SetBlocked(bool blocked)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_blocked = blocked;
+			}
+
+			m_condition.notify_all();
+		}
+
+		bool WaitForEvent(DWORD action, const std::wstring &fileName)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			return m_condition.wait_for(lock, 10s, [this, action, &fileName] {
+				return std::any_of(m_events.begin(), m_events.end(), [action, &fileName] (const Event &event) {
+					return event.action == action && event.fileName == fileName;
+				});
+			});
+		}
+
+		std::vector<Event> GetEvents()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_events;
+		}
+
+	private:
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::vector<Event> m_events;
+		bool m_blocked = false;
+	};
+
+	// The monitor frees this (using free()) once the watch is stopped.
+	struct CallbackData
+	{
+		EventRecorder *recorder;
+	};
+
+	void OnDirectoryAltered(const TCHAR *szFileName, DWORD dwAction, void *pData)
+	{
+		auto *callbackData = reinterpret_cast<CallbackData *>(pData);
+		callbackData->recorder->AddEvent(dwAction, szFileName);
+	}
+
+	void CreateTestFile(const std::wstring &path)
+	{
+		HANDLE hFile = CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		ASSERT_NE(hFile, INVALID_HANDLE_VALUE);
+		CloseHandle(hFile);
+	}
+}
+
+class DirectoryMonitorTest : public ::testing::Test
+{
+protected:
+
+	void SetUp() override
+	{
+		TCHAR tempPath[MAX_PATH];
+		ASSERT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+
+		m_directory = std::wstring(tempPath) + L"TestDirectoryMonitor";
+		RemoveTestDirectory();
+		ASSERT_TRUE(CreateDirectory(m_directory.c_str(), nullptr));
+
+		HRESULT hr = CreateDirectoryMonitor(&m_directoryMonitor);
+		ASSERT_TRUE(SUCCEEDED(hr));
+	}
+
+	void TearDown() override
+	{
+		m_recorder.SetBlocked(false);
+
+		if (m_directoryMonitor)
+		{
+			m_directoryMonitor->Release();
+		}
+
+		RemoveTestDirectory();
+	}
+
+	int Watch()
+	{
+		auto *callbackData = reinterpret_cast<CallbackData *>(malloc(sizeof(CallbackData)));
+		callbackData->recorder = &m_recorder;
+
+		return m_directoryMonitor->WatchDirectory(m_directory.c_str(),
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME, OnDirectoryAltered,
+			FALSE, callbackData);
+	}
+
+	// The statistics for a watch are only updated once all the events
+	// from a read have been delivered.
+	DirectoryWatchStatistics WaitForStatistics(int watchId, ULONGLONG numEvents)
+	{
+		DirectoryWatchStatistics statistics = {};
+		auto end = std::chrono::steady_clock::now() + 10s;
+
+		while (m_directoryMonitor->GetWatchStatistics(watchId, &statistics)
+			&& statistics.numEvents < numEvents
+			&& std::chrono::steady_clock::now() < end)
+		{
+			Sleep(10);
+		}
+
+		return statistics;
+	}
+
+	std::wstring GetPath(const std::wstring &fileName) const
+	{
+		return m_directory + L"\\" + fileName;
+	}
+
+	void RemoveTestDirectory()
+	{
+		WIN32_FIND_DATA wfd;
+		HANDLE hFindFile = FindFirstFile(GetPath(L"*").c_str(), &wfd);
+
+		if (hFindFile != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				if ((wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+				{
+					DeleteFile(GetPath(wfd.cFileName).c_str());
+				}
+			} while (FindNextFile(hFindFile, &wfd));
+
+			FindClose(hFindFile);
+		}
+
+		RemoveDirectory(m_directory.c_str());
+	}
+
+	std::wstring m_directory;
+	IDirectoryMonitor *m_directoryMonitor = nullptr;
+	EventRecorder m_recorder;
+};
+
+TEST_F(DirectoryMonitorTest, Changes)
+{
+	int watchId = Watch();
+	ASSERT_NE(watchId, -1);
+
+	CreateTestFile(GetPath(L"file.txt"));
+	ASSERT_TRUE(MoveFile(GetPath(L"file.txt").c_str(), GetPath(L"renamed.txt").c_str()));
+	ASSERT_TRUE(DeleteFile(GetPath(L"renamed.txt").c_str()));
+
+	ASSERT_TRUE(m_recorder.WaitForEvent(FILE_ACTION_REMOVED, L"renamed.txt"));
+
+	std::vector<Event> expectedEvents = {
+		{ FILE_ACTION_ADDED, L"file.txt" },
+		{ FILE_ACTION_RENAMED_OLD_NAME, L"file.txt" },
+		{ FILE_ACTION_RENAMED_NEW_NAME, L"renamed.txt" },
+		{ FILE_ACTION_REMOVED, L"renamed.txt" }
+	};
+
+	auto events = m_recorder.GetEvents();
+	ASSERT_EQ(events.size(), expectedEvents.size());
+
+	for (std::size_t i = 0; i < events.size(); i++)
+	{
+		EXPECT_EQ(events[i].action, expectedEvents[i].action);
+		EXPECT_EQ(events[i].fileName, expectedEvents[i].fileName);
+	}
+
+	auto statistics = WaitForStatistics(watchId, expectedEvents.size());
+	EXPECT_EQ(statistics.numEvents, expectedEvents.size());
+	EXPECT_EQ(statistics.numOverflows, 0U);
+	EXPECT_GE(statistics.maxQueueDepth, 1U);
+	EXPECT_GT(statistics.bufferSize, 0U);
+
+	EXPECT_TRUE(m_directoryMonitor->StopDirectoryMonitor(watchId));
+}
+
+TEST_F(DirectoryMonitorTest, Overflow)
+{
+	int watchId = Watch();
+	ASSERT_NE(watchId, -1);
+
+	// The callback for this first change will block, which means that
+	// the rest of the changes have to be buffered by the system.
+	m_recorder.SetBlocked(true);
+	CreateTestFile(GetPath(L"first.txt"));
+
+	// Each of these changes takes up several hundred bytes, so together
+	// they'll be far larger than the buffer used for a single folder.
+	std::wstring longName(200, 'a');
+
+	for (int i = 0; i < 1000; i++)
+	{
+		CreateTestFile(GetPath(longName + std::to_wstring(i)));
+	}
+
+	m_recorder.SetBlocked(false);
+
+	ASSERT_TRUE(m_recorder.WaitForEvent(DIRECTORY_MONITOR_ACTION_OVERFLOW, L""));
+
+	DirectoryWatchStatistics statistics;
+	ASSERT_TRUE(m_directoryMonitor->GetWatchStatistics(watchId, &statistics));
+	EXPECT_GE(statistics.numOverflows, 1U);
+
+	// The watch should continue to work once the overflow has been
+	// reported.
+	CreateTestFile(GetPath(L"last.txt"));
+	EXPECT_TRUE(m_recorder.WaitForEvent(FILE_ACTION_ADDED, L"last.txt"));
+}
+
+TEST_F(DirectoryMonitorTest, InvalidWatch)
+{
+	auto *callbackData = reinterpret_cast<CallbackData *>(malloc(sizeof(CallbackData)));
+	callbackData->recorder = &m_recorder;
+
+	int watchId = m_directoryMonitor->WatchDirectory(GetPath(L"missing").c_str(),
+		FILE_NOTIFY_CHANGE_FILE_NAME, OnDirectoryAltered, FALSE, callbackData);
+	EXPECT_EQ(watchId, -1);
+
+	DirectoryWatchStatistics statistics;
+	EXPECT_FALSE(m_directoryMonitor->GetWatchStatistics(watchId, &statistics));
+	EXPECT_FALSE(m_directoryMonitor->StopDirectoryMonitor(watchId));
+	EXPECT_FALSE(m_directoryMonitor->StopDirectoryMonitor(1000));
+}
+
+// Watches should be able to be stopped while their callback is running.
+TEST_F(DirectoryMonitorTest, StopWhileDispatching)
+{
+	int watchId = Watch();
+	ASSERT_NE(watchId, -1);
+
+	m_recorder.SetBlocked(true);
+	CreateTestFile(GetPath(L"file.txt"));
+
+	// Gives the worker thread a chance to pick up the change.
+	Sleep(200);
+
+	EXPECT_TRUE(m_directoryMonitor->StopDirectoryMonitor(watchId));
+
+	m_recorder.SetBlocked(false);
+
+	// Releasing the monitor waits for the watch to be removed.
+	m_directoryMonitor->Release();
+	m_directoryMonitor = nullptr;
+
+	auto events = m_recorder.GetEvents();
+	ASSERT_EQ(events.size(), 1U);
+	EXPECT_EQ(events[0].action, static_cast<DWORD>(FILE_ACTION_ADDED));
+	EXPECT_EQ(events[0].fileName, L"file.txt");
+}
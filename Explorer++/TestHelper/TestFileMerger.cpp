@@ -0,0 +1,626 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/FileMerger.h"
+#include <boost/crc.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+
+namespace
+{
+	using FileData = std::vector<std::uint8_t>;
+
+	class MemoryInput : public FileMergeInput
+	{
+	public:
+
+		MemoryInput(const FileData &data) :
+			m_data(data),
+			m_position(0)
+		{
+		}
+
+		std::uint64_t GetSize() const override
+		{
+			return m_data.size();
+		}
+
+		bool Read(void *buffer, std::size_t size, std::size_t &bytesRead) override
+		{
+			bytesRead = (std::min)(size, m_data.size() - m_position);
+			memcpy(buffer, m_data.data() + m_position, bytesRead);
+			m_position += bytesRead;
+			return true;
+		}
+
+	private:
+
+		const FileData m_data;
+		std::size_t m_position;
+	};
+
+	class MemoryOutput : public FileMergeOutput
+	{
+	public:
+
+		MemoryOutput(FileData &data) :
+			m_data(data)
+		{
+		}
+
+		bool Write(const void *buffer, std::size_t size) override
+		{
+			auto bytes = static_cast<const std::uint8_t *>(buffer);
+			m_data.insert(m_data.end(), bytes, bytes + size);
+			return true;
+		}
+
+	private:
+
+		FileData &m_data;
+	};
+
+	// A set of files that are stored in memory.
+	class MemoryFileSystem
+	{
+	public:
+
+		void AddFile(const std::wstring &path, const FileData &data)
+		{
+			m_files[path] = data;
+		}
+
+		const FileData *GetFile(const std::wstring &path) const
+		{
+			auto itr = m_files.find(path);
+
+			if (itr == m_files.end())
+			{
+				return nullptr;
+			}
+
+			return &itr->second;
+		}
+
+		FileMerger::OpenInput GetOpenInput()
+		{
+			return [this] (const std::wstring &path) -> std::unique_ptr<FileMergeInput> {
+				auto itr = m_files.find(path);
+
+				if (itr == m_files.end())
+				{
+					return nullptr;
+				}
+
+				return std::make_unique<MemoryInput>(itr->second);
+			};
+		}
+
+		FileMerger::CreateOutput GetCreateOutput()
+		{
+			return [this] (const std::wstring &path) -> std::unique_ptr<FileMergeOutput> {
+				auto [itr, inserted] = m_files.insert({ path, FileData() });
+
+				if (!inserted)
+				{
+					return nullptr;
+				}
+
+				return std::make_unique<MemoryOutput>(itr->second);
+			};
+		}
+
+	private:
+
+		std::map<std::wstring, FileData> m_files;
+	};
+
+	FileData GenerateData(std::size_t size, int seed)
+	{
+		FileData data(size);
+
+		for (std::size_t i = 0; i < size; i++)
+		{
+			data[i] = static_cast<std::uint8_t>((i * 7 + seed) % 251);
+		}
+
+		return data;
+	}
+
+	const std::size_t SMALL_BUFFER_SIZE = 4096;
+
+	FileMerger::Options GetSmallBufferOptions()
+	{
+		FileMerger::Options options;
+		options.bufferSize = SMALL_BUFFER_SIZE;
+		options.numBuffers = 2;
+		return options;
+	}
+
+	// Sets up a set of input files that have sizes around the buffer
+	// size, along with the data they should be merged into.
+	std::vector<std::wstring> SetUpInputFiles(MemoryFileSystem &fileSystem, FileData &expectedOutput)
+	{
+		const std::size_t sizes[] = { 0, 1, SMALL_BUFFER_SIZE - 1, SMALL_BUFFER_SIZE,
+			SMALL_BUFFER_SIZE + 1, (SMALL_BUFFER_SIZE * 3) + 7, 0 };
+		std::vector<std::wstring> inputFiles;
+		int seed = 0;
+
+		for (std::size_t size : sizes)
+		{
+			std::wstring path = L"C:\\Input\\file." + std::to_wstring(seed);
+			FileData data = GenerateData(size, seed);
+
+			fileSystem.AddFile(path, data);
+			inputFiles.push_back(path);
+			expectedOutput.insert(expectedOutput.end(), data.begin(), data.end());
+
+			seed++;
+		}
+
+		return inputFiles;
+	}
+
+	const wchar_t OUTPUT_FILE[] = L"C:\\Output\\file";
+}
+
+TEST(FileMerger, Merge)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, GetSmallBufferOptions(),
+		fileSystem.GetOpenInput(), fileSystem.GetCreateOutput());
+
+	FileMerger::Progress lastProgress = {};
+	auto result = merger.Merge([&lastProgress] (const FileMerger::Progress &progress) {
+		EXPECT_GE(progress.bytesWritten, lastProgress.bytesWritten);
+		lastProgress = progress;
+	});
+	ASSERT_EQ(result, FileMerger::Result::Succeeded);
+
+	const FileData *output = fileSystem.GetFile(OUTPUT_FILE);
+	ASSERT_NE(output, nullptr);
+	EXPECT_EQ(*output, expectedOutput);
+
+	EXPECT_EQ(lastProgress.bytesWritten, expectedOutput.size());
+	EXPECT_EQ(lastProgress.totalBytes, expectedOutput.size());
+	EXPECT_EQ(lastProgress.filesMerged, inputFiles.size());
+}
+
+TEST(FileMerger, Verify)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+
+	FileMerger::Options options = GetSmallBufferOptions();
+	options.verify = true;
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, options,
+		fileSystem.GetOpenInput(), fileSystem.GetCreateOutput());
+	ASSERT_EQ(merger.Merge(nullptr), FileMerger::Result::Succeeded);
+
+	boost::crc_32_type checksum;
+	checksum.process_bytes(expectedOutput.data(), expectedOutput.size());
+	EXPECT_EQ(merger.GetChecksum(), checksum.checksum());
+}
+
+TEST(FileMerger, VerificationFailed)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+
+	FileMerger::Options options = GetSmallBufferOptions();
+	options.verify = true;
+
+	// The output is corrupted when it's read back.
+	auto openInput = [&fileSystem] (const std::wstring &path) -> std::unique_ptr<FileMergeInput> {
+		const FileData *data = fileSystem.GetFile(path);
+
+		if (!data)
+		{
+			return nullptr;
+		}
+
+		FileData copy = *data;
+
+		if (path == OUTPUT_FILE)
+		{
+			copy[copy.size() / 2] ^= 1;
+		}
+
+		return std::make_unique<MemoryInput>(copy);
+	};
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, options, openInput, fileSystem.GetCreateOutput());
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::VerificationFailed);
+}
+
+TEST(FileMerger, InputFileInvalid)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+	inputFiles.push_back(L"C:\\Input\\missing");
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, GetSmallBufferOptions(),
+		fileSystem.GetOpenInput(), fileSystem.GetCreateOutput());
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::InputFileInvalid);
+
+	// The output file shouldn't have been created.
+	EXPECT_EQ(fileSystem.GetFile(OUTPUT_FILE), nullptr);
+}
+
+TEST(FileMerger, OutputFileInvalid)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+
+	// The output file already exists.
+	fileSystem.AddFile(OUTPUT_FILE, FileData());
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, GetSmallBufferOptions(),
+		fileSystem.GetOpenInput(), fileSystem.GetCreateOutput());
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::OutputFileInvalid);
+}
+
+TEST(FileMerger, OutOfMemory)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+
+	// A buffer this large can't be allocated.
+	FileMerger::Options options = GetSmallBufferOptions();
+	options.bufferSize = (std::numeric_limits<std::size_t>::max)() / 2;
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, options, fileSystem.GetOpenInput(), fileSystem.GetCreateOutput());
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::OutOfMemory);
+
+	// The output file shouldn't have been created.
+	EXPECT_EQ(fileSystem.GetFile(OUTPUT_FILE), nullptr);
+}
+
+namespace
+{
+	// Calls the specified function for each write once a certain number of
+	// bytes have been written.
+	class LimitedOutput : public FileMergeOutput
+	{
+	public:
+
+		LimitedOutput(std::size_t limit, std::function<bool()> onLimitReached) :
+			m_limit(limit),
+			m_onLimitReached(onLimitReached),
+			m_bytesWritten(0)
+		{
+		}
+
+		bool Write(const void *buffer, std::size_t size) override
+		{
+			UNREFERENCED_PARAMETER(buffer);
+
+			m_bytesWritten += size;
+
+			if (m_bytesWritten > m_limit)
+			{
+				return m_onLimitReached();
+			}
+
+			return true;
+		}
+
+	private:
+
+		const std::size_t m_limit;
+		const std::function<bool()> m_onLimitReached;
+		std::size_t m_bytesWritten;
+	};
+}
+
+TEST(FileMerger, WriteFailed)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+
+	auto createOutput = [] (const std::wstring &path) -> std::unique_ptr<FileMergeOutput> {
+		UNREFERENCED_PARAMETER(path);
+
+		return std::make_unique<LimitedOutput>(SMALL_BUFFER_SIZE, [] { return false; });
+	};
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, GetSmallBufferOptions(), fileSystem.GetOpenInput(), createOutput);
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::WriteFailed);
+}
+
+TEST(FileMerger, Stop)
+{
+	MemoryFileSystem fileSystem;
+	FileData expectedOutput;
+	auto inputFiles = SetUpInputFiles(fileSystem, expectedOutput);
+
+	FileMerger *mergerPointer = nullptr;
+
+	auto createOutput = [&mergerPointer] (const std::wstring &path) -> std::unique_ptr<FileMergeOutput> {
+		UNREFERENCED_PARAMETER(path);
+
+		return std::make_unique<LimitedOutput>(SMALL_BUFFER_SIZE, [&mergerPointer] {
+			mergerPointer->Stop();
+			return true;
+		});
+	};
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, GetSmallBufferOptions(), fileSystem.GetOpenInput(), createOutput);
+	mergerPointer = &merger;
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::Stopped);
+}
+
+TEST(FileMerger, Files)
+{
+	TCHAR tempPath[MAX_PATH];
+	ASSERT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+
+	std::vector<std::wstring> inputFiles;
+	FileData expectedOutput;
+
+	for (int i = 0; i < 3; i++)
+	{
+		std::wstring path = std::wstring(tempPath) + L"TestFileMerger.part" + std::to_wstring(i);
+		FileData data = GenerateData((SMALL_BUFFER_SIZE * (i + 1)) + i, i);
+
+		HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		ASSERT_NE(file, INVALID_HANDLE_VALUE);
+
+		DWORD bytesWritten;
+		BOOL res = WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr);
+		CloseHandle(file);
+		ASSERT_TRUE(res);
+
+		inputFiles.push_back(path);
+		expectedOutput.insert(expectedOutput.end(), data.begin(), data.end());
+	}
+
+	std::wstring outputFile = std::wstring(tempPath) + L"TestFileMerger.out";
+	DeleteFile(outputFile.c_str());
+
+	FileMerger::Options options = GetSmallBufferOptions();
+	options.verify = true;
+
+	FileMerger merger(outputFile, inputFiles, options);
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::Succeeded);
+
+	auto output = OpenFileMergeInput(outputFile);
+	ASSERT_TRUE(output);
+	ASSERT_EQ(output->GetSize(), expectedOutput.size());
+
+	FileData outputData(expectedOutput.size());
+	std::size_t bytesRead;
+	ASSERT_TRUE(output->Read(outputData.data(), outputData.size(), bytesRead));
+	EXPECT_EQ(bytesRead, outputData.size());
+	EXPECT_EQ(outputData, expectedOutput);
+	output.reset();
+
+	// The output file already exists.
+	FileMerger secondMerger(outputFile, inputFiles, options);
+	EXPECT_EQ(secondMerger.Merge(nullptr), FileMerger::Result::OutputFileInvalid);
+
+	DeleteFile(outputFile.c_str());
+
+	for (const auto &inputFile : inputFiles)
+	{
+		DeleteFile(inputFile.c_str());
+	}
+}
+
+namespace
+{
+	const std::size_t BLOCK_SIZE = 4096;
+
+	// Each block of a synthetic file consists of a single repeated byte,
+	// which depends on the position of the block and the file.
+	std::uint8_t GetSyntheticByte(int fileIndex, std::uint64_t offset)
+	{
+		return static_cast<std::uint8_t>(((offset / BLOCK_SIZE) + (fileIndex * 37)) % 251);
+	}
+
+	// A large file that's generated as it's read, so that it doesn't need
+	// to be stored.
+	class SyntheticInput : public FileMergeInput
+	{
+	public:
+
+		SyntheticInput(int fileIndex, std::uint64_t size, std::size_t &maxReadSize) :
+			m_fileIndex(fileIndex),
+			m_size(size),
+			m_position(0),
+			m_maxReadSize(maxReadSize)
+		{
+		}
+
+		std::uint64_t GetSize() const override
+		{
+			return m_size;
+		}
+
+		bool Read(void *buffer, std::size_t size, std::size_t &bytesRead) override
+		{
+			m_maxReadSize = (std::max)(m_maxReadSize, size);
+
+			bytesRead = static_cast<std::size_t>((std::min)(static_cast<std::uint64_t>(size), m_size - m_position));
+			auto bytes = static_cast<std::uint8_t *>(buffer);
+			std::size_t filled = 0;
+
+			while (filled < bytesRead)
+			{
+				std::size_t blockRemaining = BLOCK_SIZE - static_cast<std::size_t>(m_position % BLOCK_SIZE);
+				std::size_t amount = (std::min)(blockRemaining, bytesRead - filled);
+				memset(bytes + filled, GetSyntheticByte(m_fileIndex, m_position), amount);
+
+				filled += amount;
+				m_position += amount;
+			}
+
+			return true;
+		}
+
+	private:
+
+		const int m_fileIndex;
+		const std::uint64_t m_size;
+		std::uint64_t m_position;
+		std::size_t &m_maxReadSize;
+	};
+
+	struct SyntheticOutputResults
+	{
+		std::uint64_t bytesWritten = 0;
+		bool valid = true;
+	};
+
+	// Checks the merged output of a set of synthetic files, without
+	// storing it.
+	class SyntheticOutputChecker : public FileMergeOutput
+	{
+	public:
+
+		SyntheticOutputChecker(const std::vector<std::uint64_t> &fileSizes, SyntheticOutputResults &results) :
+			m_fileSizes(fileSizes),
+			m_fileIndex(0),
+			m_filePosition(0),
+			m_results(results)
+		{
+		}
+
+		bool Write(const void *buffer, std::size_t size) override
+		{
+			auto bytes = static_cast<const std::uint8_t *>(buffer);
+			std::size_t checked = 0;
+
+			while (checked < size)
+			{
+				while (m_fileIndex < m_fileSizes.size() && m_filePosition == m_fileSizes[m_fileIndex])
+				{
+					m_fileIndex++;
+					m_filePosition = 0;
+				}
+
+				if (m_fileIndex == m_fileSizes.size())
+				{
+					m_results.valid = false;
+					return true;
+				}
+
+				// The first byte of each block (or of each part of a block)
+				// is checked.
+				std::size_t blockRemaining = BLOCK_SIZE - static_cast<std::size_t>(m_filePosition % BLOCK_SIZE);
+				std::size_t fileRemaining = static_cast<std::size_t>((std::min)(
+					static_cast<std::uint64_t>(blockRemaining), m_fileSizes[m_fileIndex] - m_filePosition));
+				std::size_t amount = (std::min)(fileRemaining, size - checked);
+
+				if (bytes[checked] != GetSyntheticByte(static_cast<int>(m_fileIndex), m_filePosition))
+				{
+					m_results.valid = false;
+				}
+
+				checked += amount;
+				m_filePosition += amount;
+			}
+
+			m_results.bytesWritten += size;
+
+			return true;
+		}
+
+	private:
+
+		const std::vector<std::uint64_t> m_fileSizes;
+		std::size_t m_fileIndex;
+		std::uint64_t m_filePosition;
+		SyntheticOutputResults &m_results;
+	};
+}
+
+// Merges a set of synthetic files using a small, fixed amount of buffer
+// memory.
+void TestSyntheticMerge(const std::vector<std::uint64_t> &fileSizes, std::size_t memoryCap)
+{
+	std::vector<std::wstring> inputFiles;
+
+	for (std::size_t i = 0; i < fileSizes.size(); i++)
+	{
+		inputFiles.push_back(std::to_wstring(i));
+	}
+
+	std::size_t maxReadSize = 0;
+
+	auto openInput = [&fileSizes, &maxReadSize] (const std::wstring &path) -> std::unique_ptr<FileMergeInput> {
+		int fileIndex = std::stoi(path);
+		return std::make_unique<SyntheticInput>(fileIndex, fileSizes[fileIndex], maxReadSize);
+	};
+
+	SyntheticOutputResults outputResults;
+
+	auto createOutput = [&fileSizes, &outputResults] (const std::wstring &path) -> std::unique_ptr<FileMergeOutput> {
+		UNREFERENCED_PARAMETER(path);
+
+		return std::make_unique<SyntheticOutputChecker>(fileSizes, outputResults);
+	};
+
+	FileMerger::Options options;
+	options.bufferSize = memoryCap / 8;
+	options.numBuffers = 4;
+
+	FileMerger merger(OUTPUT_FILE, inputFiles, options, openInput, createOutput);
+	EXPECT_LE(merger.GetBufferMemorySize(), memoryCap);
+
+	std::uint64_t totalBytes = 0;
+
+	for (auto fileSize : fileSizes)
+	{
+		totalBytes += fileSize;
+	}
+
+	FileMerger::Progress lastProgress = {};
+	int numProgressUpdates = 0;
+
+	auto result = merger.Merge([&lastProgress, &numProgressUpdates, &outputResults] (const FileMerger::Progress &progress) {
+		// Progress should reflect exactly what's been written so far.
+		EXPECT_EQ(progress.bytesWritten, outputResults.bytesWritten);
+
+		lastProgress = progress;
+		numProgressUpdates++;
+	});
+
+	ASSERT_EQ(result, FileMerger::Result::Succeeded);
+	EXPECT_TRUE(outputResults.valid);
+	EXPECT_EQ(outputResults.bytesWritten, totalBytes);
+	EXPECT_LE(maxReadSize, options.bufferSize);
+
+	EXPECT_EQ(lastProgress.bytesWritten, totalBytes);
+	EXPECT_EQ(lastProgress.totalBytes, totalBytes);
+	EXPECT_EQ(lastProgress.filesMerged, fileSizes.size());
+	EXPECT_GT(numProgressUpdates, 0);
+}
+
+TEST(FileMerger, SyntheticFiles)
+{
+	const std::uint64_t MB = 1024 * 1024;
+	TestSyntheticMerge({ (5 * MB) + 123, MB, 4097, 0, MB / 2 }, 512 * 1024);
+}
+
+// Merges several GB of data (including a part larger than 4GB). This
+// takes a long time to run, so it's disabled by default.
+TEST(FileMerger, DISABLED_LargeFiles)
+{
+	const std::uint64_t GB = 1024 * 1024 * 1024;
+	TestSyntheticMerge({ (5 * GB) + 123, GB, 4097, 0, GB / 2 }, 8 * 1024 * 1024);
+}
@@ -0,0 +1,310 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/FileSearcher.h"
+#include "../Helper/Macros.h"
+#include "Helper.h"
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+namespace
+{
+	const wchar_t GENERATED_TREE_ROOT[] = L"C:\\Root";
+	const int GENERATED_TREE_DEPTH = 4;
+	const int GENERATED_TREE_FOLDERS_PER_FOLDER = 4;
+	const int GENERATED_TREE_FILES_PER_FOLDER = 8;
+
+	// 1 + 4 + 16 + 64 + 256
+	const int GENERATED_TREE_NUM_DIRECTORIES = 341;
+
+	// Generates the contents of a directory in a tree that only exists in
+	// memory. Each directory contains four .txt files (the first of which
+	// is hidden) and four .log files.
+	bool EnumerateGeneratedDirectory(const std::wstring &path, std::vector<FileSearchEntry> &entries)
+	{
+		auto depth = std::count(path.begin(), path.end(), '\\') - 1;
+
+		if (depth < GENERATED_TREE_DEPTH)
+		{
+			for (int i = 0; i < GENERATED_TREE_FOLDERS_PER_FOLDER; i++)
+			{
+				entries.push_back({ L"Folder" + std::to_wstring(i), FILE_ATTRIBUTE_DIRECTORY });
+			}
+		}
+
+		for (int i = 0; i < GENERATED_TREE_FILES_PER_FOLDER; i++)
+		{
+			std::wstring extension = (i < GENERATED_TREE_FILES_PER_FOLDER / 2) ? L".txt" : L".log";
+			DWORD attributes = FILE_ATTRIBUTE_ARCHIVE;
+
+			if (i == 0)
+			{
+				attributes |= FILE_ATTRIBUTE_HIDDEN;
+			}
+
+			entries.push_back({ L"File" + std::to_wstring(i) + extension, attributes });
+		}
+
+		return true;
+	}
+
+	FileSearcher::Options GetGeneratedTreeOptions(const std::wstring &pattern)
+	{
+		FileSearcher::Options options;
+		options.baseDirectory = GENERATED_TREE_ROOT;
+		options.pattern = pattern;
+		return options;
+	}
+
+	// Runs a search, removing results from the buffer until the search
+	// has finished.
+	std::vector<FileSearcher::Result> RunSearch(FileSearcher &searcher)
+	{
+		std::vector<FileSearcher::Result> results;
+
+		bool started = searcher.Start(nullptr);
+		EXPECT_TRUE(started);
+
+		if (!started)
+		{
+			return results;
+		}
+
+		while (true)
+		{
+			// Once the search has finished, every result will be in the
+			// buffer.
+			bool finished = searcher.IsFinished();
+			auto batch = searcher.TakeResults(1000);
+
+			if (finished && batch.empty())
+			{
+				break;
+			}
+
+			if (batch.empty())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			std::move(batch.begin(), batch.end(), std::back_inserter(results));
+		}
+
+		return results;
+	}
+
+	void TestGeneratedTreeSearch(const FileSearcher::Options &options, int numFoldersExpected, int numFilesExpected)
+	{
+		for (int numThreads = 1; numThreads <= 8; numThreads++)
+		{
+			FileSearcher searcher(options, numThreads, 100, EnumerateGeneratedDirectory);
+			auto results = RunSearch(searcher);
+
+			int numFolders = static_cast<int>(std::count_if(results.begin(), results.end(),
+				[] (const FileSearcher::Result &result) {
+				return result.isFolder;
+			}));
+
+			EXPECT_EQ(numFoldersExpected, numFolders);
+			EXPECT_EQ(numFilesExpected, static_cast<int>(results.size()) - numFolders);
+
+			auto statistics = searcher.GetStatistics();
+			EXPECT_EQ(numFoldersExpected, statistics.numFoldersFound);
+			EXPECT_EQ(numFilesExpected, statistics.numFilesFound);
+
+			// Each item should only be returned once.
+			std::set<std::wstring> paths;
+
+			for (const auto &result : results)
+			{
+				EXPECT_TRUE(paths.insert(result.path).second);
+			}
+		}
+	}
+}
+
+TEST(FileNameMatcher, Wildcard)
+{
+	FileNameMatcher matcher(L"*.txt", false, false);
+	EXPECT_TRUE(matcher.Matches(L"file.txt"));
+	EXPECT_FALSE(matcher.Matches(L"file.TXT"));
+	EXPECT_FALSE(matcher.Matches(L"file.log"));
+
+	FileNameMatcher caseInsensitiveMatcher(L"*.txt", false, true);
+	EXPECT_TRUE(caseInsensitiveMatcher.Matches(L"file.TXT"));
+
+	FileNameMatcher emptyMatcher(L"", false, false);
+	EXPECT_TRUE(emptyMatcher.Matches(L"file.log"));
+}
+
+TEST(FileNameMatcher, RegularExpression)
+{
+	FileNameMatcher matcher(L"file[0-9]+\\.txt", true, false);
+	EXPECT_TRUE(matcher.Matches(L"file12.txt"));
+	EXPECT_FALSE(matcher.Matches(L"FILE12.txt"));
+	EXPECT_FALSE(matcher.Matches(L"file.txt"));
+
+	FileNameMatcher caseInsensitiveMatcher(L"file[0-9]+\\.txt", true, true);
+	EXPECT_TRUE(caseInsensitiveMatcher.Matches(L"FILE12.TXT"));
+
+	EXPECT_THROW(FileNameMatcher(L"file[", true, false), std::regex_error);
+}
+
+TEST(FileSearcher, ResourceFolder)
+{
+	TCHAR szFullFileName[MAX_PATH];
+	GetTestResourceFilePath(L"FolderSize", szFullFileName, SIZEOF_ARRAY(szFullFileName));
+
+	FileSearcher::Options options;
+	options.baseDirectory = szFullFileName;
+
+	FileSearcher searcher(options, FileSearcher::GetDefaultNumThreads());
+	auto results = RunSearch(searcher);
+
+	auto statistics = searcher.GetStatistics();
+	EXPECT_EQ(2, statistics.numFoldersFound);
+	EXPECT_EQ(6, statistics.numFilesFound);
+	EXPECT_EQ(8U, results.size());
+}
+
+TEST(FileSearcher, AllItems)
+{
+	TestGeneratedTreeSearch(GetGeneratedTreeOptions(L""), GENERATED_TREE_NUM_DIRECTORIES - 1,
+		GENERATED_TREE_NUM_DIRECTORIES * GENERATED_TREE_FILES_PER_FOLDER);
+}
+
+TEST(FileSearcher, Wildcard)
+{
+	int numFilesExpected = GENERATED_TREE_NUM_DIRECTORIES * (GENERATED_TREE_FILES_PER_FOLDER / 2);
+
+	TestGeneratedTreeSearch(GetGeneratedTreeOptions(L"*.txt"), 0, numFilesExpected);
+	TestGeneratedTreeSearch(GetGeneratedTreeOptions(L"*.TXT"), 0, 0);
+
+	auto options = GetGeneratedTreeOptions(L"*.TXT");
+	options.caseInsensitive = true;
+	TestGeneratedTreeSearch(options, 0, numFilesExpected);
+}
+
+TEST(FileSearcher, RegularExpression)
+{
+	auto options = GetGeneratedTreeOptions(L"File[0-3]\\.txt");
+	options.useRegularExpressions = true;
+	TestGeneratedTreeSearch(options, 0, GENERATED_TREE_NUM_DIRECTORIES * (GENERATED_TREE_FILES_PER_FOLDER / 2));
+
+	options = GetGeneratedTreeOptions(L"folder.*");
+	options.useRegularExpressions = true;
+	options.caseInsensitive = true;
+	TestGeneratedTreeSearch(options, GENERATED_TREE_NUM_DIRECTORIES - 1, 0);
+}
+
+TEST(FileSearcher, InvalidRegularExpression)
+{
+	auto options = GetGeneratedTreeOptions(L"File[");
+	options.useRegularExpressions = true;
+
+	FileSearcher searcher(options, 2, 100, EnumerateGeneratedDirectory);
+	EXPECT_FALSE(searcher.Start(nullptr));
+
+	// Since the search was never started, this should return
+	// immediately.
+	searcher.Wait();
+}
+
+TEST(FileSearcher, Attributes)
+{
+	auto options = GetGeneratedTreeOptions(L"");
+	options.attributes = FILE_ATTRIBUTE_HIDDEN;
+	TestGeneratedTreeSearch(options, 0, GENERATED_TREE_NUM_DIRECTORIES);
+}
+
+TEST(FileSearcher, NoSubFolders)
+{
+	auto options = GetGeneratedTreeOptions(L"");
+	options.searchSubFolders = false;
+	TestGeneratedTreeSearch(options, GENERATED_TREE_FOLDERS_PER_FOLDER, GENERATED_TREE_FILES_PER_FOLDER);
+}
+
+TEST(FileSearcher, BoundedBuffer)
+{
+	const std::size_t maxBufferedResults = 10;
+	const int numThreads = 4;
+
+	FileSearcher searcher(GetGeneratedTreeOptions(L""), numThreads, maxBufferedResults,
+		EnumerateGeneratedDirectory);
+	ASSERT_TRUE(searcher.Start(nullptr));
+
+	// Since nothing is removing results, the search threads should be
+	// blocked once the buffer is full.
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	EXPECT_FALSE(searcher.IsFinished());
+
+	auto statistics = searcher.GetStatistics();
+	EXPECT_LE(statistics.numFoldersFound + statistics.numFilesFound,
+		static_cast<int>(maxBufferedResults) + numThreads);
+
+	auto results = searcher.TakeResults(maxBufferedResults * 2);
+	EXPECT_EQ(maxBufferedResults, results.size());
+
+	// Stopping the search should release any blocked threads.
+	searcher.Stop();
+	searcher.Wait();
+	EXPECT_TRUE(searcher.IsFinished());
+}
+
+TEST(FileSearcher, Stop)
+{
+	auto slowEnumerate = [] (const std::wstring &path, std::vector<FileSearchEntry> &entries) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return EnumerateGeneratedDirectory(path, entries);
+	};
+
+	FileSearcher searcher(GetGeneratedTreeOptions(L""), 2, FileSearcher::DEFAULT_MAX_BUFFERED_RESULTS,
+		slowEnumerate);
+
+	std::atomic<int> numCompletions = 0;
+	bool searchStopped = false;
+
+	ASSERT_TRUE(searcher.Start([&numCompletions, &searchStopped] (bool stopped) {
+		searchStopped = stopped;
+		numCompletions++;
+	}));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	searcher.Stop();
+	searcher.Wait();
+
+	EXPECT_EQ(1, numCompletions);
+	EXPECT_TRUE(searchStopped);
+	EXPECT_LT(searcher.GetStatistics().numDirectoriesSearched,
+		static_cast<std::uint64_t>(GENERATED_TREE_NUM_DIRECTORIES));
+}
+
+// The results shouldn't depend on how the directories are split between
+// the threads. Each enumeration is given a small delay, so that the
+// threads will end up stealing work from each other.
+TEST(FileSearcher, NumThreads)
+{
+	auto slowEnumerate = [] (const std::wstring &path, std::vector<FileSearchEntry> &entries) {
+		std::this_thread::sleep_for(std::chrono::microseconds(20));
+		return EnumerateGeneratedDirectory(path, entries);
+	};
+
+	int maxThreads = (std::max)(4, FileSearcher::GetDefaultNumThreads());
+
+	for (int numThreads = 1; numThreads <= maxThreads; numThreads++)
+	{
+		FileSearcher searcher(GetGeneratedTreeOptions(L"*.txt"), numThreads,
+			FileSearcher::DEFAULT_MAX_BUFFERED_RESULTS, slowEnumerate);
+
+		auto results = RunSearch(searcher);
+
+		EXPECT_EQ(static_cast<std::size_t>(GENERATED_TREE_NUM_DIRECTORIES * (GENERATED_TREE_FILES_PER_FOLDER / 2)),
+			results.size());
+		EXPECT_EQ(static_cast<std::uint64_t>(GENERATED_TREE_NUM_DIRECTORIES),
+			searcher.GetStatistics().numDirectoriesSearched);
+	}
+}
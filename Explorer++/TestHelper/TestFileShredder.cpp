@@ -0,0 +1,358 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/FileShredder.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace
+{
+	using FileData = std::vector<std::uint8_t>;
+
+	struct MemoryFile
+	{
+		FileData data;
+		bool deleted = false;
+
+		// If set, writes beyond this offset will fail.
+		std::uint64_t writeLimit = UINT64_MAX;
+	};
+
+	class MemoryTarget : public ShredTarget
+	{
+	public:
+
+		MemoryTarget(MemoryFile &file) :
+			m_file(file)
+		{
+		}
+
+		std::uint64_t GetSize() const override
+		{
+			return m_file.data.size();
+		}
+
+		bool Write(std::uint64_t offset, const void *buffer, std::size_t size) override
+		{
+			if (offset + size > m_file.writeLimit)
+			{
+				return false;
+			}
+
+			memcpy(m_file.data.data() + offset, buffer, size);
+			return true;
+		}
+
+		bool Read(std::uint64_t offset, void *buffer, std::size_t size) override
+		{
+			memcpy(buffer, m_file.data.data() + offset, size);
+			return true;
+		}
+
+		bool Flush() override
+		{
+			return true;
+		}
+
+		bool Delete() override
+		{
+			m_file.deleted = true;
+			return true;
+		}
+
+	private:
+
+		MemoryFile &m_file;
+	};
+
+	// A set of files that are stored in memory. Files that haven't been
+	// added can't be opened.
+	class MemoryFileSystem
+	{
+	public:
+
+		MemoryFile &AddFile(const std::wstring &path, std::size_t size)
+		{
+			MemoryFile &file = m_files[path];
+			file.data.assign(size, 0xAB);
+			return file;
+		}
+
+		FileShredder::OpenTarget GetOpenTarget()
+		{
+			return [this] (const std::wstring &path) -> std::unique_ptr<ShredTarget> {
+				auto itr = m_files.find(path);
+
+				if (itr == m_files.end())
+				{
+					return nullptr;
+				}
+
+				return std::make_unique<MemoryTarget>(itr->second);
+			};
+		}
+
+	private:
+
+		std::map<std::wstring, MemoryFile> m_files;
+	};
+
+	const std::size_t SMALL_BLOCK_SIZE = 4096;
+
+	const std::vector<FileShredder::Pattern> THREE_PASSES = {
+		FileShredder::Pattern::Zeros,
+		FileShredder::Pattern::Ones,
+		FileShredder::Pattern::Random
+	};
+
+	// Checks that the contents of a target match what should have been
+	// written by the specified pass. Random data can't be checked exactly,
+	// but it shouldn't consist of a single repeated byte.
+	void CheckPassData(const FileData &data, FileShredder::Pattern pattern)
+	{
+		switch (pattern)
+		{
+		case FileShredder::Pattern::Zeros:
+			EXPECT_TRUE(std::all_of(data.begin(), data.end(), [] (std::uint8_t byte) { return byte == 0x00; }));
+			break;
+
+		case FileShredder::Pattern::Ones:
+			EXPECT_TRUE(std::all_of(data.begin(), data.end(), [] (std::uint8_t byte) { return byte == 0xFF; }));
+			break;
+
+		case FileShredder::Pattern::Random:
+			if (data.size() >= 16)
+			{
+				EXPECT_FALSE(std::all_of(data.begin(), data.end(), [&data] (std::uint8_t byte) { return byte == data[0]; }));
+			}
+			break;
+		}
+	}
+
+	FileData ReadTarget(ShredTarget &target)
+	{
+		FileData data(static_cast<std::size_t>(target.GetSize()));
+
+		if (!data.empty())
+		{
+			EXPECT_TRUE(target.Read(0, data.data(), data.size()));
+		}
+
+		return data;
+	}
+}
+
+TEST(FileShredder, Passes)
+{
+	MemoryFileSystem fileSystem;
+	std::vector<std::wstring> paths;
+	std::vector<MemoryFile *> files;
+
+	// The sizes include files that are smaller than a single block, as
+	// well as files that end part way through a block.
+	const std::size_t sizes[] = { 0, 100, SMALL_BLOCK_SIZE, (SMALL_BLOCK_SIZE * 5) + 17 };
+
+	for (std::size_t size : sizes)
+	{
+		std::wstring path = L"C:\\file" + std::to_wstring(size);
+		files.push_back(&fileSystem.AddFile(path, size));
+		paths.push_back(path);
+	}
+
+	std::mutex mutex;
+	std::map<std::wstring, std::vector<std::size_t>> passesCompleted;
+
+	FileShredder shredder(THREE_PASSES, 2, SMALL_BLOCK_SIZE, fileSystem.GetOpenTarget());
+	FileShredder::Progress finalProgress = {};
+	auto result = shredder.Shred(paths, [&finalProgress] (const FileShredder::Progress &progress) {
+		finalProgress = progress;
+	}, [&] (const std::wstring &path, std::size_t passIndex, ShredTarget &target) {
+		CheckPassData(ReadTarget(target), THREE_PASSES[passIndex]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		passesCompleted[path].push_back(passIndex);
+	});
+	EXPECT_EQ(result, FileShredder::Result::Succeeded);
+
+	std::uint64_t totalSize = 0;
+
+	for (std::size_t i = 0; i < paths.size(); i++)
+	{
+		EXPECT_TRUE(files[i]->deleted);
+		EXPECT_EQ(passesCompleted[paths[i]], std::vector<std::size_t>({ 0, 1, 2 }));
+
+		totalSize += sizes[i];
+	}
+
+	EXPECT_EQ(finalProgress.totalBytes, totalSize * THREE_PASSES.size());
+	EXPECT_EQ(finalProgress.bytesWritten, finalProgress.totalBytes);
+	EXPECT_EQ(finalProgress.filesDestroyed, paths.size());
+}
+
+TEST(FileShredder, OpenFailed)
+{
+	MemoryFileSystem fileSystem;
+	MemoryFile &file = fileSystem.AddFile(L"C:\\file", SMALL_BLOCK_SIZE * 2);
+
+	FileShredder shredder({ FileShredder::Pattern::Zeros }, 1, SMALL_BLOCK_SIZE, fileSystem.GetOpenTarget());
+	EXPECT_EQ(shredder.Shred({ L"C:\\missing", L"C:\\file" }, nullptr), FileShredder::Result::Failed);
+
+	// The remaining file should still be destroyed.
+	EXPECT_TRUE(file.deleted);
+}
+
+TEST(FileShredder, WriteFailed)
+{
+	MemoryFileSystem fileSystem;
+	MemoryFile &file = fileSystem.AddFile(L"C:\\file", SMALL_BLOCK_SIZE * 4);
+	file.writeLimit = SMALL_BLOCK_SIZE * 2;
+
+	FileShredder shredder({ FileShredder::Pattern::Zeros }, 1, SMALL_BLOCK_SIZE, fileSystem.GetOpenTarget());
+	EXPECT_EQ(shredder.Shred({ L"C:\\file" }, nullptr), FileShredder::Result::Failed);
+
+	// A file that couldn't be fully overwritten shouldn't be deleted.
+	EXPECT_FALSE(file.deleted);
+}
+
+TEST(FileShredder, Stop)
+{
+	MemoryFileSystem fileSystem;
+	MemoryFile &file = fileSystem.AddFile(L"C:\\file", SMALL_BLOCK_SIZE * 4);
+
+	FileShredder shredder(THREE_PASSES, 1, SMALL_BLOCK_SIZE, fileSystem.GetOpenTarget());
+	auto result = shredder.Shred({ L"C:\\file" }, nullptr,
+		[&shredder] (const std::wstring &path, std::size_t passIndex, ShredTarget &target) {
+		UNREFERENCED_PARAMETER(path);
+		UNREFERENCED_PARAMETER(passIndex);
+		UNREFERENCED_PARAMETER(target);
+
+		shredder.Stop();
+	});
+	EXPECT_EQ(result, FileShredder::Result::Stopped);
+	EXPECT_FALSE(file.deleted);
+
+	// Only the first pass should have been written.
+	CheckPassData(file.data, FileShredder::Pattern::Zeros);
+}
+
+namespace
+{
+	std::wstring CreateTestFile(const std::wstring &name, std::size_t size)
+	{
+		TCHAR tempPath[MAX_PATH];
+		EXPECT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+
+		std::wstring path = std::wstring(tempPath) + name;
+		FileData data(size, 0xAB);
+
+		HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		EXPECT_NE(file, INVALID_HANDLE_VALUE);
+
+		DWORD bytesWritten;
+		EXPECT_TRUE(WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr));
+		CloseHandle(file);
+
+		return path;
+	}
+
+	// Reads a target that may have been opened for unbuffered access, in
+	// which case the buffer needs to be sector aligned.
+	FileData ReadUnbufferedTarget(ShredTarget &target)
+	{
+		const std::size_t READ_SIZE = 64 * 1024;
+
+		auto buffer = static_cast<std::uint8_t *>(VirtualAlloc(nullptr, READ_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+		EXPECT_NE(buffer, nullptr);
+
+		FileData data;
+		std::uint64_t size = target.GetSize();
+
+		for (std::uint64_t offset = 0; offset < size; offset += READ_SIZE)
+		{
+			auto readSize = static_cast<std::size_t>((std::min)(static_cast<std::uint64_t>(READ_SIZE), size - offset));
+			EXPECT_TRUE(target.Read(offset, buffer, readSize));
+			data.insert(data.end(), buffer, buffer + readSize);
+		}
+
+		VirtualFree(buffer, 0, MEM_RELEASE);
+
+		return data;
+	}
+}
+
+TEST(FileShredder, Files)
+{
+	std::vector<std::wstring> paths;
+
+	for (int i = 0; i < 3; i++)
+	{
+		paths.push_back(CreateTestFile(L"TestFileShredder.file" + std::to_wstring(i), (100000 * (i + 1)) + i));
+	}
+
+	std::mutex mutex;
+	std::map<std::wstring, std::vector<std::size_t>> passesCompleted;
+
+	FileShredder shredder(THREE_PASSES, 2);
+	auto result = shredder.Shred(paths, nullptr,
+		[&] (const std::wstring &path, std::size_t passIndex, ShredTarget &target) {
+		// Each pass is flushed before this is called, so what's read here
+		// is what's on disk, including the slack space at the end of the
+		// last cluster.
+		FileData data = ReadUnbufferedTarget(target);
+		EXPECT_EQ(data.size(), target.GetSize());
+		CheckPassData(data, THREE_PASSES[passIndex]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		passesCompleted[path].push_back(passIndex);
+	});
+	EXPECT_EQ(result, FileShredder::Result::Succeeded);
+
+	for (const auto &path : paths)
+	{
+		EXPECT_EQ(passesCompleted[path], std::vector<std::size_t>({ 0, 1, 2 }));
+		EXPECT_EQ(GetFileAttributes(path.c_str()), INVALID_FILE_ATTRIBUTES);
+	}
+
+	// Folders can't be destroyed.
+	TCHAR tempPath[MAX_PATH];
+	ASSERT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+	EXPECT_EQ(OpenShredTarget(tempPath), nullptr);
+}
+
+// Destroys 128MB of files, using both a single thread and the default
+// number of threads. This writes a large amount of data to disk, so it's
+// disabled by default.
+TEST(FileShredder, DISABLED_LargeFiles)
+{
+	const int NUM_FILES = 4;
+	const std::size_t FILE_SIZE = 32 * 1024 * 1024;
+
+	for (int numThreads : { 1, FileShredder::GetDefaultNumThreads() })
+	{
+		std::vector<std::wstring> paths;
+
+		for (int i = 0; i < NUM_FILES; i++)
+		{
+			paths.push_back(CreateTestFile(L"TestFileShredder.benchmark" + std::to_wstring(i), FILE_SIZE));
+		}
+
+		FileShredder shredder({ FileShredder::Pattern::Random }, numThreads);
+		FileShredder::Progress finalProgress = {};
+
+		auto result = shredder.Shred(paths, [&finalProgress] (const FileShredder::Progress &progress) {
+			finalProgress = progress;
+		});
+
+		EXPECT_EQ(result, FileShredder::Result::Succeeded);
+		EXPECT_EQ(finalProgress.filesDestroyed, static_cast<std::size_t>(NUM_FILES));
+		EXPECT_GE(finalProgress.bytesWritten, static_cast<std::uint64_t>(NUM_FILES) * FILE_SIZE);
+
+		for (const auto &path : paths)
+		{
+			EXPECT_EQ(GetFileAttributes(path.c_str()), INVALID_FILE_ATTRIBUTES);
+		}
+	}
+}
@@ -0,0 +1,528 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ChecksumManifest.h"
+#include "../Helper/FileSplitter.h"
+#include <boost/crc.hpp>
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace
+{
+	using FileData = std::vector<std::uint8_t>;
+
+	class MemoryInput : public FileMergeInput
+	{
+	public:
+
+		MemoryInput(const FileData &data) :
+			m_data(data),
+			m_position(0)
+		{
+		}
+
+		std::uint64_t GetSize() const override
+		{
+			return m_data.size();
+		}
+
+		bool Read(void *buffer, std::size_t size, std::size_t &bytesRead) override
+		{
+			bytesRead = (std::min)(size, m_data.size() - m_position);
+			memcpy(buffer, m_data.data() + m_position, bytesRead);
+			m_position += bytesRead;
+			return true;
+		}
+
+	private:
+
+		const FileData m_data;
+		std::size_t m_position;
+	};
+
+	class MemoryOutput : public FileMergeOutput
+	{
+	public:
+
+		MemoryOutput(FileData &data) :
+			m_data(data)
+		{
+		}
+
+		bool Write(const void *buffer, std::size_t size) override
+		{
+			auto bytes = static_cast<const std::uint8_t *>(buffer);
+			m_data.insert(m_data.end(), bytes, bytes + size);
+			return true;
+		}
+
+	private:
+
+		FileData &m_data;
+	};
+
+	// A set of files that are stored in memory.
+	class MemoryFileSystem
+	{
+	public:
+
+		void AddFile(const std::wstring &path, const FileData &data)
+		{
+			m_files[path] = data;
+		}
+
+		FileData *GetFile(const std::wstring &path)
+		{
+			auto itr = m_files.find(path);
+
+			if (itr == m_files.end())
+			{
+				return nullptr;
+			}
+
+			return &itr->second;
+		}
+
+		FileMerger::OpenInput GetOpenInput()
+		{
+			return [this] (const std::wstring &path) -> std::unique_ptr<FileMergeInput> {
+				auto itr = m_files.find(path);
+
+				if (itr == m_files.end())
+				{
+					return nullptr;
+				}
+
+				return std::make_unique<MemoryInput>(itr->second);
+			};
+		}
+
+		FileMerger::CreateOutput GetCreateOutput()
+		{
+			return [this] (const std::wstring &path) -> std::unique_ptr<FileMergeOutput> {
+				auto [itr, inserted] = m_files.insert({ path, FileData() });
+
+				if (!inserted)
+				{
+					return nullptr;
+				}
+
+				return std::make_unique<MemoryOutput>(itr->second);
+			};
+		}
+
+	private:
+
+		std::map<std::wstring, FileData> m_files;
+	};
+
+	FileData GenerateData(std::size_t size)
+	{
+		FileData data(size);
+
+		for (std::size_t i = 0; i < size; i++)
+		{
+			data[i] = static_cast<std::uint8_t>((i * 7) % 251);
+		}
+
+		return data;
+	}
+
+	std::uint32_t CalculateChecksum(const FileData &data)
+	{
+		boost::crc_32_type checksum;
+		checksum.process_bytes(data.data(), data.size());
+		return checksum.checksum();
+	}
+
+	const std::size_t SMALL_BUFFER_SIZE = 4096;
+
+	FileSplitter::Options GetSmallBufferOptions()
+	{
+		FileSplitter::Options options;
+		options.bufferSize = SMALL_BUFFER_SIZE;
+		options.numBuffers = 2;
+		return options;
+	}
+
+	const wchar_t INPUT_FILE[] = L"C:\\Input\\file";
+
+	std::wstring GetPartPath(std::uint64_t partNumber)
+	{
+		return L"C:\\Output\\file.part" + std::to_wstring(partNumber);
+	}
+}
+
+TEST(FileSplitter, Split)
+{
+	const FileData input = GenerateData((SMALL_BUFFER_SIZE * 10) + 123);
+
+	// The part sizes are smaller than, equal to, not aligned with and
+	// larger than the buffer size, as well as larger than the file itself.
+	const std::uint64_t partSizes[] = { 100, 1000, SMALL_BUFFER_SIZE, (SMALL_BUFFER_SIZE * 3) + 7,
+		input.size(), input.size() * 2 };
+
+	for (std::uint64_t partSize : partSizes)
+	{
+		MemoryFileSystem fileSystem;
+		fileSystem.AddFile(INPUT_FILE, input);
+
+		FileSplitter::Options options = GetSmallBufferOptions();
+		options.manifestPath = L"C:\\Output\\file.sfv";
+
+		FileSplitter splitter(INPUT_FILE, partSize, GetPartPath, options, fileSystem.GetOpenInput(),
+			fileSystem.GetCreateOutput());
+
+		FileSplitter::Progress lastProgress = {};
+		auto result = splitter.Split([&lastProgress] (const FileSplitter::Progress &progress) {
+			lastProgress = progress;
+		});
+		ASSERT_EQ(result, FileSplitter::Result::Succeeded);
+
+		std::uint64_t expectedParts = (input.size() + partSize - 1) / partSize;
+		EXPECT_EQ(lastProgress.partsWritten, expectedParts);
+		EXPECT_EQ(lastProgress.totalParts, expectedParts);
+		EXPECT_EQ(lastProgress.bytesWritten, input.size());
+		EXPECT_EQ(splitter.GetManifest().GetNumEntries(), expectedParts);
+
+		FileData merged;
+
+		for (std::uint64_t i = 1; i <= expectedParts; i++)
+		{
+			const FileData *part = fileSystem.GetFile(GetPartPath(i));
+			ASSERT_NE(part, nullptr);
+
+			std::uint64_t expectedSize = (std::min)(partSize, input.size() - ((i - 1) * partSize));
+			EXPECT_EQ(part->size(), expectedSize);
+
+			auto checksum = splitter.GetManifest().GetChecksum(L"file.part" + std::to_wstring(i));
+			ASSERT_TRUE(checksum);
+			EXPECT_EQ(*checksum, CalculateChecksum(*part));
+
+			merged.insert(merged.end(), part->begin(), part->end());
+		}
+
+		EXPECT_EQ(fileSystem.GetFile(GetPartPath(expectedParts + 1)), nullptr);
+		EXPECT_EQ(merged, input);
+	}
+}
+
+TEST(FileSplitter, EmptyFile)
+{
+	MemoryFileSystem fileSystem;
+	fileSystem.AddFile(INPUT_FILE, FileData());
+
+	FileSplitter splitter(INPUT_FILE, 100, GetPartPath, GetSmallBufferOptions(), fileSystem.GetOpenInput(),
+		fileSystem.GetCreateOutput());
+	EXPECT_EQ(splitter.Split(nullptr), FileSplitter::Result::Succeeded);
+	EXPECT_EQ(fileSystem.GetFile(GetPartPath(1)), nullptr);
+}
+
+TEST(FileSplitter, InputFileInvalid)
+{
+	MemoryFileSystem fileSystem;
+
+	FileSplitter splitter(INPUT_FILE, 100, GetPartPath, GetSmallBufferOptions(), fileSystem.GetOpenInput(),
+		fileSystem.GetCreateOutput());
+	EXPECT_EQ(splitter.Split(nullptr), FileSplitter::Result::InputFileInvalid);
+}
+
+TEST(FileSplitter, OutputFileInvalid)
+{
+	MemoryFileSystem fileSystem;
+	fileSystem.AddFile(INPUT_FILE, GenerateData(SMALL_BUFFER_SIZE * 4));
+
+	// The second part already exists.
+	fileSystem.AddFile(GetPartPath(2), FileData());
+
+	FileSplitter splitter(INPUT_FILE, SMALL_BUFFER_SIZE, GetPartPath, GetSmallBufferOptions(),
+		fileSystem.GetOpenInput(), fileSystem.GetCreateOutput());
+	EXPECT_EQ(splitter.Split(nullptr), FileSplitter::Result::OutputFileInvalid);
+	EXPECT_EQ(fileSystem.GetFile(GetPartPath(3)), nullptr);
+}
+
+TEST(FileSplitter, Stop)
+{
+	MemoryFileSystem fileSystem;
+	fileSystem.AddFile(INPUT_FILE, GenerateData(SMALL_BUFFER_SIZE * 8));
+
+	FileSplitter *splitterPointer = nullptr;
+	auto createOutput = fileSystem.GetCreateOutput();
+
+	// The split is stopped as soon as the second part is created.
+	auto stoppingCreateOutput = [&splitterPointer, createOutput] (const std::wstring &path) {
+		if (path == GetPartPath(2))
+		{
+			splitterPointer->Stop();
+		}
+
+		return createOutput(path);
+	};
+
+	FileSplitter splitter(INPUT_FILE, SMALL_BUFFER_SIZE, GetPartPath, GetSmallBufferOptions(),
+		fileSystem.GetOpenInput(), stoppingCreateOutput);
+	splitterPointer = &splitter;
+	EXPECT_EQ(splitter.Split(nullptr), FileSplitter::Result::Stopped);
+}
+
+TEST(ChecksumManifest, SerializeAndParse)
+{
+	ChecksumManifest manifest;
+	manifest.AddEntry(L"file.part1", 0x0123ABCD);
+	manifest.AddEntry(L"file with spaces.part2", 0);
+
+	std::string data = manifest.Serialize();
+	EXPECT_EQ(data, "file.part1 0123ABCD\r\nfile with spaces.part2 00000000\r\n");
+
+	auto parsed = ChecksumManifest::Parse("; A comment\r\n" + data + "\r\n");
+	ASSERT_TRUE(parsed);
+	EXPECT_EQ(parsed->GetNumEntries(), 2U);
+	EXPECT_EQ(parsed->GetChecksum(L"FILE.PART1").value_or(0), 0x0123ABCDU);
+	EXPECT_EQ(parsed->GetChecksum(L"file with spaces.part2").value_or(1), 0U);
+	EXPECT_FALSE(parsed->GetChecksum(L"file.part3"));
+
+	EXPECT_FALSE(ChecksumManifest::Parse("file.part1"));
+	EXPECT_FALSE(ChecksumManifest::Parse("file.part1 0123ABC"));
+	EXPECT_FALSE(ChecksumManifest::Parse("file.part1 0123ABCG"));
+}
+
+// Splits a file and then merges the parts back together, verifying them
+// against the manifest written by the split.
+TEST(FileSplitter, MergeWithManifest)
+{
+	MemoryFileSystem fileSystem;
+	const FileData input = GenerateData((SMALL_BUFFER_SIZE * 5) + 17);
+	fileSystem.AddFile(INPUT_FILE, input);
+
+	FileSplitter::Options splitOptions = GetSmallBufferOptions();
+	splitOptions.manifestPath = L"C:\\Output\\file.sfv";
+
+	FileSplitter splitter(INPUT_FILE, SMALL_BUFFER_SIZE * 2, GetPartPath, splitOptions, fileSystem.GetOpenInput(),
+		fileSystem.GetCreateOutput());
+	ASSERT_EQ(splitter.Split(nullptr), FileSplitter::Result::Succeeded);
+
+	std::vector<std::wstring> parts = { GetPartPath(1), GetPartPath(2), GetPartPath(3) };
+
+	FileMerger::Options mergeOptions;
+	mergeOptions.bufferSize = SMALL_BUFFER_SIZE;
+	mergeOptions.numBuffers = 2;
+	mergeOptions.manifest = splitter.GetManifest();
+
+	FileMerger merger(L"C:\\Output\\merged", parts, mergeOptions, fileSystem.GetOpenInput(),
+		fileSystem.GetCreateOutput());
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::Succeeded);
+	EXPECT_EQ(*fileSystem.GetFile(L"C:\\Output\\merged"), input);
+
+	(*fileSystem.GetFile(GetPartPath(2)))[10] ^= 0xFF;
+
+	FileMerger corruptMerger(L"C:\\Output\\corrupt", parts, mergeOptions, fileSystem.GetOpenInput(),
+		fileSystem.GetCreateOutput());
+	EXPECT_EQ(corruptMerger.Merge(nullptr), FileMerger::Result::VerificationFailed);
+
+	// A part that isn't listed in the manifest can't be verified.
+	mergeOptions.manifest = ChecksumManifest();
+	FileMerger unlistedMerger(L"C:\\Output\\unlisted", { GetPartPath(1) }, mergeOptions,
+		fileSystem.GetOpenInput(), fileSystem.GetCreateOutput());
+	EXPECT_EQ(unlistedMerger.Merge(nullptr), FileMerger::Result::VerificationFailed);
+}
+
+TEST(FileSplitter, Files)
+{
+	TCHAR tempPath[MAX_PATH];
+	ASSERT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+
+	std::wstring inputFile = std::wstring(tempPath) + L"TestFileSplitter.in";
+	FileData input = GenerateData((SMALL_BUFFER_SIZE * 7) + 3);
+
+	HANDLE file = CreateFile(inputFile.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	ASSERT_NE(file, INVALID_HANDLE_VALUE);
+
+	DWORD bytesWritten;
+	BOOL res = WriteFile(file, input.data(), static_cast<DWORD>(input.size()), &bytesWritten, nullptr);
+	CloseHandle(file);
+	ASSERT_TRUE(res);
+
+	auto getPartPath = [tempPath] (std::uint64_t partNumber) {
+		return std::wstring(tempPath) + L"TestFileSplitter.part" + std::to_wstring(partNumber);
+	};
+
+	std::vector<std::wstring> parts;
+
+	for (std::uint64_t i = 1; i <= 3; i++)
+	{
+		parts.push_back(getPartPath(i));
+		DeleteFile(parts.back().c_str());
+	}
+
+	FileSplitter::Options options = GetSmallBufferOptions();
+	options.manifestPath = std::wstring(tempPath) + L"TestFileSplitter.sfv";
+
+	FileSplitter splitter(inputFile, SMALL_BUFFER_SIZE * 3, getPartPath, options);
+	EXPECT_EQ(splitter.Split(nullptr), FileSplitter::Result::Succeeded);
+
+	// The manifest should be found alongside the parts.
+	auto manifest = FindChecksumManifest(parts);
+	ASSERT_TRUE(manifest);
+	EXPECT_EQ(manifest->GetNumEntries(), parts.size());
+
+	std::wstring outputFile = std::wstring(tempPath) + L"TestFileSplitter.out";
+	DeleteFile(outputFile.c_str());
+
+	FileMerger::Options mergeOptions;
+	mergeOptions.manifest = manifest;
+
+	FileMerger merger(outputFile, parts, mergeOptions);
+	EXPECT_EQ(merger.Merge(nullptr), FileMerger::Result::Succeeded);
+
+	auto output = OpenFileMergeInput(outputFile);
+	ASSERT_TRUE(output);
+
+	FileData outputData(input.size());
+	std::size_t bytesRead;
+	ASSERT_TRUE(output->Read(outputData.data(), outputData.size(), bytesRead));
+	EXPECT_EQ(bytesRead, input.size());
+	EXPECT_EQ(outputData, input);
+	output.reset();
+
+	DeleteFile(outputFile.c_str());
+	DeleteFile(options.manifestPath.c_str());
+	DeleteFile(inputFile.c_str());
+
+	for (const auto &part : parts)
+	{
+		DeleteFile(part.c_str());
+	}
+}
+
+// Large files are read without buffering. The last read from such a file
+// will return less than was requested, which shouldn't cause the split to
+// fail.
+TEST(FileSplitter, UnbufferedInput)
+{
+	TCHAR tempPath[MAX_PATH];
+	ASSERT_NE(GetTempPath(MAX_PATH, tempPath), 0U);
+
+	std::wstring inputFile = std::wstring(tempPath) + L"TestFileSplitter.unbuffered";
+	FileData input = GenerateData((SMALL_BUFFER_SIZE * 5) + 1001);
+
+	HANDLE file = CreateFile(inputFile.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	ASSERT_NE(file, INVALID_HANDLE_VALUE);
+
+	DWORD bytesWritten;
+	BOOL res = WriteFile(file, input.data(), static_cast<DWORD>(input.size()), &bytesWritten, nullptr);
+	CloseHandle(file);
+	ASSERT_TRUE(res);
+
+	MemoryFileSystem fileSystem;
+	FileSplitter splitter(inputFile, SMALL_BUFFER_SIZE * 2, GetPartPath, GetSmallBufferOptions(),
+		OpenUnbufferedFileMergeInput, fileSystem.GetCreateOutput());
+	auto result = splitter.Split(nullptr);
+
+	DeleteFile(inputFile.c_str());
+
+	ASSERT_EQ(result, FileSplitter::Result::Succeeded);
+
+	FileData merged;
+
+	for (std::uint64_t i = 1; i <= 3; i++)
+	{
+		const FileData *part = fileSystem.GetFile(GetPartPath(i));
+		ASSERT_NE(part, nullptr);
+
+		merged.insert(merged.end(), part->begin(), part->end());
+	}
+
+	EXPECT_EQ(fileSystem.GetFile(GetPartPath(4)), nullptr);
+	EXPECT_EQ(merged, input);
+}
+
+namespace
+{
+	// Generates data as it's read, so that a large file doesn't need to be
+	// stored.
+	class SyntheticInput : public FileMergeInput
+	{
+	public:
+
+		SyntheticInput(std::uint64_t size) :
+			m_size(size),
+			m_position(0)
+		{
+		}
+
+		std::uint64_t GetSize() const override
+		{
+			return m_size;
+		}
+
+		bool Read(void *buffer, std::size_t size, std::size_t &bytesRead) override
+		{
+			bytesRead = static_cast<std::size_t>((std::min)(static_cast<std::uint64_t>(size), m_size - m_position));
+			memset(buffer, static_cast<int>((m_position / size) % 251), bytesRead);
+			m_position += bytesRead;
+			return true;
+		}
+
+	private:
+
+		const std::uint64_t m_size;
+		std::uint64_t m_position;
+	};
+
+	// Discards everything that's written to it.
+	class NullOutput : public FileMergeOutput
+	{
+	public:
+
+		bool Write(const void *buffer, std::size_t size) override
+		{
+			UNREFERENCED_PARAMETER(buffer);
+			UNREFERENCED_PARAMETER(size);
+
+			return true;
+		}
+	};
+}
+
+// Splits a synthetic file of just over 4GB using part sizes ranging from
+// 1MB to 4GB. The amount of buffer memory used is the same in each case.
+// This takes a long time to run, so it's disabled by default.
+TEST(FileSplitter, DISABLED_LargeFile)
+{
+	const std::uint64_t MB = 1024 * 1024;
+	const std::uint64_t GB = 1024 * MB;
+	const std::uint64_t INPUT_SIZE = (4 * GB) + 123;
+	const std::uint64_t partSizes[] = { MB, 64 * MB, GB, 4 * GB };
+
+	for (std::uint64_t partSize : partSizes)
+	{
+		auto openInput = [INPUT_SIZE] (const std::wstring &path) -> std::unique_ptr<FileMergeInput> {
+			UNREFERENCED_PARAMETER(path);
+
+			return std::make_unique<SyntheticInput>(INPUT_SIZE);
+		};
+
+		auto createOutput = [] (const std::wstring &path) -> std::unique_ptr<FileMergeOutput> {
+			UNREFERENCED_PARAMETER(path);
+
+			return std::make_unique<NullOutput>();
+		};
+
+		FileSplitter splitter(INPUT_FILE, partSize, GetPartPath, FileSplitter::Options(), openInput, createOutput);
+		EXPECT_EQ(splitter.GetBufferMemorySize(),
+			FileSplitter::DEFAULT_BUFFER_SIZE * FileSplitter::DEFAULT_NUM_BUFFERS);
+
+		FileSplitter::Progress lastProgress = {};
+
+		auto result = splitter.Split([&lastProgress] (const FileSplitter::Progress &progress) {
+			lastProgress = progress;
+		});
+
+		ASSERT_EQ(result, FileSplitter::Result::Succeeded);
+		EXPECT_EQ(lastProgress.bytesWritten, INPUT_SIZE);
+		EXPECT_EQ(lastProgress.partsWritten, (INPUT_SIZE + partSize - 1) / partSize);
+	}
+}
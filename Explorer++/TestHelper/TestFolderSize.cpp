@@ -6,6 +6,8 @@
 #include "../Helper/FolderSize.h"
 #include "../Helper/Macros.h"
 #include "Helper.h"
+#include <algorithm>
+#include <future>
 
 void TestCalculateFolderSize(const TCHAR *szFolder, int nFoldersExpected,
 	int nFilesExpected, ULARGE_INTEGER ulTotalFolderSizeExpected)
@@ -83,4 +85,357 @@ TEST(CalculateFolderSize, FilesAndFolders)
 	ULARGE_INTEGER ulTotalFolderSizeExpected;
 	ulTotalFolderSizeExpected.QuadPart = 18432;
 	TestCalculateFolderSize(L"FolderSize", 2, 6, ulTotalFolderSizeExpected);
-}
\ No newline at end of file
+}
+
+namespace
+{
+	const int GENERATED_TREE_DEPTH = 4;
+	const int GENERATED_TREE_BRANCHING = 5;
+	const int GENERATED_TREE_FILES_PER_FOLDER = 10;
+	const int GENERATED_TREE_FILE_SIZE = 1024;
+
+	// Generates the contents of a folder in a tree that only exists in
+	// memory. Folders whose names end in an odd digit have one fewer
+	// subfolder than the others and deeper folders contain more files, so
+	// that the tree isn't perfectly balanced.
+	bool EnumerateGeneratedFolder(const std::wstring &path, FolderContents &contents)
+	{
+		auto depth = std::count(path.begin(), path.end(), '\\');
+
+		if (depth < GENERATED_TREE_DEPTH)
+		{
+			int numSubfolders = GENERATED_TREE_BRANCHING - static_cast<int>(path.back() - '0') % 2;
+
+			for (int i = 0; i < numSubfolders; i++)
+			{
+				contents.subfolders.push_back(path + L"\\" + std::to_wstring(i));
+			}
+
+			contents.numFolders = numSubfolders;
+		}
+
+		contents.numFiles = GENERATED_TREE_FILES_PER_FOLDER + static_cast<int>(depth);
+		contents.size = static_cast<ULONGLONG>(contents.numFiles) * GENERATED_TREE_FILE_SIZE;
+
+		return true;
+	}
+
+	// Walks the generated tree serially, so that the results of the
+	// calculator can be checked.
+	FolderSizeCalculator::Totals GetExpectedTotals(const std::wstring &path)
+	{
+		FolderSizeCalculator::Totals totals;
+
+		FolderContents contents;
+		EnumerateGeneratedFolder(path, contents);
+
+		totals.numFolders = contents.numFolders;
+		totals.numFiles = contents.numFiles;
+		totals.size = contents.size;
+
+		for (const auto &subfolder : contents.subfolders)
+		{
+			auto subfolderTotals = GetExpectedTotals(subfolder);
+
+			totals.numFolders += subfolderTotals.numFolders;
+			totals.numFiles += subfolderTotals.numFiles;
+			totals.size += subfolderTotals.size;
+		}
+
+		return totals;
+	}
+
+	void ExpectTotalsEqual(const FolderSizeCalculator::Totals &expected,
+		const FolderSizeCalculator::Totals &actual)
+	{
+		EXPECT_EQ(expected.numFolders, actual.numFolders);
+		EXPECT_EQ(expected.numFiles, actual.numFiles);
+		EXPECT_EQ(expected.size, actual.size);
+	}
+}
+
+TEST(FolderSizeCalculator, ResourceFolder)
+{
+	TCHAR szFullFileName[MAX_PATH];
+	GetTestResourceFilePath(L"FolderSize", szFullFileName, SIZEOF_ARRAY(szFullFileName));
+
+	FolderSizeCalculator calculator(FolderSizeCalculator::GetDefaultNumThreads());
+	auto totals = calculator.Calculate(szFullFileName);
+
+	EXPECT_EQ(2, totals.numFolders);
+	EXPECT_EQ(6, totals.numFiles);
+	EXPECT_EQ(18432U, totals.size);
+}
+
+TEST(FolderSizeCalculator, GeneratedTree)
+{
+	auto expectedTotals = GetExpectedTotals(L"C:\\0");
+
+	for (int numThreads = 1; numThreads <= 8; numThreads++)
+	{
+		FolderSizeCalculator calculator(numThreads, EnumerateGeneratedFolder);
+		EXPECT_EQ(numThreads, calculator.GetNumThreads());
+
+		// Each calculation is repeated, since the results should be
+		// deterministic, regardless of how the work is distributed.
+		for (int i = 0; i < 5; i++)
+		{
+			calculator.ClearCache();
+			ExpectTotalsEqual(expectedTotals, calculator.Calculate(L"C:\\0"));
+		}
+	}
+}
+
+TEST(FolderSizeCalculator, ConcurrentCalculations)
+{
+	FolderSizeCalculator calculator(4, EnumerateGeneratedFolder);
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	int numCompleted = 0;
+	std::vector<FolderSizeCalculator::Totals> results(GENERATED_TREE_BRANCHING);
+
+	for (int i = 0; i < GENERATED_TREE_BRANCHING; i++)
+	{
+		calculator.StartCalculation(L"C:\\0\\" + std::to_wstring(i), nullptr,
+			[&, i] (const FolderSizeCalculator::Totals &totals, bool cancelled) {
+			EXPECT_FALSE(cancelled);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			results[i] = totals;
+			numCompleted++;
+			condition.notify_one();
+		});
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [&] {
+		return numCompleted == GENERATED_TREE_BRANCHING;
+	});
+
+	for (int i = 0; i < GENERATED_TREE_BRANCHING; i++)
+	{
+		ExpectTotalsEqual(GetExpectedTotals(L"C:\\0\\" + std::to_wstring(i)), results[i]);
+	}
+}
+
+TEST(FolderSizeCalculator, Progress)
+{
+	// The calculation needs to take long enough for several progress
+	// updates to be sent.
+	auto slowEnumerate = [] (const std::wstring &path, FolderContents &contents) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		return EnumerateGeneratedFolder(path, contents);
+	};
+
+	FolderSizeCalculator calculator(1, slowEnumerate);
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<FolderSizeCalculator::Totals> progressUpdates;
+	boost::optional<FolderSizeCalculator::Totals> finalTotals;
+
+	calculator.StartCalculation(L"C:\\0",
+		[&] (const FolderSizeCalculator::Totals &partialTotals) {
+		std::lock_guard<std::mutex> lock(mutex);
+		EXPECT_FALSE(finalTotals);
+		progressUpdates.push_back(partialTotals);
+	},
+		[&] (const FolderSizeCalculator::Totals &totals, bool cancelled) {
+		EXPECT_FALSE(cancelled);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		finalTotals = totals;
+		condition.notify_one();
+	});
+
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [&] {
+		return finalTotals.is_initialized();
+	});
+
+	ExpectTotalsEqual(GetExpectedTotals(L"C:\\0"), *finalTotals);
+
+	// The partial totals should only ever increase and should never
+	// exceed the final totals.
+	EXPECT_FALSE(progressUpdates.empty());
+
+	ULONGLONG previousSize = 0;
+
+	for (const auto &partialTotals : progressUpdates)
+	{
+		EXPECT_GE(partialTotals.size, previousSize);
+		EXPECT_LE(partialTotals.size, finalTotals->size);
+		previousSize = partialTotals.size;
+	}
+}
+
+TEST(FolderSizeCalculator, Cancellation)
+{
+	std::atomic<int> numEnumerations = 0;
+
+	auto slowEnumerate = [&numEnumerations] (const std::wstring &path, FolderContents &contents) {
+		numEnumerations++;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return EnumerateGeneratedFolder(path, contents);
+	};
+
+	FolderSizeCalculator calculator(2, slowEnumerate);
+
+	std::promise<std::pair<FolderSizeCalculator::Totals, bool>> promise;
+
+	int calculationId = calculator.StartCalculation(L"C:\\0", nullptr,
+		[&promise] (const FolderSizeCalculator::Totals &totals, bool cancelled) {
+		promise.set_value({ totals, cancelled });
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	calculator.CancelCalculation(calculationId);
+
+	auto result = promise.get_future().get();
+	auto expectedTotals = GetExpectedTotals(L"C:\\0");
+
+	EXPECT_TRUE(result.second);
+	EXPECT_LT(result.first.size, expectedTotals.size);
+	EXPECT_LT(numEnumerations, expectedTotals.numFolders + 1);
+
+	// Nothing from the cancelled calculation should have been cached for
+	// the root folder.
+	EXPECT_FALSE(calculator.GetCachedTotals(L"C:\\0"));
+
+	// Cancelling a calculation that has already finished should have no
+	// effect.
+	calculator.CancelCalculation(calculationId);
+	ExpectTotalsEqual(expectedTotals, calculator.Calculate(L"C:\\0"));
+}
+
+TEST(FolderSizeCalculator, CachedTotals)
+{
+	std::atomic<int> numEnumerations = 0;
+
+	auto countingEnumerate = [&numEnumerations] (const std::wstring &path, FolderContents &contents) {
+		numEnumerations++;
+		return EnumerateGeneratedFolder(path, contents);
+	};
+
+	// The generated folders don't exist, so they're all given the same
+	// last write time.
+	auto getLastWriteTime = [] (const std::wstring &path) {
+		UNREFERENCED_PARAMETER(path);
+
+		return boost::optional<ULONGLONG>(0);
+	};
+
+	FolderSizeCalculator calculator(4, countingEnumerate, getLastWriteTime);
+
+	auto expectedTotals = GetExpectedTotals(L"C:\\0");
+	ExpectTotalsEqual(expectedTotals, calculator.Calculate(L"C:\\0"));
+	EXPECT_EQ(expectedTotals.numFolders + 1, numEnumerations);
+
+	// The totals for the folder, as well as each folder beneath it,
+	// should now be available without any further enumeration.
+	numEnumerations = 0;
+	ExpectTotalsEqual(expectedTotals, calculator.Calculate(L"C:\\0"));
+	ExpectTotalsEqual(GetExpectedTotals(L"C:\\0\\1\\2"), calculator.Calculate(L"C:\\0\\1\\2"));
+	EXPECT_EQ(0, numEnumerations);
+
+	auto cachedTotals = calculator.GetCachedTotals(L"C:\\0\\3");
+	ASSERT_TRUE(cachedTotals);
+	ExpectTotalsEqual(GetExpectedTotals(L"C:\\0\\3"), *cachedTotals);
+
+	// Invalidating a folder should invalidate its parents and children,
+	// but should leave its siblings alone.
+	calculator.InvalidateCachedTotals(L"C:\\0\\1");
+	EXPECT_FALSE(calculator.GetCachedTotals(L"C:\\0"));
+	EXPECT_FALSE(calculator.GetCachedTotals(L"C:\\0\\1"));
+	EXPECT_FALSE(calculator.GetCachedTotals(L"C:\\0\\1\\2"));
+	EXPECT_TRUE(calculator.GetCachedTotals(L"C:\\0\\2"));
+
+	// Only the invalidated folders should be enumerated again.
+	auto expectedEnumerations = GetExpectedTotals(L"C:\\0\\1").numFolders + 2;
+	ExpectTotalsEqual(expectedTotals, calculator.Calculate(L"C:\\0"));
+	EXPECT_EQ(expectedEnumerations, numEnumerations);
+}
+
+TEST(FolderSizeCalculator, CachedTotalsCaseInsensitive)
+{
+	auto getLastWriteTime = [] (const std::wstring &path) {
+		UNREFERENCED_PARAMETER(path);
+
+		return boost::optional<ULONGLONG>(0);
+	};
+
+	FolderSizeCalculator calculator(2, EnumerateGeneratedFolder, getLastWriteTime);
+	calculator.Calculate(L"C:\\0");
+
+	auto cachedTotals = calculator.GetCachedTotals(L"c:\\0\\3");
+	ASSERT_TRUE(cachedTotals);
+	ExpectTotalsEqual(GetExpectedTotals(L"C:\\0\\3"), *cachedTotals);
+
+	calculator.InvalidateCachedTotals(L"c:\\0\\1");
+	EXPECT_FALSE(calculator.GetCachedTotals(L"C:\\0"));
+	EXPECT_FALSE(calculator.GetCachedTotals(L"C:\\0\\1\\2"));
+	EXPECT_TRUE(calculator.GetCachedTotals(L"C:\\0\\2"));
+}
+
+// Cached totals shouldn't be used once a folder's last write time has
+// changed.
+TEST(FolderSizeCalculator, CachedTotalsModified)
+{
+	std::atomic<int> numEnumerations = 0;
+
+	auto countingEnumerate = [&numEnumerations] (const std::wstring &path, FolderContents &contents) {
+		numEnumerations++;
+		return EnumerateGeneratedFolder(path, contents);
+	};
+
+	std::mutex mutex;
+	std::map<std::wstring, ULONGLONG> lastWriteTimes;
+
+	auto getLastWriteTime = [&mutex, &lastWriteTimes] (const std::wstring &path) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto itr = lastWriteTimes.find(path);
+		return boost::optional<ULONGLONG>(itr != lastWriteTimes.end() ? itr->second : 0);
+	};
+
+	FolderSizeCalculator calculator(4, countingEnumerate, getLastWriteTime);
+	calculator.Calculate(L"C:\\0");
+	EXPECT_TRUE(calculator.GetCachedTotals(L"C:\\0\\1"));
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		lastWriteTimes[L"C:\\0\\1"] = 1;
+	}
+
+	EXPECT_FALSE(calculator.GetCachedTotals(L"C:\\0\\1"));
+	EXPECT_TRUE(calculator.GetCachedTotals(L"C:\\0\\1\\2"));
+
+	// Only the modified folder itself should need to be enumerated again,
+	// since the totals for its subfolders are still valid.
+	numEnumerations = 0;
+	ExpectTotalsEqual(GetExpectedTotals(L"C:\\0\\1"), calculator.Calculate(L"C:\\0\\1"));
+	EXPECT_EQ(1, numEnumerations);
+	EXPECT_TRUE(calculator.GetCachedTotals(L"C:\\0\\1"));
+}
+
+// The totals shouldn't depend on how the work is split between the
+// threads. Each enumeration is given a small delay, so that workers will
+// end up stealing tasks from each other.
+TEST(FolderSizeCalculator, NumThreads)
+{
+	auto slowEnumerate = [] (const std::wstring &path, FolderContents &contents) {
+		std::this_thread::sleep_for(std::chrono::microseconds(20));
+		return EnumerateGeneratedFolder(path, contents);
+	};
+
+	auto expectedTotals = GetExpectedTotals(L"C:\\0");
+	int maxThreads = (std::max)(4, FolderSizeCalculator::GetDefaultNumThreads());
+
+	for (int numThreads = 1; numThreads <= maxThreads; numThreads++)
+	{
+		FolderSizeCalculator calculator(numThreads, slowEnumerate);
+		EXPECT_EQ(numThreads, calculator.GetNumThreads());
+		ExpectTotalsEqual(expectedTotals, calculator.Calculate(L"C:\\0"));
+	}
+}
@@ -0,0 +1,345 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/ImageHeader.h"
+#include "../Helper/Macros.h"
+#include "Helper.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<BYTE>;
+
+	void Append(Bytes &data, const Bytes &bytes)
+	{
+		data.insert(data.end(), bytes.begin(), bytes.end());
+	}
+
+	void AppendString(Bytes &data, const char *str, size_t length)
+	{
+		data.insert(data.end(), str, str + length);
+	}
+
+	void AppendBigEndian16(Bytes &data, UINT value)
+	{
+		Append(data, { static_cast<BYTE>(value >> 8), static_cast<BYTE>(value) });
+	}
+
+	void AppendBigEndian32(Bytes &data, UINT value)
+	{
+		AppendBigEndian16(data, value >> 16);
+		AppendBigEndian16(data, value & 0xFFFF);
+	}
+
+	void AppendLittleEndian16(Bytes &data, UINT value)
+	{
+		Append(data, { static_cast<BYTE>(value), static_cast<BYTE>(value >> 8) });
+	}
+
+	void AppendLittleEndian32(Bytes &data, UINT value)
+	{
+		AppendLittleEndian16(data, value & 0xFFFF);
+		AppendLittleEndian16(data, value >> 16);
+	}
+
+	void AppendPngChunk(Bytes &data, const char *type, const Bytes &chunkData)
+	{
+		AppendBigEndian32(data, static_cast<UINT>(chunkData.size()));
+		AppendString(data, type, 4);
+		Append(data, chunkData);
+
+		// The CRC isn't checked.
+		AppendBigEndian32(data, 0);
+	}
+
+	Bytes BuildPng(UINT width, UINT height, BYTE bitDepth, BYTE colorType, bool includeResolution)
+	{
+		Bytes data = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+		Bytes header;
+		AppendBigEndian32(header, width);
+		AppendBigEndian32(header, height);
+		Append(header, { bitDepth, colorType, 0, 0, 0 });
+		AppendPngChunk(data, "IHDR", header);
+
+		AppendPngChunk(data, "tEXt", { 'a', 0, 'b' });
+
+		if (includeResolution)
+		{
+			// 3780 pixels per meter is (approximately) 96 dpi.
+			Bytes physicalDimensions;
+			AppendBigEndian32(physicalDimensions, 3780);
+			AppendBigEndian32(physicalDimensions, 7560);
+			physicalDimensions.push_back(1);
+			AppendPngChunk(data, "pHYs", physicalDimensions);
+		}
+
+		AppendPngChunk(data, "IDAT", { 0, 0, 0, 0 });
+		AppendPngChunk(data, "IEND", {});
+
+		return data;
+	}
+
+	void AppendJpegSegment(Bytes &data, BYTE marker, const Bytes &segmentData)
+	{
+		Append(data, { 0xFF, marker });
+		AppendBigEndian16(data, static_cast<UINT>(segmentData.size() + 2));
+		Append(data, segmentData);
+	}
+
+	Bytes BuildJpeg(BYTE frameMarker, UINT width, UINT height, BYTE densityUnits)
+	{
+		Bytes data = { 0xFF, 0xD8 };
+
+		Bytes jfifHeader;
+		AppendString(jfifHeader, "JFIF", 5);
+		Append(jfifHeader, { 1, 2, densityUnits });
+		AppendBigEndian16(jfifHeader, 72);
+		AppendBigEndian16(jfifHeader, 150);
+		Append(jfifHeader, { 0, 0 });
+		AppendJpegSegment(data, 0xE0, jfifHeader);
+
+		// An Exif segment, which should be skipped over.
+		AppendJpegSegment(data, 0xE1, Bytes(1000, 0xAB));
+
+		// Fill bytes, followed by a quantization table.
+		Append(data, { 0xFF, 0xFF });
+		AppendJpegSegment(data, 0xDB, Bytes(65, 0));
+
+		Bytes frameHeader = { 8 };
+		AppendBigEndian16(frameHeader, height);
+		AppendBigEndian16(frameHeader, width);
+		Append(frameHeader, { 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 });
+		AppendJpegSegment(data, frameMarker, frameHeader);
+
+		AppendJpegSegment(data, 0xDA, Bytes(10, 0));
+		Append(data, { 0x12, 0x34, 0xFF, 0xD9 });
+
+		return data;
+	}
+
+	Bytes BuildBmp(LONG width, LONG height, UINT bitDepth, LONG pixelsPerMeter)
+	{
+		Bytes data = { 'B', 'M' };
+		AppendLittleEndian32(data, 0);
+		AppendLittleEndian32(data, 0);
+		AppendLittleEndian32(data, 54);
+
+		AppendLittleEndian32(data, 40);
+		AppendLittleEndian32(data, static_cast<UINT>(width));
+		AppendLittleEndian32(data, static_cast<UINT>(height));
+		AppendLittleEndian16(data, 1);
+		AppendLittleEndian16(data, bitDepth);
+		AppendLittleEndian32(data, BI_RGB);
+		AppendLittleEndian32(data, 0);
+		AppendLittleEndian32(data, static_cast<UINT>(pixelsPerMeter));
+		AppendLittleEndian32(data, static_cast<UINT>(pixelsPerMeter));
+		AppendLittleEndian32(data, 0);
+		AppendLittleEndian32(data, 0);
+
+		return data;
+	}
+
+	// Tracks how much of the data is read, so that the tests can check
+	// that only the header is examined.
+	class MemoryReader
+	{
+	public:
+
+		MemoryReader(const Bytes &data) :
+			m_data(data),
+			m_bytesRead(0)
+		{
+
+		}
+
+		bool Parse(ImageHeaderInfo &info)
+		{
+			return ParseImageHeader([this] (ULONGLONG offset, void *buffer, size_t size) {
+				if (offset > m_data.size() || size > m_data.size() - offset)
+				{
+					return false;
+				}
+
+				memcpy(buffer, m_data.data() + offset, size);
+				m_bytesRead += size;
+
+				return true;
+			}, info);
+		}
+
+		size_t GetBytesRead() const
+		{
+			return m_bytesRead;
+		}
+
+	private:
+
+		const Bytes &m_data;
+		size_t m_bytesRead;
+	};
+
+	bool Parse(const Bytes &data, ImageHeaderInfo &info)
+	{
+		MemoryReader reader(data);
+		return reader.Parse(info);
+	}
+}
+
+TEST(ImageHeader, Png)
+{
+	ImageHeaderInfo info;
+	ASSERT_TRUE(Parse(BuildPng(640, 480, 8, 6, true), info));
+
+	EXPECT_EQ(info.width, 640U);
+	EXPECT_EQ(info.height, 480U);
+	EXPECT_EQ(info.bitDepth, 32U);
+
+	ASSERT_TRUE(info.horizontalResolution);
+	ASSERT_TRUE(info.verticalResolution);
+	EXPECT_NEAR(*info.horizontalResolution, 96.0, 0.05);
+	EXPECT_NEAR(*info.verticalResolution, 192.0, 0.05);
+
+	ASSERT_TRUE(Parse(BuildPng(1, 70000, 4, 3, false), info));
+
+	EXPECT_EQ(info.width, 1U);
+	EXPECT_EQ(info.height, 70000U);
+	EXPECT_EQ(info.bitDepth, 4U);
+	EXPECT_FALSE(info.horizontalResolution);
+	EXPECT_FALSE(info.verticalResolution);
+
+	ASSERT_TRUE(Parse(BuildPng(10, 10, 16, 2, false), info));
+	EXPECT_EQ(info.bitDepth, 48U);
+}
+
+TEST(ImageHeader, Jpeg)
+{
+	ImageHeaderInfo info;
+	ASSERT_TRUE(Parse(BuildJpeg(0xC0, 4000, 3000, 1), info));
+
+	EXPECT_EQ(info.width, 4000U);
+	EXPECT_EQ(info.height, 3000U);
+	EXPECT_EQ(info.bitDepth, 24U);
+
+	ASSERT_TRUE(info.horizontalResolution);
+	ASSERT_TRUE(info.verticalResolution);
+	EXPECT_DOUBLE_EQ(*info.horizontalResolution, 72.0);
+	EXPECT_DOUBLE_EQ(*info.verticalResolution, 150.0);
+
+	// Progressive, with the density given in dots per centimeter.
+	ASSERT_TRUE(Parse(BuildJpeg(0xC2, 20, 30, 2), info));
+
+	EXPECT_EQ(info.width, 20U);
+	EXPECT_EQ(info.height, 30U);
+	ASSERT_TRUE(info.horizontalResolution);
+	EXPECT_DOUBLE_EQ(*info.horizontalResolution, 72.0 * 2.54);
+
+	// Only the aspect ratio is given.
+	ASSERT_TRUE(Parse(BuildJpeg(0xC1, 20, 30, 0), info));
+	EXPECT_FALSE(info.horizontalResolution);
+	EXPECT_FALSE(info.verticalResolution);
+}
+
+TEST(ImageHeader, JpegWithoutFrame)
+{
+	Bytes data = { 0xFF, 0xD8 };
+	AppendJpegSegment(data, 0xDB, Bytes(65, 0));
+	AppendJpegSegment(data, 0xDA, Bytes(10, 0));
+	Append(data, { 0xFF, 0xD9 });
+
+	ImageHeaderInfo info;
+	EXPECT_FALSE(Parse(data, info));
+}
+
+TEST(ImageHeader, Gif)
+{
+	Bytes data;
+	AppendString(data, "GIF89a", 6);
+	AppendLittleEndian16(data, 300);
+	AppendLittleEndian16(data, 200);
+	Append(data, { 0xF7, 0, 0 });
+
+	ImageHeaderInfo info;
+	ASSERT_TRUE(Parse(data, info));
+
+	EXPECT_EQ(info.width, 300U);
+	EXPECT_EQ(info.height, 200U);
+	EXPECT_EQ(info.bitDepth, 8U);
+	EXPECT_FALSE(info.horizontalResolution);
+}
+
+TEST(ImageHeader, Bmp)
+{
+	ImageHeaderInfo info;
+
+	// Top-down.
+	ASSERT_TRUE(Parse(BuildBmp(123, -456, 24, 2835), info));
+
+	EXPECT_EQ(info.width, 123U);
+	EXPECT_EQ(info.height, 456U);
+	EXPECT_EQ(info.bitDepth, 24U);
+
+	ASSERT_TRUE(info.horizontalResolution);
+	EXPECT_NEAR(*info.horizontalResolution, 72.0, 0.01);
+
+	ASSERT_TRUE(Parse(BuildBmp(1, 1, 1, 0), info));
+	EXPECT_EQ(info.bitDepth, 1U);
+	EXPECT_FALSE(info.horizontalResolution);
+
+	EXPECT_FALSE(Parse(BuildBmp(0, 1, 24, 0), info));
+}
+
+TEST(ImageHeader, Invalid)
+{
+	ImageHeaderInfo info;
+
+	EXPECT_FALSE(Parse({}, info));
+
+	// TIFF isn't supported.
+	EXPECT_FALSE(Parse({ 'I', 'I', 42, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, info));
+
+	// Truncated.
+	Bytes png = BuildPng(10, 10, 8, 2, false);
+	png.resize(20);
+	EXPECT_FALSE(Parse(png, info));
+
+	Bytes jpeg = BuildJpeg(0xC0, 10, 10, 1);
+	jpeg.resize(200);
+	EXPECT_FALSE(Parse(jpeg, info));
+
+	// Invalid color type.
+	EXPECT_FALSE(Parse(BuildPng(10, 10, 8, 5, false), info));
+}
+
+TEST(ImageHeader, OnlyHeaderRead)
+{
+	Bytes jpeg = BuildJpeg(0xC0, 10, 10, 1);
+	jpeg.insert(jpeg.end() - 2, 1024 * 1024, 0);
+
+	MemoryReader reader(jpeg);
+	ImageHeaderInfo info;
+	ASSERT_TRUE(reader.Parse(info));
+
+	EXPECT_LT(reader.GetBytesRead(), 128U);
+}
+
+TEST(ImageHeader, File)
+{
+	TCHAR path[MAX_PATH];
+	GetTestResourceFilePath(L"Metadata.jpg", path, SIZEOF_ARRAY(path));
+
+	ImageHeaderInfo info;
+	ASSERT_TRUE(ReadImageHeader(path, info));
+
+	EXPECT_EQ(info.width, 10U);
+	EXPECT_EQ(info.height, 10U);
+	EXPECT_EQ(info.bitDepth, 24U);
+
+	ASSERT_TRUE(info.horizontalResolution);
+	EXPECT_DOUBLE_EQ(*info.horizontalResolution, 96.0);
+
+	EXPECT_FALSE(ReadImageHeader(L"C:\\Nonexistent\\Nonexistent.jpg", info));
+}
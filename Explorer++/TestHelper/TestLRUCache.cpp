@@ -0,0 +1,87 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/LRUCache.h"
+#include <memory>
+#include <string>
+
+TEST(LRUCache, GetAndSet)
+{
+	LRUCache<std::wstring, int> cache(10);
+
+	EXPECT_FALSE(cache.Get(L"a"));
+
+	cache.Set(L"a", 1);
+	cache.Set(L"b", 2);
+
+	ASSERT_TRUE(cache.Get(L"a"));
+	EXPECT_EQ(*cache.Get(L"a"), 1);
+	ASSERT_TRUE(cache.Get(L"b"));
+	EXPECT_EQ(*cache.Get(L"b"), 2);
+
+	cache.Set(L"a", 3);
+	EXPECT_EQ(*cache.Get(L"a"), 3);
+	EXPECT_EQ(cache.GetNumEntries(), 2U);
+
+	cache.Remove(L"a");
+	EXPECT_FALSE(cache.Get(L"a"));
+	EXPECT_EQ(cache.GetNumEntries(), 1U);
+
+	cache.Clear();
+	EXPECT_FALSE(cache.Get(L"b"));
+	EXPECT_EQ(cache.GetNumEntries(), 0U);
+}
+
+TEST(LRUCache, Eviction)
+{
+	LRUCache<int, int> cache(3);
+
+	cache.Set(1, 1);
+	cache.Set(2, 2);
+	cache.Set(3, 3);
+
+	// Looking up an entry makes it the most recently used.
+	EXPECT_TRUE(cache.Get(1));
+
+	cache.Set(4, 4);
+
+	EXPECT_EQ(cache.GetNumEntries(), 3U);
+	EXPECT_FALSE(cache.Get(2));
+	EXPECT_TRUE(cache.Get(1));
+	EXPECT_TRUE(cache.Get(3));
+	EXPECT_TRUE(cache.Get(4));
+
+	// As does updating it.
+	cache.Set(1, 10);
+	cache.Set(5, 5);
+	cache.Set(6, 6);
+
+	EXPECT_FALSE(cache.Get(3));
+	EXPECT_FALSE(cache.Get(4));
+	ASSERT_TRUE(cache.Get(1));
+	EXPECT_EQ(*cache.Get(1), 10);
+}
+
+TEST(LRUCache, SharedValues)
+{
+	LRUCache<int, std::shared_ptr<int>> cache(1);
+
+	auto value = std::make_shared<int>(1);
+	cache.Set(1, value);
+	EXPECT_EQ(value.use_count(), 2);
+
+	auto cachedValue = cache.Get(1);
+	ASSERT_TRUE(cachedValue);
+	EXPECT_EQ(cachedValue->get(), value.get());
+
+	cachedValue.reset();
+	cache.Set(2, nullptr);
+	EXPECT_EQ(value.use_count(), 1);
+
+	// An empty value is still a cached value.
+	cachedValue = cache.Get(2);
+	ASSERT_TRUE(cachedValue);
+	EXPECT_EQ(*cachedValue, nullptr);
+}
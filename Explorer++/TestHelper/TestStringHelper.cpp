@@ -5,6 +5,131 @@
 #include "stdafx.h"
 #include "../Helper/StringHelper.h"
 #include "../Helper/Macros.h"
+#include <random>
+
+namespace
+{
+	/* The original (recursive) implementation of CheckWildcardMatch.
+	WildcardPattern is expected to give exactly the same results. */
+	BOOL ReferenceWildcardMatch(const TCHAR *szWildcard, const TCHAR *szString, BOOL bCaseSensitive);
+
+	BOOL ReferenceWildcardMatchInternal(const TCHAR *szWildcard, const TCHAR *szString, BOOL bCaseSensitive)
+	{
+		BOOL bMatched;
+		BOOL bCurrentMatch = TRUE;
+
+		while(*szWildcard != '\0' && *szString != '\0' && bCurrentMatch)
+		{
+			switch(*szWildcard)
+			{
+			case '*':
+				bMatched = FALSE;
+
+				if(*(szWildcard + 1) != '\0')
+				{
+					bMatched = ReferenceWildcardMatch(++szWildcard, szString, bCaseSensitive);
+				}
+
+				while(*szWildcard != '\0' && *szString != '\0' && !bMatched)
+				{
+					bMatched = ReferenceWildcardMatch(szWildcard, ++szString, bCaseSensitive);
+				}
+
+				if(bMatched)
+				{
+					while(*szWildcard != '\0')
+						szWildcard++;
+
+					szWildcard--;
+
+					while(*szString != '\0')
+						szString++;
+				}
+
+				bCurrentMatch = bMatched;
+				break;
+
+			case '?':
+				szString++;
+				break;
+
+			default:
+				if(bCaseSensitive)
+				{
+					bCurrentMatch = (*szWildcard == *szString);
+				}
+				else
+				{
+					TCHAR szCharacter1[1];
+					LCMapString(LOCALE_USER_DEFAULT, LCMAP_LOWERCASE, szWildcard, 1, szCharacter1, SIZEOF_ARRAY(szCharacter1));
+
+					TCHAR szCharacter2[1];
+					LCMapString(LOCALE_USER_DEFAULT, LCMAP_LOWERCASE, szString, 1, szCharacter2, SIZEOF_ARRAY(szCharacter2));
+
+					bCurrentMatch = (szCharacter1[0] == szCharacter2[0]);
+				}
+
+				szString++;
+				break;
+			}
+
+			szWildcard++;
+		}
+
+		while(*szWildcard == '*')
+			szWildcard++;
+
+		if(*szWildcard == '\0' && *szString == '\0' && bCurrentMatch)
+			return TRUE;
+
+		return FALSE;
+	}
+
+	BOOL ReferenceWildcardMatch(const TCHAR *szWildcard, const TCHAR *szString, BOOL bCaseSensitive)
+	{
+		if(StrChr(szWildcard, ':') == NULL)
+		{
+			return ReferenceWildcardMatchInternal(szWildcard, szString, bCaseSensitive);
+		}
+
+		TCHAR szWildcardPattern[512];
+		TCHAR *szRemainingPattern = NULL;
+
+		StringCchCopy(szWildcardPattern, SIZEOF_ARRAY(szWildcardPattern), szWildcard);
+
+		TCHAR *szSinglePattern = wcstok_s(szWildcardPattern, _T(":"), &szRemainingPattern);
+
+		while(szSinglePattern != NULL)
+		{
+			PathRemoveBlanks(szSinglePattern);
+
+			if(ReferenceWildcardMatchInternal(szSinglePattern, szString, bCaseSensitive))
+			{
+				return TRUE;
+			}
+
+			szSinglePattern = wcstok_s(NULL, _T(":"), &szRemainingPattern);
+		}
+
+		return FALSE;
+	}
+
+	std::wstring GenerateString(std::mt19937 &generator, const std::wstring &characters, int maxLength)
+	{
+		std::uniform_int_distribution<int> lengthDistribution(0, maxLength);
+		std::uniform_int_distribution<std::size_t> characterDistribution(0, characters.size() - 1);
+
+		std::wstring str;
+		int length = lengthDistribution(generator);
+
+		for(int i = 0; i < length; i++)
+		{
+			str += characters[characterDistribution(generator)];
+		}
+
+		return str;
+	}
+}
 
 TEST(CheckWildcardMatch, SimpleMatches)
 {
@@ -33,6 +158,86 @@ TEST(CheckWildcardMatch, UnicodeMatches)
 	#pragma warning(pop)
 }
 
+TEST(CheckWildcardMatch, MultiplePatterns)
+{
+	EXPECT_EQ(TRUE, CheckWildcardMatch(_T("*.h: *.cpp"), _T("StringHelper.cpp"), TRUE));
+	EXPECT_EQ(TRUE, CheckWildcardMatch(_T("*.h: *.cpp"), _T("StringHelper.h"), TRUE));
+	EXPECT_EQ(FALSE, CheckWildcardMatch(_T("*.h: *.cpp"), _T("StringHelper.obj"), TRUE));
+	EXPECT_EQ(TRUE, CheckWildcardMatch(_T("::*.txt::"), _T("Test.txt"), TRUE));
+	EXPECT_EQ(FALSE, CheckWildcardMatch(_T(":"), _T("Test.txt"), TRUE));
+}
+
+TEST(WildcardPattern, Simple)
+{
+	WildcardPattern pattern(L"*a*a*a*b", true);
+	EXPECT_TRUE(pattern.Matches(L"aaab"));
+	EXPECT_TRUE(pattern.Matches(L"xaxaxaxb"));
+	EXPECT_FALSE(pattern.Matches(L"aab"));
+	EXPECT_FALSE(pattern.Matches(std::wstring(100, 'a')));
+
+	WildcardPattern emptyPattern(L"", true);
+	EXPECT_TRUE(emptyPattern.Matches(L""));
+	EXPECT_FALSE(emptyPattern.Matches(L"a"));
+
+	WildcardPattern questionMarkPattern(L"a?c*?", false);
+	EXPECT_TRUE(questionMarkPattern.Matches(L"ABCD"));
+	EXPECT_FALSE(questionMarkPattern.Matches(L"ABC"));
+}
+
+// Compares the results of WildcardPattern against the original
+// implementation for a large number of randomly generated patterns and
+// strings.
+TEST(WildcardPattern, MatchesReference)
+{
+	std::mt19937 generator(1);
+
+	for(int i = 0; i < 2000; i++)
+	{
+		std::wstring pattern = GenerateString(generator, L"abA.*?* :", 8);
+		bool caseSensitive = (i % 2 == 0);
+		WildcardPattern compiledPattern(pattern, caseSensitive);
+
+		for(int j = 0; j < 50; j++)
+		{
+			std::wstring str = GenerateString(generator, L"abAB. ", 10);
+
+			BOOL expected = ReferenceWildcardMatch(pattern.c_str(), str.c_str(), caseSensitive);
+			EXPECT_EQ(expected ? true : false, compiledPattern.Matches(str))
+				<< "Pattern: " << wstrToStr(pattern) << ", string: " << wstrToStr(str)
+				<< ", case sensitive: " << caseSensitive;
+		}
+	}
+}
+
+// Matches a large set of filenames against several patterns, using both
+// the original implementation and WildcardPattern.
+TEST(WildcardPattern, GeneratedNames)
+{
+	std::mt19937 generator(1);
+	std::vector<std::wstring> names;
+
+	for(int i = 0; i < 20000; i++)
+	{
+		names.push_back(GenerateString(generator, L"abcdefABCDEF_-", 24) + L".txt");
+	}
+
+	names.push_back(std::wstring(30, 'a'));
+
+	const TCHAR *patterns[] = { L"*.TXT", L"*.h: *.cpp: *.txt", L"ab*", L"*a*a*a*b" };
+
+	for(auto pattern : patterns)
+	{
+		WildcardPattern compiledPattern(pattern, false);
+
+		for(const auto &name : names)
+		{
+			BOOL expected = ReferenceWildcardMatch(pattern, name.c_str(), FALSE);
+			EXPECT_EQ(expected ? true : false, compiledPattern.Matches(name))
+				<< "Pattern: " << wstrToStr(pattern) << ", string: " << wstrToStr(name);
+		}
+	}
+}
+
 TEST(FormatSizeString, Simple)
 {
 	ULARGE_INTEGER ulSize;
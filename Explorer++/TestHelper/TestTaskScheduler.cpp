@@ -0,0 +1,330 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/TaskScheduler.h"
+#include <atomic>
+#include <chrono>
+#include <numeric>
+
+namespace
+{
+	// Blocks each of the tasks that are run until it's opened.
+	class Gate
+	{
+	public:
+
+		void Wait()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_open; });
+		}
+
+		void Open()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_open = true;
+			}
+
+			m_condition.notify_all();
+		}
+
+	private:
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_open = false;
+	};
+
+	void Spin(std::chrono::microseconds duration)
+	{
+		auto end = std::chrono::steady_clock::now() + duration;
+
+		while (std::chrono::steady_clock::now() < end)
+		{
+		}
+	}
+}
+
+TEST(TaskScheduler, Results)
+{
+	TaskScheduler scheduler(4);
+	auto queue = scheduler.CreateQueue(4);
+
+	std::vector<std::future<int>> futures;
+
+	for (int i = 0; i < 100; i++)
+	{
+		futures.push_back(queue->Push(TaskScheduler::TaskPriority::Normal, [i] {
+			return i * i;
+		}));
+	}
+
+	for (int i = 0; i < 100; i++)
+	{
+		EXPECT_EQ(futures[i].get(), i * i);
+	}
+}
+
+TEST(TaskScheduler, SerialQueue)
+{
+	TaskScheduler scheduler(4);
+	auto queue = scheduler.CreateQueue();
+
+	std::atomic<int> numRunning = 0;
+	std::atomic<int> maxRunning = 0;
+	std::vector<int> order;
+	std::vector<std::future<void>> futures;
+
+	for (int i = 0; i < 50; i++)
+	{
+		futures.push_back(queue->Push(TaskScheduler::TaskPriority::Normal, [&, i] {
+			int running = ++numRunning;
+			maxRunning = (std::max)(maxRunning.load(), running);
+
+			// Only one task runs at a time, so this doesn't need to be
+			// synchronized.
+			order.push_back(i);
+			Spin(std::chrono::microseconds(100));
+
+			numRunning--;
+		}));
+	}
+
+	for (auto &future : futures)
+	{
+		future.get();
+	}
+
+	EXPECT_EQ(maxRunning, 1);
+
+	std::vector<int> expectedOrder(50);
+	std::iota(expectedOrder.begin(), expectedOrder.end(), 0);
+	EXPECT_EQ(order, expectedOrder);
+}
+
+TEST(TaskScheduler, MaxConcurrency)
+{
+	TaskScheduler scheduler(4);
+	auto queue = scheduler.CreateQueue(2);
+
+	std::atomic<int> numRunning = 0;
+	std::atomic<int> maxRunning = 0;
+	std::vector<std::future<void>> futures;
+
+	for (int i = 0; i < 50; i++)
+	{
+		futures.push_back(queue->Push(TaskScheduler::TaskPriority::Normal, [&] {
+			int running = ++numRunning;
+			int previousMax = maxRunning.load();
+
+			while (running > previousMax && !maxRunning.compare_exchange_weak(previousMax, running))
+			{
+			}
+
+			Spin(std::chrono::microseconds(500));
+
+			numRunning--;
+		}));
+	}
+
+	for (auto &future : futures)
+	{
+		future.get();
+	}
+
+	EXPECT_LE(maxRunning, 2);
+}
+
+TEST(TaskScheduler, Priority)
+{
+	TaskScheduler scheduler(1);
+
+	auto activeQueue = scheduler.CreateQueue();
+	activeQueue->SetActive(true);
+
+	auto backgroundQueue = scheduler.CreateQueue();
+
+	// Occupies the only worker, so that the tasks below are all queued
+	// before any of them run.
+	Gate gate;
+	auto blocker = scheduler.CreateQueue();
+	auto blockerFuture = blocker->Push(TaskScheduler::TaskPriority::Visible, [&gate] {
+		gate.Wait();
+	});
+
+	std::vector<std::string> order;
+	std::vector<std::future<void>> futures;
+
+	auto push = [&order, &futures] (TaskScheduler::Queue *queue, TaskScheduler::TaskPriority priority,
+		const std::string &name) {
+		futures.push_back(queue->Push(priority, [&order, name] {
+			order.push_back(name);
+		}));
+	};
+
+	push(backgroundQueue.get(), TaskScheduler::TaskPriority::Visible, "background");
+	push(activeQueue.get(), TaskScheduler::TaskPriority::Normal, "active");
+	push(activeQueue.get(), TaskScheduler::TaskPriority::Visible, "visible");
+
+	gate.Open();
+
+	for (auto &future : futures)
+	{
+		future.get();
+	}
+
+	std::vector<std::string> expectedOrder = { "visible", "active", "background" };
+	EXPECT_EQ(order, expectedOrder);
+}
+
+TEST(TaskScheduler, Cancel)
+{
+	TaskScheduler scheduler(1);
+	auto queue = scheduler.CreateQueue();
+
+	Gate gate;
+	auto blockerFuture = queue->Push(TaskScheduler::TaskPriority::Normal, [&gate] {
+		gate.Wait();
+	});
+
+	std::atomic<int> numRun = 0;
+	std::vector<std::future<void>> futures;
+
+	for (int i = 0; i < 10; i++)
+	{
+		futures.push_back(queue->Push(TaskScheduler::TaskPriority::Normal, [&numRun] {
+			numRun++;
+		}));
+	}
+
+	queue->Cancel();
+	gate.Open();
+	blockerFuture.get();
+
+	for (auto &future : futures)
+	{
+		EXPECT_THROW(future.get(), std::future_error);
+	}
+
+	EXPECT_EQ(numRun, 0);
+
+	// The queue should still be usable after being cancelled.
+	auto future = queue->Push(TaskScheduler::TaskPriority::Normal, [] {
+		return 1;
+	});
+	EXPECT_EQ(future.get(), 1);
+}
+
+TEST(TaskScheduler, DestroyQueue)
+{
+	TaskScheduler scheduler(2);
+	auto queue = scheduler.CreateQueue();
+
+	std::atomic<bool> started = false;
+	std::atomic<bool> finished = false;
+
+	auto future = queue->Push(TaskScheduler::TaskPriority::Normal, [&started, &finished] {
+		started = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		finished = true;
+	});
+
+	while (!started)
+	{
+		std::this_thread::yield();
+	}
+
+	// Destroying the queue should wait for the running task.
+	queue.reset();
+
+	EXPECT_TRUE(finished);
+}
+
+TEST(TaskScheduler, Stealing)
+{
+	// Queues are assigned to workers in turn, so every queue here is
+	// assigned to the first worker. The second worker can only help by
+	// stealing.
+	TaskScheduler scheduler(2);
+	auto queue = scheduler.CreateQueue(2);
+	auto otherQueue = scheduler.CreateQueue();
+
+	std::atomic<int> numStarted = 0;
+	std::vector<std::future<bool>> futures;
+
+	for (int i = 0; i < 2; i++)
+	{
+		futures.push_back(queue->Push(TaskScheduler::TaskPriority::Normal, [&numStarted] {
+			numStarted++;
+
+			// Each task waits for the other to start, which will only
+			// happen if the tasks are running on different workers.
+			auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+			while (numStarted < 2)
+			{
+				if (std::chrono::steady_clock::now() > timeout)
+				{
+					return false;
+				}
+
+				std::this_thread::yield();
+			}
+
+			return true;
+		}));
+	}
+
+	for (auto &future : futures)
+	{
+		EXPECT_TRUE(future.get());
+	}
+}
+
+// Each background tab is given a backlog of work. A task in the selected
+// tab should still run well before that backlog has been worked through.
+TEST(TaskScheduler, SelectedTabWithBackgroundWork)
+{
+	const int NUM_TABS = 100;
+	const int QUEUES_PER_TAB = 4;
+	const int BACKGROUND_TASKS_PER_QUEUE = 20;
+	const int NUM_BACKGROUND_TASKS = (NUM_TABS - 1) * QUEUES_PER_TAB * BACKGROUND_TASKS_PER_QUEUE;
+
+	std::atomic<int> numBackgroundTasksRun(0);
+
+	TaskScheduler scheduler(TaskScheduler::GetDefaultNumThreads());
+	std::vector<std::unique_ptr<TaskScheduler::Queue>> queues;
+
+	for (int i = 0; i < NUM_TABS * QUEUES_PER_TAB; i++)
+	{
+		queues.push_back(scheduler.CreateQueue());
+	}
+
+	// The first tab is the selected tab.
+	for (int i = 0; i < QUEUES_PER_TAB; i++)
+	{
+		queues[i]->SetActive(true);
+	}
+
+	for (std::size_t i = QUEUES_PER_TAB; i < queues.size(); i++)
+	{
+		for (int j = 0; j < BACKGROUND_TASKS_PER_QUEUE; j++)
+		{
+			queues[i]->Push(TaskScheduler::TaskPriority::Normal, [&numBackgroundTasksRun] {
+				Spin(std::chrono::microseconds(100));
+				numBackgroundTasksRun++;
+			});
+		}
+	}
+
+	int numRunBeforeSelected = queues[0]->Push(TaskScheduler::TaskPriority::Visible, [&numBackgroundTasksRun] {
+		return numBackgroundTasksRun.load();
+	}).get();
+	EXPECT_LT(numRunBeforeSelected, NUM_BACKGROUND_TASKS);
+
+	// The queues have to be destroyed before the scheduler.
+	queues.clear();
+}
@@ -0,0 +1,449 @@
+// Copyright (C) Explorer++ Project
+// SPDX-License-Identifier: GPL-3.0-only
+// See LICENSE in the top level directory
+
+#include "stdafx.h"
+#include "../Helper/Macros.h"
+#include "../Helper/VirtualFileCopy.h"
+#include <wil/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <random>
+
+namespace
+{
+	const size_t TEST_CHUNK_SIZE = 4096;
+
+	// Generates its contents on demand, so that a large amount of data can
+	// be copied without first being held in memory. As some streams do,
+	// each read returns fewer bytes than were requested.
+	class GeneratedStream : public IStream
+	{
+	public:
+
+		GeneratedStream(ULONGLONG size, ULONG maxReadSize) :
+			m_refCount(1),
+			m_size(size),
+			m_maxReadSize(maxReadSize),
+			m_position(0)
+		{
+		}
+
+		static BYTE GetByte(ULONGLONG offset)
+		{
+			return static_cast<BYTE>((offset * 7) + (offset >> 16));
+		}
+
+		IFACEMETHODIMP QueryInterface(REFIID riid, void **ppvObject) override
+		{
+			if (riid == IID_IUnknown || riid == IID_ISequentialStream || riid == IID_IStream)
+			{
+				*ppvObject = static_cast<IStream *>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppvObject = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		IFACEMETHODIMP_(ULONG) AddRef() override
+		{
+			return InterlockedIncrement(&m_refCount);
+		}
+
+		IFACEMETHODIMP_(ULONG) Release() override
+		{
+			ULONG refCount = InterlockedDecrement(&m_refCount);
+
+			if (refCount == 0)
+			{
+				delete this;
+			}
+
+			return refCount;
+		}
+
+		IFACEMETHODIMP Read(void *pv, ULONG cb, ULONG *pcbRead) override
+		{
+			ULONG bytesToRead = static_cast<ULONG>((std::min)({ static_cast<ULONGLONG>(cb),
+				static_cast<ULONGLONG>(m_maxReadSize), m_size - m_position }));
+			BYTE *buffer = static_cast<BYTE *>(pv);
+
+			for (ULONG i = 0; i < bytesToRead; i++)
+			{
+				buffer[i] = GetByte(m_position + i);
+			}
+
+			m_position += bytesToRead;
+			*pcbRead = bytesToRead;
+
+			return (bytesToRead == cb) ? S_OK : S_FALSE;
+		}
+
+		IFACEMETHODIMP Write(const void *, ULONG, ULONG *) override { return E_NOTIMPL; }
+		IFACEMETHODIMP Seek(LARGE_INTEGER, DWORD, ULARGE_INTEGER *) override { return E_NOTIMPL; }
+		IFACEMETHODIMP SetSize(ULARGE_INTEGER) override { return E_NOTIMPL; }
+		IFACEMETHODIMP CopyTo(IStream *, ULARGE_INTEGER, ULARGE_INTEGER *, ULARGE_INTEGER *) override { return E_NOTIMPL; }
+		IFACEMETHODIMP Commit(DWORD) override { return E_NOTIMPL; }
+		IFACEMETHODIMP Revert() override { return E_NOTIMPL; }
+		IFACEMETHODIMP LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return E_NOTIMPL; }
+		IFACEMETHODIMP UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return E_NOTIMPL; }
+		IFACEMETHODIMP Stat(STATSTG *, DWORD) override { return E_NOTIMPL; }
+		IFACEMETHODIMP Clone(IStream **) override { return E_NOTIMPL; }
+
+	private:
+
+		~GeneratedStream() = default;
+
+		ULONG m_refCount;
+		const ULONGLONG m_size;
+		const ULONG m_maxReadSize;
+		ULONGLONG m_position;
+	};
+
+	std::vector<BYTE> GenerateData(size_t size)
+	{
+		std::mt19937 generator(static_cast<unsigned int>(size));
+		std::vector<BYTE> data(size);
+		std::generate(data.begin(), data.end(), [&generator] { return static_cast<BYTE>(generator()); });
+		return data;
+	}
+
+	wil::com_ptr<IStream> CreateMemoryStream(const std::vector<BYTE> &data)
+	{
+		wil::com_ptr<IStream> stream;
+		stream.attach(SHCreateMemStream(data.data(), static_cast<UINT>(data.size())));
+		return stream;
+	}
+
+	wil::unique_hfile CreateOutputFile(const std::wstring &path)
+	{
+		return wil::unique_hfile(CreateFile(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr));
+	}
+
+	std::vector<BYTE> ReadFileContents(const std::wstring &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<BYTE>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	// The streams are marshaled from this (single-threaded) apartment, so
+	// calls to them from the worker threads are serviced by this thread.
+	// As with the drop window, messages need to be pumped while the copy
+	// is in progress.
+	template <typename Function>
+	auto RunWhilePumpingMessages(Function function)
+	{
+		auto future = std::async(std::launch::async, function);
+
+		while (future.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready)
+		{
+			MsgWaitForMultipleObjects(0, nullptr, FALSE, 10, QS_ALLINPUT);
+
+			MSG msg;
+
+			while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+			{
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+		}
+
+		return future.get();
+	}
+}
+
+class VirtualFileCopyTest : public ::testing::Test
+{
+protected:
+
+	void SetUp() override
+	{
+		TCHAR tempPath[MAX_PATH];
+		ASSERT_NE(GetTempPath(SIZEOF_ARRAY(tempPath), tempPath), 0U);
+
+		m_directory = std::wstring(tempPath) + L"VirtualFileCopyTest" + std::to_wstring(GetCurrentProcessId());
+		ASSERT_TRUE(CreateDirectory(m_directory.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS);
+	}
+
+	void TearDown() override
+	{
+		for (const auto &path : m_files)
+		{
+			DeleteFile(path.c_str());
+		}
+
+		RemoveDirectory(m_directory.c_str());
+	}
+
+	std::wstring GetPath(const std::wstring &fileName)
+	{
+		std::wstring path = m_directory + L"\\" + fileName;
+		m_files.push_back(path);
+		return path;
+	}
+
+private:
+
+	std::wstring m_directory;
+	std::vector<std::wstring> m_files;
+};
+
+TEST_F(VirtualFileCopyTest, CopyStreamToFile)
+{
+	auto data = GenerateData((TEST_CHUNK_SIZE * 10) + 123);
+	auto stream = CreateMemoryStream(data);
+	ASSERT_TRUE(stream);
+
+	std::wstring path = GetPath(L"file.bin");
+	auto file = CreateOutputFile(path);
+	ASSERT_TRUE(file);
+
+	int numChunks = 0;
+	ULONGLONG bytesWritten = 0;
+
+	HRESULT hr = NVirtualFileCopy::CopyStreamToFile(stream.get(), file.get(), NVirtualFileCopy::UNKNOWN_SIZE,
+		TEST_CHUNK_SIZE, [&numChunks, &bytesWritten] (ULONG chunkSize) {
+			numChunks++;
+			bytesWritten += chunkSize;
+			return true;
+		});
+	EXPECT_EQ(hr, S_OK);
+
+	file.reset();
+
+	EXPECT_EQ(numChunks, 11);
+	EXPECT_EQ(bytesWritten, data.size());
+	EXPECT_EQ(ReadFileContents(path), data);
+}
+
+TEST_F(VirtualFileCopyTest, MaxBytes)
+{
+	auto data = GenerateData(TEST_CHUNK_SIZE * 4);
+	auto stream = CreateMemoryStream(data);
+	ASSERT_TRUE(stream);
+
+	std::wstring path = GetPath(L"file.bin");
+	auto file = CreateOutputFile(path);
+	ASSERT_TRUE(file);
+
+	// An HGLOBAL can be larger than the file it contains, so only the
+	// size given in the file descriptor should be copied.
+	const ULONGLONG maxBytes = (TEST_CHUNK_SIZE * 2) + 10;
+	HRESULT hr = NVirtualFileCopy::CopyStreamToFile(stream.get(), file.get(), maxBytes, TEST_CHUNK_SIZE, nullptr);
+	EXPECT_EQ(hr, S_OK);
+
+	file.reset();
+
+	EXPECT_EQ(ReadFileContents(path), std::vector<BYTE>(data.begin(), data.begin() + maxBytes));
+}
+
+TEST_F(VirtualFileCopyTest, ShortReads)
+{
+	const ULONGLONG size = (TEST_CHUNK_SIZE * 3) + 1;
+	wil::com_ptr<IStream> stream;
+	stream.attach(new GeneratedStream(size, 1000));
+
+	std::wstring path = GetPath(L"file.bin");
+	auto file = CreateOutputFile(path);
+	ASSERT_TRUE(file);
+
+	HRESULT hr = NVirtualFileCopy::CopyStreamToFile(stream.get(), file.get(), NVirtualFileCopy::UNKNOWN_SIZE,
+		TEST_CHUNK_SIZE, nullptr);
+	EXPECT_EQ(hr, S_OK);
+
+	file.reset();
+
+	auto contents = ReadFileContents(path);
+	ASSERT_EQ(contents.size(), size);
+
+	for (size_t i = 0; i < contents.size(); i++)
+	{
+		ASSERT_EQ(contents[i], GeneratedStream::GetByte(i));
+	}
+}
+
+TEST_F(VirtualFileCopyTest, Cancel)
+{
+	auto data = GenerateData(TEST_CHUNK_SIZE * 10);
+	auto stream = CreateMemoryStream(data);
+	ASSERT_TRUE(stream);
+
+	std::wstring path = GetPath(L"file.bin");
+	auto file = CreateOutputFile(path);
+	ASSERT_TRUE(file);
+
+	int numChunks = 0;
+
+	HRESULT hr = NVirtualFileCopy::CopyStreamToFile(stream.get(), file.get(), NVirtualFileCopy::UNKNOWN_SIZE,
+		TEST_CHUNK_SIZE, [&numChunks] (ULONG) {
+			numChunks++;
+			return numChunks < 2;
+		});
+	EXPECT_EQ(hr, HRESULT_FROM_WIN32(ERROR_CANCELLED));
+	EXPECT_EQ(numChunks, 2);
+}
+
+TEST_F(VirtualFileCopyTest, CopyItems)
+{
+	const int NUM_ITEMS = NVirtualFileCopy::MAX_CONCURRENT_COPIES * 2 + 1;
+
+	std::vector<std::vector<BYTE>> data;
+	std::vector<NVirtualFileCopy::CopyItem> items;
+	ULONGLONG totalSize = 0;
+
+	FILETIME lastWriteTime;
+	lastWriteTime.dwLowDateTime = 0x12345678;
+	lastWriteTime.dwHighDateTime = 0x01d00000;
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		data.push_back(GenerateData((TEST_CHUNK_SIZE * i) + i));
+		totalSize += data[i].size();
+
+		auto stream = CreateMemoryStream(data[i]);
+		ASSERT_TRUE(stream);
+
+		NVirtualFileCopy::CopyItem item;
+		HRESULT hr = CoMarshalInterThreadInterfaceInStream(IID_IStream, stream.get(), &item.marshaledStream);
+		ASSERT_EQ(hr, S_OK);
+
+		// The size of some files won't be known ahead of time.
+		item.size = (i % 2 == 0) ? data[i].size() : NVirtualFileCopy::UNKNOWN_SIZE;
+		item.destinationPath = GetPath(L"file" + std::to_wstring(i) + L".bin");
+		item.attributes = FILE_ATTRIBUTE_NORMAL;
+		item.lastWriteTime = lastWriteTime;
+		items.push_back(std::move(item));
+	}
+
+	ULONGLONG lastTotalBytes = 0;
+	ULONGLONG lastBytesCopied = 0;
+	bool progressValid = true;
+
+	auto results = RunWhilePumpingMessages([&] {
+		return NVirtualFileCopy::CopyItems(items, TEST_CHUNK_SIZE,
+			[&] (ULONGLONG totalBytes, ULONGLONG bytesCopied) {
+				if (bytesCopied > totalBytes || bytesCopied < lastBytesCopied)
+				{
+					progressValid = false;
+				}
+
+				lastTotalBytes = totalBytes;
+				lastBytesCopied = bytesCopied;
+				return true;
+			});
+	});
+
+	EXPECT_TRUE(progressValid);
+	EXPECT_EQ(lastTotalBytes, totalSize);
+	EXPECT_EQ(lastBytesCopied, totalSize);
+
+	ASSERT_EQ(results.size(), items.size());
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		EXPECT_EQ(results[i], S_OK);
+		EXPECT_EQ(ReadFileContents(items[i].destinationPath), data[i]);
+
+		WIN32_FILE_ATTRIBUTE_DATA attributeData;
+		ASSERT_TRUE(GetFileAttributesEx(items[i].destinationPath.c_str(), GetFileExInfoStandard, &attributeData));
+		EXPECT_EQ(CompareFileTime(&attributeData.ftLastWriteTime, &lastWriteTime), 0);
+	}
+}
+
+TEST_F(VirtualFileCopyTest, CopyItemsCancel)
+{
+	const int NUM_ITEMS = NVirtualFileCopy::MAX_CONCURRENT_COPIES * 2;
+
+	std::vector<NVirtualFileCopy::CopyItem> items;
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		wil::com_ptr<IStream> stream;
+		stream.attach(new GeneratedStream(TEST_CHUNK_SIZE * 4096, TEST_CHUNK_SIZE));
+
+		NVirtualFileCopy::CopyItem item;
+		HRESULT hr = CoMarshalInterThreadInterfaceInStream(IID_IStream, stream.get(), &item.marshaledStream);
+		ASSERT_EQ(hr, S_OK);
+
+		item.size = NVirtualFileCopy::UNKNOWN_SIZE;
+		item.destinationPath = GetPath(L"file" + std::to_wstring(i) + L".bin");
+		item.attributes = FILE_ATTRIBUTE_NORMAL;
+		items.push_back(std::move(item));
+	}
+
+	auto results = RunWhilePumpingMessages([&] {
+		return NVirtualFileCopy::CopyItems(items, TEST_CHUNK_SIZE, [] (ULONGLONG, ULONGLONG) {
+			return false;
+		});
+	});
+
+	// Any copies that didn't finish should have been removed.
+	for (int i = 0; i < NUM_ITEMS; i++)
+	{
+		if (FAILED(results[i]))
+		{
+			EXPECT_EQ(GetFileAttributes(items[i].destinationPath.c_str()), INVALID_FILE_ATTRIBUTES);
+		}
+	}
+
+	EXPECT_TRUE(std::any_of(results.begin(), results.end(), [] (HRESULT hr) {
+		return hr == HRESULT_FROM_WIN32(ERROR_CANCELLED);
+	}));
+}
+
+TEST(VirtualFileCopy, ScaleProgress)
+{
+	UINT workTotal;
+	UINT workSoFar;
+
+	NVirtualFileCopy::ScaleProgress(1000, 250, workTotal, workSoFar);
+	EXPECT_EQ(workTotal, 1000U);
+	EXPECT_EQ(workSoFar, 250U);
+
+	// Files larger than 4 GB.
+	const ULONGLONG totalBytes = 20ULL * 1024 * 1024 * 1024;
+	NVirtualFileCopy::ScaleProgress(totalBytes, totalBytes / 4, workTotal, workSoFar);
+	EXPECT_LE(workTotal, UINT_MAX);
+	EXPECT_GT(workTotal, UINT_MAX / 2);
+	EXPECT_NEAR(static_cast<double>(workSoFar) / workTotal, 0.25, 0.001);
+
+	NVirtualFileCopy::ScaleProgress(totalBytes, totalBytes, workTotal, workSoFar);
+	EXPECT_EQ(workSoFar, workTotal);
+}
+
+// The entire file was previously read into a single buffer before being
+// written out. Now, the file should be written out one chunk at a time.
+// This takes a long time to run, so it's disabled by default.
+TEST_F(VirtualFileCopyTest, DISABLED_LargeFile)
+{
+	const ULONGLONG size = 256ULL * 1024 * 1024;
+	wil::com_ptr<IStream> stream;
+	stream.attach(new GeneratedStream(size, ULONG_MAX));
+
+	std::wstring path = GetPath(L"large.bin");
+	auto file = CreateOutputFile(path);
+	ASSERT_TRUE(file);
+
+	ULONGLONG bytesWritten = 0;
+
+	HRESULT hr = NVirtualFileCopy::CopyStreamToFile(stream.get(), file.get(), size, NVirtualFileCopy::CHUNK_SIZE,
+		[&bytesWritten] (ULONG chunkBytesWritten) {
+			EXPECT_LE(chunkBytesWritten, NVirtualFileCopy::CHUNK_SIZE);
+			bytesWritten += chunkBytesWritten;
+			return true;
+		});
+	EXPECT_EQ(hr, S_OK);
+	EXPECT_EQ(bytesWritten, size);
+
+	file.reset();
+
+	WIN32_FILE_ATTRIBUTE_DATA attributeData;
+	ASSERT_TRUE(GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attributeData));
+	EXPECT_EQ((static_cast<ULONGLONG>(attributeData.nFileSizeHigh) << 32) | attributeData.nFileSizeLow, size);
+}